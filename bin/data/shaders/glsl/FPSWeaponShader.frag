@@ -3,20 +3,58 @@ uniform sampler2D tex1;
 varying vec3 normal;
 uniform vec3 mSunPos;         // Sun light position
 varying vec3 vertex;
-uniform float shadow;
+varying vec4 shadowPos;
+uniform sampler2D shadowMap;
+uniform mat4 mShadowMatrix[4];
+uniform float mShadowSplits[4];
+uniform float mShadowCascades;
+uniform float mShadowTexel;
 
 float specMap(vec3 tmp) {
 	return pow(length(tmp),2.5);
 }
 
+// Sun light reaching an object space position, 0 in shadow and 1 lit.
+// The first cascade ending past the view depth holds it.
+float sunShadow(vec4 pos, float viewDepth)
+{
+	vec4 coord;
+
+	if(mShadowCascades < 1.0 || viewDepth > mShadowSplits[3])
+		return 1.0;
+	else if(viewDepth <= mShadowSplits[0])
+		coord = mShadowMatrix[0]*pos;
+	else if(viewDepth <= mShadowSplits[1])
+		coord = mShadowMatrix[1]*pos;
+	else if(viewDepth <= mShadowSplits[2])
+		coord = mShadowMatrix[2]*pos;
+	else
+		coord = mShadowMatrix[3]*pos;
+
+	// The atlas holds the caster depths, 2x2 taps soften the edges
+	float z = coord.z-0.0005;
+
+	float lit = step(z, texture2D(shadowMap, coord.xy).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(mShadowTexel, 0.0)).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(0.0, mShadowTexel)).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(mShadowTexel, mShadowTexel)).r);
+
+	return lit*0.25;
+}
+
 void main(void)
 {
 	vec3 msun = normalize(mSunPos);
 	vec3 nmal = normalize(normal);
 	float tmp2 = max(0.0,dot(msun, nmal));
 	vec3 R = reflect(normalize(vertex),nmal);
+	float shadow = sunShadow(shadowPos, vertex.z);
 	
 	float mix_val = gl_LightModel.ambient*gl_FrontMaterial.ambient + tmp2*shadow*gl_FrontMaterial.diffuse;
 	vec4 color = texture2D(tex0, gl_TexCoord[0]);
-	gl_FragColor = color*mix_val+pow(max(dot(R,msun),0.0),gl_FrontMaterial.shininess)*shadow*gl_FrontMaterial.specular*specMap(color.xyz);
+	gl_FragData[0] = color*mix_val+pow(max(dot(R,msun),0.0),gl_FrontMaterial.shininess)*shadow*gl_FrontMaterial.specular*specMap(color.xyz);
+
+	// G-buffer of the dynamic lights: view normal and negated depth, albedo
+	gl_FragData[1] = vec4(nmal, -vertex.z);
+	gl_FragData[2] = color;
 }
@@ -1,13 +1,16 @@
 varying vec3 normal;
 varying vec3 vertex;
+varying vec4 shadowPos;
 
 void main(void)
 {
 	gl_Position = ftransform();
 
-	vertex = gl_ModelViewMatrix*gl_Vertex;
+	vertex = (gl_ModelViewMatrix*gl_Vertex).xyz;
 	
 	normal = gl_NormalMatrix*gl_Normal;
 
+	shadowPos = gl_Vertex;
+
 	gl_TexCoord[0] = gl_MultiTexCoord0;
 }
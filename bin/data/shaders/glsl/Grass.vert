@@ -104,11 +104,15 @@ void main()
 		vec4 tformed = vec4(centr+length(vectorFromCenter)*windOffset,gl_Vertex.w);
 		gl_Position = gl_ModelViewProjectionMatrix * tformed;
 		gl_FrontColor = vec4(max(dot(normalize(mSunPos),gl_NormalMatrix*gl_Normal),0.0),1.0,0.0,clamp(exp2(-gl_Fog.density * length(gl_Position.xyz) * 1.442695), 0.0, 1.0));
-		gl_TexCoord[0] = vec4(gl_MultiTexCoord0.xy,gl_Vertex.xz/vec2(1010.0,-1010.0)+vec2(0.51,0.51));
+		gl_TexCoord[0] = gl_MultiTexCoord0;
+		gl_TexCoord[1] = vec4(gl_NormalMatrix*gl_Normal,(gl_ModelViewMatrix * tformed).z);
+		gl_TexCoord[2] = tformed;
 	}
 	else {
 		gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
 		gl_FrontColor = vec4(max(dot(normalize(mSunPos),gl_NormalMatrix*gl_Normal),0.0),1.0,0.0,clamp(exp2(-gl_Fog.density * length(gl_Position.xyz) * 1.442695), 0.0, 1.0));
-		gl_TexCoord[0] = vec4(gl_MultiTexCoord0.xy,gl_Vertex.xz/vec2(1010.0,-1010.0)+vec2(0.51,0.51));
+		gl_TexCoord[0] = gl_MultiTexCoord0;
+		gl_TexCoord[1] = vec4(gl_NormalMatrix*gl_Normal,(gl_ModelViewMatrix * gl_Vertex).z);
+		gl_TexCoord[2] = gl_Vertex;
 	}
 }
@@ -3,7 +3,41 @@ uniform sampler2D tex0;
 varying float diffuse;
 uniform vec3 mAmbientData;
 uniform sampler2D shadowMap;
-varying vec2 shadowTC;
+uniform mat4 mShadowMatrix[4];
+uniform float mShadowSplits[4];
+uniform float mShadowCascades;
+uniform float mShadowTexel;
+varying vec4 shadowPos;
+varying vec3 normal;
+varying float depth;
+
+// Sun light reaching an object space position, 0 in shadow and 1 lit.
+// The first cascade ending past the view depth holds it.
+float sunShadow(vec4 pos, float viewDepth)
+{
+	vec4 coord;
+
+	if(mShadowCascades < 1.0 || viewDepth > mShadowSplits[3])
+		return 1.0;
+	else if(viewDepth <= mShadowSplits[0])
+		coord = mShadowMatrix[0]*pos;
+	else if(viewDepth <= mShadowSplits[1])
+		coord = mShadowMatrix[1]*pos;
+	else if(viewDepth <= mShadowSplits[2])
+		coord = mShadowMatrix[2]*pos;
+	else
+		coord = mShadowMatrix[3]*pos;
+
+	// The atlas holds the caster depths, 2x2 taps soften the edges
+	float z = coord.z-0.0005;
+
+	float lit = step(z, texture2D(shadowMap, coord.xy).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(mShadowTexel, 0.0)).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(0.0, mShadowTexel)).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(mShadowTexel, mShadowTexel)).r);
+
+	return lit*0.25;
+}
 
 void main()
 {
@@ -11,6 +45,10 @@ void main()
 
 	if (Color.a<0.35) discard;
 
-	gl_FragColor = vec4(mix(gl_Fog.color.rgb, Color.rgb * (gl_FrontMaterial.ambient*mAmbientData.x+(1.0-texture2D(shadowMap,shadowTC).a)*diffuse*gl_FrontMaterial.diffuse), gl_Color.a), 1.0);
+	gl_FragData[0] = vec4(mix(gl_Fog.color.rgb, Color.rgb * (gl_FrontMaterial.ambient*mAmbientData.x+sunShadow(shadowPos, depth)*diffuse*gl_FrontMaterial.diffuse), gl_Color.a), 1.0);
+
+	// G-buffer of the dynamic lights: view normal and negated depth, albedo
+	gl_FragData[1] = vec4(normalize(normal), -depth);
+	gl_FragData[2] = Color;
 	//gl_FragColor = vec4(mix(gl_Fog.color.rgb, gl_Color.rgb *Color.rgb * gl_FrontMaterial.emission, gl_Color.a), 1.0);
 }
@@ -3,7 +3,9 @@ uniform vec3 mSunPos;
 uniform vec3 windDir;
 uniform float time;
 varying float diffuse;
-varying vec2 shadowTC;
+varying vec4 shadowPos;
+varying vec3 normal;
+varying float depth;
 
 float noiseR(float put,float lower, float upper) {
 	return 1.0;//+clamp(cos(put)*cos(put*3.0)*cos(put*5.0)*cos(put*7.0)*3.0+sin(put*25.0)*0.3,-lower,upper);
@@ -37,15 +39,19 @@ void main()
 		vec4 tformed = vec4(centr+length(vectorFromCenter)*windOffset,gl_Vertex.w);
 		gl_Position = gl_ModelViewProjectionMatrix * tformed;
 		gl_FrontColor.a = clamp(exp2(-gl_Fog.density * length(gl_Position.xyz) * 1.442695), 0.0, 1.0);
-		shadowTC = tformed.xz/vec2(1010.0,-1010.0)+vec2(0.51,0.51);
-		diffuse = max(dot(normalize(mSunPos),gl_NormalMatrix*gl_Normal),0.0);
+		shadowPos = tformed;
+		normal = gl_NormalMatrix*gl_Normal;
+		depth = (gl_ModelViewMatrix * tformed).z;
+		diffuse = max(dot(normalize(mSunPos),normal),0.0);
 		gl_TexCoord[0] = gl_MultiTexCoord0;
 	}
 	else {
 		gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
 		gl_FrontColor.a = clamp(exp2(-gl_Fog.density * length(gl_Position.xyz) * 1.442695), 0.0, 1.0);
-		shadowTC = gl_Vertex.xz/vec2(1010.0,-1010.0)+vec2(0.51,0.51);
-		diffuse = max(dot(normalize(mSunPos),gl_NormalMatrix*gl_Normal),0.0);
+		shadowPos = gl_Vertex;
+		normal = gl_NormalMatrix*gl_Normal;
+		depth = (gl_ModelViewMatrix * gl_Vertex).z;
+		diffuse = max(dot(normalize(mSunPos),normal),0.0);
 		gl_TexCoord[0] = gl_MultiTexCoord0;
 	}
 }
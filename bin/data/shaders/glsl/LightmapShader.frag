@@ -0,0 +1,21 @@
+//level geometry
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+uniform float mFog;
+varying vec3 normal;
+varying float depth;
+varying float fogDistance;
+
+void main(void)
+{
+	vec4 albedo = texture2D(tex0, gl_TexCoord[0].xy);
+	vec3 col = albedo.rgb * texture2D(tex1, gl_TexCoord[1].xy).rgb;
+
+	float fogFactor = mix(1.0, clamp(exp2( -gl_Fog.density*fogDistance*1.442695 ), 0.0, 1.0), mFog);
+
+	gl_FragData[0] = vec4(mix(gl_Fog.color.rgb, col, fogFactor), 1.0);
+
+	// G-buffer of the dynamic lights: view normal and negated depth, albedo
+	gl_FragData[1] = vec4(normalize(normal), -depth);
+	gl_FragData[2] = albedo;
+}
@@ -0,0 +1,17 @@
+varying vec3 normal;
+varying float depth;
+varying float fogDistance;
+
+void main(void)
+{
+	gl_Position = ftransform();
+
+	vec4 vertex = gl_ModelViewMatrix*gl_Vertex;
+
+	normal = gl_NormalMatrix*gl_Normal;
+	depth = vertex.z;
+	fogDistance = length(vertex.xyz);
+
+	gl_TexCoord[0] = gl_MultiTexCoord0;
+	gl_TexCoord[1] = gl_MultiTexCoord1;
+}
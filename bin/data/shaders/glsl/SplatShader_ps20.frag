@@ -6,8 +6,43 @@ uniform sampler2D tex3;
 uniform sampler2D tex4;
 uniform vec3 mSunPos;         	// Sun light position
 uniform vec3 mAmbientData;	// Sun light parameters
+uniform sampler2D shadowMap;
+uniform mat4 mShadowMatrix[4];
+uniform float mShadowSplits[4];
+uniform float mShadowCascades;
+uniform float mShadowTexel;
 varying vec3 varVert;
 varying vec3 normal;
+varying float depth;
+varying vec4 shadowPos;
+
+// Sun light reaching an object space position, 0 in shadow and 1 lit.
+// The first cascade ending past the view depth holds it.
+float sunShadow(vec4 pos, float viewDepth)
+{
+	vec4 coord;
+
+	if(mShadowCascades < 1.0 || viewDepth > mShadowSplits[3])
+		return 1.0;
+	else if(viewDepth <= mShadowSplits[0])
+		coord = mShadowMatrix[0]*pos;
+	else if(viewDepth <= mShadowSplits[1])
+		coord = mShadowMatrix[1]*pos;
+	else if(viewDepth <= mShadowSplits[2])
+		coord = mShadowMatrix[2]*pos;
+	else
+		coord = mShadowMatrix[3]*pos;
+
+	// The atlas holds the caster depths, 2x2 taps soften the edges
+	float z = coord.z-0.0005;
+
+	float lit = step(z, texture2D(shadowMap, coord.xy).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(mShadowTexel, 0.0)).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(0.0, mShadowTexel)).r);
+	lit += step(z, texture2D(shadowMap, coord.xy+vec2(mShadowTexel, mShadowTexel)).r);
+
+	return lit*0.25;
+}
 
 void main(void)
 {
@@ -22,5 +57,9 @@ void main(void)
 	// More efficient as a one-liner
 	float fogFactor = clamp(exp2( -gl_Fog.density*length(varVert.xyz)*1.442695 ), 0.0, 1.0);
 
-    gl_FragColor = vec4(mix(gl_Fog.color.rgb,col.rgb*(mAmbientData.x*0.95+max(dot(normalize(normal),normalize(mSunPos)),0.0)*0.5*(1.0-splat.a)),fogFactor), 1.0);
+    gl_FragData[0] = vec4(mix(gl_Fog.color.rgb,col.rgb*(mAmbientData.x*0.95+max(dot(normalize(normal),normalize(mSunPos)),0.0)*0.5*sunShadow(shadowPos, depth)),fogFactor), 1.0);
+
+	// G-buffer of the dynamic lights: view normal and negated depth, albedo
+	gl_FragData[1] = vec4(normalize(normal), -depth);
+	gl_FragData[2] = vec4(col.rgb, 1.0);
 }
@@ -1,11 +1,15 @@
 varying vec3 varVert;
 varying vec3 normal;
+varying float depth;
+varying vec4 shadowPos;
 
 void main(void)
 {
 	gl_Position = ftransform();
 	varVert = gl_Position.xyz;
 	normal = gl_NormalMatrix*normalize(gl_Normal);
+	depth = (gl_ModelViewMatrix*gl_Vertex).z;
+	shadowPos = gl_Vertex;
 	
 	gl_TexCoord[0] = gl_MultiTexCoord0 * 32.0;
 	gl_TexCoord[1] = gl_MultiTexCoord0;	
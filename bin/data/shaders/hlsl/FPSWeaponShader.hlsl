@@ -3,12 +3,20 @@ float4x4 mInvWorld;       	// Inverted world matrix
 float4x4 mTransWorld;     	// Transposed world matrix
 float3 mSunPos;         	// Sun light position
 float3 mAmbientData;
+float4x4 mShadowMatrix[4];	// Object space to the cascades of the shadow atlas
+float mShadowSplits[4];		// View distance where each cascade ends
+float mShadowCascades;		// 0 when shadows are off
+float mShadowTexel;
 
 struct VS_OUTPUT
 {
 	float4 Position   : POSITION;   // vertex position 
 	float4 Diffuse    : COLOR0;     // vertex diffuse color
-	float2 TexCoord1  : TEXCOORD0;  // tex coords
+	float3 TexCoord1  : TEXCOORD0;  // tex coords, view depth
+	float4 Shadow0	  : TEXCOORD1;  // position in each cascade
+	float4 Shadow1	  : TEXCOORD2;
+	float4 Shadow2	  : TEXCOORD3;
+	float4 Shadow3	  : TEXCOORD4;
 };
 
 VS_OUTPUT vertexMain(	float4 vPosition	: POSITION,
@@ -39,11 +47,18 @@ VS_OUTPUT vertexMain(	float4 vPosition	: POSITION,
 	float3 tmp = dot(-lightVector, normal);
 	tmp = lit(tmp.x, tmp.y, 1);
 
-	Output.Diffuse = lerp(mAmbientData.y + (tmp.y*mAmbientData.y), (mAmbientData.y + mAmbientData.x) / 2, mAmbientData.z);
+	Output.Diffuse = lerp(mAmbientData.y, (mAmbientData.y + mAmbientData.x) / 2, mAmbientData.z);
 
-	Output.Diffuse.a = 1;
+	// The sun part, the pixel shader takes the shadow off it
+	Output.Diffuse.a = (1 - mAmbientData.z) * tmp.y * mAmbientData.y;
 	
-	Output.TexCoord1 = texCoord;
+	Output.TexCoord1.xy = texCoord;
+	Output.TexCoord1.z = Output.Position.w;
+
+	Output.Shadow0 = mul(vPosition, mShadowMatrix[0]);
+	Output.Shadow1 = mul(vPosition, mShadowMatrix[1]);
+	Output.Shadow2 = mul(vPosition, mShadowMatrix[2]);
+	Output.Shadow3 = mul(vPosition, mShadowMatrix[3]);
 	
 	return Output;
 }
@@ -72,9 +87,38 @@ sampler2D tex1 = sampler_state
 	AddressV		= WRAP;
 };
 
-float4 pixelMain(float2 TexCoord : TEXCOORD0, float4 Diffuse : COLOR0) : COLOR0
+sampler2D shadowMap : register(s5);
+
+// Sun light reaching the pixel, 0 in shadow and 1 lit.
+// The first cascade ending past the view depth holds it.
+float sunShadow(float4 coord0, float4 coord1, float4 coord2, float4 coord3, float viewDepth)
+{
+	if(mShadowCascades < 1 || viewDepth > mShadowSplits[3])
+		return 1;
+
+	float4 coord = viewDepth <= mShadowSplits[0] ? coord0 :
+		(viewDepth <= mShadowSplits[1] ? coord1 : (viewDepth <= mShadowSplits[2] ? coord2 : coord3));
+
+	// The atlas holds the caster depths, 2x2 taps soften the edges
+	float z = coord.z - 0.0005;
+
+	float lit = step(z, tex2D(shadowMap, coord.xy).r);
+	lit += step(z, tex2D(shadowMap, coord.xy + float2(mShadowTexel, 0)).r);
+	lit += step(z, tex2D(shadowMap, coord.xy + float2(0, mShadowTexel)).r);
+	lit += step(z, tex2D(shadowMap, coord.xy + float2(mShadowTexel, mShadowTexel)).r);
+
+	return lit * 0.25;
+}
+
+float4 pixelMain(float3 TexCoord : TEXCOORD0, float4 Diffuse : COLOR0,
+	float4 Shadow0 : TEXCOORD1, float4 Shadow1 : TEXCOORD2,
+	float4 Shadow2 : TEXCOORD3, float4 Shadow3 : TEXCOORD4) : COLOR0
 { 	
-	float4 outColor = tex2D(tex0, TexCoord.xy) * Diffuse;
+	float4 outColor = tex2D(tex0, TexCoord.xy);
+
+	float shadow = sunShadow(Shadow0, Shadow1, Shadow2, Shadow3, TexCoord.z);
+
+	outColor.rgb *= Diffuse.rgb + Diffuse.a * shadow;
 
 	return outColor;
 }
@@ -3,12 +3,21 @@ float4x4 mInvWorld;       	// Inverted world matrix
 float4x4 mTransWorld;     	// Transposed world matrix
 float3 mSunPos;         	// Sun light position
 float3 mAmbientData;		// Sun light parameters
+float4x4 mShadowMatrix[4];	// Object space to the cascades of the shadow atlas
+float mShadowSplits[4];		// View distance where each cascade ends
+float mShadowCascades;		// 0 when shadows are off
+float mShadowTexel;
 
 struct VS_OUTPUT
 {
 	float4 Position   : POSITION;   // vertex position 
 	float4 Diffuse    : COLOR0;     // vertex diffuse color
 	float4 TexCoord1  : TEXCOORD0;  // tex coords
+	float4 Shadow0	  : TEXCOORD1;  // position in each cascade
+	float4 Shadow1	  : TEXCOORD2;
+	float4 Shadow2	  : TEXCOORD3;
+	float4 Shadow3	  : TEXCOORD4;
+	float  Depth	  : TEXCOORD5;  // view depth
 };
 
 VS_OUTPUT vertexMain(	in float4 vPosition	: POSITION,
@@ -45,6 +54,13 @@ VS_OUTPUT vertexMain(	in float4 vPosition	: POSITION,
 	Output.TexCoord1.xy = texCoord * 32;
 	Output.TexCoord1.zw = texCoord;
 
+	Output.Depth = Output.Position.w;
+
+	Output.Shadow0 = mul(vPosition, mShadowMatrix[0]);
+	Output.Shadow1 = mul(vPosition, mShadowMatrix[1]);
+	Output.Shadow2 = mul(vPosition, mShadowMatrix[2]);
+	Output.Shadow3 = mul(vPosition, mShadowMatrix[3]);
+
 	return Output;
 }
 
@@ -107,7 +123,33 @@ sampler2D tex4 = sampler_state
 	AddressV		= WRAP;
 };
 
-float4 pixelMain(in float4 TexCoord : TEXCOORD0, in float4 Diffuse : COLOR0) : COLOR0
+sampler2D shadowMap : register(s5);
+
+// Sun light reaching the pixel, 0 in shadow and 1 lit.
+// The first cascade ending past the view depth holds it.
+float sunShadow(float4 coord0, float4 coord1, float4 coord2, float4 coord3, float viewDepth)
+{
+	if(mShadowCascades < 1 || viewDepth > mShadowSplits[3])
+		return 1;
+
+	float4 coord = viewDepth <= mShadowSplits[0] ? coord0 :
+		(viewDepth <= mShadowSplits[1] ? coord1 : (viewDepth <= mShadowSplits[2] ? coord2 : coord3));
+
+	// The atlas holds the caster depths, 2x2 taps soften the edges
+	float z = coord.z - 0.0005;
+
+	float lit = step(z, tex2D(shadowMap, coord.xy).r);
+	lit += step(z, tex2D(shadowMap, coord.xy + float2(mShadowTexel, 0)).r);
+	lit += step(z, tex2D(shadowMap, coord.xy + float2(0, mShadowTexel)).r);
+	lit += step(z, tex2D(shadowMap, coord.xy + float2(mShadowTexel, mShadowTexel)).r);
+
+	return lit * 0.25;
+}
+
+float4 pixelMain(in float4 TexCoord : TEXCOORD0, in float4 Diffuse : COLOR0,
+	in float4 Shadow0 : TEXCOORD1, in float4 Shadow1 : TEXCOORD2,
+	in float4 Shadow2 : TEXCOORD3, in float4 Shadow3 : TEXCOORD4,
+	in float Depth : TEXCOORD5) : COLOR0
 { 	
 	float3 outColor = tex2D(tex1, TexCoord.xy).rgb;
 	float4 splat = tex2D(tex0, TexCoord.zw); // splat map
@@ -116,6 +158,8 @@ float4 pixelMain(in float4 TexCoord : TEXCOORD0, in float4 Diffuse : COLOR0) : C
 		((((((outColor*(1-splat.r)) + tex2D(tex2, TexCoord.xy).rgb * splat.r)
 		* (1-splat.g)) + tex2D(tex3, TexCoord.xy).rgb * splat.g)
 		* (1-splat.b)) + tex2D(tex4, TexCoord.xy).rgb * splat.b);	
-	return float4(outColor * (1 - (splat.a * Diffuse.a)) * Diffuse.rgb, 1);
+	float shadow = 1 - sunShadow(Shadow0, Shadow1, Shadow2, Shadow3, Depth);
+
+	return float4(outColor * (1 - (shadow * Diffuse.a)) * Diffuse.rgb, 1);
 }
 
@@ -39,6 +39,18 @@ namespace engine {
     //! Get the user-defined ID of this character
     irr::s32 getUserID() { return userID; }
 
+    bool isDead() { return (parameters.States & ECS_DEAD) != 0; }
+
+    //! Seconds since the character died
+    irr::f32 getDeathTime() { return deathTime; }
+
+#ifdef PHYSICS_NEWTON
+    //! Vehicle the character drives, or -1
+    irr::s32 getVehicle() { return vehicle; }
+
+    bool isDriving() { return vehicle >= 0; }
+#endif
+
     /*
       SET methods
     */
@@ -61,6 +73,19 @@ namespace engine {
     {
       parameters.States = 0;
       runSpeedFactor = 0.f;
+      deathTime = 0.f;
+
+      // Back from the dead
+      if(body.Node)
+        body.Node->setVisible(true);
+
+#ifdef PHYSICS_NEWTON
+      if(body.PhysicsBody)
+        body.PhysicsBody->setCollisionEnabled(true);
+
+      // Respawned while driving
+      leaveVehicle();
+#endif
 
       stand();
     }
@@ -95,6 +120,10 @@ namespace engine {
 
     void remove();
 
+    //! Hand the character over to a ragdoll and hide it until it respawns.
+    //! The velocity (irrlicht units per second) is given to the ragdoll.
+    void die(const irr::core::vector3df& velocity = irr::core::vector3df(0.f, 0.f, 0.f));
+
     irr::scene::ISceneNode * rotationNode;
 
   protected:
@@ -104,6 +133,10 @@ namespace engine {
     //! Main update .. gravity, movement and such
     void update();
 
+    //! Kill the character once its health is gone. True while it is dead,
+    //! the derived classes skip their update then.
+    bool updateDeath();
+
     //! Move the character with the given direction vector
     void move(irr::core::vector3df dir, irr::f32 moveSpeed, bool inAir=false, irr::f32 deceleration=.0f);
 
@@ -121,6 +154,18 @@ namespace engine {
     //! Stand up
     void stand();
 
+#ifdef PHYSICS_NEWTON
+    //! Get in the nearest vehicle nobody drives. False when none is close.
+    bool enterVehicle();
+
+    //! Get out on the left side of the vehicle
+    void leaveVehicle();
+
+    //! Controls of the vehicle driven (see CVehicleManager::setControls).
+    //! The character rides on top of it, facing its front.
+    void drive(irr::f32 throttle, irr::f32 steering, bool brake);
+#endif
+
     void *inventory;
 
     /// Rendered node and physics body
@@ -141,9 +186,15 @@ namespace engine {
 
     irr::f32 fallingTime;
 
+    irr::f32 deathTime;
+
     irr::s32 userID;
 
     irr::f32 floorY;
+
+#ifdef PHYSICS_NEWTON
+    irr::s32 vehicle;
+#endif
   };
 
 }
@@ -2,13 +2,21 @@
 // of draw calls. Simply add meshes into this one, with given transformations
 // or positions, and then call update
 
-// TODO: Adapt the VBO interface and integrate setDirty with the current VBO updates.
+// Moving a mesh buffer marks only its vertices dirty, the driver uploads just that range.
+
+// Destination buffers use 32 bit indices, so there is one buffer per material
+// and vertex type no matter how many vertices are added.
+
+// Lower detail levels can be generated from the destination buffers. The mesh
+// then hands out the buffers of the level picked by selectLod().
 
 #ifndef CBATCHINGMESH_HEADER
 #define CBATCHINGMESH_HEADER
 
 #include "IMesh.h"
 #include "SMeshBuffer.h"
+#include "CDynamicMeshBuffer.h"
+#include "IMeshManipulator.h"
 
 namespace irr
 {
@@ -32,8 +40,15 @@ public:
 	void clear();
 
 	//! first updates the mesh, then drops all source buffers.
-	/** once this mesh has been finalized, it cannot be changed again! */
-	void finalize();
+	/** once this mesh has been finalized, it cannot be changed again!
+	With an optimizer the destination buffers are then reordered for the
+	vertex caches, see IMeshManipulator::optimizeMeshBuffer() */
+	void finalize(const IMeshManipulator* optimizer=0);
+
+	//! measures the vertex cache use of the destination buffers
+	/** The ratios of the buffers are weighted by their triangles and vertices,
+	see IMeshManipulator::getVertexCacheStats() */
+	void getVertexCacheStats(const IMeshManipulator* manipulator, f32& acmr, f32& atvr) const;
 
 	//! adds a mesh to the buffers with the given offset
 	/** \Return: Returns an array of ID numbers */
@@ -87,6 +102,34 @@ public:
 	//! returns the number of source buffers
 	u32 getSourceBufferCount() const;
 
+	//! builds lower detail copies of the destination buffers
+	/** Every level keeps about ratio of the triangles of the level before it
+	and is optimized for the vertex caches. Levels are built from the current
+	destination buffers, update() with new buffers or moving a mesh buffer
+	drops them again.
+	\Return: Returns the number of levels, including the full detail one */
+	u32 generateLods(const IMeshManipulator* manipulator, u32 levels, f32 ratio);
+
+	//! drops the lower detail levels, the mesh draws at full detail
+	void clearLods();
+
+	//! sets the screen size (part of the screen height) below which a level is used
+	void setLodScreenSize(u32 level, f32 size);
+
+	//! picks the detail level for the screen size the mesh covers
+	/** A level is only left once the size is past its threshold by the
+	hysteresis fraction, so meshes near a threshold don't keep switching.
+	\Return: Returns true if the level changed */
+	bool selectLod(f32 screenSize, f32 hysteresis);
+
+	//! returns the number of detail levels, including the full detail one
+	u32 getLodCount() const { return Lods.size() + 1; }
+
+	u32 getCurrentLod() const { return CurrentLod; }
+
+	//! returns the number of triangles drawn at the given level
+	u32 getLodTriangleCount(u32 level) const;
+
   u32 getDestBufferCount() { return DestBuffers.size(); }
 
   u32 getMaterialRefCount() { return MaterialReferences.size(); }
@@ -159,13 +202,20 @@ private:
 
 	struct SDestBufferReference
 	{
-		IMeshBuffer* Buffer;
+		CDynamicMeshBuffer* Buffer;
 		video::E_VERTEX_TYPE VertexType;
 		u32 VertexCount;
 		u32 IndexCount;
 		bool IsDirty;
 	};
 
+	struct SLodLevel
+	{
+		//! simplified copy of every destination buffer, in the same order
+		core::array<IMeshBuffer*> Buffers;
+		f32 ScreenSize;
+	};
+
 	//! Source mesh buffers, these are locked
 	//core::array<bool>                 SourceBufferNeeded;
 	core::array<IMeshBuffer*>         SourceBuffers;
@@ -175,6 +225,10 @@ private:
 	core::array<SMaterialReference>   MaterialReferences;
 	core::array<SDestBufferReference> DestBuffers;
 
+	//! levels below full detail, Lods[0] is level 1
+	core::array<SLodLevel>            Lods;
+	u32 CurrentLod;
+
 	//! bounding containing all destination buffers
 	core::aabbox3d<f32> Box;
 
@@ -3,6 +3,7 @@
 
 #include "Engine.h"
 #include "BaseCharacter.h"
+#include "GameClasses.h"
 
 namespace game {
 
@@ -10,7 +11,9 @@ namespace game {
   {
   public:
 
-    CBot(engine::SCharacterCreationParameters params);
+    CBot(CGame * game, engine::SCharacterCreationParameters params);
+
+    ~CBot();
 
     virtual void update();
 
@@ -20,6 +23,27 @@ namespace game {
 
   private:
 
+    //! Pick a new destination and queue a path to it
+    void plan();
+
+    //! Move by the input of the network client controlling this character
+    void followInput(const engine::SNetInput& input);
+
+#ifdef PHYSICS_NEWTON
+    //! Steer the vehicle driven towards the waypoint
+    void driveTo(const irr::core::vector3df& waypoint);
+#endif
+
+    CGame * Game;
+
+    // Path request waiting for a worker, 0 when none
+    irr::u32 m_PathTicket;
+
+    irr::core::array<irr::core::vector3df> m_Path;
+    irr::u32 m_PathIndex;
+
+    // Seconds until the next destination is picked
+    irr::f32 m_PlanDelay;
 
   };
 
@@ -0,0 +1,190 @@
+#ifndef BREAKABLES_HEADER_DEFINED
+#define BREAKABLES_HEADER_DEFINED
+
+#include "Engine.h"
+#include "newton/World.h"
+
+namespace engine {
+
+  //! Edge of the cells a breakable prop is cut into (irrlicht units).
+  //! Props that would get more than BREAKABLE_MAX_PIECES pieces get bigger cells.
+  const irr::f32 BREAKABLE_PIECE_SIZE = 12.f;
+  const irr::u32 BREAKABLE_MAX_PIECES = 27;
+
+  //! Pieces cut from a single sided face are given this thickness
+  const irr::f32 BREAKABLE_MIN_THICKNESS = 0.5f;
+
+  //! Hits a piece takes before it breaks off
+  const irr::u32 BREAKABLE_PIECE_HITS = 2;
+
+  //! Pieces this near to the hit are damaged too (the nearest one always is)
+  const irr::f32 BREAKABLE_HIT_RADIUS = 8.f;
+
+  //! Speed a piece is knocked off with along the shot (irrlicht units per second)
+  const irr::f32 BREAKABLE_DEBRIS_SPEED = 96.f;
+
+  //! Mass of a piece: Newton volume of its hull times the density, clamped
+  const irr::f32 BREAKABLE_DENSITY = 400.f;
+  const irr::f32 BREAKABLE_MIN_MASS = 0.5f;
+  const irr::f32 BREAKABLE_MAX_MASS = 40.f;
+
+  //! Debris bodies simulated at once, a piece beyond that recycles the oldest one
+  const irr::u32 BREAKABLE_DEBRIS_POOL = 32;
+
+  //! Seconds a piece has to rest before it is frozen, and simulated at most
+  const irr::f32 BREAKABLE_SETTLE_TIME = 0.5f;
+  const irr::f32 BREAKABLE_MAX_TIME = 6.f;
+
+  //! A piece rests below these speeds (irrlicht units and radians per second)
+  const irr::f32 BREAKABLE_REST_SPEED = 8.f;
+  const irr::f32 BREAKABLE_REST_OMEGA = 1.f;
+
+  //! Seconds a broken off piece stays in the level
+  const irr::f32 BREAKABLE_DEBRIS_LIFETIME = 20.f;
+
+  const irr::u32 BREAKABLE_FILE_VERSION = 1;
+
+  //! Piece of a breakable prop, everything but the damage is cooked
+  struct SBreakablePiece
+  {
+    //! Geometry in the space of the prop, cut from the prop's mesh buffers
+    irr::scene::SMesh *Mesh;
+
+    //! Buffer of the prop every buffer of the mesh was cut from
+    irr::core::array<irr::u32> Buffers;
+
+    //! Convex hull of the geometry (Newton units, space of the prop). The
+    //! prop's compound and the debris body share it.
+    NewtonCollision *Hull;
+
+    irr::core::vector3df Center;
+
+    irr::f32 Mass;
+
+    //! Pieces of the neighbouring cells
+    irr::core::array<irr::u32> Neighbours;
+
+    //! Piece of the bottom cells, it holds up the pieces connected to it
+    bool Anchored;
+
+    irr::u32 Hits;
+
+    bool Broken;
+  };
+
+  //! Level node named with the -b parameter
+  struct SBreakableProp
+  {
+    irr::scene::IMeshSceneNode *Node;
+
+    //! Static body, its collision is a compound of the hulls of the whole pieces
+    physics::CBody *Body;
+
+    irr::core::array<SBreakablePiece> Pieces;
+
+    //! Whole pieces drawn by the node once a piece broke off
+    irr::scene::SMesh *Remaining;
+
+    irr::u32 BrokenCount;
+  };
+
+  //! Pooled body and node of a broken off piece
+  struct SDebris
+  {
+    NewtonBody *Body;
+
+    irr::scene::IMeshSceneNode *Node;
+
+    irr::f32 Age;
+    irr::f32 RestTime;
+
+    bool Used;
+
+    //! Resting: the body is static where the piece lies, it still collides
+    //! until the pool recycles it
+    bool Frozen;
+  };
+
+  //! Breakable and destructible props (fences, sandbags, crates).
+  //! The props are cut into cells when the level is loaded for the first time
+  //! and the pieces, their hulls and how they hold together are cooked next to
+  //! the level like the navigation mesh. A prop collides with a compound of the
+  //! hulls of its whole pieces. Hits break pieces off, together with the pieces
+  //! nothing holds up anymore, and they fall as debris from a fixed pool of
+  //! bodies that is frozen once it rests and culled after a while.
+  class CBreakableManager
+  {
+  public:
+
+    CBreakableManager(CCore * core);
+
+    ~CBreakableManager();
+
+    //! Body of a breakable level node. It gets its collision in build().
+    physics::CBody *addProp(irr::scene::IMeshSceneNode *node, irr::u32 bodyID);
+
+    //! Load the pieces cooked in the file, or cut the props and cook it
+    void build(const irr::io::path& file);
+
+    //! Damage the pieces of the prop around the position. Returns false when
+    //! the body belongs to no breakable prop.
+    bool hit(physics::CBody *body, const irr::core::vector3df& position, const irr::core::vector3df& direction);
+
+    //! Move the debris nodes, freeze the resting debris and cull the old one
+    void update(irr::f32 time);
+
+    //! Forget the props and destroy the debris pool (the level is being cleared)
+    void clear();
+
+    irr::u32 getPropCount() { return m_Props.size(); }
+
+    //! Debris being simulated and frozen in place
+    irr::u32 getSimulatedCount() { return m_Simulated; }
+    irr::u32 getFrozenCount() { return m_Frozen; }
+
+  private:
+
+    //! Cut the prop's geometry into cells, a piece per cell that has any
+    void fracture(SBreakableProp& prop, irr::u32 seed);
+
+    //! Convex hull of the piece's vertices, or of the vertices pushed apart
+    //! when they lie in a plane
+    NewtonCollision *createHull(const SBreakablePiece& piece);
+
+    //! Materials of the prop node, mass and hardware mapping of the pieces
+    void setupPieces(SBreakableProp& prop);
+
+    irr::u32 getChecksum();
+
+    bool load(const irr::io::path& file, irr::u32 checksum);
+
+    void save(const irr::io::path& file, irr::u32 checksum);
+
+    //! Set the prop's compound and mesh to its whole pieces
+    void updateProp(SBreakableProp& prop);
+
+    void createPool();
+
+    //! Free debris of the pool, the oldest debris is culled when there is none
+    irr::u32 getFreeDebris();
+
+    void spawnDebris(SBreakableProp& prop, irr::u32 piece, const irr::core::vector3df& velocity);
+
+    void freeze(SDebris& debris);
+
+    void cull(SDebris& debris);
+
+    CCore * Core;
+
+    irr::core::array<SBreakableProp> m_Props;
+
+    irr::core::array<SDebris> m_Pool;
+
+    NewtonCollision *m_NullCollision;
+
+    irr::u32 m_Simulated, m_Frozen;
+  };
+
+}
+
+#endif
@@ -50,7 +50,7 @@ namespace engine {
 
     irr::f32 headBobY, headBobX, objectBobY, objectBobX;
 
-    irr::f32 shadowValue, shakeValue, shakeValueTarget;
+    irr::f32 shakeValue, shakeValueTarget;
 
     irr::f32 tilt, roll, distanceToWall;
 
@@ -104,8 +104,6 @@ namespace engine {
 
     irr::scene::IMeshSceneNode *getFPSViewObjectNode() { return FPSViewObject; }
 
-    irr::f32 getShadow() { return shadowValue; }
-
     bool isWeaponAimedCloseUp() { return weaponCloseUpAim; }
 
     void toggleWeaponCloseUpAim();
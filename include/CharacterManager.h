@@ -12,6 +12,7 @@ namespace game {
   public:
 
     friend class CPlayer;
+    friend class CBot;
 
     CCharacterManager(CGame * game)
     {
@@ -32,6 +33,9 @@ namespace game {
 
     CBot * createBot(engine::SCharacterCreationParameters parameters);
 
+    //! Update all bots
+    void update();
+
     //! Get the player
     CPlayer * getPlayer() { return m_Player; }
 
@@ -11,6 +11,12 @@
 //#define SOUND_IRRKLANG
 #define SOUND_CAUDIO
 
+// RENDERING
+// Test 4 bounding boxes at a time when culling
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #define CULLING_SSE
+#endif
+
 // PATHFINDING
 #define MICROPATHER
 
@@ -20,6 +20,9 @@ namespace engine {
   {
   private:
 
+    // Worker threads shared by physics, culling and grass
+    CJobManager *Jobs;
+
     // Class containing the Irrlicht renderer
     CRenderer *Renderer;
 
@@ -47,14 +50,26 @@ namespace engine {
 
     CTimer * Timer;
 
+    // Snapshot replication, idle unless started from the command line
+    CNetworkManager *Network;
+
+    // Second endpoint connected to Network through the loopback transport (-loopback)
+    CNetworkManager *LoopbackClient;
+
     bool bIsRunning, requestAppClose;
 
     bool b_Paused;
 
+    // Dedicated simulation, no window and nothing is rendered
+    bool b_Headless;
+
+    // Clock advanced by simulate(), in seconds
+    irr::f64 m_SimulatedTime;
+
   public:
 
     // Constructor
-    CCore() { b_Paused = false; }
+    CCore() { b_Paused = false; b_Headless = false; m_SimulatedTime = 0.0; LoopbackClient = (CNetworkManager*)NULL; Jobs = (CJobManager*)NULL; }
 
     // Destructor
     ~CCore();
@@ -66,11 +81,20 @@ namespace engine {
 
     void close();
 
+    //! Start the server/client from -server, -connect and -loopback
+    void initNetwork();
+
     void requestClose() { requestAppClose = true; }
 
+    bool isCloseRequested() { return requestAppClose; }
+
     void update();
     void render();
 
+    //! Advance level objects, timers and physics by one fixed tick.
+    //! Used instead of update()/render() in headless mode.
+    void simulate(irr::f32 tick);
+
     // Application is closed when the current frame is finished.
     void finalizeUpdate();
 
@@ -85,6 +109,9 @@ namespace engine {
     CAtmosphereManager *GetAtmo() { return AtmoManager; }
     CCamera *getCamera() { return Camera; }
     CTimer *getTimer() { return Timer; }
+    CNetworkManager *getNetwork() { return Network; }
+    CNetworkManager *getLoopbackClient() { return LoopbackClient; }
+    CJobManager *getJobs() { return Jobs; }
 
     // Is the main cycle running?
     bool isRunning(){ return bIsRunning; }
@@ -93,6 +120,8 @@ namespace engine {
 
     bool isPaused() { return b_Paused; }
 
+    bool isHeadless() { return b_Headless; }
+
     struct STime
     {
         irr::f32 delta;
@@ -0,0 +1,166 @@
+#ifndef CULLING_HEADER_DEFINED
+#define CULLING_HEADER_DEFINED
+
+#include "Engine.h"
+#include "Jobs.h"
+
+namespace engine {
+
+  //! Boxes per BVH leaf
+  const irr::u32 CULL_LEAF_SIZE = 8;
+
+  //! Below this many boxes to test in a frame, all tests run on the render thread
+  const irr::u32 CULL_PARALLEL_THRESHOLD = 4096;
+
+  //! World space boxes as center/extent, one array per component.
+  //! Sizes are padded to a multiple of 4 so they can be tested 4 at a time.
+  struct SCullBoxes
+  {
+    irr::core::array<irr::f32> CenterX, CenterY, CenterZ;
+    irr::core::array<irr::f32> ExtentX, ExtentY, ExtentZ;
+
+    irr::u32 Count;
+
+    SCullBoxes() : Count(0) {}
+
+    void clear();
+
+    //! Resize to count boxes (and padding)
+    void resize(irr::u32 count);
+
+    void set(irr::u32 index, const irr::core::aabbox3df& box);
+  };
+
+  struct SCullBVHNode
+  {
+    irr::core::aabbox3df Box;
+
+    //! Inner node: index of the first child, the second follows it.
+    //! Leaf: first box.
+    irr::u32 First;
+
+    //! Boxes in a leaf, 0 for inner nodes
+    irr::u32 Count;
+  };
+
+  //! Copy the frustum planes as 4 floats each (normal and distance)
+  void getCullPlanes(const irr::scene::SViewFrustum& frustum, irr::f32 *planes);
+
+  //! Test boxes [first, first+count) against the planes from getCullPlanes(),
+  //! write the indices of the visible ones into out
+  void testCullBoxes(const irr::f32 *planes, const SCullBoxes& boxes,
+    irr::u32 first, irr::u32 count, irr::core::array<irr::u32>& out);
+
+  //! Range of boxes to test against the frustum
+  struct SCullRange
+  {
+    irr::u32 First, Count;
+  };
+
+  class CCullingManager;
+
+  //! Ranges tested by one job and the visible boxes it found
+  struct SCullJob
+  {
+    CCullingManager *Manager;
+
+    irr::core::array<SCullRange> Ranges;
+    irr::core::array<irr::u32> Results;
+  };
+
+  //! Frustum culling of level geometry.
+  //! Static nodes are kept as world space boxes in flat arrays sorted under a BVH,
+  //! dynamic nodes have their boxes refreshed every frame. The managed nodes are
+  //! taken out of the normal scene traversal (Irrlicht's per node isCulled()):
+  //! a proxy node registers only the nodes that passed the test.
+  class CCullingManager
+  {
+  public:
+
+    CCullingManager(CCore * core);
+
+    ~CCullingManager();
+
+    void update(irr::f32);
+
+    //! Node that never moves. Returns false when the node can't be
+    //! managed (it has children or isn't a child of the scene root).
+    bool addStaticNode(irr::scene::ISceneNode *node);
+
+    //! Moving node, its box is read every frame
+    bool addDynamicNode(irr::scene::ISceneNode *node);
+
+    //! Forget all nodes (the scene is being cleared)
+    void clear();
+
+    //! Test every node against the frustum of the camera and fill the visible list.
+    //! Called by the proxy node when the scene registers its nodes for rendering.
+    void cull(const irr::scene::SViewFrustum& frustum);
+
+    //! Nodes that passed the last cull()
+    const irr::core::array<irr::scene::ISceneNode*>& getVisibleNodes() { return m_Visible; }
+
+    const irr::core::array<irr::scene::ISceneNode*>& getStaticNodes() { return m_StaticNodes; }
+
+    const irr::core::array<irr::scene::ISceneNode*>& getDynamicNodes() { return m_DynamicNodes; }
+
+    irr::u32 getNodeCount() { return m_StaticNodes.size() + m_DynamicNodes.size(); }
+
+    //! Boxes tested one by one in the last cull (not accepted or rejected by the BVH)
+    irr::u32 getTestedCount() { return m_Tested; }
+
+    irr::u32 getCullMicroseconds() { return m_CullTime; }
+
+    //! Test the ranges of a job, called on the job threads
+    void testJob(SCullJob *job);
+
+  private:
+
+    void build();
+
+    irr::u32 buildNode(irr::u32 nodeIndex, irr::u32 first, irr::u32 count,
+      irr::core::array<irr::u32>& order, const irr::core::array<irr::core::aabbox3df>& boxes);
+
+    //! Test boxes [first, first+count) against the current frustum planes,
+    //! write the indices of the visible ones into out
+    void testRange(const SCullBoxes& boxes, irr::u32 first, irr::u32 count, irr::core::array<irr::u32>& out);
+
+    irr::scene::ISceneNode *getProxy();
+
+    CCore * Core;
+
+    // Proxy in the scene graph, parent of all managed nodes
+    irr::scene::ISceneNode *m_Proxy;
+
+    irr::core::array<irr::scene::ISceneNode*> m_StaticNodes;
+    irr::core::array<irr::scene::ISceneNode*> m_DynamicNodes;
+
+    // Static boxes in BVH leaf order, m_StaticOrder maps them back to nodes
+    SCullBoxes m_StaticBoxes;
+    irr::core::array<irr::u32> m_StaticOrder;
+    irr::core::array<SCullBVHNode> m_BVH;
+
+    SCullBoxes m_DynamicBoxes;
+
+    // Static nodes were added since the BVH was built
+    bool b_Dirty;
+
+    // Frustum planes of the current cull, 4 floats each (normal and distance)
+    irr::f32 m_Planes[irr::scene::SViewFrustum::VF_PLANE_COUNT * 4];
+
+    // Ranges left for the box tests by the BVH traversal
+    irr::core::array<SCullRange> m_StaticRanges;
+
+    irr::core::array<irr::scene::ISceneNode*> m_Visible;
+
+    irr::u32 m_Tested;
+    irr::u32 m_CullTime;
+
+    // Static box tests split over the job threads, job 0 runs on the render thread
+    irr::core::array<SCullJob*> m_Jobs;
+    SJobCounter m_JobCounter;
+  };
+
+}
+
+#endif
@@ -13,6 +13,9 @@ namespace engine {
     EDS_CLOSING
   };
 
+  //! Sliding speed of the door leaves (units per second)
+  const irr::f32 DOOR_SPEED = 5.f;
+
   class CDoor
   {
   public:
@@ -23,6 +26,7 @@ namespace engine {
       a_ActivationPoints.set_used(0);
       b_Automatic = false;
       b_Locked = false;
+      m_State = EDS_CLOSED;
     }
 
     ~CDoor()
@@ -41,6 +41,10 @@ class CVehicleManager;
 class CDoor;
 class CAtmosphereManager;
 class CTerrainNode;
+class CNetworkManager;
+struct SNetInput;
+class CPathfinder;
+class CJobManager;
 
 #ifdef GRASS_2
 class CGrassSceneNode;
@@ -172,6 +176,9 @@ enum E_CHARACTER_STATES
 
   const irr::f32 MAX_CHARACTER_FALLING_SPEED = 30.0f;
 
+  // Seconds a dead character waits before it respawns
+  const irr::f32 CHARACTER_RESPAWN_DELAY = 5.0f;
+
   const irr::core::vector3df UPRIGHT_SCALE = irr::core::vector3df(1, 1, 1);
 
   const irr::core::vector3df CROUCH_SCALE = irr::core::vector3df(1, 0.50f, 1);
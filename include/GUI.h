@@ -72,6 +72,9 @@ namespace game {
 
     irr::video::ITexture *textures[TEX_COUNT];
 
+    // Sprite ids of the images drawn through the sprite batcher, -1 if not loaded
+    irr::s32 sprites[TEX_COUNT];
+
     irr::core::array<irr::gui::IGUIFont*> fonts;
 
     irr::core::dimension2d<irr::u16> screenSize;
@@ -48,6 +48,17 @@ namespace game {
 
     void playSurfaceHitSound(E_BODY_MATERIAL_TYPE material, irr::core::vector3df &position);
 
+#ifdef PHYSICS_NEWTON
+    //! Response to a bullet or round hitting the body: breakable pieces,
+    //! bullet hole decal, debris particles and the surface sound
+    void createBulletHit(
+      engine::physics::CBody *body,
+      irr::core::vector3df hitPosition,
+      irr::core::vector3df hitNormal,
+      const irr::core::vector3df& direction,
+      bool decal);
+#endif
+
     void createSurfaceHitParticles(
       const irr::c8* particle_texture_file,
       irr::core::vector3df position,
@@ -78,6 +89,9 @@ namespace game {
 
     void updateGUI();
 
+    //! Main loop of the headless mode. Fixed tick, no rendering, prints ticks/sec.
+    void runHeadless();
+
     void checkPlayerInteractions();
 
     void loadInventoryObjects();
@@ -147,6 +147,10 @@ namespace game {
   {
     SWeaponParameters()
     {
+      // Rounds of projectile launchers: 200 m/s, no drag
+      muzzleVelocity = 6400.f;
+      drag = 0.f;
+
       fireSounds.set_used(0);
       reloadSounds.set_used(0);
     }
@@ -171,6 +175,11 @@ namespace game {
 
     irr::f32 fireRange;
 
+    //! Projectile launchers only: speed of the round leaving the muzzle
+    //! (irrlicht units per second) and its drag (1/irrlicht units)
+    irr::f32 muzzleVelocity;
+    irr::f32 drag;
+
     // First person
     irr::core::stringc f_mesh;
     irr::core::stringc f_muzzle;
@@ -334,12 +343,25 @@ namespace game {
     EMMT_IN_GAME
   };
 
+  //! Menu images drawn through the sprite batcher
+  enum E_MENU_SPRITES
+  {
+    EMS_BACKGROUND = 0,
+    EMS_BOTTOM_MAIN,
+    EMS_BOTTOM,
+    EMS_TOP,
+    EMS_COUNT
+  };
+
   struct SMainMenuData
   {
     irr::core::array<irr::video::ITexture*> texture;
 
+    irr::core::array<irr::s32> sprite;
+
     SMainMenuData(){
       texture.set_used(0);
+      sprite.set_used(0);
       skirmish_level_index = 0;
     }
 
@@ -2,9 +2,21 @@
 #define CGRASSSCENENODE_H
 
 #include "Engine.h"
+#include "Jobs.h"
 
 namespace engine {
 
+  class CGrassSceneNode;
+
+  //! Elements of one patch that pass the camera checks this frame
+  struct SGrassJob
+  {
+    CGrassSceneNode *Node;
+    SFoilageGroup *Patch;
+
+    irr::core::array<irr::core::matrix4> Transforms;
+  };
+
   class CGrassSceneNode : public irr::scene::ISceneNode
   {
   public:
@@ -71,6 +83,12 @@ namespace engine {
 
     void setIsDestCheck(bool b) { b_DistCheckEnabled = b; }
 
+    //! Patches are checked on the job threads, NULL checks them while rendering
+    void setJobs(CJobManager *jobs) { m_Jobs = jobs; }
+
+    //! Fill the transformations of the visible elements of the job's patch
+    void buildPatch(SGrassJob *job);
+
   private:
 
     irr::core::aabbox3d<irr::f32> Box;
@@ -86,6 +104,16 @@ namespace engine {
     irr::u32 m_ClosestPatchIndex;
 
     bool b_DistCheckEnabled;
+
+    CJobManager *m_Jobs;
+
+    // One job per patch drawn, reused every frame
+    irr::core::array<SGrassJob*> m_PatchJobs;
+    SJobCounter m_JobCounter;
+
+    // Camera of the frame the jobs check against
+    irr::core::vector3df m_CameraPosition;
+    irr::core::aabbox3df m_CameraBox;
   };
 
 }
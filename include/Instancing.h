@@ -0,0 +1,122 @@
+#ifndef INSTANCING_HEADER_DEFINED
+#define INSTANCING_HEADER_DEFINED
+
+#include "Engine.h"
+#include "Culling.h"
+
+namespace engine {
+
+  //! Copies of a mesh needed before its nodes are drawn instanced
+  const irr::u32 INSTANCE_MIN_COUNT = 4;
+
+  //! Detail levels of an instanced mesh, the first is the full mesh
+  const irr::u32 INSTANCE_MAX_LODS = 4;
+
+  //! Bytes kept per instance (its transformation)
+  const irr::u32 INSTANCE_TRANSFORM_SIZE = 16 * sizeof(irr::f32);
+
+  //! Static nodes sharing one mesh and material
+  struct SInstanceGroup
+  {
+    //! Mesh of every detail level and the camera distance it starts at
+    irr::scene::IMesh *Lods[INSTANCE_MAX_LODS];
+    irr::f32 LodDistances[INSTANCE_MAX_LODS];
+    irr::u32 LodCount;
+
+    //! Hidden nodes, they keep their physics bodies and names
+    irr::core::array<irr::scene::ISceneNode*> Nodes;
+
+    irr::core::array<irr::core::matrix4> Transforms;
+
+    //! World space box of every instance and of the whole group
+    SCullBoxes Boxes;
+    irr::core::aabbox3df Box;
+
+    //! Transformations of the instances that passed the last cull, per detail level
+    irr::core::array<irr::core::matrix4> Visible[INSTANCE_MAX_LODS];
+  };
+
+  //! Instanced rendering of repeated level props.
+  //! Static nodes using the same mesh are hidden and replaced by a group:
+  //! the mesh stays in memory (and in a hardware buffer) once, the instances
+  //! are culled here and every mesh buffer of every detail level is drawn with
+  //! one instanced call. Drivers without instancing draw the copies one by one.
+  class CInstancingManager
+  {
+  public:
+
+    CInstancingManager(CCore * core);
+
+    ~CInstancingManager();
+
+    //! Static mesh node that can be drawn as an instance of its mesh,
+    //! with materials the driver draws instanced in one call
+    bool canInstance(irr::scene::IMeshSceneNode *node);
+
+    //! Hide the nodes (same mesh and materials) and draw them as one group.
+    //! Returns the group index.
+    irr::u32 addGroup(const irr::core::array<irr::scene::IMeshSceneNode*>& nodes);
+
+    //! Lower detail mesh of a group, used from distance on. Levels are added
+    //! in increasing distance.
+    bool addLod(irr::u32 group, irr::scene::IMesh *mesh, irr::f32 distance);
+
+    //! Forget all groups (the scene is being cleared)
+    void clear();
+
+    //! Print memory and draw calls saved in the current level
+    void printReport();
+
+    //! Test every instance against the frustum and pick its detail level.
+    //! Called by the proxy node when the scene registers its nodes for rendering.
+    void cull(const irr::scene::SViewFrustum& frustum, const irr::core::vector3df& cameraPosition);
+
+    //! Draw the visible instances of the solid or transparent groups
+    void render(bool transparent);
+
+    irr::u32 getGroupCount() { return m_Groups.size(); }
+
+    SInstanceGroup *getGroup(irr::u32 index) { return m_Groups[index]; }
+
+    irr::u32 getInstanceCount() { return m_InstanceCount; }
+
+    //! Instances that passed the last cull
+    irr::u32 getVisibleCount() { return m_Visible; }
+
+    //! Draw calls of the last frame, one per copy for buffers the driver couldn't instance
+    irr::u32 getDrawCallCount() { return m_LastDrawCalls; }
+
+    //! Buffer copies of the last frame that were drawn with an instanced call
+    irr::u32 getInstancedCount() { return m_LastInstanced; }
+
+    //! Some visible instance has a transparent material
+    bool hasTransparentInstances() { return b_Transparent; }
+
+  private:
+
+    irr::scene::ISceneNode *getProxy();
+
+    CCore * Core;
+
+    // Proxy in the scene graph, registers the groups for rendering
+    irr::scene::ISceneNode *m_Proxy;
+
+    irr::core::array<SInstanceGroup*> m_Groups;
+
+    irr::f32 m_Planes[irr::scene::SViewFrustum::VF_PLANE_COUNT * 4];
+
+    irr::core::array<irr::u32> m_Passed;
+
+    irr::u32 m_InstanceCount;
+    irr::u32 m_Visible;
+
+    bool b_Transparent;
+
+    // Counted this frame / shown for the last frame
+    irr::u32 m_DrawCalls, m_LastDrawCalls;
+    irr::u32 m_Instanced, m_LastInstanced;
+  };
+
+}
+
+#endif
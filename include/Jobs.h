@@ -0,0 +1,110 @@
+#ifndef JOBS_HEADER_DEFINED
+#define JOBS_HEADER_DEFINED
+
+#include "Engine.h"
+
+namespace engine {
+
+  //! Threads running jobs at most, the thread calling wait() included
+  const irr::u32 JOB_MAX_THREADS = 16;
+
+  //! Jobs a queue holds, a full queue runs new jobs on the submitting thread
+  const irr::u32 JOB_QUEUE_SIZE = 1024;
+
+  //! Job entry point. Thread is the index of the thread running it,
+  //! 0 for the thread that created the manager (and any other non worker).
+  typedef void (*JobFunction)(void *data, irr::u32 thread);
+
+  //! Jobs of a batch still queued or running, wait() returns when it reaches 0
+  struct SJobCounter
+  {
+    volatile irr::s32 Pending;
+
+    SJobCounter() : Pending(0) {}
+  };
+
+  struct SJob
+  {
+    JobFunction Function;
+    void *Data;
+    SJobCounter *Counter;
+  };
+
+  struct SJobThreads;
+
+  //! Work stealing job scheduler shared by the whole engine.
+  //! Every thread owns a queue: it pushes and pops its own jobs at the back
+  //! (the most recent, still in cache) and idle threads steal from the front
+  //! of the other queues. Workers with nothing to run or steal sleep until a
+  //! job is submitted. Physics (Newton's jobs), culling, grass, Burning's Video
+  //! tiles and path requests all submit here, so the cores are never shared by
+  //! several private thread pools.
+  //! Background jobs (path requests) may run for several frames. They wait in
+  //! a queue of their own that only idle workers take from, so wait() never
+  //! picks one up and a frame never waits for them.
+  class CJobManager
+  {
+  public:
+
+    CJobManager();
+
+    ~CJobManager();
+
+    //! Start the workers. 0 runs every job on the thread that waits for it.
+    void start(irr::u32 workers);
+
+    //! Join the workers, queued jobs are run first
+    void stop();
+
+    //! Queue a job, the counter is incremented until it has run
+    void submit(JobFunction function, void *data, SJobCounter *counter);
+
+    //! Queue a job that may outlast the frame, it's run by an idle worker.
+    //! Without workers it's run right away on the calling thread.
+    void submitBackground(JobFunction function, void *data, SJobCounter *counter);
+
+    //! Run and steal jobs until the counter reaches 0
+    void wait(SJobCounter *counter);
+
+    //! Worker threads, not counting the thread that waits
+    irr::u32 getWorkerCount();
+
+    //! Threads that can run jobs at once, worth splitting work in this many parts
+    irr::u32 getThreadCount() { return getWorkerCount() + 1; }
+
+    //! Logical processors of the machine
+    static irr::u32 getProcessorCount();
+
+    //! Copy the counters of the last frame
+    void update();
+
+    //! Jobs run and taken from another thread's queue in the last frame
+    irr::u32 getJobCount() { return m_LastJobs; }
+    irr::u32 getStolenCount() { return m_LastStolen; }
+
+    //! Worker thread loop
+    void serveJobs(irr::u32 thread);
+
+  private:
+
+    //! Queue of the calling thread
+    irr::u32 getThreadIndex();
+
+    //! Take a job from the back of the own queue or the front of another one
+    bool takeJob(irr::u32 thread, SJob& job);
+
+    //! Take the oldest background job
+    bool takeBackgroundJob(SJob& job);
+
+    void runJob(const SJob& job, irr::u32 thread);
+
+    SJobThreads *m_Threads;
+
+    volatile irr::s32 m_Jobs, m_Stolen;
+
+    irr::u32 m_LastJobs, m_LastStolen;
+  };
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef LIGHTS_HEADER_DEFINED
+#define LIGHTS_HEADER_DEFINED
+
+#include "Engine.h"
+
+namespace engine {
+
+  //! Lights shaded in one frame, the rest (farthest first) are dropped
+  const irr::u32 LIGHT_MAX = 256;
+
+  //! Screen tile size in pixels, doubled on screens with more tiles than the grid holds
+  const irr::u32 LIGHT_TILE_SIZE = 32;
+
+  //! Tiles per row and column of the tile texture
+  const irr::u32 LIGHT_GRID_SIZE = 64;
+
+  //! Lights a single tile can shade
+  const irr::u32 LIGHT_TILE_MAX = 64;
+
+  //! Light indices of all tiles together, 4 per texel of a 64x64 texture
+  const irr::u32 LIGHT_INDEX_CAPACITY = 64 * 64 * 4;
+
+  //! View space positions are stored as 16 bit fixed point in +-LIGHT_ENCODE_RANGE
+  const irr::f32 LIGHT_ENCODE_RANGE = 1024.f;
+
+  //! Largest radius and intensity the light texture can hold
+  const irr::f32 LIGHT_MAX_RADIUS = 256.f;
+  const irr::f32 LIGHT_MAX_INTENSITY = 4.f;
+
+  //! Fixed function lights, given to the lights nearest to the camera
+  const irr::u32 LIGHT_FORWARD_MAX = 8;
+
+  //! Point light. Transient lights (muzzle flashes) fade out over their life time.
+  struct SDynamicLight
+  {
+    irr::u32 Id;
+
+    irr::core::vector3df Position;
+    irr::video::SColorf Color;
+    irr::f32 Radius;
+    irr::f32 Intensity;
+
+    //! 0 for lights that stay until they are removed
+    irr::f32 LifeTime;
+    irr::f32 Age;
+  };
+
+  //! Tiled deferred lighting of point lights.
+  //! The fixed function light list can't take more than 8 lights per object,
+  //! so dynamic lights are shaded after the solid pass instead. While there are
+  //! lights the scene is drawn into a color target with two G-buffer targets
+  //! beside it: the material shaders (terrain, lightmaps, grass, view object)
+  //! write view normal and depth, albedo as their second and third output.
+  //! Fixed function materials leave the depth positive, the deferred pass
+  //! skips those pixels. Lit fixed function materials (characters, props) get
+  //! the nearest lights through the fixed function lights instead. The lights are binned into screen tiles on the CPU and one full
+  //! screen pass adds the lights of each pixel's tile. The cost grows with the
+  //! lit pixels and not with lights times objects.
+  class CLightManager
+  {
+  public:
+
+    CLightManager(CCore * core);
+
+    ~CLightManager();
+
+    //! Create the G-buffer, data textures and shaders. Returns false when
+    //! the driver can't run them, lights are ignored then.
+    bool init();
+
+    //! Add a light, returns its id. A life time of 0 keeps the light until removeLight().
+    irr::u32 addLight(const irr::core::vector3df& position, const irr::video::SColorf& color,
+      irr::f32 radius, irr::f32 lifeTime = 0.f, irr::f32 intensity = 1.f);
+
+    void removeLight(irr::u32 id);
+
+    void setLightPosition(irr::u32 id, const irr::core::vector3df& position);
+
+    //! Age the transient lights, drop the expired ones and place the fixed function lights
+    void update(irr::f32 time);
+
+    //! Remove all lights (the scene is being cleared)
+    void clear();
+
+    //! Bind the scene and G-buffer targets before the scene is drawn.
+    //! Returns false when there's nothing to light, the frame is drawn as usual.
+    bool beginFrame();
+
+    //! Shade the lights into the scene target, the rest of the scene follows there.
+    //! Called by the proxy node after the solid nodes are drawn.
+    void render();
+
+    //! Copy the scene target to the frame buffer after the scene is drawn
+    void endFrame();
+
+    bool isEnabled() { return m_GBuffer[0] != NULL; }
+
+    irr::u32 getLightCount() { return m_Lights.size(); }
+
+    //! Tile size in pixels the lights are binned with
+    irr::u32 getTileSize() { return m_TileSize; }
+
+    //! Lights that were on screen in the last frame
+    irr::u32 getVisibleCount() { return m_Visible; }
+
+    //! Tiles with at least one light in the last frame
+    irr::u32 getLitTileCount() { return m_LitTiles; }
+
+  private:
+
+    irr::scene::ISceneNode *getProxy();
+
+    //! Project the lights, fill the tile lists and the data textures
+    void binLights();
+
+    void renderLighting();
+
+    //! Move the fixed function lights to the lights nearest to the camera
+    void updateForwardLights();
+
+    CCore * Core;
+
+    // Proxy in the scene graph, registered in the shadow pass (after the solid nodes)
+    irr::scene::ISceneNode *m_Proxy;
+
+    irr::core::array<SDynamicLight> m_Lights;
+
+    // Light scene nodes of the fixed function materials, hidden when unused
+    irr::scene::ILightSceneNode *m_ForwardLights[LIGHT_FORWARD_MAX];
+
+    irr::u32 m_NextId;
+
+    // View normal and depth, albedo
+    irr::video::ITexture *m_GBuffer[2];
+
+    // Color of the scene while the G-buffer is written, sharing its depth buffer
+    irr::video::ITexture *m_Scene;
+
+    // Scene, normal and depth, albedo: the outputs of the material shaders
+    irr::core::array<irr::video::IRenderTarget> m_Targets;
+
+    // The frame is drawn into the scene target
+    bool m_Active;
+
+    // Offset and count of every tile, light indices, light parameters
+    irr::video::ITexture *m_TileTexture, *m_IndexTexture, *m_LightTexture;
+
+    irr::video::SMaterial m_LightingMaterial;
+
+    irr::u32 m_TileSize, m_TilesX, m_TilesY;
+
+    // Lights on screen this frame and the tile rectangle they cover
+    irr::core::array<irr::u32> m_VisibleLights;
+    irr::core::array<irr::core::rect<irr::s32> > m_LightTiles;
+
+    // Lights and first index of every tile (both are used up while the index list is filled)
+    irr::core::array<irr::u32> m_TileCounts, m_TileOffsets;
+
+    irr::u32 m_Visible;
+    irr::u32 m_LitTiles;
+  };
+
+}
+
+#endif
@@ -0,0 +1,484 @@
+#ifndef NETWORK_HEADER_DEFINED
+#define NETWORK_HEADER_DEFINED
+
+#include "Engine.h"
+
+namespace engine {
+
+  const irr::u16 NET_DEFAULT_PORT = 27960;
+
+  //! Packets never get bigger than this (fits in one ethernet frame)
+  const irr::u32 NET_MAX_PACKET_SIZE = 1400;
+
+  //! Sent snapshots kept per client (and received snapshots kept on the client).
+  //! Acks older than this fall back to a full snapshot.
+  const irr::u32 NET_SNAPSHOT_HISTORY = 32;
+
+  const irr::u32 NET_MAX_CLIENTS = 16;
+
+  //! Seconds without a packet before the other side is dropped
+  const irr::f32 NET_TIMEOUT = 5.f;
+
+  //! Seconds between connection attempts
+  const irr::f32 NET_CONNECT_RETRY = 0.5f;
+
+  //! Snapshots per second sent by the server
+  const irr::u32 NET_SEND_RATE = 20;
+
+  //! Entities further than this from the client's character are not sent
+  const irr::f32 NET_INTEREST_RADIUS = 200.f;
+
+  const irr::u32 NET_PROTOCOL_ID = 0x46573031;
+
+  /*
+    Quantization of the entity state
+  */
+
+  //! Steps per world unit and bits of a position component (about +-32000 units)
+  const irr::f32 NET_POSITION_PRECISION = 64.f;
+  const irr::u32 NET_POSITION_BITS = 22;
+
+  //! Position changes smaller than this many steps are sent as a delta
+  const irr::u32 NET_POSITION_DELTA_BITS = 9;
+
+  const irr::u32 NET_ROTATION_BITS = 10;
+
+  //! Steps per unit/sec and bits of a velocity component
+  const irr::f32 NET_VELOCITY_PRECISION = 32.f;
+  const irr::u32 NET_VELOCITY_BITS = 14;
+
+  const irr::u32 NET_ENTITY_ID_BITS = 12;
+  const irr::u32 NET_MAX_ENTITIES = 1 << NET_ENTITY_ID_BITS;
+
+  //! Network IDs of the game's entities. They follow from what an entity
+  //! is, not from the order it was registered in, so a server without a
+  //! player and a client with one agree on every ID.
+  const irr::u16 NET_ID_PLAYER = 0;
+  const irr::u16 NET_ID_BOTS = 1;
+  const irr::u16 NET_ID_BODIES = 512;
+
+  const irr::u32 NET_TEAM_BITS = 4;
+
+  //! Worst case size of one entity in a snapshot, in bits
+  const irr::u32 NET_MAX_ENTITY_BITS = 2 + 1 + NET_ENTITY_ID_BITS + 2
+    + NET_POSITION_BITS * 3 + NET_ROTATION_BITS * 3 + NET_VELOCITY_BITS * 3 + 8 + 16 + NET_TEAM_BITS + 8;
+
+  enum E_NET_ROLE
+  {
+    ENR_NONE = 0,
+    ENR_SERVER,
+    ENR_CLIENT
+  };
+
+  enum E_NET_PACKET
+  {
+    ENP_CONNECT = 0,
+    ENP_ACCEPT,
+    ENP_REJECT,
+    ENP_SNAPSHOT,
+    ENP_ACK,
+    ENP_DISCONNECT,
+    ENP_INPUT
+  };
+
+  enum E_NET_ENTITY_TYPE
+  {
+    ENE_CHARACTER = 0,
+    ENE_BODY
+  };
+
+  struct SNetAddress
+  {
+    //! IPv4 address in host byte order
+    irr::u32 Host;
+    irr::u16 Port;
+
+    SNetAddress() : Host(0), Port(0) {}
+
+    SNetAddress(irr::u32 host, irr::u16 port) : Host(host), Port(port) {}
+
+    bool operator==(const SNetAddress& other) const { return Host == other.Host && Port == other.Port; }
+
+    bool operator!=(const SNetAddress& other) const { return !(*this == other); }
+  };
+
+  //! Writes values with any number of bits into a byte buffer
+  class CBitWriter
+  {
+  public:
+
+    CBitWriter(irr::u8 *buffer, irr::u32 size);
+
+    void write(irr::u32 value, irr::u32 bits);
+
+    void writeSigned(irr::s32 value, irr::u32 bits);
+
+    void writeBool(bool value) { write(value ? 1 : 0, 1); }
+
+    //! Bytes used so far
+    irr::u32 getBytes() { return (m_Bits + 7) / 8; }
+
+    irr::u32 getBitsLeft() { return m_Size * 8 - m_Bits; }
+
+    //! Something didn't fit, the buffer contents are not usable
+    bool isOverflow() { return b_Overflow; }
+
+  private:
+
+    irr::u8 *m_Buffer;
+
+    irr::u32 m_Size, m_Bits;
+
+    bool b_Overflow;
+  };
+
+  class CBitReader
+  {
+  public:
+
+    CBitReader(const irr::u8 *buffer, irr::u32 size);
+
+    irr::u32 read(irr::u32 bits);
+
+    irr::s32 readSigned(irr::u32 bits);
+
+    bool readBool() { return read(1) != 0; }
+
+    //! Read past the end of the packet, the packet is broken
+    bool isOverflow() { return b_Overflow; }
+
+  private:
+
+    const irr::u8 *m_Buffer;
+
+    irr::u32 m_Size, m_Bits;
+
+    bool b_Overflow;
+  };
+
+  //! Quantized state of one replicated entity
+  struct SNetEntityState
+  {
+    irr::u16 ID;
+    irr::u8 Type;
+
+    irr::s32 Position[3];
+    irr::u16 Rotation[3];
+    irr::s32 Velocity[3];
+
+    //! Health as a fraction of the maximum, 0-255
+    irr::u8 Health;
+    irr::u16 States;
+    irr::u8 Team;
+  };
+
+  //! Entities seen by one client at one point of time, sorted by ID
+  struct SNetSnapshot
+  {
+    irr::u32 Sequence;
+    bool Valid;
+
+    irr::core::array<SNetEntityState> Entities;
+
+    SNetSnapshot() : Sequence(0), Valid(false) {}
+  };
+
+  //! What a client's player does, the server moves the client's character by it
+  struct SNetInput
+  {
+    //! Direction relative to the heading, -1, 0 or 1
+    irr::s8 Forward, Right;
+
+    //! Degrees around the up axis
+    irr::f32 Heading;
+
+    bool Jump;
+
+    SNetInput() : Forward(0), Right(0), Heading(0.f), Jump(false) {}
+  };
+
+  //! Sends and receives datagrams. Never blocks.
+  class INetTransport
+  {
+  public:
+
+    virtual ~INetTransport() {}
+
+    virtual bool send(const SNetAddress& to, const irr::u8 *data, irr::u32 size) = 0;
+
+    //! Returns the packet size, 0 when nothing is waiting
+    virtual irr::u32 receive(SNetAddress& from, irr::u8 *data, irr::u32 maxSize) = 0;
+  };
+
+  class CUdpTransport : public INetTransport
+  {
+  public:
+
+    CUdpTransport();
+
+    ~CUdpTransport();
+
+    //! Bind to a port, 0 lets the system pick one (clients)
+    bool open(irr::u16 port);
+
+    void close();
+
+    bool send(const SNetAddress& to, const irr::u8 *data, irr::u32 size);
+
+    irr::u32 receive(SNetAddress& from, irr::u8 *data, irr::u32 maxSize);
+
+    //! Resolve a host name or a dotted address
+    static bool resolve(const irr::c8 *host, irr::u16 port, SNetAddress& out);
+
+  private:
+
+    irr::s32 m_Socket;
+  };
+
+  //! In-process transport. Endpoints find each other by port, so a server
+  //! and a client can run in the same process without touching the network.
+  class CLoopbackTransport : public INetTransport
+  {
+  public:
+
+    //! 0 picks a free port
+    CLoopbackTransport(irr::u16 port);
+
+    ~CLoopbackTransport();
+
+    bool send(const SNetAddress& to, const irr::u8 *data, irr::u32 size);
+
+    irr::u32 receive(SNetAddress& from, irr::u8 *data, irr::u32 maxSize);
+
+    SNetAddress getAddress() { return m_Address; }
+
+  private:
+
+    struct SPacket
+    {
+      SNetAddress From;
+      irr::core::array<irr::u8> Data;
+    };
+
+    SNetAddress m_Address;
+
+    irr::core::list<SPacket> m_Queue;
+  };
+
+  //! Per second counters
+  struct SNetStats
+  {
+    irr::u32 BytesSent, BytesReceived;
+    irr::u32 PacketsSent, PacketsReceived;
+
+    irr::u32 FullSnapshots, DeltaSnapshots;
+
+    //! Entities written into snapshots and entities left out because the packet was full
+    irr::u32 EntitiesSent, EntitiesDeferred;
+
+    //! Time spent capturing, encoding and decoding snapshots
+    irr::u32 SerializeMicroseconds, DeserializeMicroseconds;
+
+    void reset()
+    {
+      BytesSent = BytesReceived = 0;
+      PacketsSent = PacketsReceived = 0;
+      FullSnapshots = DeltaSnapshots = 0;
+      EntitiesSent = EntitiesDeferred = 0;
+      SerializeMicroseconds = DeserializeMicroseconds = 0;
+    }
+
+    SNetStats() { reset(); }
+  };
+
+  //! Snapshot replication of characters and dynamic bodies.
+  //! The server is authoritative: it sends the quantized state of the entities
+  //! near each client, delta compressed against the last snapshot that client
+  //! acknowledged. Clients overwrite their local entities with what they receive.
+  //! Every client controls one character of the server: it sends its player's
+  //! input, the server moves that character by it and sends the entities around
+  //! it. The client's player takes that character's network ID.
+  //! Both sides register their entities under the same network IDs. A client
+  //! in the server's process (-loopback) registers replicas instead, which only
+  //! keep the received state: the objects it could write to are the server's.
+  class CNetworkManager
+  {
+  public:
+
+    CNetworkManager(CCore * core);
+
+    ~CNetworkManager();
+
+    bool startServer(irr::u16 port, bool loopback=false);
+
+    bool startClient(const irr::c8 *host, irr::u16 port, bool loopback=false);
+
+    void stop();
+
+    //! Receive packets and, on the server, send snapshots at the send rate
+    void update(irr::f32 delta);
+
+    //! Register a replicated entity under its network ID. Returns false
+    //! when the ID is out of range or already taken.
+    bool addCharacter(CBaseCharacter *character, irr::u16 id);
+
+    bool addBody(physics::CBody *body, irr::u16 id);
+
+    //! Register an entity without an object on this side, clients only.
+    //! Snapshots update its state and nothing else.
+    bool addReplica(irr::u16 id, E_NET_ENTITY_TYPE type);
+
+    //! State of an entity in the last snapshot the client applied,
+    //! NULL when the snapshot left it out (outside the interest radius)
+    const SNetEntityState *getState(irr::u16 id);
+
+    //! Client: input of the player, sent to the server at the send rate
+    void setInput(const SNetInput& input);
+
+    //! Server: input of the client controlling the character. Returns false
+    //! for characters no client controls. A jump is only returned once.
+    bool getInput(CBaseCharacter *character, SNetInput& input);
+
+    void clearEntities();
+
+    void setSendRate(irr::u32 rate) { m_SendRate = rate > 0 ? rate : NET_SEND_RATE; }
+
+    void setInterestRadius(irr::f32 radius) { m_InterestRadius = radius; }
+
+    E_NET_ROLE getRole() { return m_Role; }
+
+    //! Client has been accepted by the server
+    bool isConnected() { return b_Connected; }
+
+    irr::u32 getClientCount();
+
+    irr::u32 getEntityCount() { return m_EntityCount; }
+
+    //! Counters of the last full second
+    const SNetStats& getStats() { return m_LastStats; }
+
+    //! Sequence of the newest snapshot sent (server) or applied (client)
+    irr::u32 getSequence() { return m_Sequence; }
+
+  private:
+
+    struct SNetEntity
+    {
+      //! Slot of a registered entity, the IDs in between are free
+      bool Used;
+
+      irr::u8 Type;
+      CBaseCharacter *Character;
+
+      //! NULL for replicas
+      physics::CBody *Body;
+
+      //! Client: state in the last snapshot applied
+      bool HasState;
+      SNetEntityState State;
+    };
+
+    struct SNetClient
+    {
+      bool Active;
+
+      SNetAddress Address;
+
+      //! Character the client controls, the interest area is around it.
+      //! -1 sends everything.
+      irr::s32 Focus;
+
+      bool HasInput;
+      irr::u32 InputSequence;
+      SNetInput Input;
+
+      bool HasAck;
+      irr::u32 LastAck;
+
+      irr::f32 LastReceived;
+
+      SNetSnapshot History[NET_SNAPSHOT_HISTORY];
+    };
+
+    void receivePackets();
+
+    bool addEntity(irr::u16 id, const SNetEntity& entity);
+
+    void handleServerPacket(const SNetAddress& from, CBitReader& reader, irr::u32 type);
+
+    void handleClientPacket(const SNetAddress& from, CBitReader& reader, irr::u32 type);
+
+    void sendPacket(const SNetAddress& to, CBitWriter& writer, irr::u8 *buffer);
+
+    void sendSimple(const SNetAddress& to, E_NET_PACKET type, irr::u32 value, irr::u32 bits);
+
+    //! Quantize the state of all registered entities
+    void captureState();
+
+    void sendSnapshot(SNetClient& client);
+
+    void writeEntity(CBitWriter& writer, const SNetEntityState& state, const SNetEntityState *baseline);
+
+    bool readEntity(CBitReader& reader, SNetEntityState& state, const SNetEntityState *baseline);
+
+    void readSnapshot(CBitReader& reader);
+
+    void applySnapshot(const SNetSnapshot& snapshot);
+
+    void assignFocus(SNetClient& client);
+
+    void sendInput();
+
+    //! Move the player to the network ID of the character the server gave the client
+    void bindOwnCharacter(irr::s32 id);
+
+    void checkTimeouts();
+
+    CCore * Core;
+
+    E_NET_ROLE m_Role;
+
+    INetTransport *m_Transport;
+
+    SNetAddress m_ServerAddress;
+
+    bool b_Connected;
+
+    // Indexed by network ID
+    irr::core::array<SNetEntity> m_Entities;
+
+    irr::u32 m_EntityCount;
+
+    // Server: state of every entity at this tick
+    irr::core::array<SNetEntityState> m_State;
+
+    SNetClient *m_Clients;
+
+    // Client: snapshots received from the server
+    SNetSnapshot m_Received[NET_SNAPSHOT_HISTORY];
+
+    // Client: network ID of the player, -1 without one
+    irr::s32 m_OwnSlot;
+
+    // Client: newest input of the player, a jump stays until it is sent
+    SNetInput m_Input;
+    bool b_HasInput;
+    irr::u32 m_InputSequence;
+
+    irr::u32 m_Sequence;
+
+    irr::u32 m_SendRate;
+
+    irr::f32 m_InterestRadius;
+
+    // Seconds since start, advanced by update()
+    irr::f32 m_Time, m_SendAccumulator, m_LastConnectAttempt, m_LastReceived;
+
+    irr::f32 m_StatsTime;
+
+    SNetStats m_Stats, m_LastStats;
+  };
+
+}
+
+#endif
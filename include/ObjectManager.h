@@ -24,6 +24,34 @@ namespace engine {
     irr::f32 strength;
   };
 
+  //! Detail levels of batched level meshes, the first is the full mesh
+  const irr::u32 MESH_LOD_LEVELS = 4;
+
+  //! Part of the triangles every level keeps of the level before it
+  const irr::f32 MESH_LOD_RATIO = 0.4f;
+
+  //! Part of the screen height a mesh covers when its level starts being used
+  const irr::f32 MESH_LOD_SCREEN_SIZES[MESH_LOD_LEVELS] = { 0.f, 0.5f, 0.2f, 0.08f };
+
+  //! How far past a threshold the screen size must get before the level changes
+  const irr::f32 MESH_LOD_HYSTERESIS = 0.15f;
+
+  //! Vertex cache use of a batched mesh before and after optimization
+  struct SMeshCacheReport
+  {
+    irr::u32 Triangles;
+    irr::f32 AcmrBefore, AcmrAfter;
+    irr::f32 AtvrBefore, AtvrAfter;
+  };
+
+  //! Batched node drawn with a lower detail mesh when it gets small on screen
+  struct SMeshLod
+  {
+    irr::scene::IMeshSceneNode *Node;
+    irr::scene::CBatchingMesh *Mesh;
+    irr::f32 Radius;
+  };
+
   class CObjectManager
   {
   public:
@@ -34,13 +62,13 @@ namespace engine {
 
     void copyMaterialToMesh(irr::scene::IMesh *mesh, irr::scene::ISceneNode *node);
 
-    void calculateLightmapForNode(irr::scene::IMeshSceneNode* node);
 
     bool addObject(irr::scene::ISceneNode *node);
 
     void loadLevel(irr::core::stringc levelFile);
 
-    engine::CVehicleManager *getVehicles(){ return Vehicles; }
+
+    engine::CPathfinder *getPathfinder(){ return Pathfinder; }
 
     irr::core::stringc getObjectSimpleName(const irr::c8*name);
     irr::core::stringc getNodeFullName(const irr::c8*name);
@@ -155,6 +183,25 @@ namespace engine {
 
     void findAndApplyShaderMaterials(irr::scene::IMeshSceneNode*node);
 
+    //! True if findAndApplyShaderMaterials will give the node a shader material
+    bool getsShaderMaterial(irr::scene::IMeshSceneNode *node);
+
+    //! Finalize a batched mesh, reordering it for the vertex caches
+    void optimizeBatchedMesh(irr::scene::IMeshSceneNode *node, irr::scene::CBatchingMesh *mesh);
+
+    void printMeshCacheReport();
+
+    //! Draw the batched meshes in their original and optimized order
+    void benchmarkMeshOptimization(irr::u32 frames);
+
+    //! Build the lower detail levels of a batched node
+    void generateMeshLods(irr::scene::IMeshSceneNode *node, irr::scene::CBatchingMesh *mesh);
+
+    //! Pick the detail level of every batched node for the current camera
+    void updateMeshLods();
+
+    void printMeshLodReport();
+
     void generateGrassFile(SGrassObject);
 
     void loadGrassFromFile(const irr::c8 *);
@@ -190,7 +237,8 @@ namespace engine {
 
     irr::scene::CBatchingMesh *GrassMesh;
 
-    engine::CVehicleManager *Vehicles;
+
+    engine::CPathfinder *Pathfinder;
 
     // Lists
     irr::core::array<game::CStaticObject*> staticList;
@@ -246,6 +294,14 @@ namespace engine {
 
     irr::core::array<irr::scene::CBatchingMesh*> levelMeshes;
 
+    irr::core::array<SMeshLod> meshLods;
+
+    irr::core::array<SMeshCacheReport> meshCacheReports;
+
+    // Copies of the batched meshes in their original order, kept for -meshbench
+    irr::core::array<irr::scene::IMeshSceneNode*> benchNodes;
+    irr::core::array<irr::scene::IMesh*> benchMeshes;
+
     irr::core::array<SMaterialPair *> nameMaterials;
 
     void loadNameMaterials();
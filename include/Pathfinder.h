@@ -1,36 +1,242 @@
 #ifndef PATHFINDER_HEADER_DEFINED
 #define PATHFINDER_HEADER_DEFINED
 
+#include "Engine.h"
+
 #ifdef MICROPATHER
 
 #include "Micropather.h"
+#include "Jobs.h"
+
+#include <map>
+
+namespace engine {
+
+  //! Steepest walkable surface, in degrees
+  const irr::f32 NAV_MAX_SLOPE = 45.f;
+
+  //! Vertices closer than this are treated as the same vertex
+  const irr::f32 NAV_WELD_DISTANCE = 0.05f;
+
+  //! Open edges of different meshes closer than this (horizontally) are connected,
+  //! if the height difference can be stepped over (MAX_STEP_HEIGHT)
+  const irr::f32 NAV_LINK_DISTANCE = 0.35f;
+
+  //! Polygon lookup grid
+  const irr::f32 NAV_GRID_CELL_SIZE = 8.f;
+
+  //! How far above a surface a position can be and still be on it
+  const irr::f32 NAV_MAX_HEIGHT_ABOVE = 2.f;
+
+  //! Polygons are clustered into connected regions inside cells this big.
+  //! Long paths are planned over regions first, then refined one region at a time.
+  const irr::f32 NAV_REGION_SIZE = 32.f;
+
+  //! Region paths remembered for start/goal region pairs
+  const irr::u32 NAV_PATH_CACHE_SIZE = 512;
+
+  const irr::u32 NAV_FILE_VERSION = 1;
+
+  //! Walkable triangle of the navigation mesh
+  struct SNavPolygon
+  {
+    irr::core::vector3df Vertices[3];
+
+    irr::core::vector3df Center;
+
+    //! Connected polygons and the middle of the shared edge
+    irr::core::array<irr::u32> Neighbours;
+    irr::core::array<irr::core::vector3df> Portals;
+  };
+
+  //! Connected group of polygons, node of the high level graph
+  struct SNavRegion
+  {
+    //! Polygon nearest to the middle of the region
+    irr::u32 Representative;
+
+    irr::core::vector3df Center;
+
+    //! Connected regions, the cost of crossing into them and the polygon
+    //! of this region on the cheapest border to each of them
+    irr::core::array<irr::u32> Neighbours;
+    irr::core::array<irr::f32> Costs;
+    irr::core::array<irr::u32> Exits;
+  };
+
+  enum E_PATH_STATUS
+  {
+    EPS_PENDING = 0,
+    EPS_FOUND,
+    EPS_NOT_FOUND,
+    EPS_UNKNOWN
+  };
 
-struct SPathNode
-{
-  irr::s32 id;
-  irr::core::vector3df position;
-  irr::core::array<irr::s32> adjacent;
-};
+  struct SPathfinderLock;
+  struct SNavSearch;
 
-class CPathfinder : public micropather::Graph
-{
+  //! Navigation mesh built from the static level geometry and A* over its polygons.
+  //! Searches are hierarchical: A* over regions picks the corridor, polygon A* only
+  //! runs inside two neighbouring regions at a time.
+  //! Paths can be solved right away with findPath() or queued with requestPath(),
+  //! queued requests are solved by background jobs so the frame never waits.
+  class CPathfinder
+  {
   public:
 
-    CPathfinder()
+    CPathfinder(CCore * core);
+
+    ~CPathfinder();
+
+    //! Collect the walkable triangles of a static mesh
+    void addGeometry(irr::scene::IMesh *mesh, const irr::core::matrix4& transform);
+
+    //! Build the navigation mesh from the collected triangles. If navFile was
+    //! cooked from the same geometry it's loaded instead, otherwise it's (re)written.
+    void build(const irr::io::path& navFile);
+
+    void clear();
+
+    //! Polygon under the position, or the closest one nearby. -1 if none.
+    irr::s32 getPolygonAt(const irr::core::vector3df& position);
+
+    //! Solve on the calling thread
+    bool findPath(const irr::core::vector3df& start, const irr::core::vector3df& end,
+      irr::core::array<irr::core::vector3df>& path);
+
+    //! Queue a path request. Returns a ticket for getPath(), 0 when there's no navigation mesh.
+    irr::u32 requestPath(const irr::core::vector3df& start, const irr::core::vector3df& end);
+
+    //! EPS_PENDING until the request is solved. A finished request is
+    //! forgotten after this returns its result.
+    E_PATH_STATUS getPath(irr::u32 ticket, irr::core::array<irr::core::vector3df>& path);
+
+    void cancelPath(irr::u32 ticket);
+
+    //! Without job workers, solves one queued request per call
+    void update();
+
+    irr::u32 getPolygonCount() { return m_Polygons.size(); }
+
+    irr::u32 getCacheHits() { return m_CacheHits; }
+
+    irr::u32 getCacheMisses() { return m_CacheMisses; }
+
+    irr::u32 getRegionCount() { return m_Regions.size(); }
+
+    bool isReady() { return m_Polygons.size() > 0; }
+
+    const SNavPolygon& getPolygon(irr::u32 index) { return m_Polygons[index]; }
+
+    const SNavRegion& getRegion(irr::u32 index) { return m_Regions[index]; }
+
+    irr::u32 getPolygonRegion(irr::u32 polygon) { return m_PolygonRegions[polygon]; }
+
+    //! Solve random queries flat and hierarchically, print node expansions and time per query
+    void benchmark(irr::u32 queries);
+
+    //! Solve the oldest queued request, run by a background job
+    void serveRequest(irr::u32 thread);
+
+  private:
+
+    struct SPathRequest
     {
-      points.set_used(0);
-    }
+      irr::u32 Ticket;
+
+      irr::core::vector3df Start, End;
+
+      E_PATH_STATUS Status;
+
+      // Taken by a job / dropped by its owner while being solved
+      bool Taken, Cancelled;
+
+      irr::core::array<irr::core::vector3df> Path;
+    };
 
-    ~CPathfinder()
+    // Start and goal region
+    typedef std::pair<irr::u32, irr::u32> SPathKey;
+
+    struct SCachedPath
     {
-      points.clear();
-    }
+      SPathKey Key;
+      irr::core::array<irr::u32> Regions;
+    };
 
-  private:
+    bool solve(SNavSearch *search, const irr::core::vector3df& start,
+      const irr::core::vector3df& end, irr::core::array<irr::core::vector3df>& path);
+
+    //! Polygon path over the region corridor
+    bool solvePolygons(SNavSearch *search, irr::u32 start, irr::u32 goal, irr::core::array<irr::u32>& polygons);
+
+    //! Polygon path that doesn't leave the two regions
+    bool solveCorridor(SNavSearch *search, irr::u32 regionA, irr::u32 regionB,
+      irr::u32 start, irr::u32 goal, irr::core::array<irr::u32>& polygons);
+
+    //! Polygon path over the whole mesh
+    bool solveFlat(SNavSearch *search, irr::u32 start, irr::u32 goal, irr::core::array<irr::u32>& polygons);
+
+    SNavSearch *createSearch();
+
+    void clearCache();
+
+    void connectPolygons();
+
+    void buildRegions();
+
+    void buildGrid();
+
+    irr::u32 getChecksum();
+
+    bool load(const irr::io::path& file, irr::u32 checksum);
+
+    void save(const irr::io::path& file, irr::u32 checksum);
+
+    //! Wait for the request jobs and drop their searches
+    void finishRequests();
+
+    void lock();
+
+    void unlock();
+
+    CCore * Core;
+
+    // Walkable triangles collected by addGeometry()
+    irr::core::array<irr::core::vector3df> m_Triangles;
+
+    irr::core::array<SNavPolygon> m_Polygons;
+
+    irr::core::array<SNavRegion> m_Regions;
+    irr::core::array<irr::u32> m_PolygonRegions;
+
+    // Polygons overlapping each grid cell
+    irr::core::array< irr::core::array<irr::u32> > m_Grid;
+    irr::core::vector2df m_GridOrigin;
+    irr::u32 m_GridWidth, m_GridHeight;
+
+    // Used by findPath() and update()
+    SNavSearch *m_Search;
+
+    // Used by the request jobs, one for every job thread, created when needed
+    SNavSearch *m_Searches[JOB_MAX_THREADS];
+
+    // Path cache, shared by all threads
+    SCachedPath m_Cache[NAV_PATH_CACHE_SIZE];
+    std::map<SPathKey, irr::u32> m_CacheIndex;
+    irr::u32 m_NextCacheSlot;
+    irr::u32 m_CacheHits, m_CacheMisses;
+
+    irr::core::list<SPathRequest*> m_Queue;
+    irr::core::array<SPathRequest*> m_Requests;
+    irr::u32 m_NextTicket;
+
+    // Request jobs still queued or running
+    SJobCounter m_RequestJobs;
 
-    irr::core::array<SPathNode> points;
+    SPathfinderLock *m_Lock;
+  };
 
-};
+}
 
 #endif
 #endif
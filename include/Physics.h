@@ -5,10 +5,24 @@
 
 #ifdef PHYSICS_NEWTON
   #include "newton/World.h"
+  #include "Ragdolls.h"
+  #include "Breakables.h"
+  #include "Projectile.h"
+  #include "VehicleManager.h"
 #endif
 
 namespace engine {
 
+#ifdef PHYSICS_NEWTON
+  //! Dynamic bodies farther than the freeze radius from every character are
+  //! frozen, nearer than the wake radius they are simulated again (irrlicht units)
+  const irr::f32 PHYSICS_FREEZE_RADIUS = 2048.f;
+  const irr::f32 PHYSICS_WAKE_RADIUS = 1536.f;
+
+  //! Seconds between two activation passes
+  const irr::f32 PHYSICS_ACTIVATION_INTERVAL = 0.25f;
+#endif
+
 #ifdef PHYSICS_IRR_NEWT
   struct SCharacterPhysicsResult
   {
@@ -61,12 +75,37 @@ namespace engine {
       bool dynamic = true,
       irr::f32 mass = 50.0f);
 
+    //! Convex body moved by the game (door leaves)
+    physics::CBody * createKinematicBody(irr::scene::ISceneNode* node);
+
+    //! Bodies of the meshes of a level node. Static meshes get bodies without
+    //! Newton bodies, their faces collide after buildStaticWorld().
     irr::core::array<physics::CBody*> createStaticPhysics(irr::scene::IMeshSceneNode*);
 
+    //! Merge the static faces of the loaded level into region bodies
+    void buildStaticWorld();
+
     void createTestObject(irr::u32, irr::core::vector3df);
 
+    //! Freeze the dynamic bodies far from every character, thaw the near ones
+    //! and those a moving body touches, and count the body states
+    void updateActivation(irr::f32 time);
+
+    //! Dynamic bodies simulated, asleep and frozen at the last activation pass
+    irr::u32 getActiveBodyCount() { return m_ActiveBodies; }
+    irr::u32 getSleepingBodyCount() { return m_SleepingBodies; }
+    irr::u32 getFrozenBodyCount() { return m_FrozenBodies; }
+
     physics::CPhysicsWorld *getPhysicsWorld() { return PhysicsWorld; }
 
+    CRagdollManager *getRagdolls() { return Ragdolls; }
+
+    CBreakableManager *getBreakables() { return Breakables; }
+
+    CProjectileManager *getProjectiles() { return Projectiles; }
+
+    CVehicleManager *getVehicles() { return Vehicles; }
+
     physics::SRayCastResult getRayCollision(physics::SRayCastParameters params)
     {
       return PhysicsWorld->getRayCollision(params);
@@ -81,6 +120,22 @@ namespace engine {
 
     physics::CPhysicsWorld *PhysicsWorld;
 
+    CRagdollManager *Ragdolls;
+
+    CBreakableManager *Breakables;
+
+    CProjectileManager *Projectiles;
+
+    CVehicleManager *Vehicles;
+
+    // Bodies the activation passes look at: characters keep the bodies
+    // around them simulated, the dynamic bodies are frozen and thawed
+    irr::core::array<physics::CBody*> m_CharacterBodies, m_DynamicBodies;
+
+    irr::f32 m_ActivationTime;
+
+    irr::u32 m_ActiveBodies, m_SleepingBodies, m_FrozenBodies;
+
 #endif
 
     CCore * Core;
@@ -0,0 +1,125 @@
+#ifndef PROJECTILE_HEADER_DEFINED
+#define PROJECTILE_HEADER_DEFINED
+
+#include "Engine.h"
+#include "newton/World.h"
+
+namespace engine {
+
+  //! Rounds in flight at most, firing beyond that fails
+  const irr::u32 PROJECTILE_MAX_ROUNDS = 16384;
+
+  //! Seconds a round flies before it is removed without a hit
+  const irr::f32 PROJECTILE_MAX_TIME = 6.f;
+
+  //! Gravity on the rounds (irrlicht units per second squared), the same
+  //! 9.8 m/s² the bodies fall with
+  const irr::f32 PROJECTILE_GRAVITY = 9.8f * physics::NewtonToIrr;
+
+  //! A tracer is the path the round flew in this many seconds, but no
+  //! longer than PROJECTILE_TRACER_LENGTH (irrlicht units)
+  const irr::f32 PROJECTILE_TRACER_TIME = 0.02f;
+  const irr::f32 PROJECTILE_TRACER_LENGTH = 48.f;
+  const irr::f32 PROJECTILE_TRACER_WIDTH = 0.35f;
+
+  //! Tracers of rounds farther than this from the camera are not drawn
+  const irr::f32 PROJECTILE_TRACER_DISTANCE = 4096.f;
+
+  const irr::video::SColor PROJECTILE_TRACER_COLOR = irr::video::SColor(255, 255, 190, 90);
+
+  //! A round that struck a body
+  struct SProjectileHit
+  {
+    physics::CBody *Body;
+
+    irr::core::vector3df Position, Normal;
+
+    //! Velocity of the round when it hit
+    irr::core::vector3df Velocity;
+
+    //! Value given when the round was fired (the weapon type)
+    irr::u32 Type;
+  };
+
+  //! Called for every hit while the rounds are advanced
+  typedef void (*ProjectileHitFunction)(void *data, const SProjectileHit& hit);
+
+  //! Ballistic rounds (heavy weapons, vehicle guns).
+  //! Every round in flight is a few entries in flat arrays, one per quantity.
+  //! Each physics tick gravity and quadratic drag are applied to all of them,
+  //! the segments they flew are cast as one ray batch split over the job
+  //! threads, and the rounds that hit something are reported and removed.
+  //! The tracers are one small mesh drawn once per round with one instanced
+  //! call, no round has a scene node.
+  class CProjectileManager
+  {
+  public:
+
+    CProjectileManager(CCore * core);
+
+    ~CProjectileManager();
+
+    //! Launch a round. The segment cast skips the shape (the shooter's body,
+    //! physics::RAY_EXCLUDE_NONE for none). Drag is the deceleration per
+    //! squared speed (1/irrlicht units). Returns false when too many rounds
+    //! are in flight.
+    bool fire(const irr::core::vector3df& position, const irr::core::vector3df& velocity,
+      irr::f32 drag, irr::u32 excluded, irr::u32 type);
+
+    //! Hits are reported to the function while update() runs
+    void setHitCallback(ProjectileHitFunction function, void *data);
+
+    //! Advance the rounds by a physics tick and cast the segments they flew
+    void update(irr::f32 time);
+
+    //! Set the tracer of every round near enough to the camera.
+    //! Called by the tracer node when the scene registers its nodes for rendering.
+    void cull(const irr::core::vector3df& cameraPosition);
+
+    //! Draw the tracers of the last cull
+    void render();
+
+    //! Remove all rounds (the level is being cleared)
+    void clear();
+
+    irr::u32 getRoundCount() { return m_Positions.size(); }
+
+    //! Rounds that hit something in the last tick
+    irr::u32 getHitCount() { return m_LastHits; }
+
+    irr::u32 getTracerCount() { return m_Tracers.size(); }
+
+  private:
+
+    //! Scene node drawing the tracers, and the mesh they are drawn with
+    void createTracers();
+
+    //! Swap the last round into the slot
+    void remove(irr::u32 index);
+
+    CCore * Core;
+
+    // Rounds in flight, one entry per round in every array
+    irr::core::array<irr::core::vector3df> m_Positions, m_Velocities;
+    irr::core::array<irr::f32> m_Drag, m_Age;
+    irr::core::array<irr::u32> m_Types;
+
+    // Segments of the current tick, the excluded shapes are kept in it
+    physics::SRayBatch m_Batch;
+
+    ProjectileHitFunction m_HitFunction;
+    void *m_HitData;
+
+    irr::scene::ISceneNode *m_TracerNode;
+    irr::scene::SMeshBuffer *m_TracerMesh;
+    irr::video::SMaterial m_TracerMaterial;
+
+    // Transformation of the unit tracer for every tracer drawn
+    irr::core::array<irr::core::matrix4> m_Tracers;
+
+    irr::u32 m_LastHits;
+  };
+
+}
+
+#endif
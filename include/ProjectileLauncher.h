@@ -0,0 +1,30 @@
+#ifndef PROJECTILE_LAUNCHER_HEADER_DEFINED
+#define PROJECTILE_LAUNCHER_HEADER_DEFINED
+
+#include "Weapon.h"
+
+namespace game {
+
+  //! Weapon firing ballistic rounds, they fly and hit in the projectile
+  //! manager instead of being traced at once
+  class CProjectileLauncher : public CWeapon
+  {
+  public:
+
+    CProjectileLauncher(CGame* game)
+    {
+      Game = game;
+    }
+
+    bool fire();
+
+  private:
+
+    //! Launch a round from the weapon along its aim
+    void launch();
+
+  };
+
+}
+
+#endif
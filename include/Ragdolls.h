@@ -0,0 +1,142 @@
+#ifndef RAGDOLLS_HEADER_DEFINED
+#define RAGDOLLS_HEADER_DEFINED
+
+#include "Engine.h"
+#include "newton/World.h"
+
+namespace engine {
+
+  //! Ragdolls simulated at once, a death beyond that settles the oldest one
+  const irr::u32 RAGDOLL_POOL_SIZE = 6;
+
+  //! Corpses kept in the level, the oldest one is removed beyond that
+  const irr::u32 RAGDOLL_CORPSE_MAX = 16;
+
+  //! Capsules of a ragdoll: pelvis, chest, head, arms and legs
+  const irr::u32 RAGDOLL_PART_COUNT = 11;
+
+  //! Mass of a whole ragdoll, split over the parts
+  const irr::f32 RAGDOLL_MASS = 60.f;
+
+  //! Seconds all parts have to rest before the pose is frozen
+  const irr::f32 RAGDOLL_SETTLE_TIME = 0.5f;
+
+  //! A part rests below these speeds (irrlicht units and radians per second).
+  //! The joints keep a ragdoll jittering long after it looks still, Newton's
+  //! own sleep takes seconds longer.
+  const irr::f32 RAGDOLL_REST_SPEED = 8.f;
+  const irr::f32 RAGDOLL_REST_OMEGA = 1.f;
+
+  //! Seconds a ragdoll is simulated at most (one stuck on a slope)
+  const irr::f32 RAGDOLL_MAX_TIME = 8.f;
+
+  //! One capsule of the ragdoll, from a joint of the skeleton to the next.
+  //! Parts come after their parent.
+  struct SRagdollPart
+  {
+    const irr::c8 *Joint;
+    const irr::c8 *EndJoint;
+
+    //! Part the capsule hangs from, -1 for the pelvis
+    irr::s32 Parent;
+
+    //! Capsule radius and length as a fraction of the joint distance
+    irr::f32 Radius;
+    irr::f32 Length;
+
+    //! Fraction of RAGDOLL_MASS
+    irr::f32 Mass;
+
+    //! Swing and twist limits of the joint to the parent (degrees)
+    irr::f32 Cone;
+    irr::f32 Twist;
+  };
+
+  //! Bodies of one ragdoll. They are created once, while unused they are
+  //! massless with a null collision (and cost nothing in the solver or the
+  //! broadphase).
+  struct SRagdollBodies
+  {
+    NewtonBody *Parts[RAGDOLL_PART_COUNT];
+    NewtonJoint *Joints[RAGDOLL_PART_COUNT];
+
+    bool Used;
+  };
+
+  //! Copy of a dead character's node posed by the ragdoll bodies, and
+  //! left in its last pose once they settled
+  struct SCorpse
+  {
+    irr::scene::IAnimatedMeshSceneNode *Node;
+
+    irr::scene::IBoneSceneNode *Bones[RAGDOLL_PART_COUNT];
+
+    //! Bone transformation relative to its body
+    irr::core::matrix4 Offsets[RAGDOLL_PART_COUNT];
+
+    //! Pool index of the bodies, -1 once the pose is frozen
+    irr::s32 Bodies;
+
+    irr::f32 Age;
+    irr::f32 RestTime;
+  };
+
+  //! Ragdoll deaths.
+  //! The character's node is copied, its skeleton is mapped to a few capsules
+  //! joined by limited ball joints and the copy is posed by the capsules until
+  //! they rest. The bodies come from a fixed pool and the corpses are capped,
+  //! so a long battle doesn't pile up physics cost.
+  class CRagdollManager
+  {
+  public:
+
+    CRagdollManager(CCore * core);
+
+    ~CRagdollManager();
+
+    //! Hand a dying character's node over to a ragdoll, the node itself can
+    //! be hidden and reused. Returns false when the mesh lacks the joints.
+    bool spawn(irr::scene::IAnimatedMeshSceneNode *node, const irr::core::vector3df& velocity);
+
+    //! Pose the corpses and freeze the ones that settled
+    void update(irr::f32 time);
+
+    //! Remove the corpses and destroy the pool bodies (the level is being cleared)
+    void clear();
+
+    irr::u32 getCorpseCount() { return m_Corpses.size(); }
+
+    //! Ragdolls being simulated
+    irr::u32 getSimulatedCount() { return m_Simulated; }
+
+  private:
+
+    //! Create the bodies of the pool
+    void createPool();
+
+    //! Free bodies of the pool, -1 when all are used
+    irr::s32 getFreeBodies();
+
+    //! Leave the corpse in its current pose and park its bodies
+    void settle(SCorpse& corpse);
+
+    void removeCorpse(irr::u32 index);
+
+    //! Move the bones of a corpse to its bodies
+    void pose(SCorpse& corpse);
+
+    CCore * Core;
+
+    irr::core::array<SRagdollBodies> m_Pool;
+
+    //! Oldest first
+    irr::core::array<SCorpse> m_Corpses;
+
+    NewtonCollision *m_NullCollision;
+
+    irr::u32 m_Simulated;
+  };
+
+}
+
+#endif
@@ -3,53 +3,15 @@
 
 #include "Engine.h"
 #include "ShaderManager.h"
+#include "SpriteBatcher.h"
+#include "Culling.h"
+#include "Instancing.h"
+#include "Shadows.h"
+#include "Lights.h"
+#include "Jobs.h"
 
 namespace engine {
 
-  /*struct SFaceCullData
-  {
-    irr::core::array<irr::scene::CMeshBuffer<irr::video::S3DVertex>*> Buffers;
-    irr::core::array<irr::video::S3DVertex*> Vertex;
-    irr::core::array<u16*> Indices;
-    irr::core::array<irr::s32> IndexCount;
-    irr::core::array<irr::u16*> IndicesCount;
-    irr::core::array<irr::core::vector3df*> Normals;
-    irr::core::array<irr::core::vector3df*> VertPoint;
-
-    irr::core::array<irr::u32> m;
-    irr::core::array<irr::u32> k;
-
-    void Setup(irr::scene::IMesh* Mesh, bool batchedMesh);
-    void Update();
-
-    SFaceCullData()
-    {
-      m.set_used(0);
-      k.set_used(0);
-    }
-  };*/
-
-  class CCullingManager
-  {
-  public:
-
-    CCullingManager(CCore * core) : Core(core)
-    {
-      //faceCulledObjects.set_used(0);
-    }
-
-    void update(irr::f32);
-
-    void addFaceCulledMesh(irr::scene::IMesh* mesh);
-
-  private:
-
-    CCore * Core;
-
-    //irr::core::array<SFaceCullData *> faceCulledObjects;
-
-  };
-
   class CRenderer
   {
   public:
@@ -61,8 +23,12 @@ namespace engine {
 
     ~CRenderer()
     {
+      delete LightManager;
+      delete ShadowManager;
       delete ShaderManager;
+      delete InstancingManager;
       delete CullingManager;
+      delete SpriteBatcher;
     }
 
     irr::u32 createDevice();
@@ -76,8 +42,18 @@ namespace engine {
     irr::ITimer *getTimer() { return Timer; }
     CShaderManager *getShaders() { return ShaderManager; }
     CCullingManager *getCullingManager() { return CullingManager; }
+    CInstancingManager *getInstancingManager() { return InstancingManager; }
+    CShadowManager *getShadows() { return ShadowManager; }
+    CLightManager *getLights() { return LightManager; }
+    CSpriteBatcher *getSpriteBatcher() { return SpriteBatcher; }
     irr::scene::ICameraSceneNode *getCamera() { return SceneManager->getActiveCamera(); }
 
+    //! Queue one of the driver's jobs (Burning's Video tiles) on the job manager
+    void submitDriverJob(irr::video::SDriverJob *job);
+
+    //! Run and wait for the queued driver jobs
+    void waitDriverJobs();
+
   private:
 
     CCore * Core;
@@ -99,6 +75,17 @@ namespace engine {
 
     CCullingManager *CullingManager;
 
+    CInstancingManager *InstancingManager;
+
+    CShadowManager *ShadowManager;
+
+    CLightManager *LightManager;
+
+    CSpriteBatcher *SpriteBatcher;
+
+    // Driver jobs of the current flush
+    SJobCounter DriverJobs;
+
     struct SOcclusionRTT
     {
        	irr::video::ITexture* Texture;
@@ -2,6 +2,7 @@
 #define SHADERS_HEADER_DEFINED
 
 #include <irrlicht.h>
+#include "Shadows.h"
 
 namespace engine {
 
@@ -14,7 +15,16 @@ namespace engine {
     ESS_AMBIENT_LIGHT = 1 << 4,
     ESS_TEXTURES_OPENGL = 1 << 5,
     ESS_TIME = 1 << 6,
-    ESS_FAR_VALUE = 1 << 7
+    ESS_FAR_VALUE = 1 << 7,
+
+    //! Sun shadow lookup: mShadowMatrix (a world matrix per cascade, object
+    //! space to atlas coordinates and depth), mShadowSplits (view distance
+    //! where each cascade ends), mShadowCascades (0 when shadows are off),
+    //! mShadowTexel and the shadowMap sampler
+    ESS_SHADOW_MAP = 1 << 8,
+
+    //! mFog, 1 when the material has fog enabled
+    ESS_FOG = 1 << 9
   };
 
 
@@ -29,6 +39,7 @@ namespace engine {
     CBaseShader(CCore * core, irr::u32 params) : Core(core){
       toBeDeleted = false;
       parameters = params;
+      shadowSlot = SHADOW_TEXTURE_SLOT;
     }
 
     virtual void OnSetConstants(
@@ -46,6 +57,9 @@ namespace engine {
 
     irr::u32 parameters;
 
+    //! Texture slot of the shadow atlas in the materials of this shader
+    irr::u32 shadowSlot;
+
     const irr::video::SMaterial *UsedMaterial;
 
     CCore * Core;
@@ -61,6 +75,7 @@ namespace engine {
 
       CGrassShader(CCore *core, irr::u32 params) : CBaseShader(core, params) {
         parameters = params;
+        shadowSlot = 3;
       }
 
       virtual void OnSetConstants(
@@ -69,11 +84,13 @@ namespace engine {
   };
 
 
-  class CCameraViewObjectShader : public CBaseShader
+  //! Tiled point lights: screen and tile size, the projection to rebuild
+  //! view positions from the G-buffer depth and the light encoding ranges
+  class CTiledLightShader : public CBaseShader
   {
     public:
 
-      CCameraViewObjectShader(CCore *core, irr::u32 params) : CBaseShader(core, params) {
+      CTiledLightShader(CCore *core, irr::u32 params) : CBaseShader(core, params) {
         parameters = params;
       }
 
@@ -136,9 +153,16 @@ namespace engine {
     irr::s32 createMultiTextureShader();
     irr::s32 createGrassShader();
     irr::s32 createCameraViewObjectShader();
+    //! Lightmapped level geometry, writes the G-buffer with OpenGL
     irr::s32 createLightmapShader();
     irr::s32 createParticleFadeOutShader(irr::f32 fade_time);
 
+    //! Writes the light space depth of the shadow casters
+    irr::s32 createShadowDepthShader();
+
+    //! Adds the lights of each pixel's screen tile (OpenGL only)
+    irr::s32 createTiledLightShader();
+
   private:
     CCore * Core;
   };
@@ -0,0 +1,154 @@
+#ifndef SHADOWS_HEADER_DEFINED
+#define SHADOWS_HEADER_DEFINED
+
+#include "Engine.h"
+
+namespace engine {
+
+  //! Slices of the view frustum with their own shadow map
+  const irr::u32 SHADOW_CASCADES = 4;
+
+  //! Size of one cascade, the cascades share a 2x2 atlas
+  const irr::u32 SHADOW_MAP_SIZE = 1024;
+
+  //! View distance covered by the cascades
+  const irr::f32 SHADOW_DISTANCE = 150.f;
+
+  //! Blend between logarithmic (1) and even (0) cascade splits
+  const irr::f32 SHADOW_SPLIT_LAMBDA = 0.75f;
+
+  //! A cascade covers this much more than its slice of the frustum, so the
+  //! camera can move and turn a while before the cascade has to be redrawn
+  const irr::f32 SHADOW_CASCADE_MARGIN = 0.25f;
+
+  //! Texture slot of the atlas in materials using the shadow lookup
+  const irr::u32 SHADOW_TEXTURE_SLOT = 5;
+
+  //! Light space region of a cascade and the matrices it was drawn with
+  struct SShadowCascade
+  {
+    //! Center of the region in light space (snapped to texels) and half its size
+    irr::core::vector2df Center;
+    irr::f32 HalfSize;
+
+    //! Radius of the frustum slice the region was fitted to
+    irr::f32 Radius;
+
+    //! View distance where the cascade ends
+    irr::f32 Split;
+
+    irr::core::matrix4 View, Projection;
+
+    //! World space to atlas coordinates and depth
+    irr::core::matrix4 Lookup;
+
+    bool Valid;
+
+    SShadowCascade() : HalfSize(0.f), Radius(0.f), Split(0.f), Valid(false) {}
+  };
+
+  //! Cascaded shadow maps of the sun.
+  //! The view frustum is split in SHADOW_CASCADES slices, each one gets an
+  //! orthographic shadow map from the sun fitted around it. A cascade keeps its
+  //! region (and its rendered map) until the slice leaves it, the sun turns, the
+  //! static casters change or a dynamic caster moves inside it: on most frames
+  //! nothing is drawn. Casters are the nodes of the culling manager and the
+  //! instance groups; shaders read the maps with the ESS_SHADOW_MAP constants.
+  class CShadowManager
+  {
+  public:
+
+    CShadowManager(CCore * core);
+
+    ~CShadowManager();
+
+    //! Create the atlas and the depth material. Returns false when the
+    //! driver can't render them, shadows stay disabled then.
+    bool init();
+
+    //! Fit the cascades to the active camera and redraw the ones that changed.
+    //! Called every frame before the scene is drawn.
+    void update();
+
+    //! Redraw the cascades overlapping a static caster whose mesh changed
+    //! (a prop losing pieces). The box is in world space.
+    void invalidate(const irr::core::aabbox3df& box);
+
+    //! Forget the cascades and casters (the scene is being cleared)
+    void clear();
+
+    bool isEnabled() { return m_Texture != NULL; }
+
+    //! Atlas with the cascades, NULL when shadows are disabled
+    irr::video::ITexture *getTexture() { return m_Texture; }
+
+    //! Cascades the shaders should read, 0 when shadows are disabled
+    irr::u32 getCascadeCount() { return isEnabled() ? SHADOW_CASCADES : 0; }
+
+    const SShadowCascade& getCascade(irr::u32 index) { return m_Cascades[index]; }
+
+    //! Cascades redrawn in the last frame
+    irr::u32 getRenderedCount() { return m_Rendered; }
+
+    //! Caster draws of the last frame
+    irr::u32 getCasterDrawCount() { return m_CasterDraws; }
+
+  private:
+
+    //! Light space box of a world space box given as center and extent
+    irr::core::aabbox3df getLightBox(const irr::core::vector3df& center, const irr::core::vector3df& extent);
+
+    void updateLightView(const irr::core::vector3df& sunDirection);
+
+    void updateSceneBox();
+
+    //! Check the dynamic casters, mark cascades they moved in
+    void updateDynamicCasters();
+
+    //! Fit the cascade to its slice, returns true if its region moved
+    bool fitCascade(irr::u32 index, irr::scene::ICameraSceneNode *camera, irr::f32 nearValue, irr::f32 farValue);
+
+    void renderCascade(irr::u32 index);
+
+    //! Draw the casters whose light space box overlaps the region
+    void renderCasters(const SShadowCascade& cascade);
+
+    bool overlaps(const SShadowCascade& cascade, const irr::core::aabbox3df& lightBox);
+
+    CCore * Core;
+
+    irr::video::ITexture *m_Texture;
+
+    irr::video::SMaterial m_DepthMaterial;
+
+    SShadowCascade m_Cascades[SHADOW_CASCADES];
+
+    bool b_Dirty[SHADOW_CASCADES];
+
+    // Sun direction and the rotation into light space (no translation)
+    irr::core::vector3df m_SunDirection;
+    irr::core::matrix4 m_LightView;
+
+    // Depth range of all casters in light space
+    irr::f32 m_MinDepth, m_MaxDepth;
+
+    // Caster counts the scene box was computed for
+    irr::u32 m_StaticCount, m_GroupCount;
+
+    // Last transformation and light space box of every dynamic caster
+    irr::core::array<irr::core::matrix4> m_DynamicTransforms;
+    irr::core::array<irr::core::aabbox3df> m_DynamicBoxes;
+
+    // Light space boxes of dynamic casters that moved this frame (before and after)
+    irr::core::array<irr::core::aabbox3df> m_MovedBoxes;
+
+    // Instances passing a cascade, drawn in one call per mesh buffer
+    irr::core::array<irr::core::matrix4> m_Transforms;
+
+    irr::u32 m_Rendered;
+    irr::u32 m_CasterDraws;
+  };
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef SPRITE_BATCHER_HEADER_DEFINED
+#define SPRITE_BATCHER_HEADER_DEFINED
+
+#include "Engine.h"
+
+namespace engine {
+
+  //! Size of one atlas page. Clamped to the max texture size of the driver.
+  const irr::u32 SPRITE_ATLAS_SIZE = 2048;
+
+  //! Empty pixels left around every packed image so neighbours don't bleed
+  const irr::u32 SPRITE_ATLAS_PADDING = 1;
+
+  //! One texture the batcher draws from. Either an atlas built by the batcher
+  //! or a foreign texture (font pages, images too big for an atlas).
+  struct SSpritePage
+  {
+    irr::video::ITexture *Texture;
+
+    // Top-left corner of a white block used for untextured rectangles,
+    // (-1,-1) when the page doesn't have one
+    irr::core::position2d<irr::s32> WhiteTexel;
+
+    // Shelf packer state
+    irr::u32 ShelfX, ShelfY, ShelfHeight;
+
+    // Quads waiting for the next flush
+    irr::core::array<irr::video::S3DVertex> Vertices;
+    irr::core::array<irr::u16> Indices;
+
+    // Page was built by the batcher (removed from the driver on clear)
+    bool Atlas;
+
+    SSpritePage() : Texture(0), WhiteTexel(-1,-1),
+      ShelfX(0), ShelfY(0), ShelfHeight(0), Atlas(false) {}
+  };
+
+  struct SSprite
+  {
+    irr::io::path File;
+
+    irr::s32 Page;
+
+    // Position of the image inside the page texture
+    irr::core::rect<irr::s32> Rect;
+
+    SSprite() : Page(-1) {}
+  };
+
+  //! Collects 2D quads (images, rectangles, bitmap font glyphs) and draws
+  //! each run of quads on the same page texture with one draw call.
+  //! Switching to another page or calling flush() draws the queued run, so
+  //! quads always come out in the order they were submitted. Font pages
+  //! added with addFont() are packed with the sprites, text between icons
+  //! then doesn't switch pages.
+  class CSpriteBatcher
+  {
+  public:
+
+    CSpriteBatcher(CCore * core);
+
+    ~CSpriteBatcher();
+
+    //! Register an image file. It is packed into an atlas on the next buildAtlases() call.
+    //! Returns the sprite id (the same id if the file is already registered).
+    irr::s32 addSprite(const irr::io::path& file);
+
+    //! Register the glyph pages of a bitmap font. They are packed into an
+    //! atlas on the next buildAtlases() call, other font types are ignored.
+    void addFont(irr::gui::IGUIFont *font);
+
+    //! Pack every sprite added since the last call into atlas pages
+    void buildAtlases();
+
+    //! Drop all pages and sprites
+    void clear();
+
+    void draw(irr::s32 sprite,
+      const irr::core::position2d<irr::s32>& position,
+      const irr::core::rect<irr::s32>& sourceRect,
+      irr::video::SColor color=irr::video::SColor(255,255,255,255));
+
+    void draw(irr::s32 sprite,
+      const irr::core::rect<irr::s32>& destRect,
+      const irr::core::rect<irr::s32>& sourceRect,
+      irr::video::SColor color=irr::video::SColor(255,255,255,255));
+
+    void drawRectangle(irr::video::SColor color, const irr::core::rect<irr::s32>& position);
+
+    //! Same layout as IGUIFont::draw. Bitmap fonts are batched per glyph,
+    //! other font types are drawn directly.
+    void drawText(irr::gui::IGUIFont *font,
+      const irr::core::stringw& text,
+      const irr::core::rect<irr::s32>& position,
+      irr::video::SColor color,
+      bool hcenter=false, bool vcenter=false);
+
+    //! Draw the queued quads
+    void flush();
+
+    //! Called once per frame after all 2D drawing is done
+    void endFrame();
+
+    irr::u32 getDrawCallCount() { return m_LastDrawCalls; }
+
+    irr::u32 getQuadCount() { return m_LastQuads; }
+
+    irr::u32 getAtlasCount() { return m_AtlasCount; }
+
+    irr::u32 getSpriteCount() { return m_Sprites.size(); }
+
+  private:
+
+    irr::s32 getPageForTexture(irr::video::ITexture *texture);
+
+    //! Queue a loaded image for the next buildAtlases(), returns the sprite id
+    irr::s32 addSpriteImage(irr::video::IImage *image, const irr::io::path& file);
+
+    bool allocate(SSpritePage &page, const irr::core::dimension2d<irr::u32>& size,
+      irr::core::position2d<irr::s32>& position);
+
+    void addQuad(irr::s32 page,
+      const irr::core::rect<irr::f32>& destRect,
+      const irr::core::rect<irr::s32>& sourceRect,
+      irr::video::SColor color);
+
+    void flushPage(irr::s32 page);
+
+    CCore * Core;
+
+    irr::video::IVideoDriver *m_Driver;
+
+    irr::core::array<SSpritePage> m_Pages;
+
+    irr::core::array<SSprite> m_Sprites;
+
+    // Images loaded by addSprite(), waiting for buildAtlases()
+    irr::core::array<irr::video::IImage*> m_PendingImages;
+    irr::core::array<irr::s32> m_PendingSprites;
+
+    // Sprites holding the glyph pages of the fonts, by page texture
+    irr::core::map<irr::video::ITexture*, irr::s32> m_FontSprites;
+
+    irr::video::SMaterial m_Material;
+
+    irr::s32 m_LastPage;
+
+    irr::u32 m_AtlasSize;
+    irr::u32 m_AtlasCount;
+
+    irr::u32 m_DrawCalls, m_LastDrawCalls;
+    irr::u32 m_Quads, m_LastQuads;
+  };
+
+}
+
+#endif
@@ -1,19 +1,240 @@
 #ifndef VEHICLE_MANAGER_HEADER_DEFINED
 #define VEHICLE_MANAGER_HEADER_DEFINED
 
+#include "Engine.h"
+#include "newton/World.h"
+
 namespace engine {
 
+  //! Wheels of a vehicle at most, a tank has a road wheel per side and axle
+  const irr::u32 VEHICLE_MAX_WHEELS = 16;
+
+  //! Damping of the suspension as a fraction of the critical damping
+  const irr::f32 VEHICLE_DAMPING_RATIO = 0.4f;
+
+  //! Deceleration of a rolling vehicle without throttle (m/s²)
+  const irr::f32 VEHICLE_ROLLING_DECELERATION = 1.5f;
+
+  //! A vehicle without input below these speeds (irrlicht units and radians
+  //! per second) for this many seconds is parked: its body is frozen and no
+  //! wheel rays are cast for it until it is driven or pushed
+  const irr::f32 VEHICLE_PARK_SPEED = 8.f;
+  const irr::f32 VEHICLE_PARK_OMEGA = 0.2f;
+  const irr::f32 VEHICLE_PARK_TIME = 1.f;
+
+  //! A character this close to a vehicle's box can get in (irrlicht units)
+  const irr::f32 VEHICLE_ENTER_DISTANCE = 48.f;
+
+  enum E_VEHICLE_CLASS
+  {
+    //! Steered front wheels (jeeps, trucks)
+    EVC_WHEELED = 0,
+
+    //! Road wheels turned by the difference of the track speeds (tanks)
+    EVC_TRACKED,
+
+    EVC_COUNT
+  };
+
+  //! Handling of a vehicle class
+  struct SVehicleClass
+  {
+    //! Mass of the whole vehicle (kg)
+    irr::f32 Mass;
+
+    //! Suspension travel (irrlicht units). The wheels placed in the level
+    //! are at half travel, the springs hold the mass there.
+    irr::f32 Travel;
+
+    //! Accelerations of the engine and the brakes (m/s²)
+    irr::f32 Acceleration;
+    irr::f32 Braking;
+
+    //! Top speed (irrlicht units per second)
+    irr::f32 MaxSpeed;
+
+    //! Steering angle of the front wheels (degrees)
+    irr::f32 Steer;
+
+    //! Friction of the tires or tracks along and across the wheels
+    irr::f32 Grip;
+    irr::f32 SideGrip;
+  };
+
+  //! Wheel of a vehicle, positions in the space of the chassis body
+  struct SVehicleWheel
+  {
+    //! Top of the suspension, the ray is cast down from it
+    irr::core::vector3df Hardpoint;
+
+    irr::f32 Radius;
+
+    //! Steered wheel (front wheels of wheeled vehicles)
+    bool Steered;
+
+    //! -1 on the left side, 1 on the right side
+    irr::f32 Side;
+
+    //! Child node drawn as the wheel, its place and rotation in the level
+    irr::scene::ISceneNode *Node;
+    irr::core::vector3df NodePosition;
+    irr::core::vector3df NodeRotation;
+
+    //! Contact of the last cast: suspension compressed by this much
+    //! (irrlicht units), ground normal, body driven on
+    bool Contact;
+    irr::f32 Compression;
+    irr::core::vector3df Normal;
+    physics::CBody *Ground;
+
+    //! Rolling angle of the wheel node (degrees)
+    irr::f32 Spin;
+  };
+
+  //! Chassis transformation of a physics tick
+  struct SVehicleTransform
+  {
+    irr::core::vector3df Position;
+    irr::core::quaternion Rotation;
+  };
+
+  //! Level node named with the -v parameter (-v -t for tracked vehicles)
+  struct SVehicle
+  {
+    irr::scene::IMeshSceneNode *Node;
+
+    physics::CBody *Body;
+
+    E_VEHICLE_CLASS Class;
+
+    irr::core::array<SVehicleWheel> Wheels;
+
+    //! Spring rate and damping of a wheel's suspension (Newton units)
+    irr::f32 Spring, Damper;
+
+    //! Driver input: throttle and steering from -1 to 1 (steering right is
+    //! positive), brake
+    irr::f32 Throttle, Steering;
+    bool Brake;
+
+    //! Seconds without input below the park speeds
+    irr::f32 IdleTime;
+
+    //! Frozen, no rays are cast and the node stays where it is
+    bool Parked;
+
+    //! A character drives it, nobody else can get in
+    bool Driven;
+  };
+
+  class CVehicleManager;
+
+  //! Body of a vehicle's chassis. Newton's callbacks find the vehicle
+  //! through it, the ray casts see a body like any other.
+  class CVehicleBody : public physics::CBody
+  {
+  public:
+
+    CVehicleBody(irr::u32 shapeId, NewtonWorld * world, CVehicleManager * manager, irr::u32 vehicle)
+      : physics::CBody(shapeId, world), Manager(manager), Vehicle(vehicle)
+    {
+    }
+
+    CVehicleManager * Manager;
+
+    irr::u32 Vehicle;
+  };
+
+  //! Wheeled and tracked vehicles driven on ray cast wheels.
+  //! Newton 2.32 ships without its vehicle joint, so every chassis is a
+  //! rigid body held up by a spring and damper per wheel. Once per physics
+  //! tick the wheel rays of all vehicles are cast as one batch, the chassis'
+  //! force callback turns the contacts into suspension, drive and friction
+  //! forces. Newton only writes the chassis transformations into a buffer,
+  //! the scene nodes are moved between the last two of them every frame.
+  //! Vehicles nobody drives are parked (frozen) once they stand still.
   class CVehicleManager
   {
   public:
-    CVehicleManager(){ }
 
+    CVehicleManager(CCore * core);
+
+    ~CVehicleManager();
+
+    //! Take a vehicle node out of the level before it is grouped and
+    //! batched. It gets its body in build().
+    void addVehicle(irr::scene::IMeshSceneNode *node, E_VEHICLE_CLASS vehicleClass);
+
+    //! Put the vehicle nodes back into the scene and create their bodies
+    //! and wheels (the level is loaded)
+    void build();
+
+    //! Driver input of a vehicle, a parked vehicle is woken by any input
+    void setControls(irr::u32 vehicle, irr::f32 throttle, irr::f32 steering, bool brake);
+
+    //! Nearest vehicle nobody drives that a character at the position can
+    //! get in, or -1
+    irr::s32 getFreeVehicle(const irr::core::vector3df& position);
+
+    //! A character gets in or out. Getting out sets the brake and lets go
+    //! of the throttle and steering, the vehicle parks once it stands.
+    void setDriven(irr::u32 vehicle, bool driven);
+
+    //! Park the vehicles standing still, cast the wheel rays of the others.
+    //! Called before every physics tick, whose forces use the contacts.
+    void update(irr::f32 time);
+
+    //! Move the nodes of the moving vehicles between the last two ticks.
+    //! alpha is the part of a tick the frame is past the last one, time
+    //! the length of the frame (the wheels roll by it).
+    void updateNodes(irr::f32 alpha, irr::f32 time);
+
+    //! Remove the bodies and forget the vehicles (the level is being cleared)
+    void clear();
+
+    //! Suspension, drive and friction forces of the vehicle's wheels
+    //! (force callback of the chassis, runs on Newton's threads)
+    void applyForces(irr::u32 vehicle, irr::f32 timestep);
+
+    //! Keep the chassis transformation for the nodes (transform callback)
+    void setTransform(irr::u32 vehicle, const irr::f32 *matrix);
+
+    irr::u32 getVehicleCount() { return m_Vehicles.size(); }
+
+    SVehicle& getVehicle(irr::u32 vehicle) { return m_Vehicles[vehicle]; }
+
+    //! Vehicles driving and parked after the last update
+    irr::u32 getDrivingCount() { return m_Driving; }
+    irr::u32 getParkedCount() { return m_Parked; }
 
   private:
 
+    //! Wheels of the node's "Wheel" children, or evenly spread under the
+    //! chassis when it has none
+    void createWheels(SVehicle& vehicle, const irr::core::matrix4& bodyMatrix);
+
+    void createBody(SVehicle& vehicle, irr::u32 index);
+
+    void park(irr::u32 index);
+
+    void unpark(irr::u32 index);
+
+    //! Steering and rolling of the wheel nodes
+    void updateWheelNodes(SVehicle& vehicle, irr::f32 time);
+
+    CCore * Core;
+
+    irr::core::array<SVehicle> m_Vehicles;
+
+    // Chassis transformations of the last two ticks, one per vehicle
+    irr::core::array<SVehicleTransform> m_Previous, m_Current;
+
+    // Wheel rays of every driving vehicle, in vehicle and wheel order
+    physics::SRayBatch m_Batch;
+
+    irr::u32 m_Driving, m_Parked;
   };
 
 }
 
 #endif
-
@@ -7,6 +7,11 @@ namespace game {
 
   const irr::f32 MINIMUM_DISTANCE_BETWEEN_BULLET_DECALS = 0.0070f;
 
+  //! Light of a muzzle flash, it lives as long as the flash mesh
+  const irr::video::SColorf MUZZLE_LIGHT_COLOR = irr::video::SColorf(1.f, 0.8f, 0.45f);
+  const irr::f32 MUZZLE_LIGHT_RADIUS = 8.f;
+  const irr::f32 MUZZLE_LIGHT_TIME = 0.12f;
+
   class CWeapon : public CInventoryBaseObject
   {
   public:
@@ -29,7 +29,11 @@ namespace physics {
     EBT_PRIMITIVE_BOX,
     EBT_PRIMITIVE_SPHERE,
     EBT_PRIMITIVE_CAPSULE,
-    EBT_NULL
+    EBT_NULL,
+
+    //! Convex hull without mass, moved by the game with moveKinematic()
+    //! (doors, lifts). Pushes dynamic bodies and sleeps while it stands still.
+    EBT_KINEMATIC
   };
 
   struct SBodyCreationParameters
@@ -61,6 +65,7 @@ namespace physics {
       a_NewtonCollisions.set_used(0);
       a_NewtonJoints.set_used(0);
       b_GravityEnabled = true;
+      b_Kinematic = false;
       m_NewtonWorld = world;
     }
 
@@ -96,6 +101,22 @@ namespace physics {
 
     inline void setGravityEnabled(bool grav) { b_GravityEnabled = grav; }
 
+    inline void setKinematic(bool kinematic) { b_Kinematic = kinematic; }
+
+    //! Move a kinematic body to the position in the given time. The velocity
+    //! is set too, so the contacts push what is in the way.
+    void moveKinematic(irr::core::vector3df position, irr::f32 time);
+
+    //! Stop a kinematic body and let it sleep
+    void stopKinematic();
+
+    //! Simulate a sleeping or frozen dynamic body (and its island) again
+    void wake();
+
+    //! Swap the collision for a null one and back (dead characters). Only for
+    //! bodies whose collisions were not released after creation.
+    void setCollisionEnabled(bool enabled);
+
     /*
       GET methods
     */
@@ -126,6 +147,8 @@ namespace physics {
 
     bool isGravityEnabled() { return b_GravityEnabled; }
 
+    bool isKinematic() { return b_Kinematic; }
+
 
 
     void drawDebug(irr::video::IVideoDriver *driver);
@@ -162,6 +185,8 @@ namespace physics {
 
     bool b_GravityEnabled;
 
+    bool b_Kinematic;
+
     void *m_UserData;
   };
 
@@ -4,6 +4,7 @@
 #include <Newton.h>
 
 #include "CompileConfig.h"
+#include "Jobs.h"
 #include "newton/Body.h"
 #include "newton/Collision.h"
 
@@ -20,6 +21,48 @@ namespace physics {
   //!Convert a position from irrlicht to newton
   const irr::f32 IrrToNewton = (1.0f / NewtonToIrr);
 
+  //! Static level geometry is merged into one tree collision body per
+  //! square region of this size (irrlicht units, on the X/Z plane)
+  const irr::f32 STATIC_REGION_SIZE = 1024.f;
+
+  //! Modes of NewtonSetPlatformArchitecture: the common x87 solver, or the
+  //! best instruction set the cpu has (the SSE solver where it is detected)
+  const irr::s32 PHYSICS_ARCHITECTURE_X87 = 0;
+  const irr::s32 PHYSICS_ARCHITECTURE_BEST = 2;
+
+  //! Test scene of the solver benchmark: stacks of boxes and chains of
+  //! capsules joined by limited ball joints like ragdoll limbs
+  const irr::u32 BENCHMARK_STACKS = 8;
+  const irr::u32 BENCHMARK_STACK_HEIGHT = 10;
+  const irr::u32 BENCHMARK_CHAINS = 8;
+  const irr::u32 BENCHMARK_CHAIN_LINKS = 10;
+
+  //! Broadphase of the world: Newton's grid of sorted cells, or the
+  //! dynamic AABB tree (faster with debris and long traces across the level)
+  const irr::s32 PHYSICS_BROADPHASE_GRID = NEWTON_BROADPHASE_GRID;
+  const irr::s32 PHYSICS_BROADPHASE_TREE = NEWTON_BROADPHASE_AABB_TREE;
+
+  //! Collision updates the broadphase benchmark times on the level
+  const irr::u32 BROADPHASE_BENCHMARK_STEPS = 60;
+
+  //! Size of the boxes queried by the broadphase benchmark (irrlicht units)
+  const irr::f32 BROADPHASE_BENCHMARK_BOX = 64.f;
+
+  //! Auto sleep: a group of bodies below this acceleration and these speeds
+  //! (irrlicht units, radians per second) for this many frames at 60 fps goes
+  //! to sleep. Newton waits 6 seconds by default, props jittering on the
+  //! frame scaled gravity never got there.
+  const irr::f32 PHYSICS_SLEEP_ACCEL = 192.f;
+  const irr::f32 PHYSICS_SLEEP_SPEED = 16.f;
+  const irr::f32 PHYSICS_SLEEP_OMEGA = 0.5f;
+  const irr::s32 PHYSICS_SLEEP_FRAMES = 60;
+
+  //! Below this many segments a ray batch is cast on the calling thread
+  const irr::u32 RAY_BATCH_PARALLEL_THRESHOLD = 512;
+
+  //! Shape ID of no body, for batched segments that skip nothing
+  const irr::u32 RAY_EXCLUDE_NONE = 0xFFFFFFFF;
+
   inline void fillVec3(
       irr::core::vector3df vector,
       irr::f32* array) {
@@ -49,9 +92,14 @@ namespace physics {
     irr::core::line3df line;
     irr::core::array<irr::u32> excluded;
 
+    //! Wake the dynamic body that is hit (weapon traces). Probes like the
+    //! stair and crosshair rays leave resting bodies asleep.
+    bool wake;
+
     SRayCastParameters()
     {
       excluded.set_used(0);
+      wake = false;
     }
   };
 
@@ -76,6 +124,36 @@ namespace physics {
     irr::f32 distance;
   };
 
+  //! Segments cast with one call, each one gets the nearest hit along it
+  struct SRayBatch
+  {
+    irr::core::array<irr::core::line3df> lines;
+
+    //! Shape ID each segment skips (the shooter), or RAY_EXCLUDE_NONE
+    irr::core::array<irr::u32> excluded;
+
+    //! Same order as the lines, the body is NULL where nothing was hit
+    irr::core::array<SRayCastResult> results;
+
+    //! Wake the dynamic bodies that are hit, as SRayCastParameters::wake
+    bool wake;
+
+    SRayBatch()
+    {
+      wake = false;
+    }
+  };
+
+  class CPhysicsWorld;
+
+  //! Range of a ray batch cast by one job
+  struct SRayBatchJob
+  {
+    CPhysicsWorld *world;
+    SRayBatch *batch;
+    irr::u32 first, count;
+  };
+
   struct SConvexCastResultSingle
   {
     CBody *body;
@@ -91,6 +169,23 @@ namespace physics {
     irr::f32 param;
   };
 
+  //! Faces of the static meshes in one region. The face attribute is the
+  //! index of the mesh's body + 1, hits are mapped back to that body.
+  //! The faces are kept, a region gaining faces is rebuilt from all of them.
+  struct SStaticRegion
+  {
+    //! Newton space, three per face
+    irr::core::array<irr::core::vector3df> vertices;
+    irr::core::array<irr::s32> attributes;
+
+    NewtonBody * body;
+
+    //! Faces were added since the body was built
+    bool dirty;
+
+    SStaticRegion() : body(NULL), dirty(false) {}
+  };
+
   class CPhysicsWorld
   {
   public:
@@ -98,6 +193,8 @@ namespace physics {
     CPhysicsWorld(irr::ITimer * timer)
     {
       m_Timer = timer;
+      m_Jobs = (CJobManager*)NULL;
+      m_Broadphase = PHYSICS_BROADPHASE_TREE;
       g_timeAccumulator = DEMO_FPS_IN_MICROSECUNDS;
 
       all_bodies.set_used(0);
@@ -115,10 +212,34 @@ namespace physics {
 
     void advanceSimulation2();
 
-    void createNewtonWorld();
+    //! Create the world, its jobs run on the job manager when one is given
+    void createNewtonWorld(CJobManager *jobs = (CJobManager*)NULL, irr::s32 architecture = PHYSICS_ARCHITECTURE_BEST);
+
+    //! Simulate the test scene for some steps with every platform
+    //! architecture and print the solver time per step
+    void benchmark(irr::u32 steps);
+
+    //! Broadphase of the world, and of the worlds created later
+    void setBroadphase(irr::s32 broadphase);
+
+    //! Time the collision update, ray casts and box queries on the loaded
+    //! level with every broadphase and print the results
+    void benchmarkBroadphase(irr::u32 queries);
+
+    //! Queue one of Newton's jobs (island, broadphase cell) on the job manager
+    void submitNewtonJob(void *job);
 
+    //! Run and wait for the queued Newton jobs
+    void waitNewtonJobs();
+
+    //! One Newton step of the configured length
     void advanceSimulation3(irr::f32 time);
 
+    //! Length of a Newton step (seconds)
+    void setTimeStep(irr::f32 step);
+
+    irr::f32 getTimeStep();
+
     NewtonWorld* getNewtonWorld() { return m_NewtonWorld; }
 
     void closeNewtonWorld();
@@ -127,10 +248,32 @@ namespace physics {
 
     CBody * createBody(SBodyCreationParameters params);
 
+    //! Body of a static mesh without a Newton body of its own: the faces are
+    //! added to the regions they lie in and collide once buildStaticWorld() ran
+    CBody * createStaticBody(SBodyCreationParameters params, const irr::core::matrix4& transformation);
+
+    //! (Re)create the tree collision body of every region with new faces
+    void buildStaticWorld();
+
+    //! Static body owning a face attribute, NULL if there is none
+    CBody * getStaticBody(irr::s32 attribute);
+
+    irr::u32 getStaticBodyCount() { return static_bodies.size(); }
+
+    irr::u32 getStaticRegionCount() { return static_regions.size(); }
+
     NewtonCollision * createCollisionFromBodyParameters(SBodyCreationParameters params);
 
     SRayCastResult getRayCollision(SRayCastParameters);
 
+    //! Cast every segment of the batch. The segments are split over the job
+    //! threads when there are enough of them. With batch.wake the hit bodies
+    //! are woken afterwards, on the calling thread.
+    void getRayCollisions(SRayBatch& batch);
+
+    //! Cast a range of the batch's segments (a job of getRayCollisions)
+    void castRays(SRayBatch& batch, irr::u32 first, irr::u32 count);
+
     SConvexCastResult getConvexCollision(SConvexCastParameters);
 
     void drawDebug(irr::video::IVideoDriver *driver, NewtonBody *Body);
@@ -142,14 +285,30 @@ namespace physics {
 
     irr::u32 getUniqueBodyID() { return m_UniqueBodyID++; }
 
+    irr::u32 getBodyCount() { return all_bodies.size(); }
+
     CCollisionManager * getCollisionManager() { return &collisionManager; }
 
   protected:
 
+    //! World size, solver model and job scheduler of a new world
+    void configureWorld(NewtonWorld *world);
+
     NewtonWorld* m_NewtonWorld;
 
     irr::ITimer * m_Timer;
 
+    CJobManager * m_Jobs;
+
+    irr::s32 m_Broadphase;
+
+    // Newton jobs of the current barrier
+    SJobCounter m_NewtonJobs;
+
+    // Ranges of the ray batch being cast, one per job
+    irr::core::array<SRayBatchJob> m_RayJobs;
+    SJobCounter m_RayJobCounter;
+
     CCollisionManager collisionManager;
 
     int g_currentTime;
@@ -166,6 +325,14 @@ namespace physics {
     irr::core::array<CBody*> all_bodies;
 
     irr::u32 m_UniqueBodyID;
+
+    void addStaticFace(const irr::core::vector3df* face, irr::s32 attribute);
+
+    // Bodies of the merged static meshes, by face attribute - 1
+    irr::core::array<CBody*> static_bodies;
+
+    // Regions by their grid cell (x and z packed in 16 bits each)
+    irr::core::map<irr::u32, SStaticRegion*> static_regions;
   };
 
 } // physics namespace
@@ -23,6 +23,12 @@ namespace scene
 		{
 			VertexBuffer=new CVertexBuffer(vertexType);
 			IndexBuffer=new CIndexBuffer(indexType);
+
+			for (u32 i=0; i<DIRTY_HISTORY; ++i)
+			{
+				DirtyVertexFirst[i]=0;
+				DirtyVertexCount[i]=0;
+			}
 		}
 
 		//! destructor
@@ -64,6 +70,38 @@ namespace scene
 			IndexBuffer=newIndexBuffer;
 		}
 
+		//! flags the mesh as changed, reloads hardware buffers
+		virtual void setDirty(E_BUFFER_TYPE Buffer=EBT_VERTEX_AND_INDEX)
+		{
+			IDynamicMeshBuffer::setDirty(Buffer);
+
+			// a count of 0 means the whole buffer changed
+			if (Buffer==EBT_VERTEX_AND_INDEX || Buffer==EBT_VERTEX)
+				DirtyVertexCount[getChangedID_Vertex() % DIRTY_HISTORY]=0;
+		}
+
+		//! flags a range of vertices as changed
+		virtual void setDirtyVertices(u32 first, u32 count)
+		{
+			if (!count)
+				return;
+			getVertexBuffer().setDirty();
+			DirtyVertexFirst[getChangedID_Vertex() % DIRTY_HISTORY]=first;
+			DirtyVertexCount[getChangedID_Vertex() % DIRTY_HISTORY]=count;
+		}
+
+		//! Get the vertices changed by one change of the vertex buffer.
+		virtual bool getDirtyVertices(u32 changedID, u32& first, u32& count) const
+		{
+			// only the last changes are remembered
+			const u32 current=getChangedID_Vertex();
+			if (changedID > current || current - changedID >= DIRTY_HISTORY)
+				return false;
+			first=DirtyVertexFirst[changedID % DIRTY_HISTORY];
+			count=DirtyVertexCount[changedID % DIRTY_HISTORY];
+			return count != 0;
+		}
+
 		//! Get Material of this buffer.
 		virtual const video::SMaterial& getMaterial() const
 		{
@@ -106,6 +144,11 @@ namespace scene
 	private:
 		IVertexBuffer *VertexBuffer;
 		IIndexBuffer *IndexBuffer;
+
+		//! Ranges of the last vertex changes, by the change ID of the vertex buffer
+		enum { DIRTY_HISTORY=8 };
+		u32 DirtyVertexFirst[DIRTY_HISTORY];
+		u32 DirtyVertexCount[DIRTY_HISTORY];
 	};
 
 
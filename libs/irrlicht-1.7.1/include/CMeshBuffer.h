@@ -20,6 +20,8 @@ namespace scene
 		//! Default constructor for empty meshbuffer
 		CMeshBuffer():ChangedID_Vertex(1),ChangedID_Index(1),MappingHint_Vertex(EHM_NEVER), MappingHint_Index(EHM_NEVER)
 		{
+			for (u32 i=0; i<DIRTY_HISTORY; ++i)
+				DirtyVertexCount[i]=0;
 			#ifdef _DEBUG
 			setDebugName("SMeshBuffer");
 			#endif
@@ -257,11 +259,36 @@ namespace scene
 		virtual void setDirty(E_BUFFER_TYPE Buffer=EBT_VERTEX_AND_INDEX)
 		{
 			if (Buffer==EBT_VERTEX_AND_INDEX ||Buffer==EBT_VERTEX)
+			{
 				++ChangedID_Vertex;
+				// a count of 0 means the whole buffer changed
+				DirtyVertexCount[ChangedID_Vertex % DIRTY_HISTORY]=0;
+			}
 			if (Buffer==EBT_VERTEX_AND_INDEX || Buffer==EBT_INDEX)
 				++ChangedID_Index;
 		}
 
+		//! flags a range of vertices as changed
+		virtual void setDirtyVertices(u32 first, u32 count)
+		{
+			if (!count)
+				return;
+			++ChangedID_Vertex;
+			DirtyVertexFirst[ChangedID_Vertex % DIRTY_HISTORY]=first;
+			DirtyVertexCount[ChangedID_Vertex % DIRTY_HISTORY]=count;
+		}
+
+		//! Get the vertices changed by one change of the vertex buffer.
+		virtual bool getDirtyVertices(u32 changedID, u32& first, u32& count) const
+		{
+			// only the last changes are remembered
+			if (changedID > ChangedID_Vertex || ChangedID_Vertex - changedID >= DIRTY_HISTORY)
+				return false;
+			first=DirtyVertexFirst[changedID % DIRTY_HISTORY];
+			count=DirtyVertexCount[changedID % DIRTY_HISTORY];
+			return count != 0;
+		}
+
 		//! Get the currently used ID for identification of changes.
 		/** This shouldn't be used for anything outside the VideoDriver. */
 		virtual u32 getChangedID_Vertex() const {return ChangedID_Vertex;}
@@ -273,6 +300,11 @@ namespace scene
 		u32 ChangedID_Vertex;
 		u32 ChangedID_Index;
 
+		//! Ranges of the last vertex changes, by ChangedID_Vertex
+		enum { DIRTY_HISTORY=8 };
+		u32 DirtyVertexFirst[DIRTY_HISTORY];
+		u32 DirtyVertexCount[DIRTY_HISTORY];
+
 		//! hardware mapping hint
 		E_HARDWARE_MAPPING MappingHint_Vertex;
 		E_HARDWARE_MAPPING MappingHint_Index;
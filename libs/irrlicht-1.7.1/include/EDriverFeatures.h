@@ -106,6 +106,9 @@ namespace video
 		//! Supports geometry shaders
 		EVDF_GEOMETRY_SHADER,
 
+		//! Supports drawing many copies of a mesh buffer with one call
+		EVDF_INSTANCING,
+
 		//! Only used for counting the elements of this enum
 		EVDF_COUNT
 	};
@@ -144,6 +144,28 @@ namespace scene
 		//! Get the currently used ID for identification of changes.
 		/** This shouldn't be used for anything outside the VideoDriver. */
 		virtual u32 getChangedID_Index() const = 0;
+
+		//! flags a range of vertices as changed
+		/** Drivers which support it upload only the changed ranges to the
+		hardware buffer. The default flags the whole vertex buffer.
+		\param first Index of the first changed vertex.
+		\param count Number of changed vertices. */
+		virtual void setDirtyVertices(u32 first, u32 count)
+		{
+			setDirty(EBT_VERTEX);
+		}
+
+		//! Get the vertices changed by one change of the vertex buffer.
+		/** This shouldn't be used for anything outside the VideoDriver.
+		\param changedID Value of getChangedID_Vertex() right after the change.
+		\param first Receives the first changed vertex.
+		\param count Receives the number of changed vertices.
+		eturn False if the change is not known as a range, and the whole
+		buffer has to be uploaded. */
+		virtual bool getDirtyVertices(u32 changedID, u32& first, u32& count) const
+		{
+			return false;
+		}
 	};
 
 } // end namespace scene
@@ -220,6 +220,52 @@ namespace scene
 		IReferenceCounted::drop() for more information. */
 		virtual IMesh* createMeshWelded(IMesh* mesh, f32 tolerance=core::ROUNDING_ERROR_f32) const = 0;
 
+		//! Creates a lower detail copy of a mesh buffer
+		/** Edges are collapsed in order of their quadric error until
+		the triangle count drops to the given ratio. Vertices on open
+		edges (mesh borders and texture or normal seams) are kept in
+		place, so the outline and seams of the buffer don't tear.
+		The copy has the index type of mb.
+		\param mb Input mesh buffer
+		\param ratio Part of the triangles to keep, between 0 and 1.
+		\return Simplified buffer with the material of mb, or 0 if
+		the buffer can't be simplified. If you no longer need it, you
+		should call IMeshBuffer::drop(). See
+		IReferenceCounted::drop() for more information. */
+		virtual IMeshBuffer* createSimplifiedMeshBuffer(const IMeshBuffer* mb, f32 ratio) const = 0;
+
+		//! Creates a lower detail copy of a mesh
+		/** Every mesh buffer is simplified with
+		createSimplifiedMeshBuffer(), the copy has the same number of
+		buffers as the input mesh.
+		\param mesh Input mesh
+		\param ratio Part of the triangles to keep, between 0 and 1.
+		\return Simplified mesh. If you no longer need it, you should
+		call IMesh::drop(). See IReferenceCounted::drop() for more
+		information. */
+		virtual IMesh* createSimplifiedMesh(IMesh* mesh, f32 ratio) const = 0;
+
+		//! Reorders the triangles and vertices of a mesh buffer for the GPU caches
+		/** Triangles are sorted for the post transform vertex cache
+		(Tipsify), the clusters this produces are ordered so that
+		surfaces facing away from the center of the buffer are drawn
+		first, which reduces overdraw. Finally the vertices are stored
+		in the order they are first used, for the pre transform cache.
+		The buffer keeps its triangles and is marked dirty.
+		\param mb Mesh buffer to optimize
+		\param cacheSize Vertices the post transform cache holds. */
+		virtual void optimizeMeshBuffer(IMeshBuffer* mb, u32 cacheSize=16) const = 0;
+
+		//! Measures how well a mesh buffer uses a FIFO vertex cache
+		/** \param mb Mesh buffer to measure
+		\param acmr Receives the average cache miss ratio, vertices
+		transformed per triangle. 0.5 is the best possible, 3 means
+		every vertex is transformed for every triangle.
+		\param atvr Receives the average transformed vertex ratio,
+		vertices transformed per vertex used. 1 is the best possible.
+		\param cacheSize Vertices the simulated cache holds. */
+		virtual void getVertexCacheStats(const IMeshBuffer* mb, f32& acmr, f32& atvr, u32 cacheSize=16) const = 0;
+
 		//! Get amount of polygons in mesh.
 		/** \param mesh Input mesh
 		\return Number of polygons in mesh. */
@@ -142,6 +142,21 @@ namespace video
 		0
 	};
 
+	//! Enum for the per frame render counters of the driver
+	enum E_RENDER_STATISTIC
+	{
+		//! Calls which draw primitives, 2d and 3d
+		ERS_DRAW_CALLS=0,
+		//! Textures bound to a texture unit
+		ERS_TEXTURE_BINDS,
+		//! Shader programs made active
+		ERS_SHADER_BINDS,
+		//! Bytes of vertex and index data uploaded to hardware buffers
+		ERS_UPLOAD_BYTES,
+		//! Not used, counts the statistics
+		ERS_COUNT
+	};
+
 	struct SOverrideMaterial
 	{
 		//! The Material values
@@ -227,6 +242,20 @@ namespace video
 		bool BlendEnable;
 	};
 
+	//! Part of a driver's work handed to the application's job scheduler
+	/** Drivers derive their own job data from it. */
+	struct SDriverJob
+	{
+		//! Does the work, on any thread of the scheduler
+		void (*Run)(SDriverJob* job);
+	};
+
+	//! Called by the driver for every job it splits its work into
+	typedef void (*DriverJobSubmit)(void* userData, SDriverJob* job);
+
+	//! Called by the driver when all submitted jobs have to be done
+	typedef void (*DriverJobWait)(void* userData);
+
 	//! Interface to driver which is able to perform 2d and 3d graphics functions.
 	/** This interface is one of the most important interfaces of
 	the Irrlicht Engine: All rendering and texture manipulation is done with
@@ -940,6 +969,36 @@ namespace video
 		/** \param mb Buffer to draw; */
 		virtual void drawMeshBuffer(const scene::IMeshBuffer* mb) =0;
 
+		//! Draws a mesh buffer once for each transformation
+		/** The world transformation is replaced by each of the matrices.
+		Drivers supporting EVDF_INSTANCING draw all copies with one call
+		when the current material allows it, the others draw them one
+		by one. The world transformation is undefined afterwards.
+		\param mb Buffer to draw.
+		\param transforms World matrices of the copies.
+		\param count Number of copies.
+		\return True if the copies were drawn with one instanced call,
+		false if they were drawn one by one. */
+		virtual bool drawMeshBufferInstanced(const scene::IMeshBuffer* mb,
+			const core::matrix4* transforms, u32 count) =0;
+
+		//! Returns if drawMeshBufferInstanced draws copies with this material in one call
+		/** \param material Material the copies would be drawn with.
+		eturn False if the copies would be drawn one by one. */
+		virtual bool canDrawInstanced(const SMaterial& material) const =0;
+
+		//! Runs the parallel work of the driver as jobs of the application
+		/** Drivers rasterizing on the CPU stop their own worker threads
+		and split a batch into jobs handed to submit instead, the calling
+		thread takes part in each batch before calling wait. The other
+		drivers ignore it.
+		\param threads Threads the scheduler runs jobs on, the caller included.
+		\param submit Called for every job. 0 returns to the driver's own threads.
+		\param wait Called when the submitted jobs have to be done.
+		\param userData Passed to submit and wait. */
+		virtual void setJobScheduler(u32 threads, DriverJobSubmit submit,
+			DriverJobWait wait, void* userData) =0;
+
 		//! Sets the fog mode.
 		/** These are global values attached to each 3d object rendered,
 		which has the fog flag enabled in its material.
@@ -997,6 +1056,12 @@ namespace video
 		\return Amount of primitives drawn in the last frame. */
 		virtual u32 getPrimitiveCountDrawn( u32 mode =0 ) const =0;
 
+		//! Returns a render counter of the last frame.
+		/** Drivers which don't track a counter return 0 for it.
+		\param statistic Which counter to return.
+		eturn Value of the counter in the last frame. */
+		virtual u32 getRenderStatistic(E_RENDER_STATISTIC statistic) const =0;
+
 		//! Deletes all dynamic lights which were previously added with addDynamicLight().
 		virtual void deleteAllDynamicLights() =0;
 
@@ -68,6 +68,16 @@ typedef signed int		s32;
 
 
 
+//! 64 bit unsigned variable.
+/** This is a typedef for 64bit uint, it ensures portability of the engine. */
+#if defined(_MSC_VER) || ((__BORLANDC__ >= 0x530) && !defined(__STRICT_ANSI__))
+typedef unsigned __int64			u64;
+#elif __GNUC__
+__extension__ typedef unsigned long long	u64;
+#else
+typedef unsigned long long			u64;
+#endif
+
 // 64 bit signed variable.
 // This is a typedef for __int64, it ensures portability of the engine.
 // This type is currently not used by the engine and not supported by compilers
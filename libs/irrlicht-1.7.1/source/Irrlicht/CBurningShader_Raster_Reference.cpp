@@ -516,6 +516,8 @@ public:
 
 	virtual void setMaterial ( const SBurningShaderMaterial &material );
 
+	//! scanlines are not clipped to tiles
+	virtual bool canDrawTiles() const { return false; }
 
 private:
 	void scanline ();
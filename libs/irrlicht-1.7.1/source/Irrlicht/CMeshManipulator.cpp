@@ -5,6 +5,7 @@
 #include "CMeshManipulator.h"
 #include "SMesh.h"
 #include "CMeshBuffer.h"
+#include "CDynamicMeshBuffer.h"
 #include "SAnimatedMesh.h"
 #include "os.h"
 #include "irrMap.h"
@@ -1074,6 +1075,1031 @@ void CMeshManipulator::calculateTangents(
 
 
 
+namespace
+{
+
+//! Copies the indices of a buffer with either index type
+void getIndexList(const IMeshBuffer* mb, core::array<u32>& indices)
+{
+	const u32 indexCount = mb->getIndexCount();
+	indices.set_used(indexCount);
+
+	if (mb->getIndexType() == video::EIT_32BIT)
+	{
+		const u32* source = (const u32*)mb->getIndices();
+		for (u32 i=0; i<indexCount; ++i)
+			indices[i] = source[i];
+	}
+	else
+	{
+		const u16* source = mb->getIndices();
+		for (u32 i=0; i<indexCount; ++i)
+			indices[i] = source[i];
+	}
+}
+
+//! Symmetric 4x4 error quadric of the planes around a vertex
+struct SQuadric
+{
+	f64 A[10];
+
+	void reset()
+	{
+		for (u32 i=0; i<10; ++i)
+			A[i] = 0.0;
+	}
+
+	void addPlane(f64 a, f64 b, f64 c, f64 d, f64 weight)
+	{
+		A[0] += weight*a*a; A[1] += weight*a*b; A[2] += weight*a*c; A[3] += weight*a*d;
+		A[4] += weight*b*b; A[5] += weight*b*c; A[6] += weight*b*d;
+		A[7] += weight*c*c; A[8] += weight*c*d;
+		A[9] += weight*d*d;
+	}
+
+	void add(const SQuadric& other)
+	{
+		for (u32 i=0; i<10; ++i)
+			A[i] += other.A[i];
+	}
+
+	//! Sum of the squared distances of p to the planes
+	f64 error(const core::vector3df& p) const
+	{
+		const f64 x = p.X, y = p.Y, z = p.Z;
+
+		return A[0]*x*x + 2.0*A[1]*x*y + 2.0*A[2]*x*z + 2.0*A[3]*x
+			+ A[4]*y*y + 2.0*A[5]*y*z + 2.0*A[6]*y
+			+ A[7]*z*z + 2.0*A[8]*z
+			+ A[9];
+	}
+};
+
+//! Candidate collapse of vertex From into vertex To. It is stale when one of
+//! the vertices changed after it was queued.
+struct SCollapse
+{
+	f64 Cost;
+	u32 From, To;
+	u32 FromStamp, ToStamp;
+};
+
+//! Binary min heap of collapses
+class CCollapseHeap
+{
+public:
+
+	bool empty() const
+	{
+		return Items.size() == 0;
+	}
+
+	void push(const SCollapse& c)
+	{
+		Items.push_back(c);
+
+		u32 i = Items.size() - 1;
+		while (i > 0)
+		{
+			const u32 parent = (i - 1) / 2;
+			if (Items[parent].Cost <= Items[i].Cost)
+				break;
+
+			const SCollapse tmp = Items[parent];
+			Items[parent] = Items[i];
+			Items[i] = tmp;
+			i = parent;
+		}
+	}
+
+	SCollapse pop()
+	{
+		const SCollapse top = Items[0];
+
+		Items[0] = Items.getLast();
+		Items.set_used(Items.size() - 1);
+
+		const u32 size = Items.size();
+		u32 i = 0;
+		while (true)
+		{
+			const u32 left = i * 2 + 1;
+			const u32 right = left + 1;
+			u32 smallest = i;
+
+			if (left < size && Items[left].Cost < Items[smallest].Cost)
+				smallest = left;
+			if (right < size && Items[right].Cost < Items[smallest].Cost)
+				smallest = right;
+			if (smallest == i)
+				break;
+
+			const SCollapse tmp = Items[smallest];
+			Items[smallest] = Items[i];
+			Items[i] = tmp;
+			i = smallest;
+		}
+
+		return top;
+	}
+
+private:
+
+	core::array<SCollapse> Items;
+};
+
+struct SSimplifyEdge
+{
+	u32 A, B;
+
+	bool operator<(const SSimplifyEdge& other) const
+	{
+		return A < other.A || (A == other.A && B < other.B);
+	}
+};
+
+//! State of one quadric edge collapse simplification
+class CTriangleSimplifier
+{
+public:
+
+	CTriangleSimplifier(const IMeshBuffer* mb) : Buffer(mb), AliveTriangles(0), Token(0)
+	{
+		weld();
+		buildTriangles();
+		buildQuadrics();
+		lockOpenEdges();
+	}
+
+	//! Collapse edges until targetTriangles are left or nothing can be collapsed
+	void run(u32 targetTriangles)
+	{
+		while (AliveTriangles > targetTriangles && !Heap.empty())
+		{
+			const SCollapse c = Heap.pop();
+
+			if (Removed[c.From] || Removed[c.To] ||
+				Stamps[c.From] != c.FromStamp || Stamps[c.To] != c.ToStamp)
+				continue;
+
+			if (!canCollapse(c.From, c.To))
+				continue;
+
+			collapse(c.From, c.To);
+		}
+	}
+
+	//! Surviving vertices (indices into the input buffer) and the triangles indexing them
+	void getResult(core::array<u32>& keep, core::array<u32>& indices)
+	{
+		core::array<u32> newIndex;
+		newIndex.set_used(Positions);
+		for (u32 i=0; i<Positions; ++i)
+			newIndex[i] = 0xffffffff;
+
+		keep.set_used(0);
+		indices.set_used(0);
+		indices.reallocate(AliveTriangles * 3);
+
+		// vertices in order of first use
+		for (u32 t=0; t<TriangleAlive.size(); ++t)
+		{
+			if (!TriangleAlive[t])
+				continue;
+
+			for (u32 k=0; k<3; ++k)
+			{
+				const u32 v = Triangles[t*3+k];
+				if (newIndex[v] == 0xffffffff)
+				{
+					newIndex[v] = keep.size();
+					keep.push_back(v);
+				}
+				indices.push_back(newIndex[v]);
+			}
+		}
+	}
+
+private:
+
+	// Vertices equal in every attribute are shared, so the triangles of a
+	// smooth surface are connected even if the exporter split them
+	void weld()
+	{
+		const u32 vertexCount = Buffer->getVertexCount();
+		const u32 pitch = video::getVertexPitchFromType(Buffer->getVertexType());
+		const u8* data = (const u8*)Buffer->getVertices();
+
+		u32 tableSize = 1;
+		while (tableSize < vertexCount * 2)
+			tableSize <<= 1;
+
+		core::array<u32> table;
+		table.set_used(tableSize);
+		for (u32 i=0; i<tableSize; ++i)
+			table[i] = 0xffffffff;
+
+		Remap.set_used(vertexCount);
+
+		for (u32 i=0; i<vertexCount; ++i)
+		{
+			const u8* vertex = data + i * pitch;
+
+			// FNV-1a
+			u32 hash = 2166136261u;
+			for (u32 b=0; b<pitch; ++b)
+				hash = (hash ^ vertex[b]) * 16777619u;
+
+			u32 slot = hash & (tableSize - 1);
+			while (true)
+			{
+				if (table[slot] == 0xffffffff)
+				{
+					table[slot] = i;
+					Remap[i] = i;
+					break;
+				}
+				if (memcmp(data + table[slot] * pitch, vertex, pitch) == 0)
+				{
+					Remap[i] = table[slot];
+					break;
+				}
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+
+		Positions = vertexCount;
+	}
+
+	void buildTriangles()
+	{
+		core::array<u32> idx;
+		getIndexList(Buffer, idx);
+
+		const u32 triangleCount = idx.size() / 3;
+
+		Triangles.reallocate(triangleCount * 3);
+
+		for (u32 t=0; t<triangleCount; ++t)
+		{
+			const u32 a = Remap[idx[t*3+0]];
+			const u32 b = Remap[idx[t*3+1]];
+			const u32 c = Remap[idx[t*3+2]];
+
+			// degenerate triangles are dropped
+			if (a == b || b == c || a == c)
+				continue;
+
+			Triangles.push_back(a);
+			Triangles.push_back(b);
+			Triangles.push_back(c);
+		}
+
+		AliveTriangles = Triangles.size() / 3;
+
+		TriangleAlive.set_used(AliveTriangles);
+		for (u32 t=0; t<AliveTriangles; ++t)
+			TriangleAlive[t] = true;
+
+		VertexTriangles.reallocate(Positions);
+		for (u32 i=0; i<Positions; ++i)
+			VertexTriangles.push_back(core::array<u32>());
+
+		for (u32 t=0; t<AliveTriangles; ++t)
+			for (u32 k=0; k<3; ++k)
+				VertexTriangles[Triangles[t*3+k]].push_back(t);
+
+		Removed.set_used(Positions);
+		Locked.set_used(Positions);
+		Stamps.set_used(Positions);
+		Marks.set_used(Positions);
+		for (u32 i=0; i<Positions; ++i)
+		{
+			Removed[i] = false;
+			Locked[i] = false;
+			Stamps[i] = 0;
+			Marks[i] = 0;
+		}
+	}
+
+	void buildQuadrics()
+	{
+		Quadrics.set_used(Positions);
+		for (u32 i=0; i<Positions; ++i)
+			Quadrics[i].reset();
+
+		for (u32 t=0; t<AliveTriangles; ++t)
+		{
+			const core::vector3df& p0 = Buffer->getPosition(Triangles[t*3+0]);
+			const core::vector3df& p1 = Buffer->getPosition(Triangles[t*3+1]);
+			const core::vector3df& p2 = Buffer->getPosition(Triangles[t*3+2]);
+
+			core::vector3df n = (p1 - p0).crossProduct(p2 - p0);
+			const f64 length = n.getLength();
+			if (length <= 0.0)
+				continue;
+
+			n /= (f32)length;
+
+			// planes are weighted by the triangle area
+			const f64 d = -n.dotProduct(p0);
+			for (u32 k=0; k<3; ++k)
+				Quadrics[Triangles[t*3+k]].addPlane(n.X, n.Y, n.Z, d, length * 0.5);
+		}
+	}
+
+	// Edges used by a single triangle are borders or seams between vertices
+	// with different attributes, edges used by more than two are non manifold.
+	// Their vertices never move.
+	void lockOpenEdges()
+	{
+		core::array<SSimplifyEdge> edges;
+		edges.reallocate(AliveTriangles * 3);
+
+		for (u32 t=0; t<AliveTriangles; ++t)
+		{
+			for (u32 k=0; k<3; ++k)
+			{
+				const u32 a = Triangles[t*3+k];
+				const u32 b = Triangles[t*3+(k+1)%3];
+
+				SSimplifyEdge e;
+				e.A = core::min_(a, b);
+				e.B = core::max_(a, b);
+				edges.push_back(e);
+			}
+		}
+
+		edges.sort();
+
+		u32 first = 0;
+		while (first < edges.size())
+		{
+			u32 last = first + 1;
+			while (last < edges.size() && edges[last].A == edges[first].A && edges[last].B == edges[first].B)
+				++last;
+
+			if (last - first != 2)
+			{
+				Locked[edges[first].A] = true;
+				Locked[edges[first].B] = true;
+			}
+
+			first = last;
+		}
+
+		for (u32 i=0; i<edges.size(); ++i)
+			if (i == 0 || edges[i].A != edges[i-1].A || edges[i].B != edges[i-1].B)
+				queueEdge(edges[i].A, edges[i].B);
+	}
+
+	//! Queue the cheaper direction of collapsing the edge a-b
+	void queueEdge(u32 a, u32 b)
+	{
+		if (Locked[a] && Locked[b])
+			return;
+
+		SQuadric q = Quadrics[a];
+		q.add(Quadrics[b]);
+
+		SCollapse c;
+		c.Cost = 0.0;
+		c.From = a;
+		c.To = b;
+
+		if (Locked[a])
+		{
+			c.From = b;
+			c.To = a;
+			c.Cost = q.error(Buffer->getPosition(a));
+		}
+		else if (Locked[b])
+			c.Cost = q.error(Buffer->getPosition(b));
+		else
+		{
+			const f64 toB = q.error(Buffer->getPosition(b));
+			const f64 toA = q.error(Buffer->getPosition(a));
+
+			c.Cost = toB;
+			if (toA < toB)
+			{
+				c.From = b;
+				c.To = a;
+				c.Cost = toA;
+			}
+		}
+
+		c.FromStamp = Stamps[c.From];
+		c.ToStamp = Stamps[c.To];
+		Heap.push(c);
+	}
+
+	static bool hasVertex(const u32* triangle, u32 v)
+	{
+		return triangle[0] == v || triangle[1] == v || triangle[2] == v;
+	}
+
+	//! The collapse flips no triangle and keeps the surface manifold
+	bool canCollapse(u32 from, u32 to)
+	{
+		const core::vector3df& target = Buffer->getPosition(to);
+		const core::array<u32>& fromTriangles = VertexTriangles[from];
+
+		u32 shared = 0;
+
+		++Token;
+		for (u32 i=0; i<fromTriangles.size(); ++i)
+		{
+			const u32 t = fromTriangles[i];
+			if (!TriangleAlive[t])
+				continue;
+
+			const u32* tri = &Triangles[t*3];
+
+			for (u32 k=0; k<3; ++k)
+				Marks[tri[k]] = Token;
+
+			if (hasVertex(tri, to))
+			{
+				++shared;
+				continue;
+			}
+
+			core::vector3df before[3], after[3];
+			for (u32 k=0; k<3; ++k)
+			{
+				before[k] = Buffer->getPosition(tri[k]);
+				after[k] = tri[k] == from ? target : before[k];
+			}
+
+			const core::vector3df oldNormal = (before[1] - before[0]).crossProduct(before[2] - before[0]);
+			const core::vector3df newNormal = (after[1] - after[0]).crossProduct(after[2] - after[0]);
+
+			const f32 oldLength = oldNormal.getLength();
+			const f32 newLength = newNormal.getLength();
+
+			if (newLength <= oldLength * 0.001f)
+				return false;
+
+			// turning more than about 80 degrees counts as a flip
+			if (oldNormal.dotProduct(newNormal) < 0.2f * oldLength * newLength)
+				return false;
+		}
+
+		if (shared == 0)
+			return false;
+
+		// link condition: the only vertices next to both are the opposite
+		// corners of the triangles that share the edge
+		const u32 fromToken = Token;
+		const u32 commonToken = ++Token;
+		u32 common = 0;
+
+		const core::array<u32>& toTriangles = VertexTriangles[to];
+		for (u32 i=0; i<toTriangles.size(); ++i)
+		{
+			const u32 t = toTriangles[i];
+			if (!TriangleAlive[t])
+				continue;
+
+			for (u32 k=0; k<3; ++k)
+			{
+				const u32 v = Triangles[t*3+k];
+				if (v == from || v == to || Marks[v] != fromToken)
+					continue;
+
+				Marks[v] = commonToken;
+				++common;
+			}
+		}
+
+		return common == shared;
+	}
+
+	void collapse(u32 from, u32 to)
+	{
+		core::array<u32>& fromTriangles = VertexTriangles[from];
+		core::array<u32>& toTriangles = VertexTriangles[to];
+
+		for (u32 i=0; i<fromTriangles.size(); ++i)
+		{
+			const u32 t = fromTriangles[i];
+			if (!TriangleAlive[t])
+				continue;
+
+			u32* tri = &Triangles[t*3];
+
+			if (hasVertex(tri, to))
+			{
+				TriangleAlive[t] = false;
+				--AliveTriangles;
+				continue;
+			}
+
+			for (u32 k=0; k<3; ++k)
+				if (tri[k] == from)
+					tri[k] = to;
+
+			toTriangles.push_back(t);
+		}
+
+		fromTriangles.clear();
+
+		Removed[from] = true;
+		Quadrics[to].add(Quadrics[from]);
+		++Stamps[from];
+		++Stamps[to];
+
+		// drop the removed triangles and queue the edges around the vertex again
+		++Token;
+		u32 alive = 0;
+		for (u32 i=0; i<toTriangles.size(); ++i)
+		{
+			const u32 t = toTriangles[i];
+			if (!TriangleAlive[t])
+				continue;
+
+			toTriangles[alive++] = t;
+
+			for (u32 k=0; k<3; ++k)
+			{
+				const u32 v = Triangles[t*3+k];
+				if (v == to || Marks[v] == Token)
+					continue;
+
+				Marks[v] = Token;
+				queueEdge(to, v);
+			}
+		}
+		toTriangles.set_used(alive);
+	}
+
+	const IMeshBuffer* Buffer;
+
+	u32 Positions;
+	core::array<u32> Remap;
+
+	core::array<u32> Triangles;
+	core::array<bool> TriangleAlive;
+	u32 AliveTriangles;
+
+	core::array<core::array<u32> > VertexTriangles;
+	core::array<SQuadric> Quadrics;
+	core::array<bool> Removed, Locked;
+	core::array<u32> Stamps;
+
+	core::array<u32> Marks;
+	u32 Token;
+
+	CCollapseHeap Heap;
+};
+
+} // end anonymous namespace
+
+
+//! Creates a lower detail copy of a mesh buffer by quadric edge collapse.
+IMeshBuffer* CMeshManipulator::createSimplifiedMeshBuffer(const IMeshBuffer* mb, f32 ratio) const
+{
+	if (!mb || mb->getIndexCount() < 3)
+		return 0;
+
+	if (mb->getVertexType() != video::EVT_STANDARD &&
+		mb->getVertexType() != video::EVT_2TCOORDS &&
+		mb->getVertexType() != video::EVT_TANGENTS)
+	{
+		os::Printer::log("Cannot simplify mesh buffer, vertex type unsupported", ELL_ERROR);
+		return 0;
+	}
+
+	ratio = core::clamp(ratio, 0.f, 1.f);
+
+	core::array<u32> keep;
+	core::array<u32> indices;
+	{
+		CTriangleSimplifier simplifier(mb);
+		simplifier.run((u32)(mb->getIndexCount() / 3 * ratio));
+		simplifier.getResult(keep, indices);
+	}
+
+	// buffers with 32 bit indices keep them
+	if (mb->getIndexType() == video::EIT_32BIT)
+	{
+		CDynamicMeshBuffer* buffer = new CDynamicMeshBuffer(mb->getVertexType(), video::EIT_32BIT);
+		buffer->Material = mb->getMaterial();
+
+		const u32 pitch = video::getVertexPitchFromType(mb->getVertexType());
+		const u8* v = (const u8*)mb->getVertices();
+
+		buffer->getVertexBuffer().reallocate(keep.size());
+		for (u32 i=0; i<keep.size(); ++i)
+			buffer->getVertexBuffer().push_back(*(const video::S3DVertex*)(v + keep[i] * pitch));
+
+		buffer->getIndexBuffer().reallocate(indices.size());
+		for (u32 i=0; i<indices.size(); ++i)
+			buffer->getIndexBuffer().push_back(indices[i]);
+
+		buffer->recalculateBoundingBox();
+		return buffer;
+	}
+
+	switch(mb->getVertexType())
+	{
+	case video::EVT_STANDARD:
+		{
+			SMeshBuffer* buffer = new SMeshBuffer();
+			buffer->Material = mb->getMaterial();
+
+			const video::S3DVertex* v = (const video::S3DVertex*)mb->getVertices();
+
+			buffer->Vertices.reallocate(keep.size());
+			for (u32 i=0; i<keep.size(); ++i)
+				buffer->Vertices.push_back(v[keep[i]]);
+
+			buffer->Indices.reallocate(indices.size());
+			for (u32 i=0; i<indices.size(); ++i)
+				buffer->Indices.push_back((u16)indices[i]);
+
+			buffer->recalculateBoundingBox();
+			return buffer;
+		}
+	case video::EVT_2TCOORDS:
+		{
+			SMeshBufferLightMap* buffer = new SMeshBufferLightMap();
+			buffer->Material = mb->getMaterial();
+
+			const video::S3DVertex2TCoords* v = (const video::S3DVertex2TCoords*)mb->getVertices();
+
+			buffer->Vertices.reallocate(keep.size());
+			for (u32 i=0; i<keep.size(); ++i)
+				buffer->Vertices.push_back(v[keep[i]]);
+
+			buffer->Indices.reallocate(indices.size());
+			for (u32 i=0; i<indices.size(); ++i)
+				buffer->Indices.push_back((u16)indices[i]);
+			buffer->recalculateBoundingBox();
+			return buffer;
+		}
+	case video::EVT_TANGENTS:
+		{
+			SMeshBufferTangents* buffer = new SMeshBufferTangents();
+			buffer->Material = mb->getMaterial();
+
+			const video::S3DVertexTangents* v = (const video::S3DVertexTangents*)mb->getVertices();
+
+			buffer->Vertices.reallocate(keep.size());
+			for (u32 i=0; i<keep.size(); ++i)
+				buffer->Vertices.push_back(v[keep[i]]);
+
+			buffer->Indices.reallocate(indices.size());
+			for (u32 i=0; i<indices.size(); ++i)
+				buffer->Indices.push_back((u16)indices[i]);
+			buffer->recalculateBoundingBox();
+			return buffer;
+		}
+	default:
+		return 0;
+	}
+}
+
+
+//! Creates a lower detail copy of a mesh, buffer by buffer.
+IMesh* CMeshManipulator::createSimplifiedMesh(IMesh* mesh, f32 ratio) const
+{
+	if (!mesh)
+		return 0;
+
+	SMesh* clone = new SMesh();
+
+	for (u32 b=0; b<mesh->getMeshBufferCount(); ++b)
+	{
+		IMeshBuffer* buffer = createSimplifiedMeshBuffer(mesh->getMeshBuffer(b), ratio);
+
+		// buffers that can't be simplified are shared with the input mesh
+		if (!buffer)
+		{
+			clone->addMeshBuffer(mesh->getMeshBuffer(b));
+			continue;
+		}
+
+		clone->addMeshBuffer(buffer);
+		buffer->drop();
+	}
+
+	clone->recalculateBoundingBox();
+	return clone;
+}
+
+
+namespace
+{
+
+//! Triangles Tipsify emitted between two dead ends
+struct SOverdrawCluster
+{
+	f32 Key;
+	u32 First, Count;
+
+	// clusters facing away from the center come first
+	bool operator<(const SOverdrawCluster& other) const
+	{
+		return Key > other.Key;
+	}
+};
+
+//! Vertex with triangles left, taken from the dead end stack or by scanning
+s32 skipDeadEnd(core::array<u32>& deadEnd, const core::array<u32>& live, u32& cursor)
+{
+	while (deadEnd.size())
+	{
+		const u32 v = deadEnd.getLast();
+		deadEnd.set_used(deadEnd.size() - 1);
+
+		if (live[v] > 0)
+			return v;
+	}
+
+	for (; cursor < live.size(); ++cursor)
+		if (live[cursor] > 0)
+			return cursor;
+
+	return -1;
+}
+
+} // end anonymous namespace
+
+
+//! Reorders triangles and vertices of a mesh buffer for the vertex caches and less overdraw.
+void CMeshManipulator::optimizeMeshBuffer(IMeshBuffer* mb, u32 cacheSize) const
+{
+	if (!mb || mb->getIndexCount() < 3 || cacheSize == 0)
+		return;
+
+	core::array<u32> indices;
+	getIndexList(mb, indices);
+
+	const u32 indexCount = mb->getIndexCount() - mb->getIndexCount() % 3;
+	const u32 triangleCount = indexCount / 3;
+	const u32 vertexCount = mb->getVertexCount();
+
+	u32 i;
+
+	// triangles around every vertex
+	core::array<u32> live, offsets, adjacency;
+	live.set_used(vertexCount);
+	offsets.set_used(vertexCount + 1);
+	adjacency.set_used(indexCount);
+
+	for (i=0; i<vertexCount; ++i)
+		live[i] = 0;
+	for (i=0; i<indexCount; ++i)
+		++live[indices[i]];
+
+	offsets[0] = 0;
+	for (i=0; i<vertexCount; ++i)
+		offsets[i+1] = offsets[i] + live[i];
+
+	core::array<u32> fill;
+	fill.set_used(vertexCount);
+	for (i=0; i<vertexCount; ++i)
+		fill[i] = offsets[i];
+	for (i=0; i<indexCount; ++i)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	// Tipsify: fan around the vertex that is still in the cache and has few
+	// triangles left, jump to a dead end vertex when none is left
+	core::array<u32> cacheTime, deadEnd, candidates, order, clusterStarts;
+	core::array<bool> emitted;
+
+	cacheTime.set_used(vertexCount);
+	for (i=0; i<vertexCount; ++i)
+		cacheTime[i] = 0;
+
+	emitted.set_used(triangleCount);
+	for (i=0; i<triangleCount; ++i)
+		emitted[i] = false;
+
+	order.reallocate(triangleCount);
+
+	u32 time = cacheSize + 1;
+	u32 cursor = 0;
+	s32 fan = skipDeadEnd(deadEnd, live, cursor);
+
+	clusterStarts.push_back(0);
+
+	while (fan >= 0)
+	{
+		candidates.set_used(0);
+
+		for (u32 a=offsets[fan]; a<offsets[fan+1]; ++a)
+		{
+			const u32 t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (u32 k=0; k<3; ++k)
+			{
+				const u32 v = indices[t*3+k];
+
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+
+			emitted[t] = true;
+			order.push_back(t);
+		}
+
+		s32 next = -1;
+		s32 best = -1;
+
+		for (u32 c=0; c<candidates.size(); ++c)
+		{
+			const u32 v = candidates[c];
+			if (live[v] == 0)
+				continue;
+
+			// still in the cache after its remaining triangles are emitted
+			s32 priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = time - cacheTime[v];
+
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next < 0)
+		{
+			next = skipDeadEnd(deadEnd, live, cursor);
+
+			if (next >= 0 && order.size() > clusterStarts.getLast())
+				clusterStarts.push_back(order.size());
+		}
+
+		fan = next;
+	}
+
+	// order the clusters for overdraw: the ones facing outwards are likely
+	// to hide the rest of the buffer
+	core::vector3df center;
+	f32 totalArea = 0.f;
+
+	core::array<core::vector3df> triangleCenters, triangleNormals;
+	triangleCenters.set_used(triangleCount);
+	triangleNormals.set_used(triangleCount);
+
+	for (i=0; i<triangleCount; ++i)
+	{
+		const core::vector3df& p0 = mb->getPosition(indices[i*3+0]);
+		const core::vector3df& p1 = mb->getPosition(indices[i*3+1]);
+		const core::vector3df& p2 = mb->getPosition(indices[i*3+2]);
+
+		// length of the normal is twice the area
+		triangleNormals[i] = (p1 - p0).crossProduct(p2 - p0);
+		triangleCenters[i] = (p0 + p1 + p2) / 3.f;
+
+		const f32 area = triangleNormals[i].getLength();
+		center += triangleCenters[i] * area;
+		totalArea += area;
+	}
+
+	if (totalArea > 0.f)
+		center /= totalArea;
+
+	core::array<SOverdrawCluster> clusters;
+	clusters.reallocate(clusterStarts.size());
+
+	for (i=0; i<clusterStarts.size(); ++i)
+	{
+		SOverdrawCluster cluster;
+		cluster.First = clusterStarts[i];
+		cluster.Count = (i + 1 < clusterStarts.size() ? clusterStarts[i+1] : order.size()) - cluster.First;
+
+		core::vector3df clusterCenter, clusterNormal;
+		f32 clusterArea = 0.f;
+
+		for (u32 t=cluster.First; t<cluster.First+cluster.Count; ++t)
+		{
+			const f32 area = triangleNormals[order[t]].getLength();
+			clusterCenter += triangleCenters[order[t]] * area;
+			clusterNormal += triangleNormals[order[t]];
+			clusterArea += area;
+		}
+
+		cluster.Key = 0.f;
+		if (clusterArea > 0.f)
+		{
+			clusterCenter /= clusterArea;
+			clusterNormal.normalize();
+			cluster.Key = (clusterCenter - center).dotProduct(clusterNormal);
+		}
+
+		clusters.push_back(cluster);
+	}
+
+	clusters.sort();
+
+	// vertices in order of first use
+	core::array<u32> newIndices;
+	core::array<u32> remap;
+	newIndices.set_used(indexCount);
+	remap.set_used(vertexCount);
+
+	for (i=0; i<vertexCount; ++i)
+		remap[i] = 0xffffffff;
+
+	u32 nextVertex = 0;
+	u32 written = 0;
+
+	for (i=0; i<clusters.size(); ++i)
+	{
+		for (u32 t=clusters[i].First; t<clusters[i].First+clusters[i].Count; ++t)
+		{
+			for (u32 k=0; k<3; ++k)
+			{
+				const u32 v = indices[order[t]*3+k];
+				if (remap[v] == 0xffffffff)
+					remap[v] = nextVertex++;
+
+				newIndices[written++] = remap[v];
+			}
+		}
+	}
+
+	// unused vertices stay at the end
+	for (i=0; i<vertexCount; ++i)
+		if (remap[i] == 0xffffffff)
+			remap[i] = nextVertex++;
+
+	const u32 pitch = video::getVertexPitchFromType(mb->getVertexType());
+	u8* vertices = (u8*)mb->getVertices();
+
+	core::array<u8> copy;
+	copy.set_used(vertexCount * pitch);
+	memcpy(copy.pointer(), vertices, vertexCount * pitch);
+
+	for (i=0; i<vertexCount; ++i)
+		memcpy(vertices + remap[i] * pitch, copy.pointer() + i * pitch, pitch);
+
+	if (mb->getIndexType() == video::EIT_32BIT)
+		memcpy(mb->getIndices(), newIndices.const_pointer(), indexCount * sizeof(u32));
+	else
+	{
+		u16* target = mb->getIndices();
+		for (i=0; i<indexCount; ++i)
+			target[i] = (u16)newIndices[i];
+	}
+
+	mb->setDirty();
+}
+
+
+//! Measures the average cache miss ratio and transformed vertex ratio of a mesh buffer.
+void CMeshManipulator::getVertexCacheStats(const IMeshBuffer* mb, f32& acmr, f32& atvr, u32 cacheSize) const
+{
+	acmr = 0.f;
+	atvr = 0.f;
+
+	if (!mb || mb->getIndexCount() < 3)
+		return;
+
+	core::array<u32> indices;
+	getIndexList(mb, indices);
+	const u32 indexCount = mb->getIndexCount();
+	const u32 vertexCount = mb->getVertexCount();
+
+	// time the vertex entered the FIFO, 0 if it never did
+	core::array<u32> entered;
+	entered.set_used(vertexCount);
+	for (u32 i=0; i<vertexCount; ++i)
+		entered[i] = 0;
+
+	u32 misses = 0;
+	u32 used = 0;
+
+	for (u32 i=0; i<indexCount; ++i)
+	{
+		const u32 v = indices[i];
+
+		if (entered[v] == 0)
+			++used;
+		else if (misses + 1 - entered[v] <= cacheSize)
+			continue;
+
+		++misses;
+		entered[v] = misses;
+	}
+
+	acmr = (f32)misses / (indexCount / 3);
+	atvr = used ? (f32)misses / used : 0.f;
+}
+
+
 //! Returns amount of polygons in mesh.
 s32 CMeshManipulator::getPolyCount(scene::IMesh* mesh) const
 {
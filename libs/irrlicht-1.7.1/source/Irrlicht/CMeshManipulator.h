@@ -69,6 +69,18 @@ public:
 	//! Creates a copy of the mesh, which will have all duplicated vertices removed, i.e. maximal amount of vertices are shared via indexing.
 	virtual IMesh* createMeshWelded(IMesh *mesh, f32 tolerance=core::ROUNDING_ERROR_f32) const;
 
+	//! Creates a lower detail copy of a mesh buffer by quadric edge collapse.
+	virtual IMeshBuffer* createSimplifiedMeshBuffer(const IMeshBuffer* mb, f32 ratio) const;
+
+	//! Creates a lower detail copy of a mesh, buffer by buffer.
+	virtual IMesh* createSimplifiedMesh(IMesh* mesh, f32 ratio) const;
+
+	//! Reorders triangles and vertices of a mesh buffer for the vertex caches and less overdraw.
+	virtual void optimizeMeshBuffer(IMeshBuffer* mb, u32 cacheSize=16) const;
+
+	//! Measures the average cache miss ratio and transformed vertex ratio of a mesh buffer.
+	virtual void getVertexCacheStats(const IMeshBuffer* mb, f32& acmr, f32& atvr, u32 cacheSize=16) const;
+
 	//! Returns amount of polygons in mesh.
 	virtual s32 getPolyCount(scene::IMesh* mesh) const;
 
@@ -82,6 +82,9 @@ CNullDriver::CNullDriver(io::IFileSystem* io, const core::dimension2d<u32>& scre
 
 	setFog();
 
+	for (u32 i=0; i<ERS_COUNT; ++i)
+		RenderStatistics[i] = LastRenderStatistics[i] = 0;
+
 	setTextureCreationFlag(ETCF_ALWAYS_32_BIT, true);
 	setTextureCreationFlag(ETCF_CREATE_MIP_MAPS, true);
 
@@ -265,6 +268,8 @@ bool CNullDriver::beginScene(bool backBuffer, bool zBuffer, SColor color,
 {
 	core::clearFPUException();
 	PrimitivesDrawn = 0;
+	for (u32 i=0; i<ERS_COUNT; ++i)
+		RenderStatistics[i] = 0;
 	return true;
 }
 
@@ -273,6 +278,8 @@ bool CNullDriver::beginScene(bool backBuffer, bool zBuffer, SColor color,
 bool CNullDriver::endScene()
 {
 	FPSCounter.registerFrame(os::Timer::getRealTime(), PrimitivesDrawn);
+	for (u32 i=0; i<ERS_COUNT; ++i)
+		LastRenderStatistics[i] = RenderStatistics[i];
 	updateAllHardwareBuffers();
 	return true;
 }
@@ -601,6 +608,7 @@ void CNullDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCount,
 	if ((iType==EIT_16BIT) && (vertexCount>65536))
 		os::Printer::log("Too many vertices for 16bit index type, render artifacts may occur.");
 	PrimitivesDrawn += primitiveCount;
+	++RenderStatistics[ERS_DRAW_CALLS];
 }
 
 
@@ -610,6 +618,7 @@ void CNullDriver::draw2DVertexPrimitiveList(const void* vertices, u32 vertexCoun
 	if ((iType==EIT_16BIT) && (vertexCount>65536))
 		os::Printer::log("Too many vertices for 16bit index type, render artifacts may occur.");
 	PrimitivesDrawn += primitiveCount;
+	++RenderStatistics[ERS_DRAW_CALLS];
 }
 
 
@@ -844,6 +853,13 @@ u32 CNullDriver::getPrimitiveCountDrawn( u32 param ) const
 }
 
 
+//! returns a render counter of the last frame
+u32 CNullDriver::getRenderStatistic(E_RENDER_STATISTIC statistic) const
+{
+	return (statistic < ERS_COUNT) ? LastRenderStatistics[statistic] : 0;
+}
+
+
 
 //! Sets the dynamic ambient light color. The default color is
 //! (0,0,0,0) which means it is dark.
@@ -1468,6 +1484,29 @@ void CNullDriver::drawMeshBuffer(const scene::IMeshBuffer* mb)
 }
 
 
+//! Draws a mesh buffer once for each transformation, one call per copy
+bool CNullDriver::drawMeshBufferInstanced(const scene::IMeshBuffer* mb,
+		const core::matrix4* transforms, u32 count)
+{
+	if (!mb || !transforms)
+		return false;
+
+	for (u32 i=0; i<count; ++i)
+	{
+		setTransform(ETS_WORLD, transforms[i]);
+		drawMeshBuffer(mb);
+	}
+	return false;
+}
+
+
+//! Returns if drawMeshBufferInstanced draws copies with this material in one call
+bool CNullDriver::canDrawInstanced(const SMaterial& material) const
+{
+	return false;
+}
+
+
 CNullDriver::SHWBufferLink *CNullDriver::getBufferLink(const scene::IMeshBuffer* mb)
 {
 	if (!mb || !isHardwareBufferRecommend(mb))
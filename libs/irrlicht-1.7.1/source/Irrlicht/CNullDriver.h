@@ -241,6 +241,9 @@ namespace video
 		//! very useful method for statistics.
 		virtual u32 getPrimitiveCountDrawn( u32 param = 0 ) const;
 
+		//! returns a render counter of the last frame
+		virtual u32 getRenderStatistic(E_RENDER_STATISTIC statistic) const;
+
 		//! deletes all dynamic lights there are
 		virtual void deleteAllDynamicLights();
 
@@ -363,6 +366,17 @@ namespace video
 		//! Draws a mesh buffer
 		virtual void drawMeshBuffer(const scene::IMeshBuffer* mb);
 
+		//! Draws a mesh buffer once for each transformation
+		virtual bool drawMeshBufferInstanced(const scene::IMeshBuffer* mb,
+			const core::matrix4* transforms, u32 count);
+
+		//! Returns if drawMeshBufferInstanced draws copies with this material in one call
+		virtual bool canDrawInstanced(const SMaterial& material) const;
+
+		//! Runs the parallel work of the driver as jobs of the application
+		virtual void setJobScheduler(u32 threads, DriverJobSubmit submit,
+			DriverJobWait wait, void* userData) {}
+
 	protected:
 		struct SHWBufferLink
 		{
@@ -697,6 +711,9 @@ namespace video
 		CFPSCounter FPSCounter;
 
 		u32 PrimitivesDrawn;
+		//! counters of the current and of the last frame
+		u32 RenderStatistics[ERS_COUNT];
+		u32 LastRenderStatistics[ERS_COUNT];
 		u32 MinVertexCountForVBO;
 
 		u32 TextureCreationFlags;
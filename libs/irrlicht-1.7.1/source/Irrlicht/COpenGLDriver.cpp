@@ -587,6 +587,13 @@ COpenGLDriver::~COpenGLDriver()
 
 	deleteAllTextures();
 
+#if defined(GL_ARB_vertex_buffer_object)
+	if (StreamBufferID)
+		extGlDeleteBuffers(1, &StreamBufferID);
+#endif
+	if (InstancingProgram)
+		extGlDeleteObject(InstancingProgram);
+
 #ifdef _IRR_COMPILE_WITH_WINDOWS_DEVICE_
 	if (DeviceType == EIDT_WIN32)
 	{
@@ -630,9 +637,37 @@ bool COpenGLDriver::genericDriverInit(const core::dimension2d<u32>& screenSize,
 
 	u32 i;
 	for (i=0; i<MATERIAL_MAX_TEXTURES; ++i)
+	{
 		CurrentTexture[i]=0;
+		CurrentLODBias[i]=0.f;
+	}
+	CurrentProgram=0;
 	// load extensions
 	initExtensions(stencilBuffer);
+
+	ColorPointerSize=4;
+#if defined(GL_ARB_vertex_array_bgra) || defined(GL_EXT_vertex_array_bgra)
+	// SColor is stored as BGRA, vertex arrays can read it without conversion
+	if (FeatureAvailable[IRR_ARB_vertex_array_bgra] || FeatureAvailable[IRR_EXT_vertex_array_bgra])
+		ColorPointerSize=GL_BGRA;
+#endif
+
+	VertexBufferOffset=0;
+	StreamBufferID=0;
+	StreamFrame=STREAM_FRAMES;
+	StreamWrite=0;
+	InstancingProgram=0;
+	InstancingProgramFailed=false;
+	InstanceCount=0;
+#if defined(GL_ARB_vertex_buffer_object)
+	if (FeatureAvailable[IRR_ARB_vertex_buffer_object])
+	{
+		extGlGenBuffers(1, &StreamBufferID);
+		extGlBindBuffer(GL_ARRAY_BUFFER, StreamBufferID);
+		extGlBufferData(GL_ARRAY_BUFFER, STREAM_FRAMES*STREAM_REGION_SIZE, 0, GL_STREAM_DRAW);
+		extGlBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+#endif
 	if (queryFeature(EVDF_ARB_GLSL))
 	{
 		char buf[32];
@@ -837,6 +872,11 @@ bool COpenGLDriver::beginScene(bool backBuffer, bool zBuffer, SColor color,
 #endif
 
 	clearBuffers(backBuffer, zBuffer, false, color);
+
+	// move on to the next region of the stream ring
+	++StreamFrame;
+	StreamWrite=0;
+
 	return true;
 }
 
@@ -910,31 +950,31 @@ void COpenGLDriver::setTransform(E_TRANSFORMATION_STATE state, const core::matri
 }
 
 
-bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
+namespace
 {
-	if (!HWBuffer)
-		return false;
+	//! vertices [First, End) of a meshbuffer
+	struct SVertexRange
+	{
+		u32 First, End;
 
-	if (!FeatureAvailable[IRR_ARB_vertex_buffer_object])
-		return false;
+		bool operator<(const SVertexRange& other) const { return First < other.First; }
+	};
+}
 
-#if defined(GL_ARB_vertex_buffer_object)
-	const scene::IMeshBuffer* mb = HWBuffer->MeshBuffer;
-	const void* vertices=mb->getVertices();
-	const u32 vertexCount=mb->getVertexCount();
-	const E_VERTEX_TYPE vType=mb->getVertexType();
-	const u32 vertexSize = getVertexPitchFromType(vType);
 
-	//buffer vertex data, and convert colours...
-	core::array<c8> buffer(vertexSize * vertexCount);
-	memcpy(buffer.pointer(), vertices, vertexSize * vertexCount);
+void COpenGLDriver::copyVertices(void* dest, const void* vertices, u32 vertexCount, E_VERTEX_TYPE vType)
+{
+	memcpy(dest, vertices, vertexCount * getVertexPitchFromType(vType));
+
+	if (ColorPointerSize != 4)
+		return;
 
 	// in order to convert the colors into opengl format (RGBA)
 	switch (vType)
 	{
 		case EVT_STANDARD:
 		{
-			S3DVertex* pb = reinterpret_cast<S3DVertex*>(buffer.pointer());
+			S3DVertex* pb = static_cast<S3DVertex*>(dest);
 			const S3DVertex* po = static_cast<const S3DVertex*>(vertices);
 			for (u32 i=0; i<vertexCount; i++)
 			{
@@ -944,7 +984,7 @@ bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 		break;
 		case EVT_2TCOORDS:
 		{
-			S3DVertex2TCoords* pb = reinterpret_cast<S3DVertex2TCoords*>(buffer.pointer());
+			S3DVertex2TCoords* pb = static_cast<S3DVertex2TCoords*>(dest);
 			const S3DVertex2TCoords* po = static_cast<const S3DVertex2TCoords*>(vertices);
 			for (u32 i=0; i<vertexCount; i++)
 			{
@@ -954,7 +994,7 @@ bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 		break;
 		case EVT_TANGENTS:
 		{
-			S3DVertexTangents* pb = reinterpret_cast<S3DVertexTangents*>(buffer.pointer());
+			S3DVertexTangents* pb = static_cast<S3DVertexTangents*>(dest);
 			const S3DVertexTangents* po = static_cast<const S3DVertexTangents*>(vertices);
 			for (u32 i=0; i<vertexCount; i++)
 			{
@@ -962,11 +1002,38 @@ bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 			}
 		}
 		break;
-		default:
-		{
-			return false;
-		}
 	}
+}
+
+
+const void* COpenGLDriver::getUploadVertices(const void* vertices, u32 vertexCount, E_VERTEX_TYPE vType)
+{
+	if (ColorPointerSize != 4)
+		return vertices;
+
+	VertexUploadBuffer.set_used(vertexCount * getVertexPitchFromType(vType));
+	copyVertices(VertexUploadBuffer.pointer(), vertices, vertexCount, vType);
+	return VertexUploadBuffer.const_pointer();
+}
+
+
+bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer, u32 lastChangedID)
+{
+	if (!HWBuffer)
+		return false;
+
+	if (!FeatureAvailable[IRR_ARB_vertex_buffer_object])
+		return false;
+
+#if defined(GL_ARB_vertex_buffer_object)
+	const scene::IMeshBuffer* mb = HWBuffer->MeshBuffer;
+	const c8* vertices=static_cast<const c8*>(mb->getVertices());
+	const u32 vertexCount=mb->getVertexCount();
+	const E_VERTEX_TYPE vType=mb->getVertexType();
+	const u32 vertexSize = getVertexPitchFromType(vType);
+
+	if (vType!=EVT_STANDARD && vType!=EVT_2TCOORDS && vType!=EVT_TANGENTS)
+		return false;
 
 	//get or create buffer
 	bool newBuffer=false;
@@ -987,17 +1054,59 @@ bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 	//copy data to graphics card
 	glGetError(); // clear error storage
 	if (!newBuffer)
-		extGlBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * vertexSize, buffer.const_pointer());
+	{
+		// collect the ranges changed since the last upload, if all of them are known
+		core::array<SVertexRange> ranges;
+		bool partial=true;
+		const u32 changedID=mb->getChangedID_Vertex();
+		for (u32 id=lastChangedID+1; partial && id<=changedID; ++id)
+		{
+			SVertexRange range;
+			u32 count;
+			partial=mb->getDirtyVertices(id, range.First, count) && range.First+count <= vertexCount;
+			range.End=range.First+count;
+			ranges.push_back(range);
+		}
+
+		if (partial && ranges.size())
+		{
+			// merge overlapping and touching ranges, then upload each one
+			ranges.sort();
+			u32 merged=0;
+			for (u32 i=1; i<ranges.size(); ++i)
+			{
+				if (ranges[i].First <= ranges[merged].End)
+					ranges[merged].End=core::max_(ranges[merged].End, ranges[i].End);
+				else
+					ranges[++merged]=ranges[i];
+			}
+
+			for (u32 i=0; i<=merged; ++i)
+			{
+				const u32 count=ranges[i].End-ranges[i].First;
+				extGlBufferSubData(GL_ARRAY_BUFFER, ranges[i].First*vertexSize, count*vertexSize,
+					getUploadVertices(vertices+ranges[i].First*vertexSize, count, vType));
+				RenderStatistics[ERS_UPLOAD_BYTES] += count*vertexSize;
+			}
+		}
+		else
+		{
+			extGlBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * vertexSize, getUploadVertices(vertices, vertexCount, vType));
+			RenderStatistics[ERS_UPLOAD_BYTES] += vertexCount*vertexSize;
+		}
+	}
 	else
 	{
 		HWBuffer->vbo_verticesSize = vertexCount*vertexSize;
 
+		const void* data=getUploadVertices(vertices, vertexCount, vType);
 		if (HWBuffer->Mapped_Vertex==scene::EHM_STATIC)
-			extGlBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, buffer.const_pointer(), GL_STATIC_DRAW);
+			extGlBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, data, GL_STATIC_DRAW);
 		else if (HWBuffer->Mapped_Vertex==scene::EHM_DYNAMIC)
-			extGlBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, buffer.const_pointer(), GL_DYNAMIC_DRAW);
+			extGlBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, data, GL_DYNAMIC_DRAW);
 		else //scene::EHM_STREAM
-			extGlBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, buffer.const_pointer(), GL_STREAM_DRAW);
+			extGlBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, data, GL_STREAM_DRAW);
+		RenderStatistics[ERS_UPLOAD_BYTES] += vertexCount*vertexSize;
 	}
 
 	extGlBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -1009,6 +1118,96 @@ bool COpenGLDriver::updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 }
 
 
+//! writes data into this frame's region of the stream ring, start is its byte offset in the ring
+bool COpenGLDriver::writeStream(const void* data, u32 size, u32& start)
+{
+#if defined(GL_ARB_vertex_buffer_object)
+	const u32 offset=(StreamWrite + 15) & ~15;
+	if (!StreamBufferID || !size || offset + size > STREAM_REGION_SIZE)
+		return false;
+
+	start=(StreamFrame % STREAM_FRAMES) * STREAM_REGION_SIZE + offset;
+
+	extGlBindBuffer(GL_ARRAY_BUFFER, StreamBufferID);
+	glGetError(); // clear error storage
+
+	void* dest=0;
+#if defined(GL_ARB_map_buffer_range)
+	if (FeatureAvailable[IRR_ARB_map_buffer_range])
+		dest=extGlMapBufferRange(GL_ARRAY_BUFFER, start, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+#endif
+	if (dest)
+	{
+		memcpy(dest, data, size);
+		extGlUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	else
+		extGlBufferSubData(GL_ARRAY_BUFFER, start, size, data);
+
+	extGlBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (glGetError() != GL_NO_ERROR)
+		return false;
+
+	RenderStatistics[ERS_UPLOAD_BYTES] += size;
+	StreamWrite=offset + size;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+bool COpenGLDriver::updateStreamHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
+{
+#if defined(GL_ARB_vertex_buffer_object)
+	const scene::IMeshBuffer* mb = HWBuffer->MeshBuffer;
+	const u32 vertexCount=mb->getVertexCount();
+	const E_VERTEX_TYPE vType=mb->getVertexType();
+	const u32 size=vertexCount * getVertexPitchFromType(vType);
+
+	// keep the vertices aligned, fall back to the buffer's own vbo if the region is full
+	const u32 offset=(StreamWrite + 15) & ~15;
+	if (!size || offset + size > STREAM_REGION_SIZE)
+		return false;
+
+	const u32 start=(StreamFrame % STREAM_FRAMES) * STREAM_REGION_SIZE + offset;
+
+	extGlBindBuffer(GL_ARRAY_BUFFER, StreamBufferID);
+	glGetError(); // clear error storage
+
+	void* dest=0;
+#if defined(GL_ARB_map_buffer_range)
+	// the gpu was done with this region frames ago, don't let the driver wait for it
+	if (FeatureAvailable[IRR_ARB_map_buffer_range])
+		dest=extGlMapBufferRange(GL_ARRAY_BUFFER, start, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+#endif
+	if (dest)
+	{
+		copyVertices(dest, mb->getVertices(), vertexCount, vType);
+		extGlUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	else
+		extGlBufferSubData(GL_ARRAY_BUFFER, start, size, getUploadVertices(mb->getVertices(), vertexCount, vType));
+
+	extGlBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (glGetError() != GL_NO_ERROR)
+		return false;
+
+	RenderStatistics[ERS_UPLOAD_BYTES] += size;
+	StreamWrite=offset + size;
+	HWBuffer->StreamOffset=start;
+	HWBuffer->StreamFrame=StreamFrame;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
 bool COpenGLDriver::updateIndexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 {
 	if (!HWBuffer)
@@ -1061,6 +1260,7 @@ bool COpenGLDriver::updateIndexHardwareBuffer(SHWBufferLink_opengl *HWBuffer)
 
 	//copy data to graphics card
 	glGetError(); // clear error storage
+	RenderStatistics[ERS_UPLOAD_BYTES] += indexCount * indexSize;
 	if (!newBuffer)
 		extGlBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * indexSize, indices);
 	else
@@ -1092,13 +1292,30 @@ bool COpenGLDriver::updateHardwareBuffer(SHWBufferLink *HWBuffer)
 
 	if (HWBuffer->Mapped_Vertex!=scene::EHM_NEVER)
 	{
-		if (HWBuffer->ChangedID_Vertex != HWBuffer->MeshBuffer->getChangedID_Vertex()
-			|| !((SHWBufferLink_opengl*)HWBuffer)->vbo_verticesID)
+		SHWBufferLink_opengl *link=(SHWBufferLink_opengl*)HWBuffer;
+		const u32 changedID=HWBuffer->MeshBuffer->getChangedID_Vertex();
+		const u32 lastChangedID=HWBuffer->ChangedID_Vertex;
+
+		if (HWBuffer->Mapped_Vertex==scene::EHM_STREAM && StreamBufferID)
 		{
+			// streamed vertices are written again when changed, or before their region is reused
+			if (changedID != lastChangedID
+				|| (link->Streamed && StreamFrame - link->StreamFrame >= STREAM_FRAMES)
+				|| (!link->Streamed && !link->vbo_verticesID))
+			{
+				HWBuffer->ChangedID_Vertex = changedID;
 
-			HWBuffer->ChangedID_Vertex = HWBuffer->MeshBuffer->getChangedID_Vertex();
+				link->Streamed=updateStreamHardwareBuffer(link);
+				if (!link->Streamed && !updateVertexHardwareBuffer(link, lastChangedID))
+					return false;
+			}
+		}
+		else if (changedID != lastChangedID || !link->vbo_verticesID)
+		{
 
-			if (!updateVertexHardwareBuffer((SHWBufferLink_opengl*)HWBuffer))
+			HWBuffer->ChangedID_Vertex = changedID;
+
+			if (!updateVertexHardwareBuffer(link, lastChangedID))
 				return false;
 		}
 	}
@@ -1141,6 +1358,9 @@ COpenGLDriver::SHWBufferLink *COpenGLDriver::createHardwareBuffer(const scene::I
 	HWBuffer->vbo_indicesID=0;
 	HWBuffer->vbo_verticesSize=0;
 	HWBuffer->vbo_indicesSize=0;
+	HWBuffer->StreamOffset=0;
+	HWBuffer->StreamFrame=0;
+	HWBuffer->Streamed=false;
 
 	if (!updateHardwareBuffer(HWBuffer))
 	{
@@ -1196,7 +1416,13 @@ void COpenGLDriver::drawHardwareBuffer(SHWBufferLink *_HWBuffer)
 
 	if (HWBuffer->Mapped_Vertex!=scene::EHM_NEVER)
 	{
-		extGlBindBuffer(GL_ARRAY_BUFFER, HWBuffer->vbo_verticesID);
+		if (HWBuffer->Streamed)
+		{
+			extGlBindBuffer(GL_ARRAY_BUFFER, StreamBufferID);
+			VertexBufferOffset=HWBuffer->StreamOffset;
+		}
+		else
+			extGlBindBuffer(GL_ARRAY_BUFFER, HWBuffer->vbo_verticesID);
 		vertices=0;
 	}
 
@@ -1207,6 +1433,7 @@ void COpenGLDriver::drawHardwareBuffer(SHWBufferLink *_HWBuffer)
 	}
 
 	drawVertexPrimitiveList(vertices, mb->getVertexCount(), indexList, mb->getIndexCount()/3, mb->getVertexType(), scene::EPT_TRIANGLES, mb->getIndexType());
+	VertexBufferOffset=0;
 
 	if (HWBuffer->Mapped_Vertex!=scene::EHM_NEVER)
 		extGlBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -1236,7 +1463,7 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 
 	CNullDriver::drawVertexPrimitiveList(vertices, vertexCount, indexList, primitiveCount, vType, pType, iType);
 
-	if (vertices)
+	if (vertices && ColorPointerSize == 4)
 		createColorBuffer(vertices, vertexCount, vType);
 
 	// draw everything
@@ -1253,7 +1480,12 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 		glEnableClientState(GL_NORMAL_ARRAY);
 
 	if (vertices)
-		glColorPointer(4, GL_UNSIGNED_BYTE, 0, &ColorBuffer[0]);
+	{
+		if (ColorPointerSize == 4)
+			glColorPointer(4, GL_UNSIGNED_BYTE, 0, &ColorBuffer[0]);
+		else
+			glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, getVertexPitchFromType(vType), &(static_cast<const S3DVertex*>(vertices))[0].Color);
+	}
 
 	switch (vType)
 	{
@@ -1266,10 +1498,10 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 			}
 			else
 			{
-				glNormalPointer(GL_FLOAT, sizeof(S3DVertex), buffer_offset(12));
-				glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(S3DVertex), buffer_offset(24));
-				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex), buffer_offset(28));
-				glVertexPointer(3, GL_FLOAT, sizeof(S3DVertex), 0);
+				glNormalPointer(GL_FLOAT, sizeof(S3DVertex), buffer_offset(VertexBufferOffset+12));
+				glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, sizeof(S3DVertex), buffer_offset(VertexBufferOffset+24));
+				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex), buffer_offset(VertexBufferOffset+28));
+				glVertexPointer(3, GL_FLOAT, sizeof(S3DVertex), buffer_offset(VertexBufferOffset));
 			}
 
 			if (MultiTextureExtension && CurrentTexture[1])
@@ -1279,7 +1511,7 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 				if (vertices)
 					glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex), &(static_cast<const S3DVertex*>(vertices))[0].TCoords);
 				else
-					glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex), buffer_offset(28));
+					glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex), buffer_offset(VertexBufferOffset+28));
 			}
 			break;
 		case EVT_2TCOORDS:
@@ -1291,10 +1523,10 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 			}
 			else
 			{
-				glNormalPointer(GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(12));
-				glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(S3DVertex2TCoords), buffer_offset(24));
-				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(28));
-				glVertexPointer(3, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(0));
+				glNormalPointer(GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(VertexBufferOffset+12));
+				glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, sizeof(S3DVertex2TCoords), buffer_offset(VertexBufferOffset+24));
+				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(VertexBufferOffset+28));
+				glVertexPointer(3, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(VertexBufferOffset));
 			}
 
 
@@ -1305,7 +1537,7 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 				if (vertices)
 					glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), &(static_cast<const S3DVertex2TCoords*>(vertices))[0].TCoords2);
 				else
-					glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(36));
+					glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(VertexBufferOffset+36));
 			}
 			break;
 		case EVT_TANGENTS:
@@ -1317,10 +1549,10 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 			}
 			else
 			{
-				glNormalPointer(GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(12));
-				glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(S3DVertexTangents), buffer_offset(24));
-				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(28));
-				glVertexPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(0));
+				glNormalPointer(GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(VertexBufferOffset+12));
+				glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, sizeof(S3DVertexTangents), buffer_offset(VertexBufferOffset+24));
+				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(VertexBufferOffset+28));
+				glVertexPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(VertexBufferOffset));
 			}
 
 			if (MultiTextureExtension)
@@ -1330,14 +1562,14 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 				if (vertices)
 					glTexCoordPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), &(static_cast<const S3DVertexTangents*>(vertices))[0].Tangent);
 				else
-					glTexCoordPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(36));
+					glTexCoordPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(VertexBufferOffset+36));
 
 				extGlClientActiveTexture(GL_TEXTURE2_ARB);
 				glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 				if (vertices)
 					glTexCoordPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), &(static_cast<const S3DVertexTangents*>(vertices))[0].Binormal);
 				else
-					glTexCoordPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(48));
+					glTexCoordPointer(3, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(VertexBufferOffset+48));
 			}
 			break;
 	}
@@ -1365,6 +1597,165 @@ void COpenGLDriver::drawVertexPrimitiveList(const void* vertices, u32 vertexCoun
 }
 
 
+//! draws a mesh buffer once for each transformation, with one instanced call where possible
+bool COpenGLDriver::drawMeshBufferInstanced(const scene::IMeshBuffer* mb,
+		const core::matrix4* transforms, u32 count)
+{
+	if (!mb || !transforms || !count)
+		return false;
+
+	SHWBufferLink *HWBuffer=getBufferLink(mb);
+
+	if (count==1 || !HWBuffer || !canDrawInstanced(Material) || !createInstancingProgram())
+		return CNullDriver::drawMeshBufferInstanced(mb, transforms, count);
+
+	// matrices as 16 floats each, matrix4 can carry more than that
+	InstanceData.set_used(count*16);
+	for (u32 i=0; i<count; ++i)
+		memcpy(&InstanceData[i*16], transforms[i].pointer(), 16*sizeof(f32));
+
+	u32 start;
+	if (!writeStream(InstanceData.const_pointer(), count*16*sizeof(f32), start))
+		return CNullDriver::drawMeshBufferInstanced(mb, transforms, count);
+
+	// the modelview matrix is the view matrix, the program applies the instance matrix
+	setTransform(ETS_WORLD, core::IdentityMatrix);
+	setRenderStates3DMode();
+	setActiveProgram(InstancingProgram);
+
+	// one matrix column per attribute, advanced once per instance
+	extGlBindBuffer(GL_ARRAY_BUFFER, StreamBufferID);
+	for (u32 i=0; i<4; ++i)
+	{
+		extGlEnableVertexAttribArray(INSTANCE_ATTRIBUTE+i);
+		extGlVertexAttribPointer(INSTANCE_ATTRIBUTE+i, 4, GL_FLOAT, GL_FALSE,
+			16*sizeof(f32), buffer_offset(start + i*4*sizeof(f32)));
+		extGlVertexAttribDivisor(INSTANCE_ATTRIBUTE+i, 1);
+	}
+	extGlBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	InstanceCount=count;
+	drawHardwareBuffer(HWBuffer);
+	InstanceCount=0;
+
+	// the draw call counted the primitives of one copy
+	PrimitivesDrawn += (mb->getIndexCount()/3) * (count-1);
+
+	for (u32 i=0; i<4; ++i)
+	{
+		extGlVertexAttribDivisor(INSTANCE_ATTRIBUTE+i, 0);
+		extGlDisableVertexAttribArray(INSTANCE_ATTRIBUTE+i);
+	}
+
+	setActiveProgram(0);
+	return true;
+}
+
+
+//! true if the instancing program can draw the material
+bool COpenGLDriver::canDrawInstanced(const SMaterial& material) const
+{
+	if (!queryFeature(EVDF_INSTANCING) || !StreamBufferID || InstancingProgramFailed)
+		return false;
+
+	// the program replaces the vertex stage: no lighting, no texture coordinate generation
+	if (material.Lighting)
+		return false;
+
+	switch (material.MaterialType)
+	{
+	case EMT_SOLID:
+	case EMT_SOLID_2_LAYER:
+	case EMT_LIGHTMAP:
+	case EMT_LIGHTMAP_ADD:
+	case EMT_LIGHTMAP_M2:
+	case EMT_LIGHTMAP_M4:
+	case EMT_LIGHTMAP_LIGHTING:
+	case EMT_LIGHTMAP_LIGHTING_M2:
+	case EMT_LIGHTMAP_LIGHTING_M4:
+	case EMT_DETAIL_MAP:
+	case EMT_TRANSPARENT_ADD_COLOR:
+	case EMT_TRANSPARENT_ALPHA_CHANNEL:
+	case EMT_TRANSPARENT_ALPHA_CHANNEL_REF:
+	case EMT_TRANSPARENT_VERTEX_ALPHA:
+	case EMT_ONETEXTURE_BLEND:
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+//! compiles the vertex program reading the instance matrices, once
+bool COpenGLDriver::createInstancingProgram()
+{
+	if (InstancingProgram)
+		return true;
+	if (InstancingProgramFailed)
+		return false;
+
+#if defined(GL_ARB_shader_objects) && defined(GL_ARB_vertex_shader)
+	// the fragment stage stays fixed function
+	const c8* source =
+		"attribute vec4 InstanceColumn0;\n"
+		"attribute vec4 InstanceColumn1;\n"
+		"attribute vec4 InstanceColumn2;\n"
+		"attribute vec4 InstanceColumn3;\n"
+		"void main()\n"
+		"{\n"
+		"	mat4 world = mat4(InstanceColumn0, InstanceColumn1, InstanceColumn2, InstanceColumn3);\n"
+		"	vec4 eye = gl_ModelViewMatrix * (world * gl_Vertex);\n"
+		"	gl_Position = gl_ProjectionMatrix * eye;\n"
+		"	gl_ClipVertex = eye;\n"
+		"	gl_FrontColor = gl_Color;\n"
+		"	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+		"	gl_TexCoord[1] = gl_TextureMatrix[1] * gl_MultiTexCoord1;\n"
+		"	gl_FogFragCoord = abs(eye.z);\n"
+		"}\n";
+
+	InstancingProgramFailed=true;
+
+	GLhandleARB shader=extGlCreateShaderObject(GL_VERTEX_SHADER_ARB);
+	extGlShaderSourceARB(shader, 1, &source, NULL);
+	extGlCompileShaderARB(shader);
+
+	GLint status=0;
+	extGlGetObjectParameteriv(shader, GL_OBJECT_COMPILE_STATUS_ARB, &status);
+	if (!status)
+	{
+		os::Printer::log("Instancing vertex program failed to compile, instances are drawn one by one", ELL_WARNING);
+		extGlDeleteObject(shader);
+		return false;
+	}
+
+	GLhandleARB program=extGlCreateProgramObject();
+	extGlAttachObject(program, shader);
+	extGlBindAttribLocation(program, INSTANCE_ATTRIBUTE, "InstanceColumn0");
+	extGlBindAttribLocation(program, INSTANCE_ATTRIBUTE+1, "InstanceColumn1");
+	extGlBindAttribLocation(program, INSTANCE_ATTRIBUTE+2, "InstanceColumn2");
+	extGlBindAttribLocation(program, INSTANCE_ATTRIBUTE+3, "InstanceColumn3");
+	extGlLinkProgramARB(program);
+	// the program keeps the shader
+	extGlDeleteObject(shader);
+
+	extGlGetObjectParameteriv(program, GL_OBJECT_LINK_STATUS_ARB, &status);
+	if (!status)
+	{
+		os::Printer::log("Instancing vertex program failed to link, instances are drawn one by one", ELL_WARNING);
+		extGlDeleteObject(program);
+		return false;
+	}
+
+	InstancingProgram=program;
+	InstancingProgramFailed=false;
+	return true;
+#else
+	InstancingProgramFailed=true;
+	return false;
+#endif
+}
+
+
 void COpenGLDriver::createColorBuffer(const void* vertices, u32 vertexCount, E_VERTEX_TYPE vType)
 {
 	// convert colors to gl color format.
@@ -1499,7 +1890,10 @@ void COpenGLDriver::renderArray(const void* indexList, u32 primitiveCount,
 			glDrawElements(GL_TRIANGLE_FAN, primitiveCount+2, indexSize, indexList);
 			break;
 		case scene::EPT_TRIANGLES:
-			glDrawElements(GL_TRIANGLES, primitiveCount*3, indexSize, indexList);
+			if (InstanceCount)
+				extGlDrawElementsInstanced(GL_TRIANGLES, primitiveCount*3, indexSize, indexList, InstanceCount);
+			else
+				glDrawElements(GL_TRIANGLES, primitiveCount*3, indexSize, indexList);
 			break;
 		case scene::EPT_QUAD_STRIP:
 			glDrawElements(GL_QUAD_STRIP, primitiveCount*2+2, indexSize, indexList);
@@ -1527,7 +1921,7 @@ void COpenGLDriver::draw2DVertexPrimitiveList(const void* vertices, u32 vertexCo
 
 	CNullDriver::draw2DVertexPrimitiveList(vertices, vertexCount, indexList, primitiveCount, vType, pType, iType);
 
-	if (vertices)
+	if (vertices && ColorPointerSize == 4)
 		createColorBuffer(vertices, vertexCount, vType);
 
 	// draw everything
@@ -1553,7 +1947,12 @@ void COpenGLDriver::draw2DVertexPrimitiveList(const void* vertices, u32 vertexCo
 		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
 	if (vertices)
-		glColorPointer(4, GL_UNSIGNED_BYTE, 0, &ColorBuffer[0]);
+	{
+		if (ColorPointerSize == 4)
+			glColorPointer(4, GL_UNSIGNED_BYTE, 0, &ColorBuffer[0]);
+		else
+			glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, getVertexPitchFromType(vType), &(static_cast<const S3DVertex*>(vertices))[0].Color);
+	}
 
 	switch (vType)
 	{
@@ -1565,7 +1964,7 @@ void COpenGLDriver::draw2DVertexPrimitiveList(const void* vertices, u32 vertexCo
 			}
 			else
 			{
-				glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(S3DVertex), buffer_offset(24));
+				glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, sizeof(S3DVertex), buffer_offset(24));
 				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex), buffer_offset(28));
 				glVertexPointer(2, GL_FLOAT, sizeof(S3DVertex), 0);
 			}
@@ -1588,7 +1987,7 @@ void COpenGLDriver::draw2DVertexPrimitiveList(const void* vertices, u32 vertexCo
 			}
 			else
 			{
-				glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(S3DVertex2TCoords), buffer_offset(24));
+				glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, sizeof(S3DVertex2TCoords), buffer_offset(24));
 				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(28));
 				glVertexPointer(2, GL_FLOAT, sizeof(S3DVertex2TCoords), buffer_offset(0));
 			}
@@ -1611,7 +2010,7 @@ void COpenGLDriver::draw2DVertexPrimitiveList(const void* vertices, u32 vertexCo
 			}
 			else
 			{
-				glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(S3DVertexTangents), buffer_offset(24));
+				glColorPointer(ColorPointerSize, GL_UNSIGNED_BYTE, sizeof(S3DVertexTangents), buffer_offset(24));
 				glTexCoordPointer(2, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(28));
 				glVertexPointer(2, GL_FLOAT, sizeof(S3DVertexTangents), buffer_offset(0));
 			}
@@ -2158,6 +2557,9 @@ bool COpenGLDriver::setActiveTexture(u32 stage, const video::ITexture* texture)
 	if (MultiTextureExtension)
 		extGlActiveTexture(GL_TEXTURE0_ARB + stage);
 
+	// texturing of the unit is only enabled while a texture is set
+	const bool wasEnabled = (CurrentTexture[stage] != 0);
+
 	CurrentTexture[stage]=texture;
 
 	if (!texture)
@@ -2169,19 +2571,58 @@ bool COpenGLDriver::setActiveTexture(u32 stage, const video::ITexture* texture)
 	{
 		if (texture->getDriverType() != EDT_OPENGL)
 		{
+			CurrentTexture[stage]=0;
 			glDisable(GL_TEXTURE_2D);
 			os::Printer::log("Fatal Error: Tried to set a texture not owned by this driver.", ELL_ERROR);
 			return false;
 		}
 
-		glEnable(GL_TEXTURE_2D);
+		if (!wasEnabled)
+			glEnable(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D,
 			static_cast<const COpenGLTexture*>(texture)->getOpenGLTextureName());
+		++RenderStatistics[ERS_TEXTURE_BINDS];
 	}
 	return true;
 }
 
 
+//! makes a GLSL program active, unless it already is
+void COpenGLDriver::setActiveProgram(GLhandleARB program)
+{
+	if (CurrentProgram==program)
+		return;
+
+	CurrentProgram=program;
+	extGlUseProgramObject(program);
+
+	if (program)
+		++RenderStatistics[ERS_SHADER_BINDS];
+}
+
+
+//! sets a parameter of the texture bound to a stage, if it differs from the value cached in the texture
+void COpenGLDriver::setTextureParameter(u32 stage, u32 state, GLenum name, GLint value)
+{
+	const COpenGLTexture* texture = static_cast<const COpenGLTexture*>(CurrentTexture[stage]);
+
+	// without a texture the parameter would go to whatever texture object is still bound
+	if (!texture)
+		return;
+
+	GLint& cached = texture->getStatesCache().Values[state];
+
+	if (cached == value)
+		return;
+
+	if (MultiTextureExtension)
+		extGlActiveTexture(GL_TEXTURE0_ARB + stage);
+
+	glTexParameteri(GL_TEXTURE_2D, name, value);
+	cached = value;
+}
+
+
 //! disables all textures beginning with the optional fromStage parameter. Otherwise all texture stages are disabled.
 //! Returns whether disabling was successful or not.
 bool COpenGLDriver::disableTextures(u32 fromStage)
@@ -2437,13 +2878,11 @@ void COpenGLDriver::setWrapMode(const SMaterial& material)
 	// Has to be checked always because it depends on the textures
 	for (u32 u=0; u<MaxTextureUnits; ++u)
 	{
-		if (MultiTextureExtension)
-			extGlActiveTexture(GL_TEXTURE0_ARB + u);
-		else if (u>0)
+		if (!MultiTextureExtension && u>0)
 			break; // stop loop
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, getTextureWrapMode(material.TextureLayer[u].TextureWrapU));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, getTextureWrapMode(material.TextureLayer[u].TextureWrapV));
+		setTextureParameter(u, COpenGLTexture::SStatesCache::WRAP_S, GL_TEXTURE_WRAP_S, getTextureWrapMode(material.TextureLayer[u].TextureWrapU));
+		setTextureParameter(u, COpenGLTexture::SStatesCache::WRAP_T, GL_TEXTURE_WRAP_T, getTextureWrapMode(material.TextureLayer[u].TextureWrapV));
 	}
 }
 
@@ -2550,43 +2989,47 @@ void COpenGLDriver::setBasicRenderStates(const SMaterial& material, const SMater
 	}
 
 	// Texture filter
-	// Has to be checked always because it depends on the textures
-	// Filtering has to be set for each texture layer
+	// Filtering is state of the texture objects, so it has to be checked
+	// for each bound texture, but it's only set where it changes.
 	for (u32 i=0; i<MaxTextureUnits; ++i)
 	{
-		if (MultiTextureExtension)
-			extGlActiveTexture(GL_TEXTURE0_ARB + i);
-		else if (i>0)
+		if (!MultiTextureExtension && i>0)
 			break;
 
+		if (!CurrentTexture[i])
+			continue;
+
 #ifdef GL_EXT_texture_lod_bias
 		if (FeatureAvailable[IRR_EXT_texture_lod_bias])
 		{
-			if (material.TextureLayer[i].LODBias)
+			const GLfloat bias = material.TextureLayer[i].LODBias ?
+				core::clamp(material.TextureLayer[i].LODBias * 0.125f, -MaxTextureLODBias, MaxTextureLODBias) : 0.f;
+
+			if (resetAllRenderStates || CurrentLODBias[i] != bias)
 			{
-				const float tmp = core::clamp(material.TextureLayer[i].LODBias * 0.125f, -MaxTextureLODBias, MaxTextureLODBias);
-				glTexEnvf(GL_TEXTURE_FILTER_CONTROL_EXT, GL_TEXTURE_LOD_BIAS_EXT, tmp);
+				if (MultiTextureExtension)
+					extGlActiveTexture(GL_TEXTURE0_ARB + i);
+				glTexEnvf(GL_TEXTURE_FILTER_CONTROL_EXT, GL_TEXTURE_LOD_BIAS_EXT, bias);
+				CurrentLODBias[i] = bias;
 			}
-			else
-				glTexEnvf(GL_TEXTURE_FILTER_CONTROL_EXT, GL_TEXTURE_LOD_BIAS_EXT, 0.f);
 		}
 #endif
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+		setTextureParameter(i, COpenGLTexture::SStatesCache::MAG_FILTER, GL_TEXTURE_MAG_FILTER,
 			(material.TextureLayer[i].BilinearFilter || material.TextureLayer[i].TrilinearFilter) ? GL_LINEAR : GL_NEAREST);
 
-		if (material.getTexture(i) && material.getTexture(i)->hasMipMaps())
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		if (CurrentTexture[i]->hasMipMaps())
+			setTextureParameter(i, COpenGLTexture::SStatesCache::MIN_FILTER, GL_TEXTURE_MIN_FILTER,
 				material.TextureLayer[i].TrilinearFilter ? GL_LINEAR_MIPMAP_LINEAR :
 				material.TextureLayer[i].BilinearFilter ? GL_LINEAR_MIPMAP_NEAREST :
 				GL_NEAREST_MIPMAP_NEAREST);
 		else
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			setTextureParameter(i, COpenGLTexture::SStatesCache::MIN_FILTER, GL_TEXTURE_MIN_FILTER,
 				(material.TextureLayer[i].BilinearFilter || material.TextureLayer[i].TrilinearFilter) ? GL_LINEAR : GL_NEAREST);
 
 #ifdef GL_EXT_texture_filter_anisotropic
 		if (FeatureAvailable[IRR_EXT_texture_filter_anisotropic])
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+			setTextureParameter(i, COpenGLTexture::SStatesCache::ANISOTROPY, GL_TEXTURE_MAX_ANISOTROPY_EXT,
 			material.TextureLayer[i].AnisotropicFilter>1 ? core::min_(MaxAnisotropy, material.TextureLayer[i].AnisotropicFilter) : 1);
 #endif
 	}
@@ -2855,10 +3298,10 @@ void COpenGLDriver::setRenderStates2DMode(bool alpha, bool texture, bool alphaCh
 	{
 		if (!OverrideMaterial2DEnabled)
 		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			setTextureParameter(0, COpenGLTexture::SStatesCache::MIN_FILTER, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			setTextureParameter(0, COpenGLTexture::SStatesCache::MAG_FILTER, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			setTextureParameter(0, COpenGLTexture::SStatesCache::WRAP_S, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			setTextureParameter(0, COpenGLTexture::SStatesCache::WRAP_T, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		}
 		setTransform(ETS_TEXTURE_0, core::IdentityMatrix);
 
@@ -78,13 +78,20 @@ namespace video
 
 		struct SHWBufferLink_opengl : public SHWBufferLink
 		{
-			SHWBufferLink_opengl(const scene::IMeshBuffer *_MeshBuffer): SHWBufferLink(_MeshBuffer), vbo_verticesID(0),vbo_indicesID(0){}
+			SHWBufferLink_opengl(const scene::IMeshBuffer *_MeshBuffer): SHWBufferLink(_MeshBuffer), vbo_verticesID(0),vbo_indicesID(0),
+				StreamOffset(0), StreamFrame(0), Streamed(false){}
 
 			GLuint vbo_verticesID; //tmp
 			GLuint vbo_indicesID; //tmp
 
 			GLuint vbo_verticesSize; //tmp
 			GLuint vbo_indicesSize; //tmp
+
+			//! Streamed vertices: byte offset in the stream ring and frame they were written in
+			u32 StreamOffset;
+			u32 StreamFrame;
+			//! The vertices are in the stream ring, not in vbo_verticesID
+			bool Streamed;
 		};
 
 		//! updates hardware buffer if needed
@@ -104,6 +111,13 @@ namespace video
 				const void* indexList, u32 primitiveCount,
 				E_VERTEX_TYPE vType, scene::E_PRIMITIVE_TYPE pType, E_INDEX_TYPE iType);
 
+		//! draws a mesh buffer once for each transformation, with one instanced call where possible
+		virtual bool drawMeshBufferInstanced(const scene::IMeshBuffer* mb,
+				const core::matrix4* transforms, u32 count);
+
+		//! true if the instancing program can draw the material
+		virtual bool canDrawInstanced(const SMaterial& material) const;
+
 		//! draws a vertex primitive list in 2d
 		virtual void draw2DVertexPrimitiveList(const void* vertices, u32 vertexCount,
 				const void* indexList, u32 primitiveCount,
@@ -264,6 +278,12 @@ namespace video
 		//! Returns whether setting was a success or not.
 		bool setActiveTexture(u32 stage, const video::ITexture* texture);
 
+		//! makes a GLSL program active, unless it already is
+		void setActiveProgram(GLhandleARB program);
+
+		//! returns the GLSL program made active last
+		GLhandleARB getActiveProgram() const { return CurrentProgram; }
+
 		//! disables all textures beginning with the optional fromStage parameter. Otherwise all texture stages are disabled.
 		//! Returns whether disabling was successful or not.
 		bool disableTextures(u32 fromStage=0);
@@ -359,8 +379,21 @@ namespace video
 		//! clears the zbuffer and color buffer
 		void clearBuffers(bool backBuffer, bool zBuffer, bool stencilBuffer, SColor color);
 
-		bool updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer);
+		//! uploads the vertices changed since lastChangedID, or all of them
+		bool updateVertexHardwareBuffer(SHWBufferLink_opengl *HWBuffer, u32 lastChangedID);
 		bool updateIndexHardwareBuffer(SHWBufferLink_opengl *HWBuffer);
+		//! writes the vertices of a streamed buffer into this frame's region of the stream ring
+		bool updateStreamHardwareBuffer(SHWBufferLink_opengl *HWBuffer);
+		//! writes data into this frame's region of the stream ring, start is its byte offset in the ring
+		bool writeStream(const void* data, u32 size, u32& start);
+
+		//! compiles the vertex program reading the instance matrices, once
+		bool createInstancingProgram();
+
+		//! copies vertices, converting the colors if the vertex arrays can't read them as they are
+		void copyVertices(void* dest, const void* vertices, u32 vertexCount, E_VERTEX_TYPE vType);
+		//! returns the vertices ready for upload, the source itself if no conversion is needed
+		const void* getUploadVertices(const void* vertices, u32 vertexCount, E_VERTEX_TYPE vType);
 
 		void uploadClipPlane(u32 index);
 
@@ -376,6 +409,9 @@ namespace video
 		//! Set GL pipeline to desired texture wrap modes of the material
 		void setWrapMode(const SMaterial& material);
 
+		//! sets a parameter of the texture bound to a stage, if it differs from the value cached in the texture
+		void setTextureParameter(u32 stage, u32 state, GLenum name, GLint value);
+
 		//! get native wrap mode value
 		GLint getTextureWrapMode(const u8 clamp);
 
@@ -405,6 +441,28 @@ namespace video
 		core::stringw Name;
 		core::matrix4 Matrices[ETS_COUNT];
 		core::array<u8> ColorBuffer;
+		core::array<c8> VertexUploadBuffer;
+
+		//! size passed to glColorPointer, GL_BGRA when vertex colors are read in their native order
+		GLint ColorPointerSize;
+
+		//! byte offset of the vertices in the bound array buffer
+		u32 VertexBufferOffset;
+
+		//! Streamed vertex buffers are written into one region of a ring per frame,
+		//! a region is reused only after STREAM_FRAMES frames
+		enum { STREAM_FRAMES=3, STREAM_REGION_SIZE=2*1024*1024 };
+		GLuint StreamBufferID;
+		u32 StreamFrame;
+		u32 StreamWrite;
+
+		//! Instance matrices are read from the generic attributes starting at INSTANCE_ATTRIBUTE,
+		//! renderArray draws InstanceCount copies when it isn't 0
+		enum { INSTANCE_ATTRIBUTE=4 };
+		GLhandleARB InstancingProgram;
+		bool InstancingProgramFailed;
+		u32 InstanceCount;
+		core::array<f32> InstanceData;
 
 		//! enumeration for rendering modes such as 2d and 3d for minizing the switching of renderStates.
 		enum E_RENDER_MODE
@@ -423,6 +481,9 @@ namespace video
 		SMaterial Material, LastMaterial;
 		COpenGLTexture* RenderTargetTexture;
 		const ITexture* CurrentTexture[MATERIAL_MAX_TEXTURES];
+		//! LOD bias of each texture unit, part of the unit and not the texture state
+		GLfloat CurrentLODBias[MATERIAL_MAX_TEXTURES];
+		GLhandleARB CurrentProgram;
 		core::array<ITexture*> DepthTextures;
 		struct SUserClipPlane
 		{
@@ -23,7 +23,8 @@ COpenGLExtensionHandler::COpenGLExtensionHandler() :
 		MaxUserClipPlanes(0), MaxAuxBuffers(0),
 		MaxMultipleRenderTargets(1), MaxIndices(65535),
 		MaxTextureSize(1), MaxGeometryVerticesOut(0),
-		MaxTextureLODBias(0.f), Version(0), ShaderLanguageVersion(0)
+		MaxTextureLODBias(0.f), Version(0), ShaderLanguageVersion(0),
+		ActiveTextureUnit(GL_TEXTURE0_ARB)
 #ifdef _IRR_OPENGL_USE_EXTPOINTER_
 	,pGlActiveTextureARB(0), pGlClientActiveTextureARB(0),
 	pGlGenProgramsARB(0), pGlGenProgramsNV(0),
@@ -53,11 +54,16 @@ COpenGLExtensionHandler::COpenGLExtensionHandler() :
 	pGlDrawBuffersARB(0), pGlDrawBuffersATI(0),
 	pGlGenBuffersARB(0), pGlBindBufferARB(0), pGlBufferDataARB(0), pGlDeleteBuffersARB(0),
 	pGlBufferSubDataARB(0), pGlGetBufferSubDataARB(0), pGlMapBufferARB(0), pGlUnmapBufferARB(0),
+	pGlMapBufferRange(0),
 	pGlIsBufferARB(0), pGlGetBufferParameterivARB(0), pGlGetBufferPointervARB(0),
 	pGlProvokingVertexARB(0), pGlProvokingVertexEXT(0),
 	pGlColorMaskIndexedEXT(0), pGlEnableIndexedEXT(0), pGlDisableIndexedEXT(0),
 	pGlBlendFuncIndexedAMD(0), pGlBlendFunciARB(0),
-	pGlProgramParameteriARB(0), pGlProgramParameteriEXT(0)
+	pGlProgramParameteriARB(0), pGlProgramParameteriEXT(0),
+	pGlBindAttribLocationARB(0), pGlVertexAttribPointerARB(0),
+	pGlEnableVertexAttribArrayARB(0), pGlDisableVertexAttribArrayARB(0),
+	pGlVertexAttribDivisorARB(0),
+	pGlDrawElementsInstancedARB(0), pGlDrawElementsInstancedEXT(0)
 #endif // _IRR_OPENGL_USE_EXTPOINTER_
 {
 	for (u32 i=0; i<IRR_OpenGL_Feature_Count; ++i)
@@ -199,6 +205,7 @@ void COpenGLExtensionHandler::initExtensions(bool stencilBuffer)
 	pGlGetBufferSubDataARB= (PFNGLGETBUFFERSUBDATAARBPROC)wglGetProcAddress("glGetBufferSubDataARB");
 	pGlMapBufferARB= (PFNGLMAPBUFFERARBPROC) wglGetProcAddress("glMapBufferARB");
 	pGlUnmapBufferARB= (PFNGLUNMAPBUFFERARBPROC) wglGetProcAddress("glUnmapBufferARB");
+	pGlMapBufferRange= (PFNGLMAPBUFFERRANGEPROC) wglGetProcAddress("glMapBufferRange");
 	pGlIsBufferARB= (PFNGLISBUFFERARBPROC) wglGetProcAddress("glIsBufferARB");
 	pGlGetBufferParameterivARB= (PFNGLGETBUFFERPARAMETERIVARBPROC) wglGetProcAddress("glGetBufferParameterivARB");
 	pGlGetBufferPointervARB= (PFNGLGETBUFFERPOINTERVARBPROC) wglGetProcAddress("glGetBufferPointervARB");
@@ -210,6 +217,15 @@ void COpenGLExtensionHandler::initExtensions(bool stencilBuffer)
 	pGlBlendFuncIndexedAMD= (PFNGLBLENDFUNCINDEXEDAMDPROC) wglGetProcAddress("glBlendFuncIndexedAMD");
 	pGlBlendFunciARB= (PFNGLBLENDFUNCIPROC) wglGetProcAddress("glBlendFunciARB");
 	pGlProgramParameteriARB= (PFNGLPROGRAMPARAMETERIARBPROC) wglGetProcAddress("glProgramParameteriARB");
+
+	// get instancing extension
+	pGlBindAttribLocationARB= (PFNGLBINDATTRIBLOCATIONARBPROC) wglGetProcAddress("glBindAttribLocationARB");
+	pGlVertexAttribPointerARB= (PFNGLVERTEXATTRIBPOINTERARBPROC) wglGetProcAddress("glVertexAttribPointerARB");
+	pGlEnableVertexAttribArrayARB= (PFNGLENABLEVERTEXATTRIBARRAYARBPROC) wglGetProcAddress("glEnableVertexAttribArrayARB");
+	pGlDisableVertexAttribArrayARB= (PFNGLDISABLEVERTEXATTRIBARRAYARBPROC) wglGetProcAddress("glDisableVertexAttribArrayARB");
+	pGlVertexAttribDivisorARB= (PFNGLVERTEXATTRIBDIVISORARBPROC) wglGetProcAddress("glVertexAttribDivisorARB");
+	pGlDrawElementsInstancedARB= (PFNGLDRAWELEMENTSINSTANCEDARBPROC) wglGetProcAddress("glDrawElementsInstancedARB");
+	pGlDrawElementsInstancedEXT= (PFNGLDRAWELEMENTSINSTANCEDEXTPROC) wglGetProcAddress("glDrawElementsInstancedEXT");
 	pGlProgramParameteriEXT= (PFNGLPROGRAMPARAMETERIEXTPROC) wglGetProcAddress("glProgramParameteriEXT");
 
 
@@ -430,6 +446,9 @@ void COpenGLExtensionHandler::initExtensions(bool stencilBuffer)
 	pGlUnmapBufferARB = (PFNGLUNMAPBUFFERARBPROC)
 	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glUnmapBufferARB"));
 
+	pGlMapBufferRange = (PFNGLMAPBUFFERRANGEPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glMapBufferRange"));
+
 	pGlIsBufferARB = (PFNGLISBUFFERARBPROC)
 	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glIsBufferARB"));
 
@@ -457,6 +476,22 @@ void COpenGLExtensionHandler::initExtensions(bool stencilBuffer)
 	pGlProgramParameteriEXT = (PFNGLPROGRAMPARAMETERIEXTPROC)
 	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glProgramParameteriEXT"));
 
+	// get instancing extension
+	pGlBindAttribLocationARB = (PFNGLBINDATTRIBLOCATIONARBPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glBindAttribLocationARB"));
+	pGlVertexAttribPointerARB = (PFNGLVERTEXATTRIBPOINTERARBPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glVertexAttribPointerARB"));
+	pGlEnableVertexAttribArrayARB = (PFNGLENABLEVERTEXATTRIBARRAYARBPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glEnableVertexAttribArrayARB"));
+	pGlDisableVertexAttribArrayARB = (PFNGLDISABLEVERTEXATTRIBARRAYARBPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glDisableVertexAttribArrayARB"));
+	pGlVertexAttribDivisorARB = (PFNGLVERTEXATTRIBDIVISORARBPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glVertexAttribDivisorARB"));
+	pGlDrawElementsInstancedARB = (PFNGLDRAWELEMENTSINSTANCEDARBPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glDrawElementsInstancedARB"));
+	pGlDrawElementsInstancedEXT = (PFNGLDRAWELEMENTSINSTANCEDEXTPROC)
+	IRR_OGL_LOAD_EXTENSION(reinterpret_cast<const GLubyte*>("glDrawElementsInstancedEXT"));
+
 	#endif // _IRR_OPENGL_USE_EXTPOINTER_
 #endif // _IRR_WINDOWS_API_
 
@@ -615,6 +650,11 @@ bool COpenGLExtensionHandler::queryFeature(E_VIDEO_DRIVER_FEATURE feature) const
 		return FeatureAvailable[IRR_EXT_draw_buffers2];
 	case EVDF_MRT_BLEND_FUNC:
 		return FeatureAvailable[IRR_ARB_draw_buffers_blend] || FeatureAvailable[IRR_AMD_draw_buffers_blend];
+	case EVDF_INSTANCING:
+		// per instance attributes are read by a vertex shader
+		return FeatureAvailable[IRR_ARB_instanced_arrays] &&
+			(FeatureAvailable[IRR_ARB_draw_instanced] || FeatureAvailable[IRR_EXT_draw_instanced]) &&
+			(FeatureAvailable[IRR_ARB_shading_language_100] || Version>=200);
 	default:
 		return false;
 	};
@@ -836,6 +836,9 @@ class COpenGLExtensionHandler
 	//! GLSL version as Integer: 100*Major+Minor
 	u16 ShaderLanguageVersion;
 
+	//! Texture unit made active last, extGlActiveTexture skips calls which don't change it
+	GLenum ActiveTextureUnit;
+
 	// public access to the (loaded) extensions.
 	// general functions
 	void extGlActiveTexture(GLenum texture);
@@ -903,6 +906,7 @@ class COpenGLExtensionHandler
 	void extGlGetBufferSubData (GLenum target, GLintptrARB offset, GLsizeiptrARB size, GLvoid *data);
 	void *extGlMapBuffer (GLenum target, GLenum access);
 	GLboolean extGlUnmapBuffer (GLenum target);
+	void *extGlMapBufferRange (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
 	GLboolean extGlIsBuffer (GLuint buffer);
 	void extGlGetBufferParameteriv (GLenum target, GLenum pname, GLint *params);
 	void extGlGetBufferPointerv (GLenum target, GLenum pname, GLvoid **params);
@@ -912,6 +916,12 @@ class COpenGLExtensionHandler
 	void extGlDisableIndexed(GLenum target, GLuint index);
 	void extGlBlendFuncIndexed(GLuint buf, GLenum src, GLenum dst);
 	void extGlProgramParameteri(GLuint program, GLenum pname, GLint value);
+	void extGlBindAttribLocation(GLhandleARB program, GLuint index, const GLcharARB *name);
+	void extGlVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+	void extGlEnableVertexAttribArray(GLuint index);
+	void extGlDisableVertexAttribArray(GLuint index);
+	void extGlVertexAttribDivisor(GLuint index, GLuint divisor);
+	void extGlDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei primcount);
 
 
 	protected:
@@ -982,6 +992,7 @@ class COpenGLExtensionHandler
 		PFNGLGETBUFFERSUBDATAARBPROC pGlGetBufferSubDataARB;
 		PFNGLMAPBUFFERARBPROC pGlMapBufferARB;
 		PFNGLUNMAPBUFFERARBPROC pGlUnmapBufferARB;
+		PFNGLMAPBUFFERRANGEPROC pGlMapBufferRange;
 		PFNGLISBUFFERARBPROC pGlIsBufferARB;
 		PFNGLGETBUFFERPARAMETERIVARBPROC pGlGetBufferParameterivARB;
 		PFNGLGETBUFFERPOINTERVARBPROC pGlGetBufferPointervARB;
@@ -994,11 +1005,22 @@ class COpenGLExtensionHandler
 		PFNGLBLENDFUNCIPROC pGlBlendFunciARB;
 		PFNGLPROGRAMPARAMETERIARBPROC pGlProgramParameteriARB;
 		PFNGLPROGRAMPARAMETERIEXTPROC pGlProgramParameteriEXT;
+		PFNGLBINDATTRIBLOCATIONARBPROC pGlBindAttribLocationARB;
+		PFNGLVERTEXATTRIBPOINTERARBPROC pGlVertexAttribPointerARB;
+		PFNGLENABLEVERTEXATTRIBARRAYARBPROC pGlEnableVertexAttribArrayARB;
+		PFNGLDISABLEVERTEXATTRIBARRAYARBPROC pGlDisableVertexAttribArrayARB;
+		PFNGLVERTEXATTRIBDIVISORARBPROC pGlVertexAttribDivisorARB;
+		PFNGLDRAWELEMENTSINSTANCEDARBPROC pGlDrawElementsInstancedARB;
+		PFNGLDRAWELEMENTSINSTANCEDEXTPROC pGlDrawElementsInstancedEXT;
 	#endif
 };
 
 inline void COpenGLExtensionHandler::extGlActiveTexture(GLenum texture)
 {
+	if (texture == ActiveTextureUnit)
+		return;
+	ActiveTextureUnit = texture;
+
 #ifdef _IRR_OPENGL_USE_EXTPOINTER_
 	if (MultiTextureExtension && pGlActiveTextureARB)
 		pGlActiveTextureARB(texture);
@@ -1685,6 +1707,20 @@ inline GLboolean COpenGLExtensionHandler::extGlUnmapBuffer (GLenum target)
 #endif
 }
 
+inline void *COpenGLExtensionHandler::extGlMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlMapBufferRange)
+		return pGlMapBufferRange(target, offset, length, access);
+	return 0;
+#elif defined(GL_ARB_map_buffer_range)
+	return glMapBufferRange(target, offset, length, access);
+#else
+	os::Printer::log("glMapBufferRange not supported", ELL_ERROR);
+	return 0;
+#endif
+}
+
 inline GLboolean COpenGLExtensionHandler::extGlIsBuffer (GLuint buffer)
 {
 #ifdef _IRR_OPENGL_USE_EXTPOINTER_
@@ -1819,6 +1855,88 @@ inline void COpenGLExtensionHandler::extGlProgramParameteri(GLuint program, GLen
 }
 
 
+inline void COpenGLExtensionHandler::extGlBindAttribLocation(GLhandleARB program, GLuint index, const GLcharARB *name)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlBindAttribLocationARB)
+		pGlBindAttribLocationARB(program, index, name);
+#elif defined(GL_ARB_vertex_shader)
+	glBindAttribLocationARB(program, index, name);
+#else
+	os::Printer::log("glBindAttribLocation not supported", ELL_ERROR);
+#endif
+}
+
+
+inline void COpenGLExtensionHandler::extGlVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlVertexAttribPointerARB)
+		pGlVertexAttribPointerARB(index, size, type, normalized, stride, pointer);
+#elif defined(GL_ARB_vertex_program)
+	glVertexAttribPointerARB(index, size, type, normalized, stride, pointer);
+#else
+	os::Printer::log("glVertexAttribPointer not supported", ELL_ERROR);
+#endif
+}
+
+
+inline void COpenGLExtensionHandler::extGlEnableVertexAttribArray(GLuint index)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlEnableVertexAttribArrayARB)
+		pGlEnableVertexAttribArrayARB(index);
+#elif defined(GL_ARB_vertex_program)
+	glEnableVertexAttribArrayARB(index);
+#else
+	os::Printer::log("glEnableVertexAttribArray not supported", ELL_ERROR);
+#endif
+}
+
+
+inline void COpenGLExtensionHandler::extGlDisableVertexAttribArray(GLuint index)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlDisableVertexAttribArrayARB)
+		pGlDisableVertexAttribArrayARB(index);
+#elif defined(GL_ARB_vertex_program)
+	glDisableVertexAttribArrayARB(index);
+#else
+	os::Printer::log("glDisableVertexAttribArray not supported", ELL_ERROR);
+#endif
+}
+
+
+inline void COpenGLExtensionHandler::extGlVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlVertexAttribDivisorARB)
+		pGlVertexAttribDivisorARB(index, divisor);
+#elif defined(GL_ARB_instanced_arrays)
+	glVertexAttribDivisorARB(index, divisor);
+#else
+	os::Printer::log("glVertexAttribDivisor not supported", ELL_ERROR);
+#endif
+}
+
+
+inline void COpenGLExtensionHandler::extGlDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei primcount)
+{
+#ifdef _IRR_OPENGL_USE_EXTPOINTER_
+	if (pGlDrawElementsInstancedARB)
+		pGlDrawElementsInstancedARB(mode, count, type, indices, primcount);
+	else if (pGlDrawElementsInstancedEXT)
+		pGlDrawElementsInstancedEXT(mode, count, type, indices, primcount);
+#elif defined(GL_ARB_draw_instanced)
+	glDrawElementsInstancedARB(mode, count, type, indices, primcount);
+#elif defined(GL_EXT_draw_instanced)
+	glDrawElementsInstancedEXT(mode, count, type, indices, primcount);
+#else
+	os::Printer::log("glDrawElementsInstanced not supported", ELL_ERROR);
+#endif
+}
+
+
 }
 }
 
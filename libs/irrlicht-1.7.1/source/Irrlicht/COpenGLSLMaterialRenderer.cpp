@@ -91,6 +91,10 @@ COpenGLSLMaterialRenderer::~COpenGLSLMaterialRenderer()
 
 	if (Program)
 	{
+		// the handle may be reused by a new program, don't let the driver think it's still active
+		if (Driver->getActiveProgram() == Program)
+			Driver->setActiveProgram(0);
+
 		GLhandleARB shaders[8];
 		GLint count;
 		Driver->extGlGetAttachedObjects(Program, 8, &count, shaders);
@@ -177,7 +181,7 @@ void COpenGLSLMaterialRenderer::OnSetMaterial(const video::SMaterial& material,
 	if (material.MaterialType != lastMaterial.MaterialType || resetAllRenderstates)
 	{
 		if (Program)
-			Driver->extGlUseProgramObject(Program);
+			Driver->setActiveProgram(Program);
 
 		if (BaseMaterial)
 			BaseMaterial->OnSetMaterial(material, material, true, this);
@@ -195,7 +199,7 @@ void COpenGLSLMaterialRenderer::OnSetMaterial(const video::SMaterial& material,
 
 void COpenGLSLMaterialRenderer::OnUnsetMaterial()
 {
-	Driver->extGlUseProgramObject(0);
+	Driver->setActiveProgram(0);
 
 	if (BaseMaterial)
 		BaseMaterial->OnUnsetMaterial();
@@ -319,6 +323,17 @@ bool COpenGLSLMaterialRenderer::linkProgram()
 
 		GLint size;
 		Driver->extGlGetActiveUniformARB(Program, i, maxlen, 0, &size, &ui.type, reinterpret_cast<GLcharARB*>(buf));
+
+		// some drivers name arrays after their first element, "name[0]"
+		for (c8* bracket = buf; *bracket; ++bracket)
+		{
+			if (*bracket == '[')
+			{
+				*bracket = 0;
+				break;
+			}
+		}
+
 		ui.name = buf;
 
 		UniformInfo.push_back(ui);
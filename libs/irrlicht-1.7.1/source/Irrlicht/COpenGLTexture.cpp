@@ -297,6 +297,9 @@ void COpenGLTexture::uploadTexture(bool newTexture, void* mipmapData, u32 level)
 	// mipmap handling for main texture
 	if (!level && newTexture)
 	{
+		// filters are set here directly
+		StatesCache.reset();
+
 #ifndef DISABLE_MIPMAPPING
 #ifdef GL_SGIS_generate_mipmap
 		// auto generate if possible and no mipmap data is given
@@ -575,6 +578,12 @@ void COpenGLTexture::setIsRenderTarget(bool isTarget)
 }
 
 
+COpenGLTexture::SStatesCache& COpenGLTexture::getStatesCache() const
+{
+	return StatesCache;
+}
+
+
 bool COpenGLTexture::isFrameBufferObject() const
 {
 	return false;
@@ -103,6 +103,36 @@ public:
 	//! sets whether this texture is intended to be used as a render target.
 	void setIsRenderTarget(bool isTarget);
 
+	//! texture object parameters last set through the driver, -1 if unknown
+	struct SStatesCache
+	{
+		enum E_STATE
+		{
+			MIN_FILTER=0,
+			MAG_FILTER,
+			WRAP_S,
+			WRAP_T,
+			ANISOTROPY,
+			STATE_COUNT
+		};
+
+		SStatesCache()
+		{
+			reset();
+		}
+
+		void reset()
+		{
+			for (u32 i=0; i<STATE_COUNT; ++i)
+				Values[i] = -1;
+		}
+
+		GLint Values[STATE_COUNT];
+	};
+
+	//! get the parameters cache, the driver skips glTexParameter calls which change nothing
+	SStatesCache& getStatesCache() const;
+
 protected:
 
 	//! protected constructor with basic setup, no GL texture name created, for derived classes
@@ -142,6 +172,8 @@ protected:
 	bool AutomaticMipmapUpdate;
 	bool ReadOnlyLock;
 	bool KeepImage;
+
+	mutable SStatesCache StatesCache;
 };
 
 //! OpenGL FBO texture.
@@ -1189,6 +1189,88 @@ bool CSceneManager::isCulled(const ISceneNode* node) const
 }
 
 
+//! packs the render queue key of a node
+CSceneManager::DefaultNodeEntry::DefaultNodeEntry(ISceneNode* n,
+		const core::vector3df& camera, E_SCENE_NODE_RENDER_PASS pass)
+	: Node(n), Key(0)
+{
+	// passes are single bits, store the bit index
+	u32 passIndex = 0;
+	while (passIndex < 15 && (1u << passIndex) < (u32)pass)
+		++passIndex;
+
+	u32 shader = 0;
+	u32 textures = 2166136261u;
+
+	if (n->getMaterialCount())
+	{
+		const video::SMaterial& material = n->getMaterial(0);
+
+		shader = (u32)material.MaterialType;
+
+		// FNV-1a over the texture pointers of all layers
+		for (u32 i=0; i<video::MATERIAL_MAX_TEXTURES; ++i)
+			textures = (textures ^ (u32)((size_t)material.getTexture(i) >> 4)) * 16777619u;
+	}
+
+	// level geometry often has its origin far from the vertices, use the box center.
+	// Squared distances are positive, so their bit patterns sort like the values.
+	f32 distance = n->getTransformedBoundingBox().getCenter().getDistanceFromSQ(camera);
+
+	Key = ((u64)passIndex << 60) |
+		((u64)(shader & 0xfff) << 48) |
+		((u64)((textures ^ (textures >> 24)) & 0xffffff) << 24) |
+		(u64)(IR(distance) >> 8);
+}
+
+
+//! radix sorts a render queue on the entry keys
+void CSceneManager::sortRenderQueue(core::array<DefaultNodeEntry>& queue)
+{
+	const u32 count = queue.size();
+
+	if (count < 2)
+		return;
+
+	RenderQueueBuffer.set_used(count);
+
+	DefaultNodeEntry* src = queue.pointer();
+	DefaultNodeEntry* dst = RenderQueueBuffer.pointer();
+
+	// 8 bits per pass, least significant first. Passes where all keys
+	// share the same byte don't change the order and are skipped.
+	u32 histogram[256];
+
+	for (u32 shift=0; shift<64; shift+=8)
+	{
+		memset(histogram, 0, sizeof(histogram));
+
+		u32 i;
+		for (i=0; i<count; ++i)
+			++histogram[(u32)(src[i].Key >> shift) & 0xff];
+
+		if (histogram[(u32)(src[0].Key >> shift) & 0xff] == count)
+			continue;
+
+		u32 offset = 0;
+		for (i=0; i<256; ++i)
+		{
+			const u32 n = histogram[i];
+			histogram[i] = offset;
+			offset += n;
+		}
+
+		for (i=0; i<count; ++i)
+			dst[histogram[(u32)(src[i].Key >> shift) & 0xff]++] = src[i];
+
+		core::swap(src, dst);
+	}
+
+	if (src != queue.pointer())
+		memcpy(queue.pointer(), src, count * sizeof(DefaultNodeEntry));
+}
+
+
 //! registers a node for rendering it at a specific time.
 u32 CSceneManager::registerNodeForRendering(ISceneNode* node, E_SCENE_NODE_RENDER_PASS pass)
 {
@@ -1232,7 +1314,7 @@ u32 CSceneManager::registerNodeForRendering(ISceneNode* node, E_SCENE_NODE_RENDE
 	case ESNRP_SOLID:
 		if (!isCulled(node))
 		{
-			SolidNodeList.push_back(node);
+			SolidNodeList.push_back(DefaultNodeEntry(node, camWorldPos, ESNRP_SOLID));
 			taken = 1;
 		}
 		break;
@@ -1273,7 +1355,7 @@ u32 CSceneManager::registerNodeForRendering(ISceneNode* node, E_SCENE_NODE_RENDE
 			// not transparent, register as solid
 			if ( 0 == taken )
 			{
-				SolidNodeList.push_back(node);
+				SolidNodeList.push_back(DefaultNodeEntry(node, camWorldPos, ESNRP_SOLID));
 				taken = 1;
 			}
 		}
@@ -1450,7 +1532,7 @@ void CSceneManager::drawAll()
 		CurrentRendertime = ESNRP_SOLID;
 		Driver->getOverrideMaterial().Enabled = ((Driver->getOverrideMaterial().EnablePasses & CurrentRendertime) != 0);
 
-		SolidNodeList.sort(); // sort by textures
+		sortRenderQueue(SolidNodeList); // sort by shader, textures and depth
 
 		if(LightManager)
 		{
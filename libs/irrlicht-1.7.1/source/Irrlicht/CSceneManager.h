@@ -515,25 +515,28 @@ namespace scene
 		//! reads user data of a node
 		void readUserData(io::IXMLReader* reader, ISceneNode* node, ISceneUserDataSerializer* userDataSerializer);
 
+		//! render queue entry, sorted on a key packed from the first material of the node
+		/** Key bits from high to low: render pass (4), material type (12),
+		hash of the texture set (24) and distance to the camera (24), so the
+		queue is grouped by shader, then by textures, then drawn front to back. */
 		struct DefaultNodeEntry
 		{
-			DefaultNodeEntry(ISceneNode* n) :
-				Node(n), TextureValue(0)
-			{
-				if (n->getMaterialCount())
-					TextureValue = (n->getMaterial(0).getTexture(0));
-			}
+			DefaultNodeEntry() : Node(0), Key(0) {}
+
+			DefaultNodeEntry(ISceneNode* n, const core::vector3df& camera, E_SCENE_NODE_RENDER_PASS pass);
 
 			bool operator < (const DefaultNodeEntry& other) const
 			{
-				return (TextureValue < other.TextureValue);
+				return (Key < other.Key);
 			}
 
 			ISceneNode* Node;
-			private:
-			void* TextureValue;
+			u64 Key;
 		};
 
+		//! radix sorts a render queue on the entry keys
+		void sortRenderQueue(core::array<DefaultNodeEntry>& queue);
+
 		//! sort on distance (center) to camera
 		struct TransparentNodeEntry
 		{
@@ -600,6 +603,7 @@ namespace scene
 		core::array<ISceneNode*> ShadowNodeList;
 		core::array<ISceneNode*> SkyBoxList;
 		core::array<DefaultNodeEntry> SolidNodeList;
+		core::array<DefaultNodeEntry> RenderQueueBuffer;
 		core::array<TransparentNodeEntry> TransparentNodeList;
 		core::array<TransparentNodeEntry> TransparentEffectNodeList;
 
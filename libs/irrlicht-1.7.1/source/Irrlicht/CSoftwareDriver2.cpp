@@ -13,6 +13,19 @@
 #include "S3DVertex.h"
 #include "S4DVertex.h"
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+	#ifdef _IRR_WINDOWS_API_
+		#include <windows.h>
+	#else
+		#include <pthread.h>
+		#include <unistd.h>
+	#endif
+
+	#ifdef SOFTWARE_DRIVER_2_TILE_SSE
+		#include <xmmintrin.h>
+	#endif
+#endif
+
 
 #define MAT_TEXTURE(tex) ( (video::CSoftwareTexture2*) Material.org.getTexture ( tex ) )
 
@@ -22,13 +35,94 @@ namespace irr
 namespace video
 {
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+
+struct STileJob : public SDriverJob
+{
+	CBurningVideoDriver* Driver;
+	u32 Slot;
+};
+
+static void runTileJob ( SDriverJob* job )
+{
+	STileJob* tiles = (STileJob*) job;
+	tiles->Driver->drawTiles ( tiles->Slot );
+}
+
+struct STileThreads
+{
+#ifdef _IRR_WINDOWS_API_
+	CRITICAL_SECTION Lock;
+	HANDLE Start, Done;
+	core::array<HANDLE> Threads;
+#else
+	pthread_mutex_t Lock;
+	pthread_cond_t Start, Done;
+	core::array<pthread_t> Threads;
+#endif
+
+	bool Stop;
+
+	// incremented for every flush, workers wait for a new one
+	u32 Generation;
+
+	// workers still rasterizing the current flush
+	u32 Busy;
+
+	// slot handed to the next worker that starts
+	u32 NextWorker;
+
+	// next entry of the tile queue to rasterize
+	u32 NextTile;
+
+	// scheduler of the application replacing the threads, see setJobScheduler
+	DriverJobSubmit Submit;
+	DriverJobWait Wait;
+	void* UserData;
+
+	// one job for every slot, slot 0 is run by the flushing thread
+	STileJob Jobs[SOFTWARE_DRIVER_2_TILE_MAX_THREADS];
+};
+
+#ifdef _IRR_WINDOWS_API_
+static DWORD WINAPI tileWorker(LPVOID data)
+#else
+static void* tileWorker(void *data)
+#endif
+{
+	((CBurningVideoDriver*)data)->serveTiles();
+
+	return 0;
+}
+
+static u32 getProcessorCount()
+{
+#ifdef _IRR_WINDOWS_API_
+	SYSTEM_INFO info;
+	GetSystemInfo ( &info );
+	return info.dwNumberOfProcessors;
+#else
+	const long count = sysconf ( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (u32) count : 1;
+#endif
+}
+
+static inline bool sameTexture ( const sInternalTexture &a, const sInternalTexture &b )
+{
+	return	a.Texture == b.Texture && a.data == b.data &&
+			a.lodLevel == b.lodLevel && a.pitchlog2 == b.pitchlog2 &&
+			a.textureXMask == b.textureXMask && a.textureYMask == b.textureYMask;
+}
+
+#endif // SOFTWARE_DRIVER_2_TILED
+
 
 //! constructor
 CBurningVideoDriver::CBurningVideoDriver(const core::dimension2d<u32>& windowSize, bool fullscreen, io::IFileSystem* io, video::IImagePresenter* presenter)
 : CNullDriver(io, windowSize), BackBuffer(0), Presenter(presenter),
 	WindowId(0), SceneSourceRect(0),
 	RenderTargetTexture(0), RenderTargetSurface(0), CurrentShader(0),
-	 DepthBuffer(0), CurrentOut ( 12 * 2, 128 ), Temp ( 12 * 2, 128 )
+	CurrentShaderType(ETR_INVALID), DepthBuffer(0), CurrentOut ( 12 * 2, 128 ), Temp ( 12 * 2, 128 )
 {
 	#ifdef _DEBUG
 	setDebugName("CBurningVideoDriver");
@@ -45,36 +139,47 @@ CBurningVideoDriver::CBurningVideoDriver(const core::dimension2d<u32>& windowSiz
 	}
 
 	// create triangle renderers
+	createShaders ( BurningShader, DepthBuffer );
+
+#ifdef SOFTWARE_DRIVER_2_TILED
+	irr::memset32 ( TileShader, 0, sizeof ( TileShader ) );
+	memset ( TileTexture, 0, sizeof ( TileTexture ) );
+	TileSlots = 0;
+	TilesActive = false;
+	TileColumns = 0;
+	TileRows = 0;
+
+	TileThreads = new STileThreads();
+	TileThreads->Stop = false;
+	TileThreads->Generation = 0;
+	TileThreads->Busy = 0;
+	TileThreads->NextWorker = 0;
+	TileThreads->NextTile = 0;
+	TileThreads->Submit = 0;
+	TileThreads->Wait = 0;
+	TileThreads->UserData = 0;
+
+	for ( u32 slot = 0; slot != SOFTWARE_DRIVER_2_TILE_MAX_THREADS; ++slot )
+	{
+		TileThreads->Jobs[slot].Run = runTileJob;
+		TileThreads->Jobs[slot].Driver = this;
+		TileThreads->Jobs[slot].Slot = slot;
+	}
+
+#ifdef _IRR_WINDOWS_API_
+	InitializeCriticalSection ( &TileThreads->Lock );
+	// manual reset, every worker has to see the start of a flush
+	TileThreads->Start = CreateEvent ( NULL, TRUE, FALSE, NULL );
+	TileThreads->Done = CreateEvent ( NULL, FALSE, FALSE, NULL );
+#else
+	pthread_mutex_init ( &TileThreads->Lock, NULL );
+	pthread_cond_init ( &TileThreads->Start, NULL );
+	pthread_cond_init ( &TileThreads->Done, NULL );
+#endif
 
-	irr::memset32 ( BurningShader, 0, sizeof ( BurningShader ) );
-	//BurningShader[ETR_FLAT] = createTRFlat2(DepthBuffer);
-	//BurningShader[ETR_FLAT_WIRE] = createTRFlatWire2(DepthBuffer);
-	BurningShader[ETR_GOURAUD] = createTriangleRendererGouraud2(DepthBuffer);
-	BurningShader[ETR_GOURAUD_ALPHA] = createTriangleRendererGouraudAlpha2(DepthBuffer );
-	BurningShader[ETR_GOURAUD_ALPHA_NOZ] = createTRGouraudAlphaNoZ2(DepthBuffer );
-	//BurningShader[ETR_GOURAUD_WIRE] = createTriangleRendererGouraudWire2(DepthBuffer);
-	//BurningShader[ETR_TEXTURE_FLAT] = createTriangleRendererTextureFlat2(DepthBuffer);
-	//BurningShader[ETR_TEXTURE_FLAT_WIRE] = createTriangleRendererTextureFlatWire2(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD] = createTriangleRendererTextureGouraud2(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_LIGHTMAP_M1] = createTriangleRendererTextureLightMap2_M1(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_LIGHTMAP_M2] = createTriangleRendererTextureLightMap2_M2(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_LIGHTMAP_M4] = createTriangleRendererGTextureLightMap2_M4(DepthBuffer);
-	BurningShader[ETR_TEXTURE_LIGHTMAP_M4] = createTriangleRendererTextureLightMap2_M4(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_LIGHTMAP_ADD] = createTriangleRendererTextureLightMap2_Add(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_DETAIL_MAP] = createTriangleRendererTextureDetailMap2(DepthBuffer);
-
-	BurningShader[ETR_TEXTURE_GOURAUD_WIRE] = createTriangleRendererTextureGouraudWire2(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_NOZ] = createTRTextureGouraudNoZ2();
-	BurningShader[ETR_TEXTURE_GOURAUD_ADD] = createTRTextureGouraudAdd2(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_ADD_NO_Z] = createTRTextureGouraudAddNoZ2(DepthBuffer);
-	BurningShader[ETR_TEXTURE_GOURAUD_VERTEX_ALPHA] = createTriangleRendererTextureVertexAlpha2 ( DepthBuffer );
-
-	BurningShader[ETR_TEXTURE_GOURAUD_ALPHA] = createTRTextureGouraudAlpha(DepthBuffer );
-	BurningShader[ETR_TEXTURE_GOURAUD_ALPHA_NOZ] = createTRTextureGouraudAlphaNoZ( DepthBuffer );
-
-	BurningShader[ETR_TEXTURE_BLEND] = createTRTextureBlend( DepthBuffer );
-
-	BurningShader[ETR_REFERENCE] = createTriangleRendererReference ( DepthBuffer );
+	// the calling thread rasterizes too
+	startTileThreads ( getProcessorCount() - 1 );
+#endif
 
 
 	// add the same renderer for all solid types
@@ -136,6 +241,27 @@ CBurningVideoDriver::~CBurningVideoDriver()
 		if (BurningShader[i])
 			BurningShader[i]->drop();
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+	stopTileThreads();
+
+	for (u32 slot=0; slot<TileSlots; ++slot)
+		for (s32 i=0; i<ETR2_COUNT; ++i)
+			if (TileShader[slot][i])
+				TileShader[slot][i]->drop();
+
+#ifdef _IRR_WINDOWS_API_
+	DeleteCriticalSection ( &TileThreads->Lock );
+	CloseHandle ( TileThreads->Start );
+	CloseHandle ( TileThreads->Done );
+#else
+	pthread_mutex_destroy ( &TileThreads->Lock );
+	pthread_cond_destroy ( &TileThreads->Start );
+	pthread_cond_destroy ( &TileThreads->Done );
+#endif
+
+	delete TileThreads;
+#endif
+
 	// delete zbuffer
 
 	if (DepthBuffer)
@@ -149,6 +275,41 @@ CBurningVideoDriver::~CBurningVideoDriver()
 }
 
 
+//! creates a set of triangle renderers drawing into depthBuffer
+void CBurningVideoDriver::createShaders( IBurningShader** shaders, IDepthBuffer* depthBuffer )
+{
+	irr::memset32 ( shaders, 0, sizeof ( IBurningShader* ) * ETR2_COUNT );
+	//shaders[ETR_FLAT] = createTRFlat2(depthBuffer);
+	//shaders[ETR_FLAT_WIRE] = createTRFlatWire2(depthBuffer);
+	shaders[ETR_GOURAUD] = createTriangleRendererGouraud2(depthBuffer);
+	shaders[ETR_GOURAUD_ALPHA] = createTriangleRendererGouraudAlpha2(depthBuffer );
+	shaders[ETR_GOURAUD_ALPHA_NOZ] = createTRGouraudAlphaNoZ2(depthBuffer );
+	//shaders[ETR_GOURAUD_WIRE] = createTriangleRendererGouraudWire2(depthBuffer);
+	//shaders[ETR_TEXTURE_FLAT] = createTriangleRendererTextureFlat2(depthBuffer);
+	//shaders[ETR_TEXTURE_FLAT_WIRE] = createTriangleRendererTextureFlatWire2(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD] = createTriangleRendererTextureGouraud2(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_LIGHTMAP_M1] = createTriangleRendererTextureLightMap2_M1(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_LIGHTMAP_M2] = createTriangleRendererTextureLightMap2_M2(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_LIGHTMAP_M4] = createTriangleRendererGTextureLightMap2_M4(depthBuffer);
+	shaders[ETR_TEXTURE_LIGHTMAP_M4] = createTriangleRendererTextureLightMap2_M4(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_LIGHTMAP_ADD] = createTriangleRendererTextureLightMap2_Add(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_DETAIL_MAP] = createTriangleRendererTextureDetailMap2(depthBuffer);
+
+	shaders[ETR_TEXTURE_GOURAUD_WIRE] = createTriangleRendererTextureGouraudWire2(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_NOZ] = createTRTextureGouraudNoZ2();
+	shaders[ETR_TEXTURE_GOURAUD_ADD] = createTRTextureGouraudAdd2(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_ADD_NO_Z] = createTRTextureGouraudAddNoZ2(depthBuffer);
+	shaders[ETR_TEXTURE_GOURAUD_VERTEX_ALPHA] = createTriangleRendererTextureVertexAlpha2 ( depthBuffer );
+
+	shaders[ETR_TEXTURE_GOURAUD_ALPHA] = createTRTextureGouraudAlpha(depthBuffer );
+	shaders[ETR_TEXTURE_GOURAUD_ALPHA_NOZ] = createTRTextureGouraudAlphaNoZ( depthBuffer );
+
+	shaders[ETR_TEXTURE_BLEND] = createTRTextureBlend( depthBuffer );
+
+	shaders[ETR_REFERENCE] = createTriangleRendererReference ( depthBuffer );
+}
+
+
 /*!
 	selects the right triangle renderer based on the render states.
 */
@@ -247,25 +408,31 @@ void CBurningVideoDriver::setCurrentShader()
 	//shader = ETR_REFERENCE;
 
 	// switchToTriangleRenderer
+	CurrentShaderType = shader;
 	CurrentShader = BurningShader[shader];
 	if ( CurrentShader )
-	{
-		CurrentShader->setZCompareFunc ( Material.org.ZBuffer );
-		CurrentShader->setRenderTarget(RenderTargetSurface, ViewPort);
-		CurrentShader->setMaterial ( Material );
+		setShaderState ( CurrentShader, shader );
 
-		switch ( shader )
-		{
-			case ETR_TEXTURE_GOURAUD_ALPHA:
-			case ETR_TEXTURE_GOURAUD_ALPHA_NOZ:
-			case ETR_TEXTURE_BLEND:
-				CurrentShader->setParam ( 0, Material.org.MaterialTypeParam );
-				break;
-			default:
+}
+
+
+//! passes render target and material to a triangle renderer
+void CBurningVideoDriver::setShaderState( IBurningShader* shader, EBurningFFShader type )
+{
+	shader->setZCompareFunc ( Material.org.ZBuffer );
+	shader->setRenderTarget(RenderTargetSurface, ViewPort);
+	shader->setMaterial ( Material );
+
+	switch ( type )
+	{
+		case ETR_TEXTURE_GOURAUD_ALPHA:
+		case ETR_TEXTURE_GOURAUD_ALPHA_NOZ:
+		case ETR_TEXTURE_BLEND:
+			shader->setParam ( 0, Material.org.MaterialTypeParam );
 			break;
-		}
+		default:
+		break;
 	}
-
 }
 
 
@@ -1270,6 +1437,15 @@ void CBurningVideoDriver::drawVertexPrimitiveList(const void* vertices, u32 vert
 
 	VertexCache_reset ( vertices, vertexCount, indexList, primitiveCount, vType, pType, iType );
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+	// bin big draw calls, the tiles are rasterized in parallel
+	TilesActive =	TileSlots > 1 &&
+					primitiveCount >= SOFTWARE_DRIVER_2_TILE_MIN_PRIMITIVES &&
+					CurrentShader->canDrawTiles();
+	if ( TilesActive )
+		beginTiles();
+#endif
+
 	const s4DVertex * face[3];
 
 	f32 dc_area;
@@ -1306,18 +1482,18 @@ void CBurningVideoDriver::drawVertexPrimitiveList(const void* vertices, u32 vert
 			{
 				if ( 0 == (tex = MAT_TEXTURE ( g )) )
 				{
-					CurrentShader->setTextureParam(g, 0, 0);
+					setShaderTexture(g, 0, 0);
 					continue;
 				}
 
 				lodLevel = s32_log2_f32 ( texelarea2 ( face, g ) * dc_area );
-				CurrentShader->setTextureParam(g, tex, lodLevel);
+				setShaderTexture(g, tex, lodLevel);
 				select_polygon_mipmap2 ( (s4DVertex**) face, g, tex->getSize() );
 
 			}
 
 			// rasterize
-			CurrentShader->drawTriangle ( face[0] + 1, face[1] + 1, face[2] + 1 );
+			drawShaderTriangle ( face[0] + 1, face[1] + 1, face[2] + 1 );
 			continue;
 		}
 
@@ -1424,12 +1600,12 @@ void CBurningVideoDriver::drawVertexPrimitiveList(const void* vertices, u32 vert
 		{
 			if ( 0 == (tex = MAT_TEXTURE ( g )) )
 			{
-				CurrentShader->setTextureParam(g, 0, 0);
+				setShaderTexture(g, 0, 0);
 				continue;
 			}
 
 			lodLevel = s32_log2_f32 ( texelarea ( CurrentOut.data, g ) / dc_area );
-			CurrentShader->setTextureParam(g, tex, lodLevel);
+			setShaderTexture(g, tex, lodLevel);
 			select_polygon_mipmap ( CurrentOut.data, vOut, g, tex->getSize() );
 		}
 
@@ -1437,13 +1613,21 @@ void CBurningVideoDriver::drawVertexPrimitiveList(const void* vertices, u32 vert
 		for ( g = 0; g <= vOut - 6; g += 2 )
 		{
 			// rasterize
-			CurrentShader->drawTriangle ( CurrentOut.data + 0 + 1,
+			drawShaderTriangle ( CurrentOut.data + 0 + 1,
 							CurrentOut.data + g + 3,
 							CurrentOut.data + g + 5);
 		}
 
 	}
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+	if ( TilesActive )
+	{
+		flushTiles();
+		TilesActive = false;
+	}
+#endif
+
 	// dump statistics
 /*
 	char buf [64];
@@ -1457,6 +1641,519 @@ void CBurningVideoDriver::drawVertexPrimitiveList(const void* vertices, u32 vert
 }
 
 
+//! sets a texture of the current renderer, or of the triangles binned next
+void CBurningVideoDriver::setShaderTexture( u32 stage, video::CSoftwareTexture2* texture, s32 lodLevel )
+{
+#ifdef SOFTWARE_DRIVER_2_TILED
+	if ( TilesActive )
+	{
+		// lock here, locking selects the mipmap of the texture
+		memset ( &TileTexture[stage], 0, sizeof ( sInternalTexture ) );
+		IBurningShader::getInternalTexture ( TileTexture[stage], texture, lodLevel );
+		return;
+	}
+#endif
+
+	CurrentShader->setTextureParam ( stage, texture, lodLevel );
+}
+
+
+//! rasterizes a triangle with the current renderer, or bins it
+void CBurningVideoDriver::drawShaderTriangle( const s4DVertex *a, const s4DVertex *b, const s4DVertex *c )
+{
+#ifdef SOFTWARE_DRIVER_2_TILED
+	if ( TilesActive )
+	{
+		binTriangle ( a, b, c );
+		return;
+	}
+#endif
+
+	CurrentShader->drawTriangle ( a, b, c );
+}
+
+
+#ifdef SOFTWARE_DRIVER_2_TILED
+
+//! starts count worker threads, each with its own set of triangle renderers
+void CBurningVideoDriver::startTileThreads( u32 count )
+{
+	count = core::min_ ( count, (u32) SOFTWARE_DRIVER_2_TILE_MAX_THREADS - 1 );
+
+	TileThreads->Stop = false;
+	TileThreads->NextWorker = 0;
+
+	for ( u32 i = 0; i != count; ++i )
+	{
+#ifdef _IRR_WINDOWS_API_
+		HANDLE thread = CreateThread ( NULL, 0, tileWorker, this, 0, NULL );
+
+		if ( thread != NULL )
+			TileThreads->Threads.push_back ( thread );
+#else
+		pthread_t thread;
+
+		if ( pthread_create ( &thread, NULL, tileWorker, this ) == 0 )
+			TileThreads->Threads.push_back ( thread );
+#endif
+	}
+
+	// slot 0 belongs to the calling thread
+	createTileSlots ( TileThreads->Threads.size() + 1 );
+}
+
+
+//! creates the renderers of count threads, less than 2 turns tiling off
+void CBurningVideoDriver::createTileSlots( u32 count )
+{
+	u32 slot;
+	for ( slot = 0; slot != TileSlots; ++slot )
+	{
+		for ( s32 i = 0; i != ETR2_COUNT; ++i )
+		{
+			if ( TileShader[slot][i] )
+				TileShader[slot][i]->drop();
+
+			TileShader[slot][i] = 0;
+		}
+	}
+
+	TileSlots = count > 1 ? core::min_ ( count, (u32) SOFTWARE_DRIVER_2_TILE_MAX_THREADS ) : 0;
+
+	if ( 0 == TileSlots )
+		return;
+
+	for ( slot = 0; slot != TileSlots; ++slot )
+		createShaders ( TileShader[slot], DepthBuffer );
+
+	char buf[64];
+	sprintf ( buf, "Burning's Video: %d tile rasterizer threads", TileSlots );
+	os::Printer::log ( buf );
+}
+
+
+//! runs the tile rasterization as jobs of the application instead of own threads
+void CBurningVideoDriver::setJobScheduler(u32 threads, DriverJobSubmit submit,
+	DriverJobWait wait, void* userData)
+{
+	stopTileThreads();
+
+	TileThreads->Submit = submit;
+	TileThreads->Wait = wait;
+	TileThreads->UserData = userData;
+
+	if ( submit )
+		createTileSlots ( threads );
+	else
+		startTileThreads ( getProcessorCount() - 1 );
+}
+
+
+void CBurningVideoDriver::stopTileThreads()
+{
+#ifdef _IRR_WINDOWS_API_
+	EnterCriticalSection ( &TileThreads->Lock );
+	TileThreads->Stop = true;
+	SetEvent ( TileThreads->Start );
+	LeaveCriticalSection ( &TileThreads->Lock );
+
+	for ( u32 i = 0; i != TileThreads->Threads.size(); ++i )
+	{
+		WaitForSingleObject ( TileThreads->Threads[i], INFINITE );
+		CloseHandle ( TileThreads->Threads[i] );
+	}
+#else
+	pthread_mutex_lock ( &TileThreads->Lock );
+	TileThreads->Stop = true;
+	pthread_cond_broadcast ( &TileThreads->Start );
+	pthread_mutex_unlock ( &TileThreads->Lock );
+
+	for ( u32 i = 0; i != TileThreads->Threads.size(); ++i )
+		pthread_join ( TileThreads->Threads[i], NULL );
+#endif
+
+	TileThreads->Threads.clear();
+}
+
+
+//! worker thread loop of the tile renderer
+void CBurningVideoDriver::serveTiles()
+{
+#ifdef _IRR_WINDOWS_API_
+	EnterCriticalSection ( &TileThreads->Lock );
+#else
+	pthread_mutex_lock ( &TileThreads->Lock );
+#endif
+
+	const u32 slot = ++TileThreads->NextWorker;
+
+	// flushes are numbered from 1
+	u32 generation = 0;
+
+	while ( true )
+	{
+#ifdef _IRR_WINDOWS_API_
+		while ( !TileThreads->Stop && TileThreads->Generation == generation )
+		{
+			LeaveCriticalSection ( &TileThreads->Lock );
+			WaitForSingleObject ( TileThreads->Start, INFINITE );
+			EnterCriticalSection ( &TileThreads->Lock );
+		}
+#else
+		while ( !TileThreads->Stop && TileThreads->Generation == generation )
+			pthread_cond_wait ( &TileThreads->Start, &TileThreads->Lock );
+#endif
+
+		if ( TileThreads->Stop )
+			break;
+
+		generation = TileThreads->Generation;
+
+#ifdef _IRR_WINDOWS_API_
+		LeaveCriticalSection ( &TileThreads->Lock );
+#else
+		pthread_mutex_unlock ( &TileThreads->Lock );
+#endif
+
+		drawTiles ( slot );
+
+#ifdef _IRR_WINDOWS_API_
+		EnterCriticalSection ( &TileThreads->Lock );
+
+		if ( --TileThreads->Busy == 0 )
+			SetEvent ( TileThreads->Done );
+#else
+		pthread_mutex_lock ( &TileThreads->Lock );
+
+		if ( --TileThreads->Busy == 0 )
+			pthread_cond_signal ( &TileThreads->Done );
+#endif
+	}
+
+#ifdef _IRR_WINDOWS_API_
+	LeaveCriticalSection ( &TileThreads->Lock );
+#else
+	pthread_mutex_unlock ( &TileThreads->Lock );
+#endif
+}
+
+
+//! lays the tile grid over the viewport
+void CBurningVideoDriver::beginTiles()
+{
+	TileArea = ViewPort;
+	TileColumns = ( TileArea.getWidth() + SOFTWARE_DRIVER_2_TILE_WIDTH - 1 ) / SOFTWARE_DRIVER_2_TILE_WIDTH;
+	TileRows = ( TileArea.getHeight() + SOFTWARE_DRIVER_2_TILE_HEIGHT - 1 ) / SOFTWARE_DRIVER_2_TILE_HEIGHT;
+
+	const u32 count = TileColumns * TileRows;
+
+	while ( TileBins.size() < count )
+		TileBins.push_back ( core::array<u32>() );
+
+	for ( u32 i = 0; i != count; ++i )
+		TileBins[i].set_used ( 0 );
+
+	// never grow while binning
+	if ( TileVertices.allocated_size() < SOFTWARE_DRIVER_2_TILE_MAX_TRIANGLES * 3 )
+		TileVertices.reallocate ( SOFTWARE_DRIVER_2_TILE_MAX_TRIANGLES * 3 );
+
+	TileVertices.set_used ( 0 );
+	TileTriangleState.set_used ( 0 );
+	TileStates.set_used ( 0 );
+	memset ( TileTexture, 0, sizeof ( TileTexture ) );
+}
+
+
+//! adds a screen space triangle to the bins of the tiles it touches
+void CBurningVideoDriver::binTriangle( const s4DVertex *a, const s4DVertex *b, const s4DVertex *c )
+{
+	const s4DVertex *v[3] = { a, b, c };
+
+	// edge functions e(x,y) = A*x + B*y + C
+	f32 A[3], B[3], C[3];
+	u32 i;
+
+	for ( i = 0; i != 3; ++i )
+	{
+		const sVec4 &p = v[i]->Pos;
+		const sVec4 &q = v[ i == 2 ? 0 : i + 1 ]->Pos;
+
+		A[i] = p.y - q.y;
+		B[i] = q.x - p.x;
+		C[i] = p.x * q.y - p.y * q.x;
+	}
+
+	// twice the area, nothing is rasterized for degenerated triangles
+	const f32 area = A[0] * c->Pos.x + B[0] * c->Pos.y + C[0];
+	if ( area == 0.f )
+		return;
+
+	// make the inside positive
+	if ( area < 0.f )
+	{
+		for ( i = 0; i != 3; ++i )
+		{
+			A[i] = -A[i];
+			B[i] = -B[i];
+			C[i] = -C[i];
+		}
+	}
+
+	// texture state
+	u32 state = TileStates.size() / BURNING_MATERIAL_MAX_TEXTURES;
+	bool same = state > 0;
+
+	for ( i = 0; same && i != BURNING_MATERIAL_MAX_TEXTURES; ++i )
+		same = sameTexture ( TileTexture[i], TileStates[ ( state - 1 ) * BURNING_MATERIAL_MAX_TEXTURES + i ] );
+
+	if ( same )
+		state -= 1;
+	else
+	{
+		for ( i = 0; i != BURNING_MATERIAL_MAX_TEXTURES; ++i )
+			TileStates.push_back ( TileTexture[i] );
+	}
+
+	const u32 triangle = TileTriangleState.size();
+	TileTriangleState.push_back ( state );
+
+	const u32 first = TileVertices.size();
+	TileVertices.set_used ( first + 3 );
+	TileVertices[first + 0] = *a;
+	TileVertices[first + 1] = *b;
+	TileVertices[first + 2] = *c;
+
+	// bounding box in tiles
+	const s32 left = TileArea.UpperLeftCorner.X;
+	const s32 top = TileArea.UpperLeftCorner.Y;
+
+	const s32 x0 = core::s32_clamp ( core::floor32 ( core::min_ ( a->Pos.x, b->Pos.x, c->Pos.x ) ) - left,
+						0, TileArea.getWidth() - 1 ) / SOFTWARE_DRIVER_2_TILE_WIDTH;
+	const s32 x1 = core::s32_clamp ( core::ceil32 ( core::max_ ( a->Pos.x, b->Pos.x, c->Pos.x ) ) - left,
+						0, TileArea.getWidth() - 1 ) / SOFTWARE_DRIVER_2_TILE_WIDTH;
+	const s32 y0 = core::s32_clamp ( core::floor32 ( core::min_ ( a->Pos.y, b->Pos.y, c->Pos.y ) ) - top,
+						0, TileArea.getHeight() - 1 ) / SOFTWARE_DRIVER_2_TILE_HEIGHT;
+	const s32 y1 = core::s32_clamp ( core::ceil32 ( core::max_ ( a->Pos.y, b->Pos.y, c->Pos.y ) ) - top,
+						0, TileArea.getHeight() - 1 ) / SOFTWARE_DRIVER_2_TILE_HEIGHT;
+
+	s32 x;
+	s32 y;
+
+	if ( x0 == x1 && y0 == y1 )
+	{
+		TileBins[ y0 * TileColumns + x0 ].push_back ( triangle );
+	}
+	else
+	{
+		/*
+			reject tiles outside of an edge. the maximum of an edge function
+			over a rectangle is at the corner selected by the signs of A and B,
+			the tile is grown by a pixel to stay conservative
+		*/
+#ifdef SOFTWARE_DRIVER_2_TILE_SSE
+		// the 4th lane is always inside
+		const __m128 eA = _mm_setr_ps ( A[0], A[1], A[2], 0.f );
+		const __m128 eB = _mm_setr_ps ( B[0], B[1], B[2], 0.f );
+		const __m128 eC = _mm_setr_ps ( C[0], C[1], C[2], 1.f );
+		const __m128 zero = _mm_setzero_ps ();
+#endif
+
+		for ( y = y0; y <= y1; ++y )
+		{
+			const f32 ty0 = (f32) ( top + y * SOFTWARE_DRIVER_2_TILE_HEIGHT - 1 );
+			const f32 ty1 = ty0 + (f32) ( SOFTWARE_DRIVER_2_TILE_HEIGHT + 1 );
+
+#ifdef SOFTWARE_DRIVER_2_TILE_SSE
+			const __m128 eY = _mm_add_ps ( _mm_max_ps ( _mm_mul_ps ( eB, _mm_set1_ps ( ty0 ) ),
+										_mm_mul_ps ( eB, _mm_set1_ps ( ty1 ) ) ), eC );
+#endif
+
+			for ( x = x0; x <= x1; ++x )
+			{
+				const f32 tx0 = (f32) ( left + x * SOFTWARE_DRIVER_2_TILE_WIDTH - 1 );
+				const f32 tx1 = tx0 + (f32) ( SOFTWARE_DRIVER_2_TILE_WIDTH + 1 );
+
+#ifdef SOFTWARE_DRIVER_2_TILE_SSE
+				const __m128 e = _mm_add_ps ( _mm_max_ps ( _mm_mul_ps ( eA, _mm_set1_ps ( tx0 ) ),
+											_mm_mul_ps ( eA, _mm_set1_ps ( tx1 ) ) ), eY );
+
+				if ( _mm_movemask_ps ( _mm_cmplt_ps ( e, zero ) ) )
+					continue;
+#else
+				for ( i = 0; i != 3; ++i )
+				{
+					if ( core::max_ ( A[i] * tx0, A[i] * tx1 ) + core::max_ ( B[i] * ty0, B[i] * ty1 ) + C[i] < 0.f )
+						break;
+				}
+
+				if ( i != 3 )
+					continue;
+#endif
+
+				TileBins[ y * TileColumns + x ].push_back ( triangle );
+			}
+		}
+	}
+
+	if ( TileTriangleState.size() >= SOFTWARE_DRIVER_2_TILE_MAX_TRIANGLES )
+		flushTiles();
+}
+
+
+//! rasterizes the binned triangles and empties the bins
+void CBurningVideoDriver::flushTiles()
+{
+	if ( 0 == TileTriangleState.size() )
+		return;
+
+	u32 i;
+
+	for ( i = 0; i != TileSlots; ++i )
+		setShaderState ( TileShader[i][CurrentShaderType], CurrentShaderType );
+
+	const u32 count = TileColumns * TileRows;
+
+	TileQueue.set_used ( 0 );
+	for ( i = 0; i != count; ++i )
+	{
+		if ( TileBins[i].size() )
+			TileQueue.push_back ( i );
+	}
+
+	// slot 0 is this thread
+	const u32 workers = TileQueue.size() > 1 ? TileSlots - 1 : 0;
+
+	if ( TileThreads->Submit )
+	{
+		// no job of the last flush is left, the scheduler publishes NextTile
+		TileThreads->NextTile = 0;
+
+		for ( i = 1; i <= workers; ++i )
+			TileThreads->Submit ( TileThreads->UserData, &TileThreads->Jobs[i] );
+
+		drawTiles ( 0 );
+
+		if ( workers )
+			TileThreads->Wait ( TileThreads->UserData );
+	}
+	else
+	{
+#ifdef _IRR_WINDOWS_API_
+		EnterCriticalSection ( &TileThreads->Lock );
+#else
+		pthread_mutex_lock ( &TileThreads->Lock );
+#endif
+
+		TileThreads->NextTile = 0;
+
+		if ( workers )
+		{
+			TileThreads->Busy = workers;
+
+			++TileThreads->Generation;
+
+#ifdef _IRR_WINDOWS_API_
+			ResetEvent ( TileThreads->Done );
+			SetEvent ( TileThreads->Start );
+#else
+			pthread_cond_broadcast ( &TileThreads->Start );
+#endif
+		}
+
+#ifdef _IRR_WINDOWS_API_
+		LeaveCriticalSection ( &TileThreads->Lock );
+#else
+		pthread_mutex_unlock ( &TileThreads->Lock );
+#endif
+
+		drawTiles ( 0 );
+
+		if ( workers )
+		{
+#ifdef _IRR_WINDOWS_API_
+			WaitForSingleObject ( TileThreads->Done, INFINITE );
+			ResetEvent ( TileThreads->Start );
+#else
+			pthread_mutex_lock ( &TileThreads->Lock );
+
+			while ( TileThreads->Busy > 0 )
+				pthread_cond_wait ( &TileThreads->Done, &TileThreads->Lock );
+
+			pthread_mutex_unlock ( &TileThreads->Lock );
+#endif
+		}
+	}
+
+	// the tile renderers don't own the textures
+	sInternalTexture none;
+	memset ( &none, 0, sizeof ( none ) );
+
+	for ( i = 0; i != TileSlots; ++i )
+	{
+		for ( u32 stage = 0; stage != BURNING_MATERIAL_MAX_TEXTURES; ++stage )
+			TileShader[i][CurrentShaderType]->setTextureData ( stage, none );
+	}
+
+	for ( i = 0; i != count; ++i )
+		TileBins[i].set_used ( 0 );
+
+	TileVertices.set_used ( 0 );
+	TileTriangleState.set_used ( 0 );
+	TileStates.set_used ( 0 );
+}
+
+
+//! rasterizes tiles until none is left
+void CBurningVideoDriver::drawTiles( u32 slot )
+{
+	IBurningShader* shader = TileShader[slot][CurrentShaderType];
+
+	while ( true )
+	{
+#ifdef _IRR_WINDOWS_API_
+		EnterCriticalSection ( &TileThreads->Lock );
+		const u32 next = TileThreads->NextTile++;
+		LeaveCriticalSection ( &TileThreads->Lock );
+#else
+		pthread_mutex_lock ( &TileThreads->Lock );
+		const u32 next = TileThreads->NextTile++;
+		pthread_mutex_unlock ( &TileThreads->Lock );
+#endif
+
+		if ( next >= TileQueue.size() )
+			break;
+
+		const u32 index = TileQueue[next];
+		const s32 x = TileArea.UpperLeftCorner.X + ( index % TileColumns ) * SOFTWARE_DRIVER_2_TILE_WIDTH;
+		const s32 y = TileArea.UpperLeftCorner.Y + ( index / TileColumns ) * SOFTWARE_DRIVER_2_TILE_HEIGHT;
+
+		shader->setTile ( core::rect<s32> ( x, y, x + SOFTWARE_DRIVER_2_TILE_WIDTH, y + SOFTWARE_DRIVER_2_TILE_HEIGHT ) );
+
+		// triangles keep the order of the draw call inside a tile
+		const core::array<u32> &bin = TileBins[index];
+		u32 state = 0xFFFFFFFF;
+
+		for ( u32 i = 0; i != bin.size(); ++i )
+		{
+			const u32 triangle = bin[i];
+
+			if ( TileTriangleState[triangle] != state )
+			{
+				state = TileTriangleState[triangle];
+
+				for ( u32 stage = 0; stage != BURNING_MATERIAL_MAX_TEXTURES; ++stage )
+					shader->setTextureData ( stage, TileStates[ state * BURNING_MATERIAL_MAX_TEXTURES + stage ] );
+			}
+
+			const s4DVertex *v = TileVertices.const_pointer() + triangle * 3;
+			shader->drawTriangle ( v, v + 1, v + 2 );
+		}
+	}
+}
+
+#endif // SOFTWARE_DRIVER_2_TILED
+
+
 //! Sets the dynamic ambient light color. The default color is
 //! (0,0,0,0) which means it is dark.
 //! \param color: New color of the ambient light.
@@ -16,6 +16,10 @@ namespace irr
 {
 namespace video
 {
+#ifdef SOFTWARE_DRIVER_2_TILED
+	struct STileThreads;
+#endif
+
 	class CBurningVideoDriver : public CNullDriver
 	{
 	public:
@@ -157,6 +161,18 @@ namespace video
 		//! Returns the maximum texture size supported.
 		virtual core::dimension2du getMaxTextureSize() const;
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+		//! Runs the tile rasterization as jobs of the application
+		virtual void setJobScheduler(u32 threads, DriverJobSubmit submit,
+			DriverJobWait wait, void* userData);
+
+		//! worker thread loop of the tile renderer
+		void serveTiles();
+
+		//! rasterizes tiles until none is left, run by every thread of a flush
+		void drawTiles( u32 slot );
+#endif
+
 	protected:
 
 
@@ -183,9 +199,64 @@ namespace video
 		//! selects the right triangle renderer based on the render states.
 		void setCurrentShader();
 
+		//! passes render target and material to a triangle renderer
+		void setShaderState( IBurningShader* shader, EBurningFFShader type );
+
+		//! creates a set of triangle renderers drawing into depthBuffer
+		static void createShaders( IBurningShader** shaders, IDepthBuffer* depthBuffer );
+
+		//! sets a texture of the current renderer, or of the triangles binned next
+		void setShaderTexture( u32 stage, video::CSoftwareTexture2* texture, s32 lodLevel );
+
+		//! rasterizes a triangle with the current renderer, or bins it
+		void drawShaderTriangle( const s4DVertex *a, const s4DVertex *b, const s4DVertex *c );
+
 		IBurningShader* CurrentShader;
+		EBurningFFShader CurrentShaderType;
 		IBurningShader* BurningShader[ETR2_COUNT];
 
+#ifdef SOFTWARE_DRIVER_2_TILED
+		/*
+			Tiled rasterization
+			Transformed and clipped triangles of a draw call are binned into
+			screen tiles. Every thread takes whole tiles, so no two threads
+			touch the same pixels of the render target and depth buffer.
+		*/
+		void beginTiles();
+		void binTriangle( const s4DVertex *a, const s4DVertex *b, const s4DVertex *c );
+		void flushTiles();
+
+		void startTileThreads( u32 count );
+		void stopTileThreads();
+
+		//! creates the renderers of count threads, less than 2 turns tiling off
+		void createTileSlots( u32 count );
+
+		// own renderers for every thread, slot 0 is the calling thread
+		IBurningShader* TileShader[SOFTWARE_DRIVER_2_TILE_MAX_THREADS][ETR2_COUNT];
+		u32 TileSlots;
+
+		// current draw call is binned
+		bool TilesActive;
+
+		// screen space vertices of the binned triangles, three for each
+		core::array<s4DVertex> TileVertices;
+
+		// textures of the current triangle and the distinct texture states of the batch
+		sInternalTexture TileTexture[BURNING_MATERIAL_MAX_TEXTURES];
+		core::array<sInternalTexture> TileStates;
+		core::array<u32> TileTriangleState;
+
+		// triangles touching each tile
+		core::array< core::array<u32> > TileBins;
+		core::array<u32> TileQueue;
+		core::rect<s32> TileArea;
+		u32 TileColumns;
+		u32 TileRows;
+
+		STileThreads* TileThreads;
+#endif
+
 		IDepthBuffer* DepthBuffer;
 
 
@@ -144,6 +144,10 @@ void CTRGouraudAlphaNoZ2::scanline_bilinear ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -369,6 +373,10 @@ void CTRGouraudAlphaNoZ2::drawTriangle ( const s4DVertex *a,const s4DVertex *b,c
 		yStart = core::ceil32( a->Pos.y );
 		yEnd = core::ceil32( b->Pos.y ) - 1;
 
+		// clip to the tile
+		yStart = core::s32_max ( yStart, Tile.UpperLeftCorner.Y );
+		yEnd = core::s32_min ( yEnd, Tile.LowerRightCorner.Y - 1 );
+
 #ifdef SUBTEXEL
 		subPixel = ( (f32) yStart ) - a->Pos.y;
 
@@ -528,6 +536,10 @@ void CTRGouraudAlphaNoZ2::drawTriangle ( const s4DVertex *a,const s4DVertex *b,c
 		yStart = core::ceil32( b->Pos.y );
 		yEnd = core::ceil32( c->Pos.y ) - 1;
 
+		// clip to the tile
+		yStart = core::s32_max ( yStart, Tile.UpperLeftCorner.Y );
+		yEnd = core::s32_min ( yEnd, Tile.LowerRightCorner.Y - 1 );
+
 #ifdef SUBTEXEL
 
 		subPixel = ( (f32) yStart ) - b->Pos.y;
@@ -258,6 +258,10 @@ void CTRTextureBlend::fragment_dst_color_src_alpha ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -442,6 +446,10 @@ void CTRTextureBlend::fragment_src_color_src_alpha ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -622,6 +630,10 @@ void CTRTextureBlend::fragment_one_one_minus_src_alpha()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -819,6 +831,10 @@ void CTRTextureBlend::fragment_one_minus_dst_alpha_one ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -1015,6 +1031,10 @@ void CTRTextureBlend::fragment_src_alpha_one ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -1242,6 +1262,10 @@ void CTRTextureBlend::fragment_dst_color_one_minus_dst_alpha ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -1438,6 +1462,10 @@ void CTRTextureBlend::fragment_dst_color_zero ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -1632,6 +1660,10 @@ void CTRTextureBlend::fragment_dst_color_one ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -1829,6 +1861,10 @@ void CTRTextureBlend::fragment_zero_one_minus_scr_color ()
 	xStart = core::ceil32( line.x[0] );
 	xEnd = core::ceil32( line.x[1] ) - 1;
 
+	// clip to the tile
+	xStart = core::s32_max ( xStart, Tile.UpperLeftCorner.X );
+	xEnd = core::s32_min ( xEnd, Tile.LowerRightCorner.X - 1 );
+
 	dx = xEnd - xStart;
 
 	if ( dx < 0 )
@@ -2095,6 +2131,10 @@ void CTRTextureBlend::drawTriangle ( const s4DVertex *a,const s4DVertex *b,const
 		yStart = core::ceil32( a->Pos.y );
 		yEnd = core::ceil32( b->Pos.y ) - 1;
 
+		// clip to the tile
+		yStart = core::s32_max ( yStart, Tile.UpperLeftCorner.Y );
+		yEnd = core::s32_min ( yEnd, Tile.LowerRightCorner.Y - 1 );
+
 #ifdef SUBTEXEL
 		subPixel = ( (f32) yStart ) - a->Pos.y;
 
@@ -2254,6 +2294,10 @@ void CTRTextureBlend::drawTriangle ( const s4DVertex *a,const s4DVertex *b,const
 		yStart = core::ceil32( b->Pos.y );
 		yEnd = core::ceil32( c->Pos.y ) - 1;
 
+		// clip to the tile
+		yStart = core::s32_max ( yStart, Tile.UpperLeftCorner.Y );
+		yEnd = core::s32_min ( yEnd, Tile.LowerRightCorner.Y - 1 );
+
 #ifdef SUBTEXEL
 
 		subPixel = ( (f32) yStart ) - b->Pos.y;
@@ -83,7 +83,8 @@ public:
 	virtual void drawTriangle ( const s4DVertex *a,const s4DVertex *b,const s4DVertex *c );
 	virtual void drawLine ( const s4DVertex *a,const s4DVertex *b);
 
-
+	//! lines are not clipped to tiles
+	virtual bool canDrawTiles() const { return false; }
 
 private:
 	void renderAlphaLine ( const s4DVertex *a,const s4DVertex *b ) const;
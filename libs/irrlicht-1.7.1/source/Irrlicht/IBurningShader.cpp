@@ -22,7 +22,8 @@ namespace video
 	};
 
 	IBurningShader::IBurningShader(IDepthBuffer* zbuffer)
-		: RenderTarget(0),DepthBuffer(zbuffer)
+		: RenderTarget(0),DepthBuffer(zbuffer),
+		Tile(-0x3fffffff,-0x3fffffff,0x3fffffff,0x3fffffff)
 	{
 		#ifdef _DEBUG
 		setDebugName("IBurningShader");
@@ -80,24 +81,39 @@ namespace video
 		if ( it->Texture)
 			it->Texture->drop();
 
-		it->Texture = texture;
+		getInternalTexture ( *it, texture, lodLevel );
 
 		if ( it->Texture)
-		{
 			it->Texture->grab();
+	}
+
+
+	//! sets an already locked texture, without taking a reference
+	void IBurningShader::setTextureData( u32 stage, const sInternalTexture& texture )
+	{
+		IT[stage] = texture;
+	}
+
 
+	//! locks the selected mipmap level and fills the fixpoint masks
+	void IBurningShader::getInternalTexture( sInternalTexture& it, video::CSoftwareTexture2* texture, s32 lodLevel )
+	{
+		it.Texture = texture;
+
+		if ( it.Texture)
+		{
 			// select mignify and magnify ( lodLevel )
 			//SOFTWARE_DRIVER_2_MIPMAPPING_LOD_BIAS
-			it->lodLevel = lodLevel;
-			it->data = (tVideoSample*) it->Texture->lock(true,
+			it.lodLevel = lodLevel;
+			it.data = (tVideoSample*) it.Texture->lock(true,
 				core::s32_clamp ( lodLevel + SOFTWARE_DRIVER_2_MIPMAPPING_LOD_BIAS, 0, SOFTWARE_DRIVER_2_MIPMAPPING_MAX - 1 ));
 
 			// prepare for optimal fixpoint
-			it->pitchlog2 = s32_log2_s32 ( it->Texture->getPitch() );
+			it.pitchlog2 = s32_log2_s32 ( it.Texture->getPitch() );
 
-			const core::dimension2d<u32> &dim = it->Texture->getSize();
-			it->textureXMask = s32_to_fixPoint ( dim.Width - 1 ) & FIX_POINT_UNSIGNED_MASK;
-			it->textureYMask = s32_to_fixPoint ( dim.Height - 1 ) & FIX_POINT_UNSIGNED_MASK;
+			const core::dimension2d<u32> &dim = it.Texture->getSize();
+			it.textureXMask = s32_to_fixPoint ( dim.Width - 1 ) & FIX_POINT_UNSIGNED_MASK;
+			it.textureYMask = s32_to_fixPoint ( dim.Height - 1 ) & FIX_POINT_UNSIGNED_MASK;
 		}
 	}
 
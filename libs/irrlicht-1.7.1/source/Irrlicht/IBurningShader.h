@@ -131,6 +131,21 @@ namespace video
 
 		//! sets the Texture
 		virtual void setTextureParam( u32 stage, video::CSoftwareTexture2* texture, s32 lodLevel);
+
+		//! sets an already locked texture, without taking a reference.
+		//! Used by the tile renderers, the driver owns the texture.
+		void setTextureData( u32 stage, const sInternalTexture& texture );
+
+		//! locks the selected mipmap level and fills the fixpoint masks
+		static void getInternalTexture( sInternalTexture& it, video::CSoftwareTexture2* texture, s32 lodLevel );
+
+		//! restricts rasterization to a screen rectangle (lower right corner exclusive)
+		void setTile( const core::rect<s32>& tile ) { Tile = tile; }
+
+		//! true if drawTriangle honours the tile, so the triangle can be rasterized
+		//! in several tiles by different threads
+		virtual bool canDrawTiles() const { return true; }
+
 		virtual void drawTriangle ( const s4DVertex *a,const s4DVertex *b,const s4DVertex *c ) = 0;
 		virtual void drawLine ( const s4DVertex *a,const s4DVertex *b) {};
 
@@ -146,6 +161,8 @@ namespace video
 
 		sInternalTexture IT[ BURNING_MATERIAL_MAX_TEXTURES ];
 
+		core::rect<s32> Tile;
+
 		static const tFixPointu dithermask[ 4 * 4];
 	};
 
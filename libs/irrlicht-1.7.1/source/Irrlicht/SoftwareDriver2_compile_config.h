@@ -93,6 +93,31 @@
 
 #define SOFTWARE_DRIVER_2_MIPMAPPING_SCALE (8/SOFTWARE_DRIVER_2_MIPMAPPING_MAX)
 
+// tiled rasterization
+// triangles are binned into screen tiles, the tiles are rasterized by worker threads.
+// the shaders clip their spans to the tile and rely on subtexel correction
+// to start the interpolation at the clipped edge
+#if defined ( SOFTWARE_DRIVER_2_SUBTEXEL ) && !defined ( BURNINGVIDEO_RENDERER_CE )
+	#define SOFTWARE_DRIVER_2_TILED
+#endif
+
+#ifdef SOFTWARE_DRIVER_2_TILED
+	#define SOFTWARE_DRIVER_2_TILE_WIDTH		64
+	#define SOFTWARE_DRIVER_2_TILE_HEIGHT		32
+
+	// smaller draw calls are rasterized directly
+	#define SOFTWARE_DRIVER_2_TILE_MIN_PRIMITIVES	32
+
+	// triangles binned before the tiles are flushed
+	#define SOFTWARE_DRIVER_2_TILE_MAX_TRIANGLES	8192
+
+	#define SOFTWARE_DRIVER_2_TILE_MAX_THREADS	16
+
+	#if defined ( __SSE__ ) || defined ( _M_X64 ) || ( defined ( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+		#define SOFTWARE_DRIVER_2_TILE_SSE
+	#endif
+#endif
+
 #ifndef REALINLINE
 	#ifdef _MSC_VER
 		#define REALINLINE __forceinline
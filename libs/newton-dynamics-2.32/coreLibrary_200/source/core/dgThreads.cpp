@@ -161,6 +161,12 @@ dgThreads::dgThreads()
 	#endif
 
 	m_getPerformanceCount = NULL;
+
+	m_externalThreads = 0;
+	m_externalSubmit = NULL;
+	m_externalBarrier = NULL;
+	m_externalData = NULL;
+
 	for (dgInt32 i = 0; i < DG_MAXIMUN_THREADS; i ++) {
 		m_localData[i].m_ticks = 0;
 		m_localData[i].m_threadIndex = i;
@@ -178,6 +184,9 @@ dgThreads::~dgThreads()
 
 dgInt32 dgThreads::GetThreadCount() const
 {
+	if (m_externalSubmit) {
+		return m_externalThreads;
+	}
 	return (m_numOfThreads == 0) ? 1 : m_numOfThreads;
 }
 
@@ -210,6 +219,11 @@ void dgThreads::CreateThreaded (dgInt32 threads)
 		DestroydgThreads();
 	}
 
+	m_externalThreads = 0;
+	m_externalSubmit = NULL;
+	m_externalBarrier = NULL;
+	m_externalData = NULL;
+
 	#if (defined (_WIN_32_VER) || defined (_WIN_64_VER) || defined (_MINGW_32_VER) || defined (_MINGW_64_VER))
 		if ((threads > 1) && (m_numberOfCPUCores > 1)) {
 			m_numOfThreads = GetMin (threads, m_numberOfCPUCores);
@@ -322,10 +336,33 @@ void dgThreads::DestroydgThreads()
 
 
 
+void dgThreads::SetExternalScheduler (dgInt32 threads, dgExternalSubmitCallback submit, dgExternalBarrierCallback barrier, void* const userData)
+{
+	if (m_numOfThreads) {
+		DestroydgThreads();
+	}
+
+	// the jobs are split in one chunk per scheduler thread
+	m_externalThreads = submit ? GetMax (1, GetMin (threads, dgInt32 (DG_MAXIMUN_THREADS))) : 0;
+	m_externalSubmit = submit;
+	m_externalBarrier = barrier;
+	m_externalData = userData;
+}
+
+
+void dgThreads::ExecuteJob (void* const job)
+{
+	((dgWorkerThread*) job)->ThreadExecute();
+}
+
+
 //Queues up another to work
 dgInt32 dgThreads::SubmitJob(dgWorkerThread* const job)
 {
-	if (!m_numOfThreads) {
+	if (m_externalSubmit) {
+		_ASSERTE (job->m_threadIndex != -1);
+		m_externalSubmit (m_externalData, job);
+	} else if (!m_numOfThreads) {
 		_ASSERTE (job->m_threadIndex != -1);
 		job->ThreadExecute();
 	} else {
@@ -463,6 +500,11 @@ void dgThreads::DoWork(dgInt32 mythreadIndex)
 
 void dgThreads::SynchronizationBarrier ()
 {
+	if (m_externalSubmit) {
+		m_externalBarrier (m_externalData);
+		return;
+	}
+
 	while(m_workInProgress) {
 		dgThreadYield();
 	}
@@ -473,11 +515,13 @@ void dgThreads::CalculateChunkSizes (dgInt32 elements, dgInt32* const chunkSizes
 {
 	dgInt32 step;
 	dgInt32 fraction;
+	dgInt32 threads;
 
-	if (m_numOfThreads) {
-		step = elements / m_numOfThreads;
-		fraction = elements - step * m_numOfThreads;
-		for (dgInt32 i = 0 ; i < m_numOfThreads; i ++) {
+	threads = m_externalSubmit ? m_externalThreads : m_numOfThreads;
+	if (threads) {
+		step = elements / threads;
+		fraction = elements - step * threads;
+		for (dgInt32 i = 0 ; i < threads; i ++) {
 			chunkSizes[i] = step + (fraction > 0);
 			fraction --;
 		}
@@ -24,6 +24,9 @@
 
 #define DG_MAXQUEUE		16
 
+// jobs handed to an application scheduler, it calls dgThreads::ExecuteJob on each
+typedef void (*dgExternalSubmitCallback) (void* const userData, void* const job);
+typedef void (*dgExternalBarrierCallback) (void* const userData);
 
 class dgWorkerThread
 {
@@ -45,6 +48,9 @@ public:
 	void CreateThreaded (dgInt32 threadCount);
 	void DestroydgThreads();
 
+	void SetExternalScheduler (dgInt32 threadCount, dgExternalSubmitCallback submit, dgExternalBarrierCallback barrier, void* const userData);
+	static void ExecuteJob (void* const job);
+
 	void ClearTimers();
 	void SetPerfomanceCounter(OnGetPerformanceCountCallback callback);
 	dgUnsigned32 GetPerfomanceTicks (dgUnsigned32 threadIndex) const;
@@ -107,6 +113,11 @@ private:
 
 	OnGetPerformanceCountCallback m_getPerformanceCount;
 	dgLocadData m_localData[DG_MAXIMUN_THREADS];
+
+	dgInt32 m_externalThreads;
+	dgExternalSubmitCallback m_externalSubmit;
+	dgExternalBarrierCallback m_externalBarrier;
+	void* m_externalData;
 };
 
 
@@ -312,6 +312,17 @@ void dgApi GetMinMax (dgVector &minOut, dgVector &maxOut, const dgFloat32* const
 			: "a"(op)
 			: "cc");
 	}
+#else
+	// ebx does not hold the GOT pointer in 64 bit mode, cpuid can write it directly
+	void cpuid(dgUnsigned32 op, dgUnsigned32 reg[4])
+	{
+		asm volatile(
+			"cpuid            \n\t"
+			: "=a"(reg[0]), "=b"(reg[1]), "=c"(reg[2]), "=d"(reg[3])
+			: "a"(op)
+			: "cc");
+	}
+#endif
 
 	static dgInt32 i386_cpuid(void) 
 	{ 
@@ -323,21 +334,18 @@ void dgApi GetMinMax (dgVector &minOut, dgVector &maxOut, const dgFloat32* const
 		cpuid(1, reg);
 		return reg[3];
 	} 
-#endif
 
 	dgCpuClass dgApi dgGetCpuType ()
 	{
-#ifndef _LINUX_VER_64
 		#define bit_MMX (1 << 23) 
 		#define bit_SSE (1 << 25) 
 		#define bit_SSE2 (1 << 26) 
 
-#ifndef __USE_DOUBLE_PRECISION__
+#ifdef DG_BUILD_SIMD_CODE
 		if (i386_cpuid() & bit_SSE) {
 			return dgSimdPresent;
 		}
 #endif
-		#endif
 		return dgNoSimdPresent;
 	}
 #endif
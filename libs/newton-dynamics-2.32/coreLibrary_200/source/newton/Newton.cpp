@@ -461,6 +461,48 @@ int NewtonGetMaxThreadsCount(const NewtonWorld* newtonWorld)
 }
 
 
+// Name: NewtonSetJobScheduler 
+// Run the engine jobs on the application's job scheduler instead of the engine's own threads.
+//
+// Parameters:
+// *const NewtonWorld* *newtonWorld - is the pointer to the Newton world
+// *int* threads - number of threads the scheduler runs jobs on, the work is split in this many jobs
+// *NewtonJobSubmit* submit - queues a job, the scheduler has to call NewtonExecuteJob with it
+// *NewtonJobBarrier* barrier - returns when all submitted jobs are executed
+// *void* *userData - passed to both callbacks
+// 
+// Return: Nothing
+//
+// Remarks: the engine threads are destroyed. Passing a NULL *submit* goes back to a single thread,
+// NewtonSetThreadsCount also removes the scheduler.
+//
+// See also: NewtonExecuteJob, NewtonSetThreadsCount
+void NewtonSetJobScheduler (const NewtonWorld* newtonWorld, int threads, NewtonJobSubmit submit, NewtonJobBarrier barrier, void* userData)
+{
+	TRACE_FUNTION(__FUNCTION__);
+
+	Newton* const world = (Newton *)newtonWorld;
+	world->SetExternalScheduler(threads, submit, barrier, userData);
+}
+
+
+// Name: NewtonExecuteJob 
+// Execute a job handed to the application scheduler.
+//
+// Parameters:
+// *void* *job - the job passed to the NewtonJobSubmit callback
+// 
+// Return: Nothing
+//
+// See also: NewtonSetJobScheduler
+void NewtonExecuteJob (void* job)
+{
+	TRACE_FUNTION(__FUNCTION__);
+
+	dgThreads::ExecuteJob (job);
+}
+
+
 
 /*
 // Name: NewtonGetThreadNumber 
@@ -773,6 +815,32 @@ void NewtonSetMinimumFrameRate(const NewtonWorld* newtonWorld, dFloat frameRate)
 	world->g_maxTimeStep = dgFloat32(1.0f) / frameRate;
 }
 
+// Name: NewtonSetSleepThresholds 
+// Set how slow a group of bodies has to move, and for how long, before auto sleep puts it to sleep.
+//
+// Parameters:
+// *const NewtonWorld* *newtonWorld - is the pointer to the Newton world
+// *dFloat* maxAccel - largest linear and angular acceleration of a body at rest
+// *dFloat* maxSpeed - largest linear speed of a body at rest
+// *dFloat* maxOmega - largest angular speed of a body at rest, in radians per second
+// *int* frames - frames at 60 fps the bodies have to stay below both speeds
+// 
+// Return: nothing
+//
+// Remarks: this sets the slowest entry of the sleep table, islands that are nearly still fall asleep sooner. 
+// The default is about 4 units per second squared, 0.5 units and 0.3 radians per second for 350 frames. 
+//
+// See also: NewtonBodySetAutoSleep, NewtonBodyGetSleepState
+void NewtonSetSleepThresholds(const NewtonWorld* newtonWorld, dFloat maxAccel, dFloat maxSpeed, dFloat maxOmega, int frames)
+{
+	Newton* world;
+
+	world = (Newton *) newtonWorld;
+
+	TRACE_FUNTION(__FUNCTION__);
+	world->SetSleepThresholds (dgAbsf (maxAccel), dgAbsf (maxSpeed), dgAbsf (maxOmega), frames);
+}
+
 /*
 // Name: NewtonGetTimeStep 
 // Return the correct time step for this simulation update.
@@ -850,6 +918,43 @@ void NewtonSetWorldSize(const NewtonWorld* newtonWorld, const dFloat* minPtr, co
 	world->SetWorldSize(p0, p1); 
 }
 
+// Name: NewtonSelectBroadphaseAlgorithm 
+// Select the broad phase that finds the colliding pairs and answers the world ray casts and aabb queries.
+//
+// Parameters:
+// *const NewtonWorld* *newtonWorld - is the pointer to the Newton world
+// *int* algorithmType - NEWTON_BROADPHASE_GRID or NEWTON_BROADPHASE_AABB_TREE
+// 
+// Return: Nothing.
+//
+// Remarks: NEWTON_BROADPHASE_GRID (the default) keeps the bodies in a multi level grid of sorted cells. 
+// NEWTON_BROADPHASE_AABB_TREE keeps them in a dynamic bounding box tree, it is faster with many small
+// bodies and long ray casts. All bodies are moved to the new broad phase.
+//
+// See also: NewtonGetBroadphaseAlgorithm, NewtonSetWorldSize
+void NewtonSelectBroadphaseAlgorithm (const NewtonWorld* newtonWorld, int algorithmType)
+{
+	TRACE_FUNTION(__FUNCTION__);
+	Newton* const world = (Newton *) newtonWorld;
+	world->SetBroadPhaseType ((algorithmType == NEWTON_BROADPHASE_AABB_TREE) ? DG_BROADPHASE_AABB_TREE : DG_BROADPHASE_GRID);
+}
+
+// Name: NewtonGetBroadphaseAlgorithm 
+// Get the broad phase in use.
+//
+// Parameters:
+// *const NewtonWorld* *newtonWorld - is the pointer to the Newton world
+// 
+// Return: NEWTON_BROADPHASE_GRID or NEWTON_BROADPHASE_AABB_TREE.
+//
+// See also: NewtonSelectBroadphaseAlgorithm
+int NewtonGetBroadphaseAlgorithm (const NewtonWorld* newtonWorld)
+{
+	TRACE_FUNTION(__FUNCTION__);
+	Newton* const world = (Newton *) newtonWorld;
+	return (world->GetBroadPhaseType() == DG_BROADPHASE_AABB_TREE) ? NEWTON_BROADPHASE_AABB_TREE : NEWTON_BROADPHASE_GRID;
+}
+
 
 // Name: NewtonSetIslandUpdateEvent 
 // Set a function callback to be call on each island update.
@@ -6040,6 +6145,28 @@ int NewtonBodyGetSleepState(const NewtonBody* bodyPtr)
 	return body->GetSleepState() ? 1 : 0;
 }
 
+// Name: NewtonBodySetSleepState
+// Wake a sleeping body up, or put a body to sleep.
+//
+// Parameters:
+// *const NewtonBody* *bodyPtr - is the pointer to the body.
+// *int* state - 0 wakes the body, 1 stops it and puts it to sleep. 
+// 
+// Return: Nothing.
+//
+// Remarks: a woken body is simulated with its island again until auto sleep finds it at rest. 
+// A body put to sleep is woken again by new contacts. 
+//
+// See also: NewtonBodyGetSleepState, NewtonBodySetAutoSleep
+void NewtonBodySetSleepState(const NewtonBody* bodyPtr, int state)
+{
+	dgBody *body;
+	body = (dgBody *)bodyPtr;
+
+	TRACE_FUNTION(__FUNCTION__);
+	body->SetSleepState (state ? true : false);
+}
+
 /*
 // Name: NewtonBodySetFreezeTreshold 
 // Set the minimum values for velocity of a body that will be considered at rest.
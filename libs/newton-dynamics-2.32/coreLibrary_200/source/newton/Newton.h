@@ -69,6 +69,9 @@ extern "C" {
 	#define NEWTON_PROFILER_DYNAMICS_CONSTRAINT_GRAPH		6
 	#define NEWTON_PROFILER_DYNAMICS_SOLVE_CONSTRAINT_GRAPH	7
 
+	#define NEWTON_BROADPHASE_GRID							0
+	#define NEWTON_BROADPHASE_AABB_TREE						1
+
 	typedef struct NewtonMesh{} NewtonMesh;
 	typedef struct NewtonBody{} NewtonBody;
 	typedef struct NewtonWorld{} NewtonWorld;
@@ -272,6 +275,10 @@ extern "C" {
 
 	typedef unsigned (*NewtonGetTicksCountCallback) ();
 
+	// application job scheduler callbacks
+	typedef void (*NewtonJobSubmit) (void* userData, void* job);
+	typedef void (*NewtonJobBarrier) (void* userData);
+
 	typedef void (*NewtonSerialize) (void* serializeHandle, const void* buffer, int size);
 	typedef void (*NewtonDeserialize) (void* serializeHandle, void* buffer, int size);
 	
@@ -367,11 +374,16 @@ extern "C" {
 	NEWTON_API void NewtonSetThreadsCount (const NewtonWorld* newtonWorld, int threads);
 	NEWTON_API int NewtonGetThreadsCount(const NewtonWorld* newtonWorld);
 	NEWTON_API int NewtonGetMaxThreadsCount(const NewtonWorld* newtonWorld);
+	NEWTON_API void NewtonSetJobScheduler (const NewtonWorld* newtonWorld, int threads, NewtonJobSubmit submit, NewtonJobBarrier barrier, void* userData);
+	NEWTON_API void NewtonExecuteJob (void* job);
 
 	NEWTON_API void NewtonSetFrictionModel (const NewtonWorld* newtonWorld, int model);
 	NEWTON_API void NewtonSetMinimumFrameRate (const NewtonWorld* newtonWorld, dFloat frameRate);
+	NEWTON_API void NewtonSetSleepThresholds (const NewtonWorld* newtonWorld, dFloat maxAccel, dFloat maxSpeed, dFloat maxOmega, int frames);
 	NEWTON_API void NewtonSetBodyLeaveWorldEvent (const NewtonWorld* newtonWorld, NewtonBodyLeaveWorld callback); 
 	NEWTON_API void NewtonSetWorldSize (const NewtonWorld* newtonWorld, const dFloat* minPoint, const dFloat* maxPoint); 
+	NEWTON_API void NewtonSelectBroadphaseAlgorithm (const NewtonWorld* newtonWorld, int algorithmType);
+	NEWTON_API int NewtonGetBroadphaseAlgorithm (const NewtonWorld* newtonWorld);
 	NEWTON_API void NewtonSetIslandUpdateEvent (const NewtonWorld* newtonWorld, NewtonIslandUpdate islandUpdate); 
 	NEWTON_API void NewtonSetCollisionDestructor (const NewtonWorld* newtonWorld, NewtonCollisionDestructor callback); 
 	NEWTON_API void NewtonSetDestroyBodyByExeciveForce (const NewtonWorld* newtonWorld, NewtonDestroyBodyByExeciveForce callback); 
@@ -696,6 +708,7 @@ extern "C" {
 
 	
 	NEWTON_API int  NewtonBodyGetSleepState (const NewtonBody* body);
+	NEWTON_API void NewtonBodySetSleepState (const NewtonBody* body, int state);
 	NEWTON_API int  NewtonBodyGetAutoSleep (const NewtonBody* body);
 	NEWTON_API void NewtonBodySetAutoSleep (const NewtonBody* body, int state);
 
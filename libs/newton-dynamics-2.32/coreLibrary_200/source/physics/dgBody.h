@@ -77,8 +77,12 @@ typedef dgUnsigned32 (dgApi *GetBuoyancyPlane) (void* collisionID, void* context
 class dgBroadPhaseList
 {
 	public:
+	// enlarged box of the aabb tree leaf, the leaf is only moved when the body leaves it
+	dgVector m_fatMinBox;
+	dgVector m_fatMaxBox;
 	dgBroadPhaseCell* m_cell;
 	void* m_axisArrayNode[3];
+	dgInt32 m_treeLeaf;
 };
 
 
@@ -157,6 +161,7 @@ class dgBody
 	void GetAABB (dgVector &p0, dgVector &p1) const;	
 
 	bool GetSleepState () const;
+	void SetSleepState (bool state);
 	bool GetAutoSleep () const;
 	void SetAutoSleep (bool state);
 
@@ -276,6 +281,7 @@ class dgBody
 	friend class dgContactArray;
 	friend class dgContactSolver;
 	friend class dgBroadPhaseCell;
+	friend class dgBroadPhaseTree;
 	friend class dgCollisionConvex;
 	friend class dgCollisionEllipse;
 	friend class dgCollisionCompound;
@@ -325,6 +331,18 @@ inline bool dgBody::GetSleepState () const
 	return m_sleeping;
 }
 
+inline void dgBody::SetSleepState (bool state)
+{
+	if (state) {
+		m_veloc = dgVector (dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f));
+		m_omega = dgVector (dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f));
+	} else {
+		m_sleepingCounter = 0;
+	}
+	m_sleeping = state;
+	m_equilibrium = state;
+}
+
 
 
 
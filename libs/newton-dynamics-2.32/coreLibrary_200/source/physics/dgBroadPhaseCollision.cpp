@@ -311,14 +311,366 @@ dgBroadPhaseCell* dgBroadPhaseLayer::FindCreate (dgInt32 x, dgInt32 z)
 
 
 
+DG_INLINE dgFloat32 dgBoxSurfaceArea (const dgVector& minBox, const dgVector& maxBox)
+{
+	dgVector size (maxBox - minBox);
+	return size.m_x * size.m_y + size.m_y * size.m_z + size.m_z * size.m_x;
+}
+
+DG_INLINE dgFloat32 dgBoxUnionSurfaceArea (const dgVector& minBox0, const dgVector& maxBox0, const dgVector& minBox1, const dgVector& maxBox1)
+{
+	dgVector minBox (GetMin (minBox0.m_x, minBox1.m_x), GetMin (minBox0.m_y, minBox1.m_y), GetMin (minBox0.m_z, minBox1.m_z), dgFloat32 (0.0f));
+	dgVector maxBox (GetMax (maxBox0.m_x, maxBox1.m_x), GetMax (maxBox0.m_y, maxBox1.m_y), GetMax (maxBox0.m_z, maxBox1.m_z), dgFloat32 (0.0f));
+	return dgBoxSurfaceArea (minBox, maxBox);
+}
+
+DG_INLINE bool dgBoxInclusionTest (const dgVector& minBox, const dgVector& maxBox, const dgVector& outerMinBox, const dgVector& outerMaxBox)
+{
+	return (minBox.m_x >= outerMinBox.m_x) && (minBox.m_y >= outerMinBox.m_y) && (minBox.m_z >= outerMinBox.m_z) &&
+		   (maxBox.m_x <= outerMaxBox.m_x) && (maxBox.m_y <= outerMaxBox.m_y) && (maxBox.m_z <= outerMaxBox.m_z);
+}
+
+// distance along the ray (in units of its length) where it enters the box, 
+// larger than maxT if it misses the box before maxT
+DG_INLINE dgFloat32 dgRayBoxEntry (const dgVector& origin, const dgVector& dir, const dgVector& invDir, dgFloat32 maxT, const dgVector& minBox, const dgVector& maxBox)
+{
+	dgFloat32 tmin = dgFloat32 (0.0f);
+	dgFloat32 tmax = maxT;
+	for (dgInt32 i = 0; i < 3; i ++) {
+		if (dgAbsf (dir[i]) < dgFloat32 (1.0e-8f)) {
+			if ((origin[i] < minBox[i]) || (origin[i] > maxBox[i])) {
+				return dgFloat32 (1.0e10f);
+			}
+		} else {
+			dgFloat32 t0 = (minBox[i] - origin[i]) * invDir[i];
+			dgFloat32 t1 = (maxBox[i] - origin[i]) * invDir[i];
+			if (t0 > t1) {
+				Swap (t0, t1);
+			}
+			tmin = GetMax (tmin, t0);
+			tmax = GetMin (tmax, t1);
+			if (tmin > tmax) {
+				return dgFloat32 (1.0e10f);
+			}
+		}
+	}
+	return tmin;
+}
+
+
+dgBroadPhaseTree::dgBroadPhaseTree(dgMemoryAllocator* allocator)
+	:m_nodes (256, allocator)
+{
+	m_nodesCount = 0;
+	m_freeList = -1;
+	m_root = -1;
+}
+
+dgBroadPhaseTree::~dgBroadPhaseTree()
+{
+	_ASSERTE (m_root == -1);
+}
+
+dgInt32 dgBroadPhaseTree::AllocNode ()
+{
+	dgInt32 index = m_freeList;
+	if (index >= 0) {
+		m_freeList = m_nodes[index].m_parent;
+	} else {
+		index = m_nodesCount;
+		m_nodesCount ++;
+	}
+
+	dgBroadPhaseTreeNode& node = m_nodes[index];
+	node.m_body = NULL;
+	node.m_parent = -1;
+	node.m_left = -1;
+	node.m_right = -1;
+	node.m_height = 0;
+	return index;
+}
+
+void dgBroadPhaseTree::FreeNode (dgInt32 index)
+{
+	// free nodes are linked through the parent index
+	m_nodes[index].m_parent = m_freeList;
+	m_nodes[index].m_height = -1;
+	m_freeList = index;
+}
+
+dgInt32 dgBroadPhaseTree::Insert (dgBody* const body, const dgVector& minBox, const dgVector& maxBox)
+{
+	dgInt32 leaf = AllocNode ();
+	dgBroadPhaseTreeNode& node = m_nodes[leaf];
+	node.m_minBox = minBox;
+	node.m_maxBox = maxBox;
+	node.m_body = body;
+
+	InsertLeaf (leaf);
+	return leaf;
+}
+
+void dgBroadPhaseTree::Remove (dgInt32 leaf)
+{
+	_ASSERTE (m_nodes[leaf].m_left == -1);
+	RemoveLeaf (leaf);
+	FreeNode (leaf);
+}
+
+void dgBroadPhaseTree::InsertLeaf (dgInt32 leaf)
+{
+	if (m_root == -1) {
+		m_root = leaf;
+		m_nodes[leaf].m_parent = -1;
+		return;
+	}
+
+	const dgVector minBox (m_nodes[leaf].m_minBox);
+	const dgVector maxBox (m_nodes[leaf].m_maxBox);
+
+	// walk down to the sibling with the least surface area cost
+	dgInt32 index = m_root;
+	while (m_nodes[index].m_left != -1) {
+		const dgBroadPhaseTreeNode& node = m_nodes[index];
+		dgFloat32 area = dgBoxSurfaceArea (node.m_minBox, node.m_maxBox);
+		dgFloat32 unionArea = dgBoxUnionSurfaceArea (node.m_minBox, node.m_maxBox, minBox, maxBox);
+
+		// cost of a new parent for this node and the leaf, and the least cost 
+		// the ancestors pay for pushing the leaf further down
+		dgFloat32 cost = dgFloat32 (2.0f) * unionArea;
+		dgFloat32 inheritedCost = dgFloat32 (2.0f) * (unionArea - area);
+
+		dgFloat32 childCost[2];
+		dgInt32 children[2] = {node.m_left, node.m_right};
+		for (dgInt32 i = 0; i < 2; i ++) {
+			const dgBroadPhaseTreeNode& child = m_nodes[children[i]];
+			childCost[i] = dgBoxUnionSurfaceArea (child.m_minBox, child.m_maxBox, minBox, maxBox) + inheritedCost;
+			if (child.m_left != -1) {
+				childCost[i] -= dgBoxSurfaceArea (child.m_minBox, child.m_maxBox);
+			}
+		}
+
+		if ((cost < childCost[0]) && (cost < childCost[1])) {
+			break;
+		}
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	dgInt32 sibling = index;
+	dgInt32 oldParent = m_nodes[sibling].m_parent;
+	dgInt32 newParent = AllocNode ();
+
+	m_nodes[newParent].m_parent = oldParent;
+	m_nodes[newParent].m_left = sibling;
+	m_nodes[newParent].m_right = leaf;
+	m_nodes[sibling].m_parent = newParent;
+	m_nodes[leaf].m_parent = newParent;
+
+	if (oldParent != -1) {
+		ReplaceChild (oldParent, sibling, newParent);
+	} else {
+		m_root = newParent;
+	}
+
+	Refit (newParent);
+}
+
+void dgBroadPhaseTree::RemoveLeaf (dgInt32 leaf)
+{
+	if (leaf == m_root) {
+		m_root = -1;
+		return;
+	}
+
+	dgInt32 parent = m_nodes[leaf].m_parent;
+	dgInt32 grandParent = m_nodes[parent].m_parent;
+	dgInt32 sibling = (m_nodes[parent].m_left == leaf) ? m_nodes[parent].m_right : m_nodes[parent].m_left;
+
+	// the sibling takes the place of the parent
+	m_nodes[sibling].m_parent = grandParent;
+	if (grandParent != -1) {
+		ReplaceChild (grandParent, parent, sibling);
+		FreeNode (parent);
+		Refit (grandParent);
+	} else {
+		m_root = sibling;
+		FreeNode (parent);
+	}
+}
+
+void dgBroadPhaseTree::ReplaceChild (dgInt32 parent, dgInt32 oldChild, dgInt32 newChild)
+{
+	if (m_nodes[parent].m_left == oldChild) {
+		m_nodes[parent].m_left = newChild;
+	} else {
+		_ASSERTE (m_nodes[parent].m_right == oldChild);
+		m_nodes[parent].m_right = newChild;
+	}
+}
+
+void dgBroadPhaseTree::UpdateNode (dgInt32 index)
+{
+	dgBroadPhaseTreeNode& node = m_nodes[index];
+	const dgBroadPhaseTreeNode& left = m_nodes[node.m_left];
+	const dgBroadPhaseTreeNode& right = m_nodes[node.m_right];
+
+	node.m_minBox = dgVector (GetMin (left.m_minBox.m_x, right.m_minBox.m_x), GetMin (left.m_minBox.m_y, right.m_minBox.m_y), GetMin (left.m_minBox.m_z, right.m_minBox.m_z), dgFloat32 (0.0f));
+	node.m_maxBox = dgVector (GetMax (left.m_maxBox.m_x, right.m_maxBox.m_x), GetMax (left.m_maxBox.m_y, right.m_maxBox.m_y), GetMax (left.m_maxBox.m_z, right.m_maxBox.m_z), dgFloat32 (0.0f));
+	node.m_height = 1 + GetMax (left.m_height, right.m_height);
+}
+
+void dgBroadPhaseTree::Rotate (dgInt32 index)
+{
+	// try swapping a child with a grandchild on the other side, keep the 
+	// swap that shrinks the surface area of the modified child the most
+	dgInt32 children[2] = {m_nodes[index].m_left, m_nodes[index].m_right};
+
+	dgFloat32 bestGain = dgFloat32 (0.0f);
+	dgInt32 bestChild = -1;
+	dgInt32 bestGrandChild = -1;
+
+	for (dgInt32 i = 0; i < 2; i ++) {
+		const dgBroadPhaseTreeNode& child = m_nodes[children[i]];
+		const dgBroadPhaseTreeNode& other = m_nodes[children[1 - i]];
+		if (other.m_left != -1) {
+			dgFloat32 area = dgBoxSurfaceArea (other.m_minBox, other.m_maxBox);
+			dgInt32 grandChildren[2] = {other.m_left, other.m_right};
+			for (dgInt32 j = 0; j < 2; j ++) {
+				// the child takes the place of this grandchild, next to the other grandchild
+				const dgBroadPhaseTreeNode& stays = m_nodes[grandChildren[1 - j]];
+				dgFloat32 gain = area - dgBoxUnionSurfaceArea (child.m_minBox, child.m_maxBox, stays.m_minBox, stays.m_maxBox);
+				if (gain > bestGain) {
+					bestGain = gain;
+					bestChild = children[i];
+					bestGrandChild = grandChildren[j];
+				}
+			}
+		}
+	}
+
+	if (bestChild != -1) {
+		dgInt32 otherChild = m_nodes[bestGrandChild].m_parent;
+		ReplaceChild (index, bestChild, bestGrandChild);
+		ReplaceChild (otherChild, bestGrandChild, bestChild);
+		m_nodes[bestGrandChild].m_parent = index;
+		m_nodes[bestChild].m_parent = otherChild;
+		UpdateNode (otherChild);
+	}
+}
+
+void dgBroadPhaseTree::Refit (dgInt32 index)
+{
+	while (index != -1) {
+		Rotate (index);
+		UpdateNode (index);
+		index = m_nodes[index].m_parent;
+	}
+}
+
+void dgBroadPhaseTree::ForEachBodyInAABB (const dgVector& minBox, const dgVector& maxBox, OnBodiesInAABB callback, void* const userData) const
+{
+	if (m_root != -1) {
+		dgInt32 stack[DG_AABB_TREE_STACK_DEPTH];
+
+		dgInt32 stackIndex = 1;
+		stack[0] = m_root;
+		while (stackIndex) {
+			stackIndex --;
+			const dgBroadPhaseTreeNode& node = m_nodes[stack[stackIndex]];
+			if (dgOverlapTest (node.m_minBox, node.m_maxBox, minBox, maxBox)) {
+				if (node.m_left == -1) {
+					dgBody* const body = node.m_body;
+					if (dgOverlapTest (body->m_minAABB, body->m_maxAABB, minBox, maxBox)) {
+						callback (body, userData);
+					}
+				} else {
+					_ASSERTE (stackIndex < (DG_AABB_TREE_STACK_DEPTH - 2));
+					stack[stackIndex] = node.m_left;
+					stack[stackIndex + 1] = node.m_right;
+					stackIndex += 2;
+				}
+			}
+		}
+	}
+}
+
+dgFloat32 dgBroadPhaseTree::RayCast (dgFloat32 minT, const dgLineBox& line, OnRayCastAction filter, OnRayPrecastAction prefilter, void* const userData) const
+{
+	if (m_root != -1) {
+		dgInt32 stack[DG_AABB_TREE_STACK_DEPTH];
+		dgFloat32 stackDist[DG_AABB_TREE_STACK_DEPTH];
+
+		dgVector dir (line.m_l1 - line.m_l0);
+		dgVector invDir (dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f));
+		for (dgInt32 i = 0; i < 3; i ++) {
+			if (dgAbsf (dir[i]) >= dgFloat32 (1.0e-8f)) {
+				invDir[i] = dgFloat32 (1.0f) / dir[i];
+			}
+		}
+
+		const dgBroadPhaseTreeNode& root = m_nodes[m_root];
+		dgFloat32 dist = dgRayBoxEntry (line.m_l0, dir, invDir, minT, root.m_minBox, root.m_maxBox);
+
+		dgInt32 stackIndex = 0;
+		if (dist <= minT) {
+			stack[0] = m_root;
+			stackDist[0] = dist;
+			stackIndex = 1;
+		}
+
+		// nearest child first, so the closest hit trims the rest of the walk
+		while (stackIndex) {
+			stackIndex --;
+			if (stackDist[stackIndex] > minT) {
+				continue;
+			}
+
+			const dgBroadPhaseTreeNode& node = m_nodes[stack[stackIndex]];
+			if (node.m_left == -1) {
+				minT = node.m_body->RayCast (line, filter, prefilter, userData, minT);
+			} else {
+				const dgBroadPhaseTreeNode& left = m_nodes[node.m_left];
+				const dgBroadPhaseTreeNode& right = m_nodes[node.m_right];
+				dgFloat32 leftDist = dgRayBoxEntry (line.m_l0, dir, invDir, minT, left.m_minBox, left.m_maxBox);
+				dgFloat32 rightDist = dgRayBoxEntry (line.m_l0, dir, invDir, minT, right.m_minBox, right.m_maxBox);
+
+				dgInt32 nearNode = node.m_left;
+				dgInt32 farNode = node.m_right;
+				if (rightDist < leftDist) {
+					Swap (nearNode, farNode);
+					Swap (leftDist, rightDist);
+				}
+
+				_ASSERTE (stackIndex < (DG_AABB_TREE_STACK_DEPTH - 2));
+				if (rightDist <= minT) {
+					stack[stackIndex] = farNode;
+					stackDist[stackIndex] = rightDist;
+					stackIndex ++;
+				}
+				if (leftDist <= minT) {
+					stack[stackIndex] = nearNode;
+					stackDist[stackIndex] = leftDist;
+					stackIndex ++;
+				}
+			}
+		}
+	}
+	return minT;
+}
+
+
+
 dgBroadPhaseCollision::dgBroadPhaseCollision(dgMemoryAllocator* allocator)
 	:m_min (-dgFloat32(1000.0f), -dgFloat32(1000.0f), -dgFloat32(1000.0f), dgFloat32(0.0f)),
 	 m_max ( dgFloat32(1000.0f),  dgFloat32(1000.0f), dgFloat32(1000.0f), dgFloat32(0.0f)), 
 	 m_appMinBox (-dgFloat32(1000.0f), -dgFloat32(1000.0f), -dgFloat32(1000.0f), dgFloat32(0.0f)),
-	 m_appMaxBox ( dgFloat32(1000.0f),  dgFloat32(1000.0f), dgFloat32(1000.0f), dgFloat32(0.0f)) 
+	 m_appMaxBox ( dgFloat32(1000.0f),  dgFloat32(1000.0f), dgFloat32(1000.0f), dgFloat32(0.0f)),
+	 m_tree (allocator)
 {
 //	m_me = NULL;	
 	m_inactiveList.Init(0, allocator);
+	m_treeCell.Init(0, allocator);
+	m_broadPhaseType = DG_BROADPHASE_GRID;
 
 	for (dgInt32 i = 0; i < DG_OCTREE_MAX_DEPTH; i ++) {
 		m_layerMap[i].SetAllocator(allocator);
@@ -408,6 +760,25 @@ void dgBroadPhaseCollision::SetWorldSize (const dgVector& min, const dgVector& m
 	m_boxSize = m_max - m_min;
 }
 
+void dgBroadPhaseCollision::SetBroadPhaseType (dgInt32 type)
+{
+	if (type != m_broadPhaseType) {
+		// move all bodies to the new broad phase
+		dgBodyMasterList& masterList (*((dgWorld*)this));
+		for (dgBodyMasterList::dgListNode* node = masterList.GetFirst(); node; node = node->GetNext()) { 
+			Remove(node->GetInfo().GetBody());
+		}
+
+		m_broadPhaseType = type;
+
+		for (dgBodyMasterList::dgListNode* node = masterList.GetFirst(); node; node = node->GetNext()) { 
+			dgBody* const body = node->GetInfo().GetBody();
+			Add(body);
+			body->SetMatrix(body->GetMatrix());
+		}
+	}
+}
+
 void dgBroadPhaseCollision::InvalidateCache ()
 {
 /*
@@ -448,8 +819,15 @@ void dgBroadPhaseCollision::InvalidateCache ()
 void dgBroadPhaseCollision::Add (dgBody* const body)
 {
 	_ASSERTE (!body->m_collisionCell.m_cell);
-	// new bodies are added to the root node, and the function set matrix relocate them
-	m_layerMap[0].FindCreate (0, 0)->Add (body);
+	if (m_broadPhaseType == DG_BROADPHASE_AABB_TREE) {
+		dgBroadPhaseList& entry = body->m_collisionCell;
+		CalculateTreeBox (body, entry.m_fatMinBox, entry.m_fatMaxBox);
+		entry.m_treeLeaf = m_tree.Insert (body, entry.m_fatMinBox, entry.m_fatMaxBox);
+		entry.m_cell = &m_treeCell;
+	} else {
+		// new bodies are added to the root node, and the function set matrix relocate them
+		m_layerMap[0].FindCreate (0, 0)->Add (body);
+	}
 }
 
 
@@ -459,6 +837,13 @@ void dgBroadPhaseCollision::Remove (dgBody* const body)
 //	dgBroadPhaseLayer::dgTreeNode* node;
 
 	_ASSERTE (body->m_collisionCell.m_cell);
+	if (body->m_collisionCell.m_cell == &m_treeCell) {
+		m_tree.Remove (body->m_collisionCell.m_treeLeaf);
+		body->m_collisionCell.m_treeLeaf = -1;
+		body->m_collisionCell.m_cell = NULL;
+		return;
+	}
+
 	dgBroadPhaseCell* const obtreeCell = body->m_collisionCell.m_cell;
 	obtreeCell->Remove (body);
 
@@ -512,10 +897,127 @@ void dgBroadPhaseCollision::UpdatePairs (dgBroadPhaseCell& cellA, dgBroadPhaseCe
 }
 
 
+void dgBroadPhaseCollision::CalculateTreeBox (const dgBody* const body, dgVector& minBox, dgVector& maxBox) const
+{
+	dgVector margin (DG_AABB_TREE_MARGIN, DG_AABB_TREE_MARGIN, DG_AABB_TREE_MARGIN, dgFloat32 (0.0f));
+	minBox = body->m_minAABB - margin;
+	maxBox = body->m_maxAABB + margin;
+
+	// extend the box in the direction the body is moving
+	dgVector step (body->m_veloc.Scale (DG_AABB_TREE_PREDICTION));
+	for (dgInt32 i = 0; i < 3; i ++) {
+		if (step[i] > dgFloat32 (0.0f)) {
+			maxBox[i] += step[i];
+		} else {
+			minBox[i] += step[i];
+		}
+	}
+	minBox.m_w = dgFloat32 (0.0f);
+	maxBox.m_w = dgFloat32 (0.0f);
+}
+
+void dgBroadPhaseCollision::UpdateTreeLeaf (dgBody* const body)
+{
+	dgBroadPhaseList& entry = body->m_collisionCell;
+	_ASSERTE (entry.m_cell == &m_treeCell);
+
+	m_tree.Remove (entry.m_treeLeaf);
+	CalculateTreeBox (body, entry.m_fatMinBox, entry.m_fatMaxBox);
+	entry.m_treeLeaf = m_tree.Insert (body, entry.m_fatMinBox, entry.m_fatMaxBox);
+}
+
+void dgBroadPhaseCollision::UpdateTreePairs (dgBody* const body0, dgInt32 threadIndex) const
+{
+	if (body0->m_collision->IsType (dgCollision::dgCollisionNull_RTTI)) {
+		return;
+	}
+
+	dgInt32 stack[DG_AABB_TREE_STACK_DEPTH];
+	dgCollidingPairCollector& contactPair = *((dgWorld*)this);
+
+	dgInt32 stackIndex = 1;
+	stack[0] = m_tree.m_root;
+	while (stackIndex) {
+		stackIndex --;
+		const dgBroadPhaseTreeNode& node = m_tree.m_nodes[stack[stackIndex]];
+		if (dgOverlapTest (node.m_minBox, node.m_maxBox, body0->m_minAABB, body0->m_maxAABB)) {
+			if (node.m_left == -1) {
+				dgBody* const body1 = node.m_body;
+				// both awake bodies find the pair, the one with the lower id adds it
+				if ((body1 != body0) && (body1->m_sleeping || (body0->m_uniqueID < body1->m_uniqueID))) {
+					if (!body1->m_collision->IsType (dgCollision::dgCollisionNull_RTTI)) {
+						if (OverlapTest(body0, body1)) {
+							contactPair.AddPair(body0, body1, threadIndex);
+						}
+					}
+				}
+			} else {
+				_ASSERTE (stackIndex < (DG_AABB_TREE_STACK_DEPTH - 2));
+				stack[stackIndex] = node.m_left;
+				stack[stackIndex + 1] = node.m_right;
+				stackIndex += 2;
+			}
+		}
+	}
+}
+
+void dgBroadPhaseCollision::SubmitTreePairs (dgBody** const bodyArray, dgInt32 count)
+{
+	dgWorld* const me = (dgWorld*) this;
+	dgInt32 threadCounts = dgInt32 (me->m_numberOfTheads);
+
+	if (threadCounts > 1) {
+		dgInt32 chunkSizes[DG_MAXIMUN_THREADS];
+		me->m_threadsManager.CalculateChunkSizes(count, chunkSizes);
+		for (dgInt32 threadIndex = 0; threadIndex < threadCounts; threadIndex ++) {
+			m_treePairsWorkerThreads[threadIndex].m_step = threadCounts;
+			m_treePairsWorkerThreads[threadIndex].m_count = chunkSizes[threadIndex] * threadCounts;
+			m_treePairsWorkerThreads[threadIndex].m_bodies = &bodyArray[threadIndex];
+			m_treePairsWorkerThreads[threadIndex].m_threadIndex = threadIndex;
+			m_treePairsWorkerThreads[threadIndex].m_world = me;
+			me->m_threadsManager.SubmitJob(&m_treePairsWorkerThreads[threadIndex]);
+		}
+		me->m_threadsManager.SynchronizationBarrier ();
+	} else {
+		m_treePairsWorkerThreads[0].m_step = 1;
+		m_treePairsWorkerThreads[0].m_count = count;
+		m_treePairsWorkerThreads[0].m_bodies = &bodyArray[0];
+		m_treePairsWorkerThreads[0].m_threadIndex = 0;
+		m_treePairsWorkerThreads[0].m_world = me;
+		m_treePairsWorkerThreads[0].ThreadExecute();
+	}
+}
+
+
+class dgBroadPhaseTreeQuery
+{
+	public:
+	OnBodiesInAABB m_callback;
+	void* m_userData;
+	const dgBody* m_sentinel;
+};
+
+static void dgApi dgBroadPhaseTreeQueryCallback (dgBody* body, void* const context)
+{
+	const dgBroadPhaseTreeQuery* const query = (dgBroadPhaseTreeQuery*) context;
+	if (body != query->m_sentinel) {
+		query->m_callback (body, query->m_userData);
+	}
+}
+
 void dgBroadPhaseCollision::ForEachBodyInAABB (const dgVector& p0, const dgVector& p1, OnBodiesInAABB callback, void* const userdata) const
 {
 	if (dgOverlapTest (p0, p1, m_appMinBox, m_appMaxBox)) {
 		dgBody* const sentinel = ((dgWorld*)this)->GetSentinelBody();
+		if (m_broadPhaseType == DG_BROADPHASE_AABB_TREE) {
+			dgBroadPhaseTreeQuery query;
+			query.m_callback = callback;
+			query.m_userData = userdata;
+			query.m_sentinel = sentinel;
+			m_tree.ForEachBodyInAABB (p0, p1, dgBroadPhaseTreeQueryCallback, &query);
+			return;
+		}
+
 		dgFloat32 x0 = GetMax (p0.m_x - m_min.m_x, dgFloat32 (0.0f));
 //		dgFloat32 y0 = GetMax (p0.m_y - m_min.m_y, dgFloat32 (0.0f));
 		dgFloat32 z0 = GetMax (p0.m_z - m_min.m_z, dgFloat32 (0.0f));
@@ -551,6 +1053,85 @@ void dgBroadPhaseCollision::ForEachBodyInAABB (const dgVector& p0, const dgVecto
 	}
 }
 
+#define DG_CONVEX_CAST_POOLSIZE 32
+
+class dgBroadPhaseConvexCast
+{
+	public:
+	dgWorld* m_world;
+	dgCollisionConvex* m_collision;
+	dgMatrix m_matrix;
+	dgVector m_velocA;
+	dgVector m_velocB;
+	dgVector m_p0;
+	dgVector m_p1;
+	OnRayPrecastAction m_prefilter;
+	void* m_userData;
+	dgConvexCastReturnInfo* m_info;
+	dgInt32 m_maxContacts;
+	dgInt32 m_threadIndex;
+	dgInt32 m_totalCount;
+	dgFloat32 m_timestep;
+	dgFloat32 m_timeToImpact;
+};
+
+void dgApi dgBroadPhaseCollision::ConvexCastBody (dgBody* const body, void* const context)
+{
+	dgBroadPhaseConvexCast& cast = *((dgBroadPhaseConvexCast*) context);
+
+	if (dgOverlapTest (body->m_minAABB, body->m_maxAABB, cast.m_p0, cast.m_p1)) {
+		if (!body->m_collision->IsType(dgCollision::dgCollisionNull_RTTI)) {
+			if (!PREFILTER_RAYCAST (cast.m_prefilter, body, cast.m_collision, cast.m_userData)) {
+				dgInt32 count;
+				dgFloat32 time;
+				dgTriplex points[DG_CONVEX_CAST_POOLSIZE]; 
+				dgTriplex normals[DG_CONVEX_CAST_POOLSIZE]; 
+				dgFloat32 penetration[DG_CONVEX_CAST_POOLSIZE]; 
+
+				dgWorld* const me = cast.m_world;
+				if (me->m_cpu == dgSimdPresent) {
+					count = me->CollideContinueSimd (cast.m_collision, cast.m_matrix, cast.m_velocA, cast.m_velocB,
+													   body->m_collision, body->m_matrix, cast.m_velocB, cast.m_velocB,
+													   time, points, normals, penetration, DG_CONVEX_CAST_POOLSIZE, cast.m_threadIndex);
+				} else {
+					count = me->CollideContinue (cast.m_collision, cast.m_matrix, cast.m_velocA, cast.m_velocB,
+												   body->m_collision, body->m_matrix, cast.m_velocB, cast.m_velocB,
+												   time, points, normals, penetration, DG_CONVEX_CAST_POOLSIZE, cast.m_threadIndex);
+				}
+
+				cast.m_timeToImpact = GetMin (time, cast.m_timeToImpact);
+
+				if (count) {
+					if (time <= cast.m_timestep) {		
+						if ((cast.m_timestep - time)> dgFloat32 (1.0e-3f)) {
+							cast.m_totalCount = 0;
+							cast.m_timestep = time;
+						} 
+						if (count >= (cast.m_maxContacts - cast.m_totalCount)) {
+							count = cast.m_maxContacts - cast.m_totalCount;
+						}
+
+						dgConvexCastReturnInfo* const info = cast.m_info;
+						for (dgInt32 i = 0; i < count; i ++) {
+							dgInt32 index = cast.m_totalCount;
+							info[index].m_hitBody = body;
+							info[index].m_point[0] = points[i].m_x;
+							info[index].m_point[1] = points[i].m_y;
+							info[index].m_point[2] = points[i].m_z;
+							info[index].m_normal[0] = normals[i].m_x;
+							info[index].m_normal[1] = normals[i].m_y;
+							info[index].m_normal[2] = normals[i].m_z;
+							info[index].m_penetration = penetration[i];
+							info[index].m_contaID = 0;
+							cast.m_totalCount ++;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
 dgInt32 dgBroadPhaseCollision::ConvexCast (
 	dgCollision* const shape, 
 	const dgMatrix& matrixOrigin, 
@@ -584,101 +1165,61 @@ dgInt32 dgBroadPhaseCollision::ConvexCast (
 	timeToImpact = dgFloat32 (1.2f);
 	if (dgOverlapTest (p0, p1, m_appMinBox, m_appMaxBox)) {
 
-		#define CONVEX_CAST_POOLSIZE 32
-		dgTriplex points[CONVEX_CAST_POOLSIZE]; 
-		dgTriplex normals[CONVEX_CAST_POOLSIZE]; 
-		dgFloat32 penetration[CONVEX_CAST_POOLSIZE]; 
-
-		if (maxContacts > CONVEX_CAST_POOLSIZE) {
-			maxContacts = CONVEX_CAST_POOLSIZE;
+		if (maxContacts > DG_CONVEX_CAST_POOLSIZE) {
+			maxContacts = DG_CONVEX_CAST_POOLSIZE;
 		} 
-		
-		dgWorld* const me = (dgWorld*)this;
-		dgInt32 cpu = me->m_cpu;
-//		dgBody* const sentinel = me->GetSentinelBody();
 
-		dgFloat32 timestep = 1.2f;
-		dgMatrix alignedMatrix (matrixOrigin);
-		dgVector velocA (target - matrixOrigin.m_posit);
-		dgVector velocB (dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f));
-
-
-		dgFloat32 x0 = GetMax (p0.m_x - m_min.m_x, dgFloat32 (0.0f));
-//		dgFloat32 y0 = GetMax (p0.m_y - m_min.m_y, dgFloat32 (0.0f));
-		dgFloat32 z0 = GetMax (p0.m_z - m_min.m_z, dgFloat32 (0.0f));
-		dgFloat32 x1 = GetMin (p1.m_x - m_min.m_x, m_worlSize * dgFloat32 (0.999f));
-//		dgFloat32 y1 = GetMin (p1.m_y - m_min.m_y, m_worlSize * dgFloat32 (0.999f));
-		dgFloat32 z1 = GetMin (p1.m_z - m_min.m_z, m_worlSize * dgFloat32 (0.999f));
-		for (dgInt32 layer = 0; layer < DG_OCTREE_MAX_DEPTH; layer ++) {
-			if (m_layerMap[layer].GetCount()) {
-				dgFloat32 cellScale = m_layerMap[layer].m_invCellSize;
-				dgInt32 ix0 = dgFastInt (x0 * cellScale);
-				dgInt32 ix1 = dgFastInt (x1 * cellScale);
-				for (dgInt32 xIndex = ix0; xIndex <= ix1; xIndex ++) {
-					dgInt32 iz0 = dgFastInt (z0 * cellScale);
-					dgInt32 iz1 = dgFastInt (z1 * cellScale);
-					for (dgInt32 zIndex = iz0; zIndex <= iz1; zIndex ++) {
-						dgBroadPhaseCell *const cell = m_layerMap[layer].Find (xIndex, zIndex);
-						if (cell) {
-							for (dgSortArray::dgListNode *node = cell->m_sort[0].GetFirst(); node; node = node->GetNext()) {
-								const dgBody* const body = node->GetInfo().m_body;
-								if (dgOverlapTest (body->m_minAABB, body->m_maxAABB, p0, p1)) {
-//									if (body != sentinel) {
-									if (!body->m_collision->IsType(dgCollision::dgCollisionNull_RTTI)) {
-										if (!PREFILTER_RAYCAST (prefilter, body, collision, userData)) {
-											dgInt32 count;
-											dgFloat32 time;
-
-											if (cpu == dgSimdPresent) {
-												count = me->CollideContinueSimd (collision, alignedMatrix, velocA, velocB,
-																				   body->m_collision, body->m_matrix, velocB, velocB,
-																				   time, points, normals, penetration, CONVEX_CAST_POOLSIZE, threadIndex);
-
-
-											} else {
-												count = me->CollideContinue (collision, alignedMatrix, velocA, velocB,
-																			   body->m_collision, body->m_matrix, velocB, velocB,
-																			   time, points, normals, penetration, CONVEX_CAST_POOLSIZE, threadIndex);
-
-											}
-
-											timeToImpact = GetMin (time, timeToImpact);
-
-											if (count) {
-												if (time <= timestep) {		
-													if ((timestep - time)> dgFloat32 (1.0e-3f)) {
-														totalCount = 0;
-														timestep = time;
-													} 
-													if (count >= (maxContacts - totalCount)) {
-														count = maxContacts - totalCount;
-													}
-
-													for (dgInt32 i = 0; i < count; i ++) {
-														info[totalCount].m_hitBody = body;
-														info[totalCount].m_point[0] = points[i].m_x;
-														info[totalCount].m_point[1] = points[i].m_y;
-														info[totalCount].m_point[2] = points[i].m_z;
-														info[totalCount].m_normal[0] = normals[i].m_x;
-														info[totalCount].m_normal[1] = normals[i].m_y;
-														info[totalCount].m_normal[2] = normals[i].m_z;
-														info[totalCount].m_penetration = penetration[i];
-														info[totalCount].m_contaID = 0;
-														totalCount ++;
-													}
-												}
-											}
-										}
-									}
+		dgBroadPhaseConvexCast context;
+		context.m_world = (dgWorld*)this;
+		context.m_collision = collision;
+		context.m_matrix = matrixOrigin;
+		context.m_velocA = target - matrixOrigin.m_posit;
+		context.m_velocB = dgVector (dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f), dgFloat32 (0.0f));
+		context.m_p0 = p0;
+		context.m_p1 = p1;
+		context.m_prefilter = prefilter;
+		context.m_userData = userData;
+		context.m_info = info;
+		context.m_maxContacts = maxContacts;
+		context.m_threadIndex = threadIndex;
+		context.m_totalCount = 0;
+		context.m_timestep = dgFloat32 (1.2f);
+		context.m_timeToImpact = timeToImpact;
+
+		if (m_broadPhaseType == DG_BROADPHASE_AABB_TREE) {
+			m_tree.ForEachBodyInAABB (p0, p1, ConvexCastBody, &context);
+		} else {
+			dgFloat32 x0 = GetMax (p0.m_x - m_min.m_x, dgFloat32 (0.0f));
+//			dgFloat32 y0 = GetMax (p0.m_y - m_min.m_y, dgFloat32 (0.0f));
+			dgFloat32 z0 = GetMax (p0.m_z - m_min.m_z, dgFloat32 (0.0f));
+			dgFloat32 x1 = GetMin (p1.m_x - m_min.m_x, m_worlSize * dgFloat32 (0.999f));
+//			dgFloat32 y1 = GetMin (p1.m_y - m_min.m_y, m_worlSize * dgFloat32 (0.999f));
+			dgFloat32 z1 = GetMin (p1.m_z - m_min.m_z, m_worlSize * dgFloat32 (0.999f));
+			for (dgInt32 layer = 0; layer < DG_OCTREE_MAX_DEPTH; layer ++) {
+				if (m_layerMap[layer].GetCount()) {
+					dgFloat32 cellScale = m_layerMap[layer].m_invCellSize;
+					dgInt32 ix0 = dgFastInt (x0 * cellScale);
+					dgInt32 ix1 = dgFastInt (x1 * cellScale);
+					for (dgInt32 xIndex = ix0; xIndex <= ix1; xIndex ++) {
+						dgInt32 iz0 = dgFastInt (z0 * cellScale);
+						dgInt32 iz1 = dgFastInt (z1 * cellScale);
+						for (dgInt32 zIndex = iz0; zIndex <= iz1; zIndex ++) {
+							dgBroadPhaseCell *const cell = m_layerMap[layer].Find (xIndex, zIndex);
+							if (cell) {
+								for (dgSortArray::dgListNode *node = cell->m_sort[0].GetFirst(); node; node = node->GetNext()) {
+									ConvexCastBody (node->GetInfo().m_body, &context);
 								}
 							}
-						}
 						
+						}
 					}
 				}
 			}
 		}
 
+		totalCount = context.m_totalCount;
+		timeToImpact = context.m_timeToImpact;
+		const dgVector& velocA = context.m_velocA;
 
 		if (totalCount) {
 			#define DG_RAY_TEST_LENGTH  dgFloat32 (0.015625f)
@@ -763,6 +1304,16 @@ void dgBroadPhaseCellPairsWorkerThread::ThreadExecute()
 	}
 }
 
+void dgBroadPhaseTreePairsWorkerThread::ThreadExecute()
+{
+	dgInt32 step = m_step; 
+	dgInt32 count = m_count;
+	const dgBroadPhaseCollision& broadPhase =  *m_world;
+	for (dgInt32 i = 0; i < count; i += step) {
+		broadPhase.UpdateTreePairs (m_bodies[i], m_threadIndex);
+	}
+}
+
 void dgBroadPhaseApplyExternalForce::ThreadExecute()
 {
 	dgInt32 step = m_step; 
@@ -952,6 +1503,11 @@ void dgBroadPhaseCollision::RayCast (
 
 		dgFloat32 minT = dgFloat32 (1.1f);
 
+		if (m_broadPhaseType == DG_BROADPHASE_AABB_TREE) {
+			m_tree.RayCast (minT, line, filter, prefilter, userData);
+			return;
+		}
+
 		dgVector rayP0 (l0 - m_min);
 		dgVector rayP1 (l1 - m_min);
 
@@ -1064,8 +1620,66 @@ void dgBroadPhaseCollision::RayCast (
 
 
 
+void dgBroadPhaseCollision::UpdateTreeBodyBroadphase(dgBody* const body, dgInt32 threadIndex)
+{
+	dgWorld* const me = (dgWorld*) this;
+	if (!body->m_isInWorld) {
+		if (dgOverlapTest (body->m_minAABB, body->m_maxAABB, m_appMinBox, m_appMaxBox)) {
+			if (!body->m_spawnnedFromCallback) {
+				me->dgGetUserLock();
+			}
+			Remove (body);
+			Add (body); 
+			if (!body->m_spawnnedFromCallback) {
+				me->dgReleasedUserLock();
+			}
+			body->m_isInWorld = true;
+			body->m_sleeping = false;
+			body->m_equilibrium = false;
+		}
+		return;
+	}
+
+	if (dgOverlapTest (body->m_minAABB, body->m_maxAABB, m_appMinBox, m_appMaxBox)) {
+		// the leaf only moves when the body leaves its enlarged box
+		dgBroadPhaseList& entry = body->m_collisionCell;
+		if ((entry.m_cell == &m_treeCell) && !dgBoxInclusionTest (body->m_minAABB, body->m_maxAABB, entry.m_fatMinBox, entry.m_fatMaxBox)) {
+			if (!body->m_spawnnedFromCallback) {
+				me->dgGetUserLock();
+			}
+			UpdateTreeLeaf (body);
+			if (!body->m_spawnnedFromCallback) {
+				me->dgReleasedUserLock();
+			}
+		}
+		return;
+	}
+
+	body->m_sleeping = true;
+	body->m_isInWorld = false;
+	body->m_equilibrium = true;
+
+	if (!body->m_spawnnedFromCallback) {
+		me->dgGetUserLock();
+	}
+	Remove (body);
+	m_inactiveList.Add (body); 
+	if (!body->m_spawnnedFromCallback) {
+		me->dgReleasedUserLock();
+	}
+
+	if (me->m_leavingWorldNotify) {
+		me->m_leavingWorldNotify (body, threadIndex);
+	}
+}
+
 void dgBroadPhaseCollision::UpdateBodyBroadphase(dgBody* const body, dgInt32 threadIndex)
 {
+	if (m_broadPhaseType == DG_BROADPHASE_AABB_TREE) {
+		UpdateTreeBodyBroadphase (body, threadIndex);
+		return;
+	}
+
 	if (!body->m_isInWorld) {
 		if (dgOverlapTest (body->m_minAABB, body->m_maxAABB, m_appMinBox, m_appMaxBox)) {
 //			dgBroadPhaseCell *cell;
@@ -1233,6 +1847,13 @@ dgUnsigned32 dgBroadPhaseCollision::UpdateContactsBroadPhaseBegin(dgFloat32 time
 					m_inactiveList.Add (body); 
 				}
 			}
+			// the application moves bodies without mass without waking them, 
+			// their tree leaf is not updated with the matrix
+			if ((body->m_collisionCell.m_cell == &m_treeCell) && 
+				!dgBoxInclusionTest (body->m_minAABB, body->m_maxAABB, body->m_collisionCell.m_fatMinBox, body->m_collisionCell.m_fatMaxBox)) {
+				UpdateTreeLeaf (body);
+			}
+
 			body->m_sleeping = true;
 			body->m_autoSleep = true;
 			body->m_equilibrium = true;
@@ -1435,6 +2056,23 @@ dgUnsigned32 dgBroadPhaseCollision::UpdateContactsBroadPhaseBegin(dgFloat32 time
 		m_cellPairsWorkerThreads[0].ThreadExecute();
 	}
 
+	if (m_broadPhaseType == DG_BROADPHASE_AABB_TREE) {
+		// the layers are empty, every awake body looks for its pairs in the tree
+		dgInt32 treeBodyCount = 0;
+		for (dgBodyMasterList::dgListNode* node = masterList.GetFirst()->GetNext(); node; node = node->GetNext()) { 
+			dgBody* const body = node->GetInfo().GetBody();
+			if (!body->m_sleeping && (body->m_collisionCell.m_cell == &m_treeCell)) {
+				bodyArray[treeBodyCount] = body;
+				treeBodyCount ++;
+				if (treeBodyCount >= dgInt32 (sizeof (bodyArray) / sizeof (bodyArray[0]))) {
+					SubmitTreePairs (bodyArray, treeBodyCount);
+					treeBodyCount = 0;
+				}
+			}
+		}
+		SubmitTreePairs (bodyArray, treeBodyCount);
+	}
+
 	for (dgInt32 i = 0; i < threadCounts; i ++) {
 		if (pairCaches[i].m_count) {
 			contactPair.FlushChache (&pairCaches[i]);
@@ -30,6 +30,16 @@
 //#define DG_OCTREE_MAX_DEPTH		6
 #define DG_OCTREE_MAX_DEPTH			7
 
+// broad phase algorithms
+#define DG_BROADPHASE_GRID			0
+#define DG_BROADPHASE_AABB_TREE		1
+
+// aabb tree leaves are enlarged by this margin and the distance the body 
+// travels in DG_AABB_TREE_PREDICTION seconds, slow bodies don't move their leaf every step
+#define DG_AABB_TREE_MARGIN			dgFloat32 (0.1f)
+#define DG_AABB_TREE_PREDICTION		dgFloat32 (1.0f / 30.0f)
+#define DG_AABB_TREE_STACK_DEPTH	256
+
 
 
 typedef void (dgApi *OnBodiesInAABB) (dgBody* body, void* const userData);
@@ -37,6 +47,8 @@ typedef void (dgApi *OnLeavingWorldAction) (dgBody* body, dgInt32 threadIndex);
 
 
 
+class dgBroadPhaseConvexCast;
+
 class dgCellPair
 {
 	public:
@@ -139,6 +151,57 @@ class dgBroadPhaseLayer: public dgTree<dgBroadPhaseCell, dgUnsigned32>
 };
 
 
+class dgBroadPhaseTreeNode
+{
+	public:
+	dgVector m_minBox;
+	dgVector m_maxBox;
+	dgBody* m_body;
+	dgInt32 m_parent;
+	dgInt32 m_left;
+	dgInt32 m_right;
+	dgInt32 m_height;
+};
+
+
+// dynamic aabb tree of the bodies. Leaves hold enlarged boxes, the insertion 
+// walks down to the sibling of least surface area cost and the refit rotates 
+// nodes on the way up when that makes the boxes of their children smaller 
+class dgBroadPhaseTree
+{
+	public:
+	dgBroadPhaseTree(dgMemoryAllocator* allocator);
+	~dgBroadPhaseTree();
+
+	dgInt32 Insert (dgBody* const body, const dgVector& minBox, const dgVector& maxBox);
+	void Remove (dgInt32 leaf);
+
+	void ForEachBodyInAABB (const dgVector& minBox, const dgVector& maxBox, OnBodiesInAABB callback, void* const userData) const;
+	dgFloat32 RayCast (dgFloat32 minT, const dgLineBox& line, OnRayCastAction filter, OnRayPrecastAction prefilter, void* const userData) const;
+
+	dgInt32 GetRoot() const {return m_root;}
+	dgInt32 GetHeight() const {return (m_root >= 0) ? m_nodes[m_root].m_height : 0;}
+
+	private:
+	dgInt32 AllocNode ();
+	void FreeNode (dgInt32 index);
+
+	void InsertLeaf (dgInt32 leaf);
+	void RemoveLeaf (dgInt32 leaf);
+	void ReplaceChild (dgInt32 parent, dgInt32 oldChild, dgInt32 newChild);
+	void UpdateNode (dgInt32 index);
+	void Rotate (dgInt32 index);
+	void Refit (dgInt32 index);
+
+	dgArray<dgBroadPhaseTreeNode> m_nodes;
+	dgInt32 m_nodesCount;
+	dgInt32 m_freeList;
+	dgInt32 m_root;
+
+	friend class dgBroadPhaseCollision;
+};
+
+
 class dgBroadPhaseApplyExternalForce: public dgWorkerThread
 {
 	public: 
@@ -163,6 +226,17 @@ class dgBroadPhaseCellPairsWorkerThread: public dgWorkerThread
 	dgCellPair *m_pairs;
 };
 
+class dgBroadPhaseTreePairsWorkerThread: public dgWorkerThread
+{
+	public: 
+	virtual void ThreadExecute();
+
+	dgInt32 m_step;		
+	dgInt32 m_count;
+	dgWorld* m_world;
+	dgBody** m_bodies;
+};
+
 class dgBroadPhaseCalculateContactsWorkerThread: public dgWorkerThread
 {
 	public: 
@@ -202,6 +276,9 @@ class dgBroadPhaseCollision
 	dgInt32 ConvexCast (dgCollision* const shape, const dgMatrix& p0, const dgVector& p1, dgFloat32& timetoImpact, OnRayPrecastAction prefilter, void* const userData, dgConvexCastReturnInfo* const info, dgInt32 maxContacts, dgInt32 threadIndex) const;
 	void ForEachBodyInAABB (const dgVector& q0, const dgVector& q1, OnBodiesInAABB callback, void* const userData) const;
 
+	void SetBroadPhaseType (dgInt32 type);
+	dgInt32 GetBroadPhaseType () const {return m_broadPhaseType;}
+
 	private:
 	dgBroadPhaseCollision(dgMemoryAllocator* allocator);
 	~dgBroadPhaseCollision();
@@ -222,6 +299,14 @@ class dgBroadPhaseCollision
 	void UpdatePairs (dgBroadPhaseCell& cellA, dgBroadPhaseCell& cellB, dgInt32 threadIndex) const;
 	void UpdatePairs (dgBody* const body0, dgSortArray::dgListNode* const listNode, dgInt32 axisX, dgInt32 threadIndex) const;
 
+	void CalculateTreeBox (const dgBody* const body, dgVector& minBox, dgVector& maxBox) const;
+	void UpdateTreeLeaf (dgBody* const body);
+	void UpdateTreePairs (dgBody* const body0, dgInt32 threadIndex) const;
+	void UpdateTreeBodyBroadphase (dgBody* const body, dgInt32 threadIndex);
+	void SubmitTreePairs (dgBody** const bodyArray, dgInt32 count);
+
+	static void dgApi ConvexCastBody (dgBody* const body, void* const context);
+
 	dgVector m_min;
 	dgVector m_max;
 	dgVector m_appMinBox;
@@ -230,8 +315,14 @@ class dgBroadPhaseCollision
 	dgVector m_boxSize;
 	dgBroadPhaseCell m_inactiveList;
 	dgBroadPhaseLayer m_layerMap[DG_OCTREE_MAX_DEPTH];
+
+	// with the aabb tree, bodies in the tree point to m_treeCell (the layers stay empty)
+	dgInt32 m_broadPhaseType;
+	dgBroadPhaseTree m_tree;
+	dgBroadPhaseCell m_treeCell;
 	dgBroadPhaseApplyExternalForce m_applyExtForces[DG_MAXIMUN_THREADS];
 	dgBroadPhaseCellPairsWorkerThread m_cellPairsWorkerThreads[DG_MAXIMUN_THREADS];
+	dgBroadPhaseTreePairsWorkerThread m_treePairsWorkerThreads[DG_MAXIMUN_THREADS];
 	dgBroadPhaseMaterialCallbackWorkerThread m_materialCallbackWorkerThreads[DG_MAXIMUN_THREADS];
 	dgBroadPhaseCalculateContactsWorkerThread m_calculateContactsWorkerThreads[DG_MAXIMUN_THREADS];
 	
@@ -242,6 +333,7 @@ class dgBroadPhaseCollision
 	friend class dgBody;
 	friend class dgWorld;
 	friend class dgBroadPhaseCellPairsWorkerThread;
+	friend class dgBroadPhaseTreePairsWorkerThread;
 };
 
 #endif
@@ -406,6 +406,12 @@ void dgWorld::SetThreadsCount (dgInt32 count)
 	
 }
 
+void dgWorld::SetExternalScheduler (dgInt32 count, dgExternalSubmitCallback submit, dgExternalBarrierCallback barrier, void* const userData)
+{
+	m_threadsManager.SetExternalScheduler (count, submit, barrier, userData);
+	m_numberOfTheads = dgUnsigned32 (m_threadsManager.GetThreadCount());
+}
+
 dgInt32 dgWorld::GetThreadsCount () const
 {
 	return dgInt32 (m_numberOfTheads);
@@ -435,6 +441,30 @@ void dgWorld::SetFrictionThreshold (dgFloat32 acceleration)
 	m_frictiomTheshold = GetMax (dgFloat32(1.0e-2f), acceleration);
 }
 
+void dgWorld::SetSleepThresholds (dgFloat32 maxAccel, dgFloat32 maxSpeed, dgFloat32 maxOmega, dgInt32 frames)
+{
+	dgFloat32 accel2 = maxAccel * maxAccel;
+	dgFloat32 speed2 = maxSpeed * maxSpeed;
+	dgFloat32 omega2 = maxOmega * maxOmega;
+
+	frames = GetMax (frames, dgInt32 (1));
+
+	// the quick entries keep their thresholds, but never above the slowest one
+	for (dgInt32 i = 0; i < DG_SLEEP_ENTRIES - 1; i ++) {
+		m_sleepTable[i].m_maxAccel = GetMin (m_sleepTable[i].m_maxAccel, accel2);
+		m_sleepTable[i].m_maxAlpha = GetMin (m_sleepTable[i].m_maxAlpha, accel2);
+		m_sleepTable[i].m_maxVeloc = GetMin (m_sleepTable[i].m_maxVeloc, speed2);
+		m_sleepTable[i].m_maxOmega = GetMin (m_sleepTable[i].m_maxOmega, omega2);
+		m_sleepTable[i].m_steps = GetMin (m_sleepTable[i].m_steps, frames);
+	}
+
+	m_sleepTable[DG_SLEEP_ENTRIES - 1].m_maxAccel = accel2;
+	m_sleepTable[DG_SLEEP_ENTRIES - 1].m_maxAlpha = accel2;
+	m_sleepTable[DG_SLEEP_ENTRIES - 1].m_maxVeloc = speed2;
+	m_sleepTable[DG_SLEEP_ENTRIES - 1].m_maxOmega = omega2;
+	m_sleepTable[DG_SLEEP_ENTRIES - 1].m_steps = frames;
+}
+
 
 void dgWorld::RemoveAllGroupID()
 {
@@ -157,6 +157,7 @@ class dgWorld:
 	void SetThreadsCount (dgInt32 count);
 	dgInt32 GetThreadsCount () const;
 	dgInt32 GetMaxThreadsCount () const;
+	void SetExternalScheduler (dgInt32 count, dgExternalSubmitCallback submit, dgExternalBarrierCallback barrier, void* const userData);
 //	dgInt32 GetThreadNumber() const;
 	void EnableThreadOnSingleIsland(dgInt32 mode);
 	dgInt32 GetThreadOnSingleIsland() const;
@@ -185,6 +186,7 @@ class dgWorld:
 
 
 	void SetFrictionThreshold (dgFloat32 acceletion);
+	void SetSleepThresholds (dgFloat32 maxAccel, dgFloat32 maxSpeed, dgFloat32 maxOmega, dgInt32 frames);
 
 
 	dgBody* GetIslandBody (const void* const island, dgInt32 index) const;
@@ -11,12 +11,14 @@ using namespace engine;
 
 CBaseCharacter::CBaseCharacter()
 {
-  runSpeedFactor = floorY = fallingTime = 0.f;
+  runSpeedFactor = floorY = fallingTime = deathTime = 0.f;
 
   body.Node = (irr::scene::IAnimatedMeshSceneNode*) NULL;
 
 #ifdef PHYSICS_NEWTON
   body.PhysicsBody = (physics::CBody*)NULL;
+
+  vehicle = -1;
 #endif
 
   userID = -1;
@@ -34,6 +36,138 @@ void CBaseCharacter::remove()
 
 }
 
+void CBaseCharacter::die(const irr::core::vector3df& velocity)
+{
+  if(parameters.States & ECS_DEAD)
+    return;
+
+  parameters.States = ECS_DEAD;
+  parameters.Health = 0.f;
+  deathTime = 0.f;
+
+  ++stats.deaths;
+
+#ifdef PHYSICS_NEWTON
+  // The corpse falls out beside the vehicle
+  leaveVehicle();
+#endif
+
+  if(!body.Node)
+    return;
+
+#ifdef PHYSICS_NEWTON
+  // The ragdoll poses a copy of the node, meshes without the soldier skeleton just vanish
+  Core->getPhysics()->getRagdolls()->spawn(body.Node, velocity);
+
+  // The capsule waits for the respawn where it is, nothing collides with it
+  body.PhysicsBody->setForce(irr::core::vector3df(0.f, 0.f, 0.f));
+  body.PhysicsBody->setVelocity(irr::core::vector3df(0.f, 0.f, 0.f));
+  body.PhysicsBody->setCollisionEnabled(false);
+#endif
+
+  body.Node->setVisible(false);
+}
+
+#ifdef PHYSICS_NEWTON
+bool CBaseCharacter::enterVehicle()
+{
+  if(vehicle >= 0 || !body.PhysicsBody)
+    return false;
+
+  CVehicleManager *vehicles = Core->getPhysics()->getVehicles();
+
+  irr::s32 index = vehicles->getFreeVehicle(body.PhysicsBody->getPosition());
+
+  if(index < 0)
+    return false;
+
+  vehicles->setDriven(index, true);
+  vehicle = index;
+
+  // Rides along without colliding with the chassis
+  parameters.States &= ~ECS_MOVING;
+
+  body.PhysicsBody->setVelocity(irr::core::vector3df(0.f, 0.f, 0.f));
+  body.PhysicsBody->setCollisionEnabled(false);
+
+  if(body.Node)
+    body.Node->setVisible(false);
+
+  return true;
+}
+
+void CBaseCharacter::leaveVehicle()
+{
+  if(vehicle < 0)
+    return;
+
+  CVehicleManager *vehicles = Core->getPhysics()->getVehicles();
+
+  // The level was cleared under the driver
+  if(irr::u32(vehicle) >= vehicles->getVehicleCount())
+  {
+    vehicle = -1;
+    return;
+  }
+
+  irr::scene::ISceneNode *node = vehicles->getVehicle(vehicle).Node;
+
+  vehicles->setDriven(vehicle, false);
+  vehicle = -1;
+
+  irr::core::matrix4 matrix;
+  matrix.setRotationDegrees(node->getRotation());
+
+  irr::core::vector3df left(-matrix[0], 0.f, -matrix[2]);
+  left.normalize();
+
+  // Clear of the chassis' box
+  irr::core::vector3df extent = node->getTransformedBoundingBox().getExtent();
+  irr::f32 distance = irr::core::max_(extent.X, extent.Z) * 0.5f + VEHICLE_ENTER_DISTANCE * 0.5f;
+
+  body.PhysicsBody->setPosition(node->getPosition() + left * distance);
+  body.PhysicsBody->setVelocity(irr::core::vector3df(0.f, 0.f, 0.f));
+  body.PhysicsBody->setCollisionEnabled(true);
+
+  if(body.Node)
+    body.Node->setVisible(true);
+}
+
+void CBaseCharacter::drive(irr::f32 throttle, irr::f32 steering, bool brake)
+{
+  if(vehicle < 0)
+    return;
+
+  CVehicleManager *vehicles = Core->getPhysics()->getVehicles();
+
+  vehicles->setControls(vehicle, throttle, steering, brake);
+
+  irr::scene::ISceneNode *node = vehicles->getVehicle(vehicle).Node;
+
+  irr::core::vector3df seat = node->getPosition();
+  seat.Y = node->getTransformedBoundingBox().MaxEdge.Y;
+
+  body.PhysicsBody->setPosition(seat);
+  body.PhysicsBody->setRotation(irr::core::vector3df(0.f, node->getRotation().Y, 0.f));
+  body.PhysicsBody->setVelocity(irr::core::vector3df(0.f, 0.f, 0.f));
+}
+#endif
+
+bool CBaseCharacter::updateDeath()
+{
+  if(!(parameters.States & ECS_DEAD))
+  {
+    if(parameters.HealthMax <= 0.f || parameters.Health > 0.f)
+      return false;
+
+    die();
+  }
+
+  deathTime += Core->time.delta;
+
+  return true;
+}
+
 
 // Character rotation is calculated from body and parented empty node
 // in front of the character.
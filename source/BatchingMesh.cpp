@@ -6,13 +6,15 @@ namespace scene
 {
 
 CBatchingMesh::CBatchingMesh()
- : Box(core::vector3df(0,0,0)), IsDirty(false), IsFinal(false)
+ : CurrentLod(0), Box(core::vector3df(0,0,0)), IsDirty(false), IsFinal(false)
 {
 SourceMeshes.set_used(0);
 }
 
 CBatchingMesh::~CBatchingMesh()
 {
+	clearLods();
+
 	u32 i;
 	for (i=0; i < DestBuffers.size(); ++i)
 		DestBuffers[i].Buffer->drop();
@@ -33,6 +35,10 @@ bool CBatchingMesh::isDirty(s32 id)
 //! refreshes the internal buffers from source
 void CBatchingMesh::update()
 {
+	// lower detail levels were built from the old buffers
+	if (IsDirty)
+		clearLods();
+
 	// allocate the index and vertex arrays
 	u32 i;
 	for (i=0; i<DestBuffers.size(); ++i)
@@ -42,32 +48,8 @@ void CBatchingMesh::update()
 		{
 			DestBuffers[i].IsDirty = true;
 
-			switch (DestBuffers[i].VertexType)
-			{
-			case video::EVT_STANDARD:
-			{
-				SMeshBuffer* mb = (SMeshBuffer*)DestBuffers[i].Buffer;
-				mb->Vertices.set_used(DestBuffers[i].VertexCount);
-				mb->Indices.set_used(DestBuffers[i].IndexCount);
-				break;
-			}
-			case video::EVT_2TCOORDS:
-			{
-				SMeshBufferLightMap* mb = (SMeshBufferLightMap*)DestBuffers[i].Buffer;
-				mb->Vertices.set_used(DestBuffers[i].VertexCount);
-				mb->Indices.set_used(DestBuffers[i].IndexCount);
-				break;
-			}
-			case video::EVT_TANGENTS:
-			{
-				SMeshBufferTangents* mb = (SMeshBufferTangents*)DestBuffers[i].Buffer;
-				mb->Vertices.set_used(DestBuffers[i].VertexCount);
-				mb->Indices.set_used(DestBuffers[i].IndexCount);
-				break;
-			}
-			default: // shouldn't ever happen
-				continue;
-			}
+			DestBuffers[i].Buffer->getVertexBuffer().set_used(DestBuffers[i].VertexCount);
+			DestBuffers[i].Buffer->getIndexBuffer().set_used(DestBuffers[i].IndexCount);
 		}
 	}
 
@@ -163,46 +145,27 @@ s32 CBatchingMesh::addMeshBuffer(IMeshBuffer* buffer, const core::matrix4 &trans
 		if (MaterialReferences[i].VertexType == vt &&
 		    MaterialReferences[i].Material == m)
 		{
-			// will there be too many vertices in the buffer?
-			u32 newTotalI = buffer->getIndexCount() + DestBuffers[ MaterialReferences[i].BufferIndex ].IndexCount;
-			u32 newTotalV = buffer->getVertexCount() + DestBuffers[ MaterialReferences[i].BufferIndex ].VertexCount;
-
-			if ( newTotalI < 65536*3 && newTotalV < 65536)
-			{
-				found = true;
-				DestBuffers[ MaterialReferences[i].BufferIndex ].IndexCount = newTotalI;
-				DestBuffers[ MaterialReferences[i].BufferIndex ].VertexCount = newTotalV;
-				break;
-			}
+			// 32 bit indices, the buffer never fills up
+			found = true;
+			DestBuffers[ MaterialReferences[i].BufferIndex ].IndexCount += buffer->getIndexCount();
+			DestBuffers[ MaterialReferences[i].BufferIndex ].VertexCount += buffer->getVertexCount();
+			break;
 		}
 	}
 
 	if (!found)
 	{
 		// we need a new destination buffer and material reference
-		IMeshBuffer *mb=0;
+		if (vt != video::EVT_STANDARD && vt != video::EVT_2TCOORDS && vt != video::EVT_TANGENTS)
+			return -1; // unknown vertex type
+
+		CDynamicMeshBuffer *mb = new CDynamicMeshBuffer(vt, video::EIT_32BIT);
+		mb->Material = m;
 
 		SMaterialReference r;
 		r.Material = m;
 		r.VertexType = vt;
 		r.BufferIndex = DestBuffers.size();
-		switch (vt)
-		{
-		case video::EVT_STANDARD:
-			mb = (IMeshBuffer*)new SMeshBuffer();
-			mb->getMaterial() = m;
-			break;
-		case video::EVT_2TCOORDS:
-			mb = (IMeshBuffer*)new SMeshBufferLightMap();
-			mb->getMaterial() = m;
-			break;
-		case video::EVT_TANGENTS:
-			mb = (IMeshBuffer*)new SMeshBufferTangents();
-			mb->getMaterial() = m;
-			break;
-		default: // unknown vertex type
-			return -1;
-		}
 		i = MaterialReferences.size();
 		MaterialReferences.push_back(r);
 
@@ -265,7 +228,7 @@ NULL if there is no such mesh buffer. */
 IMeshBuffer* CBatchingMesh::getMeshBuffer(u32 nr) const
 {
 	if (nr < DestBuffers.size())
-		return DestBuffers[nr].Buffer;
+		return CurrentLod ? Lods[CurrentLod-1].Buffers[nr] : DestBuffers[nr].Buffer;
 	else
 		return 0;
 }
@@ -296,11 +259,17 @@ void CBatchingMesh::setMaterialFlag(video::E_MATERIAL_FLAG flag, bool newvalue)
 {
 	for (u32 i=0; i<DestBuffers.size(); ++i)
 		DestBuffers[i].Buffer->getMaterial().setFlag(flag, newvalue);
+
+	for (u32 l=0; l<Lods.size(); ++l)
+		for (u32 i=0; i<Lods[l].Buffers.size(); ++i)
+			Lods[l].Buffers[i]->getMaterial().setFlag(flag, newvalue);
 }
 
 //! drops all buffers and clears internal states
 void CBatchingMesh::clear()
 {
+	clearLods();
+
 	u32 i;
 	for (i=0; i < DestBuffers.size(); ++i)
 		DestBuffers[i].Buffer->drop();
@@ -320,7 +289,7 @@ void CBatchingMesh::clear()
 
 //! first updates the mesh, then drops all source buffers.
 /** once this mesh has been finalized, it cannot be changed again! */
-void CBatchingMesh::finalize()
+void CBatchingMesh::finalize(const IMeshManipulator* optimizer)
 {
 	update();
 
@@ -329,9 +298,45 @@ void CBatchingMesh::finalize()
 
 	SourceBuffers.clear();
 
+	// buffers are no longer refreshed from their sources, their order can change
+	if (optimizer && !IsFinal)
+	{
+		for (u32 i=0; i < DestBuffers.size(); ++i)
+			optimizer->optimizeMeshBuffer(DestBuffers[i].Buffer);
+	}
+
 	IsFinal = true;
 }
 
+//! measures the vertex cache use of the destination buffers
+void CBatchingMesh::getVertexCacheStats(const IMeshManipulator* manipulator, f32& acmr, f32& atvr) const
+{
+	f32 misses = 0.f;
+	u32 triangles = 0, vertices = 0;
+
+	acmr = 0.f;
+	atvr = 0.f;
+
+	for (u32 i=0; i < DestBuffers.size(); ++i)
+	{
+		const IMeshBuffer* mb = DestBuffers[i].Buffer;
+
+		f32 bufferAcmr, bufferAtvr;
+		manipulator->getVertexCacheStats(mb, bufferAcmr, bufferAtvr);
+
+		misses += bufferAcmr * (mb->getIndexCount() / 3);
+		triangles += mb->getIndexCount() / 3;
+
+		if (bufferAtvr > 0.f)
+			vertices += (u32)(bufferAcmr * (mb->getIndexCount() / 3) / bufferAtvr + 0.5f);
+	}
+
+	if (triangles)
+		acmr = misses / triangles;
+	if (vertices)
+		atvr = misses / vertices;
+}
+
 //! Moves a mesh
 core::array<bool> CBatchingMesh::moveMesh(const core::array<s32>& bufferIDs, const core::matrix4 &newMatrix)
 {
@@ -352,12 +357,20 @@ bool CBatchingMesh::moveMeshBuffer(const s32 id, const core::matrix4 &newMatrix)
 
 	BufferReferences[id].Transform = newMatrix;
 
+	// the simplified copies would keep the old position
+	if (Lods.size())
+		clearLods();
+
 	// is the source buffer dirty?
 	if (!DestBuffers[BufferReferences[id].DestReference].IsDirty)
 	{
 		// transform each vertex and normal
 		updateDestFromSourceBuffer(id);
 		recalculateDestBufferBoundingBox(BufferReferences[id].DestReference);
+
+		// only the moved vertices have to be uploaded again
+		DestBuffers[BufferReferences[id].DestReference].Buffer->setDirtyVertices(
+			BufferReferences[id].FirstVertex, BufferReferences[id].VertexCount);
 	}
 	return true;
 }
@@ -391,85 +404,196 @@ u32 CBatchingMesh::getSourceBufferCount() const
 	return BufferReferences.size();
 }
 
-// private functions
+//! builds lower detail copies of the destination buffers
+u32 CBatchingMesh::generateLods(const IMeshManipulator* manipulator, u32 levels, f32 ratio)
+{
+	clearLods();
 
-void CBatchingMesh::recalculateDestBufferBoundingBox(u32 i)
+	if (!manipulator || IsDirty || DestBuffers.size() == 0)
+		return getLodCount();
+
+	u32 previousTriangles = getLodTriangleCount(0);
+
+	for (u32 l=1; l < levels; ++l)
+	{
+		SLodLevel level;
+		level.ScreenSize = 0.f;
+		level.Buffers.reallocate(DestBuffers.size());
+
+		u32 triangles = 0;
+
+		for (u32 i=0; i < DestBuffers.size(); ++i)
+		{
+			// every level is simplified from the one before it
+			IMeshBuffer* source = (l == 1) ? DestBuffers[i].Buffer : Lods.getLast().Buffers[i];
+			IMeshBuffer* simplified = manipulator->createSimplifiedMeshBuffer(source, ratio);
+
+			if (!simplified)
+			{
+				simplified = source;
+				simplified->grab();
+			}
+			else
+			{
+				manipulator->optimizeMeshBuffer(simplified);
+
+				simplified->setHardwareMappingHint(DestBuffers[i].Buffer->getHardwareMappingHint_Vertex(), EBT_VERTEX);
+				simplified->setHardwareMappingHint(DestBuffers[i].Buffer->getHardwareMappingHint_Index(), EBT_INDEX);
+			}
+
+			triangles += simplified->getIndexCount() / 3;
+			level.Buffers.push_back(simplified);
+		}
+
+		Lods.push_back(level);
+
+		// locked borders and seams stopped the simplification, the level
+		// would cost memory without saving triangles
+		if (triangles * 10 > previousTriangles * 9)
+		{
+			for (u32 i=0; i < level.Buffers.size(); ++i)
+				level.Buffers[i]->drop();
+
+			Lods.erase(Lods.size()-1);
+			break;
+		}
+
+		previousTriangles = triangles;
+	}
+
+	return getLodCount();
+}
+
+//! drops the lower detail levels, the mesh draws at full detail
+void CBatchingMesh::clearLods()
+{
+	for (u32 l=0; l < Lods.size(); ++l)
+		for (u32 i=0; i < Lods[l].Buffers.size(); ++i)
+			Lods[l].Buffers[i]->drop();
+
+	Lods.clear();
+	CurrentLod = 0;
+}
+
+//! sets the screen size below which a level is used
+void CBatchingMesh::setLodScreenSize(u32 level, f32 size)
+{
+	if (level > 0 && level <= Lods.size())
+		Lods[level-1].ScreenSize = size;
+}
+
+//! picks the detail level for the screen size the mesh covers
+bool CBatchingMesh::selectLod(f32 screenSize, f32 hysteresis)
 {
-	switch (DestBuffers[i].VertexType)
+	u32 level = CurrentLod;
+
+	// finer while the mesh is larger than the threshold of its level
+	while (level > 0 && screenSize > Lods[level-1].ScreenSize * (1.f + hysteresis))
+		--level;
+
+	// coarser while it is smaller than the threshold of the next one
+	while (level < Lods.size() && screenSize < Lods[level].ScreenSize * (1.f - hysteresis))
+		++level;
+
+	if (level == CurrentLod)
+		return false;
+
+	CurrentLod = level;
+	return true;
+}
+
+//! returns the number of triangles drawn at the given level
+u32 CBatchingMesh::getLodTriangleCount(u32 level) const
+{
+	u32 triangles = 0;
+
+	if (level == 0)
 	{
-	case video::EVT_STANDARD:
-		((SMeshBuffer*)DestBuffers[i].Buffer)->recalculateBoundingBox();
-		break;
-	case video::EVT_2TCOORDS:
-		((SMeshBufferLightMap*)DestBuffers[i].Buffer)->recalculateBoundingBox();
-		break;
-	case video::EVT_TANGENTS:
-		((SMeshBufferTangents*)DestBuffers[i].Buffer)->recalculateBoundingBox();
-		break;
+		for (u32 i=0; i < DestBuffers.size(); ++i)
+			triangles += DestBuffers[i].Buffer->getIndexCount() / 3;
+	}
+	else if (level <= Lods.size())
+	{
+		for (u32 i=0; i < Lods[level-1].Buffers.size(); ++i)
+			triangles += Lods[level-1].Buffers[i]->getIndexCount() / 3;
 	}
+
+	return triangles;
+}
+
+// private functions
+
+void CBatchingMesh::recalculateDestBufferBoundingBox(u32 i)
+{
+	DestBuffers[i].Buffer->recalculateBoundingBox();
 }
 
 void CBatchingMesh::updateDestFromSourceBuffer(u32 i)
 {
-	u16* ind = BufferReferences[i].SourceBuffer->getIndices();
-	void*ver = BufferReferences[i].SourceBuffer->getVertices();
+	IMeshBuffer* source = BufferReferences[i].SourceBuffer;
+	void*ver = source->getVertices();
 	core::matrix4 m = BufferReferences[i].Transform;
 	u32 fi = BufferReferences[i].FirstIndex;
 	u32 fv = BufferReferences[i].FirstVertex;
 	u32 ic = BufferReferences[i].IndexCount;
 	u32 vc = BufferReferences[i].VertexCount;
 	u32 x;
+	CDynamicMeshBuffer* dest = DestBuffers[BufferReferences[i].DestReference].Buffer;
+
+	// source buffers can use either index type
+	u32* indices = (u32*) dest->getIndexBuffer().pointer();
+	if (source->getIndexType() == video::EIT_32BIT)
+	{
+		const u32* ind = (const u32*) source->getIndices();
+		for (x=fi; x < fi+ic; ++x)
+			indices[x] = ind[x-fi]+fv;
+	}
+	else
+	{
+		const u16* ind = source->getIndices();
+		for (x=fi; x < fi+ic; ++x)
+			indices[x] = ind[x-fi]+fv;
+	}
+
 	video::E_VERTEX_TYPE vt = DestBuffers[BufferReferences[i].DestReference].VertexType;
 	switch (vt)
 	{
 	case video::EVT_STANDARD:
 	{
-		SMeshBuffer* dest = (SMeshBuffer*) DestBuffers[BufferReferences[i].DestReference].Buffer;
-
-		for (x=fi; x < fi+ic; ++x)
-			dest->Indices[x] = ind[x-fi]+fv;
-
+		video::S3DVertex* destVertices = (video::S3DVertex*) dest->getVertexBuffer().pointer();
 		video::S3DVertex* vertices= (video::S3DVertex*) ver;
 
 		for (x=fv; x < fv+vc; ++x)
 		{
-			dest->Vertices[x] = vertices[x-fv];
-			m.transformVect(dest->Vertices[x].Pos);
-			m.rotateVect(dest->Vertices[x].Normal);
+			destVertices[x] = vertices[x-fv];
+			m.transformVect(destVertices[x].Pos);
+			m.rotateVect(destVertices[x].Normal);
 		}
 		break;
 	}
 	case video::EVT_2TCOORDS:
 	{
-		SMeshBufferLightMap* dest = (SMeshBufferLightMap*) DestBuffers[BufferReferences[i].DestReference].Buffer;
-
-		for (x=fi; x < fi+ic; ++x)
-			dest->Indices[x] = ind[x-fi]+fv;
-
+		video::S3DVertex2TCoords* destVertices = (video::S3DVertex2TCoords*) dest->getVertexBuffer().pointer();
 		video::S3DVertex2TCoords* vertices= (video::S3DVertex2TCoords*) ver;
 
 		for (x=fv; x < fv+vc; ++x)
 		{
-			dest->Vertices[x] = vertices[x-fv];
-			m.transformVect(dest->Vertices[x].Pos);
-			m.rotateVect(dest->Vertices[x].Normal);
+			destVertices[x] = vertices[x-fv];
+			m.transformVect(destVertices[x].Pos);
+			m.rotateVect(destVertices[x].Normal);
 		}
 		break;
 	}
 	case video::EVT_TANGENTS:
 	{
-		SMeshBufferTangents* dest = (SMeshBufferTangents*) DestBuffers[BufferReferences[i].DestReference].Buffer;
-
-		for (x=fi; x < fi+ic; ++x)
-			dest->Indices[x] = ind[x-fi]+fv;
-
+		video::S3DVertexTangents* destVertices = (video::S3DVertexTangents*) dest->getVertexBuffer().pointer();
 		video::S3DVertexTangents* vertices= (video::S3DVertexTangents*) ver;
 
 		for (x=fv; x < fv+vc; ++x)
 		{
-			dest->Vertices[x] = vertices[x-fv];
-			m.transformVect(dest->Vertices[x].Pos);
-			m.rotateVect(dest->Vertices[x].Normal); // are tangents/binormals in face space?
+			destVertices[x] = vertices[x-fv];
+			m.transformVect(destVertices[x].Pos);
+			m.rotateVect(destVertices[x].Normal); // are tangents/binormals in face space?
 		}
 		break;
 	}
@@ -500,6 +624,10 @@ void CBatchingMesh::setHardwareMappingHint(E_HARDWARE_MAPPING mapping, E_BUFFER_
 {
 	for (u32 i=0; i < DestBuffers.size(); ++i)
 		DestBuffers[i].Buffer->setHardwareMappingHint(mapping, type);
+
+	for (u32 l=0; l < Lods.size(); ++l)
+		for (u32 i=0; i < Lods[l].Buffers.size(); ++i)
+			Lods[l].Buffers[i]->setHardwareMappingHint(mapping, type);
 }
 
 
@@ -507,6 +635,10 @@ void CBatchingMesh::setDirty(E_BUFFER_TYPE type)
 {
 	for (u32 i=0; i < DestBuffers.size(); ++i)
 		DestBuffers[i].Buffer->setDirty(type);
+
+	for (u32 l=0; l < Lods.size(); ++l)
+		for (u32 i=0; i < Lods[l].Buffers.size(); ++i)
+			Lods[l].Buffers[i]->setDirty(type);
 }
 
 } // namespace scene
@@ -1,18 +1,233 @@
 #include "Core.h"
+#include "Game.h"
 #include "Bot.h"
+#include "CharacterManager.h"
+#include "ObjectManager.h"
+#include "Pathfinder.h"
+#include "Network.h"
+#include "Maths.h"
 
 using namespace game;
 
-CBot::CBot(engine::SCharacterCreationParameters params)
+// Waypoints closer than this (horizontally) count as reached
+const irr::f32 BOT_WAYPOINT_RADIUS = 0.75f;
+
+// Wait before planning again when there was no path
+const irr::f32 BOT_REPLAN_DELAY = 2.f;
+
+// Vehicles turn wide, their waypoints count as reached farther away
+const irr::f32 BOT_VEHICLE_WAYPOINT_RADIUS = 3.f;
+
+// Waypoints further off the heading than this are driven to slowly (degrees)
+const irr::f32 BOT_VEHICLE_SLOW_ANGLE = 60.f;
+
+CBot::CBot(CGame * game, engine::SCharacterCreationParameters params) : Game(game)
 {
+  parameters.TeamID = params.TeamID;
+  parameters.Class = params.Class;
 
+  Core = Game->getCore();
+
+  m_PathTicket = 0;
+  m_PathIndex = 0;
+  m_PlanDelay = 0.f;
+}
+
+CBot::~CBot()
+{
+#ifdef MICROPATHER
+  if(m_PathTicket != 0 && Core->getObjects())
+    Core->getObjects()->getPathfinder()->cancelPath(m_PathTicket);
+#endif
+}
+
+void CBot::plan()
+{
+#ifdef MICROPATHER
+  engine::CPathfinder *pathfinder = Core->getObjects()->getPathfinder();
+
+  if(!pathfinder->isReady())
+    return;
+
+  // Head for the enemy base
+  irr::u16 enemyTeam = parameters.TeamID == E_TEAM1 ? E_TEAM2 : E_TEAM1;
+
+  irr::core::array<engine::SSpawnpoint> spawnpoints;
+  Core->getObjects()->getSpawnpointsForTeam(enemyTeam, spawnpoints);
+
+  if(spawnpoints.size() == 0)
+    return;
+
+  irr::core::vector3df destination =
+    spawnpoints[Core->getMath()->getRandomInt(0, spawnpoints.size()-1)].Position;
+
+  // Solved by a worker thread, picked up by a later update()
+  m_PathTicket = pathfinder->requestPath(body.PhysicsBody->getPosition(), destination);
+#endif
 }
 
 void CBot::update()
 {
+  if(updateDeath())
+  {
+    if(getDeathTime() >= engine::CHARACTER_RESPAWN_DELAY)
+      Game->getCharacters()->spawn(this);
+
+    return;
+  }
+
+#ifdef PHYSICS_NEWTON
+  body.PhysicsBody->setForce(irr::core::vector3df(0,0,0));
+  body.PhysicsBody->setVelocity(irr::core::vector3df(0,0,0));
+  body.PhysicsBody->setOmega(irr::core::vector3df(0,0,0));
+#endif
+
+  // A network client controls this character, its input replaces the AI
+  engine::SNetInput command;
+
+  if(Core->getNetwork()->getInput(this, command))
+  {
+    followInput(command);
+
+    engine::CBaseCharacter::update();
+    return;
+  }
+
+#ifdef MICROPATHER
+  engine::CPathfinder *pathfinder = Core->getObjects()->getPathfinder();
+
+  // Never wait for the path, keep checking on the following frames
+  if(m_PathTicket != 0)
+  {
+    engine::E_PATH_STATUS status = pathfinder->getPath(m_PathTicket, m_Path);
+
+    if(status != engine::EPS_PENDING)
+    {
+      m_PathTicket = 0;
+      m_PathIndex = 0;
+
+      if(status != engine::EPS_FOUND)
+      {
+        m_Path.clear();
+        m_PlanDelay = BOT_REPLAN_DELAY;
+      }
+    }
+  }
+  else if(m_PathIndex >= m_Path.size())
+  {
+    m_PlanDelay -= Core->time.delta;
+
+    if(m_PlanDelay <= 0.f)
+      plan();
+  }
+
+  irr::core::vector3df position = body.PhysicsBody->getPosition();
+
+  irr::f32 waypointRadius = BOT_WAYPOINT_RADIUS;
+
+#ifdef PHYSICS_NEWTON
+  if(isDriving())
+    waypointRadius = BOT_VEHICLE_WAYPOINT_RADIUS;
+#endif
+
+  // Skip the waypoints already reached
+  while(m_PathIndex < m_Path.size()
+  && irr::core::vector2df(m_Path[m_PathIndex].X - position.X, m_Path[m_PathIndex].Z - position.Z).getLength() < waypointRadius)
+    ++m_PathIndex;
+
+#ifdef PHYSICS_NEWTON
+  // A free vehicle on the way is taken
+  if(m_PathTicket == 0 && m_PathIndex < m_Path.size() && !isDriving())
+    enterVehicle();
+
+  if(m_PathTicket == 0 && m_PathIndex < m_Path.size() && isDriving())
+  {
+    driveTo(m_Path[m_PathIndex]);
+
+    // The character rides along, it doesn't walk
+    return;
+  }
+  else if(isDriving())
+  {
+    // Arrived, or waiting for a path
+    leaveVehicle();
+  }
+#endif
+
+  if(m_PathTicket == 0 && m_PathIndex < m_Path.size())
+  {
+    irr::core::vector3df heading = m_Path[m_PathIndex] - position;
+    heading.Y = 0.f;
+
+    body.PhysicsBody->setRotation(irr::core::vector3df(0, heading.getHorizontalAngle().Y, 0));
+    body.Node->updateAbsolutePosition();
+
+    SCharacterClassParameters *c_class_params = Game->getCharacters()->cClassParameters[parameters.Class];
+
+    irr::core::vector3df dir(0,0,1);
+
+    engine::CBaseCharacter::checkForStairs(dir);
+
+    move(dir, c_class_params->move_speed);
+  }
+  else
+  {
+    parameters.States &= ~engine::ECS_MOVING;
+  }
+#endif
+
   engine::CBaseCharacter::update();
+}
+
+void CBot::followInput(const engine::SNetInput& input)
+{
+#ifdef PHYSICS_NEWTON
+  if(isDriving())
+    leaveVehicle();
+#endif
+
+  body.PhysicsBody->setRotation(irr::core::vector3df(0, input.Heading, 0));
+  body.Node->updateAbsolutePosition();
+
+  if(input.Jump)
+    jump();
+
+  irr::core::vector3df dir(input.Right, 0, input.Forward);
+
+  if(dir != irr::core::vector3df(0,0,0))
+  {
+    SCharacterClassParameters *c_class_params = Game->getCharacters()->cClassParameters[parameters.Class];
+
+    engine::CBaseCharacter::checkForStairs(dir);
+
+    move(dir, c_class_params->move_speed);
+  }
+  else
+  {
+    parameters.States &= ~engine::ECS_MOVING;
+  }
+}
+
+#ifdef PHYSICS_NEWTON
+void CBot::driveTo(const irr::core::vector3df& waypoint)
+{
+  irr::scene::ISceneNode *node = Core->getPhysics()->getVehicles()->getVehicle(getVehicle()).Node;
+
+  irr::core::matrix4 matrix;
+  matrix.setRotationDegrees(node->getRotation());
+
+  irr::core::vector2df front(matrix[8], matrix[10]);
+  irr::core::vector2df target(waypoint.X - node->getPosition().X, waypoint.Z - node->getPosition().Z);
+
+  // Angle from the front to the waypoint, positive to the right
+  irr::f32 angle = -atan2f(front.X * target.Y - front.Y * target.X, front.dotProduct(target)) * irr::core::RADTODEG;
+
+  irr::f32 throttle = fabsf(angle) < BOT_VEHICLE_SLOW_ANGLE ? 1.f : 0.3f;
 
+  // Full lock from 45 degrees off
+  drive(throttle, irr::core::clamp(angle / 45.f, -1.f, 1.f), false);
 }
+#endif
 
 void CBot::fire()
 {
@@ -0,0 +1,1325 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "Physics.h"
+#include "Breakables.h"
+#include "CDynamicMeshBuffer.h"
+
+#ifdef PHYSICS_NEWTON
+
+using namespace engine;
+using namespace engine::physics;
+
+const irr::u32 BREAKABLE_FILE_MAGIC = 0x52425746;
+
+// A triangle cut by the cells of a prop has 9 corners at most
+const irr::u32 BREAKABLE_POLYGON_MAX = 12;
+
+// Vertex of any irrlicht vertex type while the triangles are cut
+struct SCutVertex
+{
+  irr::video::S3DVertex Vertex;
+  irr::core::vector2df TCoords2;
+  irr::core::vector3df Tangent, Binormal;
+};
+
+struct SCutPolygon
+{
+  irr::u32 Vertices[BREAKABLE_POLYGON_MAX];
+  irr::u32 Count;
+};
+
+// Serialized hull of a piece, Newton reads it back a few bytes at a time
+struct SHullReader
+{
+  const irr::u8 *Data;
+  irr::u32 Size, Position;
+};
+
+static inline irr::f32 breakable_Axis(const irr::core::vector3df& v, irr::u32 axis)
+{
+  return axis == 0 ? v.X : (axis == 1 ? v.Y : v.Z);
+}
+
+static irr::u32 breakable_GetIndex(const irr::scene::IMeshBuffer *buffer, irr::u32 i)
+{
+  if(buffer->getIndexType() == irr::video::EIT_32BIT)
+    return ((const irr::u32*)buffer->getIndices())[i];
+
+  return buffer->getIndices()[i];
+}
+
+static SCutVertex breakable_GetVertex(const irr::scene::IMeshBuffer *buffer, irr::u32 index)
+{
+  SCutVertex v;
+
+  switch(buffer->getVertexType())
+  {
+    case irr::video::EVT_2TCOORDS:
+    {
+      const irr::video::S3DVertex2TCoords &vertex = ((const irr::video::S3DVertex2TCoords*)buffer->getVertices())[index];
+      v.Vertex = vertex;
+      v.TCoords2 = vertex.TCoords2;
+    }
+    break;
+
+    case irr::video::EVT_TANGENTS:
+    {
+      const irr::video::S3DVertexTangents &vertex = ((const irr::video::S3DVertexTangents*)buffer->getVertices())[index];
+      v.Vertex = vertex;
+      v.Tangent = vertex.Tangent;
+      v.Binormal = vertex.Binormal;
+    }
+    break;
+
+    default:
+      v.Vertex = ((const irr::video::S3DVertex*)buffer->getVertices())[index];
+    break;
+  }
+
+  return v;
+}
+
+static void breakable_SetVertex(irr::video::E_VERTEX_TYPE type, void *vertices, irr::u32 index, const SCutVertex& v)
+{
+  switch(type)
+  {
+    case irr::video::EVT_2TCOORDS:
+    {
+      irr::video::S3DVertex2TCoords &vertex = ((irr::video::S3DVertex2TCoords*)vertices)[index];
+      (irr::video::S3DVertex&)vertex = v.Vertex;
+      vertex.TCoords2 = v.TCoords2;
+    }
+    break;
+
+    case irr::video::EVT_TANGENTS:
+    {
+      irr::video::S3DVertexTangents &vertex = ((irr::video::S3DVertexTangents*)vertices)[index];
+      (irr::video::S3DVertex&)vertex = v.Vertex;
+      vertex.Tangent = v.Tangent;
+      vertex.Binormal = v.Binormal;
+    }
+    break;
+
+    default:
+      ((irr::video::S3DVertex*)vertices)[index] = v.Vertex;
+    break;
+  }
+}
+
+// Vertex where an edge crosses a cut, t from a to b
+static SCutVertex breakable_Lerp(const SCutVertex& a, const SCutVertex& b, irr::f32 t)
+{
+  SCutVertex v;
+
+  v.Vertex.Pos = a.Vertex.Pos + (b.Vertex.Pos - a.Vertex.Pos) * t;
+  v.Vertex.Normal = (a.Vertex.Normal + (b.Vertex.Normal - a.Vertex.Normal) * t).normalize();
+  v.Vertex.Color = b.Vertex.Color.getInterpolated(a.Vertex.Color, t);
+  v.Vertex.TCoords = a.Vertex.TCoords + (b.Vertex.TCoords - a.Vertex.TCoords) * t;
+  v.TCoords2 = a.TCoords2 + (b.TCoords2 - a.TCoords2) * t;
+  v.Tangent = a.Tangent + (b.Tangent - a.Tangent) * t;
+  v.Binormal = a.Binormal + (b.Binormal - a.Binormal) * t;
+
+  return v;
+}
+
+// Cut a convex polygon by the plane at the value on the axis. The corners on
+// the plane go to both sides, the new corners are shared by both.
+static void breakable_SplitPolygon(irr::core::array<SCutVertex>& vertices, const SCutPolygon& polygon,
+  irr::u32 axis, irr::f32 plane, SCutPolygon& below, SCutPolygon& above)
+{
+  below.Count = above.Count = 0;
+
+  for(irr::u32 i=0; i < polygon.Count; ++i)
+  {
+    irr::u32 a = polygon.Vertices[i];
+    irr::u32 b = polygon.Vertices[(i + 1) % polygon.Count];
+
+    irr::f32 da = breakable_Axis(vertices[a].Vertex.Pos, axis) - plane;
+    irr::f32 db = breakable_Axis(vertices[b].Vertex.Pos, axis) - plane;
+
+    if(da <= 0.f && below.Count < BREAKABLE_POLYGON_MAX)
+      below.Vertices[below.Count++] = a;
+
+    if(da >= 0.f && above.Count < BREAKABLE_POLYGON_MAX)
+      above.Vertices[above.Count++] = a;
+
+    if((da < 0.f && db > 0.f) || (da > 0.f && db < 0.f))
+    {
+      SCutVertex cut = breakable_Lerp(vertices[a], vertices[b], da / (da - db));
+      vertices.push_back(cut);
+
+      if(below.Count < BREAKABLE_POLYGON_MAX)
+        below.Vertices[below.Count++] = vertices.size() - 1;
+
+      if(above.Count < BREAKABLE_POLYGON_MAX)
+        above.Vertices[above.Count++] = vertices.size() - 1;
+    }
+  }
+}
+
+static void breakable_Serialize(void* serializeHandle, const void* buffer, int size)
+{
+  irr::core::array<irr::u8> *data = (irr::core::array<irr::u8>*)serializeHandle;
+
+  for(int i=0; i < size; ++i)
+    data->push_back(((const irr::u8*)buffer)[i]);
+}
+
+// Past the end of the data (a broken file) Newton reads zeros
+static void breakable_Deserialize(void* serializeHandle, void* buffer, int size)
+{
+  SHullReader *reader = (SHullReader*)serializeHandle;
+
+  irr::u32 count = irr::core::min_(irr::u32(size), reader->Size - reader->Position);
+
+  memcpy(buffer, reader->Data + reader->Position, count);
+  memset((irr::u8*)buffer + count, 0, size - count);
+
+  reader->Position += count;
+}
+
+// Debris bodies have no CBody, gravity is all they get
+static void breakable_ApplyForceAndTorqueCallback(const NewtonBody* newtonBody, float timestep, int threadIndex)
+{
+  irr::f32 mass, ixx, iyy, izz;
+  NewtonBodyGetMassMatrix(newtonBody, &mass, &ixx, &iyy, &izz);
+
+  irr::f32 force_array[3] = { 0.f, -9.8f * mass, 0.f };
+
+  NewtonBodySetForce(newtonBody, force_array);
+}
+
+// Massless with a null collision, the body costs nothing until it is used again
+static void breakable_ParkBody(const NewtonBody* newtonBody, const NewtonCollision* nullCollision)
+{
+  irr::f32 zero[3] = { 0.f, 0.f, 0.f };
+
+  NewtonBodySetCollision(newtonBody, nullCollision);
+  NewtonBodySetVelocity(newtonBody, zero);
+  NewtonBodySetOmega(newtonBody, zero);
+  NewtonBodySetMassMatrix(newtonBody, 0.f, 0.f, 0.f, 0.f);
+}
+
+// Massless with its hull, a piece at rest is in the way like static geometry
+static void breakable_RestBody(const NewtonBody* newtonBody)
+{
+  irr::f32 zero[3] = { 0.f, 0.f, 0.f };
+
+  NewtonBodySetVelocity(newtonBody, zero);
+  NewtonBodySetOmega(newtonBody, zero);
+  NewtonBodySetMassMatrix(newtonBody, 0.f, 0.f, 0.f, 0.f);
+}
+
+static bool breakable_IsResting(const NewtonBody* newtonBody)
+{
+  if(NewtonBodyGetSleepState(newtonBody))
+    return true;
+
+  irr::f32 velocity_array[3], omega_array[3];
+  NewtonBodyGetVelocity(newtonBody, velocity_array);
+  NewtonBodyGetOmega(newtonBody, omega_array);
+
+  irr::core::vector3df velocity(velocity_array[0], velocity_array[1], velocity_array[2]);
+  irr::core::vector3df omega(omega_array[0], omega_array[1], omega_array[2]);
+
+  return velocity.getLengthSQ() < (BREAKABLE_REST_SPEED * IrrToNewton) * (BREAKABLE_REST_SPEED * IrrToNewton)
+    && omega.getLengthSQ() < BREAKABLE_REST_OMEGA * BREAKABLE_REST_OMEGA;
+}
+
+CBreakableManager::CBreakableManager(CCore * core) : Core(core)
+{
+  m_NullCollision = (NewtonCollision*)NULL;
+  m_Simulated = m_Frozen = 0;
+}
+
+CBreakableManager::~CBreakableManager()
+{
+}
+
+CBody *CBreakableManager::addProp(irr::scene::IMeshSceneNode *node, irr::u32 bodyID)
+{
+  SBreakableProp prop;
+
+  prop.Node = node;
+  prop.Body = new CBody(bodyID, Core->getPhysics()->getPhysicsWorld()->getNewtonWorld());
+  prop.Remaining = (irr::scene::SMesh*)NULL;
+  prop.BrokenCount = 0;
+
+  prop.Body->setNode(node);
+  prop.Body->setMass(0.f);
+  prop.Body->setUserData(NULL);
+
+  m_Props.push_back(prop);
+
+  return prop.Body;
+}
+
+irr::u32 CBreakableManager::getChecksum()
+{
+  // FNV-1a over the props' vertices (rounded to centimeters) and triangle
+  // counts, and the settings the cells are cut with
+  irr::u32 hash = 2166136261u;
+
+  irr::s32 settings[2] = { irr::core::round32(BREAKABLE_PIECE_SIZE * 100.f), irr::s32(BREAKABLE_MAX_PIECES) };
+
+  for(irr::u32 k=0; k < 2; ++k)
+  {
+    hash ^= irr::u32(settings[k]);
+    hash *= 16777619u;
+  }
+
+  for(irr::u32 i=0; i < m_Props.size(); ++i)
+  {
+    irr::scene::IMesh *mesh = m_Props[i].Node->getMesh();
+
+    for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+    {
+      irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+
+      hash ^= buffer->getIndexCount();
+      hash *= 16777619u;
+
+      for(irr::u32 v=0; v < buffer->getVertexCount(); ++v)
+      {
+        const irr::core::vector3df &position = buffer->getPosition(v);
+
+        irr::s32 values[3] = {
+          irr::core::round32(position.X * 100.f),
+          irr::core::round32(position.Y * 100.f),
+          irr::core::round32(position.Z * 100.f) };
+
+        for(irr::u32 k=0; k < 3; ++k)
+        {
+          hash ^= irr::u32(values[k]);
+          hash *= 16777619u;
+        }
+      }
+    }
+  }
+
+  return hash ^ m_Props.size();
+}
+
+void CBreakableManager::build(const irr::io::path& file)
+{
+  if(m_Props.size() == 0)
+    return;
+
+  irr::u32 startTime = Core->getRenderer()->getTimer()->getRealTime();
+  irr::u32 checksum = getChecksum();
+
+  bool loaded = load(file, checksum);
+
+  if(!loaded)
+  {
+    for(irr::u32 i=0; i < m_Props.size(); ++i)
+      fracture(m_Props[i], i);
+
+    save(file, checksum);
+  }
+
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  if(!m_NullCollision)
+    m_NullCollision = NewtonCreateNull(world);
+
+  irr::u32 pieces = 0;
+
+  for(irr::u32 i=0; i < m_Props.size(); ++i)
+  {
+    SBreakableProp &prop = m_Props[i];
+
+    setupPieces(prop);
+
+    prop.Node->updateAbsolutePosition();
+
+    irr::core::matrix4 matrix = prop.Node->getAbsoluteTransformation();
+    matrix.setTranslation(matrix.getTranslation() * IrrToNewton);
+
+    NewtonBody *body = NewtonCreateBody(world, m_NullCollision, getMatrixPointer(matrix));
+    NewtonBodySetUserData(body, prop.Body);
+
+    prop.Body->setNewtonBody(body);
+
+    updateProp(prop);
+
+    pieces += prop.Pieces.size();
+  }
+
+  printf("Breakable props: %d props, %d pieces (%s in %d ms)\n",
+    m_Props.size(), pieces, loaded ? "loaded" : "cooked",
+    Core->getRenderer()->getTimer()->getRealTime() - startTime);
+}
+
+void CBreakableManager::fracture(SBreakableProp& prop, irr::u32 seed)
+{
+  irr::scene::IMesh *mesh = prop.Node->getMesh();
+
+  const irr::core::aabbox3df &box = mesh->getBoundingBox();
+  irr::core::vector3df extent = box.getExtent();
+
+  //
+  // Cells: as near to the piece size as the piece count allows
+  //
+
+  irr::u32 cells[3];
+  irr::f32 size = BREAKABLE_PIECE_SIZE;
+
+  while(true)
+  {
+    for(irr::u32 a=0; a < 3; ++a)
+      cells[a] = irr::u32(irr::core::max_(irr::core::ceil32(breakable_Axis(extent, a) / size), 1));
+
+    if(cells[0] * cells[1] * cells[2] <= BREAKABLE_MAX_PIECES)
+      break;
+
+    size *= 1.25f;
+  }
+
+  // The cuts are moved a bit, pieces of a regular grid look sawn
+  irr::core::array<irr::f32> planes[3];
+  irr::u32 random = seed * 1103515245u + 12345u;
+
+  for(irr::u32 a=0; a < 3; ++a)
+  {
+    for(irr::u32 k=1; k < cells[a]; ++k)
+    {
+      random = random * 1103515245u + 12345u;
+      irr::f32 jitter = (irr::f32((random >> 16) & 0x7FFF) / 32767.f - 0.5f) * 0.4f;
+
+      planes[a].push_back(breakable_Axis(box.MinEdge, a) + breakable_Axis(extent, a) * (irr::f32(k) + jitter) / irr::f32(cells[a]));
+    }
+  }
+
+  irr::u32 cellCount = cells[0] * cells[1] * cells[2];
+
+  // Triangles of the current buffer in each cell, piece of each cell
+  irr::core::array< irr::core::array<irr::u32> > cellTriangles;
+  irr::core::array<irr::s32> cellPieces, pieceCells;
+
+  for(irr::u32 c=0; c < cellCount; ++c)
+  {
+    cellTriangles.push_back(irr::core::array<irr::u32>());
+    cellPieces.push_back(-1);
+  }
+
+  irr::core::array<SCutVertex> vertices;
+  irr::core::array<SCutPolygon> polygons, cut;
+  irr::core::array<irr::s32> remap;
+
+  for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+  {
+    irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+    irr::video::E_VERTEX_TYPE vertexType = buffer->getVertexType();
+
+    vertices.set_used(0);
+
+    for(irr::u32 v=0; v < buffer->getVertexCount(); ++v)
+      vertices.push_back(breakable_GetVertex(buffer, v));
+
+    for(irr::u32 c=0; c < cellCount; ++c)
+      cellTriangles[c].set_used(0);
+
+    for(irr::u32 i=0; i + 2 < buffer->getIndexCount(); i += 3)
+    {
+      SCutPolygon triangle;
+      triangle.Count = 3;
+
+      for(irr::u32 k=0; k < 3; ++k)
+        triangle.Vertices[k] = breakable_GetIndex(buffer, i + k);
+
+      polygons.set_used(0);
+      polygons.push_back(triangle);
+
+      // Cut by every plane the polygons reach across
+      for(irr::u32 a=0; a < 3; ++a)
+      {
+        for(irr::u32 p=0; p < planes[a].size(); ++p)
+        {
+          cut.set_used(0);
+
+          for(irr::u32 j=0; j < polygons.size(); ++j)
+          {
+            const SCutPolygon &polygon = polygons[j];
+
+            irr::f32 low = breakable_Axis(vertices[polygon.Vertices[0]].Vertex.Pos, a), high = low;
+
+            for(irr::u32 k=1; k < polygon.Count; ++k)
+            {
+              irr::f32 value = breakable_Axis(vertices[polygon.Vertices[k]].Vertex.Pos, a);
+              low = irr::core::min_(low, value);
+              high = irr::core::max_(high, value);
+            }
+
+            if(high <= planes[a][p] || low >= planes[a][p])
+            {
+              cut.push_back(polygon);
+              continue;
+            }
+
+            SCutPolygon below, above;
+            breakable_SplitPolygon(vertices, polygon, a, planes[a][p], below, above);
+
+            if(below.Count >= 3)
+              cut.push_back(below);
+
+            if(above.Count >= 3)
+              cut.push_back(above);
+          }
+
+          polygons.swap(cut);
+        }
+      }
+
+      // Each polygon lies in one cell now, its triangle fan goes there
+      for(irr::u32 j=0; j < polygons.size(); ++j)
+      {
+        const SCutPolygon &polygon = polygons[j];
+
+        irr::core::vector3df center(0.f, 0.f, 0.f);
+
+        for(irr::u32 k=0; k < polygon.Count; ++k)
+          center += vertices[polygon.Vertices[k]].Vertex.Pos;
+
+        center /= irr::f32(polygon.Count);
+
+        irr::u32 cell[3];
+
+        for(irr::u32 a=0; a < 3; ++a)
+        {
+          cell[a] = 0;
+
+          while(cell[a] < planes[a].size() && breakable_Axis(center, a) > planes[a][cell[a]])
+            ++cell[a];
+        }
+
+        irr::core::array<irr::u32> &triangles = cellTriangles[cell[0] + cells[0] * (cell[1] + cells[1] * cell[2])];
+
+        for(irr::u32 k=1; k + 1 < polygon.Count; ++k)
+        {
+          triangles.push_back(polygon.Vertices[0]);
+          triangles.push_back(polygon.Vertices[k]);
+          triangles.push_back(polygon.Vertices[k+1]);
+        }
+      }
+    }
+
+    //
+    // A buffer of this buffer's type for every cell it reaches
+    //
+
+    for(irr::u32 c=0; c < cellCount; ++c)
+    {
+      const irr::core::array<irr::u32> &triangles = cellTriangles[c];
+
+      if(triangles.size() == 0)
+        continue;
+
+      if(cellPieces[c] < 0)
+      {
+        SBreakablePiece piece;
+
+        piece.Mesh = new irr::scene::SMesh();
+        piece.Hull = (NewtonCollision*)NULL;
+        piece.Mass = 0.f;
+        piece.Anchored = false;
+        piece.Hits = 0;
+        piece.Broken = false;
+
+        cellPieces[c] = prop.Pieces.size();
+        pieceCells.push_back(c);
+
+        prop.Pieces.push_back(piece);
+      }
+
+      SBreakablePiece &piece = prop.Pieces[cellPieces[c]];
+
+      remap.set_used(vertices.size());
+
+      for(irr::u32 v=0; v < remap.size(); ++v)
+        remap[v] = -1;
+
+      irr::u32 count = 0;
+
+      for(irr::u32 t=0; t < triangles.size(); ++t)
+      {
+        if(remap[triangles[t]] < 0)
+          remap[triangles[t]] = count++;
+      }
+
+      irr::scene::CDynamicMeshBuffer *pieceBuffer =
+        new irr::scene::CDynamicMeshBuffer(vertexType, irr::video::EIT_32BIT);
+
+      pieceBuffer->getVertexBuffer().set_used(count);
+      pieceBuffer->getIndexBuffer().reallocate(triangles.size());
+
+      for(irr::u32 v=0; v < remap.size(); ++v)
+      {
+        if(remap[v] >= 0)
+          breakable_SetVertex(vertexType, pieceBuffer->getVertexBuffer().getData(), remap[v], vertices[v]);
+      }
+
+      for(irr::u32 t=0; t < triangles.size(); ++t)
+        pieceBuffer->getIndexBuffer().push_back(remap[triangles[t]]);
+
+      pieceBuffer->recalculateBoundingBox();
+
+      piece.Mesh->addMeshBuffer(pieceBuffer);
+      piece.Buffers.push_back(b);
+
+      pieceBuffer->drop();
+    }
+  }
+
+  //
+  // Hulls, and how the pieces hold together: neighbouring cells stick to
+  // each other, the bottom cells to the ground
+  //
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    SBreakablePiece &piece = prop.Pieces[p];
+
+    piece.Mesh->recalculateBoundingBox();
+    piece.Center = piece.Mesh->getBoundingBox().getCenter();
+
+    irr::u32 cell = pieceCells[p];
+    irr::u32 x = cell % cells[0], y = (cell / cells[0]) % cells[1], z = cell / (cells[0] * cells[1]);
+
+    piece.Anchored = y == 0;
+
+    for(irr::u32 q=0; q < prop.Pieces.size(); ++q)
+    {
+      irr::u32 other = pieceCells[q];
+      irr::u32 ox = other % cells[0], oy = (other / cells[0]) % cells[1], oz = other / (cells[0] * cells[1]);
+
+      irr::u32 distance = (x > ox ? x - ox : ox - x) + (y > oy ? y - oy : oy - y) + (z > oz ? z - oz : oz - z);
+
+      if(distance == 1)
+        piece.Neighbours.push_back(q);
+    }
+
+    piece.Hull = createHull(piece);
+  }
+}
+
+NewtonCollision *CBreakableManager::createHull(const SBreakablePiece& piece)
+{
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  irr::core::array<irr::core::vector3df> points;
+  irr::core::vector3df normal(0.f, 0.f, 0.f);
+
+  for(irr::u32 b=0; b < piece.Mesh->getMeshBufferCount(); ++b)
+  {
+    irr::scene::IMeshBuffer *buffer = piece.Mesh->getMeshBuffer(b);
+
+    for(irr::u32 v=0; v < buffer->getVertexCount(); ++v)
+    {
+      points.push_back(buffer->getPosition(v) * IrrToNewton);
+      normal += buffer->getNormal(v);
+    }
+  }
+
+  NewtonCollision *hull = NewtonCreateConvexHull(world, points.size(), &points[0].X,
+    sizeof(irr::core::vector3df), 0.002f, 0, NULL);
+
+  if(hull)
+    return hull;
+
+  // The points lie in a plane (a single sided fence)
+  if(normal.getLengthSQ() < 0.000001f)
+    normal.set(0.f, 1.f, 0.f);
+
+  irr::core::vector3df offset = normal.normalize() * (BREAKABLE_MIN_THICKNESS * 0.5f * IrrToNewton);
+
+  irr::u32 count = points.size();
+
+  for(irr::u32 i=0; i < count; ++i)
+  {
+    points.push_back(points[i] - offset);
+    points[i] += offset;
+  }
+
+  hull = NewtonCreateConvexHull(world, points.size(), &points[0].X,
+    sizeof(irr::core::vector3df), 0.002f, 0, NULL);
+
+  if(hull)
+    return hull;
+
+  // Not even that (a sliver), a box around it
+  irr::core::aabbox3df box = piece.Mesh->getBoundingBox();
+  irr::core::vector3df extent = box.getExtent();
+
+  irr::core::matrix4 offsetMatrix;
+  offsetMatrix.setTranslation(box.getCenter() * IrrToNewton);
+
+  return NewtonCreateBox(world,
+    irr::core::max_(extent.X, BREAKABLE_MIN_THICKNESS) * IrrToNewton,
+    irr::core::max_(extent.Y, BREAKABLE_MIN_THICKNESS) * IrrToNewton,
+    irr::core::max_(extent.Z, BREAKABLE_MIN_THICKNESS) * IrrToNewton,
+    0, getMatrixPointer(offsetMatrix));
+}
+
+void CBreakableManager::setupPieces(SBreakableProp& prop)
+{
+  bool hardwareBuffers = Core->commandLineParameters.hasParam("-disable_vbo") == false;
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    SBreakablePiece &piece = prop.Pieces[p];
+
+    // The node's materials have the shaders applied
+    for(irr::u32 b=0; b < piece.Mesh->getMeshBufferCount(); ++b)
+    {
+      if(piece.Buffers[b] < prop.Node->getMaterialCount())
+        piece.Mesh->getMeshBuffer(b)->getMaterial() = prop.Node->getMaterial(piece.Buffers[b]);
+    }
+
+    if(hardwareBuffers)
+      piece.Mesh->setHardwareMappingHint(irr::scene::EHM_STATIC);
+
+    piece.Mass = irr::core::clamp(NewtonConvexCollisionCalculateVolume(piece.Hull) * BREAKABLE_DENSITY,
+      BREAKABLE_MIN_MASS, BREAKABLE_MAX_MASS);
+  }
+}
+
+bool CBreakableManager::load(const irr::io::path& file, irr::u32 checksum)
+{
+  irr::io::IFileSystem *fileSystem = Core->getRenderer()->getDevice()->getFileSystem();
+
+  if(!fileSystem->existFile(file))
+    return false;
+
+  irr::io::IReadFile *reader = fileSystem->createAndOpenFile(file);
+
+  if(!reader)
+    return false;
+
+  irr::u32 header[4] = {0, 0, 0, 0};
+  reader->read(header, sizeof(header));
+
+  // Cooked from other props or by another version
+  if(header[0] != BREAKABLE_FILE_MAGIC || header[1] != BREAKABLE_FILE_VERSION
+  || header[2] != checksum || header[3] != m_Props.size())
+  {
+    reader->drop();
+    return false;
+  }
+
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  bool ok = true;
+  irr::core::array<irr::u8> data;
+
+  for(irr::u32 i=0; i < m_Props.size() && ok; ++i)
+  {
+    SBreakableProp &prop = m_Props[i];
+    irr::scene::IMesh *mesh = prop.Node->getMesh();
+
+    irr::u32 pieces = 0;
+    ok = reader->read(&pieces, sizeof(pieces)) == sizeof(pieces);
+
+    for(irr::u32 p=0; p < pieces && ok; ++p)
+    {
+      SBreakablePiece piece;
+
+      piece.Mesh = new irr::scene::SMesh();
+      piece.Hull = (NewtonCollision*)NULL;
+      piece.Mass = 0.f;
+      piece.Hits = 0;
+      piece.Broken = false;
+
+      irr::u32 anchored = 0, neighbours = 0, buffers = 0;
+
+      ok = reader->read(&anchored, sizeof(anchored)) == sizeof(anchored)
+        && reader->read(&neighbours, sizeof(neighbours)) == sizeof(neighbours);
+
+      piece.Anchored = anchored != 0;
+
+      for(irr::u32 n=0; n < neighbours && ok; ++n)
+      {
+        irr::u32 neighbour;
+
+        ok = reader->read(&neighbour, sizeof(neighbour)) == sizeof(neighbour)
+          && neighbour < pieces;
+
+        piece.Neighbours.push_back(neighbour);
+      }
+
+      ok = ok && reader->read(&buffers, sizeof(buffers)) == sizeof(buffers);
+
+      for(irr::u32 b=0; b < buffers && ok; ++b)
+      {
+        irr::u32 bufferHeader[3] = {0, 0, 0};
+
+        // Buffer of the prop, vertex and index count
+        ok = reader->read(bufferHeader, sizeof(bufferHeader)) == sizeof(bufferHeader)
+          && bufferHeader[0] < mesh->getMeshBufferCount();
+
+        if(!ok)
+          break;
+
+        irr::video::E_VERTEX_TYPE vertexType = mesh->getMeshBuffer(bufferHeader[0])->getVertexType();
+
+        irr::scene::CDynamicMeshBuffer *pieceBuffer =
+          new irr::scene::CDynamicMeshBuffer(vertexType, irr::video::EIT_32BIT);
+
+        pieceBuffer->getVertexBuffer().set_used(bufferHeader[1]);
+        pieceBuffer->getIndexBuffer().set_used(bufferHeader[2]);
+
+        irr::s32 vertexBytes = irr::s32(bufferHeader[1] * pieceBuffer->getVertexBuffer().stride());
+        irr::s32 indexBytes = irr::s32(bufferHeader[2] * sizeof(irr::u32));
+
+        ok = reader->read(pieceBuffer->getVertexBuffer().getData(), vertexBytes) == vertexBytes
+          && reader->read(pieceBuffer->getIndexBuffer().getData(), indexBytes) == indexBytes;
+
+        for(irr::u32 k=0; k < bufferHeader[2] && ok; ++k)
+          ok = pieceBuffer->getIndexBuffer()[k] < bufferHeader[1];
+
+        pieceBuffer->recalculateBoundingBox();
+
+        piece.Mesh->addMeshBuffer(pieceBuffer);
+        piece.Buffers.push_back(bufferHeader[0]);
+
+        pieceBuffer->drop();
+      }
+
+      irr::u32 hullSize = 0;
+
+      ok = ok && reader->read(&hullSize, sizeof(hullSize)) == sizeof(hullSize) && hullSize > 0;
+
+      if(ok)
+      {
+        data.set_used(hullSize);
+        ok = reader->read(data.pointer(), irr::s32(hullSize)) == irr::s32(hullSize);
+      }
+
+      if(ok)
+      {
+        SHullReader hullReader;
+        hullReader.Data = data.pointer();
+        hullReader.Size = hullSize;
+        hullReader.Position = 0;
+
+        piece.Hull = NewtonCreateCollisionFromSerialization(world, breakable_Deserialize, &hullReader);
+
+        ok = piece.Hull != NULL && hullReader.Position == hullSize;
+      }
+
+      piece.Mesh->recalculateBoundingBox();
+      piece.Center = piece.Mesh->getBoundingBox().getCenter();
+
+      prop.Pieces.push_back(piece);
+    }
+  }
+
+  reader->drop();
+
+  if(!ok)
+  {
+    printf("Breakable props: %s is broken, cooking again\n", file.c_str());
+
+    for(irr::u32 i=0; i < m_Props.size(); ++i)
+    {
+      for(irr::u32 p=0; p < m_Props[i].Pieces.size(); ++p)
+      {
+        m_Props[i].Pieces[p].Mesh->drop();
+
+        if(m_Props[i].Pieces[p].Hull)
+          NewtonReleaseCollision(world, m_Props[i].Pieces[p].Hull);
+      }
+
+      m_Props[i].Pieces.clear();
+    }
+  }
+
+  return ok;
+}
+
+void CBreakableManager::save(const irr::io::path& file, irr::u32 checksum)
+{
+  irr::io::IWriteFile *writer =
+    Core->getRenderer()->getDevice()->getFileSystem()->createAndWriteFile(file);
+
+  if(!writer)
+  {
+    printf("Breakable props: unable to write %s\n", file.c_str());
+    return;
+  }
+
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  irr::u32 header[4] = { BREAKABLE_FILE_MAGIC, BREAKABLE_FILE_VERSION, checksum, m_Props.size() };
+  writer->write(header, sizeof(header));
+
+  irr::core::array<irr::u8> data;
+
+  for(irr::u32 i=0; i < m_Props.size(); ++i)
+  {
+    const SBreakableProp &prop = m_Props[i];
+
+    irr::u32 pieces = prop.Pieces.size();
+    writer->write(&pieces, sizeof(pieces));
+
+    for(irr::u32 p=0; p < pieces; ++p)
+    {
+      const SBreakablePiece &piece = prop.Pieces[p];
+
+      irr::u32 anchored = piece.Anchored ? 1 : 0;
+      irr::u32 neighbours = piece.Neighbours.size();
+      irr::u32 buffers = piece.Mesh->getMeshBufferCount();
+
+      writer->write(&anchored, sizeof(anchored));
+      writer->write(&neighbours, sizeof(neighbours));
+
+      for(irr::u32 n=0; n < neighbours; ++n)
+        writer->write(&piece.Neighbours[n], sizeof(irr::u32));
+
+      writer->write(&buffers, sizeof(buffers));
+
+      for(irr::u32 b=0; b < buffers; ++b)
+      {
+        irr::scene::IMeshBuffer *buffer = piece.Mesh->getMeshBuffer(b);
+
+        irr::u32 bufferHeader[3] = { piece.Buffers[b], buffer->getVertexCount(), buffer->getIndexCount() };
+        writer->write(bufferHeader, sizeof(bufferHeader));
+
+        writer->write(buffer->getVertices(),
+          irr::s32(buffer->getVertexCount() * irr::video::getVertexPitchFromType(buffer->getVertexType())));
+        writer->write(buffer->getIndices(), irr::s32(buffer->getIndexCount() * sizeof(irr::u32)));
+      }
+
+      data.set_used(0);
+      NewtonCollisionSerialize(world, piece.Hull, breakable_Serialize, &data);
+
+      irr::u32 hullSize = data.size();
+      writer->write(&hullSize, sizeof(hullSize));
+      writer->write(data.pointer(), irr::s32(hullSize));
+    }
+  }
+
+  writer->drop();
+}
+
+void CBreakableManager::updateProp(SBreakableProp& prop)
+{
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  irr::core::array<NewtonCollision*> hulls;
+
+  // The static shadow of the prop changes with its mesh
+  if(prop.BrokenCount > 0)
+    Core->getRenderer()->getShadows()->invalidate(prop.Node->getTransformedBoundingBox());
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    if(!prop.Pieces[p].Broken)
+      hulls.push_back(prop.Pieces[p].Hull);
+  }
+
+  if(hulls.size() == 0)
+  {
+    NewtonBodySetCollision(prop.Body->getNewtonBody(), m_NullCollision);
+    prop.Node->setVisible(false);
+    return;
+  }
+
+  NewtonCollision *compound = NewtonCreateCompoundCollision(world, hulls.size(), hulls.pointer(), prop.Body->getShapeID());
+  NewtonBodySetCollision(prop.Body->getNewtonBody(), compound);
+  NewtonReleaseCollision(world, compound);
+
+  // The node draws its own mesh until a piece breaks off
+  if(prop.BrokenCount == 0)
+    return;
+
+  //
+  // Whole pieces merged back into a buffer per buffer of the prop
+  //
+
+  irr::core::array<irr::scene::CDynamicMeshBuffer*> merged;
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    const SBreakablePiece &piece = prop.Pieces[p];
+
+    if(piece.Broken)
+      continue;
+
+    for(irr::u32 b=0; b < piece.Mesh->getMeshBufferCount(); ++b)
+    {
+      irr::scene::IMeshBuffer *buffer = piece.Mesh->getMeshBuffer(b);
+      irr::u32 index = piece.Buffers[b];
+
+      while(merged.size() <= index)
+        merged.push_back((irr::scene::CDynamicMeshBuffer*)NULL);
+
+      if(!merged[index])
+      {
+        merged[index] = new irr::scene::CDynamicMeshBuffer(buffer->getVertexType(), irr::video::EIT_32BIT);
+        merged[index]->getMaterial() = buffer->getMaterial();
+      }
+
+      irr::scene::CDynamicMeshBuffer *target = merged[index];
+
+      irr::u32 first = target->getVertexCount();
+      irr::u32 stride = target->getVertexBuffer().stride();
+
+      target->getVertexBuffer().set_used(first + buffer->getVertexCount());
+      memcpy((irr::u8*)target->getVertexBuffer().getData() + first * stride,
+        buffer->getVertices(), buffer->getVertexCount() * stride);
+
+      const irr::u32 *indices = (const irr::u32*)buffer->getIndices();
+
+      for(irr::u32 i=0; i < buffer->getIndexCount(); ++i)
+        target->getIndexBuffer().push_back(first + indices[i]);
+    }
+  }
+
+  irr::scene::SMesh *remaining = new irr::scene::SMesh();
+
+  for(irr::u32 b=0; b < merged.size(); ++b)
+  {
+    if(!merged[b])
+      continue;
+
+    merged[b]->recalculateBoundingBox();
+    remaining->addMeshBuffer(merged[b]);
+    merged[b]->drop();
+  }
+
+  remaining->recalculateBoundingBox();
+
+  if(Core->commandLineParameters.hasParam("-disable_vbo") == false)
+    remaining->setHardwareMappingHint(irr::scene::EHM_STATIC);
+
+  prop.Node->setMesh(remaining);
+
+  if(prop.Remaining)
+    prop.Remaining->drop();
+
+  prop.Remaining = remaining;
+}
+
+bool CBreakableManager::hit(CBody *body, const irr::core::vector3df& position, const irr::core::vector3df& direction)
+{
+  // A few props per level, a search is cheaper than keeping a map
+  irr::s32 index = -1;
+
+  for(irr::u32 i=0; i < m_Props.size() && index < 0; ++i)
+  {
+    if(m_Props[i].Body == body)
+      index = irr::s32(i);
+  }
+
+  if(index < 0)
+    return false;
+
+  SBreakableProp &prop = m_Props[index];
+
+  if(prop.BrokenCount == prop.Pieces.size())
+    return true;
+
+  irr::core::matrix4 inverse;
+  prop.Node->getAbsoluteTransformation().getInverse(inverse);
+
+  irr::core::vector3df local = position;
+  inverse.transformVect(local);
+
+  // The nearest piece always takes the hit, the others in the radius too
+  irr::s32 nearest = -1;
+  irr::f32 nearestDistance = 0.f;
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    if(prop.Pieces[p].Broken)
+      continue;
+
+    irr::f32 distance = prop.Pieces[p].Center.getDistanceFrom(local);
+
+    if(nearest < 0 || distance < nearestDistance)
+    {
+      nearest = irr::s32(p);
+      nearestDistance = distance;
+    }
+  }
+
+  irr::core::array<irr::u32> knocked, fallen;
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    SBreakablePiece &piece = prop.Pieces[p];
+
+    if(piece.Broken)
+      continue;
+
+    if(irr::s32(p) != nearest && piece.Center.getDistanceFrom(local) > BREAKABLE_HIT_RADIUS)
+      continue;
+
+    if(++piece.Hits < BREAKABLE_PIECE_HITS)
+      continue;
+
+    piece.Broken = true;
+    knocked.push_back(p);
+  }
+
+  if(knocked.size() == 0)
+    return true;
+
+  // Whole pieces no longer connected to an anchored one fall down too
+  irr::core::array<bool> held;
+  irr::core::array<irr::u32> open;
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    bool anchored = !prop.Pieces[p].Broken && prop.Pieces[p].Anchored;
+
+    held.push_back(anchored);
+
+    if(anchored)
+      open.push_back(p);
+  }
+
+  while(open.size() > 0)
+  {
+    const SBreakablePiece &piece = prop.Pieces[open.getLast()];
+    open.erase(open.size() - 1);
+
+    for(irr::u32 n=0; n < piece.Neighbours.size(); ++n)
+    {
+      irr::u32 neighbour = piece.Neighbours[n];
+
+      if(!held[neighbour] && !prop.Pieces[neighbour].Broken)
+      {
+        held[neighbour] = true;
+        open.push_back(neighbour);
+      }
+    }
+  }
+
+  for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+  {
+    if(!held[p] && !prop.Pieces[p].Broken)
+    {
+      prop.Pieces[p].Broken = true;
+      fallen.push_back(p);
+    }
+  }
+
+  prop.BrokenCount += knocked.size() + fallen.size();
+
+  updateProp(prop);
+
+  irr::core::vector3df velocity = direction;
+  velocity.normalize();
+  velocity *= BREAKABLE_DEBRIS_SPEED;
+
+  for(irr::u32 i=0; i < knocked.size(); ++i)
+    spawnDebris(prop, knocked[i], velocity);
+
+  for(irr::u32 i=0; i < fallen.size(); ++i)
+    spawnDebris(prop, fallen[i], irr::core::vector3df(0.f, 0.f, 0.f));
+
+  return true;
+}
+
+void CBreakableManager::createPool()
+{
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+  irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+  if(!m_NullCollision)
+    m_NullCollision = NewtonCreateNull(world);
+
+  irr::core::matrix4 identity;
+
+  for(irr::u32 i=0; i < BREAKABLE_DEBRIS_POOL; ++i)
+  {
+    SDebris debris;
+
+    debris.Body = NewtonCreateBody(world, m_NullCollision, getMatrixPointer(identity));
+
+    NewtonBodySetUserData(debris.Body, NULL);
+    NewtonBodySetForceAndTorqueCallback(debris.Body, breakable_ApplyForceAndTorqueCallback);
+    NewtonBodySetAutoSleep(debris.Body, 1);
+
+    breakable_ParkBody(debris.Body, m_NullCollision);
+
+    // The piece meshes carry the prop's materials
+    debris.Node = sceneManager->addMeshSceneNode((irr::scene::IMesh*)NULL, 0, -1,
+      irr::core::vector3df(0.f, 0.f, 0.f), irr::core::vector3df(0.f, 0.f, 0.f),
+      irr::core::vector3df(1.f, 1.f, 1.f), true);
+
+    debris.Node->grab();
+    debris.Node->setReadOnlyMaterials(true);
+    debris.Node->setVisible(false);
+
+    debris.Age = debris.RestTime = 0.f;
+    debris.Used = debris.Frozen = false;
+
+    m_Pool.push_back(debris);
+  }
+}
+
+irr::u32 CBreakableManager::getFreeDebris()
+{
+  irr::u32 oldest = 0;
+
+  for(irr::u32 i=0; i < m_Pool.size(); ++i)
+  {
+    if(!m_Pool[i].Used)
+      return i;
+
+    if(m_Pool[i].Age > m_Pool[oldest].Age)
+      oldest = i;
+  }
+
+  cull(m_Pool[oldest]);
+
+  return oldest;
+}
+
+void CBreakableManager::spawnDebris(SBreakableProp& prop, irr::u32 piece, const irr::core::vector3df& velocity)
+{
+  if(m_Pool.size() == 0)
+    createPool();
+
+  SDebris &debris = m_Pool[getFreeDebris()];
+  const SBreakablePiece &source = prop.Pieces[piece];
+
+  // The hull and the mesh are in the prop's space, the body starts where the prop is
+  irr::core::matrix4 matrix = prop.Node->getAbsoluteTransformation();
+
+  debris.Node->setMesh(source.Mesh);
+  debris.Node->setPosition(matrix.getTranslation());
+  debris.Node->setRotation(matrix.getRotationDegrees());
+  debris.Node->setVisible(true);
+
+  matrix.setTranslation(matrix.getTranslation() * IrrToNewton);
+
+  NewtonBodySetCollision(debris.Body, source.Hull);
+  NewtonBodySetMatrix(debris.Body, getMatrixPointer(matrix));
+
+  irr::f32 inertia_array[3], origin_array[3];
+
+  NewtonConvexCollisionCalculateInertialMatrix(source.Hull, inertia_array, origin_array);
+  NewtonBodySetMassMatrix(debris.Body, source.Mass,
+    source.Mass * inertia_array[0], source.Mass * inertia_array[1], source.Mass * inertia_array[2]);
+  NewtonBodySetCentreOfMass(debris.Body, origin_array);
+
+  irr::f32 velocity_array[3], zero[3] = { 0.f, 0.f, 0.f };
+  fillVec3(velocity * IrrToNewton, velocity_array);
+
+  NewtonBodySetVelocity(debris.Body, velocity_array);
+  NewtonBodySetOmega(debris.Body, zero);
+  NewtonBodySetSleepState(debris.Body, 0);
+
+  debris.Age = debris.RestTime = 0.f;
+  debris.Used = true;
+  debris.Frozen = false;
+}
+
+void CBreakableManager::freeze(SDebris& debris)
+{
+  breakable_RestBody(debris.Body);
+
+  debris.Frozen = true;
+}
+
+void CBreakableManager::cull(SDebris& debris)
+{
+  breakable_ParkBody(debris.Body, m_NullCollision);
+
+  debris.Node->setVisible(false);
+  debris.Node->setMesh((irr::scene::IMesh*)NULL);
+
+  debris.Used = debris.Frozen = false;
+}
+
+void CBreakableManager::update(irr::f32 time)
+{
+  m_Simulated = m_Frozen = 0;
+
+  for(irr::u32 i=0; i < m_Pool.size(); ++i)
+  {
+    SDebris &debris = m_Pool[i];
+
+    if(!debris.Used)
+      continue;
+
+    debris.Age += time;
+
+    if(debris.Age >= BREAKABLE_DEBRIS_LIFETIME)
+    {
+      cull(debris);
+      continue;
+    }
+
+    if(debris.Frozen)
+    {
+      ++m_Frozen;
+      continue;
+    }
+
+    irr::core::matrix4 matrix;
+    NewtonBodyGetMatrix(debris.Body, getMatrixPointer(matrix));
+
+    debris.Node->setPosition(matrix.getTranslation() * NewtonToIrr);
+    debris.Node->setRotation(matrix.getRotationDegrees());
+
+    debris.RestTime = breakable_IsResting(debris.Body) ? debris.RestTime + time : 0.f;
+
+    // The piece stays where it came to rest, no longer simulated
+    if(debris.RestTime >= BREAKABLE_SETTLE_TIME || debris.Age >= BREAKABLE_MAX_TIME)
+    {
+      freeze(debris);
+      ++m_Frozen;
+    }
+    else
+      ++m_Simulated;
+  }
+}
+
+void CBreakableManager::clear()
+{
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  for(irr::u32 i=0; i < m_Pool.size(); ++i)
+  {
+    m_Pool[i].Node->remove();
+    m_Pool[i].Node->drop();
+
+    NewtonDestroyBody(world, m_Pool[i].Body);
+  }
+
+  m_Pool.clear();
+
+  for(irr::u32 i=0; i < m_Props.size(); ++i)
+  {
+    SBreakableProp &prop = m_Props[i];
+
+    prop.Body->removeBody();
+    delete prop.Body;
+
+    for(irr::u32 p=0; p < prop.Pieces.size(); ++p)
+    {
+      prop.Pieces[p].Mesh->drop();
+      NewtonReleaseCollision(world, prop.Pieces[p].Hull);
+    }
+
+    if(prop.Remaining)
+      prop.Remaining->drop();
+  }
+
+  m_Props.clear();
+
+  if(m_NullCollision)
+  {
+    NewtonReleaseCollision(world, m_NullCollision);
+    m_NullCollision = (NewtonCollision*)NULL;
+  }
+
+  m_Simulated = m_Frozen = 0;
+}
+
+#endif
@@ -35,7 +35,7 @@ void CCamera::reset()
 
   FPSViewObject = (irr::scene::IMeshSceneNode*) NULL;
 
-  headBobY = headBobX = objectBobY = objectBobX = shadowValue = shakeValue = shakeValueTarget = 0.f;
+  headBobY = headBobX = objectBobY = objectBobX = shakeValue = shakeValueTarget = 0.f;
 
   tilt = roll = 0.f;
 
@@ -90,6 +90,10 @@ void CCamera::setFPSViewObjectMesh(irr::scene::IMesh *mesh)
     if(texName.find("sight") != -1)
       FPSViewObject->getMaterial(materialId).MaterialType = irr::video::EMT_TRANSPARENT_ALPHA_CHANNEL;
 
+    // The shader finds the sun shadow in the cascades
+    if(Core->getRenderer()->getShadows()->isEnabled())
+      FPSViewObject->getMaterial(materialId).setTexture(SHADOW_TEXTURE_SLOT, Core->getRenderer()->getShadows()->getTexture());
+
   }
 
   FPSViewObject->setMaterialFlag(irr::video::EMF_BACK_FACE_CULLING, true);
@@ -295,8 +299,7 @@ void CCamera::setFollowedCharacter(CBaseCharacter* follow_char)
 
 irr::core::vector3df eyeHeight = EYE_HEIGHT_STANDING, targetEyeHeight;
 irr::f32 runningObjectTurnAngle = 0.f;
-irr::f32 checkForShadow = 0;
-bool eyeHeightReady = true, fpsCameraInShadow = false;
+bool eyeHeightReady = true;
 
 irr::f32 closeUpTransition = 0.f;
 
@@ -519,36 +522,6 @@ void CCamera::update(irr::f32 &time)
       // Update it
       node->updateAbsolutePosition();
 
-      // Run the check 10 times a second. Should be often enough ..
-      if(checkForShadow < 0.90f)
-      {
-        irr::core::vector3df sun = Core->getObjects()->parameters.sunPosition;
-
-        irr::core::line3df shadow_line = irr::core::line3df(cameraPosition, cameraPosition + sun);
-
- #ifdef PHYSICS_NEWTON
-        // Check if anything blocks the line between the camera position and the sun position
-        physics::SRayCastParameters params;
-        params.line = shadow_line;
-        params.excluded.push_back(cameraCharacter->getBody()->PhysicsBody->getShapeID());
-
-        physics::SRayCastResult result = Core->getPhysics()->getRayCollision(params);
-
-        fpsCameraInShadow = (result.body == NULL) ? false : true;
- #endif
-
-        checkForShadow = 1.0f;
-      }
-      else
-      {
-        checkForShadow -= 0.01f; //Core->Time.Delta;
-      }
-
-      if(fpsCameraInShadow)
-        shadowValue = fmin(shadowValue + time * 10, 1.0f);
-      else
-        shadowValue = fmax(shadowValue - time * 10, 0.0f);
-
       //
       // The view objects also moves
       //
@@ -137,14 +137,43 @@ CPlayer * CCharacterManager::createPlayer(engine::SCharacterCreationParameters p
 
 CBot * CCharacterManager::createBot(engine::SCharacterCreationParameters parameters)
 {
-  CBot *bot = new CBot(parameters);
+  CBot *bot = new CBot(Game, parameters);
 
+  irr::scene::ISceneManager *SceneManager = Game->getCore()->getRenderer()->getSceneManager();
+
+  //
+  // Create graphical node
+  //
+
+  bot->getBody()->Node = SceneManager->addAnimatedMeshSceneNode(
+    SceneManager->getMesh("data/chars/empty.b3d"),
+    0, -1);
+
+  bot->getBody()->Node->setScale(irr::core::vector3df(1,1,1));
+
+  //
+  // Create physical body
+  //
+
+#ifdef PHYSICS_NEWTON
+  bot->getBody()->PhysicsBody = Game->getCore()->getPhysics()->createCharacterBody(
+    bot->getBody()->Node);
+#endif
+
+  bot->rotationNode = SceneManager->addEmptySceneNode(bot->getBody()->Node, 0);
+  bot->rotationNode->setPosition(irr::core::vector3df(0,0,10));
 
   bots.push_back(bot);
 
   return bot;
 }
 
+void CCharacterManager::update()
+{
+  for(irr::u32 i=0; i < bots.size(); ++i)
+    bots[i]->update();
+}
+
 // Call this method to spawn a character at a random spawn point
 void CCharacterManager::spawn(engine::CBaseCharacter* spawned)
 {
@@ -12,6 +12,8 @@
 #include "Camera.h"
 #include "Atmosphere.h"
 #include "Clock.h"
+#include "Network.h"
+#include "Jobs.h"
 
 #include <GL/gl.h>
 #include <GL/glu.h>
@@ -20,6 +22,8 @@ using namespace engine;
 
 CCore::~CCore()
 {
+  delete LoopbackClient;
+  delete Network;
   delete Configuration;
   delete Renderer;
   delete Objects;
@@ -29,6 +33,9 @@ CCore::~CCore()
   delete SoundManager;
   delete AtmoManager;
   delete Timer;
+
+  // Last, the managers above wait for their jobs
+  delete Jobs;
 }
 
 
@@ -39,6 +46,18 @@ irr::u16 CCore::init()
 
   Configuration->deserialize();
 
+  // Run the simulation without a window (dedicated skirmish server, benchmarks)
+  b_Headless = commandLineParameters.hasParam("-headless");
+
+  // One worker per core besides this thread, it runs jobs while it waits for them
+  irr::u32 workers = CJobManager::getProcessorCount() - 1;
+
+  if(commandLineParameters.hasParam("-jobthreads"))
+    workers = atoi(commandLineParameters.getParamValue("-jobthreads").c_str());
+
+  Jobs = new CJobManager();
+  Jobs->start(workers);
+
   Renderer = new CRenderer(this);
   SoundManager = new CSoundManager(this);
 
@@ -55,8 +74,10 @@ irr::u16 CCore::init()
   Camera = new CCamera(this);
   Timer = new CTimer(this);
   Math = new CMaths();
+  Network = new CNetworkManager(this);
 
-  Camera->setMaterial(Renderer->getShaders()->createCameraViewObjectShader());
+  if(!b_Headless)
+    Camera->setMaterial(Renderer->getShaders()->createCameraViewObjectShader());
 
   bIsRunning = true;
   requestAppClose = false;
@@ -64,9 +85,43 @@ irr::u16 CCore::init()
   anaglyphCam = Renderer->getSceneManager()->addCameraSceneNode(0,irr::core::vector3df(50,50,-60), irr::core::vector3df(-70,30,-60), -1, false);
   anaglyphdist = -1.f;
 
+  initNetwork();
+
   return 0;
 }
 
+void CCore::initNetwork()
+{
+  irr::u16 port = NET_DEFAULT_PORT;
+
+  if(commandLineParameters.hasParam("-port"))
+    port = atoi(commandLineParameters.getParamValue("-port").c_str());
+
+  if(commandLineParameters.hasParam("-netrate"))
+    Network->setSendRate(atoi(commandLineParameters.getParamValue("-netrate").c_str()));
+
+  if(commandLineParameters.hasParam("-netradius"))
+    Network->setInterestRadius(atof(commandLineParameters.getParamValue("-netradius").c_str()));
+
+  if(commandLineParameters.hasParam("-loopback"))
+  {
+    // Server and client in the same process, for testing the replication
+    if(Network->startServer(port, true))
+    {
+      LoopbackClient = new CNetworkManager(this);
+      LoopbackClient->startClient("localhost", port, true);
+    }
+  }
+  else if(commandLineParameters.hasParam("-server"))
+  {
+    Network->startServer(port);
+  }
+  else if(commandLineParameters.hasParam("-connect"))
+  {
+    Network->startClient(commandLineParameters.getParamValue("-connect").c_str(), port);
+  }
+}
+
 irr::u8 showFPS = 2;
 irr::u32 debug_delta=0, debug_fps=0;
 irr::f32 update_debug=0;
@@ -99,6 +154,9 @@ void CCore::update()
   time.total = timeThisFrame;
   time.delta = (time.total - oldtime) / 1000.0f;
 
+  // Job counts of the last frame for the overlay
+  Jobs->update();
+
   /*if(getRenderer()->UpdateOcclusionMap(time.delta))
   {
     //return;
@@ -113,6 +171,36 @@ void CCore::update()
     Timer->update();
     Objects->update(time.delta);
   }
+
+  Network->update(time.delta);
+
+  if(LoopbackClient)
+    LoopbackClient->update(time.delta);
+}
+
+void CCore::simulate(irr::f32 tick)
+{
+  // Simulated clock, timers count ticks and not the wall clock
+  m_SimulatedTime += tick;
+
+  time.delta = tick;
+  time.total = irr::u32(m_SimulatedTime * 1000.0);
+
+  if(b_Paused == true)
+    return;
+
+  Timer->update();
+  Objects->update(time.delta);
+
+#ifdef PHYSICS_NEWTON
+  PhysicsManager->update2();
+#endif
+
+  // Snapshots carry the state at the end of the tick
+  Network->update(tick);
+
+  if(LoopbackClient)
+    LoopbackClient->update(tick);
 }
 
 void CCore::render()
@@ -127,6 +215,12 @@ void CCore::render()
     Camera->update(time.delta);
   Renderer->getCullingManager()->update(time.delta);
 
+  // Redraws the shadow cascades that changed, before the scene reads them
+  Renderer->getShadows()->update();
+
+  // Expires the transient lights (muzzle flashes)
+  Renderer->getLights()->update(time.delta);
+
 #define SET_APART 0.27f
   if (Camera->getNode()&&Configuration->getVideo()->Anaglyph) {
     Renderer->getVideoDriver()->getOverrideMaterial().Material.ColorMask=irr::video::ECP_RED;
@@ -169,13 +263,21 @@ void CCore::render()
     Camera->getNode()->setPosition(oldPos);
   }
   else {
+    // With dynamic lights the material shaders fill the G-buffer as they draw
+    bool lit = Renderer->getLights()->beginFrame();
+
     // Renders Irrlicht scene
     Renderer->getSceneManager()->drawAll();
+
+    if(lit)
+      Renderer->getLights()->endFrame();
   }
 }
 
 void CCore::finalizeUpdate()
 {
+  // All 2D drawing for this frame is done
+  Renderer->getSpriteBatcher()->endFrame();
 
   irr::scene::ICameraSceneNode *cam = Renderer->getSceneManager()->getActiveCamera();
 
@@ -222,6 +324,113 @@ void CCore::finalizeUpdate()
       fpsStr += " ";
       fpsStr += irr::s32(campos.Z);
 
+      fpsStr += "\nDraws: ";
+      fpsStr += Renderer->getVideoDriver()->getRenderStatistic(irr::video::ERS_DRAW_CALLS);
+      fpsStr += ", texture binds: ";
+      fpsStr += Renderer->getVideoDriver()->getRenderStatistic(irr::video::ERS_TEXTURE_BINDS);
+      fpsStr += ", shader binds: ";
+      fpsStr += Renderer->getVideoDriver()->getRenderStatistic(irr::video::ERS_SHADER_BINDS);
+      fpsStr += ", uploaded: ";
+      fpsStr += Renderer->getVideoDriver()->getRenderStatistic(irr::video::ERS_UPLOAD_BYTES) / 1024;
+      fpsStr += " KB";
+
+      fpsStr += "\nHUD draws: ";
+      fpsStr += Renderer->getSpriteBatcher()->getDrawCallCount();
+      fpsStr += " (";
+      fpsStr += Renderer->getSpriteBatcher()->getQuadCount();
+      fpsStr += " quads, ";
+      fpsStr += Renderer->getSpriteBatcher()->getAtlasCount();
+      fpsStr += " atlases)";
+
+      fpsStr += "\nCull: ";
+      fpsStr += Renderer->getCullingManager()->getVisibleNodes().size();
+      fpsStr += "/";
+      fpsStr += Renderer->getCullingManager()->getNodeCount();
+      fpsStr += " visible, ";
+      fpsStr += Renderer->getCullingManager()->getTestedCount();
+      fpsStr += " tested, ";
+      fpsStr += Renderer->getCullingManager()->getCullMicroseconds();
+      fpsStr += " us";
+
+      fpsStr += "\nInstances: ";
+      fpsStr += Renderer->getInstancingManager()->getVisibleCount();
+      fpsStr += "/";
+      fpsStr += Renderer->getInstancingManager()->getInstanceCount();
+      fpsStr += " visible, ";
+      fpsStr += Renderer->getInstancingManager()->getInstancedCount();
+      fpsStr += " copies instanced, ";
+      fpsStr += Renderer->getInstancingManager()->getDrawCallCount();
+      fpsStr += " draws";
+
+      fpsStr += "\nShadows: ";
+      fpsStr += Renderer->getShadows()->getRenderedCount();
+      fpsStr += "/";
+      fpsStr += Renderer->getShadows()->getCascadeCount();
+      fpsStr += " cascades drawn, ";
+      fpsStr += Renderer->getShadows()->getCasterDrawCount();
+      fpsStr += " caster draws";
+
+      fpsStr += "\nLights: ";
+      fpsStr += Renderer->getLights()->getVisibleCount();
+      fpsStr += "/";
+      fpsStr += Renderer->getLights()->getLightCount();
+      fpsStr += " on screen, ";
+      fpsStr += Renderer->getLights()->getLitTileCount();
+      fpsStr += " lit tiles";
+
+      fpsStr += "\nJobs: ";
+      fpsStr += Jobs->getJobCount();
+      fpsStr += " run, ";
+      fpsStr += Jobs->getStolenCount();
+      fpsStr += " stolen, ";
+      fpsStr += Jobs->getThreadCount();
+      fpsStr += " threads";
+
+#ifdef PHYSICS_NEWTON
+      fpsStr += "\nBodies: ";
+      fpsStr += PhysicsManager->getActiveBodyCount();
+      fpsStr += " active, ";
+      fpsStr += PhysicsManager->getSleepingBodyCount();
+      fpsStr += " sleeping, ";
+      fpsStr += PhysicsManager->getFrozenBodyCount();
+      fpsStr += " frozen";
+
+      fpsStr += "\nRagdolls: ";
+      fpsStr += PhysicsManager->getRagdolls()->getSimulatedCount();
+      fpsStr += " simulated, ";
+      fpsStr += PhysicsManager->getRagdolls()->getCorpseCount();
+      fpsStr += " corpses";
+
+      fpsStr += "\nDebris: ";
+      fpsStr += PhysicsManager->getBreakables()->getSimulatedCount();
+      fpsStr += " simulated, ";
+      fpsStr += PhysicsManager->getBreakables()->getFrozenCount();
+      fpsStr += " frozen";
+
+      fpsStr += "\nRounds: ";
+      fpsStr += PhysicsManager->getProjectiles()->getRoundCount();
+      fpsStr += " in flight, ";
+      fpsStr += PhysicsManager->getProjectiles()->getHitCount();
+      fpsStr += " hits";
+
+      fpsStr += "\nVehicles: ";
+      fpsStr += PhysicsManager->getVehicles()->getDrivingCount();
+      fpsStr += " driving, ";
+      fpsStr += PhysicsManager->getVehicles()->getParkedCount();
+      fpsStr += " parked";
+#endif
+
+      if(Network->getRole() != ENR_NONE)
+      {
+        fpsStr += "\nNet: ";
+        fpsStr += Network->getStats().BytesSent;
+        fpsStr += " B/s out, ";
+        fpsStr += Network->getStats().BytesReceived;
+        fpsStr += " B/s in, ";
+        fpsStr += Network->getStats().SerializeMicroseconds + Network->getStats().DeserializeMicroseconds;
+        fpsStr += " us/s serialize";
+      }
+
       if(showFPS == 2)
       {
         irr::u32 totalRAM=0,availRAM=0;
@@ -0,0 +1,633 @@
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/time.h>
+#endif
+
+#include "Core.h"
+#include "Renderer.h"
+#include "Culling.h"
+#include "Jobs.h"
+
+#ifdef CULLING_SSE
+  #include <xmmintrin.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace engine;
+
+static void cullJob(void *data, irr::u32 thread)
+{
+  SCullJob *job = (SCullJob*)data;
+
+  job->Manager->testJob(job);
+}
+
+static irr::u32 getMicroseconds()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+
+  return irr::u32((counter.QuadPart * 1000000) / frequency.QuadPart);
+#else
+  timeval tv;
+  gettimeofday(&tv, 0);
+
+  return irr::u32(tv.tv_sec * 1000000 + tv.tv_usec);
+#endif
+}
+
+/*
+  Scene node standing in for all managed nodes. Culls when the scene
+  manager asks for registrations and only passes them to the visible nodes.
+*/
+
+class CCullingProxySceneNode : public irr::scene::ISceneNode
+{
+public:
+
+  CCullingProxySceneNode(irr::scene::ISceneNode *parent, irr::scene::ISceneManager *manager, CCullingManager *culling)
+    : irr::scene::ISceneNode(parent, manager, -1), Culling(culling)
+  {
+    setAutomaticCulling(irr::scene::EAC_OFF);
+  }
+
+  virtual void OnRegisterSceneNode()
+  {
+    if(!IsVisible)
+      return;
+
+    irr::scene::ICameraSceneNode *camera = SceneManager->getActiveCamera();
+
+    if(!camera)
+      return;
+
+    // The camera has been rendered already, its view area is up to date
+    Culling->cull(*camera->getViewFrustum());
+
+    const irr::core::array<irr::scene::ISceneNode*> &visible = Culling->getVisibleNodes();
+
+    for(irr::u32 i=0; i < visible.size(); ++i)
+      visible[i]->OnRegisterSceneNode();
+  }
+
+  virtual void OnAnimate(irr::u32 timeMs)
+  {
+    if(!IsVisible)
+      return;
+
+    // Static nodes keep the transformation they were added with
+    const irr::core::array<irr::scene::ISceneNode*> &dynamic = Culling->getDynamicNodes();
+
+    for(irr::u32 i=0; i < dynamic.size(); ++i)
+      dynamic[i]->OnAnimate(timeMs);
+  }
+
+  virtual void render() {}
+
+  virtual const irr::core::aabbox3d<irr::f32>& getBoundingBox() const { return Box; }
+
+private:
+
+  CCullingManager *Culling;
+
+  irr::core::aabbox3df Box;
+};
+
+/*
+  SCullBoxes
+*/
+
+void SCullBoxes::clear()
+{
+  CenterX.clear(); CenterY.clear(); CenterZ.clear();
+  ExtentX.clear(); ExtentY.clear(); ExtentZ.clear();
+
+  Count = 0;
+}
+
+void SCullBoxes::resize(irr::u32 count)
+{
+  irr::u32 padded = (count + 3) & ~3;
+
+  CenterX.set_used(padded); CenterY.set_used(padded); CenterZ.set_used(padded);
+  ExtentX.set_used(padded); ExtentY.set_used(padded); ExtentZ.set_used(padded);
+
+  // Padding boxes are far away and empty, they never pass
+  for(irr::u32 i=count; i < padded; ++i)
+  {
+    CenterX[i] = CenterY[i] = CenterZ[i] = 1e30f;
+    ExtentX[i] = ExtentY[i] = ExtentZ[i] = 0.f;
+  }
+
+  Count = count;
+}
+
+void SCullBoxes::set(irr::u32 index, const irr::core::aabbox3df& box)
+{
+  irr::core::vector3df center = box.getCenter();
+  irr::core::vector3df extent = box.getExtent() * 0.5f;
+
+  CenterX[index] = center.X; CenterY[index] = center.Y; CenterZ[index] = center.Z;
+  ExtentX[index] = extent.X; ExtentY[index] = extent.Y; ExtentZ[index] = extent.Z;
+}
+
+/*
+  CCullingManager
+*/
+
+CCullingManager::CCullingManager(CCore * core) : Core(core)
+{
+
+  m_Proxy = (irr::scene::ISceneNode*)NULL;
+
+  b_Dirty = false;
+
+  m_Tested = 0;
+  m_CullTime = 0;
+
+  // The box tests are split over every thread of the job manager
+  irr::u32 workers = Core->getJobs()->getWorkerCount();
+
+  if(Core->commandLineParameters.hasParam("-cullthreads"))
+    workers = irr::core::min_(workers, irr::u32(atoi(Core->commandLineParameters.getParamValue("-cullthreads").c_str())));
+
+  // Nothing is drawn without a window
+  if(Core->isHeadless())
+    workers = 0;
+
+  // Job 0 is tested on the render thread
+  for(irr::u32 i=0; i <= workers; ++i)
+  {
+    SCullJob *job = new SCullJob();
+    job->Manager = this;
+
+    m_Jobs.push_back(job);
+  }
+}
+
+CCullingManager::~CCullingManager()
+{
+  clear();
+
+  for(irr::u32 i=0; i < m_Jobs.size(); ++i)
+    delete m_Jobs[i];
+}
+
+void CCullingManager::update(irr::f32 time)
+{
+  if(b_Dirty)
+    build();
+}
+
+irr::scene::ISceneNode *CCullingManager::getProxy()
+{
+  if(!m_Proxy)
+  {
+    irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+    m_Proxy = new CCullingProxySceneNode(sceneManager->getRootSceneNode(), sceneManager, this);
+    m_Proxy->setName("CullingProxy");
+  }
+
+  return m_Proxy;
+}
+
+bool CCullingManager::addStaticNode(irr::scene::ISceneNode *node)
+{
+  irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+  if(!node || node->getParent() != sceneManager->getRootSceneNode() || node->getChildren().getSize() > 0)
+    return false;
+
+  // Animated nodes have to stay in the animation pass
+  if(node->getAnimators().getSize() > 0)
+    return addDynamicNode(node);
+
+  // The proxy sits at the origin, absolute transformations don't change
+  node->setParent(getProxy());
+  node->updateAbsolutePosition();
+  node->setAutomaticCulling(irr::scene::EAC_OFF);
+
+  m_StaticNodes.push_back(node);
+
+  b_Dirty = true;
+
+  return true;
+}
+
+bool CCullingManager::addDynamicNode(irr::scene::ISceneNode *node)
+{
+  irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+  if(!node || node->getParent() != sceneManager->getRootSceneNode() || node->getChildren().getSize() > 0)
+    return false;
+
+  node->setParent(getProxy());
+  node->setAutomaticCulling(irr::scene::EAC_OFF);
+
+  m_DynamicNodes.push_back(node);
+
+  return true;
+}
+
+void CCullingManager::clear()
+{
+  m_StaticNodes.clear();
+  m_DynamicNodes.clear();
+  m_StaticOrder.clear();
+  m_StaticBoxes.clear();
+  m_DynamicBoxes.clear();
+  m_BVH.clear();
+  m_Visible.clear();
+
+  b_Dirty = false;
+
+  if(m_Proxy)
+  {
+    m_Proxy->remove();
+    m_Proxy->drop();
+    m_Proxy = (irr::scene::ISceneNode*)NULL;
+  }
+}
+
+void CCullingManager::build()
+{
+  b_Dirty = false;
+
+  m_BVH.clear();
+  m_StaticOrder.clear();
+
+  if(m_StaticNodes.size() == 0)
+  {
+    m_StaticBoxes.clear();
+    return;
+  }
+
+  irr::core::array<irr::core::aabbox3df> boxes;
+  boxes.reallocate(m_StaticNodes.size());
+
+  for(irr::u32 i=0; i < m_StaticNodes.size(); ++i)
+  {
+    m_StaticNodes[i]->updateAbsolutePosition();
+    boxes.push_back(m_StaticNodes[i]->getTransformedBoundingBox());
+    m_StaticOrder.push_back(i);
+  }
+
+  SCullBVHNode root;
+  m_BVH.push_back(root);
+
+  buildNode(0, 0, boxes.size(), m_StaticOrder, boxes);
+
+  // Boxes in leaf order, so a leaf is one contiguous range
+  m_StaticBoxes.resize(boxes.size());
+
+  for(irr::u32 i=0; i < m_StaticOrder.size(); ++i)
+    m_StaticBoxes.set(i, boxes[m_StaticOrder[i]]);
+
+  printf("Culling: %d static nodes, %d BVH nodes\n", m_StaticNodes.size(), m_BVH.size());
+}
+
+irr::u32 CCullingManager::buildNode(irr::u32 nodeIndex, irr::u32 first, irr::u32 count,
+  irr::core::array<irr::u32>& order, const irr::core::array<irr::core::aabbox3df>& boxes)
+{
+  irr::core::aabbox3df box = boxes[order[first]];
+  irr::core::aabbox3df centers(box.getCenter());
+
+  for(irr::u32 i=first+1; i < first + count; ++i)
+  {
+    box.addInternalBox(boxes[order[i]]);
+    centers.addInternalPoint(boxes[order[i]].getCenter());
+  }
+
+  m_BVH[nodeIndex].Box = box;
+
+  if(count <= CULL_LEAF_SIZE)
+  {
+    m_BVH[nodeIndex].First = first;
+    m_BVH[nodeIndex].Count = count;
+
+    return nodeIndex;
+  }
+
+  // Split at the median of the longest axis of the centers
+  irr::core::vector3df size = centers.getExtent();
+  irr::u32 axis = 0;
+
+  if(size.Y > size.X && size.Y >= size.Z) axis = 1;
+  else if(size.Z > size.X && size.Z > size.Y) axis = 2;
+
+  irr::u32 half = count / 2;
+
+  // Selection sort would be quadratic, a simple quickselect on the axis
+  irr::u32 left = first, right = first + count - 1;
+  irr::u32 target = first + half;
+
+  while(left < right)
+  {
+    irr::core::vector3df pivotCenter = boxes[order[(left + right) / 2]].getCenter();
+    irr::f32 pivot = axis == 0 ? pivotCenter.X : (axis == 1 ? pivotCenter.Y : pivotCenter.Z);
+
+    irr::u32 i = left, j = right;
+
+    while(i <= j)
+    {
+      irr::core::vector3df ci = boxes[order[i]].getCenter();
+      irr::core::vector3df cj = boxes[order[j]].getCenter();
+
+      irr::f32 vi = axis == 0 ? ci.X : (axis == 1 ? ci.Y : ci.Z);
+      irr::f32 vj = axis == 0 ? cj.X : (axis == 1 ? cj.Y : cj.Z);
+
+      if(vi < pivot) { ++i; continue; }
+      if(vj > pivot) { if(j == 0) break; --j; continue; }
+
+      irr::u32 temp = order[i];
+      order[i] = order[j];
+      order[j] = temp;
+
+      ++i;
+      if(j == 0) break;
+      --j;
+    }
+
+    if(target <= j) right = j;
+    else if(target >= i) left = i;
+    else break;
+  }
+
+  irr::u32 children = m_BVH.size();
+
+  SCullBVHNode child;
+  m_BVH.push_back(child);
+  m_BVH.push_back(child);
+
+  m_BVH[nodeIndex].First = children;
+  m_BVH[nodeIndex].Count = 0;
+
+  buildNode(children, first, half, order, boxes);
+  buildNode(children + 1, first + half, count - half, order, boxes);
+
+  return nodeIndex;
+}
+
+void engine::testCullBoxes(const irr::f32 *planes, const SCullBoxes& boxes, irr::u32 first, irr::u32 count, irr::core::array<irr::u32>& out)
+{
+  const irr::u32 PLANES = irr::scene::SViewFrustum::VF_PLANE_COUNT;
+
+  irr::u32 end = first + count;
+
+#ifdef CULLING_SSE
+  // Four boxes at a time. A box is outside a plane when even its corner
+  // closest to the plane is in front of it: n.c + d - |n|.e > 0
+  irr::u32 start = first & ~3;
+
+  const __m128 signMask = _mm_set1_ps(-0.f);
+
+  for(irr::u32 i=start; i < end; i += 4)
+  {
+    __m128 cx = _mm_loadu_ps(&boxes.CenterX[i]);
+    __m128 cy = _mm_loadu_ps(&boxes.CenterY[i]);
+    __m128 cz = _mm_loadu_ps(&boxes.CenterZ[i]);
+    __m128 ex = _mm_loadu_ps(&boxes.ExtentX[i]);
+    __m128 ey = _mm_loadu_ps(&boxes.ExtentY[i]);
+    __m128 ez = _mm_loadu_ps(&boxes.ExtentZ[i]);
+
+    __m128 outside = _mm_setzero_ps();
+
+    for(irr::u32 p=0; p < PLANES; ++p)
+    {
+      __m128 nx = _mm_set1_ps(planes[p*4]);
+      __m128 ny = _mm_set1_ps(planes[p*4+1]);
+      __m128 nz = _mm_set1_ps(planes[p*4+2]);
+      __m128 d = _mm_set1_ps(planes[p*4+3]);
+
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), d));
+
+      __m128 radius = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+        _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+
+      outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+    }
+
+    int mask = _mm_movemask_ps(outside);
+
+    for(irr::u32 k=0; k < 4; ++k)
+    {
+      irr::u32 index = i + k;
+
+      if(index >= first && index < end && !(mask & (1 << k)))
+        out.push_back(index);
+    }
+  }
+#else
+  for(irr::u32 i=first; i < end; ++i)
+  {
+    bool outside = false;
+
+    for(irr::u32 p=0; p < PLANES && !outside; ++p)
+    {
+      const irr::f32 *plane = &planes[p*4];
+
+      irr::f32 distance = plane[0] * boxes.CenterX[i] + plane[1] * boxes.CenterY[i] + plane[2] * boxes.CenterZ[i] + plane[3];
+      irr::f32 radius = fabsf(plane[0]) * boxes.ExtentX[i] + fabsf(plane[1]) * boxes.ExtentY[i] + fabsf(plane[2]) * boxes.ExtentZ[i];
+
+      outside = distance - radius > 0.f;
+    }
+
+    if(!outside)
+      out.push_back(i);
+  }
+#endif
+}
+
+void engine::getCullPlanes(const irr::scene::SViewFrustum& frustum, irr::f32 *planes)
+{
+  for(irr::u32 p=0; p < irr::scene::SViewFrustum::VF_PLANE_COUNT; ++p)
+  {
+    planes[p*4] = frustum.planes[p].Normal.X;
+    planes[p*4+1] = frustum.planes[p].Normal.Y;
+    planes[p*4+2] = frustum.planes[p].Normal.Z;
+    planes[p*4+3] = frustum.planes[p].D;
+  }
+}
+
+void CCullingManager::testRange(const SCullBoxes& boxes, irr::u32 first, irr::u32 count, irr::core::array<irr::u32>& out)
+{
+  testCullBoxes(m_Planes, boxes, first, count, out);
+}
+
+void CCullingManager::cull(const irr::scene::SViewFrustum& frustum)
+{
+  const irr::u32 PLANES = irr::scene::SViewFrustum::VF_PLANE_COUNT;
+
+  irr::u32 start = getMicroseconds();
+
+  if(b_Dirty)
+    build();
+
+  getCullPlanes(frustum, m_Planes);
+
+  m_Visible.set_used(0);
+  m_StaticRanges.set_used(0);
+  m_Tested = 0;
+
+  /*
+    Walk the BVH. Nodes completely inside the frustum are accepted whole,
+    partially visible leaves are left for the box tests.
+  */
+
+  if(m_BVH.size() > 0)
+  {
+    irr::core::array<irr::u32> stack;
+    stack.push_back(0);
+
+    while(stack.size() > 0)
+    {
+      const SCullBVHNode &node = m_BVH[stack.getLast()];
+      stack.erase(stack.size() - 1);
+
+      irr::core::vector3df center = node.Box.getCenter();
+      irr::core::vector3df extent = node.Box.getExtent() * 0.5f;
+
+      bool outside = false, inside = true;
+
+      for(irr::u32 p=0; p < PLANES && !outside; ++p)
+      {
+        const irr::f32 *plane = &m_Planes[p*4];
+
+        irr::f32 distance = plane[0] * center.X + plane[1] * center.Y + plane[2] * center.Z + plane[3];
+        irr::f32 radius = fabsf(plane[0]) * extent.X + fabsf(plane[1]) * extent.Y + fabsf(plane[2]) * extent.Z;
+
+        if(distance - radius > 0.f)
+          outside = true;
+        else if(distance + radius > 0.f)
+          inside = false;
+      }
+
+      if(outside)
+        continue;
+
+      if(inside && node.Count == 0)
+      {
+        // Whole subtree, find its box range
+        const SCullBVHNode *first = &node, *last = &node;
+
+        while(first->Count == 0) first = &m_BVH[first->First];
+        while(last->Count == 0) last = &m_BVH[last->First + 1];
+
+        for(irr::u32 i=first->First; i < last->First + last->Count; ++i)
+          m_Visible.push_back(m_StaticNodes[m_StaticOrder[i]]);
+      }
+      else if(inside)
+      {
+        for(irr::u32 i=node.First; i < node.First + node.Count; ++i)
+          m_Visible.push_back(m_StaticNodes[m_StaticOrder[i]]);
+      }
+      else if(node.Count > 0)
+      {
+        SCullRange range;
+        range.First = node.First;
+        range.Count = node.Count;
+
+        m_StaticRanges.push_back(range);
+        m_Tested += node.Count;
+      }
+      else
+      {
+        stack.push_back(node.First + 1);
+        stack.push_back(node.First);
+      }
+    }
+  }
+
+  /*
+    Box tests of the partially visible leaves, spread over the workers
+    when there are enough of them
+  */
+
+  irr::u32 workers = m_Jobs.size() - 1;
+
+  if(workers > 0 && m_Tested >= CULL_PARALLEL_THRESHOLD)
+  {
+    irr::u32 perJob = m_Tested / (workers + 1) + 1;
+    irr::u32 job = 0, jobBoxes = 0;
+
+    for(irr::u32 i=0; i < m_Jobs.size(); ++i)
+    {
+      m_Jobs[i]->Ranges.set_used(0);
+      m_Jobs[i]->Results.set_used(0);
+    }
+
+    for(irr::u32 i=0; i < m_StaticRanges.size(); ++i)
+    {
+      m_Jobs[job]->Ranges.push_back(m_StaticRanges[i]);
+      jobBoxes += m_StaticRanges[i].Count;
+
+      if(jobBoxes >= perJob && job < workers)
+      {
+        ++job;
+        jobBoxes = 0;
+      }
+    }
+
+    // Job 0 is done here, idle threads take the rest
+    for(irr::u32 i=1; i <= job; ++i)
+      Core->getJobs()->submit(cullJob, m_Jobs[i], &m_JobCounter);
+
+    testJob(m_Jobs[0]);
+
+    Core->getJobs()->wait(&m_JobCounter);
+
+    for(irr::u32 j=0; j <= job; ++j)
+      for(irr::u32 i=0; i < m_Jobs[j]->Results.size(); ++i)
+        m_Visible.push_back(m_StaticNodes[m_StaticOrder[m_Jobs[j]->Results[i]]]);
+  }
+  else
+  {
+    irr::core::array<irr::u32> &passed = m_Jobs[0]->Results;
+    passed.set_used(0);
+
+    for(irr::u32 i=0; i < m_StaticRanges.size(); ++i)
+      testRange(m_StaticBoxes, m_StaticRanges[i].First, m_StaticRanges[i].Count, passed);
+
+    for(irr::u32 i=0; i < passed.size(); ++i)
+      m_Visible.push_back(m_StaticNodes[m_StaticOrder[passed[i]]]);
+  }
+
+  /*
+    Dynamic nodes register their current box
+  */
+
+  if(m_DynamicNodes.size() > 0)
+  {
+    m_DynamicBoxes.resize(m_DynamicNodes.size());
+
+    for(irr::u32 i=0; i < m_DynamicNodes.size(); ++i)
+      m_DynamicBoxes.set(i, m_DynamicNodes[i]->getTransformedBoundingBox());
+
+    irr::core::array<irr::u32> &passed = m_Jobs[0]->Results;
+    passed.set_used(0);
+
+    testRange(m_DynamicBoxes, 0, m_DynamicNodes.size(), passed);
+
+    for(irr::u32 i=0; i < passed.size(); ++i)
+      m_Visible.push_back(m_DynamicNodes[passed[i]]);
+
+    m_Tested += m_DynamicNodes.size();
+  }
+
+  m_CullTime = getMicroseconds() - start;
+}
+
+void CCullingManager::testJob(SCullJob *job)
+{
+  for(irr::u32 i=0; i < job->Ranges.size(); ++i)
+    testRange(m_StaticBoxes, job->Ranges[i].First, job->Ranges[i].Count, job->Results);
+}
@@ -4,6 +4,8 @@
 #include "SoundManager.h"
 #include "newton/Body.h"
 
+#include <math.h>
+
 using namespace engine;
 using namespace engine::physics;
 
@@ -59,63 +61,46 @@ void CDoor::update()
 {
   if(b_Automatic)
   {
-    irr::f32 time = m_Core->time.delta;
-
-    if(m_State == EDS_OPENING)
-    {
-      irr::core::vector3df pos1 = a_Bodies[0]->getPosition();
-      irr::core::vector3df pos2 = a_Bodies[1]->getPosition();
-
-      if(pos1.Y < endPosition[0].Y)
-      {
-        pos1.Y += 5.f * time;
-
-        if(pos1.Y > endPosition[0].Y) {
-          pos1.Y = endPosition[0].Y;
-        }
+    if(m_State != EDS_OPENING && m_State != EDS_CLOSING)
+      return;
 
-        a_Bodies[0]->setPosition(pos1);
-      }
+    irr::f32 time = m_Core->time.delta;
 
-      if(pos2.Y > endPosition[1].Y)
-      {
-        pos2.Y -= 5.f * time;
+    irr::core::vector3df *target = (m_State == EDS_OPENING) ? endPosition : startPosition;
 
-        if(pos2.Y < endPosition[1].Y) {
-          pos2.Y = endPosition[1].Y;
-        }
+    bool moving = false;
 
-        a_Bodies[1]->setPosition(pos2);
-      }
-    }
-    else if(m_State == EDS_CLOSING)
+    // The leaves slide along Y at the same speed
+    for(irr::u32 i=0; i < a_Bodies.size() && i < 2; ++i)
     {
-      irr::core::vector3df pos1 = a_Bodies[0]->getPosition();
-      irr::core::vector3df pos2 = a_Bodies[1]->getPosition();
+      irr::core::vector3df position = a_Bodies[i]->getPosition();
 
-      if(pos1.Y > startPosition[0].Y)
+      // A leaf that arrived stops while the other one is still moving
+      if(position.Y == target[i].Y)
       {
-        pos1.Y -= 5.f * time;
-
-        if(pos1.Y < startPosition[0].Y) {
-          pos1.Y = startPosition[0].Y;
-        }
-
-        a_Bodies[0]->setPosition(pos1);
+        a_Bodies[i]->stopKinematic();
+        continue;
       }
 
-      if(pos2.Y < startPosition[1].Y)
-      {
-        pos2.Y += 5.f * time;
+      irr::f32 step = DOOR_SPEED * time;
 
-        if(pos2.Y > startPosition[1].Y) {
-          pos2.Y = startPosition[1].Y;
-        }
+      if(fabsf(target[i].Y - position.Y) <= step)
+        position.Y = target[i].Y;
+      else
+        position.Y += (target[i].Y > position.Y) ? step : -step;
 
-        a_Bodies[1]->setPosition(pos2);
-      }
+      a_Bodies[i]->moveKinematic(position, time);
+
+      moving = true;
     }
 
+    // Both leaves are in place, the bodies sleep until the door moves again
+    if(!moving)
+    {
+      m_State = (m_State == EDS_OPENING) ? EDS_OPENED : EDS_CLOSED;
 
+      for(irr::u32 i=0; i < a_Bodies.size(); ++i)
+        a_Bodies[i]->stopKinematic();
+    }
   }
 }
@@ -22,7 +22,10 @@ CGUI::CGUI(CGame*game, irr::core::dimension2d<irr::u16> screensize) : Game(game)
 {
   // Nullify pointers just to be on the safe side
   for(irr::u16 i=0; i<TEX_COUNT; ++i)
+  {
     textures[i] = (irr::video::ITexture*) NULL;
+    sprites[i] = -1;
+  }
 
   screenSize = screensize;
 
@@ -70,7 +73,8 @@ void CGUI::update()
 
 void CGUI::drawUI()
 {
-  irr::video::IVideoDriver* driver = Game->getCore()->getRenderer()->getVideoDriver();
+  // Everything on the HUD goes through the sprite batcher and is drawn as one layer
+  engine::CSpriteBatcher *batcher = Game->getCore()->getRenderer()->getSpriteBatcher();
 
   engine::CBaseCharacter *player = (engine::CBaseCharacter*)Game->getCharacters()->getPlayer();
   CInventory *inventory = (game::CInventory*)player->getInventory();
@@ -96,45 +100,43 @@ void CGUI::drawUI()
 
     if(crosshairObject.icons == 0)
     {
-      driver->draw2DImage(
-        textures[TEX_CROSSHAIR_FRIENDLY],
+      batcher->draw(
+        sprites[TEX_CROSSHAIR_FRIENDLY],
         targetPos2D,
         irr::core::rect<irr::s32>(0,0,32,32),
-        0,
-        SColor(225,255,255,255),
-        true);
+        SColor(225,255,255,255));
     }
     else
     {
       if(crosshairObject.icons & ECI_HAND)
-      driver->draw2DImage(
-        textures[TEX_HAND_ICON],
+      batcher->draw(
+        sprites[TEX_HAND_ICON],
         irr::core::position2d<irr::s32>(targetPos2D.X, targetPos2D.Y),
         irr::core::rect<irr::s32>(0,0,32,32),
-        0, irr::video::SColor(225, 255, 255, 255), true);
+        irr::video::SColor(225, 255, 255, 255));
     }
 
 
     if(crosshairObject.visible)
     {
-      fonts[1]->draw(
+      batcher->drawText(
+        fonts[1],
         crosshairObject.name,
         irr::core::rect<irr::s32>(targetPos2D.X+32, targetPos2D.Y+2, targetPos2D.X+200, targetPos2D.Y+30),
-        SColor(255,255,255,255),
-        false);
+        SColor(255,255,255,255));
 
       if(crosshairObject.showHealthbar)
       {
-        driver->draw2DImage(
-          textures[TEX_HEALTHBAR_BG],
+        batcher->draw(
+          sprites[TEX_HEALTHBAR_BG],
           irr::core::position2d<irr::s32>(targetPos2D.X+32, targetPos2D.Y+20),
-          irr::core::rect<irr::s32>(0,0,64,8), 0, irr::video::SColor(128, 255, 255, 255), true);
+          irr::core::rect<irr::s32>(0,0,64,8), irr::video::SColor(128, 255, 255, 255));
 
-        driver->draw2DImage(
-          textures[TEX_HEALTHBAR],
+        batcher->draw(
+          sprites[TEX_HEALTHBAR],
           irr::core::position2d<irr::s32>(targetPos2D.X+33, targetPos2D.Y+20),
           irr::core::rect<irr::s32>(0,0,irr::s32(60*crosshairObject.healthLevel),8),
-          0, irr::video::SColor(225, 255, 255, 255), true);
+          irr::video::SColor(225, 255, 255, 255));
       }
     }
   }
@@ -142,43 +144,39 @@ void CGUI::drawUI()
   centerX = screenSize.Width - 112;
 
   // Background credits and time
-  driver->draw2DImage(textures[TEX_HUD_BG_2],
+  batcher->draw(sprites[TEX_HUD_BG_2],
     irr::core::position2d<irr::s32>(centerX-128, 4),
-    irr::core::rect<irr::s32>(0,0,256,64), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,256,64), SColor(225,255,255,255));
 
   // Credit
-  driver->draw2DImage(
-    textures[TEX_CREDIT_ICON],
+  batcher->draw(
+    sprites[TEX_CREDIT_ICON],
     irr::core::position2d<irr::s32>(centerX-115, 6),
     irr::core::rect<irr::s32>(0,0,32,32),
-    0,
-    SColor(225,255,255,255),
-    true);
+    SColor(225,255,255,255));
 
   // Time
-  driver->draw2DImage(
-    textures[TEX_TIME_ICON],
+  batcher->draw(
+    sprites[TEX_TIME_ICON],
     irr::core::position2d<irr::s32>(centerX+78, 7),
     irr::core::rect<irr::s32>(0,0,32,32),
-    0,
-    SColor(225,255,255,255),
-    true);
+    SColor(225,255,255,255));
 
 
 
   irr::core::stringw creditStr = irr::core::stringw(player->getStats()->credit);
 
-  fonts[0]->draw(
+  batcher->drawText(
+    fonts[0],
     creditStr.c_str(),
     irr::core::rect<irr::s32>(centerX-74, 13, centerX-40, 30),
-    SColor(128,0,0,0),
-    false);
+    SColor(128,0,0,0));
 
-  fonts[0]->draw(
+  batcher->drawText(
+    fonts[0],
     creditStr.c_str(),
     irr::core::rect<irr::s32>(centerX-75, 12, centerX-40, 30),
-    SColor(255,255,255,255),
-    false);
+    SColor(255,255,255,255));
 
   irr::u32 timeLeft_H, timeLeft_M, timeLeft_S;
   irr::s16 timerXOffset = 0;
@@ -210,17 +208,17 @@ void CGUI::drawUI()
     timerXOffset = 10;
   }
 
-  fonts[0]->draw(
+  batcher->drawText(
+    fonts[0],
     timerStr.c_str(),
     irr::core::rect<irr::s32>(centerX+15+timerXOffset, 13, centerX+90, 30),
-    SColor(128,0,0,0),
-    false);
+    SColor(128,0,0,0));
 
-  fonts[0]->draw(
+  batcher->drawText(
+    fonts[0],
     timerStr.c_str(),
     irr::core::rect<irr::s32>(centerX+16+timerXOffset, 12, centerX+90, 30),
-    SColor(255,255,255,255),
-    false);
+    SColor(255,255,255,255));
 
   // Time
   //wchar_t timeStr[8];
@@ -254,42 +252,42 @@ void CGUI::drawUI()
   }
 
   // Background for ammo
-  driver->draw2DImage(textures[TEX_HUD_BG],
+  batcher->draw(sprites[TEX_HUD_BG],
     irr::core::position2d<irr::s32>(screenSize.Width-135, screenSize.Height-50),
-    irr::core::rect<irr::s32>(0,0,256,64), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,256,64), SColor(225,255,255,255));
 
   // Background for player health
-  driver->draw2DImage(textures[TEX_HUD_BG_VERTICAL],
+  batcher->draw(sprites[TEX_HUD_BG_VERTICAL],
     irr::core::position2d<irr::s32>(5, screenSize.Height-160),
-    irr::core::rect<irr::s32>(0,0,44,256), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,44,256), SColor(225,255,255,255));
 
   // Background for player stamina
-  driver->draw2DImage(textures[TEX_HUD_BG_VERTICAL],
+  batcher->draw(sprites[TEX_HUD_BG_VERTICAL],
     irr::core::position2d<irr::s32>(47, screenSize.Height-140),
-    irr::core::rect<irr::s32>(0,0,44,256), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,44,256), SColor(225,255,255,255));
 
 
 
 
   // Ammo
-  driver->draw2DImage(textures[TEX_AMMO_ICON],
+  batcher->draw(sprites[TEX_AMMO_ICON],
     irr::core::position2d<irr::s32>(screenSize.Width-130, screenSize.Height-45),
-    irr::core::rect<irr::s32>(0,0,32,32), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,32,32), SColor(225,255,255,255));
 
   // Clips
-  driver->draw2DImage(textures[TEX_CLIP_ICON],
+  batcher->draw(sprites[TEX_CLIP_ICON],
     irr::core::position2d<irr::s32>(screenSize.Width-28, screenSize.Height-45),
-    irr::core::rect<irr::s32>(0,0,32,32), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,32,32), SColor(225,255,255,255));
 
   // Health
-  driver->draw2DImage(textures[TEX_HEALTH_ICON],
+  batcher->draw(sprites[TEX_HEALTH_ICON],
     irr::core::position2d<irr::s32>(7, screenSize.Height-158),
-    irr::core::rect<irr::s32>(0,0,32,32), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,32,32), SColor(225,255,255,255));
 
   // Stamina
-  driver->draw2DImage(textures[TEX_STAMINA_ICON],
+  batcher->draw(sprites[TEX_STAMINA_ICON],
     irr::core::position2d<irr::s32>(48, screenSize.Height-137),
-    irr::core::rect<irr::s32>(0,0,32,32), 0, SColor(225,255,255,255), true);
+    irr::core::rect<irr::s32>(0,0,32,32), SColor(225,255,255,255));
 
   // Stamina-bar
   /*driver->draw2DImage(textures[TEX_STAMINA_BAR],
@@ -297,55 +295,60 @@ void CGUI::drawUI()
     irr::core::rect<irr::s32>(0,0,64,16), 0, SColor(225,255,255,255), true);*/
 
   // TEXT SHADOW
-  fonts[3]->draw(
+  batcher->drawText(
+    fonts[3],
     ammoInClip,
     irr::core::rect<irr::s32>(screenSize.Width-91,screenSize.Height-40,screenSize.Width-50,screenSize.Height),
-    SColor(128,0,0,0), false);
+    SColor(128,0,0,0));
 
-  fonts[3]->draw(
+  batcher->drawText(
+    fonts[3],
     ammoClipCount,
     irr::core::rect<irr::s32>(screenSize.Width-45,screenSize.Height-40,screenSize.Width,screenSize.Height),
-    SColor(128,0,0,0), false);
+    SColor(128,0,0,0));
 
   // TEXT FOREGROUND
-  fonts[3]->draw(
+  batcher->drawText(
+    fonts[3],
     ammoInClip,
     irr::core::rect<irr::s32>(screenSize.Width-92,screenSize.Height-41,screenSize.Width-50,screenSize.Height),
-    SColor(255,255,255,255), false);
+    SColor(255,255,255,255));
 
-  fonts[3]->draw(
+  batcher->drawText(
+    fonts[3],
     ammoClipCount,
     irr::core::rect<irr::s32>(screenSize.Width-46,screenSize.Height-41,screenSize.Width,screenSize.Height),
-    SColor(255,255,255,255), false);
+    SColor(255,255,255,255));
 
   //SCharacterClassParameters *player_class_params =
     //Game->cClassParameters[Game->getCharacters()->getPlayer()->getParameters()->Class];
 
   // Health background
-  driver->draw2DRectangle(
+  batcher->drawRectangle(
     irr::video::SColor(128, 8,8,8),
     irr::core::rect<irr::s32>(15, screenSize.Height-122, 31, screenSize.Height-6));
 
   // Health level
   irr::f32 health_ = player->getParameters()->Health / player->getParameters()->HealthMax;
 
-  driver->draw2DRectangle(
+  batcher->drawRectangle(
     irr::video::SColor(150, 170,130,135),
     irr::core::rect<irr::s32>(17, irr::s32(screenSize.Height-(120*health_)),29, screenSize.Height-8));
 
 
   // Stamina background
-  driver->draw2DRectangle(
+  batcher->drawRectangle(
     irr::video::SColor(128, 8,8,8),
     irr::core::rect<irr::s32>(57, screenSize.Height-98, 73, screenSize.Height-6));
 
   // Stamina level
   irr::f32 stamina_ = player->getParameters()->Stamina / player->getParameters()->StaminaMax;
 
-  driver->draw2DRectangle(
+  batcher->drawRectangle(
     irr::video::SColor(150, 130,130,180),
     irr::core::rect<irr::s32>(59, irr::s32(screenSize.Height-(96*stamina_)), 71, screenSize.Height-8));
 
+  batcher->flush();
 
 }
 
@@ -381,32 +384,50 @@ void CGUI::clear(bool close)
     }
 
     for(irr::u16 i=0; i<TEX_COUNT; ++i)
+    {
       if(textures[i])
         textures[i]->drop();
+
+      textures[i] = (irr::video::ITexture*) NULL;
+      sprites[i] = -1;
+    }
+
+    // Atlases of the HUD and the menu
+    Game->getCore()->getRenderer()->getSpriteBatcher()->clear();
   }
 }
 
 void CGUI::loadUITextures()
 {
   irr::video::IVideoDriver* driver = Game->getCore()->getRenderer()->getVideoDriver();
-
-  textures[TEX_CROSSHAIR_FRIENDLY] = driver->getTexture("data/2d/crosshair1.png");
-  textures[TEX_CROSSHAIR_ENEMY] = driver->getTexture("data/2d/crosshair0.png");
-  textures[TEX_TIME_ICON] = driver->getTexture("data/2d/icons/time.png");
-  textures[TEX_CREDIT_ICON] = driver->getTexture("data/2d/icons/credit.png");
-  textures[TEX_OVERLAY_BINOCULARS] = driver->getTexture("data/2d/binoculars.png");
-  textures[TEX_OVERLAY_SNIPER] = driver->getTexture("data/2d/sniperScope1.png");
-  textures[TEX_AMMO_ICON] = driver->getTexture("data/2d/icons/ammo2.png");
-  textures[TEX_CLIP_ICON] = driver->getTexture("data/2d/icons/clip.png");
-  textures[TEX_HEALTH_ICON] = driver->getTexture("data/2d/icons/health.png");
-  textures[TEX_STAMINA_ICON] = driver->getTexture("data/2d/icons/stamina.png");
-  textures[TEX_HUD_BG] = driver->getTexture("data/2d/hud_bg.png");
-  textures[TEX_HUD_BG_VERTICAL] = driver->getTexture("data/2d/hud_bg_vertical.png");
-  textures[TEX_HUD_BG_2] = driver->getTexture("data/2d/hud_bg_thinner.png");
-  textures[TEX_HEALTHBAR_BG] = driver->getTexture("data/2d/healthbarbg.png");
-  textures[TEX_HEALTHBAR] = driver->getTexture("data/2d/healthbar.png");
-  textures[TEX_HAND_ICON] = driver->getTexture("data/2d/icons/hand.png");
-  textures[TEX_TERMINAL_BACKGROUND] = driver->getTexture("data/2d/terminal/background.jpg");
+  engine::CSpriteBatcher *batcher = Game->getCore()->getRenderer()->getSpriteBatcher();
+
+  // Images drawn by the HUD and the terminal are packed into atlases
+  sprites[TEX_CROSSHAIR_FRIENDLY] = batcher->addSprite("data/2d/crosshair1.png");
+  sprites[TEX_CROSSHAIR_ENEMY] = batcher->addSprite("data/2d/crosshair0.png");
+  sprites[TEX_TIME_ICON] = batcher->addSprite("data/2d/icons/time.png");
+  sprites[TEX_CREDIT_ICON] = batcher->addSprite("data/2d/icons/credit.png");
+  sprites[TEX_OVERLAY_BINOCULARS] = batcher->addSprite("data/2d/binoculars.png");
+  sprites[TEX_OVERLAY_SNIPER] = batcher->addSprite("data/2d/sniperScope1.png");
+  sprites[TEX_AMMO_ICON] = batcher->addSprite("data/2d/icons/ammo2.png");
+  sprites[TEX_CLIP_ICON] = batcher->addSprite("data/2d/icons/clip.png");
+  sprites[TEX_HEALTH_ICON] = batcher->addSprite("data/2d/icons/health.png");
+  sprites[TEX_STAMINA_ICON] = batcher->addSprite("data/2d/icons/stamina.png");
+  sprites[TEX_HUD_BG] = batcher->addSprite("data/2d/hud_bg.png");
+  sprites[TEX_HUD_BG_VERTICAL] = batcher->addSprite("data/2d/hud_bg_vertical.png");
+  sprites[TEX_HUD_BG_2] = batcher->addSprite("data/2d/hud_bg_thinner.png");
+  sprites[TEX_HEALTHBAR_BG] = batcher->addSprite("data/2d/healthbarbg.png");
+  sprites[TEX_HEALTHBAR] = batcher->addSprite("data/2d/healthbar.png");
+  sprites[TEX_HAND_ICON] = batcher->addSprite("data/2d/icons/hand.png");
+  sprites[TEX_TERMINAL_BACKGROUND] = batcher->addSprite("data/2d/terminal/background.jpg");
+
+  // Text is drawn between the icons, its glyphs share their atlas
+  for(irr::u32 i=0; i < fonts.size(); ++i)
+    batcher->addFont(fonts[i]);
+
+  batcher->buildAtlases();
+
+  // Terminal buttons are GUI elements and need textures of their own
   textures[TEX_TERMINAL_EXIT_BUTTON] = driver->getTexture("data/2d/terminal/exit.png");
   textures[TEX_TERMINAL_REFILL_ICON] = driver->getTexture("data/2d/terminal/refill.png");
   textures[TEX_TERMINAL_CHANGE_TEAM_ICON] = driver->getTexture("data/2d/terminal/changeteam.png");
@@ -432,6 +453,10 @@ irr::video::ITexture* step6_pl = (irr::video::ITexture*)NULL;
 
 void CGUI::enableLoadingScreen(E_LOADING_SCREEN type, irr::u16 state)
 {
+  // Nothing is drawn in headless mode
+  if(Game->getCore()->isHeadless())
+    return;
+
   Game->getCore()->getRenderer()->getDevice()->run();
 
   // Unload any textures before loading new ones
@@ -6,6 +6,7 @@
 #include "Menu.h"
 #include "Terminal.h"
 #include "TracedWeapon.h"
+#include "ProjectileLauncher.h"
 #include "GameInput.h"
 
 #include "Renderer.h"
@@ -14,9 +15,12 @@
 #include "Camera.h"
 #include "ObjectManager.h"
 #include "Player.h"
+#include "Bot.h"
 #include "Maths.h"
 #include "Renderer.h"
 #include "Clock.h"
+#include "Network.h"
+#include "Physics.h"
 
 using namespace game;
 using namespace engine;
@@ -26,6 +30,15 @@ bool l_restoreWeaponAimAfterReloading = false;
 bool l_weaponArmSoundPlayed = false;
 bool l_playerRelatedUpdates;
 
+#ifdef PHYSICS_NEWTON
+//! Rounds of the projectile launchers hit like the traced bullets, but
+//! leave no decal (the bullet holes are sized for rifles)
+static void game_ProjectileHit(void *data, const engine::SProjectileHit& hit)
+{
+  ((CGame*)data)->createBulletHit(hit.Body, hit.Position, hit.Normal, hit.Velocity, false);
+}
+#endif
+
 CGame::CGame(engine::CCore * core)
 {
   wPlayer = (CWeapon*)NULL;
@@ -82,6 +95,10 @@ void CGame::init()
   // Init all systems
   irr::u32 initRes = Core->init();
 
+#ifdef PHYSICS_NEWTON
+  Core->getPhysics()->getProjectiles()->setHitCallback(game_ProjectileHit, this);
+#endif
+
   // All sub-systems keep a pointer of "this"
   // which is the main game class
 
@@ -101,17 +118,25 @@ void CGame::init()
   // so it can receive events
   Core->getRenderer()->getDevice()->setEventReceiver(Input);
 
-  // Show the main loading screen
-  GUI->enableLoadingScreen(game::ELS_STARTUP);
+  // Headless mode has no menus and no HUD, skip loading any 2D assets
+  if(!Core->isHeadless())
+  {
+    // Show the main loading screen
+    GUI->enableLoadingScreen(game::ELS_STARTUP);
 
-  GUI->getMenu()->playMusic(true, "data/sounds/music/theme.ogg");
+    GUI->getMenu()->playMusic(true, "data/sounds/music/theme.ogg");
+  }
 
 #ifdef ENGINE_DEVELOPMENT_MODE
   printf("Preloading stuff ... ");
 #endif
 
-  GUI->loadUITextures();
-  GUI->loadFonts();
+  if(!Core->isHeadless())
+  {
+    GUI->loadFonts();
+    GUI->loadUITextures();
+  }
+
   loadMiscSounds();
 
 #ifdef ENGINE_DEVELOPMENT_MODE
@@ -124,7 +149,8 @@ void CGame::init()
   Core->getRenderer()->getDevice()->getFileSystem()->addZipFileArchive("data/levels/g_m1.zip");
 
   // Check if user wants to go to skirmish mode directly
-  if(Core->commandLineParameters.hasParam("-skirmish"))
+  // (headless mode always starts a skirmish, there's no menu)
+  if(Core->commandLineParameters.hasParam("-skirmish") || Core->isHeadless())
   {
     SGameParameters gameParams;
     gameParams.Type = game::EGT_SKIRMISH_ANNIHILATION;
@@ -143,6 +169,9 @@ void CGame::init()
     if(Core->commandLineParameters.hasParam("-class"))
         gameParams.Class = atoi(Core->commandLineParameters.getParamValue("-class").c_str());
 
+    if(Core->commandLineParameters.hasParam("-bots"))
+        gameParams.Skirmish.BotCount = atoi(Core->commandLineParameters.getParamValue("-bots").c_str());
+
     gameParams.Level = Core->commandLineParameters.getParamValue("-level");
 
     start(gameParams);
@@ -189,6 +218,12 @@ void CGame::checkPlayerInteractions()
 
 void CGame::run()
 {
+  if(Core->isHeadless())
+  {
+    runHeadless();
+    return;
+  }
+
   // The main cycle which updates all aspects of the game
   while(Core->isRunning() == true)
   {
@@ -223,6 +258,154 @@ void CGame::run()
   }
 }
 
+void CGame::runHeadless()
+{
+  // Fixed simulation tick, the physics timestep is set to it
+  irr::u32 tickRate = 60;
+
+  if(Core->commandLineParameters.hasParam("-tickrate"))
+    tickRate = atoi(Core->commandLineParameters.getParamValue("-tickrate").c_str());
+
+  if(tickRate == 0)
+    tickRate = 60;
+
+  // 0 runs until the skirmish timer runs out (or forever without one)
+  irr::u32 maxTicks = 0;
+
+  if(Core->commandLineParameters.hasParam("-ticks"))
+    maxTicks = atoi(Core->commandLineParameters.getParamValue("-ticks").c_str());
+
+  // By default ticks are run back to back, as fast as the CPU allows.
+  // -realtime sleeps between ticks like a real server would.
+  bool realtime = Core->commandLineParameters.hasParam("-realtime");
+
+  irr::f32 tick = 1.f / irr::f32(tickRate);
+  irr::u32 tickMs = 1000 / tickRate;
+
+#ifdef PHYSICS_NEWTON
+  // Newton steps the bodies by the same tick
+  Core->getPhysics()->getPhysicsWorld()->setTimeStep(tick);
+#endif
+
+  irr::ITimer *timer = Core->getRenderer()->getTimer();
+
+  irr::u32 startTime = timer->getRealTime();
+  irr::u32 reportTime = startTime;
+  irr::u32 ticks = 0, ticksSinceReport = 0;
+
+  printf("Headless simulation: %d ticks/sec (%s)\n", tickRate, realtime ? "realtime" : "unlimited");
+
+  while(Core->isRunning() == true)
+  {
+    irr::u32 tickStart = timer->getRealTime();
+
+    // Irrlicht still needs its timer updated
+    Core->getRenderer()->getDevice()->run();
+
+    Core->simulate(tick);
+
+    characters->update();
+
+    ++ticks;
+    ++ticksSinceReport;
+
+    irr::u32 now = timer->getRealTime();
+
+    if(now - reportTime >= 1000)
+    {
+      irr::f32 seconds = (now - reportTime) / 1000.f;
+
+      printf("Ticks/sec: %.1f (%.2fx realtime, %.3f ms/tick, %d bodies)\n",
+        ticksSinceReport / seconds,
+        (ticksSinceReport * tick) / seconds,
+        (seconds * 1000.f) / ticksSinceReport,
+        Core->getPhysics()->getPhysicsWorld()->getBodyCount());
+
+      engine::CNetworkManager *network = Core->getNetwork();
+
+      if(network->getRole() == engine::ENR_SERVER)
+      {
+        const engine::SNetStats &stats = network->getStats();
+
+        printf("  Net: %d clients, %d B/s out (%d full, %d delta snapshots, %d entities, %d deferred), %d us serializing\n",
+          network->getClientCount(), stats.BytesSent, stats.FullSnapshots, stats.DeltaSnapshots,
+          stats.EntitiesSent, stats.EntitiesDeferred, stats.SerializeMicroseconds);
+      }
+
+      engine::CNetworkManager *client = Core->getLoopbackClient();
+
+      if(!client && network->getRole() == engine::ENR_CLIENT)
+        client = network;
+
+      if(client)
+      {
+        const engine::SNetStats &stats = client->getStats();
+
+        // How far the replicated bots are from the bots of the server, in the same process
+        irr::f32 error = 0.f;
+
+        if(client == Core->getLoopbackClient())
+        {
+          for(irr::u16 i=0; i < characters->getBotCount() && engine::NET_ID_BOTS + i < engine::NET_ID_BODIES; ++i)
+          {
+            const engine::SNetEntityState *state = client->getState(engine::NET_ID_BOTS + i);
+
+            if(!state)
+              continue;
+
+            irr::core::vector3df replicated(
+              state->Position[0] / engine::NET_POSITION_PRECISION,
+              state->Position[1] / engine::NET_POSITION_PRECISION,
+              state->Position[2] / engine::NET_POSITION_PRECISION);
+
+            error = irr::core::max_(error,
+              replicated.getDistanceFrom(characters->getBotByIndex(i)->getBody()->PhysicsBody->getPosition()));
+          }
+        }
+
+        printf("  Net client: snapshot %d, %d B/s in, %d B/s out, %d us deserializing, %.2f bot error\n",
+          client->getSequence(), stats.BytesReceived, stats.BytesSent, stats.DeserializeMicroseconds, error);
+      }
+
+      reportTime = now;
+      ticksSinceReport = 0;
+    }
+
+    if(maxTicks != 0 && ticks >= maxTicks)
+      Core->requestClose();
+
+    if(gameParameters.Type == EGT_SKIRMISH_ANNIHILATION
+    || gameParameters.Type == EGT_SKIRMISH_CAPTURE_FLAG)
+    {
+      irr::u32 timeLeft_H, timeLeft_M, timeLeft_S;
+
+      Core->getTimer()->getTimerValues(TIMER_SKIRMISH, timeLeft_H, timeLeft_M, timeLeft_S);
+
+      if(timeLeft_H == 0 && timeLeft_M == 0 && timeLeft_S == 0)
+        Core->requestClose();
+    }
+
+    // Same place the windowed loop closes the app
+    if(Core->isCloseRequested())
+      Core->close();
+
+    if(realtime)
+    {
+      irr::u32 spent = timer->getRealTime() - tickStart;
+
+      if(spent < tickMs)
+        Core->getRenderer()->getDevice()->sleep(tickMs - spent);
+    }
+  }
+
+  irr::u32 totalTime = timer->getRealTime() - startTime;
+
+  if(totalTime == 0)
+    totalTime = 1;
+
+  printf("Headless simulation finished: %d ticks in %.2f s (%.1f ticks/sec, %.2f simulated seconds)\n",
+    ticks, totalTime / 1000.f, ticks / (totalTime / 1000.f), ticks * tick);
+}
 
 void CGame::loadMiscModels()
 {
@@ -493,6 +676,10 @@ void CGame::loadExternalWeaponData()
           w->recoilForce = xml->getAttributeValueAsFloat("value");
         else if(!strcmp("firerange", xml->getNodeName()))
           w->fireRange = xml->getAttributeValueAsFloat("value");
+        else if(!strcmp("muzzlevelocity", xml->getNodeName()))
+          w->muzzleVelocity = xml->getAttributeValueAsFloat("value");
+        else if(!strcmp("drag", xml->getNodeName()))
+          w->drag = xml->getAttributeValueAsFloat("value");
         else if(!strcmp("mesh1", xml->getNodeName())) {
           w->f_mesh = irr::core::stringc(xml->getAttributeValue("value"));
 
@@ -637,6 +824,8 @@ SInventoryItem CGame::createInventoryWeapon(
 
   if(params.w_class == EWC_TRACED)
     weapon = new CTracedWeapon(this);
+  else if(params.w_class == EWC_PROJECTILE_LAUNCHER)
+    weapon = new CProjectileLauncher(this);
 
   weapon->setParams(params);
 
@@ -700,7 +889,19 @@ void CGame::start(SGameParameters gameParams)
     Core->getCamera()->setType(ECT_SPECTATOR);
   }
 
-  if(!Core->commandLineParameters.hasParam("-disable_characters"))
+  if(Core->isHeadless())
+  {
+    // No player in a dedicated simulation, bots of both teams play each other
+    for(irr::u32 i=0; i < gameParameters.Skirmish.BotCount; ++i)
+    {
+      SCharacterCreationParameters botParameters;
+      botParameters.TeamID = (i % 2 == 0) ? E_TEAM1 : E_TEAM2;
+      botParameters.Class = gameParameters.Class;
+
+      characters->createBot(botParameters);
+    }
+  }
+  else if(!Core->commandLineParameters.hasParam("-disable_characters"))
   {
     GUI->enableLoadingScreen(game::ELS_LOAD_LEVEL, 5);
 
@@ -749,11 +950,64 @@ void CGame::start(SGameParameters gameParams)
 
   GUI->getMenu()->playMusic(false);
   GUI->getTerminal()->reset();
-  Core->getSound()->playSound2D("data/sounds/vocal/welcome.ogg", false, 0.87f);
+  if(!Core->isHeadless())
+    Core->getSound()->playSound2D("data/sounds/vocal/welcome.ogg", false, 0.87f);
 
   if(characters->getPlayer())
     characters->spawn(characters->getPlayer());
 
+  for(irr::u16 i=0; i < characters->getBotCount(); ++i)
+    characters->spawn(characters->getBotByIndex(i));
+
+  // Replicated entities, under IDs the server and the clients agree on.
+  // The loopback client shares the process and the objects with its server,
+  // it registers replicas under the same IDs so it never writes to them.
+  engine::CNetworkManager *networks[2] = { Core->getNetwork(), Core->getLoopbackClient() };
+
+  for(irr::u32 n=0; n < 2; ++n)
+  {
+    engine::CNetworkManager *network = networks[n];
+
+    if(!network || network->getRole() == engine::ENR_NONE)
+      continue;
+
+    bool replicas = network == Core->getLoopbackClient();
+
+    network->clearEntities();
+
+    if(characters->getPlayer())
+    {
+      if(replicas)
+        network->addReplica(engine::NET_ID_PLAYER, engine::ENE_CHARACTER);
+      else
+        network->addCharacter(characters->getPlayer(), engine::NET_ID_PLAYER);
+    }
+
+    for(irr::u16 i=0; i < characters->getBotCount(); ++i)
+    {
+      if(engine::NET_ID_BOTS + i >= engine::NET_ID_BODIES)
+        break;
+
+      if(replicas)
+        network->addReplica(engine::NET_ID_BOTS + i, engine::ENE_CHARACTER);
+      else
+        network->addCharacter(characters->getBotByIndex(i), engine::NET_ID_BOTS + i);
+    }
+
+    for(irr::u32 i=0; i < Core->getObjects()->getDynamicObjectCount() && engine::NET_ID_BODIES + i < engine::NET_MAX_ENTITIES; ++i)
+    {
+      if(!Core->getObjects()->getDynamicObjectById(i)->getBody())
+        continue;
+
+      if(replicas)
+        network->addReplica(irr::u16(engine::NET_ID_BODIES + i), engine::ENE_BODY);
+      else
+        network->addBody(Core->getObjects()->getDynamicObjectById(i)->getBody(), irr::u16(engine::NET_ID_BODIES + i));
+    }
+
+    printf("Network: %d replicated entities\n", network->getEntityCount());
+  }
+
   GUI->disableLoadingScreen();
   GUI->init();
 
@@ -774,7 +1028,8 @@ void CGame::start(SGameParameters gameParams)
 
     printf("ok!\n");
 
-    characters->getPlayer()->getStats()->credit = gameParameters.Skirmish.StartCredit;
+    if(characters->getPlayer())
+      characters->getPlayer()->getStats()->credit = gameParameters.Skirmish.StartCredit;
   }
   else
   {
@@ -855,6 +1110,159 @@ void CGame::loadWeaponSounds()
   }
 }
 
+#ifdef PHYSICS_NEWTON
+void CGame::createBulletHit(
+  engine::physics::CBody *body,
+  irr::core::vector3df hitPosition,
+  irr::core::vector3df hitNormal,
+  const irr::core::vector3df& direction,
+  bool decal)
+{
+  SObjectData* bodyUserData = (SObjectData*)body->getUserData();
+
+  if(!bodyUserData)
+    return;
+
+  irr::scene::IMeshSceneNode *hitNode = (irr::scene::IMeshSceneNode *)body->getNode();
+
+  // What type of body was hit?
+  engine::CBaseMapObject *obj_ =
+    Core->getObjects()->getObject(bodyUserData->type, bodyUserData->container_id);
+
+  irr::core::matrix4 decal_matrix;
+
+  bool create_bullet_hole_decal = false;
+  irr::core::stringc bullet_debris_texture = "";
+  irr::f32 bullet_debris_scale = 1.f;
+  irr::f32 bullet_debris_velocity = 0.0010f;
+  irr::u32 bullet_debris_random_angle = 30;
+  irr::core::vector3df bullet_debris_position_offset;
+
+  if(bodyUserData->type == EOT_DYNAMIC)
+  {
+    //colOut.body->addImpulse(impulse, colOut.point);
+
+    create_bullet_hole_decal = true;
+  }
+  else if(bodyUserData->type == EOT_STATIC)
+  {
+    create_bullet_hole_decal = true;
+  }
+  else if(bodyUserData->type == EOT_BUILDING)
+  {
+    create_bullet_hole_decal = true;
+  }
+  else if(bodyUserData->type == EOT_TERRAIN)
+  {
+    bullet_debris_texture = "data/particles/debris/bh_dirt_piece.tga";
+    bullet_debris_scale = 1.58f;
+    bullet_debris_velocity = 0.0037f;
+    bullet_debris_random_angle = 27;
+    bullet_debris_position_offset.set(0.f, 0.30f, 0.f);
+  }
+  else if(bodyUserData->type == EOT_VEHICLE)
+  {
+    // Sparks only, a moving vehicle can't hold a decal
+    bullet_debris_texture = "data/particles/debris/bh_metal_fastpiece.tga";
+  }
+
+  // Breakable props lose pieces instead, their mesh is no batching mesh to put a decal on
+  if(Core->getPhysics()->getBreakables()->hit(body, hitPosition, direction))
+    create_bullet_hole_decal = false;
+
+  // Create bullet mark
+
+  if(decal && create_bullet_hole_decal)
+  {
+    irr::core::vector3df bullet_hole_position = hitPosition - hitNode->getPosition();
+
+    irr::core::stringc bullet_hole_texture = "";
+
+    switch(bodyUserData->material)
+    {
+      case EBMT_METAL:
+        bullet_hole_texture = "data/particles/decals/bullethole_metal.png";
+        bullet_debris_texture = "data/particles/debris/bh_metal_fastpiece.tga";
+      break;
+
+      case EBMT_STONE:
+        bullet_hole_texture = "data/particles/decals/bullethole_stone.png";
+        bullet_debris_texture = "data/particles/debris/stonechip.tga";
+      break;
+
+      case EBMT_WOOD:
+        bullet_hole_texture = "data/particles/decals/bullethole_wood.png";
+        bullet_debris_texture = "data/particles/debris/woodsplinters.tga";
+        bullet_debris_scale = 0.85f;
+      break;
+
+      case EBMT_SANDBAG:
+        bullet_hole_texture = "data/particles/decals/bullethole_sandbag.png";
+        bullet_debris_texture = "data/particles/debris/bh_wood_piece.tga";
+        bullet_debris_scale = 0.5f;
+      break;
+
+      default:
+        bullet_hole_texture = "data/particles/decals/bullethole_stone.png";
+        bullet_debris_texture = "data/particles/debris/stonechip.tga";
+      break;
+    }
+
+    if(obj_->isDecalAtPosition(bullet_hole_position, MINIMUM_DISTANCE_BETWEEN_BULLET_DECALS) == false)
+    {
+      irr::scene::IMeshBuffer* bullet_hole_decal =
+        Core->getRenderer()->getSceneManager()->getMesh("data/particles/decals/bullethole1.ms3d")->getMeshBuffer(0);
+
+      bullet_hole_decal->getMaterial().setTexture(0,
+        Core->getRenderer()->getVideoDriver()->getTexture(bullet_hole_texture.c_str()));
+      bullet_hole_decal->getMaterial().Lighting = false;
+      bullet_hole_decal->getMaterial().MaterialType = irr::video::EMT_TRANSPARENT_ALPHA_CHANNEL_REF ;
+      bullet_hole_decal->getMaterial().MaterialTypeParam = 0.20f;
+      bullet_hole_decal->getMaterial().FogEnable = true;
+
+      irr::core::matrix4 decal_rotation_matrix;
+      decal_rotation_matrix.setRotationDegrees(
+        irr::core::vector3df(0, irr::f32(Core->getMath()->getRandomInt(0,360)),0));
+
+      Core->getMath()->alignToUpVector(decal_matrix, decal_rotation_matrix, hitNormal, 1.0f);
+
+      irr::scene::CBatchingMesh* obj_mesh = (irr::scene::CBatchingMesh*)hitNode->getMesh();
+      Core->getObjects()->copyMaterialToMesh(obj_mesh, hitNode);
+
+      obj_mesh->addMeshBuffer(
+        bullet_hole_decal,
+        bullet_hole_position,
+        decal_matrix.getRotationDegrees(),
+        irr::core::vector3df(0.0019f,0.0019f,0.0019f));
+
+      obj_mesh->update();
+      hitNode->setMesh(obj_mesh);
+    }
+
+  }
+
+  if(bullet_debris_texture != "")
+  {
+    // Each particle has a slightly different size
+    bullet_debris_scale *= irr::f32(Core->getMath()->getRandomInt(750,1280)/1000.f);
+
+    createSurfaceHitParticles(
+      bullet_debris_texture.c_str(),
+      hitPosition + bullet_debris_position_offset,
+      hitNormal.normalize(),
+      bullet_debris_scale,
+      bullet_debris_velocity,
+      0.41f,
+      15, 20, bullet_debris_random_angle);
+  }
+
+  // Play hit sound based on body material
+  playSurfaceHitSound((game::E_BODY_MATERIAL_TYPE)bodyUserData->material, hitPosition);
+}
+#endif
+
+
+
 void CGame::createSurfaceHitParticles(
   const irr::c8* particle_texture_file,
   irr::core::vector3df position,
@@ -867,6 +1275,10 @@ void CGame::createSurfaceHitParticles(
   irr::u32 random_angle,
   irr::scene::ISceneNode *emitter_parent)
 {
+  // Purely visual
+  if(Core->isHeadless())
+    return;
+
   irr::u32 fade_time_in_ms = irr::u32(fade_time*1000);
 
   irr::scene::ISceneNodeAnimator* del =
@@ -2,6 +2,13 @@
 
 using namespace engine;
 
+static void grassJob(void *data, irr::u32 thread)
+{
+  SGrassJob *job = (SGrassJob*)data;
+
+  job->Node->buildPatch(job);
+}
+
 CGrassSceneNode::CGrassSceneNode(
   irr::scene::ISceneNode* parent,
   irr::scene::ISceneManager* mgr,
@@ -20,12 +27,17 @@ CGrassSceneNode::CGrassSceneNode(
   Box.addInternalPoint(irr::core::vector3df(-1000,100,-1000));
 
   b_DistCheckEnabled = true;
+
+  m_Jobs = (CJobManager*)NULL;
 }
 
 CGrassSceneNode::~CGrassSceneNode()
 {
   for(irr::u32 ref = 0; ref < m_ReferenceMeshes.size(); ++ref)
     m_ReferenceMeshes[ref]->drop();
+
+  for(irr::u32 i = 0; i < m_PatchJobs.size(); ++i)
+    delete m_PatchJobs[i];
 }
 
 void CGrassSceneNode::render()
@@ -38,8 +50,6 @@ void CGrassSceneNode::render()
   irr::core::vector3df cameraPos = SceneManager->getActiveCamera()->getPosition();
   irr::core::aabbox3df cameraBBox = SceneManager->getActiveCamera()->getViewFrustum()->boundingBox;
 
-  irr::u16 gDen = 8;
-
   irr::core::array<SFoilageGroup* > patches;
 
   patches.push_back(m_Patches[m_ClosestPatchIndex]);
@@ -61,47 +71,75 @@ void CGrassSceneNode::render()
   }
 
 #ifdef GRASS_2
-  for(irr::u32 patchIdx = 0; patchIdx < patches.size(); ++patchIdx)
-  for(irr::u32 elementIdx = 0; elementIdx < patches[patchIdx]->elements.size(); ++elementIdx)
+  m_CameraPosition = cameraPos;
+  m_CameraBox = cameraBBox;
+
+  // Every patch picks its visible elements in a job, the draws stay on this thread
+  while(m_PatchJobs.size() < patches.size())
   {
-    irr::u8 ref_type = 0; //m_Patches[patchIdx]->elements[elementIdx]->type;
+    SGrassJob *job = new SGrassJob();
+    job->Node = this;
 
-    irr::core::vector3df pos = patches[patchIdx]->elements[elementIdx]->position;
-    irr::core::vector3df rot = patches[patchIdx]->elements[elementIdx]->rotation;
-    irr::core::vector3df scale = patches[patchIdx]->elements[elementIdx]->scale;
+    m_PatchJobs.push_back(job);
+  }
 
-    if((elementIdx % gDen) != 0)
-      continue;
+  for(irr::u32 patchIdx = 0; patchIdx < patches.size(); ++patchIdx)
+  {
+    m_PatchJobs[patchIdx]->Patch = patches[patchIdx];
 
-    if(cameraBBox.isPointInside(pos) == false)
-      continue;
+    if(m_Jobs)
+      m_Jobs->submit(grassJob, m_PatchJobs[patchIdx], &m_JobCounter);
+    else
+      buildPatch(m_PatchJobs[patchIdx]);
+  }
 
-    if(b_DistCheckEnabled)
-    if(pos.getDistanceFrom(cameraPos) > 70)
-      continue;
+  if(m_Jobs)
+    m_Jobs->wait(&m_JobCounter);
 
-    irr::core::matrix4 trans;
-    //trans.setScale(scale);
-    trans.setTranslation(pos);
-    trans.setRotationDegrees(rot);
+  irr::u8 ref_type = 0; //m_Patches[patchIdx]->elements[elementIdx]->type;
 
-    driver->setTransform(irr::video::ETS_WORLD, trans);
+  for(irr::u32 patchIdx = 0; patchIdx < patches.size(); ++patchIdx)
+  for(irr::u32 t = 0; t < m_PatchJobs[patchIdx]->Transforms.size(); ++t)
+  {
+    driver->setTransform(irr::video::ETS_WORLD, m_PatchJobs[patchIdx]->Transforms[t]);
 
     //driver->setMaterial(m_ReferenceMeshes[ref_type]->getMeshBuffer(0)->getMaterial());
 
     for(irr::u32 mb = 0; mb < m_ReferenceMeshes[ref_type]->getMeshBufferCount(); ++mb)
       driver->drawMeshBuffer(m_ReferenceMeshes[ref_type]->getMeshBuffer(mb));
+  }
+#endif
+  //}
+}
 
-    /*driver->drawVertexPrimitiveList(
-      &Vertices[0], 4,
-      &indices[0], 4,
-      irr::video::EVT_STANDARD,
-      irr::scene::EPT_TRIANGLES,
-      irr::video::EIT_16BIT);*/
+void CGrassSceneNode::buildPatch(SGrassJob *job)
+{
+  job->Transforms.set_used(0);
 
+#ifdef GRASS_2
+  irr::u16 gDen = 8;
+
+  const irr::core::array<SFoilageGroupElement*> &elements = job->Patch->elements;
+
+  for(irr::u32 elementIdx = 0; elementIdx < elements.size(); elementIdx += gDen)
+  {
+    irr::core::vector3df pos = elements[elementIdx]->position;
+
+    if(m_CameraBox.isPointInside(pos) == false)
+      continue;
+
+    if(b_DistCheckEnabled)
+    if(pos.getDistanceFrom(m_CameraPosition) > 70)
+      continue;
+
+    irr::core::matrix4 trans;
+    //trans.setScale(elements[elementIdx]->scale);
+    trans.setTranslation(pos);
+    trans.setRotationDegrees(elements[elementIdx]->rotation);
+
+    job->Transforms.push_back(trans);
   }
 #endif
-  //}
 }
 
 void CGrassSceneNode::addReferenceMesh(const irr::c8 * meshfile)
@@ -0,0 +1,385 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "Instancing.h"
+
+#include <stdio.h>
+#include <math.h>
+
+using namespace engine;
+
+/*
+  Scene node drawing all instance groups. Culls the instances when the
+  scene manager asks for registrations.
+*/
+
+class CInstancingProxySceneNode : public irr::scene::ISceneNode
+{
+public:
+
+  CInstancingProxySceneNode(irr::scene::ISceneNode *parent, irr::scene::ISceneManager *manager, CInstancingManager *instancing)
+    : irr::scene::ISceneNode(parent, manager, -1), Instancing(instancing)
+  {
+    setAutomaticCulling(irr::scene::EAC_OFF);
+  }
+
+  virtual void OnRegisterSceneNode()
+  {
+    if(!IsVisible)
+      return;
+
+    irr::scene::ICameraSceneNode *camera = SceneManager->getActiveCamera();
+
+    if(!camera)
+      return;
+
+    Instancing->cull(*camera->getViewFrustum(), camera->getAbsolutePosition());
+
+    if(Instancing->getVisibleCount() == 0)
+      return;
+
+    SceneManager->registerNodeForRendering(this, irr::scene::ESNRP_SOLID);
+
+    if(Instancing->hasTransparentInstances())
+      SceneManager->registerNodeForRendering(this, irr::scene::ESNRP_TRANSPARENT);
+  }
+
+  virtual void render()
+  {
+    Instancing->render(SceneManager->getSceneNodeRenderPass() == irr::scene::ESNRP_TRANSPARENT);
+  }
+
+  virtual const irr::core::aabbox3d<irr::f32>& getBoundingBox() const { return Box; }
+
+private:
+
+  CInstancingManager *Instancing;
+
+  irr::core::aabbox3df Box;
+};
+
+static bool isTransparent(irr::video::IVideoDriver *driver, const irr::video::SMaterial& material)
+{
+  irr::video::IMaterialRenderer *renderer = driver->getMaterialRenderer(material.MaterialType);
+
+  return renderer && renderer->isTransparent();
+}
+
+//! Material of a mesh buffer as the node draws it
+static const irr::video::SMaterial& getBufferMaterial(irr::scene::ISceneNode *node, irr::scene::IMeshBuffer *buffer, irr::u32 index)
+{
+  if(index < node->getMaterialCount())
+    return node->getMaterial(index);
+
+  return buffer->getMaterial();
+}
+
+CInstancingManager::CInstancingManager(CCore * core) : Core(core)
+{
+  m_Proxy = (irr::scene::ISceneNode*)NULL;
+
+  m_InstanceCount = 0;
+  m_Visible = 0;
+
+  b_Transparent = false;
+
+  m_DrawCalls = m_LastDrawCalls = 0;
+  m_Instanced = m_LastInstanced = 0;
+}
+
+CInstancingManager::~CInstancingManager()
+{
+  clear();
+}
+
+irr::scene::ISceneNode *CInstancingManager::getProxy()
+{
+  if(!m_Proxy)
+  {
+    irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+    m_Proxy = new CInstancingProxySceneNode(sceneManager->getRootSceneNode(), sceneManager, this);
+    m_Proxy->setName("InstancingProxy");
+  }
+
+  return m_Proxy;
+}
+
+bool CInstancingManager::canInstance(irr::scene::IMeshSceneNode *node)
+{
+  irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+  if(!node || node->getType() != irr::scene::ESNT_MESH || !node->getMesh())
+    return false;
+
+  if(node->getMesh()->getMeshBufferCount() == 0)
+    return false;
+
+  // Children and animators need the node itself in the scene
+  if(node->getParent() != sceneManager->getRootSceneNode()
+  || node->getChildren().getSize() > 0
+  || node->getAnimators().getSize() > 0)
+    return false;
+
+  // Lit and shader materials fall back to one draw per copy
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  for(irr::u32 i=0; i < node->getMaterialCount(); ++i)
+    if(!driver->canDrawInstanced(node->getMaterial(i)))
+      return false;
+
+  return true;
+}
+
+irr::u32 CInstancingManager::addGroup(const irr::core::array<irr::scene::IMeshSceneNode*>& nodes)
+{
+  SInstanceGroup *group = new SInstanceGroup();
+
+  irr::scene::IMesh *mesh = nodes[0]->getMesh();
+  mesh->grab();
+
+  group->Lods[0] = mesh;
+  group->LodDistances[0] = 0.f;
+  group->LodCount = 1;
+
+  group->Boxes.resize(nodes.size());
+
+  for(irr::u32 i=0; i < nodes.size(); ++i)
+  {
+    irr::scene::IMeshSceneNode *node = nodes[i];
+
+    node->updateAbsolutePosition();
+
+    irr::core::matrix4 transformation = node->getAbsoluteTransformation();
+
+    irr::core::aabbox3df box = mesh->getBoundingBox();
+    transformation.transformBoxEx(box);
+
+    group->Transforms.push_back(transformation);
+    group->Boxes.set(i, box);
+
+    if(i == 0)
+      group->Box = box;
+    else
+      group->Box.addInternalBox(box);
+
+    // The node keeps its name and physics body, the group draws it
+    node->setVisible(false);
+    group->Nodes.push_back(node);
+  }
+
+  m_InstanceCount += nodes.size();
+
+  getProxy();
+
+  m_Groups.push_back(group);
+
+  return m_Groups.size() - 1;
+}
+
+bool CInstancingManager::addLod(irr::u32 group, irr::scene::IMesh *mesh, irr::f32 distance)
+{
+  if(group >= m_Groups.size() || !mesh)
+    return false;
+
+  SInstanceGroup *g = m_Groups[group];
+
+  if(g->LodCount >= INSTANCE_MAX_LODS || distance <= g->LodDistances[g->LodCount-1])
+    return false;
+
+  mesh->grab();
+
+  g->Lods[g->LodCount] = mesh;
+  g->LodDistances[g->LodCount] = distance;
+  ++g->LodCount;
+
+  return true;
+}
+
+void CInstancingManager::clear()
+{
+  for(irr::u32 i=0; i < m_Groups.size(); ++i)
+  {
+    for(irr::u32 l=0; l < m_Groups[i]->LodCount; ++l)
+      m_Groups[i]->Lods[l]->drop();
+
+    delete m_Groups[i];
+  }
+
+  m_Groups.clear();
+  m_Passed.clear();
+
+  m_InstanceCount = 0;
+  m_Visible = 0;
+
+  b_Transparent = false;
+
+  if(m_Proxy)
+  {
+    m_Proxy->remove();
+    m_Proxy->drop();
+    m_Proxy = (irr::scene::ISceneNode*)NULL;
+  }
+}
+
+void CInstancingManager::printReport()
+{
+  if(m_Groups.size() == 0)
+  {
+    printf("Instancing: no repeated meshes\n");
+    return;
+  }
+
+  irr::u32 copiedBytes = 0, transformBytes = 0;
+  irr::u32 separateDraws = 0, instancedDraws = 0;
+
+  for(irr::u32 i=0; i < m_Groups.size(); ++i)
+  {
+    SInstanceGroup *group = m_Groups[i];
+    irr::scene::IMesh *mesh = group->Lods[0];
+
+    irr::u32 meshBytes = 0;
+
+    for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+    {
+      irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+
+      meshBytes += buffer->getVertexCount() * irr::video::getVertexPitchFromType(buffer->getVertexType());
+      meshBytes += buffer->getIndexCount() * (buffer->getIndexType() == irr::video::EIT_16BIT ? 2 : 4);
+    }
+
+    // Batching would have copied the mesh for every node
+    copiedBytes += meshBytes * (group->Nodes.size() - 1);
+    transformBytes += INSTANCE_TRANSFORM_SIZE * group->Nodes.size();
+
+    separateDraws += mesh->getMeshBufferCount() * group->Nodes.size();
+
+    for(irr::u32 l=0; l < group->LodCount; ++l)
+      instancedDraws += group->Lods[l]->getMeshBufferCount();
+  }
+
+  irr::s32 savedBytes = irr::s32(copiedBytes) - irr::s32(transformBytes);
+
+  printf("Instancing: %d meshes, %d instances\n", m_Groups.size(), m_InstanceCount);
+  printf("\tvertex memory: %d KB saved (%d KB of copies, %d KB of transformations)\n",
+    savedBytes / 1024, copiedBytes / 1024, transformBytes / 1024);
+  printf("\tdraw calls: %d per node -> at most %d instanced\n", separateDraws, instancedDraws);
+}
+
+void CInstancingManager::cull(const irr::scene::SViewFrustum& frustum, const irr::core::vector3df& cameraPosition)
+{
+  const irr::u32 PLANES = irr::scene::SViewFrustum::VF_PLANE_COUNT;
+
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  getCullPlanes(frustum, m_Planes);
+
+  m_LastDrawCalls = m_DrawCalls;
+  m_DrawCalls = 0;
+
+  m_LastInstanced = m_Instanced;
+  m_Instanced = 0;
+
+  m_Visible = 0;
+  b_Transparent = false;
+
+  for(irr::u32 i=0; i < m_Groups.size(); ++i)
+  {
+    SInstanceGroup *group = m_Groups[i];
+
+    for(irr::u32 l=0; l < group->LodCount; ++l)
+      group->Visible[l].set_used(0);
+
+    // Whole group first
+    irr::core::vector3df center = group->Box.getCenter();
+    irr::core::vector3df extent = group->Box.getExtent() * 0.5f;
+
+    bool outside = false;
+
+    for(irr::u32 p=0; p < PLANES && !outside; ++p)
+    {
+      const irr::f32 *plane = &m_Planes[p*4];
+
+      irr::f32 distance = plane[0] * center.X + plane[1] * center.Y + plane[2] * center.Z + plane[3];
+      irr::f32 radius = fabsf(plane[0]) * extent.X + fabsf(plane[1]) * extent.Y + fabsf(plane[2]) * extent.Z;
+
+      outside = distance - radius > 0.f;
+    }
+
+    if(outside)
+      continue;
+
+    m_Passed.set_used(0);
+
+    testCullBoxes(m_Planes, group->Boxes, 0, group->Boxes.Count, m_Passed);
+
+    for(irr::u32 j=0; j < m_Passed.size(); ++j)
+    {
+      irr::u32 index = m_Passed[j];
+      irr::u32 level = 0;
+
+      if(group->LodCount > 1)
+      {
+        irr::core::vector3df position(group->Boxes.CenterX[index], group->Boxes.CenterY[index], group->Boxes.CenterZ[index]);
+        irr::f32 distanceSQ = position.getDistanceFromSQ(cameraPosition);
+
+        while(level + 1 < group->LodCount
+        && distanceSQ >= group->LodDistances[level+1] * group->LodDistances[level+1])
+          ++level;
+      }
+
+      group->Visible[level].push_back(group->Transforms[index]);
+    }
+
+    m_Visible += m_Passed.size();
+
+    if(m_Passed.size() > 0 && !b_Transparent)
+    {
+      irr::scene::IMesh *mesh = group->Lods[0];
+
+      for(irr::u32 b=0; b < mesh->getMeshBufferCount() && !b_Transparent; ++b)
+        b_Transparent = isTransparent(driver, getBufferMaterial(group->Nodes[0], mesh->getMeshBuffer(b), b));
+    }
+  }
+}
+
+void CInstancingManager::render(bool transparent)
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  for(irr::u32 i=0; i < m_Groups.size(); ++i)
+  {
+    SInstanceGroup *group = m_Groups[i];
+
+    // Materials are read from the first node, shader materials are applied after grouping
+    irr::scene::ISceneNode *node = group->Nodes[0];
+
+    for(irr::u32 l=0; l < group->LodCount; ++l)
+    {
+      const irr::core::array<irr::core::matrix4> &visible = group->Visible[l];
+
+      if(visible.size() == 0)
+        continue;
+
+      irr::scene::IMesh *mesh = group->Lods[l];
+
+      for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+      {
+        irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+        const irr::video::SMaterial &material = getBufferMaterial(node, buffer, b);
+
+        if(isTransparent(driver, material) != transparent)
+          continue;
+
+        driver->setMaterial(material);
+        // The driver draws the copies one by one when it can't instance the material
+        if(driver->drawMeshBufferInstanced(buffer, visible.const_pointer(), visible.size()))
+        {
+          ++m_DrawCalls;
+          m_Instanced += visible.size();
+        }
+        else
+          m_DrawCalls += visible.size();
+      }
+    }
+  }
+}
@@ -0,0 +1,553 @@
+#ifdef _WIN32
+  // Condition variables need Vista
+  #ifndef _WIN32_WINNT
+    #define _WIN32_WINNT 0x0600
+  #endif
+  #include <windows.h>
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+#include "Jobs.h"
+
+using namespace engine;
+
+#ifdef _WIN32
+  typedef CRITICAL_SECTION JobLock;
+  typedef CONDITION_VARIABLE JobCondition;
+#else
+  typedef pthread_mutex_t JobLock;
+  typedef pthread_cond_t JobCondition;
+#endif
+
+//! Job deque of one thread. Head and Tail only grow, the jobs are in [Head, Tail).
+struct SJobQueue
+{
+  JobLock Lock;
+
+  SJob Jobs[JOB_QUEUE_SIZE];
+
+  volatile irr::u32 Head, Tail;
+};
+
+struct SJobWorkerStart
+{
+  CJobManager *Manager;
+  irr::u32 Thread;
+};
+
+struct engine::SJobThreads
+{
+  // Queue i belongs to thread i, queue 0 to the main thread
+  SJobQueue Queues[JOB_MAX_THREADS];
+
+  // First in, first out, only served by workers
+  SJobQueue Background;
+
+  // Protects the sleeps on Wake and Done
+  JobLock Lock;
+  JobCondition Wake, Done;
+
+#ifdef _WIN32
+  DWORD Key;
+  irr::core::array<HANDLE> Threads;
+#else
+  pthread_key_t Key;
+  irr::core::array<pthread_t> Threads;
+#endif
+
+  SJobWorkerStart Starts[JOB_MAX_THREADS];
+
+  // Queues that are in use
+  irr::u32 QueueCount;
+
+  bool Stop;
+
+  // Jobs in all queues, workers and waiting threads asleep
+  volatile irr::s32 Queued, Sleeping, Waiting;
+
+  // Jobs in the background queue
+  volatile irr::s32 BackgroundQueued;
+};
+
+//! Adds to the value and returns the result, a full memory barrier
+static inline irr::s32 atomicAdd(volatile irr::s32 *value, irr::s32 add)
+{
+#ifdef _WIN32
+  return irr::s32(InterlockedExchangeAdd((volatile LONG*)value, add)) + add;
+#else
+  return __sync_add_and_fetch(value, add);
+#endif
+}
+
+static void initLock(JobLock *lock)
+{
+#ifdef _WIN32
+  InitializeCriticalSection(lock);
+#else
+  pthread_mutex_init(lock, NULL);
+#endif
+}
+
+static void destroyLock(JobLock *lock)
+{
+#ifdef _WIN32
+  DeleteCriticalSection(lock);
+#else
+  pthread_mutex_destroy(lock);
+#endif
+}
+
+static inline void lock(JobLock *lock)
+{
+#ifdef _WIN32
+  EnterCriticalSection(lock);
+#else
+  pthread_mutex_lock(lock);
+#endif
+}
+
+static inline void unlock(JobLock *lock)
+{
+#ifdef _WIN32
+  LeaveCriticalSection(lock);
+#else
+  pthread_mutex_unlock(lock);
+#endif
+}
+
+static inline void sleepOn(JobCondition *condition, JobLock *lock)
+{
+#ifdef _WIN32
+  SleepConditionVariableCS(condition, lock, INFINITE);
+#else
+  pthread_cond_wait(condition, lock);
+#endif
+}
+
+static inline void wakeOne(JobCondition *condition)
+{
+#ifdef _WIN32
+  WakeConditionVariable(condition);
+#else
+  pthread_cond_signal(condition);
+#endif
+}
+
+static inline void wakeAll(JobCondition *condition)
+{
+#ifdef _WIN32
+  WakeAllConditionVariable(condition);
+#else
+  pthread_cond_broadcast(condition);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI jobWorker(LPVOID data)
+#else
+static void* jobWorker(void *data)
+#endif
+{
+  SJobWorkerStart *start = (SJobWorkerStart*)data;
+
+  start->Manager->serveJobs(start->Thread);
+
+  return 0;
+}
+
+CJobManager::CJobManager()
+{
+  m_Threads = new SJobThreads();
+
+  for(irr::u32 i=0; i < JOB_MAX_THREADS; ++i)
+  {
+    initLock(&m_Threads->Queues[i].Lock);
+    m_Threads->Queues[i].Head = m_Threads->Queues[i].Tail = 0;
+  }
+
+  initLock(&m_Threads->Background.Lock);
+  m_Threads->Background.Head = m_Threads->Background.Tail = 0;
+
+  initLock(&m_Threads->Lock);
+
+#ifdef _WIN32
+  InitializeConditionVariable(&m_Threads->Wake);
+  InitializeConditionVariable(&m_Threads->Done);
+  m_Threads->Key = TlsAlloc();
+#else
+  pthread_cond_init(&m_Threads->Wake, NULL);
+  pthread_cond_init(&m_Threads->Done, NULL);
+  pthread_key_create(&m_Threads->Key, NULL);
+#endif
+
+  m_Threads->QueueCount = 1;
+  m_Threads->Stop = false;
+  m_Threads->Queued = m_Threads->Sleeping = m_Threads->Waiting = 0;
+  m_Threads->BackgroundQueued = 0;
+
+  m_Jobs = m_Stolen = 0;
+  m_LastJobs = m_LastStolen = 0;
+}
+
+CJobManager::~CJobManager()
+{
+  stop();
+
+  for(irr::u32 i=0; i < JOB_MAX_THREADS; ++i)
+    destroyLock(&m_Threads->Queues[i].Lock);
+
+  destroyLock(&m_Threads->Background.Lock);
+  destroyLock(&m_Threads->Lock);
+
+#ifdef _WIN32
+  TlsFree(m_Threads->Key);
+#else
+  pthread_cond_destroy(&m_Threads->Wake);
+  pthread_cond_destroy(&m_Threads->Done);
+  pthread_key_delete(m_Threads->Key);
+#endif
+
+  delete m_Threads;
+}
+
+irr::u32 CJobManager::getProcessorCount()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  return irr::core::max_(irr::u32(info.dwNumberOfProcessors), 1u);
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return count > 0 ? irr::u32(count) : 1;
+#endif
+}
+
+void CJobManager::start(irr::u32 workers)
+{
+  stop();
+
+  workers = irr::core::min_(workers, JOB_MAX_THREADS - 1);
+
+  m_Threads->Stop = false;
+
+  // Queues are set before any worker looks for one to steal from
+  m_Threads->QueueCount = workers + 1;
+
+  for(irr::u32 i=1; i <= workers; ++i)
+  {
+    m_Threads->Starts[i].Manager = this;
+    m_Threads->Starts[i].Thread = i;
+
+#ifdef _WIN32
+    HANDLE thread = CreateThread(NULL, 0, jobWorker, &m_Threads->Starts[i], 0, NULL);
+
+    if(thread != NULL)
+      m_Threads->Threads.push_back(thread);
+#else
+    pthread_t thread;
+
+    if(pthread_create(&thread, NULL, jobWorker, &m_Threads->Starts[i]) == 0)
+      m_Threads->Threads.push_back(thread);
+#endif
+  }
+}
+
+void CJobManager::stop()
+{
+  lock(&m_Threads->Lock);
+  m_Threads->Stop = true;
+  wakeAll(&m_Threads->Wake);
+  unlock(&m_Threads->Lock);
+
+  for(irr::u32 i=0; i < m_Threads->Threads.size(); ++i)
+  {
+#ifdef _WIN32
+    WaitForSingleObject(m_Threads->Threads[i], INFINITE);
+    CloseHandle(m_Threads->Threads[i]);
+#else
+    pthread_join(m_Threads->Threads[i], NULL);
+#endif
+  }
+
+  m_Threads->Threads.clear();
+
+  // Jobs left in the queue of a worker that failed to start
+  SJob job;
+
+  while(takeJob(0, job))
+    runJob(job, 0);
+
+  while(takeBackgroundJob(job))
+    runJob(job, 0);
+
+  m_Threads->QueueCount = 1;
+}
+
+irr::u32 CJobManager::getWorkerCount()
+{
+  return m_Threads->Threads.size();
+}
+
+irr::u32 CJobManager::getThreadIndex()
+{
+#ifdef _WIN32
+  return irr::u32((size_t)TlsGetValue(m_Threads->Key));
+#else
+  return irr::u32((size_t)pthread_getspecific(m_Threads->Key));
+#endif
+}
+
+void CJobManager::submit(JobFunction function, void *data, SJobCounter *counter)
+{
+  SJob job;
+  job.Function = function;
+  job.Data = data;
+  job.Counter = counter;
+
+  atomicAdd(&counter->Pending, 1);
+
+  // Counted before it can be taken, so Queued never drops below 0
+  atomicAdd(&m_Threads->Queued, 1);
+
+  irr::u32 thread = getThreadIndex();
+  SJobQueue &queue = m_Threads->Queues[thread];
+
+  lock(&queue.Lock);
+
+  bool full = queue.Tail - queue.Head >= JOB_QUEUE_SIZE;
+
+  if(!full)
+  {
+    queue.Jobs[queue.Tail % JOB_QUEUE_SIZE] = job;
+    ++queue.Tail;
+  }
+
+  unlock(&queue.Lock);
+
+  if(full)
+  {
+    atomicAdd(&m_Threads->Queued, -1);
+    runJob(job, thread);
+    return;
+  }
+
+  // A worker counts itself asleep before it checks Queued, one of both sees the other
+  if(m_Threads->Sleeping > 0)
+  {
+    lock(&m_Threads->Lock);
+    wakeOne(&m_Threads->Wake);
+    unlock(&m_Threads->Lock);
+  }
+}
+
+void CJobManager::submitBackground(JobFunction function, void *data, SJobCounter *counter)
+{
+  SJob job;
+  job.Function = function;
+  job.Data = data;
+  job.Counter = counter;
+
+  atomicAdd(&counter->Pending, 1);
+
+  SJobQueue &queue = m_Threads->Background;
+  bool full = true;
+
+  if(m_Threads->Threads.size() > 0)
+  {
+    atomicAdd(&m_Threads->BackgroundQueued, 1);
+
+    lock(&queue.Lock);
+
+    full = queue.Tail - queue.Head >= JOB_QUEUE_SIZE;
+
+    if(!full)
+    {
+      queue.Jobs[queue.Tail % JOB_QUEUE_SIZE] = job;
+      ++queue.Tail;
+    }
+
+    unlock(&queue.Lock);
+
+    if(full)
+      atomicAdd(&m_Threads->BackgroundQueued, -1);
+  }
+
+  if(full)
+  {
+    runJob(job, getThreadIndex());
+    return;
+  }
+
+  if(m_Threads->Sleeping > 0)
+  {
+    lock(&m_Threads->Lock);
+    wakeOne(&m_Threads->Wake);
+    unlock(&m_Threads->Lock);
+  }
+}
+
+void CJobManager::wait(SJobCounter *counter)
+{
+  irr::u32 thread = getThreadIndex();
+  SJob job;
+
+  while(counter->Pending > 0)
+  {
+    if(takeJob(thread, job))
+    {
+      runJob(job, thread);
+      continue;
+    }
+
+    // Nothing left to take, the last jobs are running on other threads
+    lock(&m_Threads->Lock);
+    atomicAdd(&m_Threads->Waiting, 1);
+
+    if(counter->Pending > 0 && m_Threads->Queued == 0)
+      sleepOn(&m_Threads->Done, &m_Threads->Lock);
+
+    atomicAdd(&m_Threads->Waiting, -1);
+    unlock(&m_Threads->Lock);
+  }
+}
+
+void CJobManager::update()
+{
+  m_LastJobs = m_Jobs;
+  m_LastStolen = m_Stolen;
+
+  atomicAdd(&m_Jobs, -irr::s32(m_LastJobs));
+  atomicAdd(&m_Stolen, -irr::s32(m_LastStolen));
+}
+
+void CJobManager::serveJobs(irr::u32 thread)
+{
+#ifdef _WIN32
+  TlsSetValue(m_Threads->Key, (LPVOID)(size_t)thread);
+#else
+  pthread_setspecific(m_Threads->Key, (void*)(size_t)thread);
+#endif
+
+  SJob job;
+
+  while(true)
+  {
+    // Frame jobs first, a background job only fills an idle worker
+    if(takeJob(thread, job) || takeBackgroundJob(job))
+    {
+      runJob(job, thread);
+      continue;
+    }
+
+    lock(&m_Threads->Lock);
+    atomicAdd(&m_Threads->Sleeping, 1);
+
+    if(!m_Threads->Stop && m_Threads->Queued == 0 && m_Threads->BackgroundQueued == 0)
+      sleepOn(&m_Threads->Wake, &m_Threads->Lock);
+
+    atomicAdd(&m_Threads->Sleeping, -1);
+
+    // Queued jobs are finished before the workers leave
+    bool leave = m_Threads->Stop && m_Threads->Queued == 0 && m_Threads->BackgroundQueued == 0;
+
+    unlock(&m_Threads->Lock);
+
+    if(leave)
+      break;
+  }
+}
+
+bool CJobManager::takeJob(irr::u32 thread, SJob& job)
+{
+  bool found = false;
+
+  // Newest job of the own queue
+  SJobQueue &own = m_Threads->Queues[thread];
+
+  if(own.Tail != own.Head)
+  {
+    lock(&own.Lock);
+
+    if(own.Tail != own.Head)
+    {
+      --own.Tail;
+      job = own.Jobs[own.Tail % JOB_QUEUE_SIZE];
+      found = true;
+    }
+
+    unlock(&own.Lock);
+  }
+
+  // Oldest job of another queue
+  for(irr::u32 i=1; i < m_Threads->QueueCount && !found; ++i)
+  {
+    SJobQueue &victim = m_Threads->Queues[(thread + i) % m_Threads->QueueCount];
+
+    if(victim.Tail == victim.Head)
+      continue;
+
+    lock(&victim.Lock);
+
+    if(victim.Tail != victim.Head)
+    {
+      job = victim.Jobs[victim.Head % JOB_QUEUE_SIZE];
+      ++victim.Head;
+      found = true;
+    }
+
+    unlock(&victim.Lock);
+
+    if(found)
+      atomicAdd(&m_Stolen, 1);
+  }
+
+  if(found)
+    atomicAdd(&m_Threads->Queued, -1);
+
+  return found;
+}
+
+bool CJobManager::takeBackgroundJob(SJob& job)
+{
+  SJobQueue &queue = m_Threads->Background;
+
+  if(queue.Tail == queue.Head)
+    return false;
+
+  bool found = false;
+
+  lock(&queue.Lock);
+
+  if(queue.Tail != queue.Head)
+  {
+    job = queue.Jobs[queue.Head % JOB_QUEUE_SIZE];
+    ++queue.Head;
+    found = true;
+  }
+
+  unlock(&queue.Lock);
+
+  if(found)
+    atomicAdd(&m_Threads->BackgroundQueued, -1);
+
+  return found;
+}
+
+void CJobManager::runJob(const SJob& job, irr::u32 thread)
+{
+  job.Function(job.Data, thread);
+
+  atomicAdd(&m_Jobs, 1);
+
+  // The thread waiting for the batch counts itself before it checks Pending
+  if(atomicAdd(&job.Counter->Pending, -1) == 0 && m_Threads->Waiting > 0)
+  {
+    lock(&m_Threads->Lock);
+    wakeAll(&m_Threads->Done);
+    unlock(&m_Threads->Lock);
+  }
+}
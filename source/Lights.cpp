@@ -0,0 +1,614 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "ObjectManager.h"
+#include "Lights.h"
+
+#include <stdio.h>
+#include <math.h>
+
+using namespace engine;
+
+/*
+  Scene node drawing the lights. It is registered in the shadow pass,
+  which Irrlicht draws after all solid nodes and before the transparent ones.
+*/
+
+class CLightProxySceneNode : public irr::scene::ISceneNode
+{
+public:
+
+  CLightProxySceneNode(irr::scene::ISceneNode *parent, irr::scene::ISceneManager *manager, CLightManager *lights)
+    : irr::scene::ISceneNode(parent, manager, -1), Lights(lights)
+  {
+    setAutomaticCulling(irr::scene::EAC_OFF);
+  }
+
+  virtual void OnRegisterSceneNode()
+  {
+    if(IsVisible && Lights->getLightCount() > 0)
+      SceneManager->registerNodeForRendering(this, irr::scene::ESNRP_SHADOW);
+  }
+
+  virtual void render()
+  {
+    Lights->render();
+  }
+
+  virtual const irr::core::aabbox3d<irr::f32>& getBoundingBox() const { return Box; }
+
+private:
+
+  CLightManager *Lights;
+
+  irr::core::aabbox3df Box;
+};
+
+//! Light on screen and its view depth, the nearest are kept when there are too many
+struct SLightDepth
+{
+  irr::f32 Depth;
+  irr::u32 Index;
+
+  bool operator<(const SLightDepth& other) const { return Depth < other.Depth; }
+};
+
+//! 0..1 as 16 bit fixed point in two 8 bit channels
+static void encode16(irr::f32 value, irr::u32& high, irr::u32& low)
+{
+  irr::u32 fixed = irr::u32(irr::core::clamp(value, 0.f, 1.f) * 65535.f + 0.5f);
+
+  high = fixed >> 8;
+  low = fixed & 0xFF;
+}
+
+CLightManager::CLightManager(CCore * core) : Core(core)
+{
+  m_Proxy = (irr::scene::ISceneNode*)NULL;
+
+  for(irr::u32 i=0; i < LIGHT_FORWARD_MAX; ++i)
+    m_ForwardLights[i] = (irr::scene::ILightSceneNode*)NULL;
+
+  m_GBuffer[0] = m_GBuffer[1] = (irr::video::ITexture*)NULL;
+  m_Scene = (irr::video::ITexture*)NULL;
+  m_Active = false;
+  m_TileTexture = m_IndexTexture = m_LightTexture = (irr::video::ITexture*)NULL;
+
+  m_NextId = 1;
+
+  m_TileSize = LIGHT_TILE_SIZE;
+  m_TilesX = m_TilesY = 0;
+
+  m_Visible = m_LitTiles = 0;
+}
+
+CLightManager::~CLightManager()
+{
+}
+
+bool CLightManager::init()
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  // The shaders are GLSL only, like the multi-texture shader
+  if(driver->getDriverType() != irr::video::EDT_OPENGL
+  || !driver->queryFeature(irr::video::EVDF_RENDER_TO_TARGET)
+  || !driver->queryFeature(irr::video::EVDF_MULTIPLE_RENDER_TARGETS))
+  {
+    printf("Lights: deferred lighting disabled, needs OpenGL with multiple render targets\n");
+    return false;
+  }
+
+  irr::s32 lightingShader = Core->getRenderer()->getShaders()->createTiledLightShader();
+
+  if(lightingShader <= 0)
+  {
+    printf("Lights: deferred lighting disabled, shaders failed\n");
+    return false;
+  }
+
+  irr::core::dimension2du screenSize = driver->getScreenSize();
+
+  // Same format for all, older drivers can't mix formats in one framebuffer.
+  // Targets of the same size share one depth buffer.
+  m_Scene = driver->addRenderTargetTexture(screenSize, "LightScene", irr::video::ECF_A16B16G16R16F);
+  m_GBuffer[0] = driver->addRenderTargetTexture(screenSize, "GBufferNormalDepth", irr::video::ECF_A16B16G16R16F);
+  m_GBuffer[1] = driver->addRenderTargetTexture(screenSize, "GBufferAlbedo", irr::video::ECF_A16B16G16R16F);
+
+  // Data textures are read texel by texel: no mip maps, no 16 bit colors
+  bool mipMaps = driver->getTextureCreationFlag(irr::video::ETCF_CREATE_MIP_MAPS);
+  bool always32 = driver->getTextureCreationFlag(irr::video::ETCF_ALWAYS_32_BIT);
+
+  driver->setTextureCreationFlag(irr::video::ETCF_CREATE_MIP_MAPS, false);
+  driver->setTextureCreationFlag(irr::video::ETCF_ALWAYS_32_BIT, true);
+
+  m_TileTexture = driver->addTexture(irr::core::dimension2du(LIGHT_GRID_SIZE, LIGHT_GRID_SIZE), "LightTiles", irr::video::ECF_A8R8G8B8);
+  m_IndexTexture = driver->addTexture(irr::core::dimension2du(64, 64), "LightIndices", irr::video::ECF_A8R8G8B8);
+  m_LightTexture = driver->addTexture(irr::core::dimension2du(LIGHT_MAX, 4), "LightData", irr::video::ECF_A8R8G8B8);
+
+  driver->setTextureCreationFlag(irr::video::ETCF_CREATE_MIP_MAPS, mipMaps);
+  driver->setTextureCreationFlag(irr::video::ETCF_ALWAYS_32_BIT, always32);
+
+  if(!m_Scene || !m_GBuffer[0] || !m_GBuffer[1] || !m_TileTexture || !m_IndexTexture || !m_LightTexture)
+  {
+    printf("Lights: deferred lighting disabled, textures failed\n");
+    m_GBuffer[0] = m_GBuffer[1] = (irr::video::ITexture*)NULL;
+    return false;
+  }
+
+  m_Targets.push_back(irr::video::IRenderTarget(m_Scene));
+  m_Targets.push_back(irr::video::IRenderTarget(m_GBuffer[0]));
+  m_Targets.push_back(irr::video::IRenderTarget(m_GBuffer[1]));
+
+  m_LightingMaterial.MaterialType = (irr::video::E_MATERIAL_TYPE)lightingShader;
+  m_LightingMaterial.MaterialTypeParam = irr::video::pack_texureBlendFunc(irr::video::EBF_ONE, irr::video::EBF_ONE);
+  m_LightingMaterial.Lighting = false;
+  m_LightingMaterial.FogEnable = false;
+  m_LightingMaterial.BackfaceCulling = false;
+  m_LightingMaterial.ZWriteEnable = false;
+
+  // The G-buffer holds the nearest node of every pixel, there's nothing to test
+  m_LightingMaterial.ZBuffer = irr::video::ECFN_NEVER;
+
+  m_LightingMaterial.setTexture(0, m_GBuffer[0]);
+  m_LightingMaterial.setTexture(1, m_GBuffer[1]);
+  m_LightingMaterial.setTexture(2, m_TileTexture);
+  m_LightingMaterial.setTexture(3, m_IndexTexture);
+  m_LightingMaterial.setTexture(4, m_LightTexture);
+
+  for(irr::u32 i=0; i < 5; ++i)
+  {
+    m_LightingMaterial.TextureLayer[i].BilinearFilter = false;
+    m_LightingMaterial.TextureLayer[i].TrilinearFilter = false;
+    m_LightingMaterial.TextureLayer[i].TextureWrapU = irr::video::ETC_CLAMP_TO_EDGE;
+    m_LightingMaterial.TextureLayer[i].TextureWrapV = irr::video::ETC_CLAMP_TO_EDGE;
+  }
+
+  // Tiles have to fit the tile texture
+  m_TileSize = LIGHT_TILE_SIZE;
+
+  while((screenSize.Width + m_TileSize - 1) / m_TileSize > LIGHT_GRID_SIZE
+  || (screenSize.Height + m_TileSize - 1) / m_TileSize > LIGHT_GRID_SIZE)
+    m_TileSize *= 2;
+
+  m_TilesX = (screenSize.Width + m_TileSize - 1) / m_TileSize;
+  m_TilesY = (screenSize.Height + m_TileSize - 1) / m_TileSize;
+
+  m_TileCounts.set_used(m_TilesX * m_TilesY);
+  m_TileOffsets.set_used(m_TilesX * m_TilesY);
+
+  printf("Lights: tiled deferred lighting, %dx%d tiles of %d pixels\n", m_TilesX, m_TilesY, m_TileSize);
+
+  return true;
+}
+
+irr::scene::ISceneNode *CLightManager::getProxy()
+{
+  if(!m_Proxy)
+  {
+    irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+    m_Proxy = new CLightProxySceneNode(sceneManager->getRootSceneNode(), sceneManager, this);
+    m_Proxy->setName("LightProxy");
+  }
+
+  return m_Proxy;
+}
+
+irr::u32 CLightManager::addLight(const irr::core::vector3df& position, const irr::video::SColorf& color,
+  irr::f32 radius, irr::f32 lifeTime, irr::f32 intensity)
+{
+  if(!isEnabled())
+    return 0;
+
+  SDynamicLight light;
+
+  light.Id = m_NextId++;
+  light.Position = position;
+  light.Color = color;
+  light.Radius = irr::core::min_(radius, LIGHT_MAX_RADIUS);
+  light.Intensity = irr::core::min_(intensity, LIGHT_MAX_INTENSITY);
+  light.LifeTime = lifeTime;
+  light.Age = 0.f;
+
+  m_Lights.push_back(light);
+
+  getProxy();
+
+  return light.Id;
+}
+
+void CLightManager::removeLight(irr::u32 id)
+{
+  for(irr::u32 i=0; i < m_Lights.size(); ++i)
+  {
+    if(m_Lights[i].Id == id)
+    {
+      m_Lights.erase(i);
+      return;
+    }
+  }
+}
+
+void CLightManager::setLightPosition(irr::u32 id, const irr::core::vector3df& position)
+{
+  for(irr::u32 i=0; i < m_Lights.size(); ++i)
+  {
+    if(m_Lights[i].Id == id)
+    {
+      m_Lights[i].Position = position;
+      return;
+    }
+  }
+}
+
+void CLightManager::update(irr::f32 time)
+{
+  for(irr::u32 i=0; i < m_Lights.size(); )
+  {
+    SDynamicLight &light = m_Lights[i];
+
+    if(light.LifeTime > 0.f)
+    {
+      light.Age += time;
+
+      if(light.Age >= light.LifeTime)
+      {
+        // Order doesn't matter, move the last one here
+        m_Lights[i] = m_Lights.getLast();
+        m_Lights.erase(m_Lights.size() - 1);
+        continue;
+      }
+    }
+
+    ++i;
+  }
+
+  updateForwardLights();
+}
+
+void CLightManager::updateForwardLights()
+{
+  irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+  irr::scene::ICameraSceneNode *camera = sceneManager->getActiveCamera();
+
+  irr::core::array<SLightDepth> nearest;
+
+  if(camera)
+  {
+    const irr::core::vector3df cameraPosition = camera->getAbsolutePosition();
+
+    nearest.reallocate(m_Lights.size());
+
+    for(irr::u32 i=0; i < m_Lights.size(); ++i)
+    {
+      SLightDepth entry;
+
+      // Distance to the light sphere, a large light near the camera wins over a small one on it
+      entry.Depth = m_Lights[i].Position.getDistanceFrom(cameraPosition) - m_Lights[i].Radius;
+      entry.Index = i;
+
+      nearest.push_back(entry);
+    }
+
+    if(nearest.size() > LIGHT_FORWARD_MAX)
+      nearest.sort();
+  }
+
+  for(irr::u32 i=0; i < LIGHT_FORWARD_MAX; ++i)
+  {
+    if(i >= nearest.size())
+    {
+      if(m_ForwardLights[i])
+        m_ForwardLights[i]->setVisible(false);
+
+      continue;
+    }
+
+    if(!m_ForwardLights[i])
+    {
+      m_ForwardLights[i] = sceneManager->addLightSceneNode();
+      m_ForwardLights[i]->grab();
+      m_ForwardLights[i]->setName("ForwardLight");
+    }
+
+    const SDynamicLight &light = m_Lights[nearest[i].Index];
+
+    // Fade like the deferred pass does
+    irr::f32 intensity = light.Intensity;
+    if(light.LifeTime > 0.f)
+      intensity *= 1.f - light.Age / light.LifeTime;
+
+    irr::scene::ILightSceneNode *node = m_ForwardLights[i];
+
+    node->setPosition(light.Position);
+    node->setRadius(light.Radius);
+    node->setVisible(true);
+
+    irr::video::SLight &data = node->getLightData();
+
+    data.DiffuseColor = irr::video::SColorf(light.Color.r * intensity, light.Color.g * intensity, light.Color.b * intensity);
+    data.AmbientColor = data.SpecularColor = irr::video::SColorf(0.f, 0.f, 0.f);
+
+    // The fixed function falloff has no end, this one is down to 1/26 at the radius
+    data.Attenuation.set(1.f, 0.f, 25.f / (light.Radius * light.Radius));
+  }
+}
+
+void CLightManager::clear()
+{
+  m_Lights.clear();
+
+  m_Visible = m_LitTiles = 0;
+
+  for(irr::u32 i=0; i < LIGHT_FORWARD_MAX; ++i)
+  {
+    if(m_ForwardLights[i])
+    {
+      m_ForwardLights[i]->remove();
+      m_ForwardLights[i]->drop();
+      m_ForwardLights[i] = (irr::scene::ILightSceneNode*)NULL;
+    }
+  }
+
+  if(m_Proxy)
+  {
+    m_Proxy->remove();
+    m_Proxy->drop();
+    m_Proxy = (irr::scene::ISceneNode*)NULL;
+  }
+}
+
+void CLightManager::binLights()
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+  irr::scene::ICameraSceneNode *camera = Core->getRenderer()->getSceneManager()->getActiveCamera();
+
+  const irr::core::matrix4 &view = driver->getTransform(irr::video::ETS_VIEW);
+  const irr::f32 *projection = driver->getTransform(irr::video::ETS_PROJECTION).pointer();
+
+  irr::f32 nearValue = camera->getNearValue(), farValue = camera->getFarValue();
+
+  irr::core::dimension2du screenSize = driver->getScreenSize();
+
+  irr::core::array<SLightDepth> depths;
+
+  for(irr::u32 i=0; i < m_Lights.size(); ++i)
+  {
+    irr::core::vector3df position;
+    view.transformVect(position, m_Lights[i].Position);
+
+    irr::f32 radius = m_Lights[i].Radius;
+
+    if(position.Z + radius < nearValue || position.Z - radius > farValue)
+      continue;
+
+    SLightDepth depth;
+    depth.Depth = position.Z;
+    depth.Index = i;
+
+    depths.push_back(depth);
+  }
+
+  if(depths.size() > LIGHT_MAX)
+  {
+    depths.sort();
+    depths.set_used(LIGHT_MAX);
+  }
+
+  m_VisibleLights.set_used(0);
+  m_LightTiles.set_used(0);
+
+  for(irr::u32 i=0; i < m_TileCounts.size(); ++i)
+    m_TileCounts[i] = 0;
+
+  irr::u32 *lightData = (irr::u32*)m_LightTexture->lock();
+
+  for(irr::u32 d=0; d < depths.size(); ++d)
+  {
+    const SDynamicLight &light = m_Lights[depths[d].Index];
+
+    irr::core::vector3df position;
+    view.transformVect(position, light.Position);
+
+    irr::f32 radius = light.Radius;
+
+    // Screen rectangle of the view space box around the light
+    irr::core::rect<irr::s32> tiles(0, 0, m_TilesX - 1, m_TilesY - 1);
+
+    if(position.Z - radius > nearValue)
+    {
+      irr::f32 minX = 1.f, minY = 1.f, maxX = -1.f, maxY = -1.f;
+
+      for(irr::u32 c=0; c < 8; ++c)
+      {
+        irr::f32 x = position.X + ((c & 1) ? radius : -radius);
+        irr::f32 y = position.Y + ((c & 2) ? radius : -radius);
+        irr::f32 z = position.Z + ((c & 4) ? radius : -radius);
+
+        irr::f32 screenX = x * projection[0] / z;
+        irr::f32 screenY = y * projection[5] / z;
+
+        minX = irr::core::min_(minX, screenX);
+        maxX = irr::core::max_(maxX, screenX);
+        minY = irr::core::min_(minY, screenY);
+        maxY = irr::core::max_(maxY, screenY);
+      }
+
+      if(minX > 1.f || maxX < -1.f || minY > 1.f || maxY < -1.f)
+        continue;
+
+      // Tile rows go down the screen
+      irr::f32 left = (minX * 0.5f + 0.5f) * screenSize.Width;
+      irr::f32 right = (maxX * 0.5f + 0.5f) * screenSize.Width;
+      irr::f32 top = (0.5f - maxY * 0.5f) * screenSize.Height;
+      irr::f32 bottom = (0.5f - minY * 0.5f) * screenSize.Height;
+
+      tiles.UpperLeftCorner.X = irr::core::clamp(irr::s32(left) / irr::s32(m_TileSize), 0, irr::s32(m_TilesX) - 1);
+      tiles.LowerRightCorner.X = irr::core::clamp(irr::s32(right) / irr::s32(m_TileSize), 0, irr::s32(m_TilesX) - 1);
+      tiles.UpperLeftCorner.Y = irr::core::clamp(irr::s32(top) / irr::s32(m_TileSize), 0, irr::s32(m_TilesY) - 1);
+      tiles.LowerRightCorner.Y = irr::core::clamp(irr::s32(bottom) / irr::s32(m_TileSize), 0, irr::s32(m_TilesY) - 1);
+    }
+
+    irr::u32 index = m_VisibleLights.size();
+
+    m_VisibleLights.push_back(depths[d].Index);
+    m_LightTiles.push_back(tiles);
+
+    for(irr::s32 y = tiles.UpperLeftCorner.Y; y <= tiles.LowerRightCorner.Y; ++y)
+    for(irr::s32 x = tiles.UpperLeftCorner.X; x <= tiles.LowerRightCorner.X; ++x)
+    {
+      irr::u32 &count = m_TileCounts[y * m_TilesX + x];
+
+      if(count < LIGHT_TILE_MAX)
+        ++count;
+    }
+
+    // Columns of the light texture: position, radius, color
+    irr::u32 xHigh, xLow, yHigh, yLow, zHigh, zLow, radiusHigh, radiusLow;
+
+    encode16((position.X + LIGHT_ENCODE_RANGE) / (2.f * LIGHT_ENCODE_RANGE), xHigh, xLow);
+    encode16((position.Y + LIGHT_ENCODE_RANGE) / (2.f * LIGHT_ENCODE_RANGE), yHigh, yLow);
+    encode16((position.Z + LIGHT_ENCODE_RANGE) / (2.f * LIGHT_ENCODE_RANGE), zHigh, zLow);
+    encode16(radius / LIGHT_MAX_RADIUS, radiusHigh, radiusLow);
+
+    // Transient lights fade out
+    irr::f32 intensity = light.Intensity;
+
+    if(light.LifeTime > 0.f)
+      intensity *= 1.f - light.Age / light.LifeTime;
+
+    lightData[index] = irr::video::SColor(yLow, xHigh, xLow, yHigh).color;
+    lightData[LIGHT_MAX + index] = irr::video::SColor(radiusLow, zHigh, zLow, radiusHigh).color;
+    lightData[LIGHT_MAX * 2 + index] = irr::video::SColor(
+      irr::u32(irr::core::clamp(intensity / LIGHT_MAX_INTENSITY, 0.f, 1.f) * 255.f),
+      irr::u32(irr::core::clamp(light.Color.r, 0.f, 1.f) * 255.f),
+      irr::u32(irr::core::clamp(light.Color.g, 0.f, 1.f) * 255.f),
+      irr::u32(irr::core::clamp(light.Color.b, 0.f, 1.f) * 255.f)).color;
+  }
+
+  m_LightTexture->unlock();
+
+  m_Visible = m_VisibleLights.size();
+
+  // Offsets into the index list, tiles past its capacity lose their lights
+  irr::u32 offset = 0;
+  m_LitTiles = 0;
+
+  irr::u32 *tileData = (irr::u32*)m_TileTexture->lock();
+
+  for(irr::u32 i=0; i < m_TileCounts.size(); ++i)
+  {
+    m_TileCounts[i] = irr::core::min_(m_TileCounts[i], LIGHT_INDEX_CAPACITY - offset);
+    m_TileOffsets[i] = offset;
+
+    offset += m_TileCounts[i];
+
+    if(m_TileCounts[i] > 0)
+      ++m_LitTiles;
+
+    irr::u32 x = i % m_TilesX, y = i / m_TilesX;
+
+    tileData[y * LIGHT_GRID_SIZE + x] = irr::video::SColor(
+      255, m_TileOffsets[i] >> 8, m_TileOffsets[i] & 0xFF, m_TileCounts[i]).color;
+  }
+
+  m_TileTexture->unlock();
+
+  // Fill the lists in the order the lights were binned, the offsets
+  // advance and the counts go down to 0 as the tiles fill up
+  irr::u8 *indices = (irr::u8*)m_IndexTexture->lock();
+
+  for(irr::u32 l=0; l < m_VisibleLights.size(); ++l)
+  {
+    const irr::core::rect<irr::s32> &tiles = m_LightTiles[l];
+
+    for(irr::s32 y = tiles.UpperLeftCorner.Y; y <= tiles.LowerRightCorner.Y; ++y)
+    for(irr::s32 x = tiles.UpperLeftCorner.X; x <= tiles.LowerRightCorner.X; ++x)
+    {
+      irr::u32 tile = y * m_TilesX + x;
+
+      if(m_TileCounts[tile] == 0)
+        continue;
+
+      irr::u32 index = m_TileOffsets[tile]++;
+      --m_TileCounts[tile];
+
+      // A8R8G8B8 is stored as B, G, R, A: channel c of the shader is byte 2-c (alpha is 3)
+      static const irr::u32 channelByte[4] = { 2, 1, 0, 3 };
+
+      indices[(index / 4) * 4 + channelByte[index % 4]] = irr::u8(l);
+    }
+  }
+
+  m_IndexTexture->unlock();
+}
+
+void CLightManager::renderLighting()
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  // Full screen quad, the vertex shader passes the positions through
+  irr::video::S3DVertex vertices[4];
+  vertices[0].Pos.set(-1.f, -1.f, 0.f);
+  vertices[1].Pos.set(1.f, -1.f, 0.f);
+  vertices[2].Pos.set(1.f, 1.f, 0.f);
+  vertices[3].Pos.set(-1.f, 1.f, 0.f);
+
+  const irr::u16 indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+  driver->setMaterial(m_LightingMaterial);
+  driver->drawIndexedTriangleList(vertices, 4, indices, 2);
+}
+
+bool CLightManager::beginFrame()
+{
+  m_Active = false;
+
+  if(!isEnabled() || m_Lights.size() == 0 || !Core->getRenderer()->getSceneManager()->getActiveCamera())
+    return false;
+
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  // The scene clears the shared depth buffer. Material shaders write the
+  // view depth negated, the clear value and fixed function colors never are.
+  driver->setRenderTarget(m_Scene, true, true, Core->getObjects()->parameters.backgroundSkyColor);
+  driver->setRenderTarget(m_GBuffer[0], true, false, irr::video::SColor(0, 0, 0, 0));
+  driver->setRenderTarget(m_GBuffer[1], true, false, irr::video::SColor(0, 0, 0, 0));
+
+  m_Active = driver->setRenderTarget(m_Targets, false, false);
+
+  if(!m_Active)
+    driver->setRenderTarget(0, false, false);
+
+  return m_Active;
+}
+
+void CLightManager::render()
+{
+  if(!m_Active)
+    return;
+
+  // Transparent nodes only draw color, they go on in the scene target
+  Core->getRenderer()->getVideoDriver()->setRenderTarget(m_Scene, false, false);
+
+  binLights();
+
+  if(m_LitTiles == 0)
+    return;
+
+  renderLighting();
+}
+
+void CLightManager::endFrame()
+{
+  if(!m_Active)
+    return;
+
+  m_Active = false;
+
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  driver->setRenderTarget(0, false, false);
+  driver->setViewPort(irr::core::rect<irr::s32>(0, 0, driver->getScreenSize().Width, driver->getScreenSize().Height));
+  driver->draw2DImage(m_Scene, irr::core::position2d<irr::s32>(0, 0));
+}
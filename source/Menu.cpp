@@ -115,12 +115,16 @@ void CMenu::unloadAssets()
 {
   for(u32 i=0; i < data->texture.size(); ++i)
   {
-    data->texture[i]->drop();
+    if(data->texture[i])
+      data->texture[i]->drop();
     //driver->removeTexture(data.texture[i]);
   }
 
   data->texture.clear();
   data->texture.set_used(0);
+
+  // The atlases themselves are dropped with the sprite batcher
+  data->sprite.set_used(0);
 }
 
 void CMenu::loadAssets()
@@ -135,17 +139,18 @@ void CMenu::loadAssets()
   driver->setTextureCreationFlag(video::ETCF_CREATE_MIP_MAPS, false);
   driver->setTextureCreationFlag(video::ETCF_ALWAYS_32_BIT, true);
 
-  data->texture.push_back( driver->getTexture("data/2d/menu/mainmenu.jpg") ); // 0
+  // Backgrounds are drawn through the sprite batcher, their slots stay empty
+  data->texture.push_back( (ITexture*)NULL ); // 0
   data->texture.push_back( driver->getTexture("data/2d/menu/mainmenubuttons.png") );
-  data->texture.push_back( driver->getTexture("data/2d/menu/bottom1.png") );
-  data->texture.push_back( driver->getTexture("data/2d/menu/bottom2.png") );
+  data->texture.push_back( (ITexture*)NULL );
+  data->texture.push_back( (ITexture*)NULL );
   data->texture.push_back( driver->getTexture("data/2d/menu/goverment.png") );
   data->texture.push_back( driver->getTexture("data/2d/menu/nova.png") ); // 5
   data->texture.push_back( driver->getTexture("data/2d/menu/mainmenubuttons2.png") );
   data->texture.push_back( driver->getTexture("data/2d/menu/armsrace.png") );
   data->texture.push_back( driver->getTexture("data/2d/menu/goverment128.png") );
   data->texture.push_back( driver->getTexture("data/2d/menu/nova128.png") );
-  data->texture.push_back( driver->getTexture("data/2d/menu/top.png") ); // 10
+  data->texture.push_back( (ITexture*)NULL ); // 10
   data->texture.push_back( driver->getTexture("data/2d/menu/mainmenubuttons3.png") );
   data->texture.push_back( driver->getTexture("data/2d/menu/goverment128_grayed.png") );
   data->texture.push_back( driver->getTexture("data/2d/menu/nova128_grayed.png") );
@@ -155,7 +160,18 @@ void CMenu::loadAssets()
   data->texture.push_back( driver->getTexture("data/2d/menu/go.png") );
 
   for(u32 i=0; i < data->texture.size(); ++i)
-    data->texture[i]->grab();
+    if(data->texture[i])
+      data->texture[i]->grab();
+
+  engine::CSpriteBatcher *batcher = Game->getCore()->getRenderer()->getSpriteBatcher();
+
+  data->sprite.set_used(EMS_COUNT);
+  data->sprite[EMS_BACKGROUND] = batcher->addSprite("data/2d/menu/mainmenu.jpg");
+  data->sprite[EMS_BOTTOM_MAIN] = batcher->addSprite("data/2d/menu/bottom1.png");
+  data->sprite[EMS_BOTTOM] = batcher->addSprite("data/2d/menu/bottom2.png");
+  data->sprite[EMS_TOP] = batcher->addSprite("data/2d/menu/top.png");
+
+  batcher->buildAtlases();
 
   // Restore previous state of the flags
   driver->setTextureCreationFlag(video::ETCF_ALWAYS_32_BIT, Previous32BitState);
@@ -192,7 +208,7 @@ void CMenu::update()
 {
   if(!bActive) return;
 
-  irr::video::IVideoDriver *VDriver = Game->getCore()->getRenderer()->getVideoDriver();
+  engine::CSpriteBatcher *batcher = Game->getCore()->getRenderer()->getSpriteBatcher();
 
   irr::core::dimension2d<irr::u16> windowSize = GUI->screenSize;
 
@@ -202,31 +218,34 @@ void CMenu::update()
   // Draw background image
   if(m_Type == EMMT_DEFAULT)
   {
-    VDriver->draw2DImage(
-      data->texture[0],
+    batcher->draw(
+      data->sprite[EMS_BACKGROUND],
       rect<s32>(0,0, windowSize.Width, windowSize.Height),
-      rect<s32>(0,0,1024,1024), 0, 0, true);
+      rect<s32>(0,0,1024,1024));
 
-    ITexture* bottom_tex = (currentlySelectedMenuID == EMI_MAIN_MENU) ?
-      data->texture[2] : data->texture[3];
+    irr::s32 bottom_spr = (currentlySelectedMenuID == EMI_MAIN_MENU) ?
+      data->sprite[EMS_BOTTOM_MAIN] : data->sprite[EMS_BOTTOM];
 
-    VDriver->draw2DImage(
-      bottom_tex,
+    batcher->draw(
+      bottom_spr,
       rect<s32>(sw-1024,sh-64,sw,sh),
-      rect<s32>(0,0, 1024, 64), 0, 0, true);
+      rect<s32>(0,0, 1024, 64));
 
-    VDriver->draw2DImage(
-      data->texture[10],
+    batcher->draw(
+      data->sprite[EMS_TOP],
       rect<s32>(0,0,1024,64),
-      rect<s32>(0,0, 1024, 64), 0, 0, true);
+      rect<s32>(0,0, 1024, 64));
   }
   else if(m_Type == EMMT_IN_GAME)
   {
-    VDriver->draw2DRectangle(
+    batcher->drawRectangle(
       irr::video::SColor(128, 8,8,8),
       irr::core::rect<irr::s32>(0, 0, sw, sh));
   }
 
+  // Buttons and the rest of the menu are drawn on top by the GUI environment
+  batcher->flush();
+
 
 
 
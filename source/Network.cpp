@@ -0,0 +1,1482 @@
+#ifdef _WIN32
+  #include <winsock2.h>
+  typedef int socklen_t;
+#else
+  #include <sys/types.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <netinet/in.h>
+  #include <arpa/inet.h>
+  #include <netdb.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define closesocket close
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Network.h"
+#include "Core.h"
+#include "BaseCharacter.h"
+#include "newton/World.h"
+
+using namespace engine;
+
+// What follows an entity ID in a snapshot
+enum E_NET_ENTITY_OP
+{
+  ENO_END = 0,
+  ENO_NEW,
+  ENO_DELTA,
+  ENO_REMOVE
+};
+
+const irr::u32 NET_LOOPBACK_HOST = 0x7F000001;
+
+static irr::u32 getMicroseconds()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+
+  return irr::u32((counter.QuadPart * 1000000) / frequency.QuadPart);
+#else
+  timeval tv;
+  gettimeofday(&tv, 0);
+
+  return irr::u32(tv.tv_sec * 1000000 + tv.tv_usec);
+#endif
+}
+
+/*
+  Bit packing
+*/
+
+CBitWriter::CBitWriter(irr::u8 *buffer, irr::u32 size)
+{
+  m_Buffer = buffer;
+  m_Size = size;
+  m_Bits = 0;
+  b_Overflow = false;
+}
+
+void CBitWriter::write(irr::u32 value, irr::u32 bits)
+{
+  if(b_Overflow || m_Bits + bits > m_Size * 8)
+  {
+    b_Overflow = true;
+    return;
+  }
+
+  while(bits > 0)
+  {
+    irr::u32 bit = m_Bits & 7;
+    irr::u32 count = irr::core::min_(bits, 8 - bit);
+
+    irr::u8 &byte = m_Buffer[m_Bits >> 3];
+
+    if(bit == 0)
+      byte = 0;
+
+    byte |= irr::u8((value & ((1 << count) - 1)) << bit);
+
+    value >>= count;
+    bits -= count;
+    m_Bits += count;
+  }
+}
+
+void CBitWriter::writeSigned(irr::s32 value, irr::u32 bits)
+{
+  irr::s32 range = 1 << (bits - 1);
+
+  value = irr::core::clamp(value, -range, range - 1);
+
+  write(irr::u32(value) & ((1 << bits) - 1), bits);
+}
+
+CBitReader::CBitReader(const irr::u8 *buffer, irr::u32 size)
+{
+  m_Buffer = buffer;
+  m_Size = size;
+  m_Bits = 0;
+  b_Overflow = false;
+}
+
+irr::u32 CBitReader::read(irr::u32 bits)
+{
+  if(b_Overflow || m_Bits + bits > m_Size * 8)
+  {
+    b_Overflow = true;
+    return 0;
+  }
+
+  irr::u32 value = 0, shift = 0;
+
+  while(bits > 0)
+  {
+    irr::u32 bit = m_Bits & 7;
+    irr::u32 count = irr::core::min_(bits, 8 - bit);
+
+    value |= ((m_Buffer[m_Bits >> 3] >> bit) & ((1 << count) - 1)) << shift;
+
+    shift += count;
+    bits -= count;
+    m_Bits += count;
+  }
+
+  return value;
+}
+
+irr::s32 CBitReader::readSigned(irr::u32 bits)
+{
+  irr::u32 value = read(bits);
+
+  // Sign extend
+  if(value & (1 << (bits - 1)))
+    value |= ~((1 << bits) - 1);
+
+  return irr::s32(value);
+}
+
+/*
+  Quantization
+*/
+
+static irr::s32 quantize(irr::f32 value, irr::f32 precision, irr::u32 bits)
+{
+  irr::s32 range = 1 << (bits - 1);
+
+  return irr::core::clamp(irr::core::round32(value * precision), -range, range - 1);
+}
+
+static irr::u16 quantizeAngle(irr::f32 degrees)
+{
+  irr::u32 steps = 1 << NET_ROTATION_BITS;
+
+  return irr::u16(irr::core::round32(degrees / 360.f * steps) & (steps - 1));
+}
+
+static irr::f32 dequantizeAngle(irr::u16 value)
+{
+  return value * 360.f / (1 << NET_ROTATION_BITS);
+}
+
+static bool isSameState(const SNetEntityState& a, const SNetEntityState& b)
+{
+  for(irr::u32 i=0; i < 3; ++i)
+  {
+    if(a.Position[i] != b.Position[i]
+    || a.Rotation[i] != b.Rotation[i]
+    || a.Velocity[i] != b.Velocity[i])
+      return false;
+  }
+
+  return a.Type == b.Type && a.Health == b.Health && a.States == b.States && a.Team == b.Team;
+}
+
+/*
+  UDP transport
+*/
+
+#ifdef _WIN32
+static irr::u32 WinsockUsers = 0;
+#endif
+
+CUdpTransport::CUdpTransport()
+{
+  m_Socket = -1;
+
+#ifdef _WIN32
+  if(WinsockUsers++ == 0)
+  {
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+  }
+#endif
+}
+
+CUdpTransport::~CUdpTransport()
+{
+  close();
+
+#ifdef _WIN32
+  if(--WinsockUsers == 0)
+    WSACleanup();
+#endif
+}
+
+bool CUdpTransport::open(irr::u16 port)
+{
+  close();
+
+  m_Socket = irr::s32(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+
+  if(m_Socket < 0)
+  {
+    printf("Network: could not create a socket\n");
+    return false;
+  }
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+
+  if(bind(m_Socket, (const sockaddr*)&address, sizeof(address)) < 0)
+  {
+    printf("Network: could not bind to port %d\n", port);
+    close();
+    return false;
+  }
+
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  ioctlsocket(m_Socket, FIONBIO, &nonBlocking);
+#else
+  fcntl(m_Socket, F_SETFL, fcntl(m_Socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+  return true;
+}
+
+void CUdpTransport::close()
+{
+  if(m_Socket >= 0)
+    ::closesocket(m_Socket);
+
+  m_Socket = -1;
+}
+
+bool CUdpTransport::send(const SNetAddress& to, const irr::u8 *data, irr::u32 size)
+{
+  if(m_Socket < 0)
+    return false;
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(to.Host);
+  address.sin_port = htons(to.Port);
+
+  return sendto(m_Socket, (const char*)data, size, 0, (const sockaddr*)&address, sizeof(address)) == irr::s32(size);
+}
+
+irr::u32 CUdpTransport::receive(SNetAddress& from, irr::u8 *data, irr::u32 maxSize)
+{
+  if(m_Socket < 0)
+    return 0;
+
+  sockaddr_in address;
+  socklen_t length = sizeof(address);
+
+  irr::s32 size = recvfrom(m_Socket, (char*)data, maxSize, 0, (sockaddr*)&address, &length);
+
+  if(size <= 0)
+    return 0;
+
+  from.Host = ntohl(address.sin_addr.s_addr);
+  from.Port = ntohs(address.sin_port);
+
+  return irr::u32(size);
+}
+
+bool CUdpTransport::resolve(const irr::c8 *host, irr::u16 port, SNetAddress& out)
+{
+  irr::u32 address = inet_addr(host);
+
+  if(address == INADDR_NONE)
+  {
+    hostent *entry = gethostbyname(host);
+
+    if(!entry || entry->h_addrtype != AF_INET)
+      return false;
+
+    address = *(irr::u32*)entry->h_addr_list[0];
+  }
+
+  out.Host = ntohl(address);
+  out.Port = port;
+
+  return true;
+}
+
+/*
+  Loopback transport
+*/
+
+static irr::core::array<CLoopbackTransport*> LoopbackEndpoints;
+
+static irr::u16 NextLoopbackPort = 49152;
+
+CLoopbackTransport::CLoopbackTransport(irr::u16 port)
+{
+  if(port == 0)
+  {
+    bool used = true;
+
+    while(used)
+    {
+      port = NextLoopbackPort++;
+
+      used = false;
+      for(irr::u32 i=0; i < LoopbackEndpoints.size(); ++i)
+        if(LoopbackEndpoints[i]->m_Address.Port == port)
+          used = true;
+    }
+  }
+
+  m_Address = SNetAddress(NET_LOOPBACK_HOST, port);
+
+  LoopbackEndpoints.push_back(this);
+}
+
+CLoopbackTransport::~CLoopbackTransport()
+{
+  for(irr::u32 i=0; i < LoopbackEndpoints.size(); ++i)
+  {
+    if(LoopbackEndpoints[i] == this)
+    {
+      LoopbackEndpoints.erase(i);
+      break;
+    }
+  }
+}
+
+bool CLoopbackTransport::send(const SNetAddress& to, const irr::u8 *data, irr::u32 size)
+{
+  for(irr::u32 i=0; i < LoopbackEndpoints.size(); ++i)
+  {
+    if(LoopbackEndpoints[i]->m_Address == to)
+    {
+      SPacket packet;
+      packet.From = m_Address;
+      packet.Data.set_used(size);
+      memcpy(packet.Data.pointer(), data, size);
+
+      LoopbackEndpoints[i]->m_Queue.push_back(packet);
+
+      return true;
+    }
+  }
+
+  // Nobody listening, the packet is lost like it would be with UDP
+  return false;
+}
+
+irr::u32 CLoopbackTransport::receive(SNetAddress& from, irr::u8 *data, irr::u32 maxSize)
+{
+  if(m_Queue.empty())
+    return 0;
+
+  irr::core::list<SPacket>::Iterator packet = m_Queue.begin();
+
+  irr::u32 size = irr::core::min_((*packet).Data.size(), maxSize);
+
+  from = (*packet).From;
+  memcpy(data, (*packet).Data.const_pointer(), size);
+
+  m_Queue.erase(packet);
+
+  return size;
+}
+
+/*
+  Network manager
+*/
+
+CNetworkManager::CNetworkManager(CCore * core)
+{
+  Core = core;
+
+  m_Role = ENR_NONE;
+  m_Transport = (INetTransport*)NULL;
+
+  b_Connected = false;
+
+  m_Clients = new SNetClient[NET_MAX_CLIENTS];
+
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+    m_Clients[i].Active = false;
+
+  m_EntityCount = 0;
+
+  m_OwnSlot = -1;
+  b_HasInput = false;
+  m_InputSequence = 0;
+
+  m_Sequence = 0;
+  m_SendRate = NET_SEND_RATE;
+  m_InterestRadius = NET_INTEREST_RADIUS;
+
+  m_Time = m_SendAccumulator = m_LastConnectAttempt = m_LastReceived = 0.f;
+  m_StatsTime = 0.f;
+}
+
+CNetworkManager::~CNetworkManager()
+{
+  stop();
+
+  delete [] m_Clients;
+}
+
+bool CNetworkManager::startServer(irr::u16 port, bool loopback)
+{
+  stop();
+
+  if(loopback)
+  {
+    m_Transport = new CLoopbackTransport(port);
+  }
+  else
+  {
+    CUdpTransport *udp = new CUdpTransport();
+
+    if(!udp->open(port))
+    {
+      delete udp;
+      return false;
+    }
+
+    m_Transport = udp;
+  }
+
+  m_Role = ENR_SERVER;
+  m_Sequence = 0;
+  m_SendAccumulator = 0.f;
+
+  printf("Network: server listening on %s port %d, %d snapshots/sec\n",
+    loopback ? "loopback" : "UDP", port, m_SendRate);
+
+  return true;
+}
+
+bool CNetworkManager::startClient(const irr::c8 *host, irr::u16 port, bool loopback)
+{
+  stop();
+
+  if(loopback)
+  {
+    m_Transport = new CLoopbackTransport(0);
+    m_ServerAddress = SNetAddress(NET_LOOPBACK_HOST, port);
+  }
+  else
+  {
+    if(!CUdpTransport::resolve(host, port, m_ServerAddress))
+    {
+      printf("Network: could not resolve %s\n", host);
+      return false;
+    }
+
+    CUdpTransport *udp = new CUdpTransport();
+
+    if(!udp->open(0))
+    {
+      delete udp;
+      return false;
+    }
+
+    m_Transport = udp;
+  }
+
+  m_Role = ENR_CLIENT;
+  m_Sequence = 0;
+  m_SendAccumulator = 0.f;
+  b_Connected = false;
+
+  b_HasInput = false;
+  m_InputSequence = 0;
+
+  for(irr::u32 i=0; i < NET_SNAPSHOT_HISTORY; ++i)
+    m_Received[i].Valid = false;
+
+  // Connect on the next update
+  m_LastConnectAttempt = m_Time - NET_CONNECT_RETRY;
+
+  printf("Network: connecting to %s:%d%s\n", host, port, loopback ? " (loopback)" : "");
+
+  return true;
+}
+
+void CNetworkManager::stop()
+{
+  if(m_Role == ENR_SERVER)
+  {
+    for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+    {
+      if(m_Clients[i].Active)
+        sendSimple(m_Clients[i].Address, ENP_DISCONNECT, 0, 0);
+
+      m_Clients[i].Active = false;
+    }
+  }
+  else if(m_Role == ENR_CLIENT && b_Connected)
+  {
+    sendSimple(m_ServerAddress, ENP_DISCONNECT, 0, 0);
+  }
+
+  delete m_Transport;
+  m_Transport = (INetTransport*)NULL;
+
+  m_Role = ENR_NONE;
+  b_Connected = false;
+}
+
+bool CNetworkManager::addEntity(irr::u16 id, const SNetEntity& entity)
+{
+  if(id >= NET_MAX_ENTITIES)
+    return false;
+
+  if(id < m_Entities.size() && m_Entities[id].Used)
+    return false;
+
+  while(m_Entities.size() <= id)
+  {
+    SNetEntity unused;
+    unused.Used = false;
+    unused.Type = ENE_BODY;
+    unused.Character = (CBaseCharacter*)NULL;
+    unused.Body = (physics::CBody*)NULL;
+    unused.HasState = false;
+
+    m_Entities.push_back(unused);
+  }
+
+  m_Entities[id] = entity;
+
+  ++m_EntityCount;
+
+  return true;
+}
+
+bool CNetworkManager::addCharacter(CBaseCharacter *character, irr::u16 id)
+{
+  SNetEntity entity;
+  entity.Used = true;
+  entity.Type = ENE_CHARACTER;
+  entity.Character = character;
+  entity.Body = character->getBody()->PhysicsBody;
+  entity.HasState = false;
+
+  if(!addEntity(id, entity))
+    return false;
+
+  // The player starts at its own ID, until the server gives it a character
+  if(m_Role == ENR_CLIENT && id == NET_ID_PLAYER)
+    m_OwnSlot = id;
+
+  return true;
+}
+
+bool CNetworkManager::addBody(physics::CBody *body, irr::u16 id)
+{
+  SNetEntity entity;
+  entity.Used = true;
+  entity.Type = ENE_BODY;
+  entity.Character = (CBaseCharacter*)NULL;
+  entity.Body = body;
+  entity.HasState = false;
+
+  return addEntity(id, entity);
+}
+
+bool CNetworkManager::addReplica(irr::u16 id, E_NET_ENTITY_TYPE type)
+{
+  // The server captures the state from the objects
+  if(m_Role == ENR_SERVER)
+    return false;
+
+  SNetEntity entity;
+  entity.Used = true;
+  entity.Type = type;
+  entity.Character = (CBaseCharacter*)NULL;
+  entity.Body = (physics::CBody*)NULL;
+  entity.HasState = false;
+
+  return addEntity(id, entity);
+}
+
+const SNetEntityState *CNetworkManager::getState(irr::u16 id)
+{
+  if(id >= m_Entities.size() || !m_Entities[id].Used || !m_Entities[id].HasState)
+    return (SNetEntityState*)NULL;
+
+  return &m_Entities[id].State;
+}
+
+void CNetworkManager::clearEntities()
+{
+  m_Entities.clear();
+  m_State.clear();
+
+  m_EntityCount = 0;
+
+  m_OwnSlot = -1;
+
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+    m_Clients[i].Focus = -1;
+}
+
+void CNetworkManager::setInput(const SNetInput& input)
+{
+  bool jump = input.Jump || (b_HasInput && m_Input.Jump);
+
+  m_Input = input;
+  m_Input.Jump = jump;
+
+  b_HasInput = true;
+}
+
+bool CNetworkManager::getInput(CBaseCharacter *character, SNetInput& input)
+{
+  if(m_Role != ENR_SERVER)
+    return false;
+
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+  {
+    SNetClient &client = m_Clients[i];
+
+    if(!client.Active || !client.HasInput || client.Focus < 0 || client.Focus >= irr::s32(m_Entities.size()))
+      continue;
+
+    if(m_Entities[client.Focus].Character != character)
+      continue;
+
+    input = client.Input;
+    client.Input.Jump = false;
+
+    return true;
+  }
+
+  return false;
+}
+
+irr::u32 CNetworkManager::getClientCount()
+{
+  irr::u32 count = 0;
+
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+    if(m_Clients[i].Active)
+      ++count;
+
+  return count;
+}
+
+void CNetworkManager::update(irr::f32 delta)
+{
+  if(m_Role == ENR_NONE)
+    return;
+
+  m_Time += delta;
+
+  m_StatsTime += delta;
+  if(m_StatsTime >= 1.f)
+  {
+    m_LastStats = m_Stats;
+    m_Stats.reset();
+    m_StatsTime = 0.f;
+  }
+
+  receivePackets();
+
+  if(m_Role == ENR_CLIENT)
+  {
+    if(b_Connected && m_Time - m_LastReceived > NET_TIMEOUT)
+    {
+      printf("Network: connection to the server timed out\n");
+      b_Connected = false;
+    }
+
+    if(!b_Connected && m_Time - m_LastConnectAttempt >= NET_CONNECT_RETRY)
+    {
+      m_LastConnectAttempt = m_Time;
+      sendSimple(m_ServerAddress, ENP_CONNECT, NET_PROTOCOL_ID, 32);
+    }
+
+    // Input goes out at the send rate as well
+    if(b_Connected && b_HasInput)
+    {
+      m_SendAccumulator += delta;
+
+      if(m_SendAccumulator >= 1.f / m_SendRate)
+      {
+        m_SendAccumulator = 0.f;
+        sendInput();
+      }
+    }
+
+    return;
+  }
+
+  checkTimeouts();
+
+  // Snapshots go out at the send rate, not every tick
+  irr::f32 interval = 1.f / m_SendRate;
+
+  m_SendAccumulator += delta;
+  if(m_SendAccumulator < interval)
+    return;
+
+  m_SendAccumulator -= interval;
+  if(m_SendAccumulator >= interval)
+    m_SendAccumulator = 0.f;
+
+  if(getClientCount() == 0)
+    return;
+
+  ++m_Sequence;
+
+  irr::u32 start = getMicroseconds();
+
+  captureState();
+
+  m_Stats.SerializeMicroseconds += getMicroseconds() - start;
+
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+  {
+    if(!m_Clients[i].Active)
+      continue;
+
+    if(m_Clients[i].Focus < 0)
+      assignFocus(m_Clients[i]);
+
+    sendSnapshot(m_Clients[i]);
+  }
+}
+
+void CNetworkManager::receivePackets()
+{
+  irr::u8 buffer[NET_MAX_PACKET_SIZE];
+  SNetAddress from;
+
+  irr::u32 size;
+
+  while((size = m_Transport->receive(from, buffer, NET_MAX_PACKET_SIZE)) > 0)
+  {
+    m_Stats.BytesReceived += size;
+    ++m_Stats.PacketsReceived;
+
+    CBitReader reader(buffer, size);
+
+    irr::u32 type = reader.read(8);
+
+    if(m_Role == ENR_SERVER)
+      handleServerPacket(from, reader, type);
+    else
+      handleClientPacket(from, reader, type);
+
+    // Handlers can stop the manager
+    if(!m_Transport)
+      break;
+  }
+}
+
+void CNetworkManager::handleServerPacket(const SNetAddress& from, CBitReader& reader, irr::u32 type)
+{
+  SNetClient *client = (SNetClient*)NULL;
+
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+    if(m_Clients[i].Active && m_Clients[i].Address == from)
+      client = &m_Clients[i];
+
+  if(client)
+    client->LastReceived = m_Time;
+
+  if(type == ENP_CONNECT)
+  {
+    if(reader.read(32) != NET_PROTOCOL_ID)
+      return;
+
+    // Accept got lost, send it again
+    if(client)
+    {
+      sendSimple(from, ENP_ACCEPT, irr::u32(client - m_Clients), 8);
+      return;
+    }
+
+    for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+    {
+      if(m_Clients[i].Active)
+        continue;
+
+      client = &m_Clients[i];
+      client->Active = true;
+      client->Address = from;
+      client->Focus = -1;
+      client->HasAck = false;
+      client->LastAck = 0;
+      client->LastReceived = m_Time;
+      client->HasInput = false;
+      client->InputSequence = 0;
+
+      for(irr::u32 j=0; j < NET_SNAPSHOT_HISTORY; ++j)
+        client->History[j].Valid = false;
+
+      assignFocus(*client);
+
+      printf("Network: client %d connected, controlling entity %d\n", i, client->Focus);
+
+      sendSimple(from, ENP_ACCEPT, i, 8);
+      return;
+    }
+
+    sendSimple(from, ENP_REJECT, 0, 0);
+  }
+  else if(!client)
+  {
+    return;
+  }
+  else if(type == ENP_ACK)
+  {
+    irr::u32 sequence = reader.read(32);
+
+    if(reader.isOverflow() || sequence > m_Sequence)
+      return;
+
+    if(!client->HasAck || sequence > client->LastAck)
+    {
+      client->LastAck = sequence;
+      client->HasAck = true;
+    }
+  }
+  else if(type == ENP_INPUT)
+  {
+    irr::u32 sequence = reader.read(32);
+
+    SNetInput input;
+    input.Forward = irr::s8(reader.readSigned(2));
+    input.Right = irr::s8(reader.readSigned(2));
+    input.Heading = dequantizeAngle(irr::u16(reader.read(NET_ROTATION_BITS)));
+    input.Jump = reader.readBool();
+
+    // Inputs arriving late are older than the one in use
+    if(reader.isOverflow() || (client->HasInput && sequence <= client->InputSequence))
+      return;
+
+    // Not lost when the next input arrives before the character took it
+    input.Jump = input.Jump || (client->HasInput && client->Input.Jump);
+
+    client->Input = input;
+    client->InputSequence = sequence;
+    client->HasInput = true;
+  }
+  else if(type == ENP_DISCONNECT)
+  {
+    printf("Network: client %d disconnected\n", irr::u32(client - m_Clients));
+    client->Active = false;
+  }
+}
+
+void CNetworkManager::handleClientPacket(const SNetAddress& from, CBitReader& reader, irr::u32 type)
+{
+  if(from != m_ServerAddress)
+    return;
+
+  m_LastReceived = m_Time;
+
+  if(type == ENP_ACCEPT)
+  {
+    if(!b_Connected)
+      printf("Network: connected as client %d\n", reader.read(8));
+
+    b_Connected = true;
+  }
+  else if(type == ENP_REJECT)
+  {
+    printf("Network: server is full\n");
+    stop();
+  }
+  else if(type == ENP_DISCONNECT)
+  {
+    printf("Network: server closed the connection\n");
+    stop();
+  }
+  else if(type == ENP_SNAPSHOT && b_Connected)
+  {
+    readSnapshot(reader);
+  }
+}
+
+void CNetworkManager::sendPacket(const SNetAddress& to, CBitWriter& writer, irr::u8 *buffer)
+{
+  if(writer.isOverflow())
+    return;
+
+  if(m_Transport->send(to, buffer, writer.getBytes()))
+  {
+    m_Stats.BytesSent += writer.getBytes();
+    ++m_Stats.PacketsSent;
+  }
+}
+
+void CNetworkManager::sendSimple(const SNetAddress& to, E_NET_PACKET type, irr::u32 value, irr::u32 bits)
+{
+  irr::u8 buffer[8];
+
+  CBitWriter writer(buffer, sizeof(buffer));
+  writer.write(type, 8);
+
+  if(bits > 0)
+    writer.write(value, bits);
+
+  sendPacket(to, writer, buffer);
+}
+
+void CNetworkManager::sendInput()
+{
+  irr::u8 buffer[16];
+
+  CBitWriter writer(buffer, sizeof(buffer));
+  writer.write(ENP_INPUT, 8);
+  writer.write(++m_InputSequence, 32);
+  writer.writeSigned(m_Input.Forward, 2);
+  writer.writeSigned(m_Input.Right, 2);
+  writer.write(quantizeAngle(m_Input.Heading), NET_ROTATION_BITS);
+  writer.writeBool(m_Input.Jump);
+
+  sendPacket(m_ServerAddress, writer, buffer);
+
+  m_Input.Jump = false;
+}
+
+void CNetworkManager::captureState()
+{
+  m_State.set_used(m_Entities.size());
+
+  for(irr::u32 i=0; i < m_Entities.size(); ++i)
+  {
+    SNetEntity &entity = m_Entities[i];
+    SNetEntityState &state = m_State[i];
+
+    state.ID = i;
+    state.Type = entity.Type;
+
+    if(!entity.Used)
+      continue;
+
+    irr::core::vector3df position = entity.Body->getPosition();
+    irr::core::vector3df velocity = entity.Body->getVelocity();
+    irr::core::vector3df rotation;
+
+    if(entity.Type == ENE_CHARACTER)
+    {
+      SCharacterParameters *parameters = entity.Character->getParameters();
+
+      rotation = entity.Character->getBody()->Node->getRotation();
+
+      state.Health = parameters->HealthMax > 0.f ?
+        irr::u8(irr::core::clamp(parameters->Health / parameters->HealthMax, 0.f, 1.f) * 255.f) : 0;
+      state.States = irr::u16(parameters->States);
+      state.Team = irr::u8(parameters->TeamID);
+    }
+    else
+    {
+      rotation = entity.Body->getNode()->getRotation();
+
+      state.Health = 255;
+      state.States = 0;
+      state.Team = 0;
+    }
+
+    state.Position[0] = quantize(position.X, NET_POSITION_PRECISION, NET_POSITION_BITS);
+    state.Position[1] = quantize(position.Y, NET_POSITION_PRECISION, NET_POSITION_BITS);
+    state.Position[2] = quantize(position.Z, NET_POSITION_PRECISION, NET_POSITION_BITS);
+
+    state.Rotation[0] = quantizeAngle(rotation.X);
+    state.Rotation[1] = quantizeAngle(rotation.Y);
+    state.Rotation[2] = quantizeAngle(rotation.Z);
+
+    state.Velocity[0] = quantize(velocity.X, NET_VELOCITY_PRECISION, NET_VELOCITY_BITS);
+    state.Velocity[1] = quantize(velocity.Y, NET_VELOCITY_PRECISION, NET_VELOCITY_BITS);
+    state.Velocity[2] = quantize(velocity.Z, NET_VELOCITY_PRECISION, NET_VELOCITY_BITS);
+  }
+}
+
+void CNetworkManager::sendSnapshot(SNetClient& client)
+{
+  irr::u32 start = getMicroseconds();
+
+  SNetSnapshot &current = client.History[m_Sequence % NET_SNAPSHOT_HISTORY];
+  current.Sequence = m_Sequence;
+  current.Valid = true;
+  current.Entities.set_used(0);
+
+  // Delta against the newest snapshot the client is known to have
+  const SNetSnapshot *baseline = (SNetSnapshot*)NULL;
+
+  if(client.HasAck && m_Sequence - client.LastAck < NET_SNAPSHOT_HISTORY)
+  {
+    const SNetSnapshot &acked = client.History[client.LastAck % NET_SNAPSHOT_HISTORY];
+
+    if(acked.Valid && acked.Sequence == client.LastAck)
+      baseline = &acked;
+  }
+
+  irr::u8 buffer[NET_MAX_PACKET_SIZE];
+
+  CBitWriter writer(buffer, NET_MAX_PACKET_SIZE);
+  writer.write(ENP_SNAPSHOT, 8);
+  writer.write(m_Sequence, 32);
+
+  // Character the client controls
+  writer.writeBool(client.Focus >= 0);
+
+  if(client.Focus >= 0)
+    writer.write(client.Focus, NET_ENTITY_ID_BITS);
+
+  writer.writeBool(baseline != NULL);
+
+  if(baseline)
+    writer.write(m_Sequence - baseline->Sequence, 8);
+
+  // Interest area around the followed character, in quantized units
+  bool everything = client.Focus < 0 || client.Focus >= irr::s32(m_State.size());
+  irr::f32 radius = m_InterestRadius * NET_POSITION_PRECISION;
+  irr::f32 radiusSQ = radius * radius;
+
+  irr::u32 b = 0;
+  irr::s32 lastID = -1;
+  bool packetFull = false;
+
+  for(irr::u32 i=0; i < m_State.size(); ++i)
+  {
+    const SNetEntityState &state = m_State[i];
+
+    const SNetEntityState *old = (SNetEntityState*)NULL;
+
+    if(baseline && b < baseline->Entities.size() && baseline->Entities[b].ID == i)
+      old = &baseline->Entities[b++];
+
+    bool registered = m_Entities[i].Used;
+    bool visible = registered && (everything || irr::s32(i) == client.Focus);
+
+    if(registered && !visible)
+    {
+      const SNetEntityState &focus = m_State[client.Focus];
+
+      irr::f32 dx = irr::f32(state.Position[0] - focus.Position[0]);
+      irr::f32 dy = irr::f32(state.Position[1] - focus.Position[1]);
+      irr::f32 dz = irr::f32(state.Position[2] - focus.Position[2]);
+
+      visible = dx*dx + dy*dy + dz*dz <= radiusSQ;
+    }
+
+    if(!visible && !old)
+      continue;
+
+    // Unchanged entities cost nothing
+    if(visible && old && isSameState(state, *old))
+    {
+      current.Entities.push_back(state);
+      continue;
+    }
+
+    if(!packetFull && writer.getBitsLeft() < NET_MAX_ENTITY_BITS + 2)
+      packetFull = true;
+
+    // No room left, the client keeps what it had
+    if(packetFull)
+    {
+      if(old)
+        current.Entities.push_back(*old);
+
+      if(visible)
+        ++m_Stats.EntitiesDeferred;
+
+      continue;
+    }
+
+    writer.write(!visible ? ENO_REMOVE : (old ? ENO_DELTA : ENO_NEW), 2);
+
+    writer.writeBool(irr::s32(i) == lastID + 1);
+    if(irr::s32(i) != lastID + 1)
+      writer.write(i, NET_ENTITY_ID_BITS);
+
+    lastID = i;
+
+    if(!visible)
+      continue;
+
+    writeEntity(writer, state, old);
+
+    current.Entities.push_back(state);
+
+    ++m_Stats.EntitiesSent;
+  }
+
+  // Entities that were unregistered since the baseline
+  for(; baseline && b < baseline->Entities.size(); ++b)
+  {
+    irr::u32 id = baseline->Entities[b].ID;
+
+    if(packetFull || writer.getBitsLeft() < NET_ENTITY_ID_BITS + 5)
+    {
+      current.Entities.push_back(baseline->Entities[b]);
+      continue;
+    }
+
+    writer.write(ENO_REMOVE, 2);
+    writer.writeBool(false);
+    writer.write(id, NET_ENTITY_ID_BITS);
+  }
+
+  writer.write(ENO_END, 2);
+
+  if(baseline)
+    ++m_Stats.DeltaSnapshots;
+  else
+    ++m_Stats.FullSnapshots;
+
+  m_Stats.SerializeMicroseconds += getMicroseconds() - start;
+
+  sendPacket(client.Address, writer, buffer);
+}
+
+void CNetworkManager::writeEntity(CBitWriter& writer, const SNetEntityState& state, const SNetEntityState *baseline)
+{
+  if(!baseline)
+  {
+    writer.write(state.Type, 2);
+
+    for(irr::u32 i=0; i < 3; ++i)
+      writer.writeSigned(state.Position[i], NET_POSITION_BITS);
+
+    for(irr::u32 i=0; i < 3; ++i)
+      writer.write(state.Rotation[i], NET_ROTATION_BITS);
+
+    for(irr::u32 i=0; i < 3; ++i)
+      writer.writeSigned(state.Velocity[i], NET_VELOCITY_BITS);
+
+    writer.write(state.Health, 8);
+    writer.write(state.States, 16);
+    writer.write(state.Team, NET_TEAM_BITS);
+
+    return;
+  }
+
+  // Position, small moves are sent relative to the baseline
+  irr::s32 range = 1 << (NET_POSITION_DELTA_BITS - 1);
+
+  bool moved = false, small = true;
+
+  for(irr::u32 i=0; i < 3; ++i)
+  {
+    irr::s32 d = state.Position[i] - baseline->Position[i];
+
+    if(d != 0)
+      moved = true;
+
+    if(d < -range || d >= range)
+      small = false;
+  }
+
+  writer.writeBool(moved);
+
+  if(moved)
+  {
+    writer.writeBool(small);
+
+    for(irr::u32 i=0; i < 3; ++i)
+    {
+      if(small)
+        writer.writeSigned(state.Position[i] - baseline->Position[i], NET_POSITION_DELTA_BITS);
+      else
+        writer.writeSigned(state.Position[i], NET_POSITION_BITS);
+    }
+  }
+
+  bool rotated = state.Rotation[0] != baseline->Rotation[0]
+    || state.Rotation[1] != baseline->Rotation[1]
+    || state.Rotation[2] != baseline->Rotation[2];
+
+  writer.writeBool(rotated);
+
+  if(rotated)
+    for(irr::u32 i=0; i < 3; ++i)
+      writer.write(state.Rotation[i], NET_ROTATION_BITS);
+
+  bool accelerated = state.Velocity[0] != baseline->Velocity[0]
+    || state.Velocity[1] != baseline->Velocity[1]
+    || state.Velocity[2] != baseline->Velocity[2];
+
+  writer.writeBool(accelerated);
+
+  if(accelerated)
+    for(irr::u32 i=0; i < 3; ++i)
+      writer.writeSigned(state.Velocity[i], NET_VELOCITY_BITS);
+
+  bool other = state.Health != baseline->Health
+    || state.States != baseline->States
+    || state.Team != baseline->Team;
+
+  writer.writeBool(other);
+
+  if(other)
+  {
+    writer.write(state.Health, 8);
+    writer.write(state.States, 16);
+    writer.write(state.Team, NET_TEAM_BITS);
+  }
+}
+
+bool CNetworkManager::readEntity(CBitReader& reader, SNetEntityState& state, const SNetEntityState *baseline)
+{
+  if(!baseline)
+  {
+    state.Type = irr::u8(reader.read(2));
+
+    for(irr::u32 i=0; i < 3; ++i)
+      state.Position[i] = reader.readSigned(NET_POSITION_BITS);
+
+    for(irr::u32 i=0; i < 3; ++i)
+      state.Rotation[i] = irr::u16(reader.read(NET_ROTATION_BITS));
+
+    for(irr::u32 i=0; i < 3; ++i)
+      state.Velocity[i] = reader.readSigned(NET_VELOCITY_BITS);
+
+    state.Health = irr::u8(reader.read(8));
+    state.States = irr::u16(reader.read(16));
+    state.Team = irr::u8(reader.read(NET_TEAM_BITS));
+
+    return !reader.isOverflow();
+  }
+
+  irr::u16 id = state.ID;
+  state = *baseline;
+  state.ID = id;
+
+  if(reader.readBool())
+  {
+    bool small = reader.readBool();
+
+    for(irr::u32 i=0; i < 3; ++i)
+    {
+      if(small)
+        state.Position[i] = baseline->Position[i] + reader.readSigned(NET_POSITION_DELTA_BITS);
+      else
+        state.Position[i] = reader.readSigned(NET_POSITION_BITS);
+    }
+  }
+
+  if(reader.readBool())
+    for(irr::u32 i=0; i < 3; ++i)
+      state.Rotation[i] = irr::u16(reader.read(NET_ROTATION_BITS));
+
+  if(reader.readBool())
+    for(irr::u32 i=0; i < 3; ++i)
+      state.Velocity[i] = reader.readSigned(NET_VELOCITY_BITS);
+
+  if(reader.readBool())
+  {
+    state.Health = irr::u8(reader.read(8));
+    state.States = irr::u16(reader.read(16));
+    state.Team = irr::u8(reader.read(NET_TEAM_BITS));
+  }
+
+  return !reader.isOverflow();
+}
+
+void CNetworkManager::readSnapshot(CBitReader& reader)
+{
+  irr::u32 start = getMicroseconds();
+
+  irr::u32 sequence = reader.read(32);
+
+  irr::s32 own = reader.readBool() ? irr::s32(reader.read(NET_ENTITY_ID_BITS)) : -1;
+
+  const SNetSnapshot *baseline = (SNetSnapshot*)NULL;
+
+  if(reader.readBool())
+  {
+    irr::u32 baseSequence = sequence - reader.read(8);
+
+    const SNetSnapshot &stored = m_Received[baseSequence % NET_SNAPSHOT_HISTORY];
+
+    // Baseline is gone, wait for the server to notice and send a full snapshot
+    if(!stored.Valid || stored.Sequence != baseSequence)
+      return;
+
+    baseline = &stored;
+  }
+
+  SNetSnapshot snapshot;
+  snapshot.Sequence = sequence;
+
+  irr::u32 b = 0;
+  irr::s32 lastID = -1;
+
+  while(true)
+  {
+    irr::u32 op = reader.read(2);
+
+    if(reader.isOverflow())
+      return;
+
+    if(op == ENO_END)
+      break;
+
+    irr::s32 id = reader.readBool() ? lastID + 1 : irr::s32(reader.read(NET_ENTITY_ID_BITS));
+
+    if(id <= lastID)
+      return;
+
+    lastID = id;
+
+    // Entities that weren't mentioned didn't change
+    while(baseline && b < baseline->Entities.size() && baseline->Entities[b].ID < id)
+      snapshot.Entities.push_back(baseline->Entities[b++]);
+
+    const SNetEntityState *old = (SNetEntityState*)NULL;
+
+    if(baseline && b < baseline->Entities.size() && baseline->Entities[b].ID == id)
+      old = &baseline->Entities[b++];
+
+    if(op == ENO_REMOVE)
+      continue;
+
+    if(op == ENO_DELTA && !old)
+      return;
+
+    SNetEntityState state;
+    state.ID = irr::u16(id);
+
+    if(!readEntity(reader, state, op == ENO_DELTA ? old : (SNetEntityState*)NULL))
+      return;
+
+    snapshot.Entities.push_back(state);
+  }
+
+  for(; baseline && b < baseline->Entities.size(); ++b)
+    snapshot.Entities.push_back(baseline->Entities[b]);
+
+  snapshot.Valid = true;
+
+  m_Received[sequence % NET_SNAPSHOT_HISTORY] = snapshot;
+
+  sendSimple(m_ServerAddress, ENP_ACK, sequence, 32);
+
+  // Late packets are only kept as baselines
+  if(sequence > m_Sequence)
+  {
+    m_Sequence = sequence;
+
+    bindOwnCharacter(own);
+    applySnapshot(snapshot);
+  }
+
+  m_Stats.DeserializeMicroseconds += getMicroseconds() - start;
+}
+
+void CNetworkManager::applySnapshot(const SNetSnapshot& snapshot)
+{
+  for(irr::u32 i=0; i < m_Entities.size(); ++i)
+    m_Entities[i].HasState = false;
+
+  for(irr::u32 i=0; i < snapshot.Entities.size(); ++i)
+  {
+    const SNetEntityState &state = snapshot.Entities[i];
+
+    // Entity not registered on this side
+    if(state.ID >= m_Entities.size() || !m_Entities[state.ID].Used || m_Entities[state.ID].Type != state.Type)
+      continue;
+
+    SNetEntity &entity = m_Entities[state.ID];
+
+    entity.State = state;
+    entity.HasState = true;
+
+    if(!entity.Body)
+      continue;
+
+    irr::core::vector3df position(
+      state.Position[0] / NET_POSITION_PRECISION,
+      state.Position[1] / NET_POSITION_PRECISION,
+      state.Position[2] / NET_POSITION_PRECISION);
+
+    irr::core::vector3df rotation(
+      dequantizeAngle(state.Rotation[0]),
+      dequantizeAngle(state.Rotation[1]),
+      dequantizeAngle(state.Rotation[2]));
+
+    irr::core::vector3df velocity(
+      state.Velocity[0] / NET_VELOCITY_PRECISION,
+      state.Velocity[1] / NET_VELOCITY_PRECISION,
+      state.Velocity[2] / NET_VELOCITY_PRECISION);
+
+    entity.Body->setPosition(position);
+    entity.Body->setVelocity(velocity);
+
+    if(entity.Type == ENE_CHARACTER)
+    {
+      SCharacterParameters *parameters = entity.Character->getParameters();
+
+      // Heading comes from the character node, the body stays upright.
+      // The player turns with the local view, the server follows its input.
+      if(irr::s32(state.ID) != m_OwnSlot)
+        entity.Character->getBody()->Node->setRotation(rotation);
+
+      parameters->Health = state.Health / 255.f * parameters->HealthMax;
+      parameters->States = state.States;
+      parameters->TeamID = state.Team;
+    }
+    else
+    {
+      entity.Body->setRotation(rotation);
+    }
+  }
+}
+
+void CNetworkManager::assignFocus(SNetClient& client)
+{
+  client.Focus = -1;
+
+  // The server's own player is never given away
+  for(irr::u32 i=NET_ID_PLAYER + 1; i < m_Entities.size(); ++i)
+  {
+    if(!m_Entities[i].Used || m_Entities[i].Type != ENE_CHARACTER)
+      continue;
+
+    bool taken = false;
+
+    for(irr::u32 j=0; j < NET_MAX_CLIENTS; ++j)
+      if(m_Clients[j].Active && &m_Clients[j] != &client && m_Clients[j].Focus == irr::s32(i))
+        taken = true;
+
+    if(!taken)
+    {
+      client.Focus = i;
+      return;
+    }
+  }
+}
+
+void CNetworkManager::bindOwnCharacter(irr::s32 id)
+{
+  if(m_OwnSlot < 0 || id < 0 || id == m_OwnSlot || id >= irr::s32(m_Entities.size()))
+    return;
+
+  // The local copy of that character takes the player's old ID, the player takes its ID
+  SNetEntity player = m_Entities[m_OwnSlot];
+  m_Entities[m_OwnSlot] = m_Entities[id];
+  m_Entities[id] = player;
+
+  m_OwnSlot = id;
+
+  printf("Network: controlling entity %d\n", id);
+}
+
+void CNetworkManager::checkTimeouts()
+{
+  for(irr::u32 i=0; i < NET_MAX_CLIENTS; ++i)
+  {
+    if(m_Clients[i].Active && m_Time - m_Clients[i].LastReceived > NET_TIMEOUT)
+    {
+      printf("Network: client %d timed out\n", i);
+      m_Clients[i].Active = false;
+    }
+  }
+}
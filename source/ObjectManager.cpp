@@ -8,6 +8,7 @@
 #include "SoundManager.h"
 #include "Door.h"
 #include "TerrainNode.h"
+#include "Pathfinder.h"
 
 #include <string>
 #include <fstream>
@@ -38,7 +39,11 @@ const irr::u32 GRASS_MESH_BUFFER_COUNT = 10;
 
 CObjectManager::CObjectManager(CCore * core) : Core(core)
 {
-  Vehicles = new engine::CVehicleManager();
+#ifdef MICROPATHER
+  Pathfinder = new engine::CPathfinder(Core);
+#else
+  Pathfinder = (engine::CPathfinder*) NULL;
+#endif
 
   grassWave[0] = grassWave[1] = 0.f;
 
@@ -66,14 +71,17 @@ CObjectManager::~CObjectManager()
 {
   clearAll(true);
 
-  delete Vehicles;
+#ifdef MICROPATHER
+  delete Pathfinder;
+#endif
 }
 
 
 
 void CObjectManager::findAndApplyShaderMaterials(irr::scene::IMeshSceneNode *node)
 {
-    irr::s32 lightmapShader = -1;
+    // One program for all lightmapped materials
+    static irr::s32 lightmapShader = -1;
 
     // Replace certain materials
     for(irr::u32 i=0; i < node->getMaterialCount(); ++i)
@@ -126,6 +134,9 @@ void CObjectManager::findAndApplyShaderMaterials(irr::scene::IMeshSceneNode *nod
                 node->setMaterialTexture(1,
                   Core->getRenderer()->getVideoDriver()->getTexture("data/terrain/groundplants.jpg"));
 
+                if(Core->getRenderer()->getShadows()->isEnabled())
+                  node->getMaterial(i).setTexture(SHADOW_TEXTURE_SLOT, Core->getRenderer()->getShadows()->getTexture());
+
                 node->getMaterial(i).setFlag(EMF_LIGHTING, false);
                 node->getMaterial(i).MaterialType = (E_MATERIAL_TYPE)newmat;
             }
@@ -144,18 +155,44 @@ void CObjectManager::findAndApplyShaderMaterials(irr::scene::IMeshSceneNode *nod
 
         if(node->getMaterial(i).MaterialType == irr::video::EMT_LIGHTMAP)
         {
-          if(lightmapShader == -1)
+          node->getMaterial(i).setFlag(EMF_LIGHTING, false);
+
+          // The fixed function lightmap can't write the G-buffer of the dynamic lights
+          if(Core->getRenderer()->getLights()->isEnabled())
           {
-            //lightmapShader = Core->getRenderer()->getShaders()->createLightmapShader();
-          }
+            if(lightmapShader == -1)
+              lightmapShader = Core->getRenderer()->getShaders()->createLightmapShader();
 
-          node->getMaterial(i).setFlag(EMF_LIGHTING, false);
-          //node->getMaterial(i).MaterialType = (E_MATERIAL_TYPE)lightmapShader;
+            if(lightmapShader > 0)
+              node->getMaterial(i).MaterialType = (E_MATERIAL_TYPE)lightmapShader;
+          }
         }
 
     }
 }
 
+bool CObjectManager::getsShaderMaterial(irr::scene::IMeshSceneNode *node)
+{
+  for(irr::u32 i=0; i < node->getMaterialCount(); ++i)
+  {
+    irr::video::ITexture* MaterialTexture = node->getMaterial(i).getTexture(0);
+
+    if(MaterialTexture)
+    {
+      irr::core::stringc texName = MaterialTexture->getName();
+
+      if(texName.subString(texName.size()-7, 3).equals_ignore_case("_mt"))
+        return true;
+    }
+
+    if(node->getMaterial(i).MaterialType == irr::video::EMT_LIGHTMAP
+    && Core->getRenderer()->getLights()->isEnabled())
+      return true;
+  }
+
+  return false;
+}
+
 void CObjectManager::regenerateGrassMesh(irr::core::vector3df position)
 {
 #ifndef GRASS_2
@@ -358,6 +395,7 @@ void CObjectManager::loadGrassFromFile2(const irr::c8* gFile)
     Core->getRenderer()->getSceneManager(),
     9999);
   gNode->setAutomaticCulling(EAC_OFF);
+  gNode->setJobs(Core->getJobs());
 
   gNode->addReferenceMesh("data/foilage/grass1_v2.ms3d");
   gNode->addReferenceMesh("data/foilage/grass2.ms3d");
@@ -468,8 +506,8 @@ void CObjectManager::loadGrassFromFile(const irr::c8* gFile)
 
   irr::u16 grass_skipped = 0;
   irr::u16 grass_density = Core->getConfiguration()->getVideo()->grassDensity;
-  bool geomShaderEnabled = (Core->getConfiguration()->getVideo()->geomShaderGrass > 0);
-  irr::video::ITexture* shadowMap = ((scene::IMeshSceneNode*)getSceneNodeFromName(getNodeFullName("Terrain").c_str()))->getMesh()->getMeshBuffer(0)->getMaterial().getTexture(0);
+  bool geomShaderEnabled = (Core->getConfiguration()->getVideo()->geomShaderGrass > 0);
+  irr::video::ITexture* shadowMap = Core->getRenderer()->getShadows()->getTexture();
 
   disableLowDetail = false;
   disableMediumDetail = false;
@@ -1957,7 +1995,8 @@ void CObjectManager::checkChildren(ISceneNode *parent)
       {
         irr::core::stringc n_name = irr::core::stringc(node->getName());
 
-        if(isNodeParameterSet(n_name, "n") || isNodeParameterSet(n_name, "d"))
+        if(isNodeParameterSet(n_name, "n") || isNodeParameterSet(n_name, "d")
+        || isNodeParameterSet(n_name, "b"))
         {
           matrix4 node_transformation = node->getAbsoluteTransformation();
 
@@ -2076,6 +2115,10 @@ void CObjectManager::clearAll(bool app_close)
   dynamicList.clear();
   doorList.clear();
 
+#ifdef MICROPATHER
+  Pathfinder->clear();
+#endif
+
 #ifdef SOUND_IRRKLANG
 
   for(irr::u16 i=0; i< a_AmbientSounds.size(); ++i)
@@ -2126,6 +2169,11 @@ void CObjectManager::clearAll(bool app_close)
   grassMeshes.clear();
   grassMeshes.set_used(0);
 
+  Core->getRenderer()->getCullingManager()->clear();
+  Core->getRenderer()->getInstancingManager()->clear();
+  Core->getRenderer()->getShadows()->clear();
+  Core->getRenderer()->getLights()->clear();
+
   if(!app_close)
   {
     Core->getRenderer()->getSceneManager()->clear();
@@ -2172,6 +2220,14 @@ void CObjectManager::clearAll(bool app_close)
   f_groups.clear();
   f_groups.set_used(0);
 
+  meshLods.clear();
+
+  for(irr::u32 i=0; i < benchMeshes.size(); ++i)
+    benchMeshes[i]->drop();
+
+  benchMeshes.clear();
+  benchNodes.clear();
+
   for(irr::u16 i=0; i< levelMeshes.size(); ++i)
   {
     //Core->getRenderer()->getSceneManager()->getMeshCache()->removeMesh(levelMeshes[i]);
@@ -2362,6 +2418,9 @@ void CObjectManager::groupNodes()
       ((scene::IMeshSceneNode*)node)->getMesh()->setDirty(EBT_VERTEX_AND_INDEX);
     }
 
+    optimizeBatchedMesh(node, groupMesh);
+    generateMeshLods(node, groupMesh);
+
     levelMeshes.push_back(groupMesh);
   }
 
@@ -2369,6 +2428,129 @@ void CObjectManager::groupNodes()
 
 
 
+  //
+  // Repeated meshes are drawn instanced instead of being copied into batches
+  //
+
+  if(!Core->commandLineParameters.hasParam("-disable_instancing"))
+  {
+    CInstancingManager *instancing = Core->getRenderer()->getInstancingManager();
+
+    irr::core::array<scene::IMeshSceneNode*> candidates, instances;
+
+    for(u32 i=0; i < rootNodes.size(); ++i)
+    {
+      node = (scene::IMeshSceneNode*)rootNodes[i];
+      irr::core::stringc node_name = getObjectSimpleName(node->getName());
+
+      if(node->getParam(0) != 0 || node->getParam(1) != 0)
+        continue;
+      else if(isAcceptableName(node_name) == false
+      || node_name == "AutoDoor" || node_name == "Door"
+      || node_name == "DoorMeshTop" || node_name == "DoorMeshBottom")
+        continue;
+      else if(isNodeParameterSet(irr::core::stringc(node->getName()), "d")
+      || isNodeParameterSet(irr::core::stringc(node->getName()), "n")
+      || isNodeParameterSet(irr::core::stringc(node->getName()), "b"))
+        continue;
+      // Copies the driver can't draw in one call are cheaper batched
+      else if(getsShaderMaterial(node) || instancing->canInstance(node) == false)
+        continue;
+
+      candidates.push_back(node);
+    }
+
+    for(u32 i=0; i < candidates.size(); ++i)
+    {
+      node = candidates[i];
+
+      if(node->getParam(5) != 0)
+        continue;
+
+      irr::core::stringc node_name = getObjectSimpleName(node->getName());
+
+      instances.set_used(0);
+      instances.push_back(node);
+
+      // Same mesh, name (shader materials are picked by name) and materials
+      for(u32 j=i+1; j < candidates.size(); ++j)
+      {
+        node2 = candidates[j];
+
+        if(node2->getParam(5) != 0 || node2->getMesh() != node->getMesh())
+          continue;
+        else if(getObjectSimpleName(node2->getName()) != node_name)
+          continue;
+        else if(node2->getMaterialCount() != node->getMaterialCount())
+          continue;
+
+        bool sameMaterials = true;
+
+        for(u32 m=0; m < node->getMaterialCount() && sameMaterials; ++m)
+          sameMaterials = node2->getMaterial(m) == node->getMaterial(m);
+
+        if(sameMaterials)
+          instances.push_back(node2);
+      }
+
+      if(instances.size() < INSTANCE_MIN_COUNT)
+        continue;
+
+      if(Core->commandLineParameters.hasParam("-disable_vbo") == false) {
+        node->getMesh()->setHardwareMappingHint(scene::EHM_STATIC, EBT_VERTEX_AND_INDEX);
+        node->getMesh()->setDirty(EBT_VERTEX_AND_INDEX);
+      }
+
+      u32 group = instancing->addGroup(instances);
+
+      // Lower detail meshes, switched at the distances where the
+      // batched meshes switch at the same screen size
+      if(!Core->commandLineParameters.hasParam("-disable_lod"))
+      {
+        f32 radius = node->getTransformedBoundingBox().getExtent().getLength() * 0.5f;
+        f32 tanHalfFov = tanf(Core->getCamera()->getNode()->getFOV() * 0.5f);
+
+        scene::IMesh *lodMesh = node->getMesh();
+        lodMesh->grab();
+
+        for(u32 l=1; l < MESH_LOD_LEVELS; ++l)
+        {
+          scene::IMesh *simplified = meshManip->createSimplifiedMesh(lodMesh, MESH_LOD_RATIO);
+
+          for(u32 b=0; b < simplified->getMeshBufferCount(); ++b)
+            meshManip->optimizeMeshBuffer(simplified->getMeshBuffer(b));
+
+          if(Core->commandLineParameters.hasParam("-disable_vbo") == false)
+            simplified->setHardwareMappingHint(scene::EHM_STATIC, EBT_VERTEX_AND_INDEX);
+
+          instancing->addLod(group, simplified, radius / (MESH_LOD_SCREEN_SIZES[l] * tanHalfFov));
+
+          lodMesh->drop();
+          lodMesh = simplified;
+        }
+
+        lodMesh->drop();
+      }
+
+      for(u32 k=0; k < instances.size(); ++k)
+        instances[k]->setParam(5, group+1);
+    }
+
+    // Instanced nodes stay single objects
+    for(u32 i=0; i < rootNodes.size(); ++i)
+    {
+      if(rootNodes[i]->getParam(5) != 0)
+      {
+        rootNodes.erase(i);
+        --i;
+      }
+    }
+
+    instancing->printReport();
+  }
+
+
+
   //
   // 2 - Combine similar nodes nearby
   //
@@ -2387,7 +2569,8 @@ void CObjectManager::groupNodes()
     else if(isAcceptableName(node_name) == false)
       continue;
     else if(isNodeParameterSet(irr::core::stringc(node->getName()), "d")
-    || isNodeParameterSet(irr::core::stringc(node->getName()), "n")) {
+    || isNodeParameterSet(irr::core::stringc(node->getName()), "n")
+    || isNodeParameterSet(irr::core::stringc(node->getName()), "b")) {
       skip_batching = true;
     }
 
@@ -2470,7 +2653,8 @@ void CObjectManager::groupNodes()
       if(isAcceptableName(node_name2) == false)
         continue;
       else if(isNodeParameterSet(irr::core::stringc(node2->getName()), "d")
-      || isNodeParameterSet(irr::core::stringc(node2->getName()), "n"))
+      || isNodeParameterSet(irr::core::stringc(node2->getName()), "n")
+      || isNodeParameterSet(irr::core::stringc(node2->getName()), "b"))
         continue;
       else if(node2->getParam(0) != 0) continue;
 
@@ -2558,11 +2742,17 @@ void CObjectManager::groupNodes()
     node->setScale(vector3df(1,1,1));
     node->setRotation(vector3df(0,0,0));
 
+    optimizeBatchedMesh(node, groupMesh);
+    generateMeshLods(node, groupMesh);
+
     levelMeshes.push_back(groupMesh);
   }
   // step 2 is done!
   printf("ok!\n");
 
+  printMeshCacheReport();
+  printMeshLodReport();
+
 
 
 
@@ -2613,6 +2803,9 @@ bool CObjectManager::addObject(irr::scene::ISceneNode*node)
       // Convert node to mesh node
       scene::IMeshSceneNode *meshNode = (scene::IMeshSceneNode*)node;
 
+      // Node with a dynamic body, culled with its current box
+      bool movingNode = false;
+
 #ifdef PHYSICS_NEWTON
       // Create physics body/bodies for the node
       irr::core::array<physics::CBody*> bodies;
@@ -2653,6 +2846,7 @@ bool CObjectManager::addObject(irr::scene::ISceneNode*node)
 
           if(isNodeParameterSet(objectName, "d")) {
             o_type = game::EOT_DYNAMIC;
+            movingNode = true;
           }
           else if(isBaseBuilding(objectName.c_str())) {
             o_type = game::EOT_BUILDING;
@@ -2762,6 +2956,16 @@ bool CObjectManager::addObject(irr::scene::ISceneNode*node)
          meshNode->getMesh()->setDirty();
       }
 
+      // Nodes that can't be managed (e.g. they have children) are culled by the scene manager,
+      // instanced nodes are hidden and culled by their group
+      if(meshNode->getParam(5) == 0)
+      {
+        if(movingNode)
+          Core->getRenderer()->getCullingManager()->addDynamicNode(meshNode);
+        else
+          Core->getRenderer()->getCullingManager()->addStaticNode(meshNode);
+      }
+
     /*}
     break;
   }*/
@@ -2769,332 +2973,6 @@ bool CObjectManager::addObject(irr::scene::ISceneNode*node)
   return true;
 }
 
-void CObjectManager::calculateLightmapForNode(IMeshSceneNode* node)
-{
-  irr::s16 meshBufferIndex = -1;
-
-  for(irr::u32 i=0; i < node->getMaterialCount(); ++i)
-  {
-    irr::video::ITexture* MaterialTexture = node->getMaterial(i).getTexture(0);
-
-    if(MaterialTexture)
-    {
-        irr::core::stringc texName = MaterialTexture->getName();
-
-        char toFind = '\\';
-        irr::u32 lastPos = texName.findLast( toFind ) + 1;
-
-        irr::core::stringc textureFile = texName.subString(lastPos, texName.size() - lastPos-4);
-        irr::core::stringc endStr = texName.subString(texName.size()-7, 3);
-
-        // Multi-texture shader
-        if(endStr.equals_ignore_case("_mt") == true)
-          meshBufferIndex = i;
-    }
-  }
-
-  if(meshBufferIndex == -1)
-    return;
-
-  u16 *indices;
-  void* vrt;
-  S3DVertex* vertices;
-
-  IMeshBuffer *mb = node->getMesh()->getMeshBuffer(meshBufferIndex);
-
-  dimension2du texSize = dimension2du(512, 512);
-  //texSize -= dimension2du(1,1);
-
-  // Create a new blank texture
-  IImage *output = Core->getRenderer()->getVideoDriver()->createImage(ECF_A8R8G8B8, texSize);
-
-  // Black background
-  output->fill(SColor(255, 0,0,0));
-
-  // Get indices and vertices of mesh buffer
-  indices = mb->getIndices();
-  vrt = mb->getVertices();
-  vertices = (S3DVertex*)vrt;
-
-  irr::core::array<triangle3df> tri1, tri2;
-  irr::core::array<rectf> boxes;
-#ifdef PHYSICS_IRR_NEWT
-  irr::core::array<NewtonBody*> excluded;
-#endif
-  tri1.set_used(0);
-  tri2.set_used(0);
-  boxes.set_used(0);
-
-  vector3df SunPos = Core->getObjects()->parameters.sunPosition;
-
-  printf("\tSun position: %.3f, %.3f, %.3f\n", SunPos.X, SunPos.Y, SunPos.Z);
-
-  printf("\tSetting up collision triangles (Tri-count: %d) ... ", mb->getIndexCount()/3);
-
-  for(irr::u32 t=0; t < mb->getIndexCount(); t+=3)
-  {
-    vector2df in1 = vertices[indices[t]].TCoords;
-    vector2df in2 = vertices[indices[t+1]].TCoords;
-    vector2df in3 = vertices[indices[t+2]].TCoords;
-
-    triangle3df tri_1 = triangle3df(
-     vector3df(in1.X, 0, in1.Y),
-     vector3df(in2.X, 0, in2.Y),
-     vector3df(in3.X, 0, in3.Y));
-
-    irr::f32 x1=0, x2=0, y1=0, y2=0;
-
-    x1 = fmin(fmin(in1.X, in2.X), in3.X);
-    x2 = fmax(fmax(in1.X, in2.X), in3.X);
-    y1 = fmin(fmin(in1.Y, in2.Y), in3.Y);
-    y2 = fmax(fmax(in1.Y, in2.Y), in3.Y);
-
-    boxes.push_back(rectf(x1, y1, x2, y2));
-
-    triangle3df tri_2 = triangle3df(
-      vertices[indices[t]].Pos,
-      vertices[indices[t+1]].Pos,
-      vertices[indices[t+2]].Pos);
-
-    tri1.push_back(tri_1);
-    tri2.push_back(tri_2);
-
-
-    /*irr::core::line3df line1, line2, line3;
-    irr::core::array<irr::newton::SIntersectionPoint> out;
-    irr::core::array<irr::newton::SIntersectionPoint> result;
-
-    result.set_used(0);
-
-    line1.start = tri_2.pointA;
-    line1.end = line1.start + SunPos;
-
-    line2.start = tri_2.pointB;
-    line2.end = line2.start + SunPos;
-
-    line3.start = tri_2.pointC;
-    line3.end = line3.start + SunPos;
-
-    //
-    // Get excluded collisions
-    //
-
-    out.set_used(0);
-    Core->getPhysics()->GetWorld()->getCollisionManager()->getCollisionPoints(line1, &out);
-    for(irr::u32 i=0; i<out.size(); ++i) result.push_back( out[i] );
-
-    out.set_used(0);
-    Core->getPhysics()->GetWorld()->getCollisionManager()->getCollisionPoints(line2, &out);
-    for(irr::u32 i=0; i<out.size(); ++i) result.push_back( out[i] );
-
-    out.set_used(0);
-    Core->getPhysics()->GetWorld()->getCollisionManager()->getCollisionPoints(line3, &out);
-    for(irr::u32 i=0; i<out.size(); ++i) result.push_back( out[i] );
-
-    irr::core::array<irr::newton::IBody *> bodies2 = Core->getPhysics()->GetWorld()->getAllBodies();
-
-    for(u32 b=0; b < result.size(); ++b)
-    {
-      irr::s32 res = bodies2.linear_search(result[b].body);
-
-      if(res != -1) {
-        bodies2.erase(res);
-      }
-    }
-
-    irr::core::array<NewtonBody*> newtonbodies;
-    newtonbodies.set_used(0);
-
-    for(u32 b=0; b < bodies2.size(); ++b) newtonbodies.push_back(bodies2[b]->getNewtonBody());
-
-    excluded.push_back(newtonbodies);*/
-  }
-
-  printf("ok!\n");
-
-  matrix4 matObject;
-  matObject.setRotationDegrees(node->getRotation());
-  #ifdef PHYSICS_IRR_NEWT
-  for(irr::u16 di=0; di < Core->getObjects()->getDynamicObjectCount(); ++di)
-  {
-    for(irr::u16 bi=0; bi < Core->getObjects()->getDynamicObjectById(di)->getBodyCount(); ++bi)
-    {
-      excluded.push_back(Core->getObjects()->getDynamicObjectById(di)->getBodyByID(bi)->getNewtonBody());
-    }
-  }
-#endif
-  //ITimer *timer = Core->getRenderer()->getDevice()->getTimer();
-
-  //newton::IBody* node_body = Core->getPhysics()->GetWorld()->getUtils()->getBodyFromNode(node);
-
-  f32 resolution = 0; // 0,1,2,3,4
-  /*u32 time_start = 0;
-  u32 time_end = 0;
-  u32 time_longest = 0;
-  u32 time_shortest = 999999;*/
-
-  for(u32 w=0; w < texSize.Width; w += u32(resolution+1)) {
-  for(u32 h=0; h < texSize.Height; h += u32(resolution+1))
-  {
-    f32 TCoordX = f32(w) / f32(texSize.Width-1);
-    f32 TCoordY = f32(h) / f32(texSize.Height-1);
-
-    if(output->getPixel(u32(TCoordX), u32(TCoordY)) == SColor(255, 255,255,255)) continue;
-
-    //timer->tick();
-    //time_start = timer->getTime();
-
-    // Find on which triangle is the texture coordinate
-    for(irr::u32 t=0; t < tri1.size(); ++t)
-    {
-      vector3df checkPos = vector3df(TCoordX, 0, TCoordY);
-
-      if(!boxes[t].isPointInside(irr::core::position2df(TCoordX, TCoordY))) continue;
-
-      if(tri1[t].isPointInside(checkPos))
-      {
-        f32 mat_1_1 = tri1[t].pointA.X - tri1[t].pointC.X;
-        f32 mat_1_2 = tri1[t].pointB.X - tri1[t].pointC.X;
-        f32 mat_2_1 = tri1[t].pointA.Z - tri1[t].pointC.Z;
-        f32 mat_2_2 = tri1[t].pointB.Z - tri1[t].pointC.Z;
-
-        f32 detT = (mat_1_1 * mat_2_2) - (mat_2_1 * mat_1_2);
-
-        f32 l1 = ((mat_2_2*(TCoordX-tri1[t].pointC.X)) - (mat_1_2*(TCoordY-tri1[t].pointC.Z))) / detT;
-        f32 l2 = (-(mat_2_1*(TCoordX-tri1[t].pointC.X)) + (mat_1_1*(TCoordY-tri1[t].pointC.Z))) / detT;
-        f32 l3 = 1 - l1 - l2;
-
-        vector3df resultPos = (tri2[t].pointA * l1) + (tri2[t].pointB * l2) + (tri2[t].pointC * l3);
-        resultPos *= node->getScale();
-
-        matObject.rotateVect(resultPos);
-
-        resultPos += node->getPosition();
-
-        irr::core::vector3df normal = tri2[t].getNormal().normalize();
-
-        matObject.rotateVect(normal);
-
-        resultPos += normal*0.25f;
-
-        //Core->getRenderer()->getSceneManager()->addCubeSceneNode(0.25, 0, -1, resultPos);
-
-        // Tracing FROM the sun to the pixel
-        line3df sun_line = line3df(resultPos, resultPos+SunPos);
-
-#ifdef PHYSICS_NEWTON
-
-        physics::SRayCastParameters parameters;
-        parameters.line = sun_line;
-
-        physics::SRayCastResult col_out = Core->getPhysics()->getRayCollision(parameters);
-
-        if(col_out.body != NULL)
-        {
-          output->setPixel(w, h, SColor(255, 255,255,255));
-
-          for(s32 rx = -s32(resolution); rx < s32(resolution); ++rx)
-          for(s32 ry = -s32(resolution); ry < s32(resolution); ++ry)
-          {
-            output->setPixel(w+rx, h+ry, SColor(255, 255,255,255));
-          }
-        }
-
-
-#endif
-
-#ifdef PHYSICS_IRR_NEWT
-
-        newton::SIntersectionPoint col_out =
-          Core->getPhysics()->GetCollisionFromLine(sun_line, excluded);
-
-        if(col_out.body != NULL)
-        {
-          output->setPixel(w, h, SColor(255, 255,255,255));
-
-          for(s32 rx = -s32(resolution); rx < s32(resolution); ++rx)
-          for(s32 ry = -s32(resolution); ry < s32(resolution); ++ry)
-          {
-            output->setPixel(w+rx, h+ry, SColor(255, 255,255,255));
-          }
-        }
-
-        // Test collision against all possible objects
-
-        /*irr::core::array<irr::newton::SIntersectionPoint> p_objects = collisions[t];
-
-        for(irr::u32 p_obj=0; p_obj<p_objects.size(); ++p_obj)
-        {
-          newton::SIntersectionPoint col_out =
-            Core->getPhysics()->GetCollisionFromLine(p_objects[p_obj].body, sun_line);
-
-          if(col_out.body != NULL)
-          {
-            output->setPixel(w, h, SColor(255, 255,255,255));
-
-            for(s32 rx = -s32(resolution); rx < s32(resolution); ++rx)
-            for(s32 ry = -s32(resolution); ry < s32(resolution); ++ry)
-            {
-              output->setPixel(w+rx, h+ry, SColor(255, 255,255,255));
-            }
-
-            break;
-          }
-        }*/
-
-#endif
-
-        break;
-      }
-    }
-
-    /*timer->tick();
-    time_end = timer->getTime();
-
-    u32 time = time_end - time_start;
-
-    if(time > time_longest) time_longest = time;
-    else if(time < time_shortest) time_shortest = time;*/
-
-    //printf("\tTime: %d ms\n", time);
-
-  }
-
-  printf("\tProgress %d/%d..\n", w+1, texSize.Width);
-
-
-  /*IVideoDriver* drv = Core->getRenderer()->getVideoDriver();
-  ITexture *tmp_tex = drv->addTexture("tmp_dbg", output);
-
-  drv->beginScene(true, true, SColor(255, 30,30,30));
-
-  drv->2DImage(
-    tmp_tex,
-    rect<s32>(0, 0, texSize.Width, texSize.Height),
-    rect<s32>(0, 0, texSize.Width, texSize.Height), 0, 0, true);
-  drv->endScene();*/
-
-
-  }
-
-  //printf("\tLongest time: %d ms\n", time_longest);
-  //printf("\tShortest time: %d ms\n", time_shortest);
-
-
-  // Write image to file
-  stringc resultFileName = "data/levels/";
-  resultFileName += parameters.levelName;
-  resultFileName += "/shadow_";
-  resultFileName += Core->getObjects()->getNodeFullName(node->getName());
-  resultFileName += ".png";
-  Core->getRenderer()->getVideoDriver()->writeImageToFile(output, resultFileName.c_str());
-
-  output->drop();
-
-  printf("\tCompleted!\n");
-}
-
-
 void CObjectManager::loadNameMaterials()
 {
   irr::core::stringc filename = "data/levels/materials.dat";
@@ -3282,7 +3160,50 @@ void CObjectManager::loadLevel(irr::core::stringc levelFile)
     nodes[i]->setParam(0, 0);
     nodes[i]->setParam(3,-1);
     nodes[i]->setParam(4, 0);
+    nodes[i]->setParam(5, 0);
+  }
+
+#ifdef PHYSICS_NEWTON
+  // Vehicles (-v, tanks -v -t) leave the level before it is grouped, they
+  // get their bodies once the level is loaded
+  if(!Core->commandLineParameters.hasParam("-disable_physics"))
+  {
+    for (u32 i=0; i < nodes.size(); ++i)
+    {
+      irr::core::stringc nodeName = irr::core::stringc(nodes[i]->getName());
+
+      if(nodes[i]->getType() != scene::ESNT_MESH || !isNodeParameterSet(nodeName, "v"))
+        continue;
+
+      scene::IMeshSceneNode *vehicleNode = (scene::IMeshSceneNode*)nodes[i];
+
+      if(!Core->isHeadless())
+        findAndApplyShaderMaterials(vehicleNode);
+
+      vehicleNode->setAutomaticCulling(scene::EAC_FRUSTUM_BOX);
+
+      // The wheels are children of the chassis
+      irr::core::array<scene::ISceneNode*> vehicleParts;
+      vehicleParts.push_back(vehicleNode);
+
+      core::list<scene::ISceneNode*>::ConstIterator child = vehicleNode->getChildren().begin();
+
+      for(; child != vehicleNode->getChildren().end(); ++child)
+        vehicleParts.push_back(*child);
+
+      for(u32 p=0; p < vehicleParts.size(); ++p)
+      {
+        vehicleParts[p]->setMaterialFlag(EMF_BILINEAR_FILTER, true);
+        vehicleParts[p]->setMaterialFlag(EMF_TRILINEAR_FILTER, Core->getConfiguration()->getVideo()->isTrilinearFilter);
+        vehicleParts[p]->setMaterialFlag(EMF_ANISOTROPIC_FILTER, Core->getConfiguration()->getVideo()->isAnistropicFilter);
+        vehicleParts[p]->setMaterialFlag(EMF_FOG_ENABLE, parameters.fogEnabled);
+      }
+
+      Core->getPhysics()->getVehicles()->addVehicle(vehicleNode,
+        isNodeParameterSet(nodeName, "t") ? EVC_TRACKED : EVC_WHEELED);
+    }
   }
+#endif
 
   levelMeshes.set_used(0);
 
@@ -3331,7 +3252,9 @@ void CObjectManager::loadLevel(irr::core::stringc levelFile)
         && nodeName != "DoorMeshTop"
         && nodeName != "DoorMeshBottom")
         {
-          findAndApplyShaderMaterials( (scene::IMeshSceneNode*)node );
+          if(!Core->isHeadless())
+            findAndApplyShaderMaterials( (scene::IMeshSceneNode*)node );
+
           node->setAutomaticCulling(scene::EAC_FRUSTUM_BOX);
 
           addObject(node);
@@ -3345,7 +3268,8 @@ void CObjectManager::loadLevel(irr::core::stringc levelFile)
       break;
 
   		case scene::ESNT_OCTREE:
-    		findAndApplyShaderMaterials( (scene::IMeshSceneNode*)node );
+        if(!Core->isHeadless())
+    		  findAndApplyShaderMaterials( (scene::IMeshSceneNode*)node );
 
         node->setAutomaticCulling(scene::EAC_FRUSTUM_BOX);
 
@@ -3494,19 +3418,50 @@ void CObjectManager::loadLevel(irr::core::stringc levelFile)
 
   printf("ok!\n");
 
+#ifdef PHYSICS_NEWTON
+  Core->getPhysics()->buildStaticWorld();
+
+  // Breakable props are cut once and cooked next to the level like the navigation mesh
+  irr::core::stringc breakablesFile = "data/levels/";
+  breakablesFile += parameters.levelName;
+  breakablesFile += "/breakables.brk";
+
+  Core->getPhysics()->getBreakables()->build(breakablesFile);
+
+  Core->getPhysics()->getVehicles()->build();
+#endif
+
   printf("\tStatic objects: %d\n", staticList.size());
   printf("\tDynamic objects: %d\n", dynamicList.size());
 
+#ifdef MICROPATHER
+  // Walkable triangles were collected while creating the static physics.
+  // The navigation mesh is cooked next to the level and reused while the geometry doesn't change.
+  irr::core::stringc navFile = "data/levels/";
+  navFile += parameters.levelName;
+  navFile += "/navmesh.nav";
 
+  Pathfinder->build(navFile.c_str());
 
-  if(Core->commandLineParameters.hasParam("-generate_lightmap"))
+  // -pathbench <queries> compares flat and hierarchical searches on this level
+  if(Core->commandLineParameters.hasParam("-pathbench"))
   {
-    printf("Generating lightmap for terrain\n");
+    printf("Level: %s\n", parameters.levelName.c_str());
 
-    calculateLightmapForNode((scene::IMeshSceneNode*)getSceneNodeFromName(getNodeFullName("Terrain").c_str()));
+    Pathfinder->benchmark(atoi(Core->commandLineParameters.getParamValue("-pathbench").c_str()));
   }
+#endif
+
+  // -meshbench <frames> draws the batched meshes before and after the vertex cache optimization
+  if(Core->commandLineParameters.hasParam("-meshbench") && !Core->isHeadless())
+    benchmarkMeshOptimization(atoi(Core->commandLineParameters.getParamValue("-meshbench").c_str()));
+
+
+
+  // Headless mode skips all the work that only affects rendering:
+  // grass and sky
 
-  if(Core->commandLineParameters.hasParam("-generate_grass"))
+  if(Core->commandLineParameters.hasParam("-generate_grass") && !Core->isHeadless())
   {
     printf("Generating grass ... \n");
 
@@ -3560,7 +3515,7 @@ void CObjectManager::loadLevel(irr::core::stringc levelFile)
 
   //Game->getGUI()->enableLoadingScreen(game::ELS_LOAD_LEVEL, 3); // Loading grass
 
-  if(Core->commandLineParameters.hasParam("-disable_grass") == false)
+  if(Core->commandLineParameters.hasParam("-disable_grass") == false && !Core->isHeadless())
   {
     printf("Loading grass ... \n");
 
@@ -3635,7 +3590,7 @@ void CObjectManager::loadLevel(irr::core::stringc levelFile)
 
   Core->getRenderer()->getSceneManager()->setAmbientLight(parameters.ambientColor);
 
-  if(Core->commandLineParameters.hasParam("-disable_sky") == false)
+  if(Core->commandLineParameters.hasParam("-disable_sky") == false && !Core->isHeadless())
   {
     printf("Loading sky ... ");
 
@@ -3791,8 +3746,8 @@ void CObjectManager::createDoor(irr::scene::ISceneNode *node)
 
       CDoor * door = new CDoor(Core, EDT_DOUBLE_VERTICAL);
 
-      physics::CBody *topBody = Core->getPhysics()->createBodyForNode(nodeTop, false);
-      physics::CBody *bottomBody = Core->getPhysics()->createBodyForNode(nodeBottom, false);
+      physics::CBody *topBody = Core->getPhysics()->createKinematicBody(nodeTop);
+      physics::CBody *bottomBody = Core->getPhysics()->createKinematicBody(nodeBottom);
 
       game::SObjectData *objectData = new game::SObjectData();
       objectData->container_id = doorList.size();
@@ -3942,6 +3897,209 @@ void CObjectManager::createPlaneOverflight(irr::core::vector3df targetPos)
   printf("Plane created\n");
 }
 
+void CObjectManager::optimizeBatchedMesh(irr::scene::IMeshSceneNode *node, irr::scene::CBatchingMesh *mesh)
+{
+  if(Core->commandLineParameters.hasParam("-disable_mesh_optimizer"))
+    return;
+
+  IMeshManipulator *meshManip = Core->getRenderer()->getSceneManager()->getMeshManipulator();
+
+  SMeshCacheReport report;
+  report.Triangles = meshManip->getPolyCount(mesh);
+
+  mesh->getVertexCacheStats(meshManip, report.AcmrBefore, report.AtvrBefore);
+
+  if(Core->commandLineParameters.hasParam("-meshbench"))
+  {
+    scene::IMesh *copy = meshManip->createMeshCopy(mesh);
+
+    if(Core->commandLineParameters.hasParam("-disable_vbo") == false)
+      copy->setHardwareMappingHint(scene::EHM_STATIC, EBT_VERTEX_AND_INDEX);
+
+    benchNodes.push_back(node);
+    benchMeshes.push_back(copy);
+  }
+
+  // Nothing moves the batched level meshes, their sources aren't needed anymore
+  mesh->finalize(meshManip);
+
+  mesh->getVertexCacheStats(meshManip, report.AcmrAfter, report.AtvrAfter);
+
+  meshCacheReports.push_back(report);
+}
+
+void CObjectManager::printMeshCacheReport()
+{
+  if(meshCacheReports.size() == 0)
+    return;
+
+  printf("Vertex cache: %d batched meshes (ACMR: vertices per triangle, ATVR: per vertex used)\n", meshCacheReports.size());
+
+  f32 acmrBefore = 0.f, acmrAfter = 0.f;
+  u32 triangles = 0;
+
+  for(u32 i=0; i < meshCacheReports.size(); ++i)
+  {
+    const SMeshCacheReport &report = meshCacheReports[i];
+
+    printf("\tmesh %d: %d triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", i, report.Triangles,
+      report.AcmrBefore, report.AcmrAfter, report.AtvrBefore, report.AtvrAfter);
+
+    acmrBefore += report.AcmrBefore * report.Triangles;
+    acmrAfter += report.AcmrAfter * report.Triangles;
+    triangles += report.Triangles;
+  }
+
+  if(triangles > 0)
+    printf("\tall: %d triangles, ACMR %.3f -> %.3f\n", triangles, acmrBefore / triangles, acmrAfter / triangles);
+
+  meshCacheReports.clear();
+}
+
+void CObjectManager::benchmarkMeshOptimization(irr::u32 frames)
+{
+  if(benchNodes.size() == 0 || frames == 0)
+    return;
+
+  video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+  irr::ITimer *timer = Core->getRenderer()->getDevice()->getTimer();
+  irr::scene::ICameraSceneNode *cameraNode = Core->getCamera()->getNode();
+
+  cameraNode->updateAbsolutePosition();
+
+  matrix4 view;
+  view.buildCameraLookAtMatrixLH(cameraNode->getAbsolutePosition(), cameraNode->getTarget(), cameraNode->getUpVector());
+
+  // Nodes were moved under their groups after batching
+  for(u32 i=0; i < benchNodes.size(); ++i)
+  {
+    if(benchNodes[i]->getParent())
+      benchNodes[i]->getParent()->updateAbsolutePosition();
+
+    benchNodes[i]->updateAbsolutePosition();
+  }
+
+  const irr::c8 *names[2] = { "original order", "optimized" };
+
+  printf("Mesh benchmark: %d batched meshes, %d frames (GPU bound, vsync should be off)\n", benchNodes.size(), frames);
+
+  for(u32 pass=0; pass < 2; ++pass)
+  {
+    u32 start = 0;
+
+    // The first frame uploads the hardware buffers and isn't counted
+    for(u32 f=0; f <= frames; ++f)
+    {
+      if(f == 1)
+        start = timer->getRealTime();
+
+      driver->beginScene(true, true, video::SColor(255,0,0,0));
+
+      driver->setTransform(video::ETS_PROJECTION, cameraNode->getProjectionMatrix());
+      driver->setTransform(video::ETS_VIEW, view);
+
+      for(u32 i=0; i < benchNodes.size(); ++i)
+      {
+        scene::IMesh *mesh = pass == 0 ? benchMeshes[i] : benchNodes[i]->getMesh();
+
+        driver->setTransform(video::ETS_WORLD, benchNodes[i]->getAbsoluteTransformation());
+
+        for(u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+        {
+          driver->setMaterial(b < benchNodes[i]->getMaterialCount()
+            ? benchNodes[i]->getMaterial(b) : mesh->getMeshBuffer(b)->getMaterial());
+          driver->drawMeshBuffer(mesh->getMeshBuffer(b));
+        }
+      }
+
+      driver->endScene();
+    }
+
+    u32 time = timer->getRealTime() - start;
+
+    printf("\t%s: %.2f ms/frame\n", names[pass], f32(time) / frames);
+  }
+
+  for(u32 i=0; i < benchMeshes.size(); ++i)
+    benchMeshes[i]->drop();
+
+  benchMeshes.clear();
+  benchNodes.clear();
+}
+
+void CObjectManager::generateMeshLods(irr::scene::IMeshSceneNode *node, irr::scene::CBatchingMesh *mesh)
+{
+  if(Core->commandLineParameters.hasParam("-disable_lod"))
+    return;
+
+  IMeshManipulator *meshManip = Core->getRenderer()->getSceneManager()->getMeshManipulator();
+
+  if(mesh->generateLods(meshManip, MESH_LOD_LEVELS, MESH_LOD_RATIO) < 2)
+    return;
+
+  for(u32 l=1; l < mesh->getLodCount(); ++l)
+    mesh->setLodScreenSize(l, MESH_LOD_SCREEN_SIZES[l]);
+
+  SMeshLod lod;
+  lod.Node = node;
+  lod.Mesh = mesh;
+  lod.Radius = mesh->getBoundingBox().getExtent().getLength() * 0.5f;
+
+  meshLods.push_back(lod);
+}
+
+void CObjectManager::updateMeshLods()
+{
+  if(meshLods.size() == 0)
+    return;
+
+  irr::scene::ICameraSceneNode *cameraNode = Core->getCamera()->getNode();
+
+  irr::core::vector3df cameraPosition = cameraNode->getAbsolutePosition();
+  irr::f32 tanHalfFov = tanf(cameraNode->getFOV() * 0.5f);
+
+  for(u32 i=0; i < meshLods.size(); ++i)
+  {
+    SMeshLod &lod = meshLods[i];
+
+    irr::core::vector3df center = lod.Mesh->getBoundingBox().getCenter();
+    lod.Node->getAbsoluteTransformation().transformVect(center);
+
+    // Distance to the bounding sphere, the camera can be inside it
+    irr::f32 distance = core::max_(center.getDistanceFrom(cameraPosition) - lod.Radius, 1.0f);
+
+    // Part of the screen height covered by the sphere
+    irr::f32 screenSize = lod.Radius / (distance * tanHalfFov);
+
+    lod.Mesh->selectLod(screenSize, MESH_LOD_HYSTERESIS);
+  }
+}
+
+void CObjectManager::printMeshLodReport()
+{
+  if(meshLods.size() == 0)
+  {
+    printf("LOD: no batched meshes simplified\n");
+    return;
+  }
+
+  u32 triangles[MESH_LOD_LEVELS];
+
+  for(u32 l=0; l < MESH_LOD_LEVELS; ++l)
+    triangles[l] = 0;
+
+  // Meshes with fewer levels count their last level for the lower ones
+  for(u32 i=0; i < meshLods.size(); ++i)
+    for(u32 l=0; l < MESH_LOD_LEVELS; ++l)
+      triangles[l] += meshLods[i].Mesh->getLodTriangleCount(core::min_(l, meshLods[i].Mesh->getLodCount()-1));
+
+  printf("LOD: %d batched meshes\n", meshLods.size());
+
+  for(u32 l=0; l < MESH_LOD_LEVELS; ++l)
+    printf("\tlevel %d (below %.2f of the screen): %d triangles\n", l,
+      l == 0 ? 1.f : MESH_LOD_SCREEN_SIZES[l], triangles[l]);
+}
+
 void CObjectManager::update(irr::f32 &time)
 {
 
@@ -3952,6 +4110,13 @@ void CObjectManager::update(irr::f32 &time)
   for(irr::u32 dIdx=0; dIdx < doorList.size(); ++dIdx)
     doorList[dIdx]->update();
 
+  updateMeshLods();
+
+#ifdef MICROPATHER
+  // Serves path requests when there are no worker threads
+  Pathfinder->update();
+#endif
+
   /*
     Does grass need regenerating?
   */
@@ -0,0 +1,1375 @@
+#include "Engine.h"
+
+#ifdef MICROPATHER
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <pthread.h>
+  #include <sys/time.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "Core.h"
+#include "Renderer.h"
+#include "Maths.h"
+#include "Pathfinder.h"
+
+using namespace engine;
+
+// File header of a cooked navigation mesh
+const irr::u32 NAV_FILE_MAGIC = 0x564E5746;
+
+// Boundary edges are bucketed into cells this big when looking for links
+const irr::f32 NAV_LINK_CELL_SIZE = 1.f;
+
+struct SNavEdge
+{
+  irr::u32 Polygon, Count;
+};
+
+// Edge used by one polygon only
+struct SNavOpenEdge
+{
+  irr::u32 Polygon;
+  irr::core::vector3df A, B;
+};
+
+struct engine::SPathfinderLock
+{
+#ifdef _WIN32
+  CRITICAL_SECTION Lock;
+#else
+  pthread_mutex_t Lock;
+#endif
+};
+
+static void pathfinder_RunRequest(void *data, irr::u32 thread)
+{
+  ((CPathfinder*)data)->serveRequest(thread);
+}
+
+static irr::u32 getMicroseconds()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+
+  return irr::u32((counter.QuadPart * 1000000) / frequency.QuadPart);
+#else
+  timeval tv;
+  gettimeofday(&tv, 0);
+
+  return irr::u32(tv.tv_sec * 1000000 + tv.tv_usec);
+#endif
+}
+
+// MicroPather states are polygon or region indices, offset so none is NULL
+static inline void* toState(irr::u32 index)
+{
+  return (void*)(MP_UPTR)(index + 1);
+}
+
+static inline irr::u32 fromState(void *state)
+{
+  return irr::u32((MP_UPTR)state) - 1;
+}
+
+/*
+  Search graphs. Every thread has its own set, the expansion counters
+  and the corridor restriction are per search.
+*/
+
+// Regions and the precomputed costs between them
+class CNavRegionGraph : public micropather::Graph
+{
+public:
+
+  CNavRegionGraph(CPathfinder *pathfinder) : Pathfinder(pathfinder), Expansions(0) {}
+
+  float LeastCostEstimate(void* stateStart, void* stateEnd)
+  {
+    return Pathfinder->getRegion(fromState(stateStart)).Center.getDistanceFrom(
+      Pathfinder->getRegion(fromState(stateEnd)).Center);
+  }
+
+  void AdjacentCost(void* state, std::vector<micropather::StateCost> *adjacent)
+  {
+    const SNavRegion &region = Pathfinder->getRegion(fromState(state));
+
+    ++Expansions;
+
+    for(irr::u32 i=0; i < region.Neighbours.size(); ++i)
+    {
+      micropather::StateCost cost;
+      cost.state = toState(region.Neighbours[i]);
+      cost.cost = region.Costs[i];
+
+      adjacent->push_back(cost);
+    }
+  }
+
+  void PrintStateInfo(void* state)
+  {
+    printf("(region %d)", fromState(state));
+  }
+
+  CPathfinder *Pathfinder;
+
+  irr::u32 Expansions;
+};
+
+// Polygons, optionally limited to the polygons of two regions
+class CNavPolygonGraph : public micropather::Graph
+{
+public:
+
+  CNavPolygonGraph(CPathfinder *pathfinder) : Pathfinder(pathfinder), Expansions(0), Restricted(false), RegionA(0), RegionB(0) {}
+
+  float LeastCostEstimate(void* stateStart, void* stateEnd)
+  {
+    return Pathfinder->getPolygon(fromState(stateStart)).Center.getDistanceFrom(
+      Pathfinder->getPolygon(fromState(stateEnd)).Center);
+  }
+
+  void AdjacentCost(void* state, std::vector<micropather::StateCost> *adjacent)
+  {
+    const SNavPolygon &polygon = Pathfinder->getPolygon(fromState(state));
+
+    ++Expansions;
+
+    for(irr::u32 i=0; i < polygon.Neighbours.size(); ++i)
+    {
+      if(Restricted)
+      {
+        irr::u32 region = Pathfinder->getPolygonRegion(polygon.Neighbours[i]);
+
+        if(region != RegionA && region != RegionB)
+          continue;
+      }
+
+      // Through the portal, not straight between the centers
+      micropather::StateCost cost;
+      cost.state = toState(polygon.Neighbours[i]);
+      cost.cost = polygon.Center.getDistanceFrom(polygon.Portals[i])
+        + polygon.Portals[i].getDistanceFrom(Pathfinder->getPolygon(polygon.Neighbours[i]).Center);
+
+      adjacent->push_back(cost);
+    }
+  }
+
+  void PrintStateInfo(void* state)
+  {
+    irr::core::vector3df center = Pathfinder->getPolygon(fromState(state)).Center;
+
+    printf("(%d: %.1f %.1f %.1f)", fromState(state), center.X, center.Y, center.Z);
+  }
+
+  CPathfinder *Pathfinder;
+
+  irr::u32 Expansions;
+
+  bool Restricted;
+  irr::u32 RegionA, RegionB;
+};
+
+struct engine::SNavSearch
+{
+  CNavRegionGraph RegionGraph;
+  CNavPolygonGraph CorridorGraph, FlatGraph;
+
+  micropather::MicroPather RegionPather, CorridorPather, FlatPather;
+
+  SNavSearch(CPathfinder *pathfinder) :
+    RegionGraph(pathfinder), CorridorGraph(pathfinder), FlatGraph(pathfinder),
+    RegionPather(&RegionGraph, irr::core::max_(pathfinder->getRegionCount() / 4, 64u), 6),
+    // Corridor searches are small but reset often, reset cost grows with the allocation
+    CorridorPather(&CorridorGraph, 512, 6),
+    FlatPather(&FlatGraph, irr::core::max_(pathfinder->getPolygonCount() / 4, 250u), 6)
+  {
+    CorridorGraph.Restricted = true;
+  }
+
+  irr::u32 getExpansions()
+  {
+    return RegionGraph.Expansions + CorridorGraph.Expansions + FlatGraph.Expansions;
+  }
+};
+
+CPathfinder::CPathfinder(CCore * core)
+{
+  Core = core;
+
+  m_Search = (SNavSearch*)NULL;
+
+  for(irr::u32 i=0; i < JOB_MAX_THREADS; ++i)
+    m_Searches[i] = (SNavSearch*)NULL;
+
+  m_GridWidth = m_GridHeight = 0;
+
+  m_NextCacheSlot = 0;
+  m_CacheHits = m_CacheMisses = 0;
+
+  m_NextTicket = 1;
+
+  m_Lock = new SPathfinderLock();
+
+#ifdef _WIN32
+  InitializeCriticalSection(&m_Lock->Lock);
+#else
+  pthread_mutex_init(&m_Lock->Lock, NULL);
+#endif
+}
+
+CPathfinder::~CPathfinder()
+{
+  clear();
+
+#ifdef _WIN32
+  DeleteCriticalSection(&m_Lock->Lock);
+#else
+  pthread_mutex_destroy(&m_Lock->Lock);
+#endif
+
+  delete m_Lock;
+}
+
+void CPathfinder::lock()
+{
+#ifdef _WIN32
+  EnterCriticalSection(&m_Lock->Lock);
+#else
+  pthread_mutex_lock(&m_Lock->Lock);
+#endif
+}
+
+void CPathfinder::unlock()
+{
+#ifdef _WIN32
+  LeaveCriticalSection(&m_Lock->Lock);
+#else
+  pthread_mutex_unlock(&m_Lock->Lock);
+#endif
+}
+
+void CPathfinder::addGeometry(irr::scene::IMesh *mesh, const irr::core::matrix4& transform)
+{
+  if(mesh == NULL)
+    return;
+
+  irr::f32 minNormalY = cosf(NAV_MAX_SLOPE * irr::core::DEGTORAD);
+
+  for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+  {
+    irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+
+    const irr::u16 *indices16 = buffer->getIndices();
+    const irr::u32 *indices32 = (const irr::u32*)buffer->getIndices();
+    bool bigIndices = buffer->getIndexType() == irr::video::EIT_32BIT;
+
+    for(irr::u32 i=0; i + 2 < buffer->getIndexCount(); i += 3)
+    {
+      irr::core::vector3df v[3];
+
+      for(irr::u32 k=0; k < 3; ++k)
+      {
+        v[k] = buffer->getPosition(bigIndices ? indices32[i+k] : indices16[i+k]);
+        transform.transformVect(v[k]);
+      }
+
+      irr::core::triangle3df triangle(v[0], v[1], v[2]);
+      irr::core::vector3df normal = triangle.getNormal();
+
+      // Degenerate
+      if(normal.getLengthSQ() < 0.000001f)
+        continue;
+
+      normal.normalize();
+
+      if(normal.Y < minNormalY)
+        continue;
+
+      m_Triangles.push_back(v[0]);
+      m_Triangles.push_back(v[1]);
+      m_Triangles.push_back(v[2]);
+    }
+  }
+}
+
+irr::u32 CPathfinder::getChecksum()
+{
+  // FNV-1a over the collected triangles, positions rounded to centimeters
+  irr::u32 hash = 2166136261u;
+
+  for(irr::u32 i=0; i < m_Triangles.size(); ++i)
+  {
+    irr::s32 values[3] = {
+      irr::core::round32(m_Triangles[i].X * 100.f),
+      irr::core::round32(m_Triangles[i].Y * 100.f),
+      irr::core::round32(m_Triangles[i].Z * 100.f) };
+
+    for(irr::u32 k=0; k < 3; ++k)
+    {
+      hash ^= irr::u32(values[k]);
+      hash *= 16777619u;
+    }
+  }
+
+  return hash ^ m_Triangles.size();
+}
+
+void CPathfinder::build(const irr::io::path& navFile)
+{
+  finishRequests();
+
+  irr::u32 startTime = Core->getRenderer()->getTimer()->getRealTime();
+  irr::u32 checksum = getChecksum();
+
+  m_Polygons.clear();
+
+  bool loaded = load(navFile, checksum);
+
+  if(!loaded)
+  {
+    for(irr::u32 i=0; i + 2 < m_Triangles.size(); i += 3)
+    {
+      SNavPolygon polygon;
+
+      polygon.Vertices[0] = m_Triangles[i];
+      polygon.Vertices[1] = m_Triangles[i+1];
+      polygon.Vertices[2] = m_Triangles[i+2];
+      polygon.Center = (m_Triangles[i] + m_Triangles[i+1] + m_Triangles[i+2]) / 3.f;
+
+      m_Polygons.push_back(polygon);
+    }
+
+    connectPolygons();
+
+    if(m_Polygons.size() > 0)
+      save(navFile, checksum);
+  }
+
+  m_Triangles.clear();
+
+  buildGrid();
+  buildRegions();
+
+  delete m_Search;
+  m_Search = createSearch();
+
+  printf("Navigation mesh: %d polygons, %d regions, %s in %d ms\n",
+    m_Polygons.size(),
+    m_Regions.size(),
+    loaded ? "loaded" : "built",
+    Core->getRenderer()->getTimer()->getRealTime() - startTime);
+}
+
+void CPathfinder::connectPolygons()
+{
+  typedef std::pair<irr::s32, std::pair<irr::s32, irr::s32> > SVertexKey;
+  typedef std::pair<irr::u32, irr::u32> SEdgeKey;
+
+  // Weld vertices so triangles of the same mesh share their edges
+
+  std::map<SVertexKey, irr::u32> vertexIds;
+  irr::core::array<irr::u32> polygonVertices;
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    for(irr::u32 k=0; k < 3; ++k)
+    {
+      const irr::core::vector3df &v = m_Polygons[p].Vertices[k];
+
+      SVertexKey key(irr::core::round32(v.X / NAV_WELD_DISTANCE),
+        std::pair<irr::s32, irr::s32>(irr::core::round32(v.Y / NAV_WELD_DISTANCE), irr::core::round32(v.Z / NAV_WELD_DISTANCE)));
+
+      std::map<SVertexKey, irr::u32>::iterator found = vertexIds.find(key);
+
+      if(found == vertexIds.end())
+      {
+        irr::u32 id = vertexIds.size();
+        vertexIds[key] = id;
+        polygonVertices.push_back(id);
+      }
+      else
+      {
+        polygonVertices.push_back(found->second);
+      }
+    }
+  }
+
+  // Polygons sharing an edge are neighbours
+
+  std::map<SEdgeKey, SNavEdge> edges;
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    for(irr::u32 k=0; k < 3; ++k)
+    {
+      irr::u32 a = polygonVertices[p*3 + k];
+      irr::u32 b = polygonVertices[p*3 + (k+1) % 3];
+
+      SEdgeKey key(irr::core::min_(a, b), irr::core::max_(a, b));
+
+      std::map<SEdgeKey, SNavEdge>::iterator found = edges.find(key);
+
+      if(found == edges.end())
+      {
+        SNavEdge edge;
+        edge.Polygon = p;
+        edge.Count = 1;
+
+        edges[key] = edge;
+        continue;
+      }
+
+      found->second.Count++;
+
+      irr::u32 q = found->second.Polygon;
+
+      if(q == p || m_Polygons[p].Neighbours.linear_search(q) != -1)
+        continue;
+
+      irr::core::vector3df portal = (m_Polygons[p].Vertices[k] + m_Polygons[p].Vertices[(k+1) % 3]) * 0.5f;
+
+      m_Polygons[p].Neighbours.push_back(q);
+      m_Polygons[p].Portals.push_back(portal);
+      m_Polygons[q].Neighbours.push_back(p);
+      m_Polygons[q].Portals.push_back(portal);
+    }
+  }
+
+  // Open edges of separate meshes (stairs, buildings standing on the terrain)
+  // are linked when they line up and the height difference is a step
+
+  irr::core::array<SNavOpenEdge> openEdges;
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    for(irr::u32 k=0; k < 3; ++k)
+    {
+      irr::u32 a = polygonVertices[p*3 + k];
+      irr::u32 b = polygonVertices[p*3 + (k+1) % 3];
+
+      if(edges[SEdgeKey(irr::core::min_(a, b), irr::core::max_(a, b))].Count != 1)
+        continue;
+
+      SNavOpenEdge edge;
+      edge.Polygon = p;
+      edge.A = m_Polygons[p].Vertices[k];
+      edge.B = m_Polygons[p].Vertices[(k+1) % 3];
+
+      openEdges.push_back(edge);
+    }
+  }
+
+  typedef std::pair<irr::s32, irr::s32> SCellKey;
+
+  std::map<SCellKey, irr::core::array<irr::u32> > cells;
+
+  for(irr::u32 i=0; i < openEdges.size(); ++i)
+  {
+    irr::core::vector3df delta = openEdges[i].B - openEdges[i].A;
+    irr::u32 steps = irr::u32(delta.getLength() / NAV_LINK_CELL_SIZE) + 1;
+
+    SCellKey lastCell(0x7FFFFFFF, 0);
+
+    for(irr::u32 s=0; s <= steps; ++s)
+    {
+      irr::core::vector3df point = openEdges[i].A + delta * (irr::f32(s) / steps);
+
+      SCellKey cell(irr::s32(floorf(point.X / NAV_LINK_CELL_SIZE)), irr::s32(floorf(point.Z / NAV_LINK_CELL_SIZE)));
+
+      if(cell != lastCell)
+        cells[cell].push_back(i);
+
+      lastCell = cell;
+    }
+  }
+
+  irr::u32 links = 0;
+
+  for(std::map<SCellKey, irr::core::array<irr::u32> >::iterator cell = cells.begin(); cell != cells.end(); ++cell)
+  {
+    for(irr::s32 cx = -1; cx <= 1; ++cx)
+    for(irr::s32 cz = -1; cz <= 1; ++cz)
+    {
+      std::map<SCellKey, irr::core::array<irr::u32> >::iterator other =
+        cells.find(SCellKey(cell->first.first + cx, cell->first.second + cz));
+
+      if(other == cells.end())
+        continue;
+
+      for(irr::u32 i=0; i < cell->second.size(); ++i)
+      for(irr::u32 j=0; j < other->second.size(); ++j)
+      {
+        const SNavOpenEdge &e1 = openEdges[cell->second[i]];
+        const SNavOpenEdge &e2 = openEdges[other->second[j]];
+
+        if(e1.Polygon >= e2.Polygon || m_Polygons[e1.Polygon].Neighbours.linear_search(e2.Polygon) != -1)
+          continue;
+
+        irr::core::vector2df a1(e1.A.X, e1.A.Z), b1(e1.B.X, e1.B.Z);
+        irr::core::vector2df a2(e2.A.X, e2.A.Z), b2(e2.B.X, e2.B.Z);
+
+        irr::core::vector2df d1 = b1 - a1, d2 = b2 - a2;
+
+        if(d1.getLengthSQ() < 0.0001f || d2.getLengthSQ() < 0.0001f)
+          continue;
+
+        // Must run side by side
+        if(fabsf(irr::core::vector2df(d1).normalize().dotProduct(irr::core::vector2df(d2).normalize())) < 0.9f)
+          continue;
+
+        // Middle of the shorter edge projected on the longer one
+        const SNavOpenEdge &shortEdge = d1.getLengthSQ() < d2.getLengthSQ() ? e1 : e2;
+        const SNavOpenEdge &longEdge = d1.getLengthSQ() < d2.getLengthSQ() ? e2 : e1;
+
+        irr::core::vector3df middle = (shortEdge.A + shortEdge.B) * 0.5f;
+        irr::core::vector3df axis = longEdge.B - longEdge.A;
+
+        irr::f32 t = (middle - longEdge.A).dotProduct(axis) / axis.getLengthSQ();
+
+        if(t < 0.f || t > 1.f)
+          continue;
+
+        irr::core::vector3df closest = longEdge.A + axis * t;
+
+        irr::core::vector2df horizontal(closest.X - middle.X, closest.Z - middle.Z);
+
+        if(horizontal.getLength() > NAV_LINK_DISTANCE || fabsf(closest.Y - middle.Y) > MAX_STEP_HEIGHT)
+          continue;
+
+        irr::core::vector3df portal = (closest + middle) * 0.5f;
+
+        m_Polygons[e1.Polygon].Neighbours.push_back(e2.Polygon);
+        m_Polygons[e1.Polygon].Portals.push_back(portal);
+        m_Polygons[e2.Polygon].Neighbours.push_back(e1.Polygon);
+        m_Polygons[e2.Polygon].Portals.push_back(portal);
+
+        ++links;
+      }
+    }
+  }
+
+  printf("Navigation mesh: %d open edges, %d step links\n", openEdges.size(), links);
+}
+
+void CPathfinder::buildGrid()
+{
+  m_Grid.clear();
+  m_GridWidth = m_GridHeight = 0;
+
+  if(m_Polygons.size() == 0)
+    return;
+
+  irr::core::aabbox3df box(m_Polygons[0].Vertices[0]);
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+    for(irr::u32 k=0; k < 3; ++k)
+      box.addInternalPoint(m_Polygons[p].Vertices[k]);
+
+  m_GridOrigin.set(box.MinEdge.X, box.MinEdge.Z);
+  m_GridWidth = irr::u32((box.MaxEdge.X - box.MinEdge.X) / NAV_GRID_CELL_SIZE) + 1;
+  m_GridHeight = irr::u32((box.MaxEdge.Z - box.MinEdge.Z) / NAV_GRID_CELL_SIZE) + 1;
+
+  m_Grid.reallocate(m_GridWidth * m_GridHeight);
+
+  for(irr::u32 i=0; i < m_GridWidth * m_GridHeight; ++i)
+    m_Grid.push_back(irr::core::array<irr::u32>());
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    irr::core::aabbox3df polygonBox(m_Polygons[p].Vertices[0]);
+    polygonBox.addInternalPoint(m_Polygons[p].Vertices[1]);
+    polygonBox.addInternalPoint(m_Polygons[p].Vertices[2]);
+
+    irr::u32 x0 = irr::u32((polygonBox.MinEdge.X - m_GridOrigin.X) / NAV_GRID_CELL_SIZE);
+    irr::u32 x1 = irr::u32((polygonBox.MaxEdge.X - m_GridOrigin.X) / NAV_GRID_CELL_SIZE);
+    irr::u32 z0 = irr::u32((polygonBox.MinEdge.Z - m_GridOrigin.Y) / NAV_GRID_CELL_SIZE);
+    irr::u32 z1 = irr::u32((polygonBox.MaxEdge.Z - m_GridOrigin.Y) / NAV_GRID_CELL_SIZE);
+
+    for(irr::u32 z = z0; z <= z1 && z < m_GridHeight; ++z)
+      for(irr::u32 x = x0; x <= x1 && x < m_GridWidth; ++x)
+        m_Grid[z * m_GridWidth + x].push_back(p);
+  }
+}
+
+void CPathfinder::buildRegions()
+{
+  typedef std::pair<irr::s32, irr::s32> SCellKey;
+
+  const irr::u32 NO_REGION = 0xFFFFFFFF;
+
+  m_Regions.clear();
+  m_PolygonRegions.set_used(m_Polygons.size());
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+    m_PolygonRegions[p] = NO_REGION;
+
+  // Flood fill the polygons of each cell, so a region is always connected
+  // (two floors of a building in the same cell become two regions)
+
+  irr::core::array<irr::u32> stack;
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    if(m_PolygonRegions[p] != NO_REGION)
+      continue;
+
+    irr::u32 regionId = m_Regions.size();
+
+    SCellKey cell(irr::s32(floorf(m_Polygons[p].Center.X / NAV_REGION_SIZE)),
+      irr::s32(floorf(m_Polygons[p].Center.Z / NAV_REGION_SIZE)));
+
+    irr::core::array<irr::u32> members;
+    irr::core::vector3df middle(0,0,0);
+
+    m_PolygonRegions[p] = regionId;
+    stack.push_back(p);
+
+    while(stack.size() > 0)
+    {
+      irr::u32 current = stack.getLast();
+      stack.erase(stack.size() - 1);
+
+      members.push_back(current);
+      middle += m_Polygons[current].Center;
+
+      for(irr::u32 n=0; n < m_Polygons[current].Neighbours.size(); ++n)
+      {
+        irr::u32 neighbour = m_Polygons[current].Neighbours[n];
+
+        if(m_PolygonRegions[neighbour] != NO_REGION)
+          continue;
+
+        SCellKey neighbourCell(irr::s32(floorf(m_Polygons[neighbour].Center.X / NAV_REGION_SIZE)),
+          irr::s32(floorf(m_Polygons[neighbour].Center.Z / NAV_REGION_SIZE)));
+
+        if(neighbourCell != cell)
+          continue;
+
+        m_PolygonRegions[neighbour] = regionId;
+        stack.push_back(neighbour);
+      }
+    }
+
+    middle /= irr::f32(members.size());
+
+    SNavRegion region;
+    region.Representative = members[0];
+
+    for(irr::u32 i=1; i < members.size(); ++i)
+      if(m_Polygons[members[i]].Center.getDistanceFromSQ(middle)
+      < m_Polygons[region.Representative].Center.getDistanceFromSQ(middle))
+        region.Representative = members[i];
+
+    region.Center = m_Polygons[region.Representative].Center;
+
+    m_Regions.push_back(region);
+  }
+
+  // Region links, the cost goes through the cheapest border portal
+
+  irr::u32 links = 0;
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    SNavRegion &region = m_Regions[m_PolygonRegions[p]];
+
+    for(irr::u32 n=0; n < m_Polygons[p].Neighbours.size(); ++n)
+    {
+      irr::u32 otherId = m_PolygonRegions[m_Polygons[p].Neighbours[n]];
+
+      if(otherId == m_PolygonRegions[p])
+        continue;
+
+      const irr::core::vector3df &portal = m_Polygons[p].Portals[n];
+
+      irr::f32 cost = region.Center.getDistanceFrom(portal) + portal.getDistanceFrom(m_Regions[otherId].Center);
+
+      irr::s32 link = region.Neighbours.linear_search(otherId);
+
+      if(link == -1)
+      {
+        region.Neighbours.push_back(otherId);
+        region.Costs.push_back(cost);
+        region.Exits.push_back(p);
+
+        ++links;
+      }
+      else if(cost < region.Costs[link])
+      {
+        region.Costs[link] = cost;
+        region.Exits[link] = p;
+      }
+    }
+  }
+
+  printf("Navigation mesh: %d region links\n", links);
+}
+
+bool CPathfinder::load(const irr::io::path& file, irr::u32 checksum)
+{
+  irr::io::IFileSystem *fileSystem = Core->getRenderer()->getDevice()->getFileSystem();
+
+  if(!fileSystem->existFile(file))
+    return false;
+
+  irr::io::IReadFile *reader = fileSystem->createAndOpenFile(file);
+
+  if(!reader)
+    return false;
+
+  irr::u32 header[4] = {0, 0, 0, 0};
+  reader->read(header, sizeof(header));
+
+  // Cooked from other geometry or by another version
+  if(header[0] != NAV_FILE_MAGIC || header[1] != NAV_FILE_VERSION || header[2] != checksum)
+  {
+    reader->drop();
+    return false;
+  }
+
+  bool ok = true;
+
+  m_Polygons.reallocate(header[3]);
+
+  for(irr::u32 p=0; p < header[3] && ok; ++p)
+  {
+    SNavPolygon polygon;
+    irr::u32 neighbours = 0;
+
+    ok = reader->read(polygon.Vertices, sizeof(polygon.Vertices)) == sizeof(polygon.Vertices)
+      && reader->read(&neighbours, sizeof(neighbours)) == sizeof(neighbours);
+
+    for(irr::u32 n=0; n < neighbours && ok; ++n)
+    {
+      irr::u32 neighbour;
+      irr::core::vector3df portal;
+
+      ok = reader->read(&neighbour, sizeof(neighbour)) == sizeof(neighbour)
+        && reader->read(&portal, sizeof(portal)) == sizeof(portal)
+        && neighbour < header[3];
+
+      polygon.Neighbours.push_back(neighbour);
+      polygon.Portals.push_back(portal);
+    }
+
+    polygon.Center = (polygon.Vertices[0] + polygon.Vertices[1] + polygon.Vertices[2]) / 3.f;
+
+    m_Polygons.push_back(polygon);
+  }
+
+  reader->drop();
+
+  if(!ok)
+  {
+    printf("Navigation mesh: %s is broken, rebuilding\n", file.c_str());
+    m_Polygons.clear();
+  }
+
+  return ok;
+}
+
+void CPathfinder::save(const irr::io::path& file, irr::u32 checksum)
+{
+  irr::io::IWriteFile *writer =
+    Core->getRenderer()->getDevice()->getFileSystem()->createAndWriteFile(file);
+
+  if(!writer)
+  {
+    printf("Navigation mesh: unable to write %s\n", file.c_str());
+    return;
+  }
+
+  irr::u32 header[4] = { NAV_FILE_MAGIC, NAV_FILE_VERSION, checksum, m_Polygons.size() };
+  writer->write(header, sizeof(header));
+
+  for(irr::u32 p=0; p < m_Polygons.size(); ++p)
+  {
+    irr::u32 neighbours = m_Polygons[p].Neighbours.size();
+
+    writer->write(m_Polygons[p].Vertices, sizeof(m_Polygons[p].Vertices));
+    writer->write(&neighbours, sizeof(neighbours));
+
+    for(irr::u32 n=0; n < neighbours; ++n)
+    {
+      writer->write(&m_Polygons[p].Neighbours[n], sizeof(irr::u32));
+      writer->write(&m_Polygons[p].Portals[n], sizeof(irr::core::vector3df));
+    }
+  }
+
+  writer->drop();
+}
+
+void CPathfinder::clear()
+{
+  // Jobs still queued find nothing left to solve
+  lock();
+  m_Queue.clear();
+  unlock();
+
+  finishRequests();
+
+  lock();
+
+  for(irr::u32 i=0; i < m_Requests.size(); ++i)
+    delete m_Requests[i];
+
+  m_Requests.clear();
+
+  unlock();
+
+  clearCache();
+
+  delete m_Search;
+  m_Search = (SNavSearch*)NULL;
+
+  m_Triangles.clear();
+  m_Polygons.clear();
+  m_Regions.clear();
+  m_PolygonRegions.clear();
+  m_Grid.clear();
+  m_GridWidth = m_GridHeight = 0;
+}
+
+void CPathfinder::clearCache()
+{
+  lock();
+
+  m_CacheIndex.clear();
+
+  for(irr::u32 i=0; i < NAV_PATH_CACHE_SIZE; ++i)
+    m_Cache[i].Regions.clear();
+
+  m_NextCacheSlot = 0;
+  m_CacheHits = m_CacheMisses = 0;
+
+  unlock();
+}
+
+SNavSearch *CPathfinder::createSearch()
+{
+  return new SNavSearch(this);
+}
+
+irr::s32 CPathfinder::getPolygonAt(const irr::core::vector3df& position)
+{
+  if(m_Grid.size() == 0)
+    return -1;
+
+  irr::s32 cellX = irr::core::clamp(irr::s32((position.X - m_GridOrigin.X) / NAV_GRID_CELL_SIZE), 0, irr::s32(m_GridWidth) - 1);
+  irr::s32 cellZ = irr::core::clamp(irr::s32((position.Z - m_GridOrigin.Y) / NAV_GRID_CELL_SIZE), 0, irr::s32(m_GridHeight) - 1);
+
+  // Highest surface under the position
+  irr::s32 best = -1;
+  irr::f32 bestHeight = -FLT_MAX;
+
+  const irr::core::array<irr::u32> &cell = m_Grid[cellZ * m_GridWidth + cellX];
+
+  for(irr::u32 i=0; i < cell.size(); ++i)
+  {
+    const SNavPolygon &polygon = m_Polygons[cell[i]];
+
+    const irr::core::vector3df &a = polygon.Vertices[0];
+    const irr::core::vector3df &b = polygon.Vertices[1];
+    const irr::core::vector3df &c = polygon.Vertices[2];
+
+    // Barycentric coordinates on the XZ plane
+    irr::f32 det = (b.Z - c.Z) * (a.X - c.X) + (c.X - b.X) * (a.Z - c.Z);
+
+    if(fabsf(det) < 0.000001f)
+      continue;
+
+    irr::f32 u = ((b.Z - c.Z) * (position.X - c.X) + (c.X - b.X) * (position.Z - c.Z)) / det;
+    irr::f32 v = ((c.Z - a.Z) * (position.X - c.X) + (a.X - c.X) * (position.Z - c.Z)) / det;
+    irr::f32 w = 1.f - u - v;
+
+    if(u < 0.f || v < 0.f || w < 0.f)
+      continue;
+
+    irr::f32 height = a.Y * u + b.Y * v + c.Y * w;
+
+    if(height <= position.Y + MAX_STEP_HEIGHT && height > bestHeight
+    && position.Y - height <= NAV_MAX_HEIGHT_ABOVE)
+    {
+      best = cell[i];
+      bestHeight = height;
+    }
+  }
+
+  if(best != -1)
+    return best;
+
+  // Off the mesh, take the closest polygon around
+  irr::f32 bestDistance = FLT_MAX;
+
+  for(irr::s32 z = cellZ - 1; z <= cellZ + 1; ++z)
+  for(irr::s32 x = cellX - 1; x <= cellX + 1; ++x)
+  {
+    if(x < 0 || z < 0 || x >= irr::s32(m_GridWidth) || z >= irr::s32(m_GridHeight))
+      continue;
+
+    const irr::core::array<irr::u32> &near = m_Grid[z * m_GridWidth + x];
+
+    for(irr::u32 i=0; i < near.size(); ++i)
+    {
+      irr::f32 distance = m_Polygons[near[i]].Center.getDistanceFromSQ(position);
+
+      if(distance < bestDistance)
+      {
+        bestDistance = distance;
+        best = near[i];
+      }
+    }
+  }
+
+  return best;
+}
+
+bool CPathfinder::solveFlat(SNavSearch *search, irr::u32 start, irr::u32 goal, irr::core::array<irr::u32>& polygons)
+{
+  std::vector<void*> states;
+  float cost = 0.f;
+
+  int result = search->FlatPather.Solve(toState(start), toState(goal), &states, &cost);
+
+  if(result == micropather::MicroPather::NO_SOLUTION)
+    return false;
+
+  polygons.set_used(0);
+
+  if(result == micropather::MicroPather::START_END_SAME)
+    polygons.push_back(start);
+
+  for(irr::u32 i=0; i < states.size(); ++i)
+    polygons.push_back(fromState(states[i]));
+
+  return true;
+}
+
+bool CPathfinder::solveCorridor(SNavSearch *search, irr::u32 regionA, irr::u32 regionB,
+  irr::u32 start, irr::u32 goal, irr::core::array<irr::u32>& polygons)
+{
+  CNavPolygonGraph &graph = search->CorridorGraph;
+
+  // MicroPather caches the neighbours of every state it has seen,
+  // they change with the corridor
+  if(graph.RegionA != regionA || graph.RegionB != regionB)
+  {
+    graph.RegionA = regionA;
+    graph.RegionB = regionB;
+
+    search->CorridorPather.Reset();
+  }
+
+  std::vector<void*> states;
+  float cost = 0.f;
+
+  int result = search->CorridorPather.Solve(toState(start), toState(goal), &states, &cost);
+
+  if(result == micropather::MicroPather::NO_SOLUTION)
+    return false;
+
+  polygons.set_used(0);
+
+  if(result == micropather::MicroPather::START_END_SAME)
+    polygons.push_back(start);
+
+  for(irr::u32 i=0; i < states.size(); ++i)
+    polygons.push_back(fromState(states[i]));
+
+  return true;
+}
+
+bool CPathfinder::solvePolygons(SNavSearch *search, irr::u32 start, irr::u32 goal, irr::core::array<irr::u32>& polygons)
+{
+  irr::u32 startRegion = m_PolygonRegions[start];
+  irr::u32 goalRegion = m_PolygonRegions[goal];
+
+  // Close enough for a single corridor search. It can fail when the way
+  // around leaves both regions.
+  if(startRegion == goalRegion || m_Regions[startRegion].Neighbours.linear_search(goalRegion) != -1)
+  {
+    if(solveCorridor(search, startRegion, goalRegion, start, goal, polygons))
+      return true;
+
+    return solveFlat(search, start, goal, polygons);
+  }
+
+  // High level path
+
+  SPathKey key(startRegion, goalRegion);
+
+  irr::core::array<irr::u32> regions;
+
+  lock();
+
+  std::map<SPathKey, irr::u32>::iterator cached = m_CacheIndex.find(key);
+
+  if(cached != m_CacheIndex.end())
+  {
+    regions = m_Cache[cached->second].Regions;
+    ++m_CacheHits;
+  }
+  else
+  {
+    ++m_CacheMisses;
+  }
+
+  unlock();
+
+  if(regions.size() == 0)
+  {
+    std::vector<void*> states;
+    float cost = 0.f;
+
+    if(search->RegionPather.Solve(toState(startRegion), toState(goalRegion), &states, &cost) != micropather::MicroPather::SOLVED)
+      return false;
+
+    for(irr::u32 i=0; i < states.size(); ++i)
+      regions.push_back(fromState(states[i]));
+
+    lock();
+
+    // Another thread could have solved the same pair meanwhile
+    if(m_CacheIndex.find(key) == m_CacheIndex.end())
+    {
+      SCachedPath &slot = m_Cache[m_NextCacheSlot];
+
+      if(slot.Regions.size() > 0)
+        m_CacheIndex.erase(slot.Key);
+
+      slot.Key = key;
+      slot.Regions = regions;
+
+      m_CacheIndex[key] = m_NextCacheSlot;
+
+      m_NextCacheSlot = (m_NextCacheSlot + 1) % NAV_PATH_CACHE_SIZE;
+    }
+
+    unlock();
+  }
+
+  // Refine through one region at a time: from the current polygon to the
+  // border of the next region towards the one after it
+
+  polygons.set_used(0);
+  polygons.push_back(start);
+
+  irr::u32 current = start;
+
+  irr::core::array<irr::u32> leg;
+
+  for(irr::u32 i=0; i + 1 < regions.size(); ++i)
+  {
+    irr::u32 target = goal;
+
+    if(i + 2 < regions.size())
+    {
+      const SNavRegion &next = m_Regions[regions[i+1]];
+      target = next.Exits[next.Neighbours.linear_search(regions[i+2])];
+    }
+
+    if(!solveCorridor(search, regions[i], regions[i+1], current, target, leg))
+      return solveFlat(search, start, goal, polygons);
+
+    for(irr::u32 j=1; j < leg.size(); ++j)
+      polygons.push_back(leg[j]);
+
+    current = target;
+  }
+
+  return true;
+}
+
+bool CPathfinder::solve(SNavSearch *search, const irr::core::vector3df& start,
+  const irr::core::vector3df& end, irr::core::array<irr::core::vector3df>& path)
+{
+  path.set_used(0);
+
+  irr::s32 startPolygon = getPolygonAt(start);
+  irr::s32 endPolygon = getPolygonAt(end);
+
+  if(startPolygon < 0 || endPolygon < 0)
+    return false;
+
+  irr::core::array<irr::u32> polygons;
+
+  if(!solvePolygons(search, startPolygon, endPolygon, polygons))
+    return false;
+
+  // Walk from portal to portal
+  path.push_back(start);
+
+  for(irr::u32 i=1; i < polygons.size(); ++i)
+  {
+    const SNavPolygon &polygon = m_Polygons[polygons[i-1]];
+
+    irr::s32 n = polygon.Neighbours.linear_search(polygons[i]);
+
+    if(n != -1)
+      path.push_back(polygon.Portals[n]);
+  }
+
+  path.push_back(end);
+
+  return true;
+}
+
+bool CPathfinder::findPath(const irr::core::vector3df& start, const irr::core::vector3df& end,
+  irr::core::array<irr::core::vector3df>& path)
+{
+  if(!m_Search)
+    return false;
+
+  return solve(m_Search, start, end, path);
+}
+
+irr::u32 CPathfinder::requestPath(const irr::core::vector3df& start, const irr::core::vector3df& end)
+{
+  if(!isReady())
+    return 0;
+
+  SPathRequest *request = new SPathRequest();
+
+  request->Start = start;
+  request->End = end;
+  request->Status = EPS_PENDING;
+  request->Taken = false;
+  request->Cancelled = false;
+
+  lock();
+
+  request->Ticket = m_NextTicket++;
+
+  if(m_NextTicket == 0)
+    m_NextTicket = 1;
+
+  m_Requests.push_back(request);
+  m_Queue.push_back(request);
+
+  irr::u32 ticket = request->Ticket;
+
+  unlock();
+
+  // Without workers update() solves it on this thread
+  if(Core->getJobs()->getWorkerCount() > 0)
+    Core->getJobs()->submitBackground(pathfinder_RunRequest, this, &m_RequestJobs);
+
+  return ticket;
+}
+
+E_PATH_STATUS CPathfinder::getPath(irr::u32 ticket, irr::core::array<irr::core::vector3df>& path)
+{
+  E_PATH_STATUS status = EPS_UNKNOWN;
+
+  lock();
+
+  for(irr::u32 i=0; i < m_Requests.size(); ++i)
+  {
+    SPathRequest *request = m_Requests[i];
+
+    if(request->Ticket != ticket)
+      continue;
+
+    status = request->Status;
+
+    if(status != EPS_PENDING)
+    {
+      path = request->Path;
+
+      m_Requests.erase(i);
+      delete request;
+    }
+
+    break;
+  }
+
+  unlock();
+
+  return status;
+}
+
+void CPathfinder::cancelPath(irr::u32 ticket)
+{
+  lock();
+
+  for(irr::u32 i=0; i < m_Requests.size(); ++i)
+  {
+    SPathRequest *request = m_Requests[i];
+
+    if(request->Ticket != ticket)
+      continue;
+
+    m_Requests.erase(i);
+
+    if(!request->Taken)
+    {
+      for(irr::core::list<SPathRequest*>::Iterator it = m_Queue.begin(); it != m_Queue.end(); ++it)
+      {
+        if(*it == request)
+        {
+          m_Queue.erase(it);
+          break;
+        }
+      }
+
+      delete request;
+    }
+    // A job is solving it, the job deletes it
+    else if(request->Status == EPS_PENDING)
+    {
+      request->Cancelled = true;
+    }
+    else
+    {
+      delete request;
+    }
+
+    break;
+  }
+
+  unlock();
+}
+
+void CPathfinder::update()
+{
+  if(Core->getJobs()->getWorkerCount() > 0 || !m_Search)
+    return;
+
+  lock();
+
+  if(m_Queue.empty())
+  {
+    unlock();
+    return;
+  }
+
+  irr::core::list<SPathRequest*>::Iterator first = m_Queue.begin();
+
+  SPathRequest *request = *first;
+  m_Queue.erase(first);
+
+  unlock();
+
+  bool found = solve(m_Search, request->Start, request->End, request->Path);
+
+  request->Status = found ? EPS_FOUND : EPS_NOT_FOUND;
+}
+
+void CPathfinder::serveRequest(irr::u32 thread)
+{
+  lock();
+
+  // Cancelled or cleared meanwhile
+  if(m_Queue.empty())
+  {
+    unlock();
+    return;
+  }
+
+  irr::core::list<SPathRequest*>::Iterator first = m_Queue.begin();
+
+  SPathRequest *request = *first;
+  m_Queue.erase(first);
+
+  request->Taken = true;
+
+  unlock();
+
+  // MicroPather keeps per search state, every job thread needs its own.
+  // Only this thread touches its slot until finishRequests().
+  if(!m_Searches[thread])
+    m_Searches[thread] = createSearch();
+
+  irr::core::array<irr::core::vector3df> path;
+  bool found = solve(m_Searches[thread], request->Start, request->End, path);
+
+  lock();
+
+  if(request->Cancelled)
+  {
+    delete request;
+  }
+  else
+  {
+    request->Path = path;
+    request->Status = found ? EPS_FOUND : EPS_NOT_FOUND;
+  }
+
+  unlock();
+}
+
+void CPathfinder::finishRequests()
+{
+  Core->getJobs()->wait(&m_RequestJobs);
+
+  for(irr::u32 i=0; i < JOB_MAX_THREADS; ++i)
+  {
+    delete m_Searches[i];
+    m_Searches[i] = (SNavSearch*)NULL;
+  }
+}
+
+void CPathfinder::benchmark(irr::u32 queries)
+{
+  if(!isReady() || queries == 0)
+    return;
+
+  SNavSearch *search = createSearch();
+
+  // Same random pairs for every pass
+  irr::core::array<irr::u32> starts, goals;
+
+  for(irr::u32 i=0; i < queries; ++i)
+  {
+    starts.push_back(Core->getMath()->getRandomInt(0, m_Polygons.size() - 1));
+    goals.push_back(Core->getMath()->getRandomInt(0, m_Polygons.size() - 1));
+  }
+
+  const irr::c8 *names[3] = { "flat", "hierarchical", "hierarchical, cached" };
+
+  printf("Path benchmark: %d queries, %d polygons, %d regions\n", queries, m_Polygons.size(), m_Regions.size());
+
+  clearCache();
+
+  irr::core::array<irr::u32> polygons;
+
+  for(irr::u32 pass=0; pass < 3; ++pass)
+  {
+    irr::u32 found = 0;
+    irr::u32 expansions = search->getExpansions();
+    irr::u32 start = getMicroseconds();
+
+    for(irr::u32 i=0; i < queries; ++i)
+    {
+      bool solved = pass == 0
+        ? solveFlat(search, starts[i], goals[i], polygons)
+        : solvePolygons(search, starts[i], goals[i], polygons);
+
+      if(solved)
+        ++found;
+    }
+
+    irr::u32 time = getMicroseconds() - start;
+    expansions = search->getExpansions() - expansions;
+
+    printf("\t%s: %d found, %.1f expansions/query, %.1f us/query\n",
+      names[pass], found, irr::f32(expansions) / queries, irr::f32(time) / queries);
+  }
+
+  // Don't leave the benchmark's pairs in the cache statistics
+  clearCache();
+
+  delete search;
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "Core.h"
 #include "Physics.h"
 #include "Renderer.h"
+#include "ObjectManager.h"
+#include "Pathfinder.h"
 
 using namespace engine;
 
@@ -32,7 +34,28 @@ CPhysicsManager::CPhysicsManager(CCore* core) : Core(core)
 
   PhysicsWorld = new CPhysicsWorld(Core->getRenderer()->getDevice()->getTimer());
 
-  PhysicsWorld->createNewtonWorld();
+  Ragdolls = new CRagdollManager(Core);
+
+  Breakables = new CBreakableManager(Core);
+
+  Projectiles = new CProjectileManager(Core);
+
+  Vehicles = new CVehicleManager(Core);
+
+  m_ActivationTime = 0.f;
+  m_ActiveBodies = m_SleepingBodies = m_FrozenBodies = 0;
+
+  // -physicsgrid keeps Newton's grid broadphase instead of the AABB tree
+  if(Core->commandLineParameters.hasParam("-physicsgrid"))
+    PhysicsWorld->setBroadphase(PHYSICS_BROADPHASE_GRID);
+
+  // -physicsx87 keeps the solver off the SSE paths (to compare results)
+  PhysicsWorld->createNewtonWorld(Core->getJobs(),
+    Core->commandLineParameters.hasParam("-physicsx87") ? PHYSICS_ARCHITECTURE_X87 : PHYSICS_ARCHITECTURE_BEST);
+
+  // -physbench <steps> times the solver on a test scene with every architecture
+  if(Core->commandLineParameters.hasParam("-physbench"))
+    PhysicsWorld->benchmark(atoi(Core->commandLineParameters.getParamValue("-physbench").c_str()));
 #endif
 }
 
@@ -67,7 +90,7 @@ void CPhysicsManager::clearMeshGroups()
 
 void CPhysicsManager::initOnLevel()
 {
-  PhysicsWorld->clear();
+  clear();
 }
 
 void CPhysicsManager::update(
@@ -78,14 +101,146 @@ void CPhysicsManager::update(
 
 void CPhysicsManager::update2()
 {
+  // Newton takes one step of its step length per frame, the vehicles and
+  // the rounds move by that same step to stay in line with the bodies
+  irr::f32 step = PhysicsWorld->getTimeStep();
+
+  // The wheels are cast where the last tick left the vehicles, the forces
+  // of this tick push off those contacts
+  Vehicles->update(step);
+
   //PhysicsWorld->advanceSimulation2();
   PhysicsWorld->advanceSimulation3(Core->time.delta);
+
+  // The rounds are cast against the bodies where this tick left them
+  Projectiles->update(step);
+
+  // The frame ends on the tick, the vehicle nodes are drawn where it left them
+  Vehicles->updateNodes(1.f, Core->time.delta);
+
+  updateActivation(Core->time.delta);
+
+  Ragdolls->update(Core->time.delta);
+
+  Breakables->update(Core->time.delta);
+}
+
+void CPhysicsManager::updateActivation(irr::f32 time)
+{
+  m_ActivationTime += time;
+
+  if(m_ActivationTime < PHYSICS_ACTIVATION_INTERVAL)
+    return;
+
+  m_ActivationTime = 0.f;
+
+  irr::core::array<irr::core::vector3df> characters;
+
+  for(irr::u32 i=0; i < m_CharacterBodies.size(); ++i)
+  {
+    if(m_CharacterBodies[i]->getNewtonBody())
+      characters.push_back(m_CharacterBodies[i]->getPosition());
+  }
+
+  // Without characters (menus, editor) nothing is frozen
+  irr::core::array<irr::f32> distances;
+  irr::core::array<bool> wasFrozen;
+
+  distances.set_used(m_DynamicBodies.size());
+  wasFrozen.set_used(m_DynamicBodies.size());
+
+  for(irr::u32 i=0; i < m_DynamicBodies.size(); ++i)
+  {
+    NewtonBody *body = m_DynamicBodies[i]->getNewtonBody();
+
+    distances[i] = 0.f;
+    wasFrozen[i] = body && NewtonBodyGetFreezeState(body);
+
+    if(!body || characters.size() == 0)
+      continue;
+
+    irr::core::vector3df position = m_DynamicBodies[i]->getPosition();
+
+    distances[i] = position.getDistanceFromSQ(characters[0]);
+
+    for(irr::u32 c=1; c < characters.size(); ++c)
+      distances[i] = irr::core::min_(distances[i], position.getDistanceFromSQ(characters[c]));
+  }
+
+  // Far bodies first. Freezing spreads to the bodies a far body touches,
+  // the pass below thaws those again when they weren't meant to freeze.
+  for(irr::u32 i=0; i < m_DynamicBodies.size(); ++i)
+  {
+    NewtonBody *body = m_DynamicBodies[i]->getNewtonBody();
+
+    if(body && distances[i] > PHYSICS_FREEZE_RADIUS * PHYSICS_FREEZE_RADIUS)
+      NewtonBodySetFreezeState(body, 1);
+  }
+
+  const irr::f32 movingSpeed = PHYSICS_SLEEP_SPEED * IrrToNewton;
+
+  for(irr::u32 i=0; i < m_DynamicBodies.size(); ++i)
+  {
+    NewtonBody *body = m_DynamicBodies[i]->getNewtonBody();
+
+    if(!body || !NewtonBodyGetFreezeState(body))
+      continue;
+
+    bool distant = distances[i] > PHYSICS_FREEZE_RADIUS * PHYSICS_FREEZE_RADIUS;
+    bool nearby = distances[i] < PHYSICS_WAKE_RADIUS * PHYSICS_WAKE_RADIUS;
+
+    bool thaw = nearby || (!distant && !wasFrozen[i]);
+
+    // A moving body (a projectile, a door) touching a frozen one
+    for(NewtonJoint *joint = NewtonBodyGetFirstContactJoint(body); joint && !thaw;
+      joint = NewtonBodyGetNextContactJoint(body, joint))
+    {
+      NewtonBody *other = NewtonJointGetBody0(joint);
+
+      if(other == body)
+        other = NewtonJointGetBody1(joint);
+
+      irr::f32 velocity[3];
+      NewtonBodyGetVelocity(other, velocity);
+
+      thaw = velocity[0]*velocity[0] + velocity[1]*velocity[1] + velocity[2]*velocity[2] > movingSpeed * movingSpeed;
+    }
+
+    if(thaw)
+      m_DynamicBodies[i]->wake();
+  }
+
+  m_ActiveBodies = m_SleepingBodies = m_FrozenBodies = 0;
+
+  for(irr::u32 i=0; i < m_DynamicBodies.size(); ++i)
+  {
+    NewtonBody *body = m_DynamicBodies[i]->getNewtonBody();
+
+    if(!body)
+      continue;
+
+    if(NewtonBodyGetFreezeState(body))
+      ++m_FrozenBodies;
+    else if(NewtonBodyGetSleepState(body))
+      ++m_SleepingBodies;
+    else
+      ++m_ActiveBodies;
+  }
 }
 
 void CPhysicsManager::close()
 {
+  Ragdolls->clear();
+  Breakables->clear();
+  Projectiles->clear();
+  Vehicles->clear();
+
   PhysicsWorld->closeNewtonWorld();
 
+  delete Ragdolls;
+  delete Breakables;
+  delete Projectiles;
+  delete Vehicles;
   delete PhysicsWorld;
 }
 
@@ -106,6 +261,11 @@ physics::CBody * CPhysicsManager::createCharacterBody(irr::scene::IAnimatedMeshS
   charBody->createUpVectorConstraint(irr::core::vector3df(0,1,0));
   charBody->setContinuousCollisionMode(true);
 
+  // Moved by the game every frame, never put to sleep
+  NewtonBodySetAutoSleep(charBody->getNewtonBody(), 0);
+
+  m_CharacterBodies.push_back(charBody);
+
   //
   // Now let's create two more collisions. One for crouching and one for lying down.
 
@@ -156,6 +316,9 @@ physics::CBody * CPhysicsManager::createBodyForNode(
 
   body = PhysicsWorld->createBody(bodyParameters);
 
+  if(dynamic)
+    m_DynamicBodies.push_back(body);
+
   // Release collision
   PhysicsWorld->getCollisionManager()->releaseCollision(
     PhysicsWorld->getNewtonWorld(),
@@ -176,6 +339,23 @@ irr::core::array<CBody*> CPhysicsManager::createStaticPhysics(
 	if(node == NULL)
     return bodies;
 
+  // The bodies are rotated after creation, the navigation mesh and the
+  // merged static faces need the final transformation
+  node->updateAbsolutePosition();
+  irr::core::matrix4 transformation = node->getAbsoluteTransformation();
+
+  // Moving (-d) nodes keep a Newton body of their own, the rest of the
+  // level is merged into the static regions of the physics world
+  bool merge = !Core->getObjects()->isNodeParameterSet(irr::core::stringc(node->getName()), "d");
+
+  // Breakable (-b) props get their collision when the pieces are cooked,
+  // they stay out of the navigation mesh
+  if(Core->getObjects()->isNodeParameterSet(irr::core::stringc(node->getName()), "b"))
+  {
+    bodies.push_back(Breakables->addProp(node, PhysicsWorld->getUniqueBodyID()));
+    return bodies;
+  }
+
   irr::core::vector3df rotation = node->getRotation();
   node->setRotation(NULLVECTOR);
 
@@ -191,16 +371,25 @@ irr::core::array<CBody*> CPhysicsManager::createStaticPhysics(
   {
     irr::scene::IMesh *mesh = getPhysicsMesh(node);
 
+#ifdef MICROPATHER
+    Core->getObjects()->getPathfinder()->addGeometry(mesh, transformation);
+#endif
+
     bodyParameters.mesh = mesh;
     bodyParameters.bodyID = PhysicsWorld->getUniqueBodyID();
 
-    CBody * body = PhysicsWorld->createBody(bodyParameters);
+    if(merge)
+      bodies.push_back(PhysicsWorld->createStaticBody(bodyParameters, transformation));
+    else
+    {
+      CBody * body = PhysicsWorld->createBody(bodyParameters);
 
-    PhysicsWorld->getCollisionManager()->releaseCollision(
-      PhysicsWorld->getNewtonWorld(),
-      body->getCurrentCollision());
+      PhysicsWorld->getCollisionManager()->releaseCollision(
+        PhysicsWorld->getNewtonWorld(),
+        body->getCurrentCollision());
 
-    bodies.push_back(body);
+      bodies.push_back(body);
+    }
   }
   // Multi-body object (group), contains several nodes
   else
@@ -212,13 +401,11 @@ irr::core::array<CBody*> CPhysicsManager::createStaticPhysics(
       bodyParameters.mesh = meshGroup.meshes[i];
       bodyParameters.bodyID = PhysicsWorld->getUniqueBodyID();
 
-      CBody * body = PhysicsWorld->createBody(bodyParameters);
-
-      PhysicsWorld->getCollisionManager()->releaseCollision(
-        PhysicsWorld->getNewtonWorld(),
-        body->getCurrentCollision());
+#ifdef MICROPATHER
+      Core->getObjects()->getPathfinder()->addGeometry(meshGroup.meshes[i], transformation);
+#endif
 
-      bodies.push_back(body);
+      bodies.push_back(PhysicsWorld->createStaticBody(bodyParameters, transformation));
     }
   }
 
@@ -231,6 +418,42 @@ irr::core::array<CBody*> CPhysicsManager::createStaticPhysics(
   return bodies;
 }
 
+physics::CBody * CPhysicsManager::createKinematicBody(irr::scene::ISceneNode* node)
+{
+  SBodyCreationParameters bodyParameters;
+
+  bodyParameters.node = node;
+  bodyParameters.mesh = ((irr::scene::IMeshSceneNode*)node)->getMesh();
+  bodyParameters.bodyID = PhysicsWorld->getUniqueBodyID();
+  bodyParameters.type = engine::physics::EBT_KINEMATIC;
+  bodyParameters.mass = 0.f;
+  bodyParameters.scale = node->getScale();
+
+  physics::CBody * body = PhysicsWorld->createBody(bodyParameters);
+
+  PhysicsWorld->getCollisionManager()->releaseCollision(
+    PhysicsWorld->getNewtonWorld(),
+    body->getCurrentCollision());
+
+  return body;
+}
+
+void CPhysicsManager::buildStaticWorld()
+{
+  irr::u32 start = Core->getRenderer()->getTimer()->getRealTime();
+
+  PhysicsWorld->buildStaticWorld();
+
+  printf("\tStatic collision: %d meshes in %d regions (%d ms)\n",
+    PhysicsWorld->getStaticBodyCount(),
+    PhysicsWorld->getStaticRegionCount(),
+    Core->getRenderer()->getTimer()->getRealTime() - start);
+
+  // -broadbench <queries> compares the broadphases on the loaded level
+  if(Core->commandLineParameters.hasParam("-broadbench"))
+    PhysicsWorld->benchmarkBroadphase(atoi(Core->commandLineParameters.getParamValue("-broadbench").c_str()));
+}
+
 void CPhysicsManager::createTestObject(irr::u32 type, irr::core::vector3df position)
 {
 #ifdef ENGINE_DEVELOPMENT_MODE
@@ -255,13 +478,26 @@ void CPhysicsManager::createTestObject(irr::u32 type, irr::core::vector3df posit
     CBody * cubeBody = PhysicsWorld->createBody(box_params);
 
     cubeBody->setPosition(position);
+
+    m_DynamicBodies.push_back(cubeBody);
   }
 #endif
 }
 
 void CPhysicsManager::clear()
 {
+  // The pool bodies go before the world destroys all bodies
+  Ragdolls->clear();
+  Breakables->clear();
+  Projectiles->clear();
+  Vehicles->clear();
+
   PhysicsWorld->clear();
+
+  m_CharacterBodies.clear();
+  m_DynamicBodies.clear();
+
+  m_ActiveBodies = m_SleepingBodies = m_FrozenBodies = 0;
 }
 
 
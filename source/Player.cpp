@@ -7,6 +7,7 @@
 #include "Configuration.h"
 #include "Camera.h"
 #include "TracedWeapon.h"
+#include "Network.h"
 #include "Maths.h"
 
 using namespace game;
@@ -27,6 +28,14 @@ irr::f32 rollAdd = 0.f;
 
 void CPlayer::update()
 {
+  if(updateDeath())
+  {
+    if(getDeathTime() >= engine::CHARACTER_RESPAWN_DELAY)
+      Game->getCharacters()->spawn(this);
+
+    return;
+  }
+
   SCharacterClassParameters *c_class_params = Game->getCharacters()->cClassParameters[parameters.Class];
   irr::f32 time = Core->time.delta;
   irr::IrrlichtDevice *device = Core->getRenderer()->getDevice();
@@ -48,6 +57,36 @@ void CPlayer::update()
   body.PhysicsBody->setForce(irr::core::vector3df(0,0,0));
   body.PhysicsBody->setVelocity(irr::core::vector3df(0,0,0));
   body.PhysicsBody->setOmega(irr::core::vector3df(0,0,0));
+
+  //
+  // Get in and out of vehicles
+  //
+
+  if(input->isKeyPressedOnce(irr::KEY_KEY_V))
+  {
+    if(isDriving())
+      leaveVehicle();
+    else
+      enterVehicle();
+  }
+
+  if(isDriving())
+  {
+    irr::f32 throttle = 0.f, steering = 0.f;
+
+    if(input->isKeyHeldDown(irr::KEY_KEY_W)) throttle = 1.f;
+    else if(input->isKeyHeldDown(irr::KEY_KEY_S)) throttle = -1.f;
+
+    if(input->isKeyHeldDown(irr::KEY_KEY_A)) steering = -1.f;
+    else if(input->isKeyHeldDown(irr::KEY_KEY_D)) steering = 1.f;
+
+    drive(throttle, steering, input->isKeyHeldDown(irr::KEY_SPACE));
+
+    // The view looks ahead of the vehicle, the mouse doesn't turn it
+    device->getCursorControl()->setPosition(ScreenSize.Width/2, ScreenSize.Height/2);
+
+    return;
+  }
 #endif
 
   //if(Game->isPaused())
@@ -98,6 +137,22 @@ void CPlayer::update()
   if(input->isKeyHeldDown(irr::KEY_KEY_A)) dir.X = -1;
   else if(input->isKeyHeldDown(irr::KEY_KEY_D)) dir.X = 1;
 
+  bool jumpPressed = input->isKeyPressedOnce(irr::KEY_SPACE);
+
+  // On a client the server moves the player's character by this input
+  engine::CNetworkManager *network = Core->getNetwork();
+
+  if(network->getRole() == engine::ENR_CLIENT && network->isConnected())
+  {
+    engine::SNetInput command;
+    command.Forward = irr::s8(dir.Z);
+    command.Right = irr::s8(dir.X);
+    command.Heading = getRotation().Y;
+    command.Jump = jumpPressed;
+
+    network->setInput(command);
+  }
+
   engine::CBaseCharacter::checkForStairs(dir);
   engine::CBaseCharacter::update();
 
@@ -108,7 +163,7 @@ void CPlayer::update()
   // Jump
   //
 
-  if(input->isKeyPressedOnce(irr::KEY_SPACE))
+  if(jumpPressed)
   {
     // If crouching, first stand up
     if(parameters.States & engine::ECS_CROUCHING)
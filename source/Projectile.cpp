@@ -0,0 +1,340 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "Physics.h"
+#include "Projectile.h"
+
+#ifdef PHYSICS_NEWTON
+
+using namespace engine;
+using namespace engine::physics;
+
+/*
+  Scene node drawing the tracers of all rounds. Picks the tracers when the
+  scene manager asks for registrations.
+*/
+
+class CProjectileTracerSceneNode : public irr::scene::ISceneNode
+{
+public:
+
+  CProjectileTracerSceneNode(irr::scene::ISceneNode *parent, irr::scene::ISceneManager *manager, CProjectileManager *projectiles)
+    : irr::scene::ISceneNode(parent, manager, -1), Projectiles(projectiles)
+  {
+    setAutomaticCulling(irr::scene::EAC_OFF);
+  }
+
+  virtual void OnRegisterSceneNode()
+  {
+    if(!IsVisible)
+      return;
+
+    irr::scene::ICameraSceneNode *camera = SceneManager->getActiveCamera();
+
+    if(!camera)
+      return;
+
+    Projectiles->cull(camera->getAbsolutePosition());
+
+    if(Projectiles->getTracerCount() > 0)
+      SceneManager->registerNodeForRendering(this, irr::scene::ESNRP_TRANSPARENT);
+  }
+
+  virtual void render()
+  {
+    Projectiles->render();
+  }
+
+  virtual const irr::core::aabbox3d<irr::f32>& getBoundingBox() const { return Box; }
+
+private:
+
+  CProjectileManager *Projectiles;
+
+  irr::core::aabbox3df Box;
+};
+
+CProjectileManager::CProjectileManager(CCore * core) : Core(core)
+{
+  m_HitFunction = (ProjectileHitFunction)NULL;
+  m_HitData = NULL;
+
+  m_TracerNode = (irr::scene::ISceneNode*)NULL;
+  m_TracerMesh = (irr::scene::SMeshBuffer*)NULL;
+
+  m_LastHits = 0;
+
+  // Rounds push what they hit, resting bodies have to react
+  m_Batch.wake = true;
+}
+
+CProjectileManager::~CProjectileManager()
+{
+}
+
+void CProjectileManager::setHitCallback(ProjectileHitFunction function, void *data)
+{
+  m_HitFunction = function;
+  m_HitData = data;
+}
+
+void CProjectileManager::createTracers()
+{
+  irr::scene::ISceneManager *sceneManager = Core->getRenderer()->getSceneManager();
+
+  // Unit tracer: two crossed quads from the tail (z = 0) to the head (z = 1),
+  // one of them faces the camera well enough from any side
+  m_TracerMesh = new irr::scene::SMeshBuffer();
+
+  irr::video::SColor tail(255, 0, 0, 0);
+
+  for(irr::u32 q=0; q < 2; ++q)
+  {
+    irr::core::vector3df side = (q == 0) ? irr::core::vector3df(0.5f, 0.f, 0.f) : irr::core::vector3df(0.f, 0.5f, 0.f);
+    irr::core::vector3df normal = (q == 0) ? irr::core::vector3df(0.f, 1.f, 0.f) : irr::core::vector3df(1.f, 0.f, 0.f);
+
+    irr::u16 first = m_TracerMesh->Vertices.size();
+
+    m_TracerMesh->Vertices.push_back(irr::video::S3DVertex(-side, normal, tail, irr::core::vector2df(0.f, 1.f)));
+    m_TracerMesh->Vertices.push_back(irr::video::S3DVertex(side, normal, tail, irr::core::vector2df(1.f, 1.f)));
+    m_TracerMesh->Vertices.push_back(irr::video::S3DVertex(side + irr::core::vector3df(0.f, 0.f, 1.f), normal,
+      PROJECTILE_TRACER_COLOR, irr::core::vector2df(1.f, 0.f)));
+    m_TracerMesh->Vertices.push_back(irr::video::S3DVertex(-side + irr::core::vector3df(0.f, 0.f, 1.f), normal,
+      PROJECTILE_TRACER_COLOR, irr::core::vector2df(0.f, 0.f)));
+
+    m_TracerMesh->Indices.push_back(first);
+    m_TracerMesh->Indices.push_back(first + 1);
+    m_TracerMesh->Indices.push_back(first + 2);
+    m_TracerMesh->Indices.push_back(first);
+    m_TracerMesh->Indices.push_back(first + 2);
+    m_TracerMesh->Indices.push_back(first + 3);
+  }
+
+  m_TracerMesh->recalculateBoundingBox();
+
+  // The instanced draw needs the tracer in a hardware buffer
+  m_TracerMesh->setHardwareMappingHint(irr::scene::EHM_STATIC);
+
+  m_TracerMaterial.MaterialType = irr::video::EMT_TRANSPARENT_ADD_COLOR;
+  m_TracerMaterial.Lighting = false;
+  m_TracerMaterial.ZWriteEnable = false;
+  m_TracerMaterial.BackfaceCulling = false;
+  m_TracerMaterial.FogEnable = true;
+
+  m_TracerNode = new CProjectileTracerSceneNode(sceneManager->getRootSceneNode(), sceneManager, this);
+  m_TracerNode->setName("ProjectileTracers");
+}
+
+bool CProjectileManager::fire(const irr::core::vector3df& position, const irr::core::vector3df& velocity,
+  irr::f32 drag, irr::u32 excluded, irr::u32 type)
+{
+  if(m_Positions.size() >= PROJECTILE_MAX_ROUNDS)
+    return false;
+
+  if(!m_TracerNode && !Core->isHeadless())
+    createTracers();
+
+  m_Positions.push_back(position);
+  m_Velocities.push_back(velocity);
+  m_Drag.push_back(drag);
+  m_Age.push_back(0.f);
+  m_Types.push_back(type);
+
+  m_Batch.excluded.push_back(excluded);
+
+  return true;
+}
+
+void CProjectileManager::remove(irr::u32 index)
+{
+  irr::u32 last = m_Positions.size() - 1;
+
+  m_Positions[index] = m_Positions[last];
+  m_Velocities[index] = m_Velocities[last];
+  m_Drag[index] = m_Drag[last];
+  m_Age[index] = m_Age[last];
+  m_Types[index] = m_Types[last];
+  m_Batch.excluded[index] = m_Batch.excluded[last];
+
+  m_Positions.erase(last);
+  m_Velocities.erase(last);
+  m_Drag.erase(last);
+  m_Age.erase(last);
+  m_Types.erase(last);
+  m_Batch.excluded.erase(last);
+}
+
+void CProjectileManager::update(irr::f32 time)
+{
+  m_LastHits = 0;
+
+  irr::u32 count = m_Positions.size();
+
+  if(count == 0)
+    return;
+
+  //
+  // Integrate: gravity and drag against the velocity (semi-implicit Euler),
+  // the segment of the tick goes into the batch
+  //
+
+  m_Batch.lines.set_used(count);
+
+  irr::core::vector3df *positions = m_Positions.pointer();
+  irr::core::vector3df *velocities = m_Velocities.pointer();
+  const irr::f32 *drag = m_Drag.const_pointer();
+  irr::f32 *age = m_Age.pointer();
+  irr::core::line3df *lines = m_Batch.lines.pointer();
+
+  for(irr::u32 i=0; i < count; ++i)
+  {
+    irr::core::vector3df &velocity = velocities[i];
+
+    irr::f32 slowdown = drag[i] * velocity.getLength() * time;
+
+    // Drag can stop a round but never turn it around
+    velocity *= 1.f / (1.f + slowdown);
+    velocity.Y -= PROJECTILE_GRAVITY * time;
+
+    lines[i].start = positions[i];
+    positions[i] += velocity * time;
+    lines[i].end = positions[i];
+
+    age[i] += time;
+  }
+
+  Core->getPhysics()->getPhysicsWorld()->getRayCollisions(m_Batch);
+
+  //
+  // Report the hits. Going backwards, the round swapped into a removed
+  // slot was already looked at.
+  //
+
+  for(irr::s32 i=irr::s32(count) - 1; i >= 0; --i)
+  {
+    const SRayCastResult &result = m_Batch.results[i];
+
+    if(result.body)
+    {
+      if(m_HitFunction)
+      {
+        SProjectileHit hit;
+        hit.Body = result.body;
+        hit.Position = result.position;
+        hit.Normal = result.normal;
+        hit.Velocity = m_Velocities[i];
+        hit.Type = m_Types[i];
+
+        m_HitFunction(m_HitData, hit);
+      }
+
+      ++m_LastHits;
+
+      remove(i);
+    }
+    else if(m_Age[i] >= PROJECTILE_MAX_TIME)
+      remove(i);
+  }
+}
+
+void CProjectileManager::cull(const irr::core::vector3df& cameraPosition)
+{
+  m_Tracers.set_used(0);
+
+  irr::u32 count = m_Positions.size();
+
+  const irr::core::vector3df *positions = m_Positions.const_pointer();
+  const irr::core::vector3df *velocities = m_Velocities.const_pointer();
+
+  for(irr::u32 i=0; i < count; ++i)
+  {
+    if(positions[i].getDistanceFromSQ(cameraPosition) > PROJECTILE_TRACER_DISTANCE * PROJECTILE_TRACER_DISTANCE)
+      continue;
+
+    irr::f32 speed = velocities[i].getLength();
+
+    // Not longer than the path flown since the muzzle
+    irr::f32 length = irr::core::min_(speed * irr::core::min_(PROJECTILE_TRACER_TIME, m_Age[i]), PROJECTILE_TRACER_LENGTH);
+
+    if(length <= 0.f)
+      continue;
+
+    irr::core::vector3df direction = velocities[i] / speed;
+
+    irr::core::vector3df side = direction.crossProduct(irr::core::vector3df(0.f, 1.f, 0.f));
+
+    // Straight up or down
+    if(side.getLengthSQ() < 0.0001f)
+      side.set(1.f, 0.f, 0.f);
+
+    side.normalize();
+
+    irr::core::vector3df up = side.crossProduct(direction);
+    irr::core::vector3df tail = positions[i] - direction * length;
+
+    m_Tracers.push_back(irr::core::matrix4(irr::core::matrix4::EM4CONST_NOTHING));
+    irr::f32 *m = m_Tracers.getLast().pointer();
+
+    m[0] = side.X * PROJECTILE_TRACER_WIDTH;
+    m[1] = side.Y * PROJECTILE_TRACER_WIDTH;
+    m[2] = side.Z * PROJECTILE_TRACER_WIDTH;
+    m[3] = 0.f;
+
+    m[4] = up.X * PROJECTILE_TRACER_WIDTH;
+    m[5] = up.Y * PROJECTILE_TRACER_WIDTH;
+    m[6] = up.Z * PROJECTILE_TRACER_WIDTH;
+    m[7] = 0.f;
+
+    m[8] = direction.X * length;
+    m[9] = direction.Y * length;
+    m[10] = direction.Z * length;
+    m[11] = 0.f;
+
+    m[12] = tail.X;
+    m[13] = tail.Y;
+    m[14] = tail.Z;
+    m[15] = 1.f;
+  }
+}
+
+void CProjectileManager::render()
+{
+  if(m_Tracers.size() == 0 || !m_TracerMesh)
+    return;
+
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  driver->setMaterial(m_TracerMaterial);
+  driver->drawMeshBufferInstanced(m_TracerMesh, m_Tracers.const_pointer(), m_Tracers.size());
+}
+
+void CProjectileManager::clear()
+{
+  m_Positions.clear();
+  m_Velocities.clear();
+  m_Drag.clear();
+  m_Age.clear();
+  m_Types.clear();
+
+  m_Batch.lines.clear();
+  m_Batch.excluded.clear();
+  m_Batch.results.clear();
+
+  m_Tracers.clear();
+
+  m_LastHits = 0;
+
+  if(m_TracerNode)
+  {
+    m_TracerNode->remove();
+    m_TracerNode->drop();
+    m_TracerNode = (irr::scene::ISceneNode*)NULL;
+  }
+
+  if(m_TracerMesh)
+  {
+    m_TracerMesh->drop();
+    m_TracerMesh = (irr::scene::SMeshBuffer*)NULL;
+  }
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include "Game.h"
+#include "Core.h"
+#include "Renderer.h"
+#include "Physics.h"
+#include "ProjectileLauncher.h"
+#include "SoundManager.h"
+#include "Maths.h"
+#include "CharacterManager.h"
+#include "Player.h"
+
+using namespace game;
+using namespace engine;
+
+bool CProjectileLauncher::fire()
+{
+  irr::f32 currentTime = Game->getCore()->getRenderer()->getTimer()->getTime();
+  irr::f32 timeDiff = currentTime - timeLastShot;
+
+  if(timeDiff >= Game->weaponsParameters[type]->fireRate)
+  {
+    timeLastShot = currentTime;
+
+    if(selectedClipIndex != -1)
+    {
+      if(bIsReloading == false && ammoClips[selectedClipIndex]->ammo > 0)
+      {
+        SWeaponParameters *weap = Game->weaponsParameters[type];
+
+        //
+        // Play weapon firing sound
+
+        Game->getCore()->getSound()->playSound2D(
+          weap->fireSounds[Game->getCore()->getMath()->getRandomInt(0, weap->fireSounds.size()-2)].c_str(),
+          false, // no looping
+          0.62f,  // vol
+          0.0f,  // pan (center)
+          false); // create a new sound resource
+
+        //
+        // Create muzzle effect
+
+        createMuzzle();
+
+        //
+        // Launch the round, it hits later
+
+        launch();
+
+        //
+        // Deal with ammo
+
+        ammoClips[selectedClipIndex]->ammo -= 1;
+
+        if(ammoClips[selectedClipIndex]->ammo == 0) {
+          if(!reload())
+            return false;
+        }
+
+        return true;
+      }
+    }
+    else {
+      Game->getCore()->getSound()->playSound2D(
+        "data/sounds/weapon/dry_fire.wav",
+        false,
+        0.55f);
+    }
+  }
+
+  return false;
+}
+
+void CProjectileLauncher::launch()
+{
+#ifdef PHYSICS_NEWTON
+  if(node == NULL)
+    return;
+
+  SWeaponParameters *weap = Game->weaponsParameters[type];
+
+  irr::core::matrix4 weaponTransformationMatrix = node->getAbsoluteTransformation();
+  irr::core::matrix4 rotationMatrix;
+  rotationMatrix.setRotationDegrees(weaponTransformationMatrix.getRotationDegrees());
+
+  irr::core::vector3df velocity = irr::core::vector3df(0, 0, weap->muzzleVelocity);
+  rotationMatrix.rotateVect(velocity);
+
+  Game->getCore()->getPhysics()->getProjectiles()->fire(
+    weaponTransformationMatrix.getTranslation(),
+    velocity,
+    weap->drag,
+    Game->getCharacters()->getPlayer()->getBody()->PhysicsBody->getShapeID(),
+    type);
+#endif
+}
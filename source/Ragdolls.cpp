@@ -0,0 +1,398 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "Physics.h"
+#include "Ragdolls.h"
+
+#ifdef PHYSICS_NEWTON
+
+using namespace engine;
+using namespace engine::physics;
+
+/*
+  Soldier skeleton (Bip01). The head joint is the last one of the spine,
+  so the head capsule reaches past it.
+*/
+
+static const SRagdollPart ragdollParts[RAGDOLL_PART_COUNT] =
+{
+  // Joint                  End joint               Parent Radius Length Mass   Cone  Twist
+  { "Bip01 Pelvis01",       "Bip01 Spine02",        -1,    0.60f, 1.0f,  0.22f, 0.f,  0.f },
+  { "Bip01 Spine02",        "Bip01 Neck01",          0,    0.45f, 1.0f,  0.20f, 30.f, 20.f },
+  { "Bip01 Neck01",         "Bip01 Head01",          1,    0.60f, 2.0f,  0.08f, 40.f, 45.f },
+  { "Bip01 L UpperArm01",   "Bip01 L Forearm01",     1,    0.20f, 1.0f,  0.04f, 80.f, 45.f },
+  { "Bip01 L Forearm01",    "Bip01 L Hand01",        3,    0.18f, 1.3f,  0.03f, 70.f, 20.f },
+  { "Bip01 R UpperArm01",   "Bip01 R Forearm01",     1,    0.20f, 1.0f,  0.04f, 80.f, 45.f },
+  { "Bip01 R Forearm01",    "Bip01 R Hand01",        5,    0.18f, 1.3f,  0.03f, 70.f, 20.f },
+  { "Bip01 L Thigh01",      "Bip01 L Calf01",        0,    0.22f, 1.0f,  0.11f, 60.f, 20.f },
+  { "Bip01 L Calf01",       "Bip01 L Foot01",        7,    0.18f, 1.0f,  0.07f, 70.f, 10.f },
+  { "Bip01 R Thigh01",      "Bip01 R Calf01",        0,    0.22f, 1.0f,  0.11f, 60.f, 20.f },
+  { "Bip01 R Calf01",       "Bip01 R Foot01",        9,    0.18f, 1.0f,  0.07f, 70.f, 10.f }
+};
+
+// Ragdoll bodies have no CBody, gravity is all they get
+static void ragdoll_ApplyForceAndTorqueCallback(const NewtonBody* newtonBody, float timestep, int threadIndex)
+{
+  irr::f32 mass, ixx, iyy, izz;
+  NewtonBodyGetMassMatrix(newtonBody, &mass, &ixx, &iyy, &izz);
+
+  irr::f32 force_array[3] = { 0.f, -9.8f * mass, 0.f };
+
+  NewtonBodySetForce(newtonBody, force_array);
+}
+
+// Take a body out of the simulation until the next ragdoll needs it. Frozen
+// bodies are thawed again by any joint or contact that comes or goes, a
+// massless body is never simulated.
+static void ragdoll_ParkBody(const NewtonBody* newtonBody, const NewtonCollision* nullCollision)
+{
+  irr::f32 zero[3] = { 0.f, 0.f, 0.f };
+
+  NewtonBodySetCollision(newtonBody, nullCollision);
+  NewtonBodySetVelocity(newtonBody, zero);
+  NewtonBodySetOmega(newtonBody, zero);
+  NewtonBodySetMassMatrix(newtonBody, 0.f, 0.f, 0.f, 0.f);
+}
+
+// Part slow enough to count as resting
+static bool ragdoll_IsResting(const NewtonBody* newtonBody)
+{
+  if(NewtonBodyGetSleepState(newtonBody))
+    return true;
+
+  irr::f32 velocity_array[3], omega_array[3];
+  NewtonBodyGetVelocity(newtonBody, velocity_array);
+  NewtonBodyGetOmega(newtonBody, omega_array);
+
+  irr::core::vector3df velocity(velocity_array[0], velocity_array[1], velocity_array[2]);
+  irr::core::vector3df omega(omega_array[0], omega_array[1], omega_array[2]);
+
+  return velocity.getLengthSQ() < (RAGDOLL_REST_SPEED * IrrToNewton) * (RAGDOLL_REST_SPEED * IrrToNewton)
+    && omega.getLengthSQ() < RAGDOLL_REST_OMEGA * RAGDOLL_REST_OMEGA;
+}
+
+CRagdollManager::CRagdollManager(CCore * core) : Core(core)
+{
+  m_NullCollision = (NewtonCollision*)NULL;
+  m_Simulated = 0;
+}
+
+CRagdollManager::~CRagdollManager()
+{
+}
+
+void CRagdollManager::createPool()
+{
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+  m_NullCollision = NewtonCreateNull(world);
+
+  irr::core::matrix4 identity;
+
+  for(irr::u32 i=0; i < RAGDOLL_POOL_SIZE; ++i)
+  {
+    SRagdollBodies bodies;
+    bodies.Used = false;
+
+    for(irr::u32 p=0; p < RAGDOLL_PART_COUNT; ++p)
+    {
+      NewtonBody *part = NewtonCreateBody(world, m_NullCollision, getMatrixPointer(identity));
+
+      NewtonBodySetUserData(part, NULL);
+      NewtonBodySetForceAndTorqueCallback(part, ragdoll_ApplyForceAndTorqueCallback);
+      NewtonBodySetAutoSleep(part, 1);
+
+      ragdoll_ParkBody(part, m_NullCollision);
+
+      bodies.Parts[p] = part;
+      bodies.Joints[p] = (NewtonJoint*)NULL;
+    }
+
+    m_Pool.push_back(bodies);
+  }
+}
+
+irr::s32 CRagdollManager::getFreeBodies()
+{
+  for(irr::u32 i=0; i < m_Pool.size(); ++i)
+    if(!m_Pool[i].Used)
+      return irr::s32(i);
+
+  return -1;
+}
+
+bool CRagdollManager::spawn(irr::scene::IAnimatedMeshSceneNode *node, const irr::core::vector3df& velocity)
+{
+  if(!node || !node->getMesh() || node->getMesh()->getMeshType() != irr::scene::EAMT_SKINNED)
+    return false;
+
+  // Meshes without the soldier skeleton (getJointNode() would complain about every missing joint)
+  irr::scene::ISkinnedMesh *mesh = (irr::scene::ISkinnedMesh*)node->getMesh();
+
+  for(irr::u32 i=0; i < RAGDOLL_PART_COUNT; ++i)
+  {
+    if(mesh->getJointNumber(ragdollParts[i].Joint) < 0 || mesh->getJointNumber(ragdollParts[i].EndJoint) < 0)
+      return false;
+  }
+
+  if(m_Pool.size() == 0)
+    createPool();
+
+  if(m_Corpses.size() >= RAGDOLL_CORPSE_MAX)
+    removeCorpse(0);
+
+  // All bodies in use, the oldest simulated corpse stops where it is
+  irr::s32 index = getFreeBodies();
+
+  for(irr::u32 i=0; index < 0 && i < m_Corpses.size(); ++i)
+  {
+    if(m_Corpses[i].Bodies >= 0)
+    {
+      settle(m_Corpses[i]);
+      index = getFreeBodies();
+    }
+  }
+
+  //
+  // Copy of the node in its current pose, the bones are moved by the bodies from now on
+  //
+
+  SCorpse corpse;
+
+  corpse.Node = Core->getRenderer()->getSceneManager()->addAnimatedMeshSceneNode(mesh);
+  corpse.Node->grab();
+
+  node->updateAbsolutePosition();
+  const irr::core::matrix4 &nodeTransformation = node->getAbsoluteTransformation();
+
+  corpse.Node->setPosition(nodeTransformation.getTranslation());
+  corpse.Node->setRotation(nodeTransformation.getRotationDegrees());
+  corpse.Node->setScale(nodeTransformation.getScale());
+
+  for(irr::u32 i=0; i < node->getMaterialCount(); ++i)
+    corpse.Node->getMaterial(i) = node->getMaterial(i);
+
+  corpse.Node->setLoopMode(false);
+  corpse.Node->setAnimationSpeed(0.f);
+  corpse.Node->setCurrentFrame(node->getFrameNr());
+  corpse.Node->setJointMode(irr::scene::EJUOR_CONTROL);
+  corpse.Node->updateAbsolutePosition();
+  corpse.Node->animateJoints(true);
+
+  corpse.Bodies = index;
+  corpse.Age = corpse.RestTime = 0.f;
+
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+  SRagdollBodies &bodies = m_Pool[index];
+
+  irr::f32 velocity_array[3], zero[3] = { 0.f, 0.f, 0.f };
+  fillVec3(velocity * IrrToNewton, velocity_array);
+
+  for(irr::u32 i=0; i < RAGDOLL_PART_COUNT; ++i)
+  {
+    const SRagdollPart &part = ragdollParts[i];
+
+    corpse.Bones[i] = corpse.Node->getJointNode(irr::u32(mesh->getJointNumber(part.Joint)));
+    irr::scene::IBoneSceneNode *endBone = corpse.Node->getJointNode(irr::u32(mesh->getJointNumber(part.EndJoint)));
+
+    irr::core::vector3df start = corpse.Bones[i]->getAbsolutePosition();
+    irr::core::vector3df direction = endBone->getAbsolutePosition() - start;
+
+    irr::f32 distance = direction.getLength();
+
+    if(distance > 0.f)
+      direction /= distance;
+    else
+      direction.set(0.f, 1.f, 0.f);
+
+    irr::f32 radius = irr::core::max_(distance * part.Radius, 0.01f);
+    irr::f32 length = irr::core::max_(distance * part.Length, radius * 2.f + 0.01f);
+
+    // Capsules lie along X, the other axes only have to be perpendicular
+    irr::core::vector3df side = fabs(direction.Y) < 0.9f ?
+      irr::core::vector3df(0.f, 1.f, 0.f) : irr::core::vector3df(1.f, 0.f, 0.f);
+
+    irr::core::vector3df axisZ = direction.crossProduct(side).normalize();
+    irr::core::vector3df axisY = axisZ.crossProduct(direction);
+
+    irr::core::matrix4 matrix;
+    matrix[0] = direction.X; matrix[1] = direction.Y; matrix[2] = direction.Z;
+    matrix[4] = axisY.X;     matrix[5] = axisY.Y;     matrix[6] = axisY.Z;
+    matrix[8] = axisZ.X;     matrix[9] = axisZ.Y;     matrix[10] = axisZ.Z;
+    matrix.setTranslation(start + direction * (length * 0.5f));
+
+    irr::core::matrix4 inverse;
+    matrix.getInverse(inverse);
+    corpse.Offsets[i] = inverse * corpse.Bones[i]->getAbsoluteTransformation();
+
+    matrix.setTranslation(matrix.getTranslation() * IrrToNewton);
+
+    NewtonCollision *capsule = NewtonCreateCapsule(world, radius * IrrToNewton, length * IrrToNewton, 0, NULL);
+
+    NewtonBody *body = bodies.Parts[i];
+    NewtonBodySetCollision(body, capsule);
+    NewtonBodySetMatrix(body, getMatrixPointer(matrix));
+
+    irr::f32 mass = RAGDOLL_MASS * part.Mass;
+    irr::f32 inertia_array[3], origin_array[3];
+
+    NewtonConvexCollisionCalculateInertialMatrix(capsule, inertia_array, origin_array);
+    NewtonBodySetMassMatrix(body, mass, mass * inertia_array[0], mass * inertia_array[1], mass * inertia_array[2]);
+    NewtonBodySetCentreOfMass(body, origin_array);
+
+    NewtonReleaseCollision(world, capsule);
+
+    NewtonBodySetVelocity(body, velocity_array);
+    NewtonBodySetOmega(body, zero);
+    NewtonBodySetSleepState(body, 0);
+
+    // Ball joint at the start of the capsule, the cone opens along the capsule
+    if(part.Parent >= 0)
+    {
+      irr::f32 pivot[3], pin[3];
+      fillVec3(start * IrrToNewton, pivot);
+      fillVec3(direction, pin);
+
+      NewtonJoint *joint = NewtonConstraintCreateBall(world, pivot, body, bodies.Parts[part.Parent]);
+
+      NewtonBallSetConeLimits(joint, pin, part.Cone * irr::core::DEGTORAD, part.Twist * irr::core::DEGTORAD);
+
+      // Neighbouring capsules overlap at the joints
+      NewtonJointSetCollisionState(joint, 0);
+
+      bodies.Joints[i] = joint;
+    }
+  }
+
+  bodies.Used = true;
+
+  m_Corpses.push_back(corpse);
+
+  ++m_Simulated;
+
+  return true;
+}
+
+void CRagdollManager::pose(SCorpse& corpse)
+{
+  SRagdollBodies &bodies = m_Pool[corpse.Bodies];
+
+  // Parts come after their parent, so every parent bone is already in place
+  for(irr::u32 i=0; i < RAGDOLL_PART_COUNT; ++i)
+  {
+    irr::core::matrix4 matrix;
+    NewtonBodyGetMatrix(bodies.Parts[i], getMatrixPointer(matrix));
+    matrix.setTranslation(matrix.getTranslation() * NewtonToIrr);
+
+    irr::scene::IBoneSceneNode *bone = corpse.Bones[i];
+
+    irr::core::matrix4 parentInverse;
+    bone->getParent()->getAbsoluteTransformation().getInverse(parentInverse);
+
+    irr::core::matrix4 relative = parentInverse * matrix * corpse.Offsets[i];
+
+    bone->setPosition(relative.getTranslation());
+    bone->setRotation(relative.getRotationDegrees());
+
+    bone->updateAbsolutePosition();
+    bone->updateAbsolutePositionOfAllChildren();
+  }
+}
+
+void CRagdollManager::settle(SCorpse& corpse)
+{
+  if(corpse.Bodies < 0)
+    return;
+
+  NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+  SRagdollBodies &bodies = m_Pool[corpse.Bodies];
+
+  for(irr::u32 i=0; i < RAGDOLL_PART_COUNT; ++i)
+  {
+    if(bodies.Joints[i])
+      NewtonDestroyJoint(world, bodies.Joints[i]);
+
+    bodies.Joints[i] = (NewtonJoint*)NULL;
+  }
+
+  for(irr::u32 i=0; i < RAGDOLL_PART_COUNT; ++i)
+    ragdoll_ParkBody(bodies.Parts[i], m_NullCollision);
+
+  bodies.Used = false;
+
+  corpse.Bodies = -1;
+}
+
+void CRagdollManager::removeCorpse(irr::u32 index)
+{
+  settle(m_Corpses[index]);
+
+  m_Corpses[index].Node->remove();
+  m_Corpses[index].Node->drop();
+
+  m_Corpses.erase(index);
+}
+
+void CRagdollManager::update(irr::f32 time)
+{
+  m_Simulated = 0;
+
+  for(irr::u32 i=0; i < m_Corpses.size(); ++i)
+  {
+    SCorpse &corpse = m_Corpses[i];
+
+    if(corpse.Bodies < 0)
+      continue;
+
+    pose(corpse);
+
+    bool resting = true;
+
+    for(irr::u32 p=0; p < RAGDOLL_PART_COUNT && resting; ++p)
+      resting = ragdoll_IsResting(m_Pool[corpse.Bodies].Parts[p]);
+
+    corpse.Age += time;
+    corpse.RestTime = resting ? corpse.RestTime + time : 0.f;
+
+    // The pose is kept as it is, the corpse costs no physics from now on
+    if(corpse.RestTime >= RAGDOLL_SETTLE_TIME || corpse.Age >= RAGDOLL_MAX_TIME)
+      settle(corpse);
+    else
+      ++m_Simulated;
+  }
+}
+
+void CRagdollManager::clear()
+{
+  for(irr::u32 i=0; i < m_Corpses.size(); ++i)
+  {
+    m_Corpses[i].Node->remove();
+    m_Corpses[i].Node->drop();
+  }
+
+  m_Corpses.clear();
+
+  if(m_Pool.size() > 0)
+  {
+    NewtonWorld *world = Core->getPhysics()->getPhysicsWorld()->getNewtonWorld();
+
+    for(irr::u32 i=0; i < m_Pool.size(); ++i)
+    {
+      for(irr::u32 p=0; p < RAGDOLL_PART_COUNT; ++p)
+      {
+        if(m_Pool[i].Joints[p])
+          NewtonDestroyJoint(world, m_Pool[i].Joints[p]);
+
+        NewtonDestroyBody(world, m_Pool[i].Parts[p]);
+      }
+    }
+
+    m_Pool.clear();
+
+    NewtonReleaseCollision(world, m_NullCollision);
+    m_NullCollision = (NewtonCollision*)NULL;
+  }
+
+  m_Simulated = 0;
+}
+
+#endif
@@ -4,235 +4,38 @@
 
 using namespace engine;
 
-irr::f32 DoFaceCull = 0.f;
-
-//void frontwarrior::core::SFaceCullData::Update()
-//{
-  /*scene::ISceneCollisionManager *colman = Core->getRenderer()->getSceneManager()->getSceneCollisionManager();
-  scene::ICameraSceneNode *camera = Core->getRenderer()->getSceneManager()->getActiveCamera();
-
-  u32 mb = 0;
-
-  //for(u32 mb=0; mb < Buffers.size(); ++mb)
-  //{
-    /*m[mb] = k[mb] = 0;
-
-    //irr::scene::CMeshBuffer<irr::video::S3DVertex> *Buffer = new scene::CMeshBuffer<irr::video::S3DVertex>();
-
-    //Buffers[mb]->Indices.clear();
-
-    for(u32 i=0; i < IndexCount[mb]; i+=3)
-    {
-      m[mb] ++;
-
-  		if(Normals[mb][i/3].dotProduct(VertPoint[mb][i/3] - camera->getPosition()) < 0){
-
-        position2d<s32>pos1 = colman->getScreenCoordinatesFrom3DPosition(
-          Vertex[mb][IndicesCount[mb][i]].Pos );
-        position2d<s32>pos2 = colman->getScreenCoordinatesFrom3DPosition(
-          Vertex[mb][IndicesCount[mb][i+1]].Pos );
-        position2d<s32>pos3 = colman->getScreenCoordinatesFrom3DPosition(
-          Vertex[mb][IndicesCount[mb][i+2]].Pos );
-
-        // Are trinagle points inside view space
-        if((pos1.X >= 0 || pos2.X >= 0 || pos3.X >= 0)
-        && (pos1.Y >= 0 || pos2.Y >= 0 || pos3.Y >= 0)
-        && (pos1.X <= 800 || pos2.X <= 800 || pos3.X <= 800)
-        && (pos1.Y <= 600 || pos2.Y <= 600 || pos3.Y <= 600))
-        {
-  				//Buffers[mb]->Indices.push_back(IndicesCount[mb][i]);
-  				//Buffers[mb]->Indices.push_back(IndicesCount[mb][i+1]);
-  				//Buffers[mb]->Indices.push_back(IndicesCount[mb][i+2]);
-
-          k[mb] ++;
-        }
-  		}*/
-  	/*
-      u32 c1=0, pos=0;
-
-      //Buffers[mb]->Indices.erase(0, Buffers[mb]->getIndexCount());
-      //buffer->Indices.set_used(indexc);
-
-      for(u32 i=0; i<IndexCount[mb]; ++i) {
-         //m++;
-         if(Normals[mb][i].dotProduct(VertPoint[mb][i] - camera->getPosition() ) < 0 ) {
-            //buffer->Indices.push_back(indicesc[i*3]);
-            //buffer->Indices.push_back(indicesc[i*3+1]);
-            //buffer->Indices.push_back(indicesc[i*3+2]);
-            //k++;
-            c1++;
-         }
-         else {
-            if (c1!=0) {
-               c1*=3;
-               pos+=c1;
-               Buffers[mb]->Indices.set_used(pos);
-               memcpy(&Indices[mb][pos-c1], &IndicesCount[mb][i*3-c1], c1*2);
-               c1=0;
-            }
-         }
-      }
-      Buffers[mb]->Indices.set_used(pos);
-      pos=0;*/
-
-
-
-  	//printf("size: %d\n", Buffer->Indices.size());
-  	//faceCulledObjects[id].Buffers[mb]->Indices.set_used( Buffer->Indices.size() );
-
-  	//faceCulledObjects[id].Buffers[mb]->Indices = Buffer->Indices;
-
-  	//for(u32 i_id=0; i_id < Buffer->Indices.size(); ++i_id)
-    	//faceCulledObjects[id].Buffers[mb]->Indices[i_id] = Buffer->Indices[i_id];
-
-    //faceCulledObjects[id].Buffers[mb]->recalculateBoundingBox();
-    //faceCulledObjects[id].Buffers[mb]->setDirty();
-
-  //} // mb
-
-  //FaceCullingObjects[id].Buffers[0]->setDirty();
-
-  //return;
-//}
-
+irr::core::vector3df  LastPosition;
+irr::f32              LastRotationY;
+irr::f32              UpdateTime=0.f;
+bool                  bForceOcclusionUpdate=false;
 
-irr::scene::CMeshBuffer<irr::video::S3DVertex>* buffer;
-irr::u16* indices;
-void* vertices;
-irr::video::S3DVertex* vertex;
-irr::s32 indexc;
-irr::u16* indicesc;
-irr::core::vector3df* normals;
-irr::core::vector3df* vertpnt;
-int m=0, k=0;
+//void CSystem::ForceOcclusionUpdate() { bForceOcclusionUpdate = true; }
 
-void CCullingManager::update(irr::f32 time)
+void renderer_RunDriverJob(void *job, irr::u32 thread)
 {
-  return;
-
-  irr::core::vector3df camPos = Core->getRenderer()->getCamera()->getPosition();
-
-  //buffer->Indices.erase(0, buffer->getIndexCount());
-  //buffer->Indices.clear();
-  //buffer->Indices.set_used(indexc);
-
-  irr::u32 realIndiceCount = 0;
-
-  for(irr::s32 i = 0; i < indexc; i += 3)
-  {
-    m++;
-    if (normals[i/3].dotProduct(vertpnt[i/3]-camPos) < 0)
-    {
-      //memcpy((void *)&indices[i],(void *)&indicesc[i], 3); <--doesn't seem to work i'm noob in pointers :D
-
-      //printf("%d\n", indicesc[i]);
-
-      //buffer->Indices[i] = indicesc[i];
-      //buffer->Indices[i+1] = indicesc[i+1];
-      //buffer->Indices[i+2] = indicesc[i+2];
-
-      realIndiceCount += 3;
-
-      k++;
-    }
-  }
-
-  //buffer->Indices.set_used(realIndiceCount);
+  irr::video::SDriverJob *driverJob = (irr::video::SDriverJob*)job;
+  driverJob->Run(driverJob);
 }
 
-void CCullingManager::addFaceCulledMesh(irr::scene::IMesh* mesh)
+void renderer_SubmitDriverJob(void *userData, irr::video::SDriverJob *job)
 {
-	return;
-
-	buffer = (irr::scene::CMeshBuffer<irr::video::S3DVertex>*)mesh->getMeshBuffer(0);
-
-	/*printf("Vertex Count: %u\n",buffer->getVertexCount());
-	printf("Index Count: %u\n\n",buffer->getIndexCount());
-	printf("Total Triangles Count: %u\n\n",buffer->getIndexCount()/3);*/
-
-	indices = buffer->getIndices();
-	vertices = buffer->getVertices();
-	vertex = (irr::video::S3DVertex *) vertices;
-	indexc = buffer->getIndexCount();
-	indicesc = (irr::u16* )malloc(sizeof(short int)*buffer->getIndexCount());
-	normals = (irr::core::vector3df *)malloc(sizeof(irr::core::vector3df)*buffer->getIndexCount());
-	vertpnt = (irr::core::vector3df *)malloc(sizeof(irr::core::vector3df)*buffer->getIndexCount());
-
-	irr::core::triangle3df poly;
-
-	//precalculated faces normals and precalculated 1 point of intersection: normals/vertpnt
-	memcpy(indicesc, indices, sizeof(short int)*buffer->getIndexCount());
-
-	for(irr::s32 i = 0; i < indexc; i += 3)
-	{
-		poly.pointA = vertex[indicesc[i]].Pos;
-		poly.pointB = vertex[indicesc[i+1]].Pos;
-		poly.pointC = vertex[indicesc[i+2]].Pos;
-
-		normals[i/3] = poly.getNormal().normalize();
-
-		vertpnt[i/3] = vertex[indicesc[i]].Pos;
-	}
-
-  return;
+  ((CRenderer*)userData)->submitDriverJob(job);
 }
 
-/*void frontwarrior::core::SFaceCullData::Setup(irr::scene::IMesh* Mesh, bool batchedMesh)
+void renderer_WaitDriverJobs(void *userData)
 {
-  u32 mbcount = Mesh->getMeshBufferCount();
-
-  printf("\t\t# (Vertex type: %d)\n", Mesh->getMeshBuffer(0)->getVertexType());
-  printf("\t\t# (Meshbuffers: %d)\n", mbcount);
-
-  Buffers.set_used(mbcount);
-  Indices.set_used(mbcount);
-  Vertex.set_used(mbcount);
-  IndexCount.set_used(mbcount);
-  IndicesCount.set_used(mbcount);
-  Normals.set_used(mbcount);
-  VertPoint.set_used(mbcount);
-  k.set_used(mbcount);
-  m.set_used(mbcount);
-
-  for(u32 mb=0; mb < mbcount; ++mb)
-  {
-    Buffers[mb] = (irr::scene::CMeshBuffer<irr::video::S3DVertex>*) Mesh->getMeshBuffer(mb);
-
-	  Indices[mb] = Buffers[mb]->getIndices();
-    void* Vertices = Buffers[mb]->getVertices();
-
-  	Vertex[mb] = (S3DVertex*) Vertices;
-  	IndexCount[mb] = Buffers[mb]->getIndexCount();
-  	IndicesCount[mb] = (u16*)malloc(sizeof(short int)*Buffers[mb]->getIndexCount());
-  	Normals[mb] = (vector3df*)malloc(sizeof(vector3df)*Buffers[mb]->getIndexCount());
-  	VertPoint[mb] = (vector3df*)malloc(sizeof(vector3df)*Buffers[mb]->getIndexCount());
-
-    //memcpy(IndicesCount[mb], Indices, sizeof(short int)*Buffers[mb]->getIndexCount());
-
-  	IndicesCount[mb] = (u16* )malloc(sizeof(short int) * IndexCount[mb]);
-
-  	triangle3df Triangle;
-
-  	memcpy(IndicesCount[mb], Indices[mb], sizeof(short int) * IndexCount[mb]);
-  	for(u32 i=0; i < IndexCount[mb]; i+=3)
-    {
-  		Triangle.pointA = Vertex[mb][IndicesCount[mb][i]].Pos;
-  		Triangle.pointB = Vertex[mb][IndicesCount[mb][i+1]].Pos;
-  		Triangle.pointC = Vertex[mb][IndicesCount[mb][i+2]].Pos;
-  		Normals[mb][i/3] = Triangle.getNormal().normalize();
-  		VertPoint[mb][i/3] = Vertex[mb][IndicesCount[mb][i]].Pos;
-  	}
- }
-
-  return;
-}*/
+  ((CRenderer*)userData)->waitDriverJobs();
+}
 
-irr::core::vector3df  LastPosition;
-irr::f32              LastRotationY;
-irr::f32              UpdateTime=0.f;
-bool                  bForceOcclusionUpdate=false;
+void CRenderer::submitDriverJob(irr::video::SDriverJob *job)
+{
+  Core->getJobs()->submit(renderer_RunDriverJob, job, &DriverJobs);
+}
 
-//void CSystem::ForceOcclusionUpdate() { bForceOcclusionUpdate = true; }
+void CRenderer::waitDriverJobs()
+{
+  Core->getJobs()->wait(&DriverJobs);
+}
 
 bool CRenderer::needsOcclusionQuery()
 {
@@ -790,6 +593,15 @@ irr::u32 CRenderer::createDevice()
   param.Fullscreen = Core->getConfiguration()->getVideo()->isFullscreen;
   //param.EventReceiver = &Core->GetInput()->GetEventReceiver();
 
+  // No window and no rendering, the null driver still loads meshes for physics
+  if(Core->isHeadless())
+  {
+    param.DriverType = irr::video::EDT_NULL;
+    param.DeviceType = irr::EIDT_CONSOLE;
+    param.Fullscreen = false;
+    param.AntiAlias = 0;
+  }
+
   Device = createDeviceEx( param );
 
   Device->getLogger()->setLogLevel(irr::ELL_ERROR);
@@ -817,8 +629,22 @@ irr::u32 CRenderer::createDevice()
   GUI = Device->getGUIEnvironment();
   Timer = Device->getTimer();
 
+  // Burning's Video rasterizes its tiles on the engine's workers, not on threads of its own
+  VideoDriver->setJobScheduler(Core->getJobs()->getThreadCount(), renderer_SubmitDriverJob, renderer_WaitDriverJobs, this);
+
   ShaderManager = new CShaderManager(Core);
   CullingManager = new CCullingManager(Core);
+  InstancingManager = new CInstancingManager(Core);
+  SpriteBatcher = new CSpriteBatcher(Core);
+  ShadowManager = new CShadowManager(Core);
+  LightManager = new CLightManager(Core);
+
+  // The null driver of the headless mode draws nothing
+  if(!Core->isHeadless())
+  {
+    ShadowManager->init();
+    LightManager->init();
+  }
 
   // Set window caption
   Device->setWindowCaption(L"Front Warrior");
@@ -5,6 +5,8 @@
 #include "ObjectManager.h"
 #include "Camera.h"
 
+#include <string.h>
+
 using namespace engine;
 
 using namespace irr;
@@ -44,6 +46,15 @@ void CBaseShader::OnSetConstants(
 {
   irr::video::IVideoDriver* driver = services->getVideoDriver();
 
+  if(parameters & ESS_WORLD_VIEW_PROJECTION)
+  {
+    matrix4 worldViewProj = driver->getTransform(video::ETS_PROJECTION);
+    worldViewProj *= driver->getTransform(video::ETS_VIEW);
+    worldViewProj *= driver->getTransform(video::ETS_WORLD);
+
+    services->setVertexShaderConstant("mWorldViewProj", worldViewProj.pointer(), 16);
+  }
+
   if(parameters & ESS_TEXTURES_OPENGL)
   {
     int texture0 = 0;
@@ -90,6 +101,46 @@ void CBaseShader::OnSetConstants(
     float mFar = Core->getConfiguration()->getVideo()->drawRange;
     services->setPixelShaderConstant("mFar", &mFar,1);
   }
+
+  if(parameters & ESS_FOG)
+  {
+    float fog = UsedMaterial->FogEnable ? 1.f : 0.f;
+    services->setPixelShaderConstant("mFog", &fog, 1);
+  }
+
+  if(parameters & ESS_SHADOW_MAP)
+  {
+    CShadowManager *shadows = Core->getRenderer()->getShadows();
+
+    const matrix4 &world = driver->getTransform(video::ETS_WORLD);
+
+    f32 matrices[SHADOW_CASCADES * 16];
+    f32 splits[SHADOW_CASCADES];
+
+    for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+    {
+      // Object space straight into the atlas, like mSunPos the shader gets it ready to use
+      matrix4 lookup = shadows->getCascade(i).Lookup * world;
+
+      memcpy(&matrices[i*16], lookup.pointer(), 16 * sizeof(f32));
+      splits[i] = shadows->getCascade(i).Split;
+    }
+
+    services->setVertexShaderConstant("mShadowMatrix", matrices, SHADOW_CASCADES * 16);
+    services->setPixelShaderConstant("mShadowSplits", splits, SHADOW_CASCADES);
+
+    f32 cascades = f32(shadows->getCascadeCount());
+    services->setPixelShaderConstant("mShadowCascades", &cascades, 1);
+
+    f32 texel = 1.f / f32(SHADOW_MAP_SIZE * 2);
+    services->setPixelShaderConstant("mShadowTexel", &texel, 1);
+
+    if(driver->getDriverType() == video::EDT_OPENGL)
+    {
+      int slot = shadowSlot;
+      services->setPixelShaderConstant("shadowMap", (f32*)(&slot), 1);
+    }
+  }
 }
 
   /*int texture0 = 0;
@@ -133,8 +184,6 @@ void CGrassShader::OnSetConstants(
   float decay = Core->getConfiguration()->getVideo()->geomShaderGrassDecay;
   services->setVertexShaderConstant("decay", &decay, 1);
   services->setVertexShaderConstant("windDir", &Core->GetAtmo()->getWindPacked().X,3);
-  int i=3;
-  services->setVertexShaderConstant("shadowMap", (float*)&i,1);
 /*
   vector3df campos = Core->getRenderer()->getSceneManager()->getActiveCamera()->getPosition();
   services->setVertexShaderConstant("mCameraPos", reinterpret_cast<f32*>(&campos), 3);
@@ -152,19 +201,36 @@ void CGrassShader::OnSetConstants(
 
 
 
-void CCameraViewObjectShader::OnSetConstants(
+void CTiledLightShader::OnSetConstants(
   video::IMaterialRendererServices* services,
   s32 userData)
 {
   CBaseShader::OnSetConstants(services, userData);
 
-  float shadow = 1.f-Core->getCamera()->getShadow();
+  video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
 
-  services->setVertexShaderConstant("shadow", &shadow, 1);
-}
+  f32 screenSize[2];
+  screenSize[0] = f32(driver->getScreenSize().Width);
+  screenSize[1] = f32(driver->getScreenSize().Height);
+  services->setPixelShaderConstant("mScreenSize", screenSize, 2);
+
+  f32 tileSize = f32(Core->getRenderer()->getLights()->getTileSize());
+  services->setPixelShaderConstant("mTileSize", &tileSize, 1);
 
+  // View position from the depth: x = ndc.x * z / M0, y = ndc.y * z / M5
+  const f32 *projection = driver->getTransform(video::ETS_PROJECTION).pointer();
 
+  f32 unproject[2];
+  unproject[0] = 1.f / projection[0];
+  unproject[1] = 1.f / projection[5];
+  services->setPixelShaderConstant("mProjection", unproject, 2);
 
+  f32 ranges[3];
+  ranges[0] = LIGHT_ENCODE_RANGE;
+  ranges[1] = LIGHT_MAX_RADIUS;
+  ranges[2] = LIGHT_MAX_INTENSITY;
+  services->setPixelShaderConstant("mLightRanges", ranges, 3);
+}
 
 
 
@@ -182,7 +248,8 @@ irr::s32 CShaderManager::createMultiTextureShader()
 
   irr::s32 flags =
     ESS_SUN_POSITION |
-    ESS_AMBIENT_LIGHT;
+    ESS_AMBIENT_LIGHT |
+    ESS_SHADOW_MAP;
 
   /*if(Core->getConfiguration()->GetVideo()->RenderDeviceID == 0)
   {
@@ -259,7 +326,7 @@ irr::s32 CShaderManager::createGrassShader()
 
   if(gpu)
   {
-    CBaseShader *pShader = new CGrassShader(Core, ESS_SUN_POSITION|ESS_TIME|ESS_FAR_VALUE|ESS_AMBIENT_LIGHT);
+    CBaseShader *pShader = new CGrassShader(Core, ESS_SUN_POSITION|ESS_TIME|ESS_FAR_VALUE|ESS_AMBIENT_LIGHT|ESS_SHADOW_MAP);
 
     if (Core->getRenderer()->getVideoDriver()->queryFeature(EVDF_GEOMETRY_SHADER)
     && Core->getConfiguration()->getVideo()->geomShaderGrass) {
@@ -303,7 +370,9 @@ irr::s32 CShaderManager::createCameraViewObjectShader()
   const c8* vsFunc = 0;
   const c8* psFunc = 0;
   video::E_VERTEX_SHADER_TYPE vsType = video::EVST_VS_1_1;
-  video::E_PIXEL_SHADER_TYPE psType = video::EPST_PS_1_4;
+
+  // The shadow lookup doesn't fit 1.4
+  video::E_PIXEL_SHADER_TYPE psType = video::EPST_PS_2_0;
 
   if(Core->getConfiguration()->getVideo()->renderDeviceID == 0)
   {
@@ -326,9 +395,10 @@ irr::s32 CShaderManager::createCameraViewObjectShader()
 
   if(gpu)
   {
-    CCameraViewObjectShader *pShader = new CCameraViewObjectShader(
+    CBaseShader *pShader = new CBaseShader(
       Core,
-      ESS_SUN_POSITION);
+      ESS_SUN_POSITION |
+      ESS_SHADOW_MAP);
 
     result = gpu->addHighLevelShaderMaterialFromFiles(
       vsFileName, vsFunc, vsType,
@@ -364,6 +434,14 @@ irr::s32 CShaderManager::createLightmapShader()
     psFunc     = "pixelMain";
     vsFunc     = "vertexMain";
   }
+  else if(Core->getConfiguration()->getVideo()->renderDeviceID == 1)
+  {
+    psFileName = "data/shaders/glsl/LightmapShader.frag";
+    vsFileName = "data/shaders/glsl/LightmapShader.vert";
+
+    psFunc = "main";
+    vsFunc = "main";
+  }
 
   video::IGPUProgrammingServices* gpu = Core->getRenderer()->getVideoDriver()->getGPUProgrammingServices();
 
@@ -372,7 +450,9 @@ irr::s32 CShaderManager::createLightmapShader()
     CBaseShader *pShader = new CBaseShader(
       Core,
       ESS_WORLD_VIEW_PROJECTION |
-      ESS_AMBIENT_LIGHT);
+      ESS_AMBIENT_LIGHT |
+      ESS_TEXTURES_OPENGL |
+      ESS_FOG);
 
     result = gpu->addHighLevelShaderMaterialFromFiles(
       vsFileName, vsFunc, vsType,
@@ -442,3 +522,158 @@ irr::s32 CShaderManager::createParticleFadeOutShader(irr::f32 fade_time)
 }
 
 
+irr::s32 CShaderManager::createShadowDepthShader()
+{
+  irr::s32 result = 0;
+
+  const c8* vsProgram = 0;
+  const c8* psProgram = 0;
+  const c8* vsFunc = "main";
+  const c8* psFunc = "main";
+  video::E_VERTEX_SHADER_TYPE vsType = video::EVST_VS_2_0;
+  video::E_PIXEL_SHADER_TYPE psType = video::EPST_PS_2_0;
+
+  // Small enough to live here, the depth is the same in both drivers:
+  // the orthographic projection of the cascades maps it to 0..1
+  if(Core->getConfiguration()->getVideo()->renderDeviceID == 0)
+  {
+    vsProgram =
+      "float4x4 mWorldViewProj;\n"
+      "struct VS_OUTPUT { float4 Position : POSITION; float Depth : TEXCOORD0; };\n"
+      "VS_OUTPUT vertexMain(float4 position : POSITION)\n"
+      "{\n"
+      "  VS_OUTPUT output;\n"
+      "  output.Position = mul(position, mWorldViewProj);\n"
+      "  output.Depth = output.Position.z;\n"
+      "  return output;\n"
+      "}\n";
+
+    psProgram =
+      "float4 pixelMain(float depth : TEXCOORD0) : COLOR0\n"
+      "{\n"
+      "  return float4(depth, depth, depth, 1.0);\n"
+      "}\n";
+
+    vsFunc = "vertexMain";
+    psFunc = "pixelMain";
+  }
+  else if(Core->getConfiguration()->getVideo()->renderDeviceID == 1)
+  {
+    vsProgram =
+      "varying float depth;\n"
+      "void main()\n"
+      "{\n"
+      "  gl_Position = ftransform();\n"
+      "  depth = gl_Position.z;\n"
+      "}\n";
+
+    psProgram =
+      "varying float depth;\n"
+      "void main()\n"
+      "{\n"
+      "  gl_FragColor = vec4(depth, depth, depth, 1.0);\n"
+      "}\n";
+  }
+  else
+    return result;
+
+  video::IGPUProgrammingServices* gpu = Core->getRenderer()->getVideoDriver()->getGPUProgrammingServices();
+
+  if(gpu)
+  {
+    CBaseShader *pShader = new CBaseShader(
+      Core,
+      ESS_WORLD_VIEW_PROJECTION);
+
+    result = gpu->addHighLevelShaderMaterial(
+      vsProgram, vsFunc, vsType,
+      psProgram, psFunc, psType,
+      pShader);
+
+    pShader->drop();
+
+    shaderList.push_back(pShader);
+  }
+
+  return result;
+}
+
+irr::s32 CShaderManager::createTiledLightShader()
+{
+  irr::s32 result = 0;
+
+  if(Core->getConfiguration()->getVideo()->renderDeviceID != 1)
+    return result;
+
+  // The quad is given in clip space
+  const c8* vsProgram =
+    "void main()\n"
+    "{\n"
+    "  gl_Position = vec4(gl_Vertex.xy, 0.0, 1.0);\n"
+    "}\n";
+
+  // tex0 normal and negated depth, tex1 albedo, tex2 tiles (offset in r and g, count in b),
+  // tex3 light indices (4 per texel), tex4 lights (a column each: x y, z radius, color intensity)
+  const c8* psProgram =
+    "#version 120\n"
+    "uniform sampler2D tex0, tex1, tex2, tex3, tex4;\n"
+    "uniform vec2 mScreenSize;\n"
+    "uniform float mTileSize;\n"
+    "uniform vec2 mProjection;\n"
+    "uniform vec3 mLightRanges;\n"
+    "float decode(float high, float low) { return (high * 65280.0 + low * 255.0) / 65535.0; }\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 uv = gl_FragCoord.xy / mScreenSize;\n"
+    "  vec4 g = texture2D(tex0, uv);\n"
+    "  float depth = -g.w;\n"
+    "  if(depth <= 0.0) discard;\n"
+    "  vec2 ndc = uv * 2.0 - 1.0;\n"
+    "  vec3 position = vec3(ndc * mProjection * depth, depth);\n"
+    "  vec2 tile = floor(vec2(gl_FragCoord.x, mScreenSize.y - gl_FragCoord.y) / mTileSize);\n"
+    "  vec4 t = texture2D(tex2, (tile + 0.5) / 64.0);\n"
+    "  float offset = floor(t.r * 255.0 + 0.5) * 256.0 + floor(t.g * 255.0 + 0.5);\n"
+    "  int count = int(t.b * 255.0 + 0.5);\n"
+    "  vec3 light = vec3(0.0);\n"
+    "  for(int i = 0; i < 64; ++i)\n"
+    "  {\n"
+    "    if(i >= count) break;\n"
+    "    float index = offset + float(i);\n"
+    "    float texel = floor(index / 4.0);\n"
+    "    vec4 indices = texture2D(tex3, (vec2(mod(texel, 64.0), floor(texel / 64.0)) + 0.5) / 64.0);\n"
+    "    float l = floor(dot(indices, vec4(equal(vec4(index - texel * 4.0), vec4(0.0, 1.0, 2.0, 3.0)))) * 255.0 + 0.5);\n"
+    "    float u = (l + 0.5) / 256.0;\n"
+    "    vec4 p0 = texture2D(tex4, vec2(u, 0.125));\n"
+    "    vec4 p1 = texture2D(tex4, vec2(u, 0.375));\n"
+    "    vec4 c = texture2D(tex4, vec2(u, 0.625));\n"
+    "    vec3 center = vec3(decode(p0.r, p0.g), decode(p0.b, p0.a), decode(p1.r, p1.g)) * (2.0 * mLightRanges.x) - mLightRanges.x;\n"
+    "    float radius = decode(p1.b, p1.a) * mLightRanges.y;\n"
+    "    vec3 d = center - position;\n"
+    "    float dist = length(d);\n"
+    "    float attenuation = clamp(1.0 - dist / radius, 0.0, 1.0);\n"
+    "    light += c.rgb * (c.a * mLightRanges.z) * attenuation * attenuation * max(dot(g.xyz, d / max(dist, 0.0001)), 0.0);\n"
+    "  }\n"
+    "  gl_FragColor = vec4(texture2D(tex1, uv).rgb * light, 1.0);\n"
+    "}\n";
+
+  video::IGPUProgrammingServices* gpu = Core->getRenderer()->getVideoDriver()->getGPUProgrammingServices();
+
+  if(gpu)
+  {
+    CTiledLightShader *pShader = new CTiledLightShader(
+      Core,
+      ESS_TEXTURES_OPENGL);
+
+    // Added to the frame like the one texture blend material, the blend function comes from MaterialTypeParam
+    result = gpu->addHighLevelShaderMaterial(
+      vsProgram, "main", video::EVST_VS_2_0,
+      psProgram, "main", video::EPST_PS_2_0,
+      pShader, video::EMT_ONETEXTURE_BLEND);
+
+    pShader->drop();
+
+    shaderList.push_back(pShader);
+  }
+
+  return result;
+}
@@ -0,0 +1,510 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "ObjectManager.h"
+#include "Shadows.h"
+
+#include <stdio.h>
+#include <math.h>
+
+using namespace engine;
+
+CShadowManager::CShadowManager(CCore * core) : Core(core)
+{
+  m_Texture = (irr::video::ITexture*)NULL;
+
+  m_MinDepth = m_MaxDepth = 0.f;
+
+  m_StaticCount = m_GroupCount = 0;
+
+  m_Rendered = m_CasterDraws = 0;
+
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+    b_Dirty[i] = false;
+}
+
+CShadowManager::~CShadowManager()
+{
+}
+
+bool CShadowManager::init()
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  if(!driver->queryFeature(irr::video::EVDF_RENDER_TO_TARGET))
+  {
+    printf("Shadows: disabled, no render targets\n");
+    return false;
+  }
+
+  irr::s32 depthShader = Core->getRenderer()->getShaders()->createShadowDepthShader();
+
+  if(depthShader <= 0)
+  {
+    printf("Shadows: disabled, depth shader failed\n");
+    return false;
+  }
+
+  // Depth is written to the red channel, the cascades are the quarters of the atlas
+  m_Texture = driver->addRenderTargetTexture(
+    irr::core::dimension2du(SHADOW_MAP_SIZE * 2, SHADOW_MAP_SIZE * 2), "ShadowCascades", irr::video::ECF_R32F);
+
+  if(!m_Texture)
+  {
+    printf("Shadows: disabled, no floating point render target\n");
+    return false;
+  }
+
+  m_DepthMaterial.MaterialType = (irr::video::E_MATERIAL_TYPE)depthShader;
+  m_DepthMaterial.Lighting = false;
+  m_DepthMaterial.FogEnable = false;
+
+  // Both sides, thin walls would let the light through otherwise
+  m_DepthMaterial.BackfaceCulling = false;
+
+  printf("Shadows: %d cascades of %dx%d\n", SHADOW_CASCADES, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+
+  return true;
+}
+
+void CShadowManager::clear()
+{
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+  {
+    m_Cascades[i].Valid = false;
+    b_Dirty[i] = false;
+  }
+
+  m_StaticCount = m_GroupCount = 0;
+
+  m_DynamicTransforms.clear();
+  m_DynamicBoxes.clear();
+  m_MovedBoxes.clear();
+}
+
+irr::core::aabbox3df CShadowManager::getLightBox(const irr::core::vector3df& center, const irr::core::vector3df& extent)
+{
+  const irr::f32 *m = m_LightView.pointer();
+
+  irr::core::vector3df lightCenter;
+  m_LightView.transformVect(lightCenter, center);
+
+  irr::core::vector3df lightExtent(
+    fabsf(m[0]) * extent.X + fabsf(m[4]) * extent.Y + fabsf(m[8]) * extent.Z,
+    fabsf(m[1]) * extent.X + fabsf(m[5]) * extent.Y + fabsf(m[9]) * extent.Z,
+    fabsf(m[2]) * extent.X + fabsf(m[6]) * extent.Y + fabsf(m[10]) * extent.Z);
+
+  return irr::core::aabbox3df(lightCenter - lightExtent, lightCenter + lightExtent);
+}
+
+void CShadowManager::updateLightView(const irr::core::vector3df& sunDirection)
+{
+  m_SunDirection = sunDirection;
+
+  irr::core::vector3df up(0.f, 1.f, 0.f);
+
+  if(fabsf(sunDirection.Y) > 0.99f)
+    up.set(0.f, 0.f, 1.f);
+
+  // Looking from the sun, light space X and Y are the shadow map axes
+  m_LightView.buildCameraLookAtMatrixLH(irr::core::vector3df(0.f, 0.f, 0.f), -sunDirection, up);
+
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+    m_Cascades[i].Valid = false;
+}
+
+void CShadowManager::updateSceneBox()
+{
+  CCullingManager *culling = Core->getRenderer()->getCullingManager();
+  CInstancingManager *instancing = Core->getRenderer()->getInstancingManager();
+
+  const irr::core::array<irr::scene::ISceneNode*> &staticNodes = culling->getStaticNodes();
+
+  irr::core::aabbox3df sceneBox(irr::core::vector3df(0.f, 0.f, 0.f));
+  bool first = true;
+
+  for(irr::u32 i=0; i < staticNodes.size(); ++i)
+  {
+    irr::core::aabbox3df box = staticNodes[i]->getTransformedBoundingBox();
+    irr::core::aabbox3df lightBox = getLightBox(box.getCenter(), box.getExtent() * 0.5f);
+
+    if(first)
+      sceneBox = lightBox;
+    else
+      sceneBox.addInternalBox(lightBox);
+
+    first = false;
+  }
+
+  for(irr::u32 i=0; i < instancing->getGroupCount(); ++i)
+  {
+    const irr::core::aabbox3df &box = instancing->getGroup(i)->Box;
+    irr::core::aabbox3df lightBox = getLightBox(box.getCenter(), box.getExtent() * 0.5f);
+
+    if(first)
+      sceneBox = lightBox;
+    else
+      sceneBox.addInternalBox(lightBox);
+
+    first = false;
+  }
+
+  // Dynamic casters move around the static ones, leave them some room
+  m_MinDepth = sceneBox.MinEdge.Z - 10.f;
+  m_MaxDepth = sceneBox.MaxEdge.Z + 10.f;
+
+  m_StaticCount = staticNodes.size();
+  m_GroupCount = instancing->getGroupCount();
+
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+    m_Cascades[i].Valid = false;
+}
+
+void CShadowManager::updateDynamicCasters()
+{
+  const irr::core::array<irr::scene::ISceneNode*> &nodes = Core->getRenderer()->getCullingManager()->getDynamicNodes();
+
+  m_MovedBoxes.set_used(0);
+
+  // New set of casters, everything they touch is redrawn
+  if(m_DynamicTransforms.size() != nodes.size())
+  {
+    m_DynamicTransforms.set_used(nodes.size());
+    m_DynamicBoxes.set_used(nodes.size());
+
+    for(irr::u32 i=0; i < nodes.size(); ++i)
+    {
+      irr::core::aabbox3df box = nodes[i]->getTransformedBoundingBox();
+
+      m_DynamicTransforms[i] = nodes[i]->getAbsoluteTransformation();
+      m_DynamicBoxes[i] = getLightBox(box.getCenter(), box.getExtent() * 0.5f);
+
+      m_MovedBoxes.push_back(m_DynamicBoxes[i]);
+    }
+  }
+  else
+  {
+    for(irr::u32 i=0; i < nodes.size(); ++i)
+    {
+      const irr::core::matrix4 &transformation = nodes[i]->getAbsoluteTransformation();
+
+      if(transformation == m_DynamicTransforms[i])
+        continue;
+
+      irr::core::aabbox3df box = nodes[i]->getTransformedBoundingBox();
+
+      // The shadow has to go from where the node was and appear where it is now
+      m_MovedBoxes.push_back(m_DynamicBoxes[i]);
+
+      m_DynamicTransforms[i] = transformation;
+      m_DynamicBoxes[i] = getLightBox(box.getCenter(), box.getExtent() * 0.5f);
+
+      m_MovedBoxes.push_back(m_DynamicBoxes[i]);
+    }
+  }
+
+  for(irr::u32 c=0; c < SHADOW_CASCADES; ++c)
+  {
+    for(irr::u32 i=0; i < m_MovedBoxes.size() && !b_Dirty[c]; ++i)
+      b_Dirty[c] = overlaps(m_Cascades[c], m_MovedBoxes[i]);
+  }
+}
+
+void CShadowManager::invalidate(const irr::core::aabbox3df& box)
+{
+  if(!m_Texture)
+    return;
+
+  irr::core::aabbox3df lightBox = getLightBox(box.getCenter(), box.getExtent() * 0.5f);
+
+  for(irr::u32 c=0; c < SHADOW_CASCADES; ++c)
+  {
+    if(overlaps(m_Cascades[c], lightBox))
+      b_Dirty[c] = true;
+  }
+}
+
+bool CShadowManager::overlaps(const SShadowCascade& cascade, const irr::core::aabbox3df& lightBox)
+{
+  return lightBox.MinEdge.X <= cascade.Center.X + cascade.HalfSize
+    && lightBox.MaxEdge.X >= cascade.Center.X - cascade.HalfSize
+    && lightBox.MinEdge.Y <= cascade.Center.Y + cascade.HalfSize
+    && lightBox.MaxEdge.Y >= cascade.Center.Y - cascade.HalfSize;
+}
+
+bool CShadowManager::fitCascade(irr::u32 index, irr::scene::ICameraSceneNode *camera, irr::f32 nearValue, irr::f32 farValue)
+{
+  SShadowCascade &cascade = m_Cascades[index];
+
+  irr::core::vector3df position = camera->getAbsolutePosition();
+  irr::core::vector3df direction = (camera->getTarget() - position).normalize();
+  irr::core::vector3df right = camera->getUpVector().crossProduct(direction).normalize();
+  irr::core::vector3df up = direction.crossProduct(right);
+
+  irr::f32 tanY = tanf(camera->getFOV() * 0.5f);
+  irr::f32 tanX = tanY * camera->getAspectRatio();
+
+  irr::core::vector3df corners[8];
+
+  for(irr::u32 i=0; i < 2; ++i)
+  {
+    irr::f32 distance = (i == 0) ? nearValue : farValue;
+
+    irr::core::vector3df center = position + direction * distance;
+    irr::core::vector3df x = right * (distance * tanX);
+    irr::core::vector3df y = up * (distance * tanY);
+
+    corners[i*4+0] = center - x - y;
+    corners[i*4+1] = center + x - y;
+    corners[i*4+2] = center - x + y;
+    corners[i*4+3] = center + x + y;
+  }
+
+  // Bounding sphere of the slice, its size doesn't change when the camera turns
+  irr::core::vector3df center(0.f, 0.f, 0.f);
+
+  for(irr::u32 i=0; i < 8; ++i)
+    center += corners[i];
+
+  center /= 8.f;
+
+  irr::f32 radius = 0.f;
+
+  for(irr::u32 i=0; i < 8; ++i)
+    radius = irr::core::max_(radius, corners[i].getDistanceFrom(center));
+
+  radius = ceilf(radius);
+
+  irr::core::vector3df lightCenter;
+  m_LightView.transformVect(lightCenter, center);
+
+  cascade.Split = farValue;
+
+  // The slice is still inside the region the cascade was drawn for
+  if(cascade.Valid && cascade.Radius == radius
+  && fabsf(lightCenter.X - cascade.Center.X) + radius <= cascade.HalfSize
+  && fabsf(lightCenter.Y - cascade.Center.Y) + radius <= cascade.HalfSize)
+    return false;
+
+  cascade.Radius = radius;
+  cascade.HalfSize = radius * (1.f + SHADOW_CASCADE_MARGIN);
+
+  // Whole texels only, the shadow edges don't crawl when the region moves
+  irr::f32 texel = cascade.HalfSize * 2.f / irr::f32(SHADOW_MAP_SIZE);
+
+  cascade.Center.X = floorf(lightCenter.X / texel) * texel;
+  cascade.Center.Y = floorf(lightCenter.Y / texel) * texel;
+
+  irr::core::matrix4 translation;
+  translation.setTranslation(irr::core::vector3df(-cascade.Center.X, -cascade.Center.Y, 0.f));
+
+  cascade.View = translation * m_LightView;
+  cascade.Projection.buildProjectionMatrixOrthoLH(cascade.HalfSize * 2.f, cascade.HalfSize * 2.f, m_MinDepth, m_MaxDepth);
+
+  // Clip space to the quarter of the atlas. Render targets are upside down in OpenGL.
+  irr::u32 column = index % 2, row = index / 2;
+
+  irr::core::matrix4 bias;
+  bias[0] = 0.25f;
+  bias[12] = 0.25f + 0.5f * column;
+
+  if(Core->getRenderer()->getVideoDriver()->getDriverType() == irr::video::EDT_OPENGL)
+  {
+    bias[5] = 0.25f;
+    bias[13] = 0.25f + 0.5f * (1 - row);
+  }
+  else
+  {
+    bias[5] = -0.25f;
+    bias[13] = 0.25f + 0.5f * row;
+  }
+
+  cascade.Lookup = bias * cascade.Projection * cascade.View;
+
+  cascade.Valid = true;
+
+  return true;
+}
+
+void CShadowManager::update()
+{
+  m_Rendered = m_CasterDraws = 0;
+
+  if(!m_Texture)
+    return;
+
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+  irr::scene::ICameraSceneNode *camera = Core->getRenderer()->getSceneManager()->getActiveCamera();
+
+  irr::core::vector3df sun = Core->getObjects()->parameters.sunPosition;
+
+  if(!camera || sun.getLengthSQ() == 0.f)
+    return;
+
+  sun.normalize();
+
+  if(!sun.equals(m_SunDirection))
+  {
+    updateLightView(sun);
+    updateSceneBox();
+  }
+
+  if(Core->getRenderer()->getCullingManager()->getStaticNodes().size() != m_StaticCount
+  || Core->getRenderer()->getInstancingManager()->getGroupCount() != m_GroupCount)
+    updateSceneBox();
+
+  // Practical split scheme: logarithmic near the camera, even further away
+  irr::f32 nearValue = camera->getNearValue();
+  irr::f32 farValue = irr::core::min_(camera->getFarValue(), SHADOW_DISTANCE);
+
+  irr::f32 sliceStart = nearValue;
+
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+  {
+    irr::f32 part = irr::f32(i+1) / irr::f32(SHADOW_CASCADES);
+
+    irr::f32 logSplit = nearValue * powf(farValue / nearValue, part);
+    irr::f32 evenSplit = nearValue + (farValue - nearValue) * part;
+
+    irr::f32 sliceEnd = SHADOW_SPLIT_LAMBDA * logSplit + (1.f - SHADOW_SPLIT_LAMBDA) * evenSplit;
+
+    if(fitCascade(i, camera, sliceStart, sliceEnd))
+      b_Dirty[i] = true;
+
+    sliceStart = sliceEnd;
+  }
+
+  updateDynamicCasters();
+
+  bool dirty = false;
+
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+    dirty = dirty || b_Dirty[i];
+
+  if(!dirty)
+    return;
+
+  // The color of the clean cascades stays, the depth buffer is only needed while drawing
+  driver->setRenderTarget(m_Texture, false, true);
+
+  for(irr::u32 i=0; i < SHADOW_CASCADES; ++i)
+  {
+    if(!b_Dirty[i])
+      continue;
+
+    renderCascade(i);
+
+    b_Dirty[i] = false;
+    ++m_Rendered;
+  }
+
+  driver->setRenderTarget(0, false, false);
+  driver->setViewPort(irr::core::rect<irr::s32>(0, 0, driver->getScreenSize().Width, driver->getScreenSize().Height));
+}
+
+void CShadowManager::renderCascade(irr::u32 index)
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  irr::s32 size = SHADOW_MAP_SIZE;
+  irr::s32 x = (index % 2) * size, y = (index / 2) * size;
+
+  irr::core::rect<irr::s32> area(x, y, x + size, y + size);
+
+  // Reset the quarter to the far plane
+  driver->setViewPort(irr::core::rect<irr::s32>(0, 0, size * 2, size * 2));
+  driver->draw2DRectangle(irr::video::SColor(255, 255, 255, 255), area);
+
+  driver->setViewPort(area);
+
+  driver->setTransform(irr::video::ETS_PROJECTION, m_Cascades[index].Projection);
+  driver->setTransform(irr::video::ETS_VIEW, m_Cascades[index].View);
+
+  renderCasters(m_Cascades[index]);
+}
+
+void CShadowManager::renderCasters(const SShadowCascade& cascade)
+{
+  irr::video::IVideoDriver *driver = Core->getRenderer()->getVideoDriver();
+
+  CCullingManager *culling = Core->getRenderer()->getCullingManager();
+  CInstancingManager *instancing = Core->getRenderer()->getInstancingManager();
+
+  driver->setMaterial(m_DepthMaterial);
+
+  for(irr::u32 list=0; list < 2; ++list)
+  {
+    const irr::core::array<irr::scene::ISceneNode*> &nodes = (list == 0) ? culling->getStaticNodes() : culling->getDynamicNodes();
+
+    for(irr::u32 i=0; i < nodes.size(); ++i)
+    {
+      irr::scene::ISceneNode *node = nodes[i];
+
+      if(!node->isVisible() || node->getType() != irr::scene::ESNT_MESH)
+        continue;
+
+      irr::scene::IMesh *mesh = ((irr::scene::IMeshSceneNode*)node)->getMesh();
+
+      if(!mesh)
+        continue;
+
+      irr::core::aabbox3df box = node->getTransformedBoundingBox();
+
+      if(!overlaps(cascade, getLightBox(box.getCenter(), box.getExtent() * 0.5f)))
+        continue;
+
+      driver->setTransform(irr::video::ETS_WORLD, node->getAbsoluteTransformation());
+
+      for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+      {
+        irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+
+        // Alpha tested leaves would cast solid quads
+        const irr::video::SMaterial &material = (b < node->getMaterialCount()) ? node->getMaterial(b) : buffer->getMaterial();
+
+        if(material.isTransparent())
+          continue;
+
+        driver->drawMeshBuffer(buffer);
+
+        ++m_CasterDraws;
+      }
+    }
+  }
+
+  for(irr::u32 g=0; g < instancing->getGroupCount(); ++g)
+  {
+    SInstanceGroup *group = instancing->getGroup(g);
+
+    m_Transforms.set_used(0);
+
+    for(irr::u32 i=0; i < group->Boxes.Count; ++i)
+    {
+      irr::core::vector3df center(group->Boxes.CenterX[i], group->Boxes.CenterY[i], group->Boxes.CenterZ[i]);
+      irr::core::vector3df extent(group->Boxes.ExtentX[i], group->Boxes.ExtentY[i], group->Boxes.ExtentZ[i]);
+
+      if(overlaps(cascade, getLightBox(center, extent)))
+        m_Transforms.push_back(group->Transforms[i]);
+    }
+
+    if(m_Transforms.size() == 0)
+      continue;
+
+    // The coarsest level is enough for a shadow
+    irr::scene::IMesh *mesh = group->Lods[group->LodCount-1];
+    irr::scene::ISceneNode *node = group->Nodes[0];
+
+    for(irr::u32 b=0; b < mesh->getMeshBufferCount(); ++b)
+    {
+      irr::scene::IMeshBuffer *buffer = mesh->getMeshBuffer(b);
+
+      const irr::video::SMaterial &material = (b < node->getMaterialCount()) ? node->getMaterial(b) : buffer->getMaterial();
+
+      if(material.isTransparent())
+        continue;
+
+      driver->drawMeshBufferInstanced(buffer, m_Transforms.const_pointer(), m_Transforms.size());
+
+      ++m_CasterDraws;
+    }
+  }
+}
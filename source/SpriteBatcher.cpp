@@ -0,0 +1,585 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "SpriteBatcher.h"
+
+using namespace engine;
+
+using namespace irr;
+using namespace irr::video;
+using namespace irr::core;
+
+CSpriteBatcher::CSpriteBatcher(CCore * core) : Core(core)
+{
+  m_Driver = Core->getRenderer()->getVideoDriver();
+
+  m_AtlasSize = SPRITE_ATLAS_SIZE;
+
+  dimension2du maxSize = m_Driver->getMaxTextureSize();
+
+  if(maxSize.Width != 0 && maxSize.Width < m_AtlasSize) m_AtlasSize = maxSize.Width;
+  if(maxSize.Height != 0 && maxSize.Height < m_AtlasSize) m_AtlasSize = maxSize.Height;
+
+  m_AtlasCount = 0;
+  m_LastPage = -1;
+
+  m_DrawCalls = m_LastDrawCalls = 0;
+  m_Quads = m_LastQuads = 0;
+
+  // Texture alpha * vertex alpha, same as draw2DImage with the alpha channel enabled
+  m_Material.Lighting = false;
+  m_Material.ZWriteEnable = false;
+  m_Material.MaterialType = EMT_ONETEXTURE_BLEND;
+  m_Material.MaterialTypeParam = pack_texureBlendFunc(
+    EBF_SRC_ALPHA, EBF_ONE_MINUS_SRC_ALPHA, EMFN_MODULATE_1X, EAS_TEXTURE | EAS_VERTEX_COLOR);
+}
+
+CSpriteBatcher::~CSpriteBatcher()
+{
+  clear();
+}
+
+irr::s32 CSpriteBatcher::addSprite(const irr::io::path& file)
+{
+  for(u32 i=0; i < m_Sprites.size(); ++i)
+    if(m_Sprites[i].File == file)
+      return i;
+
+  IImage *image = m_Driver->createImageFromFile(file);
+
+  if(!image)
+  {
+    printf("\tERROR: Unable to load sprite %s\n", file.c_str());
+    return -1;
+  }
+
+  return addSpriteImage(image, file);
+}
+
+irr::s32 CSpriteBatcher::addSpriteImage(irr::video::IImage *image, const irr::io::path& file)
+{
+  SSprite sprite;
+  sprite.File = file;
+  sprite.Rect = rect<s32>(position2d<s32>(0,0), dimension2d<s32>(image->getDimension().Width, image->getDimension().Height));
+
+  m_Sprites.push_back(sprite);
+
+  m_PendingImages.push_back(image);
+  m_PendingSprites.push_back(m_Sprites.size()-1);
+
+  return m_Sprites.size()-1;
+}
+
+void CSpriteBatcher::addFont(irr::gui::IGUIFont *font)
+{
+  if(!font || font->getType() != irr::gui::EGFT_BITMAP)
+    return;
+
+  irr::gui::IGUISpriteBank *bank = ((irr::gui::IGUIFontBitmap*)font)->getSpriteBank();
+
+  if(!bank)
+    return;
+
+  for(u32 i=0; i < bank->getTextureCount(); ++i)
+  {
+    ITexture *texture = bank->getTexture(i);
+
+    if(!texture || m_FontSprites.find(texture))
+      continue;
+
+    // The glyph rectangles are in original pixels, a rescaled page can't be copied
+    if(texture->getSize() != texture->getOriginalSize())
+      continue;
+
+    // Read the page back, the font made its color key transparent after loading it
+    void *data = texture->lock(true);
+
+    if(!data)
+      continue;
+
+    IImage *pageImage = m_Driver->createImageFromData(texture->getColorFormat(), texture->getSize(), data);
+    texture->unlock();
+
+    IImage *image = m_Driver->createImage(ECF_A8R8G8B8, texture->getSize());
+    pageImage->copyTo(image);
+    pageImage->drop();
+
+    m_FontSprites.insert(texture, addSpriteImage(image, texture->getName().getPath()));
+  }
+}
+
+bool CSpriteBatcher::allocate(SSpritePage &page, const irr::core::dimension2d<irr::u32>& size,
+  irr::core::position2d<irr::s32>& position)
+{
+  u32 w = size.Width + SPRITE_ATLAS_PADDING*2;
+  u32 h = size.Height + SPRITE_ATLAS_PADDING*2;
+
+  // Start a new shelf
+  if(page.ShelfX + w > m_AtlasSize)
+  {
+    page.ShelfY += page.ShelfHeight;
+    page.ShelfX = 0;
+    page.ShelfHeight = 0;
+  }
+
+  if(page.ShelfX + w > m_AtlasSize || page.ShelfY + h > m_AtlasSize)
+    return false;
+
+  position.X = page.ShelfX + SPRITE_ATLAS_PADDING;
+  position.Y = page.ShelfY + SPRITE_ATLAS_PADDING;
+
+  page.ShelfX += w;
+
+  if(h > page.ShelfHeight)
+    page.ShelfHeight = h;
+
+  return true;
+}
+
+void CSpriteBatcher::buildAtlases()
+{
+  if(m_PendingImages.size() == 0)
+    return;
+
+  // Tallest images first, gives the shelf packer much less wasted space
+  for(u32 i=1; i < m_PendingImages.size(); ++i)
+  {
+    for(u32 j=i; j > 0 && m_PendingImages[j]->getDimension().Height > m_PendingImages[j-1]->getDimension().Height; --j)
+    {
+      IImage *img = m_PendingImages[j];
+      m_PendingImages[j] = m_PendingImages[j-1];
+      m_PendingImages[j-1] = img;
+
+      s32 spr = m_PendingSprites[j];
+      m_PendingSprites[j] = m_PendingSprites[j-1];
+      m_PendingSprites[j-1] = spr;
+    }
+  }
+
+  // Pages created by this call and their CPU-side images
+  array<s32> buildPages;
+  array<IImage*> buildImages;
+
+  for(u32 i=0; i < m_PendingImages.size(); ++i)
+  {
+    IImage *image = m_PendingImages[i];
+    SSprite &sprite = m_Sprites[m_PendingSprites[i]];
+
+    dimension2du size = image->getDimension();
+
+    // Doesn't fit into an atlas, use it as a page of its own
+    if(size.Width + SPRITE_ATLAS_PADDING*2 > m_AtlasSize
+    || size.Height + SPRITE_ATLAS_PADDING*2 > m_AtlasSize)
+    {
+      sprite.Page = getPageForTexture(m_Driver->getTexture(sprite.File));
+      image->drop();
+      continue;
+    }
+
+    position2d<s32> pos;
+    s32 pageIdx = -1;
+
+    for(u32 p=0; p < buildPages.size(); ++p)
+    {
+      if(allocate(m_Pages[buildPages[p]], size, pos))
+      {
+        pageIdx = p;
+        break;
+      }
+    }
+
+    if(pageIdx == -1)
+    {
+      SSpritePage page;
+      page.Atlas = true;
+
+      IImage *atlasImage = m_Driver->createImage(ECF_A8R8G8B8, dimension2du(m_AtlasSize, m_AtlasSize));
+      atlasImage->fill(SColor(0,0,0,0));
+
+      // White block for rectangles
+      position2d<s32> whitePos;
+
+      if(allocate(page, dimension2du(4,4), whitePos))
+      {
+        for(u32 y=0; y < 4; ++y)
+          for(u32 x=0; x < 4; ++x)
+            atlasImage->setPixel(whitePos.X+x, whitePos.Y+y, SColor(255,255,255,255));
+
+        page.WhiteTexel = whitePos;
+      }
+
+      m_Pages.push_back(page);
+
+      buildPages.push_back(m_Pages.size()-1);
+      buildImages.push_back(atlasImage);
+
+      pageIdx = buildPages.size()-1;
+
+      allocate(m_Pages[buildPages[pageIdx]], size, pos);
+    }
+
+    image->copyTo(buildImages[pageIdx], pos);
+    image->drop();
+
+    sprite.Page = buildPages[pageIdx];
+    sprite.Rect = rect<s32>(pos, dimension2d<s32>(size.Width, size.Height));
+  }
+
+  m_PendingImages.set_used(0);
+  m_PendingSprites.set_used(0);
+
+  // Upload the atlases
+  bool PreviousMipMapState = m_Driver->getTextureCreationFlag(ETCF_CREATE_MIP_MAPS);
+  bool Previous32BitState = m_Driver->getTextureCreationFlag(ETCF_ALWAYS_32_BIT);
+
+  m_Driver->setTextureCreationFlag(ETCF_CREATE_MIP_MAPS, false);
+  m_Driver->setTextureCreationFlag(ETCF_ALWAYS_32_BIT, true);
+
+  for(u32 p=0; p < buildPages.size(); ++p)
+  {
+    stringc name = "spriteatlas_";
+    name += m_AtlasCount++;
+
+    m_Pages[buildPages[p]].Texture = m_Driver->addTexture(name.c_str(), buildImages[p]);
+
+    buildImages[p]->drop();
+  }
+
+  m_Driver->setTextureCreationFlag(ETCF_ALWAYS_32_BIT, Previous32BitState);
+  m_Driver->setTextureCreationFlag(ETCF_CREATE_MIP_MAPS, PreviousMipMapState);
+
+  printf("Sprite atlases: %d (%d sprites)\n", m_AtlasCount, m_Sprites.size());
+}
+
+void CSpriteBatcher::clear()
+{
+  for(u32 i=0; i < m_PendingImages.size(); ++i)
+    m_PendingImages[i]->drop();
+
+  m_PendingImages.set_used(0);
+  m_PendingSprites.set_used(0);
+
+  for(u32 i=0; i < m_Pages.size(); ++i)
+  {
+    if(!m_Pages[i].Texture)
+      continue;
+
+    if(m_Pages[i].Atlas)
+      m_Driver->removeTexture(m_Pages[i].Texture);
+    else
+      m_Pages[i].Texture->drop();
+  }
+
+  m_Pages.clear();
+  m_Sprites.clear();
+  m_FontSprites.clear();
+
+  m_AtlasCount = 0;
+  m_LastPage = -1;
+}
+
+irr::s32 CSpriteBatcher::getPageForTexture(irr::video::ITexture *texture)
+{
+  if(!texture)
+    return -1;
+
+  for(u32 i=0; i < m_Pages.size(); ++i)
+    if(m_Pages[i].Texture == texture)
+      return i;
+
+  SSpritePage page;
+  page.Texture = texture;
+  page.Texture->grab();
+
+  m_Pages.push_back(page);
+
+  return m_Pages.size()-1;
+}
+
+void CSpriteBatcher::addQuad(irr::s32 page,
+  const irr::core::rect<irr::f32>& destRect,
+  const irr::core::rect<irr::s32>& sourceRect,
+  irr::video::SColor color)
+{
+  if(page < 0 || !m_Pages[page].Texture)
+    return;
+
+  SSpritePage &p = m_Pages[page];
+
+  // 16-bit indices
+  if(p.Vertices.size() + 4 > 65535)
+    flushPage(page);
+
+  // The quads of the previous page were submitted first, they are drawn first
+  if(m_LastPage != -1 && m_LastPage != page)
+    flushPage(m_LastPage);
+
+  const dimension2du& ts = p.Texture->getOriginalSize();
+  const f32 invW = 1.f / f32(ts.Width);
+  const f32 invH = 1.f / f32(ts.Height);
+
+  const f32 u0 = sourceRect.UpperLeftCorner.X * invW;
+  const f32 v0 = sourceRect.UpperLeftCorner.Y * invH;
+  const f32 u1 = sourceRect.LowerRightCorner.X * invW;
+  const f32 v1 = sourceRect.LowerRightCorner.Y * invH;
+
+  const f32 x0 = destRect.UpperLeftCorner.X;
+  const f32 y0 = destRect.UpperLeftCorner.Y;
+  const f32 x1 = destRect.LowerRightCorner.X;
+  const f32 y1 = destRect.LowerRightCorner.Y;
+
+  u16 base = (u16)p.Vertices.size();
+
+  p.Vertices.push_back(S3DVertex(x0, y0, 0.f, 0.f, 0.f, 0.f, color, u0, v0));
+  p.Vertices.push_back(S3DVertex(x1, y0, 0.f, 0.f, 0.f, 0.f, color, u1, v0));
+  p.Vertices.push_back(S3DVertex(x1, y1, 0.f, 0.f, 0.f, 0.f, color, u1, v1));
+  p.Vertices.push_back(S3DVertex(x0, y1, 0.f, 0.f, 0.f, 0.f, color, u0, v1));
+
+  p.Indices.push_back(base);
+  p.Indices.push_back(base+1);
+  p.Indices.push_back(base+2);
+  p.Indices.push_back(base);
+  p.Indices.push_back(base+2);
+  p.Indices.push_back(base+3);
+
+  m_LastPage = page;
+}
+
+void CSpriteBatcher::draw(irr::s32 sprite,
+  const irr::core::position2d<irr::s32>& position,
+  const irr::core::rect<irr::s32>& sourceRect,
+  irr::video::SColor color)
+{
+  if(sprite < 0 || sprite >= (s32)m_Sprites.size())
+    return;
+
+  const SSprite &spr = m_Sprites[sprite];
+
+  // Source rect is relative to the sprite, clip it to the sprite size
+  rect<s32> src = sourceRect + spr.Rect.UpperLeftCorner;
+  src.clipAgainst(spr.Rect);
+
+  if(!src.isValid())
+    return;
+
+  rect<f32> dest(
+    f32(position.X), f32(position.Y),
+    f32(position.X + src.getWidth()), f32(position.Y + src.getHeight()));
+
+  addQuad(spr.Page, dest, src, color);
+}
+
+void CSpriteBatcher::draw(irr::s32 sprite,
+  const irr::core::rect<irr::s32>& destRect,
+  const irr::core::rect<irr::s32>& sourceRect,
+  irr::video::SColor color)
+{
+  if(sprite < 0 || sprite >= (s32)m_Sprites.size())
+    return;
+
+  const SSprite &spr = m_Sprites[sprite];
+
+  rect<s32> src = sourceRect + spr.Rect.UpperLeftCorner;
+  src.clipAgainst(spr.Rect);
+
+  if(!src.isValid())
+    return;
+
+  rect<f32> dest(
+    f32(destRect.UpperLeftCorner.X), f32(destRect.UpperLeftCorner.Y),
+    f32(destRect.LowerRightCorner.X), f32(destRect.LowerRightCorner.Y));
+
+  addQuad(spr.Page, dest, src, color);
+}
+
+void CSpriteBatcher::drawRectangle(irr::video::SColor color, const irr::core::rect<irr::s32>& position)
+{
+  // Prefer the page used last so the rectangle keeps its order with the sprites around it
+  s32 page = -1;
+
+  if(m_LastPage != -1 && m_Pages[m_LastPage].WhiteTexel.X != -1)
+  {
+    page = m_LastPage;
+  }
+  else
+  {
+    for(u32 i=0; i < m_Pages.size(); ++i)
+    {
+      if(m_Pages[i].Texture && m_Pages[i].WhiteTexel.X != -1)
+      {
+        page = i;
+        break;
+      }
+    }
+  }
+
+  // No atlas yet, draw it directly
+  if(page == -1)
+  {
+    flush();
+    m_Driver->draw2DRectangle(color, position);
+    ++m_DrawCalls;
+    return;
+  }
+
+  const position2d<s32>& white = m_Pages[page].WhiteTexel;
+
+  rect<f32> dest(
+    f32(position.UpperLeftCorner.X), f32(position.UpperLeftCorner.Y),
+    f32(position.LowerRightCorner.X), f32(position.LowerRightCorner.Y));
+
+  addQuad(page, dest, rect<s32>(white.X+1, white.Y+1, white.X+3, white.Y+3), color);
+}
+
+void CSpriteBatcher::drawText(irr::gui::IGUIFont *font,
+  const irr::core::stringw& text,
+  const irr::core::rect<irr::s32>& position,
+  irr::video::SColor color,
+  bool hcenter, bool vcenter)
+{
+  if(!font || text.size() == 0)
+    return;
+
+  // Only bitmap fonts expose their glyphs
+  if(font->getType() != irr::gui::EGFT_BITMAP)
+  {
+    flush();
+    font->draw(text, position, color, hcenter, vcenter);
+    ++m_DrawCalls;
+    return;
+  }
+
+  irr::gui::IGUIFontBitmap *bitmapFont = (irr::gui::IGUIFontBitmap*)font;
+  irr::gui::IGUISpriteBank *bank = bitmapFont->getSpriteBank();
+
+  if(!bank)
+    return;
+
+  array<irr::gui::SGUISprite>& glyphs = bank->getSprites();
+  array<rect<s32> >& glyphRects = bank->getPositions();
+
+  // Layout follows CGUIFont::draw
+  dimension2d<s32> textDimension;
+  position2d<s32> offset = position.UpperLeftCorner;
+
+  s32 lineHeight = (s32)font->getDimension(L"").Height;
+
+  if(hcenter || vcenter)
+  {
+    dimension2du dim = font->getDimension(text.c_str());
+    textDimension.Width = dim.Width;
+    textDimension.Height = dim.Height;
+  }
+
+  if(hcenter)
+    offset.X += (position.getWidth() - textDimension.Width) >> 1;
+
+  if(vcenter)
+    offset.Y += (position.getHeight() - textDimension.Height) >> 1;
+
+  for(u32 i=0; i < text.size(); ++i)
+  {
+    wchar_t c = text[i];
+
+    bool lineBreak = false;
+
+    if(c == L'\r')
+    {
+      lineBreak = true;
+      if(text[i+1] == L'\n')
+        c = text[++i];
+    }
+    else if(c == L'\n')
+    {
+      lineBreak = true;
+    }
+
+    if(lineBreak)
+    {
+      offset.Y += lineHeight;
+      offset.X = position.UpperLeftCorner.X;
+
+      if(hcenter)
+        offset.X += (position.getWidth() - textDimension.Width) >> 1;
+
+      continue;
+    }
+
+    // Underhang is the difference between kerning with and without a previous letter
+    s32 overhang = bitmapFont->getKerningWidth(&c);
+    s32 underhang = bitmapFont->getKerningWidth(&c, &c) - overhang;
+
+    offset.X += underhang;
+
+    u32 spriteNo = bitmapFont->getSpriteNoFromChar(&c);
+
+    if(spriteNo >= glyphs.size() || glyphs[spriteNo].Frames.size() == 0)
+      continue;
+
+    const irr::gui::SGUISpriteFrame& frame = glyphs[spriteNo].Frames[0];
+    const rect<s32>& glyphRect = glyphRects[frame.rectNumber];
+
+    if(c != L' ')
+    {
+      rect<f32> dest(
+        f32(offset.X), f32(offset.Y),
+        f32(offset.X + glyphRect.getWidth()), f32(offset.Y + glyphRect.getHeight()));
+
+      ITexture *texture = bank->getTexture(frame.textureNumber);
+      map<ITexture*, s32>::Node *fontSprite = m_FontSprites.find(texture);
+
+      // Glyph pages packed into an atlas are offset by their place in it
+      if(fontSprite && m_Sprites[fontSprite->getValue()].Page != -1)
+      {
+        const SSprite &spr = m_Sprites[fontSprite->getValue()];
+        addQuad(spr.Page, dest, glyphRect + spr.Rect.UpperLeftCorner, color);
+      }
+      else
+        addQuad(getPageForTexture(texture), dest, glyphRect, color);
+    }
+
+    offset.X += glyphRect.getWidth() + overhang;
+  }
+}
+
+void CSpriteBatcher::flushPage(irr::s32 page)
+{
+  SSpritePage &p = m_Pages[page];
+
+  if(p.Vertices.size() == 0)
+    return;
+
+  m_Material.setTexture(0, p.Texture);
+  m_Driver->setMaterial(m_Material);
+
+  m_Driver->draw2DVertexPrimitiveList(
+    p.Vertices.const_pointer(), p.Vertices.size(),
+    p.Indices.const_pointer(), p.Indices.size() / 3,
+    EVT_STANDARD, irr::scene::EPT_TRIANGLES, EIT_16BIT);
+
+  ++m_DrawCalls;
+  m_Quads += p.Vertices.size() / 4;
+
+  // Keep the memory, the same amount is needed next frame
+  p.Vertices.set_used(0);
+  p.Indices.set_used(0);
+}
+
+void CSpriteBatcher::flush()
+{
+  // Only the page used last has quads queued
+  if(m_LastPage != -1)
+    flushPage(m_LastPage);
+
+  m_LastPage = -1;
+}
+
+void CSpriteBatcher::endFrame()
+{
+  flush();
+
+  m_LastDrawCalls = m_DrawCalls;
+  m_LastQuads = m_Quads;
+
+  m_DrawCalls = 0;
+  m_Quads = 0;
+}
@@ -117,17 +117,20 @@ void CTerminal::update()
   if(b_Draw == false)
     return;
 
-  irr::video::IVideoDriver *VDriver = Game->getCore()->getRenderer()->getVideoDriver();
+  engine::CSpriteBatcher *batcher = Game->getCore()->getRenderer()->getSpriteBatcher();
 
   irr::core::dimension2d<irr::u16> windowSize = GUI->screenSize;
 
   u32 sw = windowSize.Width;
   u32 sh = windowSize.Height;
 
-  VDriver->draw2DImage(
-    GUI->textures[TEX_TERMINAL_BACKGROUND],
+  batcher->draw(
+    GUI->sprites[TEX_TERMINAL_BACKGROUND],
     rect<s32>(0,0, windowSize.Width, windowSize.Height),
-    rect<s32>(0,0,1024,1024), 0, 0, true);
+    rect<s32>(0,0,1024,1024));
+
+  // The terminal buttons are drawn on top by the GUI environment
+  batcher->flush();
 
   return;
 }
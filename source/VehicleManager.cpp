@@ -0,0 +1,729 @@
+#include "Core.h"
+#include "Renderer.h"
+#include "Physics.h"
+#include "ObjectManager.h"
+#include "VehicleManager.h"
+
+#ifdef PHYSICS_NEWTON
+
+using namespace engine;
+using namespace engine::physics;
+
+static const SVehicleClass vehicleClasses[EVC_COUNT] =
+{
+  // Mass    Travel  Acceleration Braking MaxSpeed Steer  Grip  SideGrip
+  { 1800.f,  9.6f,   4.f,         8.f,    832.f,   32.f,  1.0f, 1.0f },  // EVC_WHEELED
+  { 28000.f, 6.4f,   3.f,         6.f,    448.f,   0.f,   1.0f, 0.6f }   // EVC_TRACKED
+};
+
+static void vehicle_ApplyForceAndTorqueCallback(const NewtonBody* newtonBody, float timestep, int threadIndex)
+{
+  CVehicleBody *body = (CVehicleBody*)NewtonBodyGetUserData(newtonBody);
+
+  if(body)
+    body->Manager->applyForces(body->Vehicle, timestep);
+}
+
+static void vehicle_SetTransformCallback(const NewtonBody* newtonBody, const float* matrix, int threadIndex)
+{
+  CVehicleBody *body = (CVehicleBody*)NewtonBodyGetUserData(newtonBody);
+
+  if(body)
+    body->Manager->setTransform(body->Vehicle, matrix);
+}
+
+// A node put back into the scene, and its children, are where the
+// parameters say before the scene manager animates them
+static void vehicle_UpdateAbsolutePositions(irr::scene::ISceneNode *node)
+{
+  node->updateAbsolutePosition();
+
+  irr::core::list<irr::scene::ISceneNode*>::ConstIterator it = node->getChildren().begin();
+
+  for(; it != node->getChildren().end(); ++it)
+    vehicle_UpdateAbsolutePositions(*it);
+}
+
+CVehicleManager::CVehicleManager(CCore * core) : Core(core)
+{
+  m_Driving = m_Parked = 0;
+}
+
+CVehicleManager::~CVehicleManager()
+{
+}
+
+void CVehicleManager::addVehicle(irr::scene::IMeshSceneNode *node, E_VEHICLE_CLASS vehicleClass)
+{
+  node->updateAbsolutePosition();
+
+  irr::core::matrix4 absolute = node->getAbsoluteTransformation();
+
+  // Out of the level until build(), the grab keeps the node alive
+  node->grab();
+  node->remove();
+
+  node->setPosition(absolute.getTranslation());
+  node->setRotation(absolute.getRotationDegrees());
+  node->setScale(absolute.getScale());
+
+  SVehicle vehicle;
+  vehicle.Node = node;
+  vehicle.Body = (physics::CBody*)NULL;
+  vehicle.Class = vehicleClass;
+  vehicle.Spring = vehicle.Damper = 0.f;
+  vehicle.Throttle = vehicle.Steering = 0.f;
+  vehicle.Brake = false;
+  vehicle.IdleTime = 0.f;
+  vehicle.Parked = false;
+  vehicle.Driven = false;
+
+  m_Vehicles.push_back(vehicle);
+}
+
+void CVehicleManager::build()
+{
+  irr::scene::ISceneNode *root = Core->getRenderer()->getSceneManager()->getRootSceneNode();
+
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    SVehicle &vehicle = m_Vehicles[i];
+
+    if(vehicle.Body)
+      continue;
+
+    root->addChild(vehicle.Node);
+
+    vehicle_UpdateAbsolutePositions(vehicle.Node);
+
+    createBody(vehicle, i);
+  }
+
+  m_Previous.set_used(m_Vehicles.size());
+  m_Current.set_used(m_Vehicles.size());
+
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    m_Current[i].Position = m_Vehicles[i].Node->getPosition();
+    m_Current[i].Rotation.set(m_Vehicles[i].Node->getRotation() * irr::core::DEGTORAD);
+
+    m_Previous[i] = m_Current[i];
+  }
+
+  printf("\tVehicles: %d\n", m_Vehicles.size());
+}
+
+void CVehicleManager::createWheels(SVehicle& vehicle, const irr::core::matrix4& bodyMatrix)
+{
+  const SVehicleClass &handling = vehicleClasses[vehicle.Class];
+
+  irr::core::matrix4 inverse;
+  bodyMatrix.getInverse(inverse);
+
+  vehicle.Wheels.set_used(0);
+
+  irr::core::list<irr::scene::ISceneNode*>::ConstIterator it = vehicle.Node->getChildren().begin();
+
+  for(; it != vehicle.Node->getChildren().end() && vehicle.Wheels.size() < VEHICLE_MAX_WHEELS; ++it)
+  {
+    irr::scene::ISceneNode *child = *it;
+
+    if(Core->getObjects()->getObjectSimpleName(child->getName()) != "Wheel")
+      continue;
+
+    SVehicleWheel wheel;
+
+    irr::core::vector3df center = child->getAbsolutePosition();
+    inverse.transformVect(center);
+
+    wheel.Radius = child->getBoundingBox().getExtent().Y * child->getAbsoluteTransformation().getScale().Y * 0.5f;
+
+    if(wheel.Radius <= 0.f)
+      continue;
+
+    wheel.Hardpoint = center + irr::core::vector3df(0.f, handling.Travel * 0.5f, 0.f);
+    wheel.Node = child;
+    wheel.NodePosition = child->getPosition();
+    wheel.NodeRotation = child->getRotation();
+
+    vehicle.Wheels.push_back(wheel);
+  }
+
+  // No wheel nodes: wheels under the corners of the chassis, road wheels
+  // along both sides of a tank
+  if(vehicle.Wheels.size() == 0)
+  {
+    irr::core::aabbox3df box = vehicle.Node->getBoundingBox();
+    box.MinEdge *= vehicle.Node->getScale();
+    box.MaxEdge *= vehicle.Node->getScale();
+    box.repair();
+
+    irr::core::vector3df center = box.getCenter();
+    irr::core::vector3df extent = box.getExtent();
+
+    irr::u32 perSide = (vehicle.Class == EVC_TRACKED) ? 5 : 2;
+    irr::f32 radius = extent.Y * ((vehicle.Class == EVC_TRACKED) ? 0.12f : 0.2f);
+    irr::f32 length = extent.Z * ((vehicle.Class == EVC_TRACKED) ? 0.8f : 0.7f);
+
+    for(irr::u32 s=0; s < 2; ++s)
+    {
+      for(irr::u32 w=0; w < perSide; ++w)
+      {
+        SVehicleWheel wheel;
+
+        irr::core::vector3df position;
+        position.X = center.X + extent.X * ((s == 0) ? -0.4f : 0.4f);
+        position.Y = box.MinEdge.Y + radius;
+        position.Z = center.Z - length * 0.5f + length * w / (perSide - 1);
+
+        wheel.Radius = radius;
+        wheel.Hardpoint = position + irr::core::vector3df(0.f, handling.Travel * 0.5f, 0.f);
+        wheel.Node = (irr::scene::ISceneNode*)NULL;
+
+        vehicle.Wheels.push_back(wheel);
+      }
+    }
+  }
+
+  irr::f32 front = -FLT_MAX, back = FLT_MAX;
+
+  for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w)
+  {
+    front = irr::core::max_(front, vehicle.Wheels[w].Hardpoint.Z);
+    back = irr::core::min_(back, vehicle.Wheels[w].Hardpoint.Z);
+  }
+
+  for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w)
+  {
+    SVehicleWheel &wheel = vehicle.Wheels[w];
+
+    // The front axle of a wheeled vehicle steers, a tank turns its tracks
+    wheel.Steered = vehicle.Class == EVC_WHEELED && wheel.Hardpoint.Z > (front + back) * 0.5f + (front - back) * 0.25f;
+    wheel.Side = (wheel.Hardpoint.X < 0.f) ? -1.f : 1.f;
+
+    wheel.Contact = false;
+    wheel.Compression = 0.f;
+    wheel.Normal.set(0.f, 1.f, 0.f);
+    wheel.Ground = (physics::CBody*)NULL;
+    wheel.Spin = 0.f;
+  }
+}
+
+void CVehicleManager::createBody(SVehicle& vehicle, irr::u32 index)
+{
+  CPhysicsWorld *physicsWorld = Core->getPhysics()->getPhysicsWorld();
+  NewtonWorld *world = physicsWorld->getNewtonWorld();
+
+  const SVehicleClass &handling = vehicleClasses[vehicle.Class];
+
+  irr::u32 shapeID = physicsWorld->getUniqueBodyID();
+
+  NewtonCollision *hull = physicsWorld->getCollisionManager()->createConvexHull(
+    world, vehicle.Node->getMesh(), vehicle.Node->getScale(), shapeID);
+
+  irr::core::matrix4 bodyMatrix;
+  bodyMatrix.setRotationDegrees(vehicle.Node->getRotation());
+  bodyMatrix.setTranslation(vehicle.Node->getPosition());
+
+  createWheels(vehicle, bodyMatrix);
+
+  bodyMatrix.setTranslation(vehicle.Node->getPosition() * IrrToNewton);
+
+  NewtonBody *body = NewtonCreateBody(world, hull, getMatrixPointer(bodyMatrix));
+
+  irr::f32 inertia_array[3], origin_array[3];
+
+  NewtonConvexCollisionCalculateInertialMatrix(hull, inertia_array, origin_array);
+  NewtonBodySetMassMatrix(body, handling.Mass, handling.Mass * inertia_array[0],
+    handling.Mass * inertia_array[1], handling.Mass * inertia_array[2]);
+
+  NewtonReleaseCollision(world, hull);
+
+  // The centre of mass at the height of the wheels keeps the vehicle on
+  // its wheels in the turns, a hull's centre is far too high for that
+  if(vehicle.Wheels.size() > 0)
+  {
+    irr::f32 height = 0.f;
+
+    for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w)
+      height += vehicle.Wheels[w].Hardpoint.Y - handling.Travel * 0.5f;
+
+    origin_array[1] = height / vehicle.Wheels.size() * IrrToNewton;
+  }
+
+  NewtonBodySetCentreOfMass(body, origin_array);
+
+  // Each spring holds its share of the mass at half travel
+  irr::f32 wheelMass = handling.Mass / irr::core::max_(vehicle.Wheels.size(), 1u);
+
+  vehicle.Spring = wheelMass * 9.8f / (handling.Travel * 0.5f * IrrToNewton);
+  vehicle.Damper = 2.f * VEHICLE_DAMPING_RATIO * sqrtf(vehicle.Spring * wheelMass);
+
+  CVehicleBody *vehicleBody = new CVehicleBody(shapeID, world, this, index);
+  vehicleBody->setNewtonBody(body);
+  vehicleBody->setNode(vehicle.Node);
+  vehicleBody->setMass(handling.Mass);
+
+  game::SObjectData *objectData = new game::SObjectData();
+  objectData->container_id = index;
+  objectData->element_id = 0;
+  objectData->type = game::EOT_VEHICLE;
+  objectData->material = game::EBMT_METAL;
+  objectData->name = Core->getObjects()->getObjectSimpleName(vehicle.Node->getName());
+  objectData->team = game::E_TEAM1;
+
+  vehicleBody->setUserData((void*)objectData);
+
+  NewtonBodySetUserData(body, vehicleBody);
+  NewtonBodySetForceAndTorqueCallback(body, vehicle_ApplyForceAndTorqueCallback);
+  NewtonBodySetTransformCallback(body, vehicle_SetTransformCallback);
+
+  // Parking decides when a vehicle stops being simulated
+  NewtonBodySetAutoSleep(body, 0);
+
+  vehicle.Body = vehicleBody;
+}
+
+void CVehicleManager::setControls(irr::u32 vehicle, irr::f32 throttle, irr::f32 steering, bool brake)
+{
+  SVehicle &v = m_Vehicles[vehicle];
+
+  v.Throttle = irr::core::clamp(throttle, -1.f, 1.f);
+  v.Steering = irr::core::clamp(steering, -1.f, 1.f);
+  v.Brake = brake;
+}
+
+irr::s32 CVehicleManager::getFreeVehicle(const irr::core::vector3df& position)
+{
+  irr::s32 nearest = -1;
+  irr::f32 nearestSQ = 0.f;
+
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    SVehicle &vehicle = m_Vehicles[i];
+
+    if(!vehicle.Body || vehicle.Driven)
+      continue;
+
+    irr::core::aabbox3df box = vehicle.Node->getTransformedBoundingBox();
+    box.MinEdge -= irr::core::vector3df(VEHICLE_ENTER_DISTANCE, VEHICLE_ENTER_DISTANCE, VEHICLE_ENTER_DISTANCE);
+    box.MaxEdge += irr::core::vector3df(VEHICLE_ENTER_DISTANCE, VEHICLE_ENTER_DISTANCE, VEHICLE_ENTER_DISTANCE);
+
+    if(!box.isPointInside(position))
+      continue;
+
+    irr::f32 distanceSQ = position.getDistanceFromSQ(vehicle.Node->getPosition());
+
+    if(nearest < 0 || distanceSQ < nearestSQ)
+    {
+      nearest = i;
+      nearestSQ = distanceSQ;
+    }
+  }
+
+  return nearest;
+}
+
+void CVehicleManager::setDriven(irr::u32 vehicle, bool driven)
+{
+  SVehicle &v = m_Vehicles[vehicle];
+
+  v.Driven = driven;
+
+  if(!driven)
+    setControls(vehicle, 0.f, 0.f, true);
+}
+
+void CVehicleManager::park(irr::u32 index)
+{
+  SVehicle &vehicle = m_Vehicles[index];
+  NewtonBody *body = vehicle.Body->getNewtonBody();
+
+  irr::f32 zero[3] = { 0.f, 0.f, 0.f };
+
+  NewtonBodySetVelocity(body, zero);
+  NewtonBodySetOmega(body, zero);
+  NewtonBodySetFreezeState(body, 1);
+
+  // The node stays where the last tick left the chassis
+  m_Previous[index] = m_Current[index];
+
+  irr::core::vector3df rotation;
+  m_Current[index].Rotation.toEuler(rotation);
+
+  vehicle.Node->setPosition(m_Current[index].Position);
+  vehicle.Node->setRotation(rotation * irr::core::RADTODEG);
+
+  vehicle.Parked = true;
+  vehicle.IdleTime = 0.f;
+}
+
+void CVehicleManager::unpark(irr::u32 index)
+{
+  SVehicle &vehicle = m_Vehicles[index];
+
+  vehicle.Body->wake();
+
+  m_Previous[index] = m_Current[index];
+
+  vehicle.Parked = false;
+  vehicle.IdleTime = 0.f;
+}
+
+void CVehicleManager::update(irr::f32 time)
+{
+  m_Driving = m_Parked = 0;
+
+  m_Batch.lines.set_used(0);
+  m_Batch.excluded.set_used(0);
+
+  const irr::f32 movingSpeed = PHYSICS_SLEEP_SPEED * IrrToNewton;
+
+  //
+  // Park the idle vehicles, wake the parked ones that are driven or pushed,
+  // the wheel rays of the others go into the batch
+  //
+
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    SVehicle &vehicle = m_Vehicles[i];
+
+    if(!vehicle.Body)
+      continue;
+
+    NewtonBody *body = vehicle.Body->getNewtonBody();
+
+    bool input = vehicle.Throttle != 0.f || vehicle.Steering != 0.f;
+
+    if(vehicle.Parked)
+    {
+      bool pushed = !NewtonBodyGetFreezeState(body);
+
+      // A moving body (a character, another vehicle) touching the parked one
+      for(NewtonJoint *joint = NewtonBodyGetFirstContactJoint(body); joint && !pushed;
+        joint = NewtonBodyGetNextContactJoint(body, joint))
+      {
+        NewtonBody *other = NewtonJointGetBody0(joint);
+
+        if(other == body)
+          other = NewtonJointGetBody1(joint);
+
+        irr::f32 velocity[3];
+        NewtonBodyGetVelocity(other, velocity);
+
+        pushed = velocity[0]*velocity[0] + velocity[1]*velocity[1] + velocity[2]*velocity[2] > movingSpeed * movingSpeed;
+      }
+
+      if(!input && !pushed)
+      {
+        ++m_Parked;
+        continue;
+      }
+
+      unpark(i);
+    }
+
+    irr::core::vector3df velocity, omega;
+    NewtonBodyGetVelocity(body, &velocity.X);
+    NewtonBodyGetOmega(body, &omega.X);
+
+    if(!input && velocity.getLength() * NewtonToIrr < VEHICLE_PARK_SPEED && omega.getLength() < VEHICLE_PARK_OMEGA)
+      vehicle.IdleTime += time;
+    else
+      vehicle.IdleTime = 0.f;
+
+    if(vehicle.IdleTime >= VEHICLE_PARK_TIME)
+    {
+      park(i);
+      ++m_Parked;
+      continue;
+    }
+
+    ++m_Driving;
+
+    m_Previous[i] = m_Current[i];
+
+    const SVehicleClass &handling = vehicleClasses[vehicle.Class];
+
+    irr::core::matrix4 matrix;
+    NewtonBodyGetMatrix(body, getMatrixPointer(matrix));
+    matrix.setTranslation(matrix.getTranslation() * NewtonToIrr);
+
+    irr::core::vector3df down(-matrix[4], -matrix[5], -matrix[6]);
+
+    for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w)
+    {
+      const SVehicleWheel &wheel = vehicle.Wheels[w];
+
+      irr::core::vector3df start = wheel.Hardpoint;
+      matrix.transformVect(start);
+
+      m_Batch.lines.push_back(irr::core::line3df(start, start + down * (handling.Travel + wheel.Radius)));
+      m_Batch.excluded.push_back(vehicle.Body->getShapeID());
+    }
+  }
+
+  if(m_Batch.lines.size() == 0)
+    return;
+
+  Core->getPhysics()->getPhysicsWorld()->getRayCollisions(m_Batch);
+
+  //
+  // Contacts of the wheels, in the order the rays were pushed
+  //
+
+  irr::u32 ray = 0;
+
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    SVehicle &vehicle = m_Vehicles[i];
+
+    if(!vehicle.Body || vehicle.Parked)
+      continue;
+
+    const SVehicleClass &handling = vehicleClasses[vehicle.Class];
+
+    for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w, ++ray)
+    {
+      SVehicleWheel &wheel = vehicle.Wheels[w];
+      const SRayCastResult &result = m_Batch.results[ray];
+
+      wheel.Contact = result.body != (physics::CBody*)NULL;
+
+      if(wheel.Contact)
+      {
+        wheel.Compression = irr::core::clamp(handling.Travel + wheel.Radius - result.distance, 0.f, handling.Travel);
+        wheel.Normal = result.normal;
+        wheel.Ground = result.body;
+      }
+      else
+      {
+        wheel.Compression = 0.f;
+        wheel.Normal.set(0.f, 1.f, 0.f);
+        wheel.Ground = (physics::CBody*)NULL;
+      }
+    }
+  }
+}
+
+void CVehicleManager::applyForces(irr::u32 index, irr::f32 timestep)
+{
+  SVehicle &vehicle = m_Vehicles[index];
+  NewtonBody *body = vehicle.Body->getNewtonBody();
+
+  const SVehicleClass &handling = vehicleClasses[vehicle.Class];
+
+  irr::f32 mass, ixx, iyy, izz;
+  NewtonBodyGetMassMatrix(body, &mass, &ixx, &iyy, &izz);
+
+  irr::core::matrix4 matrix;
+  NewtonBodyGetMatrix(body, getMatrixPointer(matrix));
+
+  irr::core::vector3df com, velocity, omega;
+  NewtonBodyGetCentreOfMass(body, &com.X);
+  matrix.transformVect(com);
+
+  NewtonBodyGetVelocity(body, &velocity.X);
+  NewtonBodyGetOmega(body, &omega.X);
+
+  irr::core::vector3df force(0.f, -9.8f * mass, 0.f), torque;
+
+  irr::core::vector3df up(matrix[4], matrix[5], matrix[6]);
+  irr::core::vector3df front(matrix[8], matrix[9], matrix[10]);
+
+  // No more throttle past the top speed, half of it in reverse
+  irr::f32 forwardSpeed = velocity.dotProduct(front);
+  irr::f32 maxSpeed = handling.MaxSpeed * IrrToNewton;
+
+  irr::f32 throttle = vehicle.Throttle;
+
+  if((throttle > 0.f && forwardSpeed > maxSpeed) || (throttle < 0.f && forwardSpeed < -maxSpeed * 0.5f))
+    throttle = 0.f;
+
+  irr::f32 wheelMass = mass / irr::core::max_(vehicle.Wheels.size(), 1u);
+
+  for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w)
+  {
+    const SVehicleWheel &wheel = vehicle.Wheels[w];
+
+    if(!wheel.Contact)
+      continue;
+
+    irr::core::vector3df point = wheel.Hardpoint * IrrToNewton;
+    matrix.transformVect(point);
+
+    irr::core::vector3df arm = point - com;
+    irr::core::vector3df pointVelocity = velocity + omega.crossProduct(arm);
+
+    // Suspension: the spring pushes, the damper works against the compressing
+    // and stretching, a wheel never pulls the chassis down
+    irr::f32 load = vehicle.Spring * wheel.Compression * IrrToNewton - vehicle.Damper * pointVelocity.dotProduct(up);
+
+    if(load <= 0.f)
+      continue;
+
+    // Rolling direction of the wheel on the ground
+    irr::f32 steer = wheel.Steered ? vehicle.Steering * handling.Steer * irr::core::DEGTORAD : 0.f;
+
+    irr::core::vector3df heading(sinf(steer), 0.f, cosf(steer));
+    matrix.rotateVect(heading);
+
+    heading -= wheel.Normal * heading.dotProduct(wheel.Normal);
+
+    if(heading.getLengthSQ() < 0.0001f)
+      continue;
+
+    heading.normalize();
+
+    irr::core::vector3df side = wheel.Normal.crossProduct(heading);
+
+    irr::f32 rolling = pointVelocity.dotProduct(heading);
+    irr::f32 sliding = pointVelocity.dotProduct(side);
+
+    irr::f32 longitudinal;
+
+    if(vehicle.Brake)
+      longitudinal = irr::core::clamp(-rolling * wheelMass / timestep,
+        -handling.Braking * wheelMass, handling.Braking * wheelMass);
+    else if(throttle != 0.f)
+      longitudinal = throttle * handling.Acceleration * wheelMass;
+    else
+      longitudinal = irr::core::clamp(-rolling * wheelMass / timestep,
+        -VEHICLE_ROLLING_DECELERATION * wheelMass, VEHICLE_ROLLING_DECELERATION * wheelMass);
+
+    // A tank steers by pulling its tracks against each other, as hard as
+    // they grip, the tracks skid sideways around the turn
+    if(vehicle.Class == EVC_TRACKED && !vehicle.Brake)
+      longitudinal -= vehicle.Steering * wheel.Side * handling.Grip * load;
+
+    // Half of the sliding is taken away each tick, all of it makes the
+    // wheels of one axle fight each other
+    irr::f32 lateral = -sliding * wheelMass / timestep * 0.5f;
+
+    // Friction ellipse: the tire can't grip harder than the load allows
+    irr::f32 maxLongitudinal = handling.Grip * load;
+    irr::f32 maxLateral = handling.SideGrip * load;
+
+    irr::f32 x = longitudinal / maxLongitudinal;
+    irr::f32 y = lateral / maxLateral;
+    irr::f32 slip = x*x + y*y;
+
+    if(slip > 1.f)
+    {
+      irr::f32 scale = 1.f / sqrtf(slip);
+
+      longitudinal *= scale;
+      lateral *= scale;
+    }
+
+    irr::core::vector3df wheelForce = up * load + heading * longitudinal + side * lateral;
+
+    force += wheelForce;
+    torque += arm.crossProduct(wheelForce);
+  }
+
+  NewtonBodySetForce(body, &force.X);
+  NewtonBodySetTorque(body, &torque.X);
+}
+
+void CVehicleManager::setTransform(irr::u32 index, const irr::f32 *matrix)
+{
+  irr::core::matrix4 transform;
+  transform.setM(matrix);
+
+  m_Current[index].Position = transform.getTranslation() * NewtonToIrr;
+  m_Current[index].Rotation.set(transform.getRotationDegrees() * irr::core::DEGTORAD);
+}
+
+void CVehicleManager::updateNodes(irr::f32 alpha, irr::f32 time)
+{
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    SVehicle &vehicle = m_Vehicles[i];
+
+    if(!vehicle.Body || vehicle.Parked)
+      continue;
+
+    irr::core::quaternion rotation;
+    rotation.slerp(m_Previous[i].Rotation, m_Current[i].Rotation, alpha);
+
+    irr::core::vector3df euler;
+    rotation.toEuler(euler);
+
+    vehicle.Node->setPosition(m_Previous[i].Position.getInterpolated(m_Current[i].Position, 1.f - alpha));
+    vehicle.Node->setRotation(euler * irr::core::RADTODEG);
+
+    updateWheelNodes(vehicle, time);
+  }
+}
+
+void CVehicleManager::updateWheelNodes(SVehicle& vehicle, irr::f32 time)
+{
+  const SVehicleClass &handling = vehicleClasses[vehicle.Class];
+
+  irr::core::vector3df velocity;
+  NewtonBodyGetVelocity(vehicle.Body->getNewtonBody(), &velocity.X);
+
+  irr::core::matrix4 matrix;
+  matrix.setRotationDegrees(vehicle.Node->getRotation());
+
+  irr::core::vector3df front(matrix[8], matrix[9], matrix[10]);
+
+  irr::f32 forwardSpeed = velocity.dotProduct(front) * NewtonToIrr;
+  irr::f32 scaleY = vehicle.Node->getScale().Y;
+
+  for(irr::u32 w=0; w < vehicle.Wheels.size(); ++w)
+  {
+    SVehicleWheel &wheel = vehicle.Wheels[w];
+
+    if(!wheel.Node)
+      continue;
+
+    // The wheel hangs down the travel it has left, the node's position is
+    // in the chassis' scaled space
+    irr::f32 drop = handling.Travel * 0.5f - wheel.Compression;
+
+    wheel.Node->setPosition(wheel.NodePosition - irr::core::vector3df(0.f, drop / scaleY, 0.f));
+
+    wheel.Spin = fmodf(wheel.Spin + forwardSpeed / wheel.Radius * time * irr::core::RADTODEG, 360.f);
+
+    irr::core::matrix4 steer, spin, original;
+    steer.setRotationDegrees(irr::core::vector3df(0.f, wheel.Steered ? vehicle.Steering * handling.Steer : 0.f, 0.f));
+    spin.setRotationDegrees(irr::core::vector3df(wheel.Spin, 0.f, 0.f));
+    original.setRotationDegrees(wheel.NodeRotation);
+
+    wheel.Node->setRotation((steer * spin * original).getRotationDegrees());
+  }
+}
+
+void CVehicleManager::clear()
+{
+  for(irr::u32 i=0; i < m_Vehicles.size(); ++i)
+  {
+    SVehicle &vehicle = m_Vehicles[i];
+
+    if(vehicle.Body)
+    {
+      vehicle.Body->removeBody();
+
+      delete (game::SObjectData*)vehicle.Body->getUserData();
+      delete (CVehicleBody*)vehicle.Body;
+    }
+
+    // Still grabbed, the scene manager may have dropped it already
+    vehicle.Node->remove();
+    vehicle.Node->drop();
+  }
+
+  m_Vehicles.clear();
+  m_Previous.clear();
+  m_Current.clear();
+
+  m_Batch.lines.clear();
+  m_Batch.excluded.clear();
+  m_Batch.results.clear();
+
+  m_Driving = m_Parked = 0;
+}
+
+#endif
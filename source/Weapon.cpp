@@ -68,6 +68,10 @@ void CWeapon::createMuzzle()
     muzzle->addAnimator(anim);
     anim->drop();
 
+    muzzle->updateAbsolutePosition();
+
+    Game->getCore()->getRenderer()->getLights()->addLight(
+      muzzle->getAbsolutePosition(), MUZZLE_LIGHT_COLOR, MUZZLE_LIGHT_RADIUS, MUZZLE_LIGHT_TIME);
   }
 }
 
@@ -86,10 +90,6 @@ void CWeapon::checkForHits()
     targetRotationMatrix.rotateVect(firingTarget);
 
     irr::core::line3df wFireLine;
-    bool bodyHit = false;
-    irr::core::vector3df hitPosition, hitNormal;
-    SObjectData* bodyUserData = (SObjectData*)NULL;
-    irr::scene::IMeshSceneNode *hitNode = NULL;
 
 #ifdef PHYSICS_NEWTON
     wFireLine.start = weaponTransformationMatrix.getTranslation();
@@ -101,153 +101,16 @@ void CWeapon::checkForHits()
       Game->getCharacters()->getPlayer()->getBody()->PhysicsBody->getShapeID());
 
     weaponTraceRay.line = wFireLine;
+    weaponTraceRay.wake = true;
 
     engine::physics::SRayCastResult rayResult =
       Game->getCore()->getPhysics()->getRayCollision(weaponTraceRay);
 
-    bodyHit = (rayResult.body == NULL) ? false : true;
-
-    if(bodyHit)
-    {
-      bodyUserData = (SObjectData*)rayResult.body->getUserData();
-      hitPosition = rayResult.position;
-      hitNormal = rayResult.normal;
-      hitNode = (irr::scene::IMeshSceneNode *)rayResult.body->getNode();
-    }
+    if(rayResult.body)
+      Game->createBulletHit(rayResult.body, rayResult.position, rayResult.normal,
+        wFireLine.getVector(), node->getParam(0) != 0);
 #endif
 
-    if(bodyHit && bodyUserData)
-    {
-      irr::core::vector3df impulse = irr::core::vector3df(0, 0, 0.25f);
-      targetRotationMatrix.rotateVect(impulse);
-
-      // What type of body was hit?
-      engine::CBaseMapObject *obj_ =
-        Game->getCore()->getObjects()->getObject(bodyUserData->type, bodyUserData->container_id);
-
-      irr::core::matrix4 decal_matrix;
-
-      bool create_bullet_hole_decal = false;
-      irr::core::stringc bullet_debris_texture = "";
-      irr::f32 bullet_debris_scale = 1.f;
-      irr::f32 bullet_debris_velocity = 0.0010f;
-      irr::u32 bullet_debris_random_angle = 30;
-      irr::core::vector3df bullet_debris_position_offset;
-
-      if(bodyUserData->type == EOT_DYNAMIC)
-      {
-        //colOut.body->addImpulse(impulse, colOut.point);
-
-        create_bullet_hole_decal = true;
-      }
-      else if(bodyUserData->type == EOT_STATIC)
-      {
-        create_bullet_hole_decal = true;
-      }
-      else if(bodyUserData->type == EOT_BUILDING)
-      {
-        create_bullet_hole_decal = true;
-      }
-      else if(bodyUserData->type == EOT_TERRAIN)
-      {
-        bullet_debris_texture = "data/particles/debris/bh_dirt_piece.tga";
-        bullet_debris_scale = 1.58f;
-        bullet_debris_velocity = 0.0037f;
-        bullet_debris_random_angle = 27;
-        bullet_debris_position_offset.set(0.f, 0.30f, 0.f);
-      }
-
-      // Create bullet mark
-
-      if(node->getParam(0) != 0 && create_bullet_hole_decal)
-      {
-        irr::core::vector3df bullet_hole_position = hitPosition - hitNode->getPosition();
-
-        irr::core::stringc bullet_hole_texture = "";
-
-        switch(bodyUserData->material)
-        {
-          case EBMT_METAL:
-            bullet_hole_texture = "data/particles/decals/bullethole_metal.png";
-            bullet_debris_texture = "data/particles/debris/bh_metal_fastpiece.tga";
-          break;
-
-          case EBMT_STONE:
-            bullet_hole_texture = "data/particles/decals/bullethole_stone.png";
-            bullet_debris_texture = "data/particles/debris/stonechip.tga";
-          break;
-
-          case EBMT_WOOD:
-            bullet_hole_texture = "data/particles/decals/bullethole_wood.png";
-            bullet_debris_texture = "data/particles/debris/woodsplinters.tga";
-            bullet_debris_scale = 0.85f;
-          break;
-
-          case EBMT_SANDBAG:
-            bullet_hole_texture = "data/particles/decals/bullethole_sandbag.png";
-            bullet_debris_texture = "data/particles/debris/bh_wood_piece.tga";
-            bullet_debris_scale = 0.5f;
-          break;
-
-          default:
-            bullet_hole_texture = "data/particles/decals/bullethole_stone.png";
-            bullet_debris_texture = "data/particles/debris/stonechip.tga";
-          break;
-        }
-
-        if(obj_->isDecalAtPosition(bullet_hole_position, MINIMUM_DISTANCE_BETWEEN_BULLET_DECALS) == false)
-        {
-          irr::scene::IMeshBuffer* bullet_hole_decal =
-            Game->getCore()->getRenderer()->getSceneManager()->getMesh("data/particles/decals/bullethole1.ms3d")->getMeshBuffer(0);
-
-          bullet_hole_decal->getMaterial().setTexture(0,
-            Game->getCore()->getRenderer()->getVideoDriver()->getTexture(bullet_hole_texture.c_str()));
-          bullet_hole_decal->getMaterial().Lighting = false;
-          bullet_hole_decal->getMaterial().MaterialType = irr::video::EMT_TRANSPARENT_ALPHA_CHANNEL_REF ;
-          bullet_hole_decal->getMaterial().MaterialTypeParam = 0.20f;
-          bullet_hole_decal->getMaterial().FogEnable = true;
-
-          irr::core::matrix4 decal_rotation_matrix;
-          decal_rotation_matrix.setRotationDegrees(
-            irr::core::vector3df(0, irr::f32(Game->getCore()->getMath()->getRandomInt(0,360)),0));
-
-          Game->getCore()->getMath()->alignToUpVector(decal_matrix, decal_rotation_matrix, hitNormal, 1.0f);
-
-          irr::scene::CBatchingMesh* obj_mesh = (irr::scene::CBatchingMesh*)hitNode->getMesh();
-          Game->getCore()->getObjects()->copyMaterialToMesh(obj_mesh, hitNode);
-
-          obj_mesh->addMeshBuffer(
-            bullet_hole_decal,
-            bullet_hole_position,
-            decal_matrix.getRotationDegrees(),
-            irr::core::vector3df(0.0019f,0.0019f,0.0019f));
-
-          obj_mesh->update();
-          hitNode->setMesh(obj_mesh);
-        }
-
-      }
-
-      if(bullet_debris_texture != "")
-      {
-        // Each particle has a slightly different size
-        bullet_debris_scale *= irr::f32(Game->getCore()->getMath()->getRandomInt(750,1280)/1000.f);
-
-        Game->createSurfaceHitParticles(
-          bullet_debris_texture.c_str(),
-          hitPosition + bullet_debris_position_offset,
-          hitNormal.normalize(),
-          bullet_debris_scale,
-          bullet_debris_velocity,
-          0.41f,
-          15, 20, bullet_debris_random_angle);
-      }
-
-      // Play hit sound based on body material
-      Game->playSurfaceHitSound((game::E_BODY_MATERIAL_TYPE)bodyUserData->material, hitPosition);
-
-    }
-
   }
   else {
 #ifdef ENGINE_DEVELOPMENT_MODE
@@ -6,6 +6,10 @@ void CBody::setRotation(irr::core::vector3df rotation)
 {
   m_Node->setRotation(rotation);
 
+  // Merged static meshes collide through their region
+  if(!m_NewtonBody)
+    return;
+
 	irr::core::matrix4 temp_mat;
 	NewtonBodyGetMatrix(m_NewtonBody, getMatrixPointer(temp_mat));
 	temp_mat.setRotationDegrees(rotation);
@@ -16,6 +20,9 @@ void CBody::setPosition(irr::core::vector3df position)
 {
   m_Node->setPosition(position);
 
+  if(!m_NewtonBody)
+    return;
+
   irr::core::matrix4 body_matrix;
 	NewtonBodyGetMatrix(m_NewtonBody, getMatrixPointer(body_matrix));
 
@@ -34,6 +41,49 @@ irr::core::vector3df CBody::getPositionBody()
 	return (body_matrix.getTranslation() * NewtonToIrr);
 }
 
+void CBody::moveKinematic(irr::core::vector3df position, irr::f32 time)
+{
+  if(time > 0.f)
+    setVelocity((position - getPositionBody()) * (IrrToNewton / time));
+
+  NewtonBodySetFreezeState(m_NewtonBody, 0);
+
+  setPosition(position);
+}
+
+void CBody::stopKinematic()
+{
+  setVelocity(irr::core::vector3df(0.f, 0.f, 0.f));
+
+  NewtonBodySetFreezeState(m_NewtonBody, 1);
+}
+
+void CBody::wake()
+{
+  if(!m_NewtonBody || b_Kinematic || m_Mass <= 0.f)
+    return;
+
+  NewtonBodySetFreezeState(m_NewtonBody, 0);
+  NewtonBodySetSleepState(m_NewtonBody, 0);
+}
+
+void CBody::setCollisionEnabled(bool enabled)
+{
+  if(!m_NewtonBody || a_NewtonCollisions.size() == 0)
+    return;
+
+  if(enabled)
+  {
+    NewtonBodySetCollision(m_NewtonBody, getCurrentCollision());
+  }
+  else
+  {
+    NewtonCollision *nullCollision = NewtonCreateNull(m_NewtonWorld);
+    NewtonBodySetCollision(m_NewtonBody, nullCollision);
+    NewtonReleaseCollision(m_NewtonWorld, nullCollision);
+  }
+}
+
 void CBody::setContinuousCollisionMode(bool value)
 {
 	if(value)
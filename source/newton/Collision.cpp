@@ -12,15 +12,18 @@ void CCollisionManager::addMeshToTreeCollisionStandard(
 
 	irr::video::S3DVertex* mb_vertices = (irr::video::S3DVertex*) meshBuffer->getVertices();
 
-	irr::u16* mb_indices = meshBuffer->getIndices();
+	// Batched meshes use 32 bit indices
+	const irr::u16* mb_indices16 = meshBuffer->getIndices();
+	const irr::u32* mb_indices32 = (const irr::u32*)meshBuffer->getIndices();
+	bool bigIndices = meshBuffer->getIndexType() == irr::video::EIT_32BIT;
 
   irr::video::SMaterial mat = meshBuffer->getMaterial();
 
 	for (unsigned int j = 0; j < meshBuffer->getIndexCount(); j += 3)
 	{
-		int v1i = mb_indices[j + 0];
-		int v2i = mb_indices[j + 1];
-		int v3i = mb_indices[j + 2];
+		int v1i = bigIndices ? mb_indices32[j + 0] : mb_indices16[j + 0];
+		int v2i = bigIndices ? mb_indices32[j + 1] : mb_indices16[j + 1];
+		int v3i = bigIndices ? mb_indices32[j + 2] : mb_indices16[j + 2];
 
 		vArray[0] = mb_vertices[v1i].Pos * scale.X * IrrToNewton;
 		vArray[1] = mb_vertices[v2i].Pos * scale.Y * IrrToNewton;
@@ -50,15 +53,18 @@ void CCollisionManager::addMeshToTreeCollision2TCoords(
 
 	irr::video::S3DVertex2TCoords* mb_vertices = (irr::video::S3DVertex2TCoords*) meshBuffer->getVertices();
 
-	irr::u16* mb_indices  = meshBuffer->getIndices();
+	// Batched meshes use 32 bit indices
+	const irr::u16* mb_indices16 = meshBuffer->getIndices();
+	const irr::u32* mb_indices32 = (const irr::u32*)meshBuffer->getIndices();
+	bool bigIndices = meshBuffer->getIndexType() == irr::video::EIT_32BIT;
 
   irr::video::SMaterial mat = meshBuffer->getMaterial();
 
 	for (unsigned int j = 0; j < meshBuffer->getIndexCount(); j += 3)
 	{
-		int v1i = mb_indices[j + 0];
-		int v2i = mb_indices[j + 1];
-		int v3i = mb_indices[j + 2];
+		int v1i = bigIndices ? mb_indices32[j + 0] : mb_indices16[j + 0];
+		int v2i = bigIndices ? mb_indices32[j + 1] : mb_indices16[j + 1];
+		int v3i = bigIndices ? mb_indices32[j + 2] : mb_indices16[j + 2];
 
 		vArray[0] = mb_vertices[v1i].Pos * scale.X * IrrToNewton;
 		vArray[1] = mb_vertices[v2i].Pos * scale.Y * IrrToNewton;
@@ -88,15 +94,18 @@ void CCollisionManager::addMeshToTreeCollisionTangents(
 
 	irr::video::S3DVertexTangents* mb_vertices = (irr::video::S3DVertexTangents*) meshBuffer->getVertices();
 
-	irr::u16* mb_indices  = meshBuffer->getIndices();
+	// Batched meshes use 32 bit indices
+	const irr::u16* mb_indices16 = meshBuffer->getIndices();
+	const irr::u32* mb_indices32 = (const irr::u32*)meshBuffer->getIndices();
+	bool bigIndices = meshBuffer->getIndexType() == irr::video::EIT_32BIT;
 
   irr::video::SMaterial mat = meshBuffer->getMaterial();
 
 	for (unsigned int j = 0; j < meshBuffer->getIndexCount(); j += 3)
 	{
-		int v1i = mb_indices[j + 0];
-		int v2i = mb_indices[j + 1];
-		int v3i = mb_indices[j + 2];
+		int v1i = bigIndices ? mb_indices32[j + 0] : mb_indices16[j + 0];
+		int v2i = bigIndices ? mb_indices32[j + 1] : mb_indices16[j + 1];
+		int v3i = bigIndices ? mb_indices32[j + 2] : mb_indices16[j + 2];
 
 		vArray[0] = mb_vertices[v1i].Pos * scale.X * IrrToNewton;
 		vArray[1] = mb_vertices[v2i].Pos * scale.Y * IrrToNewton;
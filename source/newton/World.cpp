@@ -1,5 +1,14 @@
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/time.h>
+#endif
+
 #include "newton/World.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
 using namespace engine::physics;
 
 using namespace irr;
@@ -11,6 +20,25 @@ CPhysicsWorld::~CPhysicsWorld()
 {
 }
 
+//
+// Job scheduler callbacks, Newton's threads are replaced by the job manager
+//
+
+void world_RunJob(void *job, irr::u32 thread)
+{
+	NewtonExecuteJob(job);
+}
+
+void world_SubmitJob(void *userData, void *job)
+{
+	((CPhysicsWorld*)userData)->submitNewtonJob(job);
+}
+
+void world_WaitJobs(void *userData)
+{
+	((CPhysicsWorld*)userData)->waitNewtonJobs();
+}
+
 //
 // Body callbacks
 //
@@ -95,6 +123,7 @@ NewtonCollision * CPhysicsWorld::createCollisionFromBodyParameters(SBodyCreation
     break;
 
     case EBT_CONVEX_HULL:
+    case EBT_KINEMATIC:
       newtonCollision = collisionManager.createConvexHull(
         m_NewtonWorld,
         params.mesh,
@@ -136,7 +165,7 @@ CBody * CPhysicsWorld::createBody(SBodyCreationParameters params)
 
   bool isDynamicBody = true;
 
-  if(params.type == EBT_TREE_COLLISION)
+  if(params.type == EBT_TREE_COLLISION || params.type == EBT_KINEMATIC)
     isDynamicBody = false;
 
   newtonCollision = createCollisionFromBodyParameters(params);
@@ -192,11 +221,24 @@ const dFloat* matrix;
     // set the function callback to set the transformation state of the graphic entity associated with this body
     // each time the body change position and orientation in the physics world
     NewtonBodySetTransformCallback(newtonBody, body_SetTransformCallback);
+
+    // resting bodies stop receiving the force callback
+    NewtonBodySetAutoSleep(newtonBody, 1);
   }
 
   body->setPosition(params.node->getPosition());
   //body->setRotation(params.node->getRotation());
 
+  // No mass: only the game moves it, the velocity is for the contacts
+  if(params.type == EBT_KINEMATIC)
+  {
+    body->setKinematic(true);
+    body->setRotation(params.node->getRotation());
+
+    NewtonBodySetAutoSleep(newtonBody, 1);
+    NewtonBodySetFreezeState(newtonBody, 1);
+  }
+
 	NewtonBodySetUserData(newtonBody, body);
 
   all_bodies.push_back(body);
@@ -204,6 +246,131 @@ const dFloat* matrix;
   return body;
 }
 
+CBody * CPhysicsWorld::createStaticBody(SBodyCreationParameters params, const irr::core::matrix4& transformation)
+{
+  CBody * body = new CBody(params.bodyID, m_NewtonWorld);
+
+  body->setNode(params.node);
+  body->setMass(0.f);
+  body->setUserData(NULL);
+
+  static_bodies.push_back(body);
+  all_bodies.push_back(body);
+
+  irr::s32 attribute = irr::s32(static_bodies.size());
+
+  for(irr::u32 b=0; b < params.mesh->getMeshBufferCount(); ++b)
+  {
+    irr::scene::IMeshBuffer *buffer = params.mesh->getMeshBuffer(b);
+
+    // Batched meshes use 32 bit indices
+    const irr::u16* indices16 = buffer->getIndices();
+    const irr::u32* indices32 = (const irr::u32*)buffer->getIndices();
+    bool bigIndices = buffer->getIndexType() == irr::video::EIT_32BIT;
+
+    // Alpha tested faces (fences, foliage) collide from both sides
+    irr::video::E_MATERIAL_TYPE materialType = buffer->getMaterial().MaterialType;
+    bool twoSided = materialType == irr::video::EMT_TRANSPARENT_ALPHA_CHANNEL
+      || materialType == irr::video::EMT_TRANSPARENT_ALPHA_CHANNEL_REF;
+
+    irr::core::vector3df face[3];
+
+    for(irr::u32 i=0; i + 2 < buffer->getIndexCount(); i += 3)
+    {
+      for(irr::u32 v=0; v < 3; ++v)
+      {
+        irr::u32 index = bigIndices ? indices32[i + v] : indices16[i + v];
+
+        transformation.transformVect(face[v], buffer->getPosition(index));
+        face[v] *= IrrToNewton;
+      }
+
+      addStaticFace(face, attribute);
+
+      if(twoSided)
+      {
+        irr::core::vector3df back[3] = { face[2], face[1], face[0] };
+        addStaticFace(back, attribute);
+      }
+    }
+  }
+
+  return body;
+}
+
+void CPhysicsWorld::addStaticFace(const irr::core::vector3df* face, irr::s32 attribute)
+{
+  irr::core::vector3df center = (face[0] + face[1] + face[2]) * (NewtonToIrr / 3.f);
+
+  irr::s32 x = irr::s32(floorf(center.X / STATIC_REGION_SIZE));
+  irr::s32 z = irr::s32(floorf(center.Z / STATIC_REGION_SIZE));
+
+  irr::u32 key = (irr::u32(x & 0xFFFF) << 16) | irr::u32(z & 0xFFFF);
+
+  irr::core::map<irr::u32, SStaticRegion*>::Node *node = static_regions.find(key);
+  SStaticRegion *region;
+
+  if(node)
+    region = node->getValue();
+  else
+  {
+    region = new SStaticRegion();
+    static_regions.insert(key, region);
+  }
+
+  region->vertices.push_back(face[0]);
+  region->vertices.push_back(face[1]);
+  region->vertices.push_back(face[2]);
+  region->attributes.push_back(attribute);
+  region->dirty = true;
+}
+
+void CPhysicsWorld::buildStaticWorld()
+{
+  irr::core::matrix4 identity;
+
+  irr::core::map<irr::u32, SStaticRegion*>::Iterator it = static_regions.getIterator();
+
+  for(; !it.atEnd(); it++)
+  {
+    SStaticRegion *region = it->getValue();
+
+    if(!region->dirty)
+      continue;
+
+    // One tree per region, the old one is replaced by a tree of all the faces
+    if(region->body)
+      NewtonDestroyBody(m_NewtonWorld, region->body);
+
+    NewtonCollision *treeCollision = NewtonCreateTreeCollision(m_NewtonWorld, getUniqueBodyID());
+
+    NewtonTreeCollisionBeginBuild(treeCollision);
+
+    for(irr::u32 i=0; i < region->attributes.size(); ++i)
+      NewtonTreeCollisionAddFace(treeCollision, 3, &region->vertices[i*3].X, sizeof(irr::core::vector3df), region->attributes[i]);
+
+    NewtonTreeCollisionEndBuild(treeCollision, 1);
+
+    NewtonBody *body = NewtonCreateBody(m_NewtonWorld, treeCollision, getMatrixPointer(identity));
+
+    // No CBody: hits are mapped to the mesh bodies by the face attribute
+    NewtonBodySetUserData(body, NULL);
+
+    collisionManager.releaseCollision(m_NewtonWorld, treeCollision);
+
+    region->body = body;
+    region->dirty = false;
+  }
+}
+
+CBody * CPhysicsWorld::getStaticBody(irr::s32 attribute)
+{
+  if(attribute < 1 || attribute > irr::s32(static_bodies.size()))
+    return (CBody*) NULL;
+
+  return static_bodies[attribute - 1];
+}
+
 float t = 0.0f;
 
 
@@ -281,6 +448,16 @@ void CPhysicsWorld::advanceSimulation3(irr::f32 time)
   NewtonUpdate(m_NewtonWorld, dt);
 }
 
+void CPhysicsWorld::setTimeStep(irr::f32 step)
+{
+  dt = step;
+}
+
+irr::f32 CPhysicsWorld::getTimeStep()
+{
+  return dt;
+}
+
 void CPhysicsWorld::advanceSimulation(irr::u32 timeInMilisecunds)
 {
 	// do the physics simulation here
@@ -339,12 +516,32 @@ void CPhysicsWorld::advanceSimulation(irr::u32 timeInMilisecunds)
 
 }
 
-void CPhysicsWorld::createNewtonWorld()
+void CPhysicsWorld::createNewtonWorld(CJobManager *jobs, irr::s32 architecture)
 {
 	m_NewtonWorld = NewtonCreate();
 
-	// use the standard x87 floating point model
-	NewtonSetPlatformArchitecture(m_NewtonWorld, 0);
+	m_Jobs = jobs;
+
+	configureWorld(m_NewtonWorld);
+
+	// the SSE solver is only taken when the cpu reports it
+	NewtonSetPlatformArchitecture(m_NewtonWorld, architecture);
+
+	char description[64];
+	NewtonGetPlatformArchitecture(m_NewtonWorld, description);
+
+	printf("Physics: %s solver, %s broadphase, %d threads\n", description,
+		m_Broadphase == PHYSICS_BROADPHASE_TREE ? "aabb tree" : "grid", NewtonGetThreadsCount(m_NewtonWorld));
+
+	g_timeAccumulator = DEMO_FPS_IN_MICROSECUNDS;
+}
+
+void CPhysicsWorld::configureWorld(NewtonWorld *world)
+{
+	// split the broadphase and the islands in one job per thread of the
+	// job manager instead of starting Newton's own threads
+	if(m_Jobs)
+		NewtonSetJobScheduler(world, m_Jobs->getThreadCount(), world_SubmitJob, world_WaitJobs, this);
 
 	// set a fix world size
 	irr::core::vector3df minSize(-5000.0f, -1000.0f, -5000.0f);
@@ -358,15 +555,302 @@ void CPhysicsWorld::createNewtonWorld()
 	fillVec3(minSize, min_size);
 	fillVec3(maxSize, max_size);
 
-	NewtonSetWorldSize(m_NewtonWorld, min_size, max_size);
+	NewtonSetWorldSize(world, min_size, max_size);
 
 	// configure the Newton world to use iterative solve mode 0
 	// this is the most efficient but the less accurate mode
-	NewtonSetSolverModel(m_NewtonWorld, 1);
+	NewtonSetSolverModel(world, 1);
 
-	NewtonSetMinimumFrameRate(m_NewtonWorld, 30);
+	NewtonSetMinimumFrameRate(world, 30);
 
-	g_timeAccumulator = DEMO_FPS_IN_MICROSECUNDS;
+	NewtonSelectBroadphaseAlgorithm(world, m_Broadphase);
+
+	NewtonSetSleepThresholds(world, PHYSICS_SLEEP_ACCEL * IrrToNewton, PHYSICS_SLEEP_SPEED * IrrToNewton, PHYSICS_SLEEP_OMEGA, PHYSICS_SLEEP_FRAMES);
+}
+
+void CPhysicsWorld::setBroadphase(irr::s32 broadphase)
+{
+	m_Broadphase = broadphase;
+
+	if(m_NewtonWorld)
+		NewtonSelectBroadphaseAlgorithm(m_NewtonWorld, m_Broadphase);
+}
+
+//
+// Solver benchmark
+//
+
+unsigned benchmark_GetTicks()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return unsigned((counter.QuadPart * 1000000) / frequency.QuadPart);
+#else
+	timeval tv;
+	gettimeofday(&tv, 0);
+
+	return unsigned(tv.tv_sec * 1000000 + tv.tv_usec);
+#endif
+}
+
+void benchmark_ApplyForceAndTorqueCallback(const NewtonBody* newtonBody, float timestep, int threadIndex)
+{
+	irr::f32 mass, ixx, iyy, izz;
+	NewtonBodyGetMassMatrix(newtonBody, &mass, &ixx, &iyy, &izz);
+
+	irr::f32 force_array[3] = { 0.f, -9.8f * mass, 0.f };
+
+	NewtonBodySetForce(newtonBody, force_array);
+}
+
+static NewtonBody *benchmark_CreateBody(NewtonWorld *world, NewtonCollision *collision, const irr::core::vector3df& position, irr::f32 mass)
+{
+	irr::core::matrix4 matrix;
+	matrix.setTranslation(position);
+
+	NewtonBody *body = NewtonCreateBody(world, collision, matrix.pointer());
+
+	if(mass > 0.f)
+	{
+		irr::f32 inertia_array[3], origin_array[3];
+
+		NewtonConvexCollisionCalculateInertialMatrix(collision, inertia_array, origin_array);
+		NewtonBodySetMassMatrix(body, mass, mass * inertia_array[0], mass * inertia_array[1], mass * inertia_array[2]);
+
+		NewtonBodySetForceAndTorqueCallback(body, benchmark_ApplyForceAndTorqueCallback);
+
+		// sleeping bodies would leave the solver less work in the later steps
+		NewtonBodySetAutoSleep(body, 0);
+	}
+
+	return body;
+}
+
+static void benchmark_CreateScene(NewtonWorld *world)
+{
+	NewtonCollision *floor = NewtonCreateBox(world, 200.f, 1.f, 200.f, 0, NULL);
+	benchmark_CreateBody(world, floor, irr::core::vector3df(0.f, -0.5f, 0.f), 0.f);
+	NewtonReleaseCollision(world, floor);
+
+	// stacks of unit boxes resting on each other
+	NewtonCollision *box = NewtonCreateBox(world, 1.f, 1.f, 1.f, 0, NULL);
+
+	for(irr::u32 s=0; s < BENCHMARK_STACKS; ++s)
+		for(irr::u32 h=0; h < BENCHMARK_STACK_HEIGHT; ++h)
+			benchmark_CreateBody(world, box, irr::core::vector3df(s * 3.f - BENCHMARK_STACKS * 1.5f, 0.5f + h, -10.f), 1.f);
+
+	NewtonReleaseCollision(world, box);
+
+	// chains of capsules along X, dropped on the floor
+	NewtonCollision *link = NewtonCreateCapsule(world, 0.2f, 1.f, 0, NULL);
+	irr::f32 pin[3] = { 1.f, 0.f, 0.f };
+
+	for(irr::u32 c=0; c < BENCHMARK_CHAINS; ++c)
+	{
+		NewtonBody *parent = (NewtonBody*)NULL;
+
+		for(irr::u32 l=0; l < BENCHMARK_CHAIN_LINKS; ++l)
+		{
+			irr::core::vector3df position(l * 1.f - BENCHMARK_CHAIN_LINKS * 0.5f, 3.f + c * 0.5f, 5.f + c * 2.f);
+
+			NewtonBody *body = benchmark_CreateBody(world, link, position, 1.f);
+
+			if(parent)
+			{
+				irr::f32 pivot[3];
+				fillVec3(position - irr::core::vector3df(0.5f, 0.f, 0.f), pivot);
+
+				NewtonJoint *joint = NewtonConstraintCreateBall(world, pivot, body, parent);
+				NewtonBallSetConeLimits(joint, pin, 0.8f, 0.5f);
+				NewtonJointSetCollisionState(joint, 0);
+			}
+
+			parent = body;
+		}
+	}
+
+	NewtonReleaseCollision(world, link);
+}
+
+void CPhysicsWorld::benchmark(irr::u32 steps)
+{
+	if(steps == 0)
+		return;
+
+	printf("Physics benchmark: %d stacks of %d boxes, %d chains of %d links, %d steps\n",
+		BENCHMARK_STACKS, BENCHMARK_STACK_HEIGHT, BENCHMARK_CHAINS, BENCHMARK_CHAIN_LINKS, steps);
+
+	const irr::s32 architectures[2] = { PHYSICS_ARCHITECTURE_X87, PHYSICS_ARCHITECTURE_BEST };
+
+	irr::s32 lastMode = -1;
+
+	for(irr::u32 a=0; a < 2; ++a)
+	{
+		NewtonWorld *world = NewtonCreate();
+
+		configureWorld(world);
+
+		NewtonSetPlatformArchitecture(world, architectures[a]);
+
+		char description[64];
+		irr::s32 mode = NewtonGetPlatformArchitecture(world, description);
+
+		// no SIMD on this cpu, the best mode is the x87 one again
+		if(mode == lastMode)
+		{
+			printf("\tno faster architecture on this cpu\n");
+			NewtonDestroy(world);
+			break;
+		}
+
+		lastMode = mode;
+
+		NewtonSetPerformanceClock(world, benchmark_GetTicks);
+
+		benchmark_CreateScene(world);
+
+		irr::u32 solverTime = 0, updateTime = 0;
+
+		for(irr::u32 i=0; i < steps; ++i)
+		{
+			NewtonUpdate(world, 1.f / DEMO_PHYSICS_FPS);
+
+			solverTime += NewtonReadPerformanceTicks(world, NEWTON_PROFILER_DYNAMICS_SOLVE_CONSTRAINT_GRAPH);
+			updateTime += NewtonReadPerformanceTicks(world, NEWTON_PROFILER_WORLD_UPDATE);
+		}
+
+		printf("\t%s: %.1f us solver, %.1f us update per step\n",
+			description, irr::f32(solverTime) / steps, irr::f32(updateTime) / steps);
+
+		NewtonDestroy(world);
+	}
+}
+
+//
+// Broadphase benchmark
+//
+
+static irr::f32 benchmark_RayCastFilter(const NewtonBody* body, const irr::f32* normal, int collisionID, void* userData, irr::f32 intersetParam)
+{
+	// closest hit only, like a weapon trace
+	++*(irr::u32*)userData;
+
+	return intersetParam;
+}
+
+static void benchmark_BodyInAABB(const NewtonBody* body, void* userData)
+{
+	++*(irr::u32*)userData;
+}
+
+static irr::f32 benchmark_Random(irr::f32 min, irr::f32 max)
+{
+	return min + (max - min) * (rand() % 10000) / 10000.f;
+}
+
+void CPhysicsWorld::benchmarkBroadphase(irr::u32 queries)
+{
+	if(!m_NewtonWorld || queries == 0)
+		return;
+
+	// traces and boxes are spread over the bounds of the level
+	irr::core::aabbox3df bounds;
+	irr::u32 bodyCount = 0;
+
+	for(NewtonBody *body = NewtonWorldGetFirstBody(m_NewtonWorld); body; body = NewtonWorldGetNextBody(m_NewtonWorld, body))
+	{
+		irr::f32 p0[3], p1[3];
+		NewtonBodyGetAABB(body, p0, p1);
+
+		irr::core::aabbox3df box(p0[0], p0[1], p0[2], p1[0], p1[1], p1[2]);
+
+		if(bodyCount++ == 0)
+			bounds = box;
+		else
+			bounds.addInternalBox(box);
+	}
+
+	printf("Broadphase benchmark: %d bodies, %d traces and box queries\n", bodyCount, queries);
+
+	const irr::s32 broadphases[2] = { PHYSICS_BROADPHASE_GRID, PHYSICS_BROADPHASE_TREE };
+
+	NewtonSetPerformanceClock(m_NewtonWorld, benchmark_GetTicks);
+
+	for(irr::u32 b=0; b < 2; ++b)
+	{
+		NewtonSelectBroadphaseAlgorithm(m_NewtonWorld, broadphases[b]);
+
+		// collision only, the bodies don't move
+		irr::u32 updateTime = 0;
+
+		for(irr::u32 i=0; i < BROADPHASE_BENCHMARK_STEPS; ++i)
+		{
+			NewtonCollisionUpdate(m_NewtonWorld);
+			updateTime += NewtonReadPerformanceTicks(m_NewtonWorld, NEWTON_PROFILER_COLLISION_UPDATE_BROAD_PHASE);
+		}
+
+		// the same traces and boxes for every broadphase
+		srand(1);
+
+		irr::u32 hits = 0, start = benchmark_GetTicks();
+
+		for(irr::u32 i=0; i < queries; ++i)
+		{
+			irr::f32 p0[3], p1[3];
+
+			for(irr::u32 j=0; j < 3; ++j)
+			{
+				p0[j] = benchmark_Random((&bounds.MinEdge.X)[j], (&bounds.MaxEdge.X)[j]);
+				p1[j] = benchmark_Random((&bounds.MinEdge.X)[j], (&bounds.MaxEdge.X)[j]);
+			}
+
+			NewtonWorldRayCast(m_NewtonWorld, p0, p1, benchmark_RayCastFilter, &hits, NULL);
+		}
+
+		irr::u32 rayTime = benchmark_GetTicks() - start;
+
+		irr::u32 found = 0;
+		start = benchmark_GetTicks();
+
+		irr::f32 halfSize = BROADPHASE_BENCHMARK_BOX * IrrToNewton * 0.5f;
+
+		for(irr::u32 i=0; i < queries; ++i)
+		{
+			irr::f32 p0[3], p1[3];
+
+			for(irr::u32 j=0; j < 3; ++j)
+			{
+				irr::f32 center = benchmark_Random((&bounds.MinEdge.X)[j], (&bounds.MaxEdge.X)[j]);
+				p0[j] = center - halfSize;
+				p1[j] = center + halfSize;
+			}
+
+			NewtonWorldForEachBodyInAABBDo(m_NewtonWorld, p0, p1, benchmark_BodyInAABB, &found);
+		}
+
+		irr::u32 boxTime = benchmark_GetTicks() - start;
+
+		printf("\t%s: %.1f us broadphase per update, %.2f us per trace (%d hits), %.2f us per box (%d bodies)\n",
+			broadphases[b] == PHYSICS_BROADPHASE_TREE ? "aabb tree" : "grid",
+			irr::f32(updateTime) / BROADPHASE_BENCHMARK_STEPS,
+			irr::f32(rayTime) / queries, hits, irr::f32(boxTime) / queries, found);
+	}
+
+	NewtonSelectBroadphaseAlgorithm(m_NewtonWorld, m_Broadphase);
+}
+
+void CPhysicsWorld::submitNewtonJob(void *job)
+{
+	m_Jobs->submit(world_RunJob, job, &m_NewtonJobs);
+}
+
+void CPhysicsWorld::waitNewtonJobs()
+{
+	m_Jobs->wait(&m_NewtonJobs);
 }
 
 void CPhysicsWorld::clear()
@@ -384,6 +868,15 @@ void CPhysicsWorld::clear()
   all_bodies.clear();
   all_bodies.set_used(0);
 
+  static_bodies.clear();
+
+  irr::core::map<irr::u32, SStaticRegion*>::Iterator it = static_regions.getIterator();
+
+  for(; !it.atEnd(); it++)
+    delete it->getValue();
+
+  static_regions.clear();
+
   g_timeAccumulator = DEMO_FPS_IN_MICROSECUNDS;
 }
 
@@ -418,6 +911,7 @@ irr::core::vector3df CPhysicsWorld::calculateToqueAtPoint(
 
 
 NewtonBody * pickedBody;
+irr::s32 pickedAttribute = 0;
 irr::f32 pickedParam = 0.f;
 irr::core::vector3df pickedPosition, pickedNormal;
 
@@ -442,6 +936,7 @@ static irr::f32 RayCastFilter (
 		//isPickedBodyDynamics = (mass > 0.0f);
 		pickedParam = intersetParam;
 		pickedBody = (NewtonBody*)body;
+		pickedAttribute = collisionID;
 		pickedNormal = irr::core::vector3df(normal[0], normal[1], normal[2]);
 	}
 	return intersetParam;
@@ -496,6 +991,13 @@ SRayCastResult CPhysicsWorld::getRayCollision(SRayCastParameters ray)
   if(pickedBody)
   {
     result.body = (CBody*)NewtonBodyGetUserData(pickedBody);
+
+    // Static regions have no body, the face attribute tells whose face was hit
+    if(!result.body)
+      result.body = getStaticBody(pickedAttribute);
+    else if(ray.wake)
+      result.body->wake();
+
     pickedPosition = currentRay.line.start + pickedParam * (currentRay.line.end - currentRay.line.start);
     pickedPosition *= NewtonToIrr;
   }
@@ -507,6 +1009,148 @@ SRayCastResult CPhysicsWorld::getRayCollision(SRayCastParameters ray)
   return result;
 }
 
+// Nearest hit of one batched segment. The filters get it as user data
+// instead of the globals above, so the segments can be cast on any thread.
+struct SBatchRayHit
+{
+  NewtonBody *body;
+  irr::s32 attribute;
+  irr::f32 param;
+  irr::f32 normal[3];
+  irr::u32 excluded;
+};
+
+static irr::f32 BatchRayCastFilter(
+  const NewtonBody* body,
+  const irr::f32* normal,
+  int collisionID,
+  void* userData,
+  irr::f32 intersetParam)
+{
+  SBatchRayHit *hit = (SBatchRayHit*)userData;
+
+  if(intersetParam < hit->param)
+  {
+    hit->param = intersetParam;
+    hit->body = (NewtonBody*)body;
+    hit->attribute = collisionID;
+    memcpy(hit->normal, normal, sizeof(hit->normal));
+  }
+
+  return intersetParam;
+}
+
+static unsigned BatchRayCastPrefilter(
+  const NewtonBody* body,
+  const NewtonCollision* collision,
+  void* userData)
+{
+  return NewtonCollisionGetUserID(collision) != ((SBatchRayHit*)userData)->excluded ? 1 : 0;
+}
+
+static void world_RayBatchJob(void *data, irr::u32 thread)
+{
+  SRayBatchJob *job = (SRayBatchJob*)data;
+
+  job->world->castRays(*job->batch, job->first, job->count);
+}
+
+void CPhysicsWorld::getRayCollisions(SRayBatch& batch)
+{
+  irr::u32 count = batch.lines.size();
+
+  batch.results.set_used(count);
+
+  irr::u32 threads = m_Jobs ? m_Jobs->getThreadCount() : 1;
+
+  if(threads < 2 || count < RAY_BATCH_PARALLEL_THRESHOLD)
+  {
+    castRays(batch, 0, count);
+  }
+  else
+  {
+    irr::u32 perJob = count / threads + 1;
+
+    m_RayJobs.set_used(0);
+
+    for(irr::u32 first=0; first < count; first += perJob)
+    {
+      SRayBatchJob job;
+      job.world = this;
+      job.batch = &batch;
+      job.first = first;
+      job.count = irr::core::min_(perJob, count - first);
+
+      m_RayJobs.push_back(job);
+    }
+
+    // The first range is cast here, idle threads take the rest
+    for(irr::u32 i=1; i < m_RayJobs.size(); ++i)
+      m_Jobs->submit(world_RayBatchJob, &m_RayJobs[i], &m_RayJobCounter);
+
+    castRays(batch, m_RayJobs[0].first, m_RayJobs[0].count);
+
+    m_Jobs->wait(&m_RayJobCounter);
+  }
+
+  // Not from the jobs, they may hit the same body. Static bodies and
+  // kinematic ones don't wake.
+  if(batch.wake)
+  {
+    for(irr::u32 i=0; i < count; ++i)
+    {
+      if(batch.results[i].body)
+        batch.results[i].body->wake();
+    }
+  }
+}
+
+void CPhysicsWorld::castRays(SRayBatch& batch, irr::u32 first, irr::u32 count)
+{
+  irr::f32 lineStart[3], lineEnd[3];
+
+  for(irr::u32 i=first; i < first + count; ++i)
+  {
+    const irr::core::line3df &line = batch.lines[i];
+    SRayCastResult &result = batch.results[i];
+
+    SBatchRayHit hit;
+    hit.body = (NewtonBody*)NULL;
+    hit.attribute = 0;
+    hit.param = 1.f;
+    hit.excluded = batch.excluded[i];
+
+    fillVec3(line.start * IrrToNewton, lineStart);
+    fillVec3(line.end * IrrToNewton, lineEnd);
+
+    NewtonWorldRayCast(m_NewtonWorld, lineStart, lineEnd, BatchRayCastFilter, &hit, BatchRayCastPrefilter);
+
+    result.body = (CBody*)NULL;
+
+    if(hit.body)
+    {
+      result.body = (CBody*)NewtonBodyGetUserData(hit.body);
+
+      // Static regions have no body, the face attribute tells whose face was hit
+      if(!result.body)
+        result.body = getStaticBody(hit.attribute);
+    }
+
+    if(result.body)
+    {
+      result.position = line.start + (line.end - line.start) * hit.param;
+      result.normal.set(hit.normal[0], hit.normal[1], hit.normal[2]);
+      result.distance = line.getLength() * hit.param;
+    }
+    else
+    {
+      result.position = line.end;
+      result.normal.set(0.f, 0.f, 0.f);
+      result.distance = line.getLength();
+    }
+  }
+}
+
 static unsigned ConvexCastCallback(
   const NewtonBody* body,
   const NewtonCollision* collision,